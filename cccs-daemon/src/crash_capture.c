@@ -0,0 +1,2056 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <json_object.h>
+#include <json_util.h>
+#include <libgen.h>
+#include <limits.h>
+#include <link.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/procfs.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "_cc_datapoints.h"
+#include "_utils.h"
+#include "crash_capture.h"
+
+#define CRASH_TAG			"CRASH:"
+
+#define DP_CRASH_STREAM_ID		"management/events/crash"
+#define CLOUD_DIR			"crashes"
+
+#define DEFAULT_CONFIG_FILE		"/etc/cccs.conf"
+#define CORE_PATTERN_FILE		"/proc/sys/kernel/core_pattern"
+/* Kernel limit of 'core_pattern', including the null character */
+#define CORE_PATTERN_MAX		128
+#define CORE_PATTERN_ARGS		"--crash-handler"
+#define CORE_PATTERN_DEFAULT		"core"
+/* Pattern to restore when unregistering the handler */
+#define CORE_PATTERN_SAVED_FILE		"/etc/cccs.core_pattern"
+
+#define CORE_EXT			".core.gz"
+#define META_EXT			".json"
+#define TMP_EXT				".tmp"
+/* Prefix of the core files consumed when not registered as handler */
+#define RAW_CORE_PREFIX			"core"
+
+#define LOOP_MS				1000
+#define SCAN_PERIOD_SEC			10
+/* Seconds without changes before a core file is considered complete */
+#define RAW_CORE_SETTLE_SEC		5
+/* Seconds before an incomplete capture is considered abandoned */
+#define STALE_TMP_SEC			(60 * 60)
+#define SEND_TIMEOUT_SEC		30
+
+/* Core data is read, compressed and uploaded in chunks of this size */
+#define CHUNK_SIZE			(64 * 1024)
+/* Deflate block, flush and gzip trailer overhead of a compressed chunk */
+#define GZIP_MARGIN			64
+/* Maximum size of the core headers and notes analyzed */
+#define MAX_NOTES_SIZE			(1024 * 1024)
+/* Bytes of the crashed thread stack kept to build the backtrace */
+#define STACK_CAPTURE_SIZE		(64 * 1024)
+/* Maximum size of a symbol or string table read to symbolize addresses */
+#define MAX_SYMTAB_SIZE			(8 * 1024 * 1024)
+#define MAX_FRAMES			16
+#define MAX_FRAME_LEN			256
+#define MAX_SYMBOL_LEN			128
+#define MAX_BUILD_ID			64
+#define MAX_NAME_LEN			16
+
+/* Registers of the crashed thread, see 'struct user_regs_struct' */
+#if defined(__x86_64__)
+#define CORE_REG_PC			16
+#define CORE_REG_SP			19
+#define CORE_REG_FP			4
+#elif defined(__i386__)
+#define CORE_REG_PC			12
+#define CORE_REG_SP			15
+#define CORE_REG_FP			5
+#elif defined(__aarch64__)
+#define CORE_REG_PC			32
+#define CORE_REG_SP			31
+#define CORE_REG_FP			29
+#define CORE_REG_LR			30
+#elif defined(__arm__)
+#define CORE_REG_PC			15
+#define CORE_REG_SP			13
+#define CORE_REG_LR			14
+#endif
+
+#if __ELF_NATIVE_CLASS == 64
+#define NATIVE_ELFCLASS			ELFCLASS64
+#define NATIVE_ST_TYPE			ELF64_ST_TYPE
+#else
+#define NATIVE_ELFCLASS			ELFCLASS32
+#define NATIVE_ST_TYPE			ELF32_ST_TYPE
+#endif
+
+#define ALIGN4(x)			(((x) + 3) & ~(size_t) 3)
+
+#if !(defined UNUSED_ARGUMENT)
+#define UNUSED_ARGUMENT(a)	(void)(a)
+#endif
+
+/**
+ * log_crash_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_crash_debug(format, ...)				\
+	log_debug("%s " format, CRASH_TAG, __VA_ARGS__)
+
+/**
+ * log_crash_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_crash_info(format, ...)				\
+	log_info("%s " format, CRASH_TAG, __VA_ARGS__)
+
+/**
+ * log_crash_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_crash_error(format, ...)				\
+	log_error("%s " format, CRASH_TAG, __VA_ARGS__)
+
+extern cc_cfg_t *cc_cfg;
+
+/*
+ * struct crash_map_t - File mapped in the crashed process
+ *
+ * @start:	Start address of the mapping.
+ * @end:	End address of the mapping.
+ * @offset:	Offset in the file of the start address.
+ * @path:	Path of the file.
+ */
+typedef struct {
+	unsigned long start;
+	unsigned long end;
+	unsigned long offset;
+	const char *path;
+} crash_map_t;
+
+/*
+ * struct crash_info_t - Captured crash
+ *
+ * @pid:		PID of the crashed process.
+ * @signal:		Signal that caused the crash.
+ * @time:		Time of the crash (epoch seconds).
+ * @name:		Name of the crashed process.
+ * @args:		Command line of the crashed process, maybe truncated.
+ * @exe:		Path of the crashed binary.
+ * @uptime:		System uptime in seconds, -1 if unknown.
+ * @process_uptime:	Seconds the process was running, -1 if unknown.
+ * @head:		Beginning of the core: ELF header, program headers and notes.
+ * @head_len:		Bytes in @head.
+ * @head_need:		Bytes of @head required for the next analysis stage.
+ * @head_stage:		Analysis stage: 0 ELF header, 1 program headers, 2 notes.
+ * @head_done:		True once the analysis of @head finished.
+ * @phdrs:		Program headers of the core.
+ * @n_phdrs:		Number of program headers.
+ * @has_regs:		True if the registers of the crashed thread are known.
+ * @pc:			Program counter of the crashed thread.
+ * @sp:			Stack pointer of the crashed thread.
+ * @fp:			Frame pointer of the crashed thread.
+ * @lr:			Link register of the crashed thread.
+ * @maps:		Files mapped in the crashed process.
+ * @n_maps:		Number of mapped files.
+ * @map_names:		Storage of the mapped file paths.
+ * @stack:		Stack of the crashed thread from @sp.
+ * @stack_off:		Offset of the stack in the core.
+ * @stack_size:		Bytes of the stack to capture.
+ * @stack_len:		Bytes of the stack captured.
+ * @raw_size:		Bytes of the core read.
+ * @stored_size:	Bytes of the compressed core stored.
+ * @truncated:		True if the core was truncated to the size cap.
+ */
+typedef struct {
+	pid_t pid;
+	int signal;
+	time_t time;
+	char name[MAX_NAME_LEN + 1];
+	char args[ELF_PRARGSZ + 1];
+	char exe[PATH_MAX];
+	long uptime;
+	long process_uptime;
+
+	unsigned char *head;
+	size_t head_len;
+	size_t head_need;
+	int head_stage;
+	bool head_done;
+	ElfW(Phdr) *phdrs;
+	size_t n_phdrs;
+
+	bool has_regs;
+	unsigned long pc;
+	unsigned long sp;
+	unsigned long fp;
+	unsigned long lr;
+
+	crash_map_t *maps;
+	size_t n_maps;
+	char *map_names;
+
+	unsigned char *stack;
+	uint64_t stack_off;
+	size_t stack_size;
+	size_t stack_len;
+
+	uint64_t raw_size;
+	uint64_t stored_size;
+	bool truncated;
+} crash_info_t;
+
+/*
+ * struct crash_settings_t - Crash capture settings
+ *
+ * @path:		Directory to store captured crashes.
+ * @max_core:		Maximum size in bytes of a compressed core, 0 for none.
+ * @max_stored:		Maximum number of stored crashes.
+ * @max_stored_size:	Maximum size in bytes of the stored crashes.
+ */
+typedef struct {
+	char *path;
+	uint64_t max_core;
+	unsigned int max_stored;
+	uint64_t max_stored_size;
+} crash_settings_t;
+
+static crash_settings_t settings;
+static bool consume_cores = false;
+
+static volatile bool stop_requested = false;
+static volatile bool crash_thread_valid = false;
+static pthread_t crash_thread;
+
+/*
+ * get_settings() - Copy the crash capture settings of a configuration
+ *
+ * @cfg:	Configuration.
+ * @s:		Settings to fill.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int get_settings(const cc_cfg_t *cfg, crash_settings_t *s)
+{
+	s->path = strdup(cfg->crash_path);
+	if (!s->path)
+		return -1;
+
+	s->max_core = (uint64_t) cfg->crash_max_core_kb * 1024;
+	s->max_stored = cfg->crash_max_stored;
+	s->max_stored_size = (uint64_t) cfg->crash_max_stored_kb * 1024;
+	/* A single crash always fits in the store */
+	if (s->max_core > s->max_stored_size)
+		s->max_core = s->max_stored_size;
+
+	return 0;
+}
+
+/*
+ * build_path() - Build the path of a file of a captured crash
+ *
+ * @buf:	Buffer to store the path.
+ * @size:	Size of @buf.
+ * @dir:	Crash capture directory.
+ * @base:	Base name of the crash.
+ * @ext:	Extension of the file.
+ *
+ * Return: 0 on success, -1 if the path does not fit.
+ */
+static int build_path(char *buf, size_t size, const char *dir, const char *base, const char *ext)
+{
+	int len = snprintf(buf, size, "%s/%s%s", dir, base, ext);
+
+	return (len < 0 || (size_t) len >= size) ? -1 : 0;
+}
+
+/*
+ * has_suffix() - Check if a string ends with a suffix
+ *
+ * @str:	String to check.
+ * @suffix:	Suffix to look for.
+ *
+ * Return: True if @str ends with @suffix.
+ */
+static bool has_suffix(const char *str, const char *suffix)
+{
+	size_t len = strlen(str), suffix_len = strlen(suffix);
+
+	return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+/*
+ * read_process_info() - Read the information of the crashed process
+ *
+ * @info:	Crash to fill.
+ *
+ * Must be called before reading the core, the process is gone afterwards.
+ */
+static void read_process_info(crash_info_t *info)
+{
+	char path[PATH_MAX], stat[1024];
+	unsigned long long start_ticks;
+	double uptime;
+	ssize_t len;
+	FILE *fp;
+	char *p;
+
+	snprintf(path, sizeof(path), "/proc/%d/exe", info->pid);
+	len = readlink(path, info->exe, sizeof(info->exe) - 1);
+	info->exe[len > 0 ? len : 0] = '\0';
+
+	fp = fopen("/proc/uptime", "r");
+	if (fp) {
+		if (fscanf(fp, "%lf", &uptime) == 1)
+			info->uptime = (long) uptime;
+		fclose(fp);
+	}
+
+	/* Start time is the 22nd field, after the name that may contain spaces */
+	snprintf(path, sizeof(path), "/proc/%d/stat", info->pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return;
+	p = fgets(stat, sizeof(stat), fp) ? strrchr(stat, ')') : NULL;
+	fclose(fp);
+	if (p && info->uptime >= 0
+		&& sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+			&start_ticks) == 1)
+		info->process_uptime = info->uptime - (long) (start_ticks / (unsigned long long) sysconf(_SC_CLK_TCK));
+}
+
+/*
+ * parse_file_note() - Parse the files mapped in the crashed process
+ *
+ * @info:	Crash to fill.
+ * @desc:	NT_FILE note descriptor.
+ * @size:	Size of @desc.
+ *
+ * The note has the number of mappings and the page size, followed by the
+ * start, end and page offset of every mapping and their null-terminated
+ * paths.
+ */
+static void parse_file_note(crash_info_t *info, const unsigned char *desc, size_t size)
+{
+	unsigned long count, page_size, *entries;
+	const char *name, *end = (const char *) desc + size;
+	size_t i;
+
+	if (info->maps || size < 2 * sizeof(unsigned long))
+		return;
+
+	memcpy(&count, desc, sizeof(count));
+	memcpy(&page_size, desc + sizeof(count), sizeof(page_size));
+	if (count == 0 || count > (size / sizeof(unsigned long) - 2) / 3)
+		return;
+
+	entries = malloc(count * 3 * sizeof(unsigned long));
+	info->maps = calloc(count, sizeof(*info->maps));
+	info->map_names = malloc(size);
+	if (!entries || !info->maps || !info->map_names)
+		goto error;
+
+	memcpy(entries, desc + 2 * sizeof(unsigned long), count * 3 * sizeof(unsigned long));
+	memcpy(info->map_names, desc, size);
+	name = info->map_names + (2 + count * 3) * sizeof(unsigned long);
+	end = info->map_names + size;
+
+	for (i = 0; i < count; i++) {
+		const char *nul = memchr(name, '\0', end - name);
+
+		if (!nul)
+			goto error;
+
+		info->maps[i].start = entries[i * 3];
+		info->maps[i].end = entries[i * 3 + 1];
+		info->maps[i].offset = entries[i * 3 + 2] * page_size;
+		info->maps[i].path = name;
+		name = nul + 1;
+	}
+	info->n_maps = count;
+	free(entries);
+
+	return;
+
+error:
+	free(entries);
+	free(info->maps);
+	free(info->map_names);
+	info->maps = NULL;
+	info->map_names = NULL;
+}
+
+/*
+ * parse_note() - Parse a note of the core
+ *
+ * @info:	Crash to fill.
+ * @type:	Type of the note.
+ * @desc:	Descriptor of the note.
+ * @size:	Size of @desc.
+ *
+ * The first NT_PRSTATUS note belongs to the thread that crashed.
+ */
+static void parse_note(crash_info_t *info, ElfW(Word) type, const unsigned char *desc, size_t size)
+{
+	switch (type) {
+	case NT_PRSTATUS:
+	{
+		struct elf_prstatus status;
+
+		if (info->has_regs || size < sizeof(status))
+			break;
+		memcpy(&status, desc, sizeof(status));
+		if (info->signal <= 0)
+			info->signal = status.pr_cursig;
+		if (info->pid <= 0)
+			info->pid = status.pr_pid;
+#ifdef CORE_REG_PC
+		info->pc = (unsigned long) status.pr_reg[CORE_REG_PC];
+		info->sp = (unsigned long) status.pr_reg[CORE_REG_SP];
+#ifdef CORE_REG_FP
+		info->fp = (unsigned long) status.pr_reg[CORE_REG_FP];
+#endif
+#ifdef CORE_REG_LR
+		info->lr = (unsigned long) status.pr_reg[CORE_REG_LR];
+#endif
+		info->has_regs = true;
+#endif /* CORE_REG_PC */
+		break;
+	}
+	case NT_PRPSINFO:
+	{
+		struct elf_prpsinfo ps;
+		size_t i;
+
+		if (size < sizeof(ps))
+			break;
+		memcpy(&ps, desc, sizeof(ps));
+		if (info->name[0] == '\0')
+			strncpy(info->name, ps.pr_fname, MIN(sizeof(ps.pr_fname), sizeof(info->name) - 1));
+		strncpy(info->args, ps.pr_psargs, MIN(sizeof(ps.pr_psargs), sizeof(info->args) - 1));
+		for (i = strlen(info->args); i > 0 && info->args[i - 1] == ' '; i--)
+			info->args[i - 1] = '\0';
+		break;
+	}
+	case NT_FILE:
+		parse_file_note(info, desc, size);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * parse_notes() - Parse the notes of the core and locate the crashed stack
+ *
+ * @info:	Crash to fill.
+ */
+static void parse_notes(crash_info_t *info)
+{
+	size_t i;
+
+	for (i = 0; i < info->n_phdrs; i++) {
+		const ElfW(Phdr) *ph = &info->phdrs[i];
+		size_t pos, end;
+
+		if (ph->p_type != PT_NOTE || ph->p_offset + ph->p_filesz > info->head_len)
+			continue;
+
+		pos = ph->p_offset;
+		end = ph->p_offset + ph->p_filesz;
+		while (end - pos >= sizeof(ElfW(Nhdr))) {
+			ElfW(Nhdr) nh;
+			size_t name_off, desc_off;
+
+			memcpy(&nh, info->head + pos, sizeof(nh));
+			name_off = pos + sizeof(nh);
+			if (ALIGN4(nh.n_namesz) > end - name_off)
+				break;
+			desc_off = name_off + ALIGN4(nh.n_namesz);
+			if (ALIGN4(nh.n_descsz) > end - desc_off)
+				break;
+
+			if (nh.n_namesz == sizeof("CORE") && memcmp(info->head + name_off, "CORE", sizeof("CORE")) == 0)
+				parse_note(info, nh.n_type, info->head + desc_off, nh.n_descsz);
+
+			pos = desc_off + ALIGN4(nh.n_descsz);
+		}
+	}
+
+	if (!info->has_regs)
+		return;
+
+	/* Keep the top of the stack of the crashed thread to unwind it */
+	for (i = 0; i < info->n_phdrs; i++) {
+		const ElfW(Phdr) *ph = &info->phdrs[i];
+
+		if (ph->p_type != PT_LOAD || info->sp < ph->p_vaddr
+			|| info->sp - ph->p_vaddr >= ph->p_filesz)
+			continue;
+
+		info->stack_off = ph->p_offset + (info->sp - ph->p_vaddr);
+		info->stack_size = MIN(STACK_CAPTURE_SIZE, ph->p_filesz - (info->sp - ph->p_vaddr));
+		info->stack = malloc(info->stack_size);
+		if (!info->stack)
+			info->stack_size = 0;
+		break;
+	}
+}
+
+/*
+ * grow_head() - Require more bytes of the beginning of the core
+ *
+ * @info:	Crash being captured.
+ * @need:	Number of bytes required.
+ *
+ * Return: 0 on success, -1 if too big or out of memory.
+ */
+static int grow_head(crash_info_t *info, size_t need)
+{
+	unsigned char *head;
+
+	if (need > MAX_NOTES_SIZE)
+		return -1;
+	if (need <= info->head_need)
+		return 0;
+
+	head = realloc(info->head, need);
+	if (!head)
+		return -1;
+
+	info->head = head;
+	info->head_need = need;
+
+	return 0;
+}
+
+/*
+ * advance_head() - Analyze the beginning of the core once enough is read
+ *
+ * @info:	Crash being captured.
+ *
+ * The ELF header locates the program headers, and these the notes.
+ */
+static void advance_head(crash_info_t *info)
+{
+	ElfW(Ehdr) ehdr;
+	size_t i, need = 0;
+
+	switch (info->head_stage) {
+	case 0:
+		memcpy(&ehdr, info->head, sizeof(ehdr));
+		if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+			|| ehdr.e_ident[EI_CLASS] != NATIVE_ELFCLASS
+			|| ehdr.e_type != ET_CORE
+			|| ehdr.e_phentsize != sizeof(ElfW(Phdr))
+			|| ehdr.e_phnum == 0 || ehdr.e_phnum == PN_XNUM
+			|| grow_head(info, ehdr.e_phoff + ehdr.e_phnum * sizeof(ElfW(Phdr))) != 0)
+			goto done;
+		info->n_phdrs = ehdr.e_phnum;
+		info->head_stage = 1;
+		break;
+	case 1:
+		info->phdrs = malloc(info->n_phdrs * sizeof(ElfW(Phdr)));
+		if (!info->phdrs)
+			goto done;
+		memcpy(info->phdrs, info->head + info->head_len - info->n_phdrs * sizeof(ElfW(Phdr)),
+			info->n_phdrs * sizeof(ElfW(Phdr)));
+		for (i = 0; i < info->n_phdrs; i++) {
+			if (info->phdrs[i].p_type == PT_NOTE)
+				need = MAX(need, info->phdrs[i].p_offset + info->phdrs[i].p_filesz);
+		}
+		/* Notes that do not fit are ignored */
+		if (need > MAX_NOTES_SIZE)
+			need = 0;
+		info->head_stage = 2;
+		if (need > info->head_len) {
+			if (grow_head(info, need) != 0)
+				goto done;
+			break;
+		}
+		/* Fall through */
+	case 2:
+		parse_notes(info);
+		goto done;
+	}
+
+	return;
+
+done:
+	info->head_done = true;
+}
+
+/*
+ * analyze_core() - Analyze a chunk of the core being captured
+ *
+ * @info:	Crash being captured.
+ * @data:	Chunk of the core.
+ * @len:	Bytes in @data.
+ *
+ * Keeps the headers and notes of the core and the top of the stack of the
+ * crashed thread.
+ */
+static void analyze_core(crash_info_t *info, const unsigned char *data, size_t len)
+{
+	uint64_t off = info->raw_size;
+
+	while (!info->head_done && off + len > info->head_len) {
+		size_t from = info->head_len - off;
+		size_t n = MIN(len - from, info->head_need - info->head_len);
+
+		memcpy(info->head + info->head_len, data + from, n);
+		info->head_len += n;
+		if (info->head_len == info->head_need)
+			advance_head(info);
+	}
+
+	if (info->stack_size > 0 && off + len > info->stack_off
+		&& off < info->stack_off + info->stack_size) {
+		uint64_t from = MAX(off, info->stack_off);
+		uint64_t to = MIN(off + len, info->stack_off + info->stack_size);
+
+		memcpy(info->stack + (from - info->stack_off), data + (from - off), to - from);
+		info->stack_len = to - info->stack_off;
+	}
+
+	info->raw_size += len;
+}
+
+/*
+ * write_all() - Write a buffer to a file
+ *
+ * @fd:		File descriptor.
+ * @data:	Data to write.
+ * @len:	Bytes in @data.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int write_all(int fd, const unsigned char *data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = write(fd, data, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * compress_data() - Compress data into a core file
+ *
+ * @zs:		Compression stream, writing to @out.
+ * @out:	Output buffer of CHUNK_SIZE bytes.
+ * @out_fd:	File descriptor of the compressed core.
+ * @info:	Crash being captured.
+ * @data:	Data to compress.
+ * @len:	Bytes in @data.
+ * @flush:	Deflate flush mode, Z_SYNC_FLUSH to compress all pending data.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int compress_data(z_stream *zs, unsigned char *out, int out_fd, crash_info_t *info,
+	unsigned char *data, size_t len, int flush)
+{
+	bool full;
+
+	zs->next_in = data;
+	zs->avail_in = len;
+	for (;;) {
+		if (deflate(zs, flush) == Z_STREAM_ERROR) {
+			errno = EINVAL;
+			return -1;
+		}
+		full = zs->avail_out == 0;
+		if (full) {
+			if (write_all(out_fd, out, CHUNK_SIZE) != 0)
+				return -1;
+			info->stored_size += CHUNK_SIZE;
+			zs->next_out = out;
+			zs->avail_out = CHUNK_SIZE;
+		}
+		/* A full buffer might leave flushed output in the stream */
+		if (zs->avail_in == 0 && (flush == Z_NO_FLUSH || !full))
+			return 0;
+	}
+}
+
+/*
+ * store_core() - Read, analyze and compress a core
+ *
+ * @fd:		File descriptor to read the core from.
+ * @info:	Crash being captured.
+ * @path:	File to store the compressed core, NULL to only analyze it.
+ * @max_size:	Approximate maximum size of the compressed core.
+ *
+ * The core is read until the end even if it is truncated, so the stack of
+ * the crashed thread can be analyzed.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int store_core(int fd, crash_info_t *info, const char *path, uint64_t max_size)
+{
+	unsigned char *in = malloc(CHUNK_SIZE), *out = NULL;
+	bool compress = path != NULL && max_size > 0;
+	int out_fd = -1, ret = -1, zret;
+	z_stream zs;
+
+	memset(&zs, 0, sizeof(zs));
+
+	if (!in)
+		goto done;
+
+	info->head_need = sizeof(ElfW(Ehdr));
+	info->head = malloc(info->head_need);
+	if (!info->head)
+		info->head_done = true;
+
+	if (compress) {
+		out = malloc(CHUNK_SIZE);
+		out_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+		/* 15 + 16: gzip format with the maximum window */
+		if (!out || out_fd < 0 || deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED,
+				15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			log_crash_error("Unable to store core '%s': %s (%d)", path, strerror(errno), errno);
+			if (out_fd >= 0)
+				close(out_fd);
+			out_fd = -1;
+			compress = false;
+		} else {
+			zs.next_out = out;
+			zs.avail_out = CHUNK_SIZE;
+		}
+	}
+
+	for (;;) {
+		ssize_t n = read(fd, in, CHUNK_SIZE);
+		unsigned char *data;
+		size_t len, left;
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			log_crash_error("Unable to read core: %s (%d)", strerror(errno), errno);
+			goto done;
+		}
+		if (n == 0)
+			break;
+
+		analyze_core(info, in, n);
+
+		if (!compress || info->truncated)
+			continue;
+
+		for (data = in, left = n; left > 0; data += len, left -= len) {
+			len = left;
+			if (zs.total_out + len + GZIP_MARGIN > max_size) {
+				uint64_t room;
+
+				/*
+				 * Near the size cap, flush so the output accounts
+				 * for all the input, and only compress what fits
+				 */
+				if (compress_data(&zs, out, out_fd, info, NULL, 0, Z_SYNC_FLUSH) != 0)
+					goto write_error;
+				room = max_size > zs.total_out + GZIP_MARGIN ?
+					max_size - zs.total_out - GZIP_MARGIN : 0;
+				if (room < GZIP_MARGIN) {
+					info->truncated = true;
+					break;
+				}
+				if (len > room)
+					len = room;
+			}
+			if (compress_data(&zs, out, out_fd, info, data, len, Z_NO_FLUSH) != 0)
+				goto write_error;
+		}
+	}
+
+	if (compress) {
+		do {
+			zret = deflate(&zs, Z_FINISH);
+			if (zret == Z_STREAM_ERROR)
+				goto done;
+			if (write_all(out_fd, out, CHUNK_SIZE - zs.avail_out) != 0)
+				goto write_error;
+			info->stored_size += CHUNK_SIZE - zs.avail_out;
+			zs.next_out = out;
+			zs.avail_out = CHUNK_SIZE;
+		} while (zret != Z_STREAM_END);
+
+		if (fsync(out_fd) != 0)
+			goto write_error;
+	}
+
+	ret = 0;
+	goto done;
+
+write_error:
+	log_crash_error("Unable to store core '%s': %s (%d)", path, strerror(errno), errno);
+
+done:
+	if (compress)
+		deflateEnd(&zs);
+	if (out_fd >= 0)
+		close(out_fd);
+	free(in);
+	free(out);
+
+	return ret;
+}
+
+/*
+ * is_code() - Check if an address is in an executable mapping of the crash
+ *
+ * @info:	Crash.
+ * @addr:	Address to check.
+ *
+ * Return: True if @addr is executable.
+ */
+static bool is_code(const crash_info_t *info, unsigned long addr)
+{
+	size_t i;
+
+	for (i = 0; i < info->n_phdrs; i++) {
+		const ElfW(Phdr) *ph = &info->phdrs[i];
+
+		if (ph->p_type == PT_LOAD && (ph->p_flags & PF_X)
+			&& addr >= ph->p_vaddr && addr - ph->p_vaddr < ph->p_memsz)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * read_stack() - Read a word of the captured stack
+ *
+ * @info:	Crash.
+ * @addr:	Address of the word.
+ * @value:	Where to store the word.
+ *
+ * Return: True if @addr is in the captured stack.
+ */
+static bool read_stack(const crash_info_t *info, unsigned long addr, unsigned long *value)
+{
+	if (addr < info->sp || addr - info->sp > info->stack_len
+		|| info->stack_len - (addr - info->sp) < sizeof(*value))
+		return false;
+
+	memcpy(value, info->stack + (addr - info->sp), sizeof(*value));
+
+	return true;
+}
+
+/*
+ * add_frame() - Add a return address to a backtrace
+ *
+ * @frames:	Backtrace.
+ * @n:		Number of frames in @frames, updated.
+ * @addr:	Address to add.
+ */
+static void add_frame(unsigned long *frames, unsigned int *n, unsigned long addr)
+{
+	if (*n < MAX_FRAMES && addr != 0 && (*n == 0 || frames[*n - 1] != addr))
+		frames[(*n)++] = addr;
+}
+
+/*
+ * unwind_stack() - Get the backtrace of the crashed thread
+ *
+ * @info:	Crash.
+ * @frames:	Array of MAX_FRAMES to store the addresses.
+ * @first_scanned:	Index of the first frame found by scanning the stack.
+ *
+ * Frame pointers are followed when the architecture uses them. If they do
+ * not give a meaningful backtrace, the stack is scanned for return addresses,
+ * that may include stale ones.
+ *
+ * Return: Number of frames.
+ */
+static unsigned int unwind_stack(const crash_info_t *info, unsigned long *frames,
+	unsigned int *first_scanned)
+{
+	unsigned long addr, value;
+	unsigned int n = 0;
+
+	add_frame(frames, &n, info->pc);
+#ifdef CORE_REG_LR
+	if (is_code(info, info->lr))
+		add_frame(frames, &n, info->lr);
+#endif
+#ifdef CORE_REG_FP
+	addr = info->fp;
+	while (n < MAX_FRAMES && addr % sizeof(unsigned long) == 0) {
+		unsigned long next;
+
+		if (!read_stack(info, addr, &next)
+			|| !read_stack(info, addr + sizeof(unsigned long), &value)
+			|| !is_code(info, value))
+			break;
+		add_frame(frames, &n, value);
+		if (next <= addr)
+			break;
+		addr = next;
+	}
+#endif
+	*first_scanned = n;
+	if (n > 2)
+		return n;
+
+	for (addr = info->sp; n < MAX_FRAMES && read_stack(info, addr, &value);
+		addr += sizeof(unsigned long)) {
+		if (is_code(info, value))
+			add_frame(frames, &n, value);
+	}
+
+	return n;
+}
+
+/*
+ * read_table() - Read a section of an ELF file
+ *
+ * @fd:		File descriptor of the ELF file.
+ * @sh:		Section header.
+ *
+ * Return: The allocated section contents, NULL on error.
+ */
+static void *read_table(int fd, const ElfW(Shdr) *sh)
+{
+	void *data;
+
+	if (sh->sh_size == 0 || sh->sh_size > MAX_SYMTAB_SIZE)
+		return NULL;
+
+	data = malloc(sh->sh_size);
+	if (data && pread(fd, data, sh->sh_size, sh->sh_offset) != (ssize_t) sh->sh_size) {
+		free(data);
+		data = NULL;
+	}
+
+	return data;
+}
+
+/*
+ * lookup_symbol() - Find the function containing an offset of an ELF file
+ *
+ * @path:	Path of the ELF file.
+ * @file_off:	Offset in the file.
+ * @name:	Buffer to store the function name.
+ * @size:	Size of @name.
+ * @sym_off:	Offset of @file_off from the function start.
+ *
+ * The symbol table is used if the file is not stripped, the dynamic symbol
+ * table otherwise.
+ *
+ * Return: 0 if found, -1 otherwise.
+ */
+static int lookup_symbol(const char *path, unsigned long file_off, char *name, size_t size,
+	unsigned long *sym_off)
+{
+	ElfW(Ehdr) ehdr;
+	ElfW(Phdr) ph;
+	ElfW(Shdr) *shdrs = NULL;
+	unsigned long vaddr = 0;
+	bool mapped = false;
+	int fd, pass, ret = -1;
+	size_t i;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr)
+		|| memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+		|| ehdr.e_ident[EI_CLASS] != NATIVE_ELFCLASS
+		|| ehdr.e_phentsize != sizeof(ElfW(Phdr))
+		|| ehdr.e_shentsize != sizeof(ElfW(Shdr)) || ehdr.e_shnum == 0)
+		goto done;
+
+	/* Translate the file offset to the address used by the symbols */
+	for (i = 0; i < ehdr.e_phnum && !mapped; i++) {
+		if (pread(fd, &ph, sizeof(ph), ehdr.e_phoff + i * sizeof(ph)) != sizeof(ph))
+			goto done;
+		if (ph.p_type == PT_LOAD && file_off >= ph.p_offset && file_off - ph.p_offset < ph.p_filesz) {
+			vaddr = file_off - ph.p_offset + ph.p_vaddr;
+			mapped = true;
+		}
+	}
+	if (!mapped)
+		goto done;
+
+	shdrs = malloc(ehdr.e_shnum * sizeof(ElfW(Shdr)));
+	if (!shdrs || pread(fd, shdrs, ehdr.e_shnum * sizeof(ElfW(Shdr)), ehdr.e_shoff)
+			!= (ssize_t) (ehdr.e_shnum * sizeof(ElfW(Shdr))))
+		goto done;
+
+	for (pass = 0; pass < 2 && ret != 0; pass++) {
+		ElfW(Word) type = pass == 0 ? SHT_SYMTAB : SHT_DYNSYM;
+
+		for (i = 0; i < ehdr.e_shnum && ret != 0; i++) {
+			const ElfW(Shdr) *sh = &shdrs[i];
+			ElfW(Sym) *syms;
+			char *strs;
+			size_t j, n_syms, best = 0;
+			bool found = false;
+
+			if (sh->sh_type != type || sh->sh_link >= ehdr.e_shnum)
+				continue;
+
+			syms = read_table(fd, sh);
+			strs = read_table(fd, &shdrs[sh->sh_link]);
+			n_syms = sh->sh_size / sizeof(ElfW(Sym));
+			for (j = 0; syms && strs && j < n_syms; j++) {
+				const ElfW(Sym) *s = &syms[j];
+
+				if (NATIVE_ST_TYPE(s->st_info) != STT_FUNC || s->st_value > vaddr
+					|| vaddr - s->st_value >= MAX(s->st_size, 1)
+					|| s->st_name >= shdrs[sh->sh_link].sh_size)
+					continue;
+				if (!found || s->st_value > syms[best].st_value) {
+					best = j;
+					found = true;
+				}
+			}
+			if (found) {
+				strs[shdrs[sh->sh_link].sh_size - 1] = '\0';
+				snprintf(name, size, "%s", strs + syms[best].st_name);
+				*sym_off = vaddr - syms[best].st_value;
+				ret = 0;
+			}
+			free(syms);
+			free(strs);
+		}
+	}
+
+done:
+	free(shdrs);
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * find_map() - Find the file mapping containing an address
+ *
+ * @info:	Crash.
+ * @addr:	Address to look for.
+ *
+ * Return: The mapping, NULL if the address is not in a mapped file.
+ */
+static const crash_map_t *find_map(const crash_info_t *info, unsigned long addr)
+{
+	size_t i;
+
+	for (i = 0; i < info->n_maps; i++) {
+		if (addr >= info->maps[i].start && addr < info->maps[i].end)
+			return &info->maps[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * describe_frame() - Describe a frame of the backtrace
+ *
+ * @info:	Crash.
+ * @index:	Index of the frame.
+ * @addr:	Address of the frame.
+ * @scanned:	True if the frame was found scanning the stack.
+ * @buf:	Buffer to store the description.
+ * @size:	Size of @buf.
+ *
+ * Format: '#<index> 0x<addr> <function>+0x<offset> (<file>)', or
+ * '#<index> 0x<addr> (<file>+0x<file offset>)' without symbols. Frames found
+ * scanning the stack are marked with '?'.
+ */
+static void describe_frame(const crash_info_t *info, unsigned int index, unsigned long addr,
+	bool scanned, char *buf, size_t size)
+{
+	const crash_map_t *map = find_map(info, addr);
+	char symbol[MAX_SYMBOL_LEN];
+	unsigned long file_off, sym_off;
+	const char *file;
+	int len;
+
+	len = snprintf(buf, size, "#%u%s 0x%0*lx", index, scanned ? "?" : "",
+		(int) (2 * sizeof(unsigned long)), addr);
+	if (len < 0 || (size_t) len >= size || !map)
+		return;
+
+	file_off = addr - map->start + map->offset;
+	file = strrchr(map->path, '/');
+	file = file ? file + 1 : map->path;
+
+	/* Return addresses point after the call */
+	if (lookup_symbol(map->path, index > 0 ? file_off - 1 : file_off,
+			symbol, sizeof(symbol), &sym_off) == 0)
+		snprintf(buf + len, size - len, " %s+0x%lx (%s)", symbol,
+			index > 0 ? sym_off + 1 : sym_off, file);
+	else
+		snprintf(buf + len, size - len, " (%s+0x%lx)", file, file_off);
+}
+
+/*
+ * read_build_id() - Read the GNU build ID of an ELF file
+ *
+ * @path:	Path of the ELF file.
+ * @buf:	Buffer to store the build ID in hexadecimal.
+ * @size:	Size of @buf.
+ *
+ * Return: 0 on success, -1 if not found.
+ */
+static int read_build_id(const char *path, char *buf, size_t size)
+{
+	unsigned char *notes = NULL;
+	ElfW(Ehdr) ehdr;
+	ElfW(Phdr) ph;
+	int fd, ret = -1;
+	size_t i;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr)
+		|| memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+		|| ehdr.e_ident[EI_CLASS] != NATIVE_ELFCLASS
+		|| ehdr.e_phentsize != sizeof(ElfW(Phdr)))
+		goto done;
+
+	for (i = 0; i < ehdr.e_phnum && ret != 0; i++) {
+		size_t pos = 0;
+
+		if (pread(fd, &ph, sizeof(ph), ehdr.e_phoff + i * sizeof(ph)) != sizeof(ph))
+			break;
+		if (ph.p_type != PT_NOTE || ph.p_filesz == 0 || ph.p_filesz > MAX_NOTES_SIZE)
+			continue;
+
+		free(notes);
+		notes = malloc(ph.p_filesz);
+		if (!notes || pread(fd, notes, ph.p_filesz, ph.p_offset) != (ssize_t) ph.p_filesz)
+			break;
+
+		while (ph.p_filesz - pos >= sizeof(ElfW(Nhdr))) {
+			ElfW(Nhdr) nh;
+			size_t name_off, desc_off, j;
+
+			memcpy(&nh, notes + pos, sizeof(nh));
+			name_off = pos + sizeof(nh);
+			if (ALIGN4(nh.n_namesz) > ph.p_filesz - name_off)
+				break;
+			desc_off = name_off + ALIGN4(nh.n_namesz);
+			if (ALIGN4(nh.n_descsz) > ph.p_filesz - desc_off)
+				break;
+
+			if (nh.n_type == NT_GNU_BUILD_ID && nh.n_namesz == sizeof(ELF_NOTE_GNU)
+				&& memcmp(notes + name_off, ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)) == 0
+				&& nh.n_descsz > 0 && 2 * nh.n_descsz < size) {
+				for (j = 0; j < nh.n_descsz; j++)
+					sprintf(buf + 2 * j, "%02x", notes[desc_off + j]);
+				ret = 0;
+				break;
+			}
+
+			pos = desc_off + ALIGN4(nh.n_descsz);
+		}
+	}
+
+done:
+	free(notes);
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * find_exe() - Guess the crashed binary from the mapped files
+ *
+ * @info:	Crash to fill.
+ *
+ * The binary is the mapped file whose name starts with the process name,
+ * which is truncated by the kernel, or the first mapped file.
+ */
+static void find_exe(crash_info_t *info)
+{
+	size_t i;
+
+	if (info->exe[0] != '\0' || info->n_maps == 0)
+		return;
+
+	for (i = 0; i < info->n_maps; i++) {
+		const char *file = strrchr(info->maps[i].path, '/');
+
+		file = file ? file + 1 : info->maps[i].path;
+		if (info->name[0] != '\0' && strncmp(file, info->name, strlen(info->name)) == 0)
+			break;
+	}
+
+	snprintf(info->exe, sizeof(info->exe), "%s", info->maps[i < info->n_maps ? i : 0].path);
+}
+
+/*
+ * build_metadata() - Build the JSON metadata of a crash
+ *
+ * @info:	Analyzed crash.
+ *
+ * Return: The metadata object, NULL if out of memory.
+ */
+static json_object *build_metadata(crash_info_t *info)
+{
+	json_object *meta = json_object_new_object();
+	json_object *backtrace = json_object_new_array();
+	char build_id[2 * MAX_BUILD_ID + 1], frame[MAX_FRAME_LEN];
+	unsigned long frames[MAX_FRAMES];
+	unsigned int i, n = 0, first_scanned = 0;
+	const char *sig_name = strsignal(info->signal);
+
+	if (!meta || !backtrace)
+		goto error;
+
+	find_exe(info);
+
+	if (json_object_object_add(meta, "name", json_object_new_string(info->name)) < 0
+		|| json_object_object_add(meta, "binary", json_object_new_string(info->exe)) < 0
+		|| json_object_object_add(meta, "pid", json_object_new_int(info->pid)) < 0
+		|| json_object_object_add(meta, "signal", json_object_new_int(info->signal)) < 0
+		|| json_object_object_add(meta, "signal_name", json_object_new_string(sig_name ? sig_name : "")) < 0
+		|| json_object_object_add(meta, "time", json_object_new_int64(info->time)) < 0
+		|| json_object_object_add(meta, "core_size", json_object_new_int64(info->raw_size)) < 0
+		|| json_object_object_add(meta, "core_stored_size", json_object_new_int64(info->stored_size)) < 0
+		|| json_object_object_add(meta, "core_truncated", json_object_new_boolean(info->truncated)) < 0)
+		goto error;
+
+	if (info->args[0] != '\0'
+		&& json_object_object_add(meta, "args", json_object_new_string(info->args)) < 0)
+		goto error;
+	if (info->exe[0] != '\0' && read_build_id(info->exe, build_id, sizeof(build_id)) == 0
+		&& json_object_object_add(meta, "build_id", json_object_new_string(build_id)) < 0)
+		goto error;
+	if (info->uptime >= 0
+		&& json_object_object_add(meta, "uptime", json_object_new_int64(info->uptime)) < 0)
+		goto error;
+	if (info->process_uptime >= 0
+		&& json_object_object_add(meta, "process_uptime", json_object_new_int64(info->process_uptime)) < 0)
+		goto error;
+
+	if (info->has_regs)
+		n = unwind_stack(info, frames, &first_scanned);
+	for (i = 0; i < n; i++) {
+		describe_frame(info, i, frames[i], i >= first_scanned, frame, sizeof(frame));
+		if (json_object_array_add(backtrace, json_object_new_string(frame)) < 0)
+			goto error;
+	}
+	if (json_object_object_add(meta, "backtrace", backtrace) < 0)
+		goto error;
+
+	return meta;
+
+error:
+	json_object_put(backtrace);
+	json_object_put(meta);
+
+	return NULL;
+}
+
+/*
+ * free_crash_info() - Free the analysis data of a crash
+ *
+ * @info:	Crash.
+ */
+static void free_crash_info(crash_info_t *info)
+{
+	free(info->head);
+	free(info->phdrs);
+	free(info->maps);
+	free(info->map_names);
+	free(info->stack);
+}
+
+/*
+ * compare_names() - Compare two crash base names for sorting
+ *
+ * @a:	Pointer to the first name.
+ * @b:	Pointer to the second name.
+ *
+ * Return: Result of comparing the names, oldest crashes first.
+ */
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/*
+ * list_crashes() - List the captured crashes, oldest first
+ *
+ * @dir:	Crash capture directory.
+ * @names:	Where to store the allocated array of base names.
+ *
+ * Return: Number of crashes, -1 on error.
+ */
+static int list_crashes(const char *dir, char ***names)
+{
+	DIR *d = opendir(dir);
+	struct dirent *entry;
+	char **list = NULL;
+	int n = 0;
+
+	*names = NULL;
+	if (!d)
+		return errno == ENOENT ? 0 : -1;
+
+	while ((entry = readdir(d)) != NULL) {
+		size_t len = strlen(entry->d_name);
+		char **tmp;
+
+		if (!has_suffix(entry->d_name, META_EXT))
+			continue;
+
+		tmp = realloc(list, (n + 1) * sizeof(*list));
+		if (!tmp)
+			break;
+		list = tmp;
+		list[n] = strndup(entry->d_name, len - strlen(META_EXT));
+		if (!list[n])
+			break;
+		n++;
+	}
+	closedir(d);
+
+	if (n > 0)
+		qsort(list, n, sizeof(*list), compare_names);
+	*names = list;
+
+	return n;
+}
+
+/*
+ * free_names() - Free a list of crash base names
+ *
+ * @names:	List to free.
+ * @n:		Number of names.
+ */
+static void free_names(char **names, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		free(names[i]);
+	free(names);
+}
+
+/*
+ * remove_crash() - Remove the files of a captured crash
+ *
+ * @dir:	Crash capture directory.
+ * @base:	Base name of the crash.
+ */
+static void remove_crash(const char *dir, const char *base)
+{
+	char path[PATH_MAX];
+
+	if (build_path(path, sizeof(path), dir, base, CORE_EXT) == 0)
+		unlink(path);
+	if (build_path(path, sizeof(path), dir, base, META_EXT) == 0)
+		unlink(path);
+}
+
+/*
+ * apply_retention() - Remove the oldest crashes over the retention limits
+ *
+ * @s:		Crash capture settings.
+ */
+static void apply_retention(const crash_settings_t *s)
+{
+	uint64_t total = 0, *sizes;
+	char **names, path[PATH_MAX];
+	struct stat st;
+	int i, n;
+
+	n = list_crashes(s->path, &names);
+	if (n <= 0)
+		return;
+
+	sizes = calloc(n, sizeof(*sizes));
+	if (!sizes) {
+		free_names(names, n);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (build_path(path, sizeof(path), s->path, names[i], CORE_EXT) == 0 && stat(path, &st) == 0)
+			sizes[i] += st.st_size;
+		if (build_path(path, sizeof(path), s->path, names[i], META_EXT) == 0 && stat(path, &st) == 0)
+			sizes[i] += st.st_size;
+		total += sizes[i];
+	}
+
+	/* The newest crash is always kept */
+	for (i = 0; i < n - 1 && ((unsigned int) (n - i) > s->max_stored || total > s->max_stored_size); i++) {
+		log_crash_info("Removing crash '%s' over the retention limits", names[i]);
+		remove_crash(s->path, names[i]);
+		total -= sizes[i];
+	}
+
+	free(sizes);
+	free_names(names, n);
+}
+
+/*
+ * save_crash() - Capture a crash from a core
+ *
+ * @s:		Crash capture settings.
+ * @fd:		File descriptor to read the core from.
+ * @info:	Crash, with the information known before reading the core.
+ *
+ * Stores the compressed core '<time>-<pid>-<name>.core.gz' and its metadata
+ * '<time>-<pid>-<name>.json' in the crash capture directory. The core is
+ * stored with a temporary name until its notes provide the process name and
+ * PID. The metadata is written last, so a crash is complete once its metadata
+ * exists.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int save_crash(const crash_settings_t *s, int fd, crash_info_t *info)
+{
+	char base[NAME_MAX - sizeof(CORE_EXT TMP_EXT)], core[PATH_MAX], meta[PATH_MAX];
+	char core_tmp[PATH_MAX], meta_tmp[PATH_MAX];
+	json_object *json = NULL;
+	bool stored = false;
+	int i, ret = -1;
+
+	if (mkpath(s->path, 0700) != 0 && errno != EEXIST) {
+		log_crash_error("Unable to create directory '%s': %s (%d)", s->path, strerror(errno), errno);
+		store_core(fd, info, NULL, 0);
+		goto done;
+	}
+
+	snprintf(base, sizeof(base), "capture-%d", getpid());
+	if (build_path(core_tmp, sizeof(core_tmp), s->path, base, CORE_EXT TMP_EXT) != 0) {
+		store_core(fd, info, NULL, 0);
+		goto done;
+	}
+
+	stored = store_core(fd, info, s->max_core > 0 ? core_tmp : NULL, s->max_core) == 0 && s->max_core > 0;
+
+	snprintf(base, sizeof(base), "%010lld-%d-%s", (long long) info->time, info->pid,
+		info->name[0] != '\0' ? info->name : "unknown");
+	/* Only keep safe characters of the process name */
+	for (i = 0; base[i] != '\0'; i++) {
+		if (!isalnum((unsigned char) base[i]) && base[i] != '-' && base[i] != '_' && base[i] != '.')
+			base[i] = '_';
+	}
+
+	if (build_path(core, sizeof(core), s->path, base, CORE_EXT) != 0
+		|| build_path(meta, sizeof(meta), s->path, base, META_EXT) != 0
+		|| build_path(meta_tmp, sizeof(meta_tmp), s->path, base, META_EXT TMP_EXT) != 0) {
+		unlink(core_tmp);
+		goto done;
+	}
+
+	if (stored)
+		stored = rename(core_tmp, core) == 0;
+	if (!stored) {
+		unlink(core_tmp);
+		info->stored_size = 0;
+	}
+
+	json = build_metadata(info);
+	if (!json) {
+		log_crash_error("Unable to store crash '%s': %s", base, "Out of memory");
+		goto error;
+	}
+	if (json_object_to_file(meta_tmp, json) != 0 || rename(meta_tmp, meta) != 0) {
+		log_crash_error("Unable to store crash '%s': %s (%d)", base, strerror(errno), errno);
+		unlink(meta_tmp);
+		goto error;
+	}
+
+	log_crash_info("Captured crash of '%s' (pid %d, signal %d): %llu bytes, %llu compressed%s",
+		info->name, info->pid, info->signal, (unsigned long long) info->raw_size,
+		(unsigned long long) info->stored_size, info->truncated ? ", truncated" : "");
+	ret = 0;
+	goto done;
+
+error:
+	if (stored)
+		unlink(core);
+
+done:
+	json_object_put(json);
+	if (ret == 0)
+		apply_retention(s);
+
+	return ret;
+}
+
+int handle_crash(const char *config_file, int argc, char *argv[])
+{
+	cc_cfg_t *cfg = NULL;
+	crash_settings_t s;
+	crash_info_t info;
+	int ret = 1;
+
+	memset(&info, 0, sizeof(info));
+	memset(&s, 0, sizeof(s));
+	info.uptime = -1;
+	info.process_uptime = -1;
+
+	if (argc < 3) {
+		log_crash_error("Invalid core dump handler arguments: %d", argc);
+		goto done;
+	}
+
+	info.pid = (pid_t) strtol(argv[0], NULL, 10);
+	info.signal = (int) strtol(argv[1], NULL, 10);
+	info.time = (time_t) strtoll(argv[2], NULL, 10);
+	if (argc > 3)
+		strncpy(info.name, argv[3], sizeof(info.name) - 1);
+
+	/* The process disappears once its core is read */
+	read_process_info(&info);
+
+	cfg = calloc(1, sizeof(*cfg));
+	if (!cfg || parse_configuration(config_file ? config_file : DEFAULT_CONFIG_FILE, cfg) != 0) {
+		log_crash_error("Unable to capture crash of pid %d: %s", info.pid, "Invalid configuration");
+		goto discard;
+	}
+	set_log_level(cfg->log_level);
+
+	if (!(cfg->services & CRASH_CAPTURE_SERVICE)) {
+		ret = 0;
+		goto discard;
+	}
+
+	if (get_settings(cfg, &s) != 0) {
+		log_crash_error("Unable to capture crash of pid %d: %s", info.pid, "Out of memory");
+		goto discard;
+	}
+
+	ret = save_crash(&s, STDIN_FILENO, &info) == 0 ? 0 : 1;
+	goto done;
+
+discard:
+	/* Read the whole core so the kernel does not wait for the handler */
+	store_core(STDIN_FILENO, &info, NULL, 0);
+
+done:
+	free_crash_info(&info);
+	free(s.path);
+	free_configuration(cfg);
+
+	return ret;
+}
+
+/*
+ * consume_raw_cores() - Capture the core files written by the kernel
+ *
+ * @s:		Crash capture settings.
+ *
+ * Used when the daemon is not the core dump handler and 'core_pattern'
+ * writes the cores to the crash capture directory with 'core' name prefix.
+ */
+static void consume_raw_cores(const crash_settings_t *s)
+{
+	DIR *d = opendir(s->path);
+	struct dirent *entry;
+	time_t now = time(NULL);
+
+	if (!d)
+		return;
+
+	while (!stop_requested && (entry = readdir(d)) != NULL) {
+		char path[PATH_MAX];
+		crash_info_t info;
+		struct stat st;
+		int fd, len;
+
+		if (strncmp(entry->d_name, RAW_CORE_PREFIX, strlen(RAW_CORE_PREFIX)) != 0
+			|| has_suffix(entry->d_name, CORE_EXT) || has_suffix(entry->d_name, META_EXT)
+			|| has_suffix(entry->d_name, TMP_EXT))
+			continue;
+
+		len = snprintf(path, sizeof(path), "%s/%s", s->path, entry->d_name);
+		if (len < 0 || (size_t) len >= sizeof(path) || lstat(path, &st) != 0
+			|| !S_ISREG(st.st_mode) || now - st.st_mtime < RAW_CORE_SETTLE_SEC)
+			continue;
+
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		memset(&info, 0, sizeof(info));
+		info.uptime = -1;
+		info.process_uptime = -1;
+		info.time = st.st_mtime;
+
+		log_crash_debug("Consuming core file '%s'", path);
+		save_crash(s, fd, &info);
+		free_crash_info(&info);
+		close(fd);
+		unlink(path);
+	}
+
+	closedir(d);
+}
+
+/*
+ * remove_stale_files() - Remove captures interrupted long ago
+ *
+ * @s:		Crash capture settings.
+ */
+static void remove_stale_files(const crash_settings_t *s)
+{
+	DIR *d = opendir(s->path);
+	struct dirent *entry;
+	time_t now = time(NULL);
+
+	if (!d)
+		return;
+
+	while ((entry = readdir(d)) != NULL) {
+		char path[PATH_MAX];
+		struct stat st;
+		int len;
+
+		if (!has_suffix(entry->d_name, TMP_EXT))
+			continue;
+
+		len = snprintf(path, sizeof(path), "%s/%s", s->path, entry->d_name);
+		if (len > 0 && (size_t) len < sizeof(path) && stat(path, &st) == 0
+			&& now - st.st_mtime > STALE_TMP_SEC)
+			unlink(path);
+	}
+
+	closedir(d);
+}
+
+/*
+ * upload_file() - Upload a file to Remote Manager
+ *
+ * @path:	Local file to upload.
+ * @cloud_path:	Remote Manager file path.
+ *
+ * The first chunk overwrites any existing file, the rest are appended.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int upload_file(const char *path, const char *cloud_path)
+{
+	unsigned char *buf = malloc(CHUNK_SIZE);
+	bool first = true;
+	int fd, ret = -1;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || !buf)
+		goto done;
+
+	while (!stop_requested) {
+		ccapi_send_error_t error;
+		ccapi_string_info_t hint_info;
+		char hint[256];
+		ssize_t n = read(fd, buf, CHUNK_SIZE);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			goto done;
+		if (n == 0) {
+			ret = 0;
+			break;
+		}
+
+		hint[0] = '\0';
+		hint_info.length = sizeof(hint);
+		hint_info.string = hint;
+
+		error = ccapi_send_data_with_reply(CCAPI_TRANSPORT_TCP, cloud_path,
+			"application/gzip", buf, n,
+			first ? CCAPI_SEND_BEHAVIOR_OVERWRITE : CCAPI_SEND_BEHAVIOR_APPEND,
+			SEND_TIMEOUT_SEC, &hint_info);
+		if (error != CCAPI_SEND_ERROR_NONE) {
+			log_crash_error("Unable to upload '%s': error %d %s", cloud_path, error, hint);
+			goto done;
+		}
+		first = false;
+	}
+
+done:
+	if (fd >= 0)
+		close(fd);
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * upload_crash() - Upload a captured crash
+ *
+ * @s:		Crash capture settings.
+ * @base:	Base name of the crash.
+ *
+ * The core is uploaded first and removed, and the metadata updated with its
+ * Remote Manager path, so a failure sending the event does not upload it
+ * again.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int upload_crash(const crash_settings_t *s, const char *base)
+{
+	char core[PATH_MAX], meta[PATH_MAX], cloud_path[PATH_MAX];
+	json_object *json = NULL;
+	int ret = -1;
+
+	if (build_path(core, sizeof(core), s->path, base, CORE_EXT) != 0
+		|| build_path(meta, sizeof(meta), s->path, base, META_EXT) != 0
+		|| snprintf(cloud_path, sizeof(cloud_path), "%s/%s%s", CLOUD_DIR, base, CORE_EXT) >= (int) sizeof(cloud_path))
+		return -1;
+
+	json = json_object_from_file(meta);
+	if (!json || !json_object_is_type(json, json_type_object)) {
+		log_crash_error("Removing invalid crash '%s'", base);
+		remove_crash(s->path, base);
+		goto done;
+	}
+
+	if (access(core, F_OK) == 0) {
+		if (upload_file(core, cloud_path) != 0)
+			goto done;
+		unlink(core);
+		if (json_object_object_add(json, "core", json_object_new_string(cloud_path)) < 0
+			|| json_object_to_file(meta, json) != 0)
+			log_crash_error("Unable to update crash '%s'", base);
+	}
+
+	if (dp_send_json_event(DP_CRASH_STREAM_ID, json_object_to_json_string(json)) != 0) {
+		log_crash_error("Unable to send crash '%s' event", base);
+		goto done;
+	}
+
+	unlink(meta);
+	log_crash_info("Uploaded crash '%s'", base);
+	ret = 0;
+
+done:
+	json_object_put(json);
+
+	return ret;
+}
+
+/*
+ * upload_crashes() - Upload the captured crashes, oldest first
+ *
+ * @s:		Crash capture settings.
+ */
+static void upload_crashes(const crash_settings_t *s)
+{
+	char **names;
+	int i, n;
+
+	n = list_crashes(s->path, &names);
+	for (i = 0; i < n && !stop_requested; i++) {
+		if (upload_crash(s, names[i]) != 0)
+			break;
+	}
+
+	if (n > 0)
+		free_names(names, n);
+}
+
+/*
+ * crash_capture_threaded() - Upload captured crashes until stop is requested
+ *
+ * @unused:	Unused parameter.
+ */
+static void *crash_capture_threaded(void *unused)
+{
+	int elapsed_ms = SCAN_PERIOD_SEC * 1000;
+
+	UNUSED_ARGUMENT(unused);
+
+	while (!stop_requested) {
+		if (elapsed_ms >= SCAN_PERIOD_SEC * 1000) {
+			elapsed_ms = 0;
+			if (consume_cores)
+				consume_raw_cores(&settings);
+			remove_stale_files(&settings);
+			if (get_cloud_connection_status() == CC_STATUS_CONNECTED)
+				upload_crashes(&settings);
+		}
+
+		usleep(LOOP_MS * 1000);
+		elapsed_ms += LOOP_MS;
+	}
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * get_handler_prefix() - Get the 'core_pattern' prefix of this handler
+ *
+ * @buf:	Buffer to store the prefix.
+ * @size:	Size of @buf.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int get_handler_prefix(char *buf, size_t size)
+{
+	char exe[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	int n;
+
+	if (len <= 0)
+		return -1;
+	exe[len] = '\0';
+
+	n = snprintf(buf, size, "|%s %s", exe, CORE_PATTERN_ARGS);
+
+	return (n < 0 || (size_t) n >= size) ? -1 : 0;
+}
+
+/*
+ * read_core_pattern() - Read the kernel 'core_pattern'
+ *
+ * @buf:	Buffer to store the pattern.
+ * @size:	Size of @buf.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int read_core_pattern(char *buf, size_t size)
+{
+	FILE *fp = fopen(CORE_PATTERN_FILE, "r");
+	bool ok;
+
+	if (!fp)
+		return -1;
+	ok = fgets(buf, size, fp) != NULL;
+	fclose(fp);
+	if (!ok)
+		return -1;
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+/*
+ * write_core_pattern() - Set the kernel 'core_pattern'
+ *
+ * @pattern:	New pattern.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int write_core_pattern(const char *pattern)
+{
+	FILE *fp = fopen(CORE_PATTERN_FILE, "w");
+	int ret = 0;
+
+	if (!fp || fputs(pattern, fp) < 0)
+		ret = -1;
+	if (fp && fclose(fp) != 0)
+		ret = -1;
+	if (ret != 0)
+		log_crash_error("Unable to set core pattern '%s': %s (%d)", pattern, strerror(errno), errno);
+
+	return ret;
+}
+
+/*
+ * save_core_pattern() - Keep the pattern to restore when unregistering
+ *
+ * @pattern:	Pattern to save.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int save_core_pattern(const char *pattern)
+{
+	FILE *fp = fopen(CORE_PATTERN_SAVED_FILE, "w");
+	int ret = 0;
+
+	if (!fp || fprintf(fp, "%s\n", pattern) < 0)
+		ret = -1;
+	if (fp && fclose(fp) != 0)
+		ret = -1;
+	if (ret != 0)
+		log_crash_error("Unable to save core pattern '%s': %s (%d)", pattern, strerror(errno), errno);
+
+	return ret;
+}
+
+/*
+ * load_core_pattern() - Get the pattern to restore when unregistering
+ *
+ * @buf:	Buffer to store the pattern.
+ * @size:	Size of @buf.
+ *
+ * The default pattern is used if none was saved.
+ */
+static void load_core_pattern(char *buf, size_t size)
+{
+	FILE *fp = fopen(CORE_PATTERN_SAVED_FILE, "r");
+	bool ok = false;
+
+	if (fp) {
+		ok = fgets(buf, size, fp) != NULL;
+		fclose(fp);
+	}
+	if (ok)
+		buf[strcspn(buf, "\n")] = '\0';
+	if (!ok || buf[0] == '\0')
+		snprintf(buf, size, "%s", CORE_PATTERN_DEFAULT);
+}
+
+/*
+ * register_handler() - Register as the kernel core dump handler
+ *
+ * @config_file:	Configuration file to pass to the handler, NULL for the
+ *			default one.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int register_handler(const char *config_file)
+{
+	char prefix[PATH_MAX], pattern[PATH_MAX], current[PATH_MAX], config[PATH_MAX];
+	int len;
+
+	if (get_handler_prefix(prefix, sizeof(prefix)) != 0)
+		return -1;
+
+	/* The handler runs from '/', and the kernel splits arguments by spaces */
+	if (config_file && (!realpath(config_file, config) || strchr(config, ' '))) {
+		log_crash_error("Invalid configuration file for the core dump handler '%s'", config_file);
+		return -1;
+	}
+
+	len = snprintf(pattern, sizeof(pattern), "%s%s%s %%P %%s %%t %%e", prefix,
+		config_file ? " -c " : "", config_file ? config : "");
+	if (len < 0 || len >= CORE_PATTERN_MAX) {
+		log_crash_error("Core dump handler pattern too long: '%s'", pattern);
+		return -1;
+	}
+
+	if (read_core_pattern(current, sizeof(current)) == 0) {
+		if (strcmp(current, pattern) == 0)
+			return 0;
+		/* Keep the previous pattern unless it is this handler with other arguments */
+		if (strncmp(current, prefix, strlen(prefix)) != 0 && save_core_pattern(current) != 0)
+			return -1;
+	}
+
+	if (write_core_pattern(pattern) != 0)
+		return -1;
+
+	log_crash_info("Registered core dump handler '%s'", pattern);
+
+	return 0;
+}
+
+/*
+ * unregister_handler() - Restore the previous core dump pattern if registered
+ */
+static void unregister_handler(void)
+{
+	char prefix[PATH_MAX], current[PATH_MAX], previous[CORE_PATTERN_MAX];
+
+	if (get_handler_prefix(prefix, sizeof(prefix)) != 0
+		|| read_core_pattern(current, sizeof(current)) != 0
+		|| strncmp(current, prefix, strlen(prefix)) != 0)
+		return;
+
+	load_core_pattern(previous, sizeof(previous));
+	if (write_core_pattern(previous) == 0) {
+		unlink(CORE_PATTERN_SAVED_FILE);
+		log_crash_info("Unregistered core dump handler, using '%s'", previous);
+	}
+}
+
+int start_crash_capture(const char *config_file)
+{
+	if (crash_thread_valid)
+		return 0;
+
+	if (!(cc_cfg->services & CRASH_CAPTURE_SERVICE) || !cc_cfg->crash_handler)
+		unregister_handler();
+
+	if (!(cc_cfg->services & CRASH_CAPTURE_SERVICE))
+		return 0;
+
+	if (get_settings(cc_cfg, &settings) != 0) {
+		log_crash_error("Unable to start crash capture: %s", "Out of memory");
+		return -1;
+	}
+
+	consume_cores = !cc_cfg->crash_handler;
+	if (cc_cfg->crash_handler && register_handler(config_file) != 0)
+		log_crash_error("%s", "Unable to register core dump handler");
+
+	stop_requested = false;
+	crash_thread_valid = (pthread_create(&crash_thread, NULL, crash_capture_threaded, NULL) == 0);
+	if (!crash_thread_valid) {
+		log_crash_error("%s", "Unable to start crash capture thread");
+		free(settings.path);
+		settings.path = NULL;
+		return -1;
+	}
+
+	log_crash_info("Crash capture started, storing crashes in '%s'", settings.path);
+
+	return 0;
+}
+
+void stop_crash_capture(void)
+{
+	stop_requested = true;
+
+	if (crash_thread_valid) {
+		crash_thread_valid = false;
+		pthread_join(crash_thread, NULL);
+	}
+
+	free(settings.path);
+	settings.path = NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CRASH_CAPTURE_H_
+#define CRASH_CAPTURE_H_
+
+#include <cloudconnector.h>
+
+/*
+ * handle_crash() - Store a core dump read from the standard input
+ *
+ * @config_file:	Absolute path of the configuration file, NULL for the
+ *			default one.
+ * @argc:		Number of arguments in @argv.
+ * @argv:		Crashed process: '<pid> <signal> <time> [<name>]'.
+ *
+ * Entry point of the kernel 'core_pattern' pipe handler. The core dump is
+ * compressed into the crash capture directory, together with the crash
+ * metadata and a backtrace summary, for 'start_crash_capture()' to upload it.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int handle_crash(const char *config_file, int argc, char *argv[]);
+
+/*
+ * start_crash_capture() - Start uploading captured crashes
+ *
+ * @config_file:	Absolute path of the configuration file in use, NULL for
+ *			the default one. It is passed to the core dump handler.
+ *
+ * Registers the daemon as the kernel core dump handler, or consumes the core
+ * files written to the crash capture directory, depending on the
+ * configuration. Crash metadata is sent to the 'management/events/crash'
+ * data stream and compressed core dumps are uploaded to the 'crashes'
+ * Remote Manager directory.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int start_crash_capture(const char *config_file);
+
+/*
+ * stop_crash_capture() - Stop uploading captured crashes
+ *
+ * The core dump handler stays registered, so crashes are captured while the
+ * daemon is not running and uploaded on the next start.
+ */
+void stop_crash_capture(void);
+
+#endif /* CRASH_CAPTURE_H_ */
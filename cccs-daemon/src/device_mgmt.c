@@ -0,0 +1,1887 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <json_object_iterator.h>
+#include <json_tokener.h>
+#include <libdigiapix/network.h>
+#include <libdigiapix/process.h>
+#include <libdigiapix/wifi.h>
+#ifdef ENABLE_BT
+#include <libdigiapix/bluetooth.h>
+#endif /* ENABLE_BT */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "data_request.h"
+#include "device_mgmt.h"
+
+#define TARGET_DEVICE_INFO		"builtin/device_info"
+#define TARGET_GET_CONFIG		"builtin/get_config"
+#define TARGET_SET_CONFIG		"builtin/set_config"
+
+#define DM_TAG				"DEVMGMT:"
+
+#define STRING_NA			"N/A"
+
+#define MAX_RESPONSE_SIZE		512
+#define PARAM_LENGTH			25
+
+#define NET_CACHE_TTL			10	/* Seconds */
+
+#define BUILD_FILE			"/etc/build"
+#define EMMC_SIZE_FILE			"/sys/class/mmc_host/mmc0/mmc0:0001/block/mmcblk0/size"
+#define NAND_SIZE_FILE			"/proc/mtd"
+#define RESOLUTION_FILE			"/sys/class/graphics/fb0/modes"
+#define RESOLUTION_FILE_CCMP		"/sys/class/drm/card0/card0-DPI-1/modes"
+#define RESOLUTION_FILE_CCMP_HDMI	"/sys/class/drm/card0/card0-HDMI-A-1/modes"
+
+#define CFG_ELEMENT_ETHERNET		"ethernet"
+#define CFG_ELEMENT_WIFI		"wifi"
+#define CFG_ELEMENT_BLUETOOTH		"bluetooth"
+
+#define CFG_FIELD_DESC			"desc"
+#define CFG_FIELD_DNS1			"dns1"
+#define CFG_FIELD_DNS2			"dns2"
+#define CFG_FIELD_ENABLE		"enable"
+#define CFG_FIELD_GATEWAY		"gateway"
+#define CFG_FIELD_IP			"ip"
+#define CFG_FIELD_MAC			"mac"
+#define CFG_FIELD_NAME			"name"
+#define CFG_FIELD_NETMASK		"netmask"
+#define CFG_FIELD_PSK			"psk"
+#define CFG_FIELD_ROLLED_BACK		"rolled_back"
+#define CFG_FIELD_SEC_MODE		"sec_mode"
+#define CFG_FIELD_SSID			"ssid"
+#define CFG_FIELD_STATUS		"status"
+#define CFG_FIELD_TYPE			"type"
+
+#define IPV4_GROUPS			4
+#define MAC_GROUPS			6
+
+#define IP_STR_LENGTH			(4 * IPV4_GROUPS)
+#define IP_FORMAT			"%d.%d.%d.%d"
+#define MAC_STR_LENGTH			(3 * MAC_GROUPS)
+#define MAC_FORMAT			"%02x:%02x:%02x:%02x:%02x:%02x"
+
+#if !(defined UNUSED_ARGUMENT)
+#define UNUSED_ARGUMENT(a)	(void)(a)
+#endif
+
+/**
+ * log_dm_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_dm_debug(format, ...)				\
+	log_debug("%s " format, DM_TAG, __VA_ARGS__)
+
+/**
+ * log_dm_warning() - Log the given message as warning
+ *
+ * @format:		Warning message to log.
+ * @args:		Additional arguments.
+ */
+#define log_dm_warning(format, ...)				\
+	log_warning("%s " format, DM_TAG, __VA_ARGS__)
+
+/**
+ * log_dm_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_dm_error(format, ...)				\
+	log_error("%s " format, DM_TAG, __VA_ARGS__)
+
+/*
+ * struct dm_entry_t - Registered element and its cached views
+ *
+ * @element:	The registered element.
+ * @view:	Cached views, reduced ('device_info') and complete ('get_config').
+ * @stamp:	Monotonic second each view was generated.
+ */
+typedef struct {
+	dm_element_t element;
+	json_object *view[2];
+	time_t stamp[2];
+} dm_entry_t;
+
+static dm_entry_t *entries = NULL;
+static size_t n_entries = 0;
+static json_object *static_info = NULL;
+static bool builtin_registered = false;
+static pthread_mutex_t dm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * get_monotonic_sec() - Get the seconds elapsed in the monotonic clock
+ *
+ * Return: The number of seconds.
+ */
+static time_t get_monotonic_sec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec;
+}
+
+/*
+ * read_file() - Read the given file and returns its contents
+ *
+ * @path:	Absolute path of the file to read.
+ * @buffer:	Buffer to store the contents of the file.
+ * @file_size:	The number of bytes to read.
+ *
+ * Return: The number of read bytes.
+ */
+static long read_file(const char *path, char *buffer, long file_size)
+{
+	FILE *fd = NULL;
+	long read_size = -1;
+
+	if ((fd = fopen(path, "rb")) == NULL) {
+		log_dm_debug("%s: fopen error: %s", __func__, path);
+		return -1;
+	}
+
+	read_size = fread(buffer, sizeof(char), file_size, fd);
+	if (ferror(fd)) {
+		log_dm_debug("%s: fread error: %s", __func__, path);
+		goto done;
+	}
+
+	if (read_size > 0)
+		buffer[read_size - 1] = '\0';
+
+done:
+	fclose(fd);
+
+	return read_size;
+}
+
+/*
+ * read_file_line() - Read the first line of the file without the line feed
+ *
+ * @path:		Absolute path of the file to read.
+ * @buffer:		Buffer to store the contents of the file.
+ * @bytes_to_read:	The number of bytes to read.
+ *
+ * Return: 0 on success, -1 on error.
+ */
+static int read_file_line(const char * const path, char *buffer, int bytes_to_read)
+{
+	char line[MAX_RESPONSE_SIZE];
+	FILE *fd = NULL;
+	int error = 0;
+
+	if ((fd = fopen(path, "rb")) == NULL) {
+		log_dm_debug("%s: fopen error: %s", __func__, path);
+		return -1;
+	}
+	if (fgets(line, sizeof(line), fd) == NULL) {
+		log_dm_debug("%s: fgets error: %s", __func__, path);
+		error = -1;
+	} else {
+		line[strcspn(line, "\n")] = '\0';
+		snprintf(buffer, bytes_to_read, "%s", line);
+	}
+	fclose(fd);
+
+	return error;
+}
+
+/*
+ * read_dey_version() - Read the DEY version
+ *
+ * @version:	Buffer to store the DEY version.
+ * @size:	Size of the buffer.
+ *
+ * Return: 0 if success, 1 otherwise.
+ */
+static int read_dey_version(char *version, size_t size)
+{
+	FILE *in = NULL;
+	char line[128] = {0};
+	int ret = 1;
+
+	in = fopen(BUILD_FILE, "rb");
+	if (in == NULL) {
+		log_dm_error("Error getting DEY version: File '%s' does not exist or not readable", BUILD_FILE);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		char value[PARAM_LENGTH];
+
+		if (strncmp(line, "DISTRO_VERSION", strlen("DISTRO_VERSION")) != 0)
+			continue;
+
+		if (sscanf(line, "%*s %*s %24s", value) == 1) {
+			snprintf(version, size, "%s", value);
+			ret = 0;
+		}
+		break;
+	}
+	fclose(in);
+
+	return ret;
+}
+
+/*
+ * get_emmc_size() - Returns the total eMMC storage size
+ *
+ * Return: total size read.
+ */
+static long get_emmc_size(void)
+{
+	char data[MAX_RESPONSE_SIZE] = {0};
+	long total_size = 0;
+
+	if (read_file(EMMC_SIZE_FILE, data, MAX_RESPONSE_SIZE) <= 0)
+		log_dm_error("Error getting storage size: %s", "Could not read file");
+	if (sscanf(data, "%ld", &total_size) < 1)
+		log_dm_error("Error getting storage size: %s", "Invalid file contents");
+
+	return total_size * 512 / 1024; /* kB */
+}
+
+/*
+ * get_nand_size() - Returns the total NAND storage size
+ *
+ * Return: total size read.
+ */
+static long get_nand_size(void)
+{
+	char buffer[MAX_RESPONSE_SIZE] = {0};
+	long total_size = 0;
+	FILE *fd;
+
+	fd = fopen(NAND_SIZE_FILE, "r");
+	if (!fd) {
+		log_dm_error("Error getting storage size: %s", "Could not open file");
+		return total_size;
+	}
+	/* Ignore first line */
+	if (fgets(buffer, sizeof(buffer), fd) == NULL) {
+		log_dm_error("Error getting storage size: %s", "Could not read file");
+		fclose(fd);
+		return total_size;
+	}
+	/* Start reading line by line */
+	while (fgets(buffer, sizeof(buffer), fd)) {
+		char size_hex[20] = {'\0'};
+
+		if (sscanf(buffer, "%*s %19s", size_hex) == 1)
+			total_size += strtol(size_hex, NULL, 16);
+	}
+	if (ferror(fd))
+		log_dm_error("Error getting storage size: %s", "File read error");
+	fclose(fd);
+
+	return total_size / 1024; /* kB */
+}
+
+/*
+ * add_string() - Add a string field to the given JSON object
+ *
+ * @root:	JSON object to add the field to.
+ * @name:	Name of the field.
+ * @value:	Value of the field.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_string(json_object *root, const char *name, const char *value)
+{
+	json_object *item = json_object_new_string(value);
+
+	if (!item || json_object_object_add(root, name, item) < 0) {
+		json_object_put(item);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * add_int() - Add an integer field to the given JSON object
+ *
+ * @root:	JSON object to add the field to.
+ * @name:	Name of the field.
+ * @value:	Value of the field.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_int(json_object *root, const char *name, int64_t value)
+{
+	json_object *item = json_object_new_int64(value);
+
+	if (!item || json_object_object_add(root, name, item) < 0) {
+		json_object_put(item);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * add_bool() - Add a boolean field to the given JSON object
+ *
+ * @root:	JSON object to add the field to.
+ * @name:	Name of the field.
+ * @value:	Value of the field.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_bool(json_object *root, const char *name, bool value)
+{
+	json_object *item = json_object_new_boolean(value);
+
+	if (!item || json_object_object_add(root, name, item) < 0) {
+		json_object_put(item);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * add_json_element() - Creates and adds a new JSON element with the provided name
+ *
+ * @name:	Name of the new JSON object.
+ * @root:	JSON object to add the created object.
+ *
+ * Return: The created JSON object.
+ */
+static json_object *add_json_element(const char *name, json_object *root)
+{
+	json_object *item = json_object_new_object();
+
+	if (!item || json_object_object_add(root, name, item) < 0) {
+		json_object_put(item);
+		return NULL;
+	}
+
+	return item;
+}
+
+/*
+ * merge_json() - Add all fields of a JSON object to another one
+ *
+ * @dst:	JSON object to add the fields to.
+ * @src:	JSON object to take the fields from. It is not modified.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int merge_json(json_object *dst, json_object *src)
+{
+	struct json_object_iterator it = json_object_iter_begin(src);
+	struct json_object_iterator it_end = json_object_iter_end(src);
+
+	while (!json_object_iter_equal(&it, &it_end)) {
+		json_object *value = json_object_iter_peek_value(&it);
+
+		if (json_object_object_add(dst, json_object_iter_peek_name(&it), json_object_get(value)) < 0) {
+			json_object_put(value);
+			return -1;
+		}
+		json_object_iter_next(&it);
+	}
+
+	return 0;
+}
+
+/*
+ * get_mca_versions() - Read the MCA firmware and hardware versions
+ *
+ * @fw_version:	Buffer to store the firmware version.
+ * @hw_version:	Buffer to store the hardware version.
+ */
+static void get_mca_versions(char *fw_version, char *hw_version)
+{
+	char path[MAX_RESPONSE_SIZE];
+	char *resp = NULL;
+
+	if (ldx_process_execute_cmd("grep -l mca /sys/bus/i2c/devices/*/name | xargs -r grep -lv ioexp | xargs -r dirname | xargs -r basename", &resp, 2) != 0 || resp == NULL) {
+		if (resp != NULL)
+			log_dm_error("Error getting MCA address: %s", resp);
+		else
+			log_dm_error("%s", "Error getting MCA address");
+		goto done;
+	}
+
+	resp[strcspn(resp, "\n")] = '\0';
+
+	snprintf(path, sizeof(path), "/sys/bus/i2c/devices/%s/fw_version", resp);
+	if (read_file_line(path, fw_version, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting MCA firmware version");
+
+	snprintf(path, sizeof(path), "/sys/bus/i2c/devices/%s/hw_version", resp);
+	if (read_file_line(path, hw_version, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting MCA hardware version");
+
+done:
+	free(resp);
+}
+
+/*
+ * get_resolution() - Read the video resolution
+ *
+ * @resolution:	Buffer to store the resolution.
+ */
+static void get_resolution(char *resolution)
+{
+	char data[MAX_RESPONSE_SIZE] = {0};
+	const char *resolution_file = NULL;
+
+	if (access(RESOLUTION_FILE, R_OK) == 0)
+		resolution_file = RESOLUTION_FILE;
+	else if (access(RESOLUTION_FILE_CCMP, R_OK) == 0)
+		resolution_file = RESOLUTION_FILE_CCMP;
+	else if (access(RESOLUTION_FILE_CCMP_HDMI, R_OK) == 0)
+		resolution_file = RESOLUTION_FILE_CCMP_HDMI;
+
+	if (resolution_file == NULL) {
+		log_dm_error("Error getting video resolution: %s", "File not readable");
+	} else if (read_file(resolution_file, data, MAX_RESPONSE_SIZE) <= 0) {
+		log_dm_error("%s", "Error getting video resolution");
+	} else if (sscanf(data, "U:%511s", resolution) < 1) {
+		if (sscanf(data, "%511s", resolution) < 1)
+			log_dm_error("%s", "Error getting video resolution");
+	}
+}
+
+/*
+ * build_static_info() - Generate the device information that does not change at runtime
+ *
+ * Return: The JSON object, NULL if out of memory.
+ */
+static json_object *build_static_info(void)
+{
+	json_object *root = json_object_new_object();
+	char version[MAX_RESPONSE_SIZE] = STRING_NA;
+	char kernel[MAX_RESPONSE_SIZE] = STRING_NA;
+	char uboot[MAX_RESPONSE_SIZE] = STRING_NA;
+	char resolution[MAX_RESPONSE_SIZE] = {0};
+	char board_sn[PARAM_LENGTH] = STRING_NA;
+	char dev_type[PARAM_LENGTH] = STRING_NA;
+	char som_variant[PARAM_LENGTH] = STRING_NA;
+	char board_variant[PARAM_LENGTH] = STRING_NA;
+	char board_id[PARAM_LENGTH] = STRING_NA;
+	char mca_fw_version[PARAM_LENGTH] = STRING_NA;
+	char mca_hw_version[PARAM_LENGTH] = STRING_NA;
+	struct sysinfo s_info;
+	long total_st = 0, total_mem = -1;
+
+	if (!root)
+		return NULL;
+
+	{
+		char dey_version[PARAM_LENGTH] = STRING_NA;
+		char build_id[PARAM_LENGTH] = STRING_NA;
+
+		if (read_dey_version(dey_version, sizeof(dey_version)) == 0
+			&& read_file_line("/etc/version", build_id, PARAM_LENGTH) == 0)
+			snprintf(version, sizeof(version), "DEY-%s-%s", dey_version, build_id);
+	}
+
+	{
+		char *resp = NULL;
+
+		if (ldx_process_execute_cmd("uname -a", &resp, 2) != 0 || resp == NULL) {
+			if (resp != NULL)
+				log_dm_error("Error getting Kernel version: %s", resp);
+			else
+				log_dm_error("%s", "Error getting Kernel version");
+		} else {
+			resp[strcspn(resp, "\n")] = '\0';
+			snprintf(kernel, sizeof(kernel), "%s", resp);
+		}
+		free(resp);
+	}
+
+	if (read_file_line("/proc/device-tree/digi,uboot,version", uboot, MAX_RESPONSE_SIZE) != 0)
+		log_dm_error("%s", "Error getting U-Boot version");
+	if (read_file_line("/proc/device-tree/digi,hwid,sn", board_sn, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting serial number");
+	if (read_file_line("/proc/device-tree/digi,machine,name", dev_type, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting device type");
+	if (read_file_line("/proc/device-tree/digi,hwid,variant", som_variant, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting SOM variant");
+	if (read_file_line("/proc/device-tree/digi,carrierboard,version", board_variant, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting board variant");
+	if (read_file_line("/proc/device-tree/digi,carrierboard,id", board_id, PARAM_LENGTH) != 0)
+		log_dm_error("%s", "Error getting board ID");
+
+	get_mca_versions(mca_fw_version, mca_hw_version);
+
+	/* Check first emmc, because '/proc/mtd' may exists although empty */
+	if (access(EMMC_SIZE_FILE, R_OK) == 0)
+		total_st = get_emmc_size();
+	else if (access(NAND_SIZE_FILE, R_OK) == 0)
+		total_st = get_nand_size();
+	else
+		log_dm_error("Error getting storage size: %s", "File not readable");
+
+	if (sysinfo(&s_info) != 0)
+		log_dm_error("Error getting total memory: %s (%d)", strerror(errno), errno);
+	else
+		total_mem = s_info.totalram / 1024;
+
+	get_resolution(resolution);
+
+	if (add_string(root, "dey_version", version) != 0
+		|| add_string(root, "kernel_version", kernel) != 0
+		|| add_string(root, "uboot_version", uboot) != 0
+		|| add_string(root, "serial_number", board_sn) != 0
+		|| add_string(root, "device_type", dev_type) != 0
+		|| add_string(root, "module_variant", som_variant) != 0
+		|| add_string(root, "board_variant", board_variant) != 0
+		|| add_string(root, "board_id", board_id) != 0
+		|| add_string(root, "mca_fw_version", mca_fw_version) != 0
+		|| add_string(root, "mca_hw_version", mca_hw_version) != 0
+		|| add_int(root, "total_st", total_st) != 0
+		|| add_int(root, "total_mem", total_mem) != 0
+		|| add_string(root, "resolution", resolution) != 0) {
+		json_object_put(root);
+		return NULL;
+	}
+
+	return root;
+}
+
+/******************** Ethernet and Wi-Fi elements ********************/
+
+/*
+ * add_net_state_json() - Adds network details to the provided JSON
+ *
+ * @i_state:	Network interface state to add.
+ * @iface_item:	JSON object to add network details.
+ * @complete:	True to include enable, type, netmask, gateway and DNS.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int add_net_state_json(const net_state_t *i_state, json_object *iface_item, bool complete)
+{
+	char mac[MAC_STR_LENGTH], ip[IP_STR_LENGTH];
+
+	snprintf(mac, sizeof(mac), MAC_FORMAT, i_state->mac[0], i_state->mac[1],
+		i_state->mac[2], i_state->mac[3], i_state->mac[4], i_state->mac[5]);
+	snprintf(ip, sizeof(ip), IP_FORMAT,
+		i_state->ipv4[0], i_state->ipv4[1], i_state->ipv4[2], i_state->ipv4[3]);
+
+	if (add_string(iface_item, CFG_FIELD_MAC, mac) != 0
+		|| add_string(iface_item, CFG_FIELD_IP, ip) != 0)
+		return -1;
+
+	if (!complete)
+		return 0;
+
+	if (add_bool(iface_item, CFG_FIELD_ENABLE, i_state->status == NET_STATUS_CONNECTED) != 0
+		|| add_int(iface_item, CFG_FIELD_TYPE, i_state->is_dhcp) != 0)
+		return -1;
+
+	snprintf(ip, sizeof(ip), IP_FORMAT,
+		i_state->netmask[0], i_state->netmask[1], i_state->netmask[2], i_state->netmask[3]);
+	if (add_string(iface_item, CFG_FIELD_NETMASK, ip) != 0)
+		return -1;
+
+	snprintf(ip, sizeof(ip), IP_FORMAT,
+		i_state->gateway[0], i_state->gateway[1], i_state->gateway[2], i_state->gateway[3]);
+	if (add_string(iface_item, CFG_FIELD_GATEWAY, ip) != 0)
+		return -1;
+
+	snprintf(ip, sizeof(ip), IP_FORMAT,
+		i_state->dns1[0], i_state->dns1[1], i_state->dns1[2], i_state->dns1[3]);
+	if (add_string(iface_item, CFG_FIELD_DNS1, ip) != 0)
+		return -1;
+
+	snprintf(ip, sizeof(ip), IP_FORMAT,
+		i_state->dns2[0], i_state->dns2[1], i_state->dns2[2], i_state->dns2[3]);
+	if (add_string(iface_item, CFG_FIELD_DNS2, ip) != 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * add_status_json() - Adds a status code and its description to the provided JSON
+ *
+ * @item:	JSON object to add the status to.
+ * @status:	Status code.
+ * @desc:	Status description.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int add_status_json(json_object *item, int status, const char *desc)
+{
+	if (add_int(item, CFG_FIELD_STATUS, status) != 0
+		|| add_string(item, CFG_FIELD_DESC, desc) != 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * eth_get_cb() - Fill the state of the Ethernet interfaces
+ *
+ * @item:	JSON object to add the interfaces to.
+ * @complete:	True to include enable, type, netmask, gateway and DNS.
+ *
+ * Return: DM_ERROR_NONE on success, DM_ERROR_NO_MEMORY otherwise.
+ */
+static int eth_get_cb(json_object *item, bool complete)
+{
+	net_names_list_t list_ifaces;
+	int i;
+
+	if (ldx_net_list_available_ifaces(&list_ifaces) < 0) {
+		log_dm_error("%s", "Unable to get list of network interfaces");
+		if (complete && add_status_json(item, NET_STATE_ERROR_NO_IFACES,
+				ldx_net_code_to_str(NET_STATE_ERROR_NO_IFACES)) != 0)
+			return DM_ERROR_NO_MEMORY;
+
+		return DM_ERROR_NONE;
+	}
+
+	for (i = 0; i < list_ifaces.n_ifaces; i++) {
+		net_state_t i_state;
+		json_object *i_item;
+
+		if (ldx_wifi_iface_exists(list_ifaces.names[i]))
+			continue;
+
+		i_item = add_json_element(list_ifaces.names[i], item);
+		if (!i_item)
+			return DM_ERROR_NO_MEMORY;
+
+		memset(&i_state, 0, sizeof(i_state));
+		if (ldx_net_get_iface_state(list_ifaces.names[i], &i_state) != NET_STATE_ERROR_NONE)
+			log_dm_warning("Error getting '%s' interface info", list_ifaces.names[i]);
+
+		if (add_net_state_json(&i_state, i_item, complete) != 0)
+			return DM_ERROR_NO_MEMORY;
+	}
+
+	return DM_ERROR_NONE;
+}
+
+/*
+ * wifi_get_cb() - Fill the state of the Wi-Fi interfaces
+ *
+ * @item:	JSON object to add the interfaces to.
+ * @complete:	True to include enable, type, netmask, gateway, DNS, SSID and
+ *		security mode.
+ *
+ * Return: DM_ERROR_NONE on success, DM_ERROR_NO_MEMORY otherwise.
+ */
+static int wifi_get_cb(json_object *item, bool complete)
+{
+	net_names_list_t list_ifaces;
+	int i;
+
+	if (ldx_wifi_list_available_ifaces(&list_ifaces) < 0) {
+		log_dm_error("%s", "Unable to get list of Wi-Fi interfaces");
+		if (complete && add_status_json(item, WIFI_STATE_ERROR_NO_IFACES,
+				ldx_wifi_code_to_str(WIFI_STATE_ERROR_NO_IFACES)) != 0)
+			return DM_ERROR_NO_MEMORY;
+
+		return DM_ERROR_NONE;
+	}
+
+	for (i = 0; i < list_ifaces.n_ifaces; i++) {
+		wifi_state_t i_state;
+		json_object *i_item = add_json_element(list_ifaces.names[i], item);
+
+		if (!i_item)
+			return DM_ERROR_NO_MEMORY;
+
+		memset(&i_state, 0, sizeof(i_state));
+		if (ldx_wifi_get_iface_state(list_ifaces.names[i], &i_state) != WIFI_STATE_ERROR_NONE)
+			log_dm_warning("Error getting '%s' interface info", list_ifaces.names[i]);
+
+		if (add_net_state_json(&i_state.net_state, i_item, complete) != 0)
+			return DM_ERROR_NO_MEMORY;
+
+		if (complete
+			&& (add_string(i_item, CFG_FIELD_SSID, i_state.ssid) != 0
+			    || add_int(i_item, CFG_FIELD_SEC_MODE, i_state.sec_mode) != 0))
+			return DM_ERROR_NO_MEMORY;
+	}
+
+	return DM_ERROR_NONE;
+}
+
+/*
+ * get_ip_from_json() - Retrieves the IP value from the given JSON object field
+ *
+ * @json_item:	JSON object.
+ * @key:	Field name.
+ * @ip:		A pointer to store the IP value.
+ *
+ * Return: 0 if the field is not found, 1 if success, -1 if bad format.
+ */
+static int get_ip_from_json(json_object *json_item, const char *key, uint8_t (*ip)[IPV4_GROUPS])
+{
+	json_object *cfg_field = NULL;
+
+	memset(ip, 0, IPV4_GROUPS);
+
+	if (!json_object_object_get_ex(json_item, key, &cfg_field))
+		return 0;
+
+	if (!json_object_is_type(cfg_field, json_type_string))
+		return -1;
+
+	if (sscanf(json_object_get_string(cfg_field), "%hhu.%hhu.%hhu.%hhu",
+			*ip, *ip + 1, *ip + 2, *ip + 3) != 4)
+		return -1;
+
+	return 1;
+}
+
+/*
+ * get_net_cfg_from_json() - Retrieves the network configuration from the JSON object
+ *
+ * @json_item:	JSON object.
+ * @iface_name: Interface name.
+ * @net_cfg:	A pointer to store the network configuration.
+ *
+ * Return: Number of valid fields if success, -1 if fails.
+ */
+static int get_net_cfg_from_json(json_object *json_item, const char *iface_name, net_config_t *net_cfg)
+{
+	json_object *cfg_field = NULL;
+	int valid_fields = 0, ret;
+
+	if (!json_object_is_type(json_item, json_type_object))
+		return -1;
+
+	strncpy(net_cfg->name, iface_name, sizeof(net_cfg->name) - 1);
+
+	if (json_object_object_get_ex(json_item, CFG_FIELD_ENABLE, &cfg_field)) {
+		if (!json_object_is_type(cfg_field, json_type_boolean))
+			return -1;
+		net_cfg->status = json_object_get_boolean(cfg_field) ? NET_STATUS_CONNECTED : NET_STATUS_DISCONNECTED;
+		valid_fields++;
+	}
+
+	if (json_object_object_get_ex(json_item, CFG_FIELD_TYPE, &cfg_field)) {
+		int type;
+
+		if (!json_object_is_type(cfg_field, json_type_int))
+			return -1;
+
+		type = json_object_get_int(cfg_field);
+		if (type < 0 || type > 1)
+			return -1;
+
+		net_cfg->is_dhcp = type == 1 ? NET_ENABLED : NET_DISABLED;
+		valid_fields++;
+	}
+
+	ret = get_ip_from_json(json_item, CFG_FIELD_IP, &net_cfg->ipv4);
+	if (ret < 0)
+		return -1;
+	net_cfg->set_ip = (ret == 1);
+	valid_fields += ret;
+
+	ret = get_ip_from_json(json_item, CFG_FIELD_NETMASK, &net_cfg->netmask);
+	if (ret < 0)
+		return -1;
+	net_cfg->set_netmask = (ret == 1);
+	valid_fields += ret;
+
+	ret = get_ip_from_json(json_item, CFG_FIELD_GATEWAY, &net_cfg->gateway);
+	if (ret < 0)
+		return -1;
+	net_cfg->set_gateway = (ret == 1);
+	valid_fields += ret;
+
+	ret = get_ip_from_json(json_item, CFG_FIELD_DNS1, &net_cfg->dns1);
+	if (ret < 0)
+		return -1;
+	net_cfg->n_dns += ret;
+	valid_fields += ret;
+
+	ret = get_ip_from_json(json_item, CFG_FIELD_DNS2, &net_cfg->dns2);
+	if (ret < 0)
+		return -1;
+	net_cfg->n_dns += ret;
+	valid_fields += ret;
+
+	return valid_fields;
+}
+
+/*
+ * net_state_to_config() - Build the configuration that reproduces a network state
+ *
+ * @state:	Current state of the interface.
+ * @name:	Interface name.
+ * @cfg:	Configuration to fill.
+ */
+static void net_state_to_config(const net_state_t *state, const char *name, net_config_t *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	strncpy(cfg->name, name, sizeof(cfg->name) - 1);
+
+	cfg->status = state->status == NET_STATUS_CONNECTED ? NET_STATUS_CONNECTED : NET_STATUS_DISCONNECTED;
+	cfg->is_dhcp = state->is_dhcp == NET_ENABLED ? NET_ENABLED : NET_DISABLED;
+	if (cfg->is_dhcp == NET_ENABLED)
+		return;
+
+	/* Static addressing must be restored explicitly */
+	memcpy(cfg->ipv4, state->ipv4, sizeof(cfg->ipv4));
+	memcpy(cfg->netmask, state->netmask, sizeof(cfg->netmask));
+	memcpy(cfg->gateway, state->gateway, sizeof(cfg->gateway));
+	memcpy(cfg->dns1, state->dns1, sizeof(cfg->dns1));
+	memcpy(cfg->dns2, state->dns2, sizeof(cfg->dns2));
+	cfg->set_ip = true;
+	cfg->set_netmask = true;
+	cfg->set_gateway = true;
+	cfg->n_dns = 2;
+}
+
+/*
+ * struct eth_txn_t - Ethernet 'set_config' transaction
+ *
+ * @n_ifaces:	Number of interfaces to configure.
+ * @n_applied:	Number of interfaces whose configuration was applied.
+ * @cfgs:	New configuration of each interface.
+ * @prev:	Configuration to restore for each interface.
+ */
+typedef struct {
+	int n_ifaces;
+	int n_applied;
+	net_config_t *cfgs;
+	net_config_t *prev;
+} eth_txn_t;
+
+/*
+ * struct wifi_txn_t - Wi-Fi 'set_config' transaction
+ *
+ * @n_ifaces:	Number of interfaces to configure.
+ * @n_applied:	Number of interfaces whose configuration was applied.
+ * @cfgs:	New configuration of each interface.
+ * @prev:	Configuration to restore for each interface.
+ */
+typedef struct {
+	int n_ifaces;
+	int n_applied;
+	wifi_config_t *cfgs;
+	wifi_config_t *prev;
+} wifi_txn_t;
+
+static void eth_release_cb(void *ctx)
+{
+	eth_txn_t *txn = ctx;
+
+	if (!txn)
+		return;
+
+	free(txn->cfgs);
+	free(txn->prev);
+	free(txn);
+}
+
+static int eth_prepare_cb(json_object *req, json_object *resp, void **ctx)
+{
+	struct json_object_iterator it, it_end;
+	eth_txn_t *txn;
+	int n = json_object_is_type(req, json_type_object) ? json_object_object_length(req) : 0;
+
+	if (n <= 0)
+		return DM_ERROR_BAD_FORMAT;
+
+	txn = calloc(1, sizeof(*txn));
+	if (txn) {
+		txn->cfgs = calloc(n, sizeof(*txn->cfgs));
+		txn->prev = calloc(n, sizeof(*txn->prev));
+	}
+	if (!txn || !txn->cfgs || !txn->prev) {
+		eth_release_cb(txn);
+		return DM_ERROR_NO_MEMORY;
+	}
+
+	it = json_object_iter_begin(req);
+	it_end = json_object_iter_end(req);
+	for (; !json_object_iter_equal(&it, &it_end); json_object_iter_next(&it)) {
+		const char *iface_name = json_object_iter_peek_name(&it);
+		net_config_t *cfg = &txn->cfgs[txn->n_ifaces];
+		net_state_t state;
+
+		if (!ldx_net_iface_exists(iface_name)) {
+			json_object *iface_item = add_json_element(iface_name, resp);
+
+			if (!iface_item || add_status_json(iface_item, NET_STATE_ERROR_NO_EXIST,
+					ldx_net_code_to_str(NET_STATE_ERROR_NO_EXIST)) != 0)
+				goto no_memory;
+			continue;
+		}
+
+		cfg->status = NET_STATUS_UNKNOWN;
+		cfg->is_dhcp = NET_ENABLED_ERROR;
+		if (get_net_cfg_from_json(json_object_iter_peek_value(&it), iface_name, cfg) < 0) {
+			log_dm_error("Invalid '%s' configuration", iface_name);
+			eth_release_cb(txn);
+			return DM_ERROR_BAD_FORMAT;
+		}
+
+		memset(&state, 0, sizeof(state));
+		if (ldx_net_get_iface_state(iface_name, &state) != NET_STATE_ERROR_NONE)
+			log_dm_warning("Error getting '%s' interface info", iface_name);
+		net_state_to_config(&state, iface_name, &txn->prev[txn->n_ifaces]);
+
+		txn->n_ifaces++;
+	}
+
+	*ctx = txn;
+
+	return DM_ERROR_NONE;
+
+no_memory:
+	eth_release_cb(txn);
+
+	return DM_ERROR_NO_MEMORY;
+}
+
+static int eth_apply_cb(void *ctx, json_object *resp)
+{
+	eth_txn_t *txn = ctx;
+	int ret = DM_ERROR_NONE;
+
+	for (txn->n_applied = 0; txn->n_applied < txn->n_ifaces; ) {
+		net_config_t *cfg = &txn->cfgs[txn->n_applied];
+		net_state_error_t err = ldx_net_set_config(*cfg);
+		json_object *iface_item;
+
+		txn->n_applied++;
+
+		iface_item = add_json_element(cfg->name, resp);
+		if (!iface_item || add_status_json(iface_item, err, ldx_net_code_to_str(err)) != 0)
+			return DM_ERROR_NO_MEMORY;
+
+		if (err != NET_STATE_ERROR_NONE) {
+			log_dm_error("Unable to configure '%s': %s", cfg->name, ldx_net_code_to_str(err));
+			ret = DM_ERROR_APPLY;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+static void eth_rollback_cb(void *ctx)
+{
+	eth_txn_t *txn = ctx;
+	int i;
+
+	for (i = txn->n_applied - 1; i >= 0; i--) {
+		if (ldx_net_set_config(txn->prev[i]) != NET_STATE_ERROR_NONE)
+			log_dm_error("Unable to restore '%s' configuration", txn->prev[i].name);
+	}
+}
+
+static void wifi_release_cb(void *ctx)
+{
+	wifi_txn_t *txn = ctx;
+
+	if (!txn)
+		return;
+
+	free(txn->cfgs);
+	free(txn->prev);
+	free(txn);
+}
+
+/*
+ * get_wifi_cfg_from_json() - Retrieves the WiFi configuration from the JSON object
+ *
+ * @json_item:	JSON object.
+ * @iface_name: Interface name.
+ * @wifi_cfg:	A pointer to store the WiFi configuration.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int get_wifi_cfg_from_json(json_object *json_item, const char *iface_name, wifi_config_t *wifi_cfg)
+{
+	json_object *cfg_field = NULL;
+	int valid_fields;
+
+	valid_fields = get_net_cfg_from_json(json_item, iface_name, &wifi_cfg->net_config);
+	if (valid_fields < 0)
+		return -1;
+
+	strncpy(wifi_cfg->name, iface_name, sizeof(wifi_cfg->name) - 1);
+
+	if (json_object_object_get_ex(json_item, CFG_FIELD_SSID, &cfg_field)) {
+		if (!json_object_is_type(cfg_field, json_type_string))
+			return -1;
+		wifi_cfg->set_ssid = true;
+		strncpy(wifi_cfg->ssid, json_object_get_string(cfg_field), IW_ESSID_MAX_SIZE - 1);
+		valid_fields++;
+	}
+
+	if (json_object_object_get_ex(json_item, CFG_FIELD_SEC_MODE, &cfg_field)) {
+		int sec_mode;
+
+		if (!json_object_is_type(cfg_field, json_type_int))
+			return -1;
+
+		sec_mode = json_object_get_int(cfg_field);
+		if (sec_mode < WIFI_SEC_MODE_OPEN || sec_mode > WIFI_SEC_MODE_WPA3)
+			return -1;
+
+		wifi_cfg->sec_mode = sec_mode;
+		valid_fields++;
+	}
+
+	if (json_object_object_get_ex(json_item, CFG_FIELD_PSK, &cfg_field)) {
+		if (!json_object_is_type(cfg_field, json_type_string))
+			return -1;
+		/* The request outlives the transaction */
+		wifi_cfg->psk = (char *)json_object_get_string(cfg_field);
+		valid_fields++;
+	}
+
+	return valid_fields > 0 ? 0 : -1;
+}
+
+static int wifi_prepare_cb(json_object *req, json_object *resp, void **ctx)
+{
+	struct json_object_iterator it, it_end;
+	wifi_txn_t *txn;
+	int n = json_object_is_type(req, json_type_object) ? json_object_object_length(req) : 0;
+
+	if (n <= 0)
+		return DM_ERROR_BAD_FORMAT;
+
+	txn = calloc(1, sizeof(*txn));
+	if (txn) {
+		txn->cfgs = calloc(n, sizeof(*txn->cfgs));
+		txn->prev = calloc(n, sizeof(*txn->prev));
+	}
+	if (!txn || !txn->cfgs || !txn->prev) {
+		wifi_release_cb(txn);
+		return DM_ERROR_NO_MEMORY;
+	}
+
+	it = json_object_iter_begin(req);
+	it_end = json_object_iter_end(req);
+	for (; !json_object_iter_equal(&it, &it_end); json_object_iter_next(&it)) {
+		const char *iface_name = json_object_iter_peek_name(&it);
+		wifi_config_t *cfg = &txn->cfgs[txn->n_ifaces];
+		wifi_config_t *prev = &txn->prev[txn->n_ifaces];
+		wifi_state_t state;
+
+		if (!ldx_wifi_iface_exists(iface_name)) {
+			json_object *iface_item = add_json_element(iface_name, resp);
+
+			if (!iface_item || add_status_json(iface_item, WIFI_STATE_ERROR_NO_EXIST,
+					ldx_wifi_code_to_str(WIFI_STATE_ERROR_NO_EXIST)) != 0) {
+				wifi_release_cb(txn);
+				return DM_ERROR_NO_MEMORY;
+			}
+			continue;
+		}
+
+		cfg->sec_mode = WIFI_SEC_MODE_ERROR;
+		cfg->net_config.status = NET_STATUS_UNKNOWN;
+		cfg->net_config.is_dhcp = NET_ENABLED_ERROR;
+		if (get_wifi_cfg_from_json(json_object_iter_peek_value(&it), iface_name, cfg) != 0) {
+			log_dm_error("Invalid '%s' configuration", iface_name);
+			wifi_release_cb(txn);
+			return DM_ERROR_BAD_FORMAT;
+		}
+
+		memset(&state, 0, sizeof(state));
+		if (ldx_wifi_get_iface_state(iface_name, &state) != WIFI_STATE_ERROR_NONE)
+			log_dm_warning("Error getting '%s' interface info", iface_name);
+
+		net_state_to_config(&state.net_state, iface_name, &prev->net_config);
+		strncpy(prev->name, iface_name, sizeof(prev->name) - 1);
+		prev->sec_mode = WIFI_SEC_MODE_ERROR;
+		/* The PSK cannot be read back, so only restore what is known */
+		if (cfg->set_ssid) {
+			prev->set_ssid = true;
+			strncpy(prev->ssid, state.ssid, IW_ESSID_MAX_SIZE - 1);
+		}
+		if (cfg->sec_mode != WIFI_SEC_MODE_ERROR)
+			prev->sec_mode = state.sec_mode;
+
+		txn->n_ifaces++;
+	}
+
+	*ctx = txn;
+
+	return DM_ERROR_NONE;
+}
+
+static int wifi_apply_cb(void *ctx, json_object *resp)
+{
+	wifi_txn_t *txn = ctx;
+	int ret = DM_ERROR_NONE;
+
+	for (txn->n_applied = 0; txn->n_applied < txn->n_ifaces; ) {
+		wifi_config_t *cfg = &txn->cfgs[txn->n_applied];
+		wifi_state_error_t err = ldx_wifi_set_config(*cfg);
+		json_object *iface_item;
+
+		txn->n_applied++;
+
+		iface_item = add_json_element(cfg->name, resp);
+		if (!iface_item || add_status_json(iface_item, err, ldx_wifi_code_to_str(err)) != 0)
+			return DM_ERROR_NO_MEMORY;
+
+		if (err != WIFI_STATE_ERROR_NONE) {
+			log_dm_error("Unable to configure '%s': %s", cfg->name, ldx_wifi_code_to_str(err));
+			ret = DM_ERROR_APPLY;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+static void wifi_rollback_cb(void *ctx)
+{
+	wifi_txn_t *txn = ctx;
+	int i;
+
+	for (i = txn->n_applied - 1; i >= 0; i--) {
+		if (ldx_wifi_set_config(txn->prev[i]) != WIFI_STATE_ERROR_NONE)
+			log_dm_error("Unable to restore '%s' configuration", txn->prev[i].name);
+	}
+}
+
+#ifdef ENABLE_BT
+/******************** Bluetooth element ********************/
+
+/*
+ * struct bt_txn_t - Bluetooth 'set_config' transaction
+ *
+ * @applied:	True if the new configuration was applied.
+ * @cfg:	New configuration.
+ * @prev:	Configuration to restore.
+ */
+typedef struct {
+	bool applied;
+	bt_config_t cfg;
+	bt_config_t prev;
+} bt_txn_t;
+
+static int bt_get_cb(json_object *item, bool complete)
+{
+	bt_state_t bt_state;
+	char mac[MAC_STR_LENGTH];
+
+	memset(&bt_state, 0, sizeof(bt_state));
+	ldx_bt_get_state(0, &bt_state);
+
+	snprintf(mac, sizeof(mac), MAC_FORMAT, bt_state.mac[0], bt_state.mac[1],
+		bt_state.mac[2], bt_state.mac[3], bt_state.mac[4], bt_state.mac[5]);
+
+	if (add_string(item, "bt-mac", mac) != 0)
+		return DM_ERROR_NO_MEMORY;
+
+	if (complete
+		&& (add_bool(item, CFG_FIELD_ENABLE, bt_state.enable) != 0
+		    || add_string(item, CFG_FIELD_NAME, bt_state.name) != 0))
+		return DM_ERROR_NO_MEMORY;
+
+	return DM_ERROR_NONE;
+}
+
+static int bt_prepare_cb(json_object *req, json_object *resp, void **ctx)
+{
+	json_object *cfg_field = NULL;
+	bt_state_t bt_state;
+	bt_txn_t *txn;
+	int valid_fields = 0;
+
+	UNUSED_ARGUMENT(resp);
+
+	if (!json_object_is_type(req, json_type_object))
+		return DM_ERROR_BAD_FORMAT;
+
+	txn = calloc(1, sizeof(*txn));
+	if (!txn)
+		return DM_ERROR_NO_MEMORY;
+
+	txn->cfg.dev_id = 0;
+	txn->cfg.enable = BT_ENABLED_ERROR;
+
+	if (json_object_object_get_ex(req, CFG_FIELD_ENABLE, &cfg_field)) {
+		if (!json_object_is_type(cfg_field, json_type_boolean))
+			goto bad_format;
+		txn->cfg.enable = json_object_get_boolean(cfg_field) ? BT_ENABLED : BT_DISABLED;
+		valid_fields++;
+	}
+
+	if (json_object_object_get_ex(req, CFG_FIELD_NAME, &cfg_field)) {
+		if (!json_object_is_type(cfg_field, json_type_string))
+			goto bad_format;
+		txn->cfg.set_name = true;
+		strncpy(txn->cfg.name, json_object_get_string(cfg_field), sizeof(txn->cfg.name) - 1);
+		valid_fields++;
+	}
+
+	if (!valid_fields)
+		goto bad_format;
+
+	memset(&bt_state, 0, sizeof(bt_state));
+	ldx_bt_get_state(0, &bt_state);
+
+	txn->prev.dev_id = 0;
+	txn->prev.enable = BT_ENABLED_ERROR;
+	if (txn->cfg.enable != BT_ENABLED_ERROR)
+		txn->prev.enable = bt_state.enable ? BT_ENABLED : BT_DISABLED;
+	if (txn->cfg.set_name) {
+		txn->prev.set_name = true;
+		strncpy(txn->prev.name, bt_state.name, sizeof(txn->prev.name) - 1);
+	}
+
+	*ctx = txn;
+
+	return DM_ERROR_NONE;
+
+bad_format:
+	free(txn);
+
+	return DM_ERROR_BAD_FORMAT;
+}
+
+static int bt_apply_cb(void *ctx, json_object *resp)
+{
+	bt_txn_t *txn = ctx;
+	bt_state_error_t err = ldx_bt_set_config(txn->cfg);
+
+	txn->applied = true;
+
+	if (add_status_json(resp, err, ldx_bt_code_to_str(err)) != 0)
+		return DM_ERROR_NO_MEMORY;
+
+	if (err != BT_STATE_ERROR_NONE) {
+		log_dm_error("Unable to configure Bluetooth: %s", ldx_bt_code_to_str(err));
+		return DM_ERROR_APPLY;
+	}
+
+	return DM_ERROR_NONE;
+}
+
+static void bt_rollback_cb(void *ctx)
+{
+	bt_txn_t *txn = ctx;
+
+	if (txn->applied && ldx_bt_set_config(txn->prev) != BT_STATE_ERROR_NONE)
+		log_dm_error("%s", "Unable to restore Bluetooth configuration");
+}
+
+static void bt_release_cb(void *ctx)
+{
+	free(ctx);
+}
+#endif /* ENABLE_BT */
+
+static const dm_element_t builtin_elements[] = {
+	{
+		.name = CFG_ELEMENT_ETHERNET,
+		.in_device_info = true,
+		.cache_ttl = NET_CACHE_TTL,
+		.get = eth_get_cb,
+		.prepare = eth_prepare_cb,
+		.apply = eth_apply_cb,
+		.rollback = eth_rollback_cb,
+		.release = eth_release_cb,
+	},
+	{
+		.name = CFG_ELEMENT_WIFI,
+		.in_device_info = true,
+		.cache_ttl = NET_CACHE_TTL,
+		.get = wifi_get_cb,
+		.prepare = wifi_prepare_cb,
+		.apply = wifi_apply_cb,
+		.rollback = wifi_rollback_cb,
+		.release = wifi_release_cb,
+	},
+#ifdef ENABLE_BT
+	{
+		.name = CFG_ELEMENT_BLUETOOTH,
+		.in_device_info = true,
+		.cache_ttl = NET_CACHE_TTL,
+		.get = bt_get_cb,
+		.prepare = bt_prepare_cb,
+		.apply = bt_apply_cb,
+		.rollback = bt_rollback_cb,
+		.release = bt_release_cb,
+	},
+#endif /* ENABLE_BT */
+};
+
+/******************** Device model ********************/
+
+/*
+ * find_entry() - Find a registered element by name
+ *
+ * @name:	Element name.
+ *
+ * Return: The entry, NULL if not registered.
+ */
+static dm_entry_t *find_entry(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < n_entries; i++) {
+		if (strcmp(entries[i].element.name, name) == 0)
+			return &entries[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * invalidate_entry() - Discard the cached views of an entry
+ *
+ * @entry:	Entry to invalidate.
+ */
+static void invalidate_entry(dm_entry_t *entry)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		json_object_put(entry->view[i]);
+		entry->view[i] = NULL;
+	}
+}
+
+/*
+ * get_entry_view() - Get the state of an element, reusing the cached one if fresh
+ *
+ * @entry:	Entry to get the state of.
+ * @complete:	True for the 'get_config' view, false for the 'device_info' one.
+ *
+ * Must be called with the device model lock held.
+ *
+ * Return: The JSON object owned by the cache, NULL if out of memory.
+ */
+static json_object *get_entry_view(dm_entry_t *entry, bool complete)
+{
+	time_t now = get_monotonic_sec();
+	json_object *view = entry->view[complete];
+
+	if (view != NULL
+		&& (entry->element.cache_ttl == 0 || now - entry->stamp[complete] < (time_t)entry->element.cache_ttl))
+		return view;
+
+	view = json_object_new_object();
+	if (!view)
+		return NULL;
+
+	if (entry->element.get(view, complete) != DM_ERROR_NONE) {
+		json_object_put(view);
+		return NULL;
+	}
+
+	json_object_put(entry->view[complete]);
+	entry->view[complete] = view;
+	entry->stamp[complete] = now;
+
+	return view;
+}
+
+int dm_register_element(const dm_element_t *element)
+{
+	dm_entry_t *entry;
+	int ret = 0;
+
+	if (!element || !element->name || !element->get
+		|| (element->prepare && (!element->apply || !element->rollback || !element->release)))
+		return -1;
+
+	pthread_mutex_lock(&dm_lock);
+
+	entry = find_entry(element->name);
+	if (entry) {
+		invalidate_entry(entry);
+	} else {
+		dm_entry_t *tmp = realloc(entries, (n_entries + 1) * sizeof(*entries));
+
+		if (!tmp) {
+			ret = -1;
+			goto done;
+		}
+		entries = tmp;
+		entry = &entries[n_entries++];
+		memset(entry, 0, sizeof(*entry));
+	}
+	entry->element = *element;
+
+	log_dm_debug("Registered device model element '%s'", element->name);
+
+done:
+	pthread_mutex_unlock(&dm_lock);
+
+	return ret;
+}
+
+void dm_invalidate_element(const char *name)
+{
+	size_t i;
+
+	pthread_mutex_lock(&dm_lock);
+	for (i = 0; i < n_entries; i++) {
+		if (!name || strcmp(entries[i].element.name, name) == 0)
+			invalidate_entry(&entries[i]);
+	}
+	pthread_mutex_unlock(&dm_lock);
+}
+
+/*
+ * set_response() - Serialize the response JSON into the response buffer
+ *
+ * @resp_buffer:	Buffer to store the answer of the request.
+ * @resp:		JSON response, NULL to use @fallback.
+ * @fallback:		Plain text response if @resp is NULL.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int set_response(ccapi_buffer_info_t *const resp_buffer, json_object *resp, const char *fallback)
+{
+	resp_buffer->buffer = strdup(resp ? json_object_to_json_string(resp) : fallback);
+	if (resp_buffer->buffer == NULL) {
+		resp_buffer->length = 0;
+		return -1;
+	}
+
+	resp_buffer->length = strlen(resp_buffer->buffer);
+
+	log_dm_debug("response: %s (len: %zu)", (char *)resp_buffer->buffer, resp_buffer->length);
+
+	return 0;
+}
+
+/*
+ * parse_request() - Parse the JSON of a data request
+ *
+ * @req_buffer:	Buffer containing the data request.
+ *
+ * Return: The JSON object, NULL if it is not a valid JSON object.
+ */
+static json_object *parse_request(ccapi_buffer_info_t const *const req_buffer)
+{
+	json_object *req;
+	char *request;
+
+	if (req_buffer->length == 0)
+		return NULL;
+
+	request = strndup(req_buffer->buffer, req_buffer->length);
+	if (!request)
+		return NULL;
+
+	req = json_tokener_parse(request);
+	free(request);
+
+	if (req && !json_object_is_type(req, json_type_object)) {
+		json_object_put(req);
+		return NULL;
+	}
+
+	return req;
+}
+
+/*
+ * device_info_cb() - Data callback for 'builtin/device_info' data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @req_buffer:		Buffer containing the data request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * Response has the same format as the 'device_info' target of the demo
+ * applications: static device information plus the reduced view of every
+ * element registered with 'in_device_info'.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if success, any other code otherwise.
+ */
+static ccapi_receive_error_t device_info_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t const *const req_buffer,
+		ccapi_buffer_info_t *const resp_buffer)
+{
+	ccapi_receive_error_t status = CCAPI_RECEIVE_ERROR_NONE;
+	json_object *root = NULL;
+	size_t i;
+
+	UNUSED_ARGUMENT(req_buffer);
+
+	log_dm_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	pthread_mutex_lock(&dm_lock);
+
+	if (!static_info)
+		static_info = build_static_info();
+
+	root = json_object_new_object();
+	if (!root || !static_info || merge_json(root, static_info) != 0)
+		goto error;
+
+	for (i = 0; i < n_entries; i++) {
+		json_object *view;
+
+		if (!entries[i].element.in_device_info)
+			continue;
+
+		view = get_entry_view(&entries[i], false);
+		if (!view || merge_json(root, view) != 0)
+			goto error;
+	}
+
+	if (set_response(resp_buffer, root, NULL) != 0)
+		goto error;
+
+	goto done;
+
+error:
+	status = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	log_dm_error("Cannot generate response for target '%s': Out of memory", target);
+
+done:
+	pthread_mutex_unlock(&dm_lock);
+
+	json_object_put(root);
+
+	return status;
+}
+
+/*
+ * get_config_cb() - Data callback for 'builtin/get_config' data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @req_buffer:		Buffer containing the data request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * Request: {"element": ["ethernet", "wifi"]}, empty to get all elements.
+ * Response: an object per requested element with its complete view.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if success, any other code otherwise.
+ */
+static ccapi_receive_error_t get_config_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t const *const req_buffer,
+		ccapi_buffer_info_t *const resp_buffer)
+{
+	ccapi_receive_error_t status = CCAPI_RECEIVE_ERROR_NONE;
+	json_object *req = NULL, *json_element = NULL, *resp = NULL;
+	bool *selected = NULL;
+	bool any = false;
+	size_t i;
+
+	log_dm_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	pthread_mutex_lock(&dm_lock);
+
+	selected = calloc(n_entries + 1, sizeof(*selected));
+	if (!selected)
+		goto error;
+
+	if (req_buffer->length == 0) {
+		for (i = 0; i < n_entries; i++)
+			selected[i] = true;
+		any = n_entries > 0;
+	} else {
+		int len, j;
+
+		req = parse_request(req_buffer);
+		if (!req)
+			goto bad_format;
+
+		if (!json_object_object_get_ex(req, "element", &json_element)
+		    || !json_object_is_type(json_element, json_type_array))
+			goto bad_format;
+
+		len = json_object_array_length(json_element);
+		for (j = 0; j < len; j++) {
+			json_object *item = json_object_array_get_idx(json_element, j);
+			dm_entry_t *entry;
+
+			if (!json_object_is_type(item, json_type_string))
+				continue;
+
+			entry = find_entry(json_object_get_string(item));
+			if (!entry)
+				continue;
+
+			selected[entry - entries] = true;
+			any = true;
+		}
+	}
+
+	if (!any)
+		goto bad_format;
+
+	resp = json_object_new_object();
+	if (!resp)
+		goto error;
+
+	for (i = 0; i < n_entries; i++) {
+		json_object *view;
+
+		if (!selected[i])
+			continue;
+
+		view = get_entry_view(&entries[i], true);
+		if (!view || json_object_object_add(resp, entries[i].element.name, json_object_get(view)) < 0)
+			goto error;
+	}
+
+	if (set_response(resp_buffer, resp, NULL) != 0)
+		goto error;
+
+	goto done;
+
+bad_format:
+	status = set_response(resp_buffer, NULL, "Invalid format") != 0 ?
+		CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY : CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+	log_dm_error("Cannot parse request for target '%s': Invalid format", target);
+	goto done;
+
+error:
+	status = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	log_dm_error("Cannot generate response for target '%s': Out of memory", target);
+
+done:
+	pthread_mutex_unlock(&dm_lock);
+
+	free(selected);
+	json_object_put(resp);
+	json_object_put(req);
+
+	return status;
+}
+
+/*
+ * set_config_cb() - Data callback for 'builtin/set_config' data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @req_buffer:		Buffer containing the data request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * Request has the same format as the 'set_config' target of the demo
+ * applications. The change is applied as a transaction: every element is
+ * validated before touching the device, and if any of them fails to apply,
+ * the already applied ones are restored to their previous configuration and
+ * marked with '"rolled_back": true' in the response.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if success, any other code otherwise.
+ */
+static ccapi_receive_error_t set_config_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t const *const req_buffer,
+		ccapi_buffer_info_t *const resp_buffer)
+{
+	ccapi_receive_error_t status = CCAPI_RECEIVE_ERROR_NONE;
+	json_object *req = NULL, *resp = NULL;
+	json_object **items = NULL;
+	void **ctxs = NULL;
+	bool *prepared = NULL;
+	size_t i, n_applied = 0;
+	int ret = DM_ERROR_NONE;
+	bool any = false;
+
+	log_dm_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	pthread_mutex_lock(&dm_lock);
+
+	req = parse_request(req_buffer);
+	if (!req || json_object_object_length(req) == 0)
+		goto bad_format;
+
+	resp = json_object_new_object();
+	items = calloc(n_entries + 1, sizeof(*items));
+	ctxs = calloc(n_entries + 1, sizeof(*ctxs));
+	prepared = calloc(n_entries + 1, sizeof(*prepared));
+	if (!resp || !items || !ctxs || !prepared)
+		goto error;
+
+	/* Validate everything and take a snapshot before changing anything */
+	for (i = 0; i < n_entries; i++) {
+		json_object *json_element = NULL;
+		const dm_element_t *element = &entries[i].element;
+
+		if (!element->prepare || !json_object_object_get_ex(req, element->name, &json_element))
+			continue;
+
+		items[i] = add_json_element(element->name, resp);
+		if (!items[i])
+			goto error;
+
+		ret = element->prepare(json_element, items[i], &ctxs[i]);
+		if (ret == DM_ERROR_BAD_FORMAT)
+			goto bad_format;
+		if (ret != DM_ERROR_NONE)
+			goto error;
+
+		prepared[i] = true;
+		any = true;
+	}
+
+	if (!any)
+		goto bad_format;
+
+	for (i = 0; i < n_entries && ret == DM_ERROR_NONE; i++) {
+		if (!prepared[i])
+			continue;
+
+		ret = entries[i].element.apply(ctxs[i], items[i]);
+		n_applied = i + 1;
+		invalidate_entry(&entries[i]);
+	}
+
+	if (ret != DM_ERROR_NONE) {
+		log_dm_error("Cannot apply request for target '%s', restoring previous configuration", target);
+		for (i = n_applied; i > 0; i--) {
+			if (!prepared[i - 1])
+				continue;
+
+			entries[i - 1].element.rollback(ctxs[i - 1]);
+			add_bool(items[i - 1], CFG_FIELD_ROLLED_BACK, true);
+		}
+		if (ret == DM_ERROR_NO_MEMORY)
+			goto error;
+	}
+
+	if (set_response(resp_buffer, resp, NULL) != 0)
+		goto error;
+
+	goto done;
+
+bad_format:
+	status = set_response(resp_buffer, NULL, "Invalid format") != 0 ?
+		CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY : CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+	log_dm_error("Cannot parse request for target '%s': Invalid format", target);
+	goto done;
+
+error:
+	set_response(resp_buffer, NULL, "Out of memory");
+	status = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	log_dm_error("Cannot process request for target '%s': Out of memory", target);
+
+done:
+	for (i = 0; prepared && i < n_entries; i++) {
+		if (prepared[i])
+			entries[i].element.release(ctxs[i]);
+	}
+
+	pthread_mutex_unlock(&dm_lock);
+
+	free(items);
+	free(ctxs);
+	free(prepared);
+	json_object_put(resp);
+	json_object_put(req);
+
+	return status;
+}
+
+/*
+ * request_status_cb() - Status callback for device management data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @resp_buffer:	Buffer containing the response data.
+ * @receive_error:	The error status of the receive process.
+ *
+ * Cleans and frees the response buffer.
+ */
+static void request_status_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t *const resp_buffer,
+		ccapi_receive_error_t receive_error)
+{
+	log_dm_debug("%s: target='%s' - transport='%d' - error='%d'", __func__,
+		target, transport, receive_error);
+
+	/* Free the response buffer */
+	if (resp_buffer)
+		free(resp_buffer->buffer);
+}
+
+static const struct {
+	const char *target;
+	ccapi_receive_data_cb_t data_cb;
+} dm_targets[] = {
+	{ TARGET_DEVICE_INFO, device_info_cb },
+	{ TARGET_GET_CONFIG, get_config_cb },
+	{ TARGET_SET_CONFIG, set_config_cb },
+};
+
+ccapi_receive_error_t register_device_mgmt_requests(void)
+{
+	ccapi_receive_error_t error = CCAPI_RECEIVE_ERROR_NONE;
+	size_t i;
+
+	if (!builtin_registered) {
+		for (i = 0; i < ARRAY_SIZE(builtin_elements); i++) {
+			if (dm_register_element(&builtin_elements[i]) != 0) {
+				log_dm_error("Cannot register device model element '%s'",
+					builtin_elements[i].name);
+				return CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+			}
+		}
+		builtin_registered = true;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(dm_targets); i++) {
+		error = ccapi_receive_add_target(dm_targets[i].target, dm_targets[i].data_cb,
+			request_status_cb, CCAPI_RECEIVE_NO_LIMIT);
+		if (error == CCAPI_RECEIVE_ERROR_TARGET_ALREADY_ADDED) {
+			log_dm_warning("Target '%s' already registered", dm_targets[i].target);
+		} else if (error != CCAPI_RECEIVE_ERROR_NONE) {
+			log_dm_error("Cannot register target '%s', error %d", dm_targets[i].target, error);
+			break;
+		}
+	}
+
+	return error;
+}
+
+void unregister_device_mgmt_requests(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(dm_targets); i++) {
+		ccapi_receive_error_t error = ccapi_receive_remove_target(dm_targets[i].target);
+
+		if (error != CCAPI_RECEIVE_ERROR_NONE)
+			log_dm_error("Could not remove registered target '%s' (%d)",
+				dm_targets[i].target, error);
+	}
+
+	dm_invalidate_element(NULL);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef DEVICE_MGMT_H_
+#define DEVICE_MGMT_H_
+
+#include <cloudconnector.h>
+#include <json_object.h>
+#include <stdbool.h>
+
+#define DM_ERROR_NONE		0
+#define DM_ERROR_BAD_FORMAT	-1
+#define DM_ERROR_NO_MEMORY	-2
+#define DM_ERROR_APPLY		-3
+
+/*
+ * dm_get_cb_t - Fill the state of a device model element
+ *
+ * @item:	JSON object to add the element fields to.
+ * @complete:	True for the 'get_config' view, false for the reduced
+ *		'device_info' one.
+ *
+ * Return: DM_ERROR_NONE on success, DM_ERROR_NO_MEMORY otherwise.
+ */
+typedef int (*dm_get_cb_t)(json_object *item, bool complete);
+
+/*
+ * dm_prepare_cb_t - Validate a 'set_config' request for an element
+ *
+ * @req:	JSON object with the requested configuration for the element.
+ * @resp:	JSON object to report per-entry results.
+ * @ctx:	Pointer to store the element private transaction data.
+ *
+ * It must not modify the device. It is expected to store in @ctx both the
+ * new configuration and a snapshot of the current one to roll back to.
+ *
+ * Return: DM_ERROR_NONE on success, DM_ERROR_BAD_FORMAT or DM_ERROR_NO_MEMORY
+ *         otherwise.
+ */
+typedef int (*dm_prepare_cb_t)(json_object *req, json_object *resp, void **ctx);
+
+/*
+ * dm_apply_cb_t - Apply a prepared configuration
+ *
+ * @ctx:	Transaction data returned by the prepare callback.
+ * @resp:	JSON object to report per-entry results.
+ *
+ * Return: DM_ERROR_NONE on success, DM_ERROR_APPLY or DM_ERROR_NO_MEMORY
+ *         otherwise.
+ */
+typedef int (*dm_apply_cb_t)(void *ctx, json_object *resp);
+
+/*
+ * dm_rollback_cb_t - Restore the configuration captured by the prepare callback
+ *
+ * @ctx:	Transaction data returned by the prepare callback.
+ *
+ * It is called for an element whose apply callback was run, even if it
+ * failed, so it must only restore the entries already applied.
+ */
+typedef void (*dm_rollback_cb_t)(void *ctx);
+
+/*
+ * dm_release_cb_t - Free the transaction data of an element
+ *
+ * @ctx:	Transaction data returned by the prepare callback.
+ */
+typedef void (*dm_release_cb_t)(void *ctx);
+
+/*
+ * struct dm_element_t - Device model element
+ *
+ * @name:		Element name in 'get_config' and 'set_config' requests.
+ * @in_device_info:	True to also report the reduced view in 'device_info'.
+ * @cache_ttl:		Seconds a generated view is reused, 0 to never expire.
+ * @get:		Callback to read the element state.
+ * @prepare:		Callback to validate a new configuration, NULL if the
+ *			element is read-only.
+ * @apply:		Callback to apply a prepared configuration.
+ * @rollback:		Callback to restore the previous configuration.
+ * @release:		Callback to free the transaction data.
+ */
+typedef struct {
+	const char *name;
+	bool in_device_info;
+	unsigned int cache_ttl;
+	dm_get_cb_t get;
+	dm_prepare_cb_t prepare;
+	dm_apply_cb_t apply;
+	dm_rollback_cb_t rollback;
+	dm_release_cb_t release;
+} dm_element_t;
+
+/*
+ * dm_register_element() - Add an element to the device model
+ *
+ * @element:	Element to register. It is copied, but its name must remain
+ *		valid while registered.
+ *
+ * Built-in elements are 'ethernet', 'wifi' and 'bluetooth'. Registering an
+ * element with an existing name replaces it.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int dm_register_element(const dm_element_t *element);
+
+/*
+ * dm_invalidate_element() - Discard the cached views of an element
+ *
+ * @name:	Element name, NULL to invalidate all of them.
+ */
+void dm_invalidate_element(const char *name);
+
+/*
+ * register_device_mgmt_requests() - Register built-in device management targets
+ *
+ * Return: Error code after registering the data requests.
+ */
+ccapi_receive_error_t register_device_mgmt_requests(void);
+
+/*
+ * unregister_device_mgmt_requests() - Unregister built-in device management targets
+ */
+void unregister_device_mgmt_requests(void);
+
+#endif /* DEVICE_MGMT_H_ */
@@ -0,0 +1,1446 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <json_object.h>
+#include <json_tokener.h>
+#include <limits.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "_cc_datapoints.h"
+#include "_utils.h"
+#include "diagnostics.h"
+
+#define DIAG_TAG			"DIAG:"
+
+#define TARGET_DIAGNOSTICS		"builtin/diagnostics"
+#define DP_DIAGNOSTICS_STREAM_ID	"management/events/diagnostics"
+
+#define DEFAULT_CONFIG_FILE		"/etc/cccs.conf"
+#define DEFAULT_CLOUD_DIR		"diagnostics"
+#define DEFAULT_RANGE_SEC		(24 * 60 * 60)
+#define DEFAULT_MAX_SIZE		(4 * 1024 * 1024)
+#define MAX_MAX_SIZE			(64 * 1024 * 1024)
+#define DEFAULT_NICE			10
+#define MAX_CLOUD_PATH			255
+
+/* Compressed data is uploaded in chunks of this size */
+#define CHUNK_SIZE			(64 * 1024)
+/* Room kept under the size cap for the manifest and the archive trailer */
+#define RESERVED_SIZE			(16 * 1024)
+/* Maximum uncompressed size of a text entry, relative to the size cap */
+#define MAX_TEXT_RATIO			10
+/* Minimum time between progress events */
+#define PROGRESS_PERIOD_SEC		5
+#define SEND_TIMEOUT_SEC		30
+
+#define TAR_BLOCK			512
+#define TAR_NAME_LEN			100
+
+#define SYSLOG_FILES			{ "/var/log/messages.0", "/var/log/messages" }
+#define JOURNALCTL_CMD			"journalctl --no-pager -q -o short-iso --since @%lld --until @%lld 2>/dev/null"
+#define JOURNALCTL_PATHS		{ "/bin/journalctl", "/usr/bin/journalctl" }
+
+#define REDACTED			"[REDACTED]"
+#define MASKED_VALUE			"\"********\""
+/* Configuration settings whose value is masked */
+#define SECRET_KEYS_REGEX		"^[[:space:]]*[a-z_]*(pass|psk|secret|token|private|credential)[a-z_]*[[:space:]]*="
+
+/* I/O priority, see linux/ioprio.h */
+#define IOPRIO_CLASS_SHIFT		13
+#define IOPRIO_CLASS_BE			2
+#define IOPRIO_CLASS_IDLE		3
+#define IOPRIO_WHO_PROCESS		1
+#define IOPRIO_PRIO_VALUE(class, data)	(((class) << IOPRIO_CLASS_SHIFT) | (data))
+
+#if !(defined UNUSED_ARGUMENT)
+#define UNUSED_ARGUMENT(a)	(void)(a)
+#endif
+
+#if !(defined ARRAY_SIZE)
+#define ARRAY_SIZE(array)	(sizeof array/sizeof array[0])
+#endif
+
+/**
+ * log_diag_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_diag_debug(format, ...)				\
+	log_debug("%s " format, DIAG_TAG, __VA_ARGS__)
+
+/**
+ * log_diag_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_diag_info(format, ...)				\
+	log_info("%s " format, DIAG_TAG, __VA_ARGS__)
+
+/**
+ * log_diag_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_diag_error(format, ...)				\
+	log_error("%s " format, DIAG_TAG, __VA_ARGS__)
+
+extern cc_cfg_t *cc_cfg;
+
+typedef enum {
+	SRC_LOGS,
+	SRC_CONFIG,
+	SRC_PROC,
+	SRC_BACKLOG,
+	SRC_COUNT
+} diag_source_t;
+
+#define SRC_ALL			((1 << SRC_COUNT) - 1)
+
+static const char * const source_names[] = {
+	[SRC_LOGS] = "logs",
+	[SRC_CONFIG] = "config",
+	[SRC_PROC] = "proc",
+	[SRC_BACKLOG] = "backlog",
+};
+
+static const char * const proc_files[] = {
+	"/proc/version", "/proc/cmdline", "/proc/uptime", "/proc/loadavg",
+	"/proc/meminfo", "/proc/vmstat", "/proc/buddyinfo", "/proc/stat",
+	"/proc/interrupts", "/proc/mounts", "/proc/net/dev", "/proc/net/route",
+	"/proc/pressure/cpu", "/proc/pressure/memory", "/proc/pressure/io",
+	"/proc/self/status", "/proc/self/limits",
+};
+
+/*
+ * struct diag_spec_t - Diagnostic bundle request
+ *
+ * @cloud_path:	Remote Manager file path to upload the bundle to.
+ * @from:	Start of the log time range (epoch seconds).
+ * @to:		End of the log time range (epoch seconds).
+ * @sources:	Bitmask of sources to include.
+ * @max_size:	Approximate maximum size of the compressed bundle.
+ * @redact:	Compiled redaction rules.
+ * @n_redact:	Number of redaction rules.
+ * @nice:	CPU nice level of the collection, also used for its I/O priority.
+ */
+typedef struct {
+	char *cloud_path;
+	time_t from;
+	time_t to;
+	unsigned int sources;
+	size_t max_size;
+	regex_t *redact;
+	size_t n_redact;
+	int nice;
+} diag_spec_t;
+
+/*
+ * struct diag_text_t - Text source of the bundle
+ *
+ * @path:	File to read, or command to run if @command is true.
+ * @command:	True if @path is a command whose output is read.
+ * @is_log:	True to filter lines by the log time range.
+ * @is_config:	True to mask the value of secret settings.
+ */
+typedef struct {
+	const char *path;
+	bool command;
+	bool is_log;
+	bool is_config;
+} diag_text_t;
+
+/*
+ * struct diag_archive_t - Compressed tar archive being uploaded
+ *
+ * @spec:		Bundle request.
+ * @zs:			Compressor state.
+ * @out:		Compressed data pending to upload.
+ * @uploaded:		Compressed bytes already uploaded.
+ * @raw:		Uncompressed bytes written to the archive.
+ * @last_progress:	Time of the last progress event.
+ * @manifest:		Array describing the archive entries.
+ * @full:		True once the size cap is reached.
+ * @failed:		True if an upload failed.
+ */
+typedef struct {
+	const diag_spec_t *spec;
+	z_stream zs;
+	unsigned char out[CHUNK_SIZE];
+	size_t uploaded;
+	size_t raw;
+	time_t last_progress;
+	json_object *manifest;
+	bool full;
+	bool failed;
+} diag_archive_t;
+
+static const char *config_path = NULL;
+static regex_t secret_keys_re;
+static bool secret_keys_re_valid = false;
+
+static pthread_t diag_thread;
+static bool diag_thread_valid = false;
+static bool diag_running = false;
+static volatile bool stop_requested = false;
+static pthread_mutex_t diag_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * get_monotonic_sec() - Get the seconds of the monotonic clock
+ *
+ * Return: Seconds since an unspecified starting point.
+ */
+static time_t get_monotonic_sec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec;
+}
+
+/*
+ * free_spec() - Free a bundle request
+ *
+ * @spec:	The request to free.
+ */
+static void free_spec(diag_spec_t *spec)
+{
+	size_t i;
+
+	if (!spec)
+		return;
+
+	for (i = 0; i < spec->n_redact; i++)
+		regfree(&spec->redact[i]);
+	free(spec->redact);
+	free(spec->cloud_path);
+	free(spec);
+}
+
+/*
+ * valid_cloud_path() - Check a Remote Manager file path
+ *
+ * @path:	The path to check.
+ *
+ * Return: True if it is a relative path without '..' components.
+ */
+static bool valid_cloud_path(const char *path)
+{
+	size_t len = strlen(path);
+
+	return len > 0 && len <= MAX_CLOUD_PATH && path[0] != '/'
+		&& path[len - 1] != '/' && strstr(path, "..") == NULL;
+}
+
+/*
+ * parse_spec() - Parse a diagnostic bundle request
+ *
+ * @req:	JSON object of the request.
+ * @error:	Pointer to store the reason if the request is invalid.
+ *
+ * Return: The request, NULL if invalid or out of memory.
+ */
+static diag_spec_t *parse_spec(json_object *req, const char **error)
+{
+	diag_spec_t *spec = calloc(1, sizeof(*spec));
+	json_object *item = NULL;
+	time_t now = time(NULL);
+
+	*error = "Out of memory";
+	if (!spec)
+		return NULL;
+
+	spec->to = now;
+	spec->from = now - DEFAULT_RANGE_SEC;
+	spec->sources = SRC_ALL;
+	spec->max_size = DEFAULT_MAX_SIZE;
+	spec->nice = DEFAULT_NICE;
+
+	if (json_object_object_get_ex(req, "path", &item)) {
+		const char *path = json_object_get_string(item);
+
+		if (!json_object_is_type(item, json_type_string) || !valid_cloud_path(path)) {
+			*error = "Invalid 'path'";
+			goto error;
+		}
+		spec->cloud_path = strdup(path);
+	} else {
+		char name[64];
+
+		strftime(name, sizeof(name), DEFAULT_CLOUD_DIR "/%Y%m%dT%H%M%SZ.tar.gz", gmtime(&now));
+		spec->cloud_path = strdup(name);
+	}
+	if (!spec->cloud_path)
+		goto error;
+
+	if (json_object_object_get_ex(req, "to", &item)) {
+		if (!json_object_is_type(item, json_type_int)) {
+			*error = "Invalid 'to'";
+			goto error;
+		}
+		spec->to = json_object_get_int64(item);
+		spec->from = spec->to - DEFAULT_RANGE_SEC;
+	}
+
+	if (json_object_object_get_ex(req, "from", &item)) {
+		if (!json_object_is_type(item, json_type_int)) {
+			*error = "Invalid 'from'";
+			goto error;
+		}
+		spec->from = json_object_get_int64(item);
+	}
+
+	if (spec->from > spec->to) {
+		*error = "Invalid time range";
+		goto error;
+	}
+
+	if (json_object_object_get_ex(req, "sources", &item)) {
+		size_t i, n;
+
+		if (!json_object_is_type(item, json_type_array)) {
+			*error = "Invalid 'sources'";
+			goto error;
+		}
+
+		spec->sources = 0;
+		n = json_object_array_length(item);
+		for (i = 0; i < n; i++) {
+			const char *name = json_object_get_string(json_object_array_get_idx(item, i));
+			int s;
+
+			for (s = 0; s < SRC_COUNT; s++) {
+				if (name && !strcmp(name, source_names[s]))
+					break;
+			}
+			if (s == SRC_COUNT) {
+				*error = "Unknown source";
+				goto error;
+			}
+			spec->sources |= 1 << s;
+		}
+	}
+
+	if (json_object_object_get_ex(req, "max_size", &item)) {
+		int64_t size = json_object_get_int64(item);
+
+		if (!json_object_is_type(item, json_type_int)
+			|| size < 2 * RESERVED_SIZE || size > MAX_MAX_SIZE) {
+			*error = "Invalid 'max_size'";
+			goto error;
+		}
+		spec->max_size = size;
+	}
+
+	if (json_object_object_get_ex(req, "nice", &item)) {
+		int nice = json_object_get_int(item);
+
+		if (!json_object_is_type(item, json_type_int) || nice < 0 || nice > 19) {
+			*error = "Invalid 'nice'";
+			goto error;
+		}
+		spec->nice = nice;
+	}
+
+	if (json_object_object_get_ex(req, "redact", &item)) {
+		size_t i, n;
+
+		if (!json_object_is_type(item, json_type_array)) {
+			*error = "Invalid 'redact'";
+			goto error;
+		}
+
+		n = json_object_array_length(item);
+		spec->redact = calloc(n + 1, sizeof(*spec->redact));
+		if (!spec->redact) {
+			*error = "Out of memory";
+			goto error;
+		}
+		for (i = 0; i < n; i++) {
+			const char *rule = json_object_get_string(json_object_array_get_idx(item, i));
+
+			if (!rule || *rule == '\0'
+				|| regcomp(&spec->redact[i], rule, REG_EXTENDED) != 0) {
+				*error = "Invalid redaction rule";
+				goto error;
+			}
+			spec->n_redact++;
+		}
+	}
+
+	*error = NULL;
+
+	return spec;
+
+error:
+	free_spec(spec);
+
+	return NULL;
+}
+
+/*
+ * set_priority() - Lower the CPU and I/O priority of the calling thread
+ *
+ * @nice:	Nice level, 0-19.
+ */
+static void set_priority(int nice)
+{
+	pid_t tid = syscall(SYS_gettid);
+	int ioprio;
+
+	if (setpriority(PRIO_PROCESS, tid, nice) != 0)
+		log_diag_debug("Unable to set nice level %d: %s (%d)", nice, strerror(errno), errno);
+
+	/* Same mapping the kernel uses for tasks without an explicit I/O priority */
+	if (nice == 19)
+		ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+	else
+		ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, (nice + 20) / 5);
+
+	if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio) != 0)
+		log_diag_debug("Unable to set I/O priority: %s (%d)", strerror(errno), errno);
+}
+
+/*
+ * report_progress() - Send a progress event of the bundle
+ *
+ * @spec:	Bundle request.
+ * @status:	'in_progress', 'done' or 'failed'.
+ * @bytes:	Compressed bytes uploaded.
+ * @detail:	Error description or NULL.
+ */
+static void report_progress(const diag_spec_t *spec, const char *status,
+	size_t bytes, const char *detail)
+{
+	json_object *event = json_object_new_object();
+
+	if (!event
+		|| json_object_object_add(event, "path", json_object_new_string(spec->cloud_path)) < 0
+		|| json_object_object_add(event, "status", json_object_new_string(status)) < 0
+		|| json_object_object_add(event, "bytes", json_object_new_int64(bytes)) < 0
+		|| (detail && json_object_object_add(event, "error", json_object_new_string(detail)) < 0)) {
+		log_diag_error("Unable to report bundle progress: %s", "Out of memory");
+		goto done;
+	}
+
+	if (dp_send_json_event(DP_DIAGNOSTICS_STREAM_ID, json_object_to_json_string(event)) != 0)
+		log_diag_debug("Unable to report bundle progress '%s'", status);
+
+done:
+	json_object_put(event);
+}
+
+/*
+ * upload_chunk() - Upload the pending compressed data
+ *
+ * @ar:		The archive.
+ *
+ * The first chunk overwrites any existing file, the rest are appended.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int upload_chunk(diag_archive_t *ar)
+{
+	size_t len = sizeof(ar->out) - ar->zs.avail_out;
+	ccapi_send_error_t error;
+	ccapi_string_info_t hint_info;
+	char hint[256];
+	time_t now;
+
+	if (len == 0 || ar->failed)
+		return ar->failed ? -1 : 0;
+
+	hint[0] = '\0';
+	hint_info.length = sizeof(hint);
+	hint_info.string = hint;
+
+	error = ccapi_send_data_with_reply(CCAPI_TRANSPORT_TCP, ar->spec->cloud_path,
+		"application/gzip", ar->out, len,
+		ar->uploaded == 0 ? CCAPI_SEND_BEHAVIOR_OVERWRITE : CCAPI_SEND_BEHAVIOR_APPEND,
+		SEND_TIMEOUT_SEC, &hint_info);
+	if (error != CCAPI_SEND_ERROR_NONE) {
+		log_diag_error("Unable to upload '%s': error %d %s", ar->spec->cloud_path, error, hint);
+		ar->failed = true;
+		return -1;
+	}
+
+	ar->uploaded += len;
+	ar->zs.next_out = ar->out;
+	ar->zs.avail_out = sizeof(ar->out);
+
+	now = get_monotonic_sec();
+	if (now - ar->last_progress >= PROGRESS_PERIOD_SEC) {
+		report_progress(ar->spec, "in_progress", ar->uploaded, NULL);
+		ar->last_progress = now;
+	}
+
+	return 0;
+}
+
+/*
+ * archive_compress() - Compress data into the archive
+ *
+ * @ar:		The archive.
+ * @data:	Data to compress.
+ * @len:	Number of bytes of @data.
+ * @flush:	Z_NO_FLUSH or Z_FINISH.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int archive_compress(diag_archive_t *ar, const void *data, size_t len, int flush)
+{
+	int ret;
+
+	ar->zs.next_in = (Bytef *)data;
+	ar->zs.avail_in = len;
+	ar->raw += len;
+
+	do {
+		if (ar->zs.avail_out == 0 && upload_chunk(ar) != 0)
+			return -1;
+
+		ret = deflate(&ar->zs, flush);
+		if (ret == Z_STREAM_ERROR)
+			return -1;
+	} while (ar->zs.avail_in > 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+
+	return flush == Z_FINISH ? upload_chunk(ar) : 0;
+}
+
+/*
+ * archive_size() - Approximate compressed size of the archive
+ *
+ * @ar:		The archive.
+ *
+ * Return: Bytes uploaded plus compressed bytes pending.
+ */
+static size_t archive_size(const diag_archive_t *ar)
+{
+	return ar->uploaded + sizeof(ar->out) - ar->zs.avail_out;
+}
+
+/*
+ * archive_room() - Check if there is room for more data in the archive
+ *
+ * @ar:		The archive.
+ *
+ * Return: True if the size cap is not reached.
+ */
+static bool archive_room(diag_archive_t *ar)
+{
+	if (!ar->full && archive_size(ar) + RESERVED_SIZE >= ar->spec->max_size) {
+		log_diag_info("Bundle '%s' reached its size cap", ar->spec->cloud_path);
+		ar->full = true;
+	}
+
+	return !ar->full;
+}
+
+/*
+ * archive_begin_entry() - Write the tar header of a regular file
+ *
+ * @ar:		The archive.
+ * @name:	Name of the file in the archive.
+ * @size:	Size of the file.
+ * @mtime:	Modification time of the file.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int archive_begin_entry(diag_archive_t *ar, const char *name, size_t size, time_t mtime)
+{
+	unsigned char header[TAR_BLOCK];
+	unsigned int checksum = 0;
+	size_t i;
+
+	if (strlen(name) >= TAR_NAME_LEN)
+		return -1;
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, name, strlen(name));
+	sprintf((char *)header + 100, "%07o", 0644);
+	sprintf((char *)header + 108, "%07o", 0);
+	sprintf((char *)header + 116, "%07o", 0);
+	sprintf((char *)header + 124, "%011llo", (unsigned long long)size);
+	sprintf((char *)header + 136, "%011llo", (unsigned long long)(mtime > 0 ? mtime : 0));
+	header[156] = '0';
+	memcpy(header + 257, "ustar", 6);
+	memcpy(header + 263, "00", 2);
+	memcpy(header + 265, "root", 4);
+	memcpy(header + 297, "root", 4);
+
+	/* Checksum is computed with its own field filled with spaces */
+	memset(header + 148, ' ', 8);
+	for (i = 0; i < sizeof(header); i++)
+		checksum += header[i];
+	sprintf((char *)header + 148, "%06o", checksum);
+	header[155] = ' ';
+
+	return archive_compress(ar, header, sizeof(header), Z_NO_FLUSH);
+}
+
+/*
+ * archive_end_entry() - Complete an entry up to its declared size
+ *
+ * @ar:		The archive.
+ * @written:	Bytes of the entry already written.
+ * @size:	Declared size of the entry.
+ * @fill:	Byte to pad the entry with if it is shorter than declared.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int archive_end_entry(diag_archive_t *ar, size_t written, size_t size, char fill)
+{
+	char pad[TAR_BLOCK];
+	size_t len;
+
+	memset(pad, fill, sizeof(pad));
+	while (written < size) {
+		len = size - written < sizeof(pad) ? size - written : sizeof(pad);
+		if (archive_compress(ar, pad, len, Z_NO_FLUSH) != 0)
+			return -1;
+		written += len;
+	}
+
+	len = size % TAR_BLOCK;
+	if (len == 0)
+		return 0;
+
+	memset(pad, 0, sizeof(pad));
+
+	return archive_compress(ar, pad, TAR_BLOCK - len, Z_NO_FLUSH);
+}
+
+/*
+ * add_manifest_entry() - Describe an archive entry in the manifest
+ *
+ * @ar:		The archive.
+ * @name:	Name of the entry.
+ * @size:	Bytes of real content.
+ * @truncated:	True if the content was cut by the size cap.
+ */
+static void add_manifest_entry(diag_archive_t *ar, const char *name, size_t size, bool truncated)
+{
+	json_object *entry = json_object_new_object();
+
+	if (!entry
+		|| json_object_object_add(entry, "name", json_object_new_string(name)) < 0
+		|| json_object_object_add(entry, "size", json_object_new_int64(size)) < 0
+		|| json_object_object_add(entry, "truncated", json_object_new_boolean(truncated)) < 0
+		|| json_object_array_add(ar->manifest, entry) < 0)
+		json_object_put(entry);
+}
+
+/*
+ * parse_log_time() - Get the timestamp of a log line
+ *
+ * @line:	The log line.
+ * @now:	Current time, to guess the year of syslog timestamps.
+ *
+ * Supports syslog ('Jan  2 15:04:05') and ISO 8601 ('2024-01-02T15:04:05')
+ * timestamps in local time.
+ *
+ * Return: The timestamp, -1 if the line does not start with one.
+ */
+static time_t parse_log_time(const char *line, time_t now)
+{
+	struct tm tm, now_tm;
+	time_t t;
+
+	memset(&tm, 0, sizeof(tm));
+	if (strptime(line, "%Y-%m-%dT%H:%M:%S", &tm) != NULL) {
+		tm.tm_isdst = -1;
+		return mktime(&tm);
+	}
+
+	memset(&tm, 0, sizeof(tm));
+	if (strptime(line, "%b %d %H:%M:%S", &tm) == NULL)
+		return -1;
+
+	localtime_r(&now, &now_tm);
+	tm.tm_year = now_tm.tm_year;
+	tm.tm_isdst = -1;
+	t = mktime(&tm);
+	/* Syslog lines do not include the year, they may be from last year */
+	if (t > now + 24 * 60 * 60) {
+		tm.tm_year--;
+		tm.tm_isdst = -1;
+		t = mktime(&tm);
+	}
+
+	return t;
+}
+
+/*
+ * redact_line() - Apply the redaction rules to a line
+ *
+ * @spec:	Bundle request.
+ * @line:	Pointer to the line, replaced if any rule matches.
+ * @size:	Pointer to the allocated size of the line.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int redact_line(const diag_spec_t *spec, char **line, size_t *size)
+{
+	size_t i;
+
+	for (i = 0; i < spec->n_redact; i++) {
+		regmatch_t match;
+		size_t offset = 0;
+
+		while ((*line)[offset] != '\0'
+			&& regexec(&spec->redact[i], *line + offset, 1, &match,
+				offset > 0 ? REG_NOTBOL : 0) == 0) {
+			size_t start = offset + match.rm_so, end = offset + match.rm_eo;
+			size_t len = strlen(*line);
+			size_t new_len = len - (end - start) + strlen(REDACTED);
+
+			if (new_len + 1 > *size) {
+				char *tmp = realloc(*line, new_len + 1);
+
+				if (!tmp)
+					return -1;
+				*line = tmp;
+				*size = new_len + 1;
+			}
+			memmove(*line + start + strlen(REDACTED), *line + end, len - end + 1);
+			memcpy(*line + start, REDACTED, strlen(REDACTED));
+			offset = start + strlen(REDACTED);
+			/* Avoid looping on empty matches */
+			if (end == start)
+				offset++;
+			if (offset > new_len)
+				break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * mask_config_line() - Mask the value of a secret configuration setting
+ *
+ * @line:	The configuration line, modified in place.
+ * @size:	Allocated size of the line.
+ */
+static void mask_config_line(char *line, size_t size)
+{
+	char *eq;
+
+	if (!secret_keys_re_valid || regexec(&secret_keys_re, line, 0, NULL, 0) != 0)
+		return;
+
+	eq = strchr(line, '=');
+	if (eq && (size_t)(eq - line) + strlen(MASKED_VALUE) + 3 <= size)
+		sprintf(eq + 1, " %s\n", MASKED_VALUE);
+}
+
+/*
+ * process_text() - Read a text source applying filters and redaction
+ *
+ * @ar:		The archive, NULL to only get the resulting size.
+ * @spec:	Bundle request.
+ * @src:	The text source.
+ * @limit:	Maximum number of bytes to write.
+ * @truncated:	Pointer to store if the size cap was reached, can be NULL.
+ *
+ * Return: Number of bytes of the processed content (written if @ar is not
+ *         NULL), -1 on error.
+ */
+static ssize_t process_text(diag_archive_t *ar, const diag_spec_t *spec,
+	const diag_text_t *src, size_t limit, bool *truncated)
+{
+	char *line = NULL;
+	size_t size = 0, total = 0;
+	bool in_range = false;
+	time_t now = time(NULL);
+	int error = 0;
+	FILE *fp;
+
+	if (src->command)
+		fp = popen(src->path, "r");
+	else
+		fp = fopen(src->path, "r");
+	if (!fp)
+		return -1;
+
+	while (!stop_requested && getline(&line, &size, fp) != -1) {
+		size_t len;
+
+		if (src->is_log) {
+			time_t t = parse_log_time(line, now);
+
+			/* Lines without timestamp belong to the previous one */
+			if (t != -1)
+				in_range = t >= spec->from && t <= spec->to;
+			if (!in_range)
+				continue;
+		}
+
+		if (src->is_config)
+			mask_config_line(line, size);
+
+		if (redact_line(spec, &line, &size) != 0) {
+			error = -1;
+			break;
+		}
+
+		len = strlen(line);
+		if (ar) {
+			if (len > limit - total)
+				len = limit - total;
+			if (!archive_room(ar)) {
+				if (truncated)
+					*truncated = true;
+				break;
+			}
+			if (archive_compress(ar, line, len, Z_NO_FLUSH) != 0) {
+				error = -1;
+				break;
+			}
+		}
+		total += len;
+		if (ar && total >= limit)
+			break;
+	}
+
+	free(line);
+	if (src->command)
+		pclose(fp);
+	else
+		fclose(fp);
+
+	return error ? -1 : (ssize_t)total;
+}
+
+/*
+ * add_text_entry() - Add a text source to the archive
+ *
+ * @ar:		The archive.
+ * @name:	Name of the entry in the archive.
+ * @src:	The text source.
+ *
+ * The source is read twice: first to know the size of the entry, then to
+ * write it, so nothing is held in memory. If the content changes between both
+ * reads, or the size cap is reached, it is padded with new lines to the
+ * declared size, which compress to almost nothing.
+ *
+ * Return: 0 on success or if the source is not available, -1 on archive errors.
+ */
+static int add_text_entry(diag_archive_t *ar, const char *name, const diag_text_t *src)
+{
+	bool truncated = false;
+	ssize_t size, written;
+
+	if (stop_requested || !archive_room(ar))
+		return 0;
+
+	size = process_text(NULL, ar->spec, src, 0, NULL);
+	if (size < 0) {
+		log_diag_debug("Skipping '%s': not available", src->path);
+		return 0;
+	}
+	if ((size_t)size > ar->spec->max_size * MAX_TEXT_RATIO) {
+		size = ar->spec->max_size * MAX_TEXT_RATIO;
+		truncated = true;
+	}
+
+	if (archive_begin_entry(ar, name, size, time(NULL)) != 0)
+		return -1;
+
+	written = process_text(ar, ar->spec, src, size, &truncated);
+	if (written < 0 || ar->failed || archive_end_entry(ar, written, size, '\n') != 0)
+		return -1;
+
+	add_manifest_entry(ar, name, written, truncated);
+
+	return 0;
+}
+
+/*
+ * add_file_entry() - Add a file to the archive as is
+ *
+ * @ar:		The archive.
+ * @name:	Name of the entry in the archive.
+ * @path:	Absolute path of the file.
+ *
+ * Return: 0 on success or if the file is not available, -1 on archive errors.
+ */
+static int add_file_entry(diag_archive_t *ar, const char *name, const char *path)
+{
+	char buffer[4096];
+	size_t written = 0, n;
+	bool truncated = false;
+	struct stat st;
+	FILE *fp;
+	int ret = 0;
+
+	if (stop_requested || !archive_room(ar))
+		return 0;
+
+	fp = fopen(path, "rb");
+	if (!fp || fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) {
+		if (fp)
+			fclose(fp);
+		return 0;
+	}
+
+	if (archive_begin_entry(ar, name, st.st_size, st.st_mtime) != 0) {
+		fclose(fp);
+		return strlen(name) >= TAR_NAME_LEN ? 0 : -1;
+	}
+
+	while (written < (size_t)st.st_size && !stop_requested) {
+		if (!archive_room(ar)) {
+			truncated = true;
+			break;
+		}
+		n = fread(buffer, 1, sizeof(buffer), fp);
+		if (n == 0)
+			break;
+		if (n > st.st_size - written)
+			n = st.st_size - written;
+		if (archive_compress(ar, buffer, n, Z_NO_FLUSH) != 0) {
+			ret = -1;
+			break;
+		}
+		written += n;
+	}
+
+	fclose(fp);
+
+	if (ret == 0 && archive_end_entry(ar, written, st.st_size, '\0') != 0)
+		ret = -1;
+	if (ret == 0)
+		add_manifest_entry(ar, name, written, truncated);
+
+	return ret;
+}
+
+/*
+ * add_buffer_entry() - Add a generated file to the archive
+ *
+ * @ar:		The archive.
+ * @name:	Name of the entry in the archive.
+ * @data:	Null-terminated contents of the file.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_buffer_entry(diag_archive_t *ar, const char *name, const char *data)
+{
+	size_t len = strlen(data);
+
+	if (archive_begin_entry(ar, name, len, time(NULL)) != 0
+		|| archive_compress(ar, data, len, Z_NO_FLUSH) != 0
+		|| archive_end_entry(ar, len, len, '\0') != 0)
+		return -1;
+
+	add_manifest_entry(ar, name, len, false);
+
+	return 0;
+}
+
+/*
+ * add_logs() - Add the log excerpts of the requested time range
+ *
+ * @ar:		The archive.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_logs(diag_archive_t *ar)
+{
+	const char *syslog_files[] = SYSLOG_FILES;
+	const char *journalctl[] = JOURNALCTL_PATHS;
+	diag_text_t src = { .is_log = true };
+	char name[TAR_NAME_LEN];
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(journalctl); i++) {
+		char cmd[256];
+
+		if (access(journalctl[i], X_OK) != 0)
+			continue;
+
+		snprintf(cmd, sizeof(cmd), JOURNALCTL_CMD,
+			(long long)ar->spec->from, (long long)ar->spec->to);
+		src.path = cmd;
+		src.command = true;
+		if (add_text_entry(ar, "logs/journal.log", &src) != 0)
+			return -1;
+		break;
+	}
+
+	src.command = false;
+	for (i = 0; i < ARRAY_SIZE(syslog_files); i++) {
+		const char *base = strrchr(syslog_files[i], '/') + 1;
+
+		snprintf(name, sizeof(name), "logs/%s", base);
+		src.path = syslog_files[i];
+		if (add_text_entry(ar, name, &src) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * add_proc() - Add a snapshot of '/proc' files
+ *
+ * @ar:		The archive.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_proc(diag_archive_t *ar)
+{
+	diag_text_t src = { 0 };
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(proc_files); i++) {
+		/* Remove leading '/' */
+		src.path = proc_files[i];
+		if (add_text_entry(ar, proc_files[i] + 1, &src) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * add_backlog() - Add backlog statistics and stored data
+ *
+ * @ar:		The archive.
+ *
+ * Stored data includes the system monitor samples not uploaded yet. The most
+ * recent files are added first, so the size cap drops the oldest ones.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_backlog(diag_archive_t *ar)
+{
+	json_object *stats = json_object_new_object();
+	struct dirent **files = NULL;
+	unsigned long long bytes = 0;
+	char *dir = NULL;
+	int i, n = 0, n_files = 0, ret = -1;
+
+	if (!stats)
+		goto done;
+
+	if (cc_cfg && cc_cfg->data_backlog_path && *cc_cfg->data_backlog_path != '\0') {
+		if (asprintf(&dir, "%s/cccs", cc_cfg->data_backlog_path) < 0) {
+			dir = NULL;
+			goto done;
+		}
+		n = scandir(dir, &files, NULL, alphasort);
+		if (n < 0)
+			n = 0;
+		if (get_directory_size(dir, &bytes) != 0)
+			bytes = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (files[i]->d_type == DT_REG)
+			n_files++;
+	}
+
+	if (json_object_object_add(stats, "path", json_object_new_string(dir ? dir : "")) < 0
+		|| json_object_object_add(stats, "limit_kb",
+			json_object_new_int64(cc_cfg ? cc_cfg->data_backlog_kb : 0)) < 0
+		|| json_object_object_add(stats, "bytes", json_object_new_int64(bytes)) < 0
+		|| json_object_object_add(stats, "files", json_object_new_int(n_files)) < 0
+		|| add_buffer_entry(ar, "backlog/stats.json",
+			json_object_to_json_string_ext(stats, JSON_C_TO_STRING_PRETTY)) != 0)
+		goto done;
+
+	/* File names start with their creation time, newest are last */
+	for (i = n - 1; i >= 0 && !stop_requested && archive_room(ar); i--) {
+		char name[TAR_NAME_LEN], *path = NULL;
+		int r;
+
+		if (files[i]->d_type != DT_REG)
+			continue;
+		if (snprintf(name, sizeof(name), "backlog/%s", files[i]->d_name) >= (int)sizeof(name))
+			continue;
+		if (asprintf(&path, "%s/%s", dir, files[i]->d_name) < 0)
+			goto done;
+		r = add_file_entry(ar, name, path);
+		free(path);
+		if (r != 0)
+			goto done;
+	}
+
+	ret = 0;
+
+done:
+	for (i = 0; i < n; i++)
+		free(files[i]);
+	free(files);
+	free(dir);
+	json_object_put(stats);
+
+	return ret;
+}
+
+/*
+ * add_manifest() - Add the description of the bundle
+ *
+ * @ar:		The archive.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_manifest(diag_archive_t *ar)
+{
+	json_object *root = json_object_new_object();
+	json_object *sources = json_object_new_array();
+	json_object *entries = ar->manifest;
+	int s, ret = -1;
+
+	for (s = 0; sources && s < SRC_COUNT; s++) {
+		if (ar->spec->sources & (1 << s))
+			json_object_array_add(sources, json_object_new_string(source_names[s]));
+	}
+
+	/* Take a reference, the manifest keeps its own */
+	json_object_get(entries);
+	if (!root
+		|| json_object_object_add(root, "created", json_object_new_int64(time(NULL))) < 0
+		|| json_object_object_add(root, "from", json_object_new_int64(ar->spec->from)) < 0
+		|| json_object_object_add(root, "to", json_object_new_int64(ar->spec->to)) < 0
+		|| json_object_object_add(root, "max_size", json_object_new_int64(ar->spec->max_size)) < 0
+		|| json_object_object_add(root, "redaction_rules", json_object_new_int64(ar->spec->n_redact)) < 0
+		|| json_object_object_add(root, "sources", sources) < 0
+		|| (sources = NULL, json_object_object_add(root, "entries", entries) < 0)
+		|| (entries = NULL, json_object_object_add(root, "size_cap_reached",
+			json_object_new_boolean(ar->full)) < 0))
+		goto done;
+
+	ret = add_buffer_entry(ar, "manifest.json",
+		json_object_to_json_string_ext(root, JSON_C_TO_STRING_PRETTY));
+
+done:
+	json_object_put(entries);
+	json_object_put(sources);
+	json_object_put(root);
+
+	return ret;
+}
+
+/*
+ * build_bundle() - Collect and upload a diagnostic bundle
+ *
+ * @spec:	Bundle request.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int build_bundle(const diag_spec_t *spec)
+{
+	diag_archive_t *ar = calloc(1, sizeof(*ar));
+	char trailer[2 * TAR_BLOCK];
+	int ret = -1;
+
+	if (!ar)
+		return -1;
+
+	ar->spec = spec;
+	ar->last_progress = get_monotonic_sec();
+	ar->manifest = json_object_new_array();
+	/* 15 + 16: gzip format with the maximum window */
+	if (!ar->manifest || deflateInit2(&ar->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		json_object_put(ar->manifest);
+		free(ar);
+		return -1;
+	}
+	ar->zs.next_out = ar->out;
+	ar->zs.avail_out = sizeof(ar->out);
+
+	if ((spec->sources & (1 << SRC_CONFIG))) {
+		diag_text_t src = {
+			.path = config_path ? config_path : DEFAULT_CONFIG_FILE,
+			.is_config = true,
+		};
+
+		if (add_text_entry(ar, "config/cccs.conf", &src) != 0)
+			goto done;
+	}
+	if ((spec->sources & (1 << SRC_PROC)) && add_proc(ar) != 0)
+		goto done;
+	if ((spec->sources & (1 << SRC_LOGS)) && add_logs(ar) != 0)
+		goto done;
+	if ((spec->sources & (1 << SRC_BACKLOG)) && add_backlog(ar) != 0)
+		goto done;
+
+	if (stop_requested)
+		goto done;
+
+	memset(trailer, 0, sizeof(trailer));
+	if (add_manifest(ar) != 0
+		|| archive_compress(ar, trailer, sizeof(trailer), Z_FINISH) != 0)
+		goto done;
+
+	log_diag_info("Bundle '%s' uploaded: %zu bytes (%zu uncompressed)",
+		spec->cloud_path, ar->uploaded, ar->raw);
+	ret = 0;
+
+done:
+	report_progress(spec, ret == 0 ? "done" : "failed", ar->uploaded,
+		ret == 0 ? NULL : (stop_requested ? "Cancelled" : "Unable to build or upload the bundle"));
+
+	deflateEnd(&ar->zs);
+	json_object_put(ar->manifest);
+	free(ar);
+
+	return ret;
+}
+
+/*
+ * diagnostics_threaded() - Build a diagnostic bundle in a new thread
+ *
+ * @data:	Bundle request, freed when done.
+ */
+static void *diagnostics_threaded(void *data)
+{
+	diag_spec_t *spec = data;
+
+	set_priority(spec->nice);
+
+	log_diag_info("Building bundle '%s'", spec->cloud_path);
+	build_bundle(spec);
+
+	free_spec(spec);
+
+	pthread_mutex_lock(&diag_lock);
+	diag_running = false;
+	pthread_mutex_unlock(&diag_lock);
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * set_response() - Set the response of a data request
+ *
+ * @resp_buffer:	Buffer to store the answer of the request.
+ * @status:		Value of the 'status' field.
+ * @name:		Name of the additional field.
+ * @value:		Value of the additional field.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int set_response(ccapi_buffer_info_t *const resp_buffer, const char *status,
+	const char *name, const char *value)
+{
+	json_object *resp = json_object_new_object();
+
+	resp_buffer->buffer = NULL;
+	resp_buffer->length = 0;
+
+	if (resp
+		&& json_object_object_add(resp, "status", json_object_new_string(status)) == 0
+		&& json_object_object_add(resp, name, json_object_new_string(value)) == 0)
+		resp_buffer->buffer = strdup(json_object_to_json_string(resp));
+
+	json_object_put(resp);
+
+	if (!resp_buffer->buffer)
+		return -1;
+
+	resp_buffer->length = strlen(resp_buffer->buffer);
+
+	return 0;
+}
+
+/*
+ * diagnostics_cb() - Data callback for 'builtin/diagnostics' data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @req_buffer:		Buffer containing the data request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * Request (all fields are optional):
+ *	{"path": "diagnostics/bundle.tar.gz", "from": <epoch>, "to": <epoch>,
+ *	 "sources": ["logs", "config", "proc", "backlog"],
+ *	 "max_size": <bytes>, "redact": ["<regex>", ...], "nice": <0-19>}
+ * Response: {"status": "started", "path": <path>} once the bundle is
+ * scheduled, {"status": "busy", "path": <path>} if another one is in
+ * progress, or {"status": "error", "error": <description>}.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if success, any other code otherwise.
+ */
+static ccapi_receive_error_t diagnostics_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t const *const req_buffer,
+		ccapi_buffer_info_t *const resp_buffer)
+{
+	static char current_path[MAX_CLOUD_PATH + 1];
+	ccapi_receive_error_t status = CCAPI_RECEIVE_ERROR_NONE;
+	json_object *req = NULL;
+	diag_spec_t *spec = NULL;
+	const char *error = NULL;
+	int r;
+
+	log_diag_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	if (req_buffer->length > 0) {
+		char *request = strndup(req_buffer->buffer, req_buffer->length);
+
+		if (!request) {
+			error = "Out of memory";
+			goto done;
+		}
+		req = json_tokener_parse(request);
+		free(request);
+		if (!req || !json_object_is_type(req, json_type_object)) {
+			error = "Invalid format";
+			goto done;
+		}
+	} else {
+		req = json_object_new_object();
+		if (!req) {
+			error = "Out of memory";
+			goto done;
+		}
+	}
+
+	spec = parse_spec(req, &error);
+	if (!spec)
+		goto done;
+
+	pthread_mutex_lock(&diag_lock);
+	if (diag_running) {
+		pthread_mutex_unlock(&diag_lock);
+		r = set_response(resp_buffer, "busy", "path", current_path);
+		free_spec(spec);
+		goto response;
+	}
+
+	/* Reap the previous bundle thread */
+	if (diag_thread_valid) {
+		pthread_join(diag_thread, NULL);
+		diag_thread_valid = false;
+	}
+
+	strncpy(current_path, spec->cloud_path, sizeof(current_path) - 1);
+	stop_requested = false;
+	diag_thread_valid = (pthread_create(&diag_thread, NULL, diagnostics_threaded, spec) == 0);
+	diag_running = diag_thread_valid;
+	pthread_mutex_unlock(&diag_lock);
+
+	if (!diag_thread_valid) {
+		free_spec(spec);
+		error = "Unable to start bundle collection";
+		goto done;
+	}
+
+	r = set_response(resp_buffer, "started", "path", current_path);
+	goto response;
+
+done:
+	log_diag_error("Cannot process request for target '%s': %s", target, error);
+	r = set_response(resp_buffer, "error", "error", error);
+	if (r == 0)
+		status = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+
+response:
+	if (r != 0)
+		status = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+
+	json_object_put(req);
+
+	return status;
+}
+
+/*
+ * diagnostics_status_cb() - Status callback for 'builtin/diagnostics' data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @resp_buffer:	Buffer containing the response data.
+ * @receive_error:	The error status of the receive process.
+ */
+static void diagnostics_status_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t *const resp_buffer,
+		ccapi_receive_error_t receive_error)
+{
+	log_diag_debug("%s: target='%s' - transport='%d' - error='%d'", __func__,
+		target, transport, receive_error);
+
+	if (resp_buffer)
+		free(resp_buffer->buffer);
+}
+
+ccapi_receive_error_t register_diagnostics_requests(const char *config_file)
+{
+	ccapi_receive_error_t error;
+
+	config_path = config_file;
+
+	if (!secret_keys_re_valid)
+		secret_keys_re_valid = regcomp(&secret_keys_re, SECRET_KEYS_REGEX,
+			REG_EXTENDED | REG_ICASE | REG_NOSUB) == 0;
+
+	error = ccapi_receive_add_target(TARGET_DIAGNOSTICS, diagnostics_cb,
+		diagnostics_status_cb, CCAPI_RECEIVE_NO_LIMIT);
+	if (error == CCAPI_RECEIVE_ERROR_TARGET_ALREADY_ADDED)
+		error = CCAPI_RECEIVE_ERROR_NONE;
+	else if (error != CCAPI_RECEIVE_ERROR_NONE)
+		log_diag_error("Cannot register target '%s', error %d", TARGET_DIAGNOSTICS, error);
+
+	return error;
+}
+
+void unregister_diagnostics_requests(void)
+{
+	ccapi_receive_error_t error;
+	bool thread_valid;
+
+	error = ccapi_receive_remove_target(TARGET_DIAGNOSTICS);
+	if (error != CCAPI_RECEIVE_ERROR_NONE)
+		log_diag_error("Could not remove registered target '%s' (%d)", TARGET_DIAGNOSTICS, error);
+
+	stop_requested = true;
+
+	pthread_mutex_lock(&diag_lock);
+	thread_valid = diag_thread_valid;
+	diag_thread_valid = false;
+	pthread_mutex_unlock(&diag_lock);
+
+	/* The thread takes the lock when it finishes */
+	if (thread_valid)
+		pthread_join(diag_thread, NULL);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+#include <cloudconnector.h>
+
+/*
+ * register_diagnostics_requests() - Register the diagnostic bundle target
+ *
+ * @config_file:	Absolute path of the configuration file in use, NULL for
+ *			the default one. It is included in the bundles with its
+ *			secrets masked.
+ *
+ * 'builtin/diagnostics' requests collect logs, configuration, '/proc'
+ * snapshots and backlog data in a compressed tar archive that is uploaded to
+ * a Remote Manager file path. Progress is reported to the
+ * 'management/events/diagnostics' data stream.
+ *
+ * Return: Error code after registering the data request.
+ */
+ccapi_receive_error_t register_diagnostics_requests(const char *config_file);
+
+/*
+ * unregister_diagnostics_requests() - Unregister the diagnostic bundle target
+ *
+ * An in-progress bundle is cancelled.
+ */
+void unregister_diagnostics_requests(void);
+
+#endif /* DIAGNOSTICS_H_ */
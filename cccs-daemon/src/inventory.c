@@ -0,0 +1,962 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <json_object.h>
+#include <limits.h>
+#include <libdigiapix/wifi.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netpacket/packet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_cc_datapoints.h"
+#include "device_mgmt.h"
+#include "inventory.h"
+
+#define INVENTORY_TAG			"INVENTORY:"
+
+#define TARGET_INVENTORY		"builtin/inventory"
+#define DP_INVENTORY_STREAM_ID		"management/events/inventory"
+
+#define LOOP_MS				100
+/* Quiet time after the last event before refreshing the inventory */
+#define DEBOUNCE_MS			2000
+/* Maximum time to keep refreshing on hold while events keep coming */
+#define MAX_HOLD_MS			30000
+/* Time to wait before retrying a failed push */
+#define RETRY_MS			60000
+
+#define BUILD_FILE			"/etc/build"
+#define VERSION_FILE			"/etc/version"
+#define MOUNTS_FILE			"/proc/self/mounts"
+#define SYS_BLOCK_DIR			"/sys/class/block"
+
+#define UEVENT_BUFSIZE			4096
+#define NETLINK_BUFSIZE			8192
+
+#if !(defined UNUSED_ARGUMENT)
+#define UNUSED_ARGUMENT(a)	(void)(a)
+#endif
+
+/**
+ * log_inv_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_inv_debug(format, ...)				\
+	log_debug("%s " format, INVENTORY_TAG, __VA_ARGS__)
+
+/**
+ * log_inv_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_inv_info(format, ...)				\
+	log_info("%s " format, INVENTORY_TAG, __VA_ARGS__)
+
+/**
+ * log_inv_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_inv_error(format, ...)				\
+	log_error("%s " format, INVENTORY_TAG, __VA_ARGS__)
+
+typedef enum {
+	INV_NET,
+	INV_STORAGE,
+	INV_FIRMWARE,
+	INV_SECTIONS
+} inv_section_t;
+
+#define INV_ALL			((1 << INV_SECTIONS) - 1)
+
+/*
+ * struct inv_item_t - Inventory entry
+ *
+ * @key:	Path of the entry, for example 'net/eth0/mac'.
+ * @value:	Value of the entry.
+ */
+typedef struct {
+	char *key;
+	char *value;
+} inv_item_t;
+
+/*
+ * struct inv_doc_t - Inventory section, sorted by key
+ *
+ * @items:	Entries.
+ * @n:		Number of entries.
+ * @max:	Allocated entries.
+ */
+typedef struct {
+	inv_item_t *items;
+	size_t n;
+	size_t max;
+} inv_doc_t;
+
+enum {
+	FD_ROUTE,
+	FD_UEVENT,
+	FD_MOUNTS,
+	FD_INOTIFY,
+	FD_COUNT
+};
+
+static inv_doc_t current[INV_SECTIONS];
+static inv_doc_t pushed[INV_SECTIONS];
+static uint32_t version = 0;
+static uint32_t pushed_version = 0;
+
+static volatile bool stop_requested = false;
+static volatile bool inv_thread_valid = false;
+static pthread_t inv_thread;
+static pthread_mutex_t inv_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * get_monotonic_ms() - Get the milliseconds elapsed in the monotonic clock
+ *
+ * Return: The number of milliseconds.
+ */
+static uint64_t get_monotonic_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void free_doc(inv_doc_t *doc)
+{
+	size_t i;
+
+	for (i = 0; i < doc->n; i++) {
+		free(doc->items[i].key);
+		free(doc->items[i].value);
+	}
+	free(doc->items);
+	memset(doc, 0, sizeof(*doc));
+}
+
+/*
+ * add_item() - Add an entry to an inventory section
+ *
+ * @doc:	Inventory section.
+ * @value:	Value of the entry.
+ * @format:	Format of the entry key.
+ * @args:	Additional arguments.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_item(inv_doc_t *doc, const char *value, const char *format, ...)
+{
+	inv_item_t *item;
+	va_list args;
+	int len;
+
+	if (doc->n == doc->max) {
+		size_t new_max = doc->max ? 2 * doc->max : 16;
+		inv_item_t *tmp = realloc(doc->items, new_max * sizeof(*tmp));
+
+		if (!tmp)
+			return -1;
+		doc->items = tmp;
+		doc->max = new_max;
+	}
+
+	item = &doc->items[doc->n];
+
+	va_start(args, format);
+	len = vasprintf(&item->key, format, args);
+	va_end(args);
+	if (len < 0)
+		return -1;
+
+	item->value = strdup(value);
+	if (!item->value) {
+		free(item->key);
+		return -1;
+	}
+
+	doc->n++;
+
+	return 0;
+}
+
+static int compare_items(const void *a, const void *b)
+{
+	const inv_item_t *item_a = a;
+	const inv_item_t *item_b = b;
+
+	return strcmp(item_a->key, item_b->key);
+}
+
+/*
+ * copy_doc() - Duplicate an inventory section
+ *
+ * @dst:	Section to store the copy, it is freed first.
+ * @src:	Section to copy.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int copy_doc(inv_doc_t *dst, const inv_doc_t *src)
+{
+	size_t i;
+
+	free_doc(dst);
+
+	for (i = 0; i < src->n; i++) {
+		if (add_item(dst, src->items[i].value, "%s", src->items[i].key) != 0) {
+			free_doc(dst);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * read_first_line() - Read the first line of a file without the line feed
+ *
+ * @path:	Absolute path of the file to read.
+ * @buffer:	Buffer to store the line.
+ * @size:	Size of the buffer.
+ *
+ * Return: 0 on success, -1 on error.
+ */
+static int read_first_line(const char *path, char *buffer, size_t size)
+{
+	FILE *fp = fopen(path, "r");
+	int ret = -1;
+
+	if (!fp)
+		return -1;
+
+	if (fgets(buffer, size, fp) != NULL) {
+		buffer[strcspn(buffer, "\n")] = '\0';
+		ret = 0;
+	}
+	fclose(fp);
+
+	return ret;
+}
+
+/*
+ * collect_net() - Read the state of the network interfaces
+ *
+ * @doc:	Section to fill.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int collect_net(inv_doc_t *doc)
+{
+	struct ifaddrs *ifaddr, *ifa;
+	int ret = 0;
+
+	if (getifaddrs(&ifaddr) != 0) {
+		log_inv_error("Unable to get network interfaces: %s (%d)", strerror(errno), errno);
+		return -1;
+	}
+
+	for (ifa = ifaddr; ifa != NULL && ret == 0; ifa = ifa->ifa_next) {
+		char addr[INET6_ADDRSTRLEN];
+		int family;
+
+		if (ifa->ifa_addr == NULL || (ifa->ifa_flags & IFF_LOOPBACK))
+			continue;
+
+		family = ifa->ifa_addr->sa_family;
+		if (family == AF_PACKET) {
+			struct sockaddr_ll *sll = (struct sockaddr_ll *)(void *)ifa->ifa_addr;
+			const char *state = "down";
+
+			if (ifa->ifa_flags & IFF_UP)
+				state = (ifa->ifa_flags & IFF_RUNNING) ? "up" : "no-carrier";
+
+			ret = add_item(doc, state, "net/%s/state", ifa->ifa_name);
+			if (ret == 0 && sll->sll_halen == 6) {
+				snprintf(addr, sizeof(addr), "%02x:%02x:%02x:%02x:%02x:%02x",
+					sll->sll_addr[0], sll->sll_addr[1], sll->sll_addr[2],
+					sll->sll_addr[3], sll->sll_addr[4], sll->sll_addr[5]);
+				ret = add_item(doc, addr, "net/%s/mac", ifa->ifa_name);
+			}
+			if (ret == 0 && ldx_wifi_iface_exists(ifa->ifa_name)) {
+				wifi_state_t wifi_state;
+
+				memset(&wifi_state, 0, sizeof(wifi_state));
+				if (ldx_wifi_get_iface_state(ifa->ifa_name, &wifi_state) == WIFI_STATE_ERROR_NONE
+					&& wifi_state.ssid[0] != '\0')
+					ret = add_item(doc, wifi_state.ssid, "net/%s/ssid", ifa->ifa_name);
+			}
+		} else if (family == AF_INET || family == AF_INET6) {
+			const void *src = family == AF_INET ?
+				(const void *)&((struct sockaddr_in *)(void *)ifa->ifa_addr)->sin_addr :
+				(const void *)&((struct sockaddr_in6 *)(void *)ifa->ifa_addr)->sin6_addr;
+
+			if (inet_ntop(family, src, addr, sizeof(addr)) == NULL)
+				continue;
+
+			ret = add_item(doc, family == AF_INET ? "ipv4" : "ipv6",
+				"net/%s/addr/%s", ifa->ifa_name, addr);
+		}
+	}
+
+	freeifaddrs(ifaddr);
+
+	return ret;
+}
+
+/*
+ * collect_storage() - Read the block devices and mounted file systems
+ *
+ * @doc:	Section to fill.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int collect_storage(inv_doc_t *doc)
+{
+	char line[512];
+	struct dirent *entry;
+	DIR *dir;
+	FILE *fp;
+	int ret = 0;
+
+	dir = opendir(SYS_BLOCK_DIR);
+	if (dir) {
+		while (ret == 0 && (entry = readdir(dir)) != NULL) {
+			char path[PATH_MAX], size[32];
+
+			if (entry->d_name[0] == '.'
+				|| strncmp(entry->d_name, "loop", strlen("loop")) == 0
+				|| strncmp(entry->d_name, "ram", strlen("ram")) == 0
+				|| strncmp(entry->d_name, "zram", strlen("zram")) == 0)
+				continue;
+
+			snprintf(path, sizeof(path), "%s/%s/size", SYS_BLOCK_DIR, entry->d_name);
+			if (read_first_line(path, size, sizeof(size)) != 0)
+				continue;
+
+			ret = add_item(doc, size, "block/%s/sectors", entry->d_name);
+		}
+		closedir(dir);
+	}
+
+	fp = fopen(MOUNTS_FILE, "r");
+	if (!fp) {
+		log_inv_error("Unable to read '%s': %s (%d)", MOUNTS_FILE, strerror(errno), errno);
+		return -1;
+	}
+
+	while (ret == 0 && fgets(line, sizeof(line), fp) != NULL) {
+		char dev[128], mnt[256], fstype[32], opts[128], value[256];
+
+		if (sscanf(line, "%127s %255s %31s %127s", dev, mnt, fstype, opts) != 4
+			|| strncmp(dev, "/dev/", strlen("/dev/")) != 0)
+			continue;
+
+		snprintf(value, sizeof(value), "%s %s %s", dev, fstype,
+			strncmp(opts, "ro", 2) == 0 && (opts[2] == ',' || opts[2] == '\0') ? "ro" : "rw");
+		ret = add_item(doc, value, "storage%s%s", mnt[0] == '/' ? "" : "/", mnt);
+	}
+	fclose(fp);
+
+	return ret;
+}
+
+/*
+ * collect_firmware() - Read the software versions
+ *
+ * @doc:	Section to fill.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int collect_firmware(inv_doc_t *doc)
+{
+	char line[256];
+	struct utsname uts;
+	FILE *fp;
+	int ret = 0;
+
+	fp = fopen(BUILD_FILE, "r");
+	if (fp) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			char value[64];
+
+			if (strncmp(line, "DISTRO_VERSION", strlen("DISTRO_VERSION")) != 0)
+				continue;
+			if (sscanf(line, "%*s %*s %63s", value) == 1)
+				ret = add_item(doc, value, "firmware/dey_version");
+			break;
+		}
+		fclose(fp);
+	}
+
+	if (ret == 0 && read_first_line(VERSION_FILE, line, sizeof(line)) == 0)
+		ret = add_item(doc, line, "firmware/build");
+
+	if (ret == 0 && uname(&uts) == 0) {
+		snprintf(line, sizeof(line), "%s %s", uts.release, uts.version);
+		ret = add_item(doc, line, "firmware/kernel");
+	}
+
+	return ret;
+}
+
+/*
+ * refresh_sections() - Read again the given inventory sections
+ *
+ * @mask:	Bitmask of sections to refresh.
+ *
+ * Return: True if any of the sections changed, false otherwise.
+ */
+static bool refresh_sections(unsigned int mask)
+{
+	static int (* const collectors[INV_SECTIONS])(inv_doc_t *) = {
+		[INV_NET] = collect_net,
+		[INV_STORAGE] = collect_storage,
+		[INV_FIRMWARE] = collect_firmware,
+	};
+	bool changed = false;
+	int s;
+
+	for (s = 0; s < INV_SECTIONS; s++) {
+		inv_doc_t doc = { 0 };
+		size_t i;
+
+		if (!(mask & (1 << s)))
+			continue;
+
+		if (collectors[s](&doc) != 0) {
+			free_doc(&doc);
+			continue;
+		}
+		qsort(doc.items, doc.n, sizeof(*doc.items), compare_items);
+
+		pthread_mutex_lock(&inv_lock);
+		if (doc.n != current[s].n) {
+			changed = true;
+		} else {
+			for (i = 0; i < doc.n && !changed; i++) {
+				changed = strcmp(doc.items[i].key, current[s].items[i].key) != 0
+					|| strcmp(doc.items[i].value, current[s].items[i].value) != 0;
+			}
+		}
+		free_doc(&current[s]);
+		current[s] = doc;
+		pthread_mutex_unlock(&inv_lock);
+
+		if (s == INV_NET)
+			dm_invalidate_element(NULL);
+	}
+
+	return changed;
+}
+
+/*
+ * add_doc_json() - Add the entries of an inventory section to a JSON object
+ *
+ * @obj:	JSON object to fill.
+ * @doc:	Inventory section.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_doc_json(json_object *obj, const inv_doc_t *doc)
+{
+	size_t i;
+
+	for (i = 0; i < doc->n; i++) {
+		json_object *value = json_object_new_string(doc->items[i].value);
+
+		if (!value || json_object_object_add(obj, doc->items[i].key, value) < 0) {
+			json_object_put(value);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * build_delta() - Generate the changes since the last pushed inventory
+ *
+ * Must be called with the inventory lock held.
+ *
+ * Return: The delta JSON object, NULL if out of memory.
+ */
+static json_object *build_delta(void)
+{
+	json_object *delta = json_object_new_object();
+	json_object *set = json_object_new_object();
+	json_object *unset = json_object_new_array();
+	int s;
+
+	if (!delta || !set || !unset
+		|| json_object_object_add(delta, "version", json_object_new_int64(version)) < 0
+		|| json_object_object_add(delta, "base", json_object_new_int64(pushed_version)) < 0)
+		goto error;
+
+	for (s = 0; s < INV_SECTIONS; s++) {
+		const inv_doc_t *old = &pushed[s], *new = &current[s];
+		size_t i = 0, j = 0;
+
+		while (i < old->n || j < new->n) {
+			int cmp;
+
+			if (i == old->n)
+				cmp = 1;
+			else if (j == new->n)
+				cmp = -1;
+			else
+				cmp = strcmp(old->items[i].key, new->items[j].key);
+
+			if (cmp < 0) {
+				if (json_object_array_add(unset, json_object_new_string(old->items[i].key)) < 0)
+					goto error;
+				i++;
+				continue;
+			}
+
+			if (cmp > 0 || strcmp(old->items[i].value, new->items[j].value) != 0) {
+				json_object *value = json_object_new_string(new->items[j].value);
+
+				if (!value || json_object_object_add(set, new->items[j].key, value) < 0) {
+					json_object_put(value);
+					goto error;
+				}
+			}
+			if (cmp == 0)
+				i++;
+			j++;
+		}
+	}
+
+	if (json_object_object_length(set) > 0) {
+		if (json_object_object_add(delta, "set", set) < 0)
+			goto error;
+	} else {
+		json_object_put(set);
+	}
+	set = NULL;
+
+	if (json_object_array_length(unset) > 0) {
+		if (json_object_object_add(delta, "unset", unset) < 0)
+			goto error;
+	} else {
+		json_object_put(unset);
+	}
+
+	return delta;
+
+error:
+	json_object_put(set);
+	json_object_put(unset);
+	json_object_put(delta);
+
+	return NULL;
+}
+
+/*
+ * push_delta() - Send the changes since the last pushed inventory
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int push_delta(void)
+{
+	json_object *delta;
+	char *json = NULL;
+	uint32_t new_version;
+	int ret = -1, s;
+
+	pthread_mutex_lock(&inv_lock);
+	new_version = version;
+	delta = build_delta();
+	if (delta)
+		json = strdup(json_object_to_json_string(delta));
+	pthread_mutex_unlock(&inv_lock);
+
+	json_object_put(delta);
+	if (!json) {
+		log_inv_error("Unable to generate inventory delta: %s", "Out of memory");
+		return -1;
+	}
+
+	log_inv_debug("Pushing inventory delta: %s", json);
+
+	if (dp_send_json_event(DP_INVENTORY_STREAM_ID, json) != 0)
+		goto done;
+
+	pthread_mutex_lock(&inv_lock);
+	for (s = 0; s < INV_SECTIONS; s++) {
+		if (copy_doc(&pushed[s], &current[s]) != 0) {
+			/* Force a complete document next time */
+			for (s = 0; s < INV_SECTIONS; s++)
+				free_doc(&pushed[s]);
+			new_version = 0;
+			break;
+		}
+	}
+	pushed_version = new_version;
+	pthread_mutex_unlock(&inv_lock);
+
+	ret = 0;
+
+done:
+	free(json);
+
+	return ret;
+}
+
+/*
+ * open_event_sources() - Open the kernel event sources to watch
+ *
+ * @fds:	Array to store the poll descriptors.
+ */
+static void open_event_sources(struct pollfd fds[FD_COUNT])
+{
+	struct sockaddr_nl addr;
+	int i;
+
+	for (i = 0; i < FD_COUNT; i++) {
+		fds[i].fd = -1;
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+
+	fds[FD_ROUTE].fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fds[FD_ROUTE].fd >= 0) {
+		memset(&addr, 0, sizeof(addr));
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+		if (bind(fds[FD_ROUTE].fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+			close(fds[FD_ROUTE].fd);
+			fds[FD_ROUTE].fd = -1;
+		}
+	}
+	if (fds[FD_ROUTE].fd < 0)
+		log_inv_error("Unable to listen to network changes: %s (%d)", strerror(errno), errno);
+
+	fds[FD_UEVENT].fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fds[FD_UEVENT].fd >= 0) {
+		memset(&addr, 0, sizeof(addr));
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = 1; /* Kernel uevents */
+		if (bind(fds[FD_UEVENT].fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+			close(fds[FD_UEVENT].fd);
+			fds[FD_UEVENT].fd = -1;
+		}
+	}
+	if (fds[FD_UEVENT].fd < 0)
+		log_inv_error("Unable to listen to device changes: %s (%d)", strerror(errno), errno);
+
+	/* The mount table notifies changes as an exceptional condition */
+	fds[FD_MOUNTS].fd = open(MOUNTS_FILE, O_RDONLY | O_CLOEXEC);
+	fds[FD_MOUNTS].events = POLLPRI;
+	if (fds[FD_MOUNTS].fd < 0)
+		log_inv_error("Unable to listen to mount changes: %s (%d)", strerror(errno), errno);
+
+	fds[FD_INOTIFY].fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fds[FD_INOTIFY].fd >= 0
+		&& inotify_add_watch(fds[FD_INOTIFY].fd, "/etc",
+			IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+		close(fds[FD_INOTIFY].fd);
+		fds[FD_INOTIFY].fd = -1;
+	}
+	if (fds[FD_INOTIFY].fd < 0)
+		log_inv_error("Unable to listen to version changes: %s (%d)", strerror(errno), errno);
+}
+
+/*
+ * read_events() - Consume pending events and return the affected sections
+ *
+ * @fds:	Poll descriptors.
+ *
+ * Return: Bitmask of sections to refresh.
+ */
+static unsigned int read_events(struct pollfd fds[FD_COUNT])
+{
+	union {
+		struct inotify_event event;
+		char data[NETLINK_BUFSIZE];
+	} u;
+	char *buf = u.data;
+	unsigned int mask = 0;
+	ssize_t len;
+
+	if (fds[FD_ROUTE].revents & POLLIN) {
+		while (recv(fds[FD_ROUTE].fd, buf, sizeof(u.data), 0) > 0)
+			mask |= 1 << INV_NET;
+	}
+
+	if (fds[FD_UEVENT].revents & POLLIN) {
+		while ((len = recv(fds[FD_UEVENT].fd, buf, UEVENT_BUFSIZE - 1, 0)) > 0) {
+			char *p;
+
+			/* Payload is a list of null-terminated 'KEY=value' strings */
+			buf[len] = '\0';
+			for (p = buf; p < buf + len; p += strlen(p) + 1) {
+				if (strcmp(p, "SUBSYSTEM=block") == 0)
+					mask |= 1 << INV_STORAGE;
+			}
+		}
+	}
+
+	if (fds[FD_MOUNTS].revents & (POLLPRI | POLLERR))
+		mask |= 1 << INV_STORAGE;
+
+	if (fds[FD_INOTIFY].revents & POLLIN) {
+		while ((len = read(fds[FD_INOTIFY].fd, buf, sizeof(u.data))) > 0) {
+			char *p = buf;
+
+			while (p < buf + len) {
+				struct inotify_event *event = (struct inotify_event *)(void *)p;
+
+				if (event->len > 0
+					&& (strcmp(event->name, "build") == 0 || strcmp(event->name, "version") == 0))
+					mask |= 1 << INV_FIRMWARE;
+				p += sizeof(struct inotify_event) + event->len;
+			}
+		}
+	}
+
+	return mask;
+}
+
+/*
+ * inventory_loop() - Watch for inventory changes until stop is requested
+ */
+static void inventory_loop(void)
+{
+	struct pollfd fds[FD_COUNT];
+	unsigned int dirty = 0;
+	uint64_t first_event = 0, last_event = 0, next_push = 0;
+	bool pending = true; /* Always start with a complete document */
+	int i;
+
+	open_event_sources(fds);
+
+	if (refresh_sections(INV_ALL)) {
+		pthread_mutex_lock(&inv_lock);
+		version++;
+		pthread_mutex_unlock(&inv_lock);
+	}
+
+	while (!stop_requested) {
+		unsigned int mask;
+		uint64_t now;
+
+		if (poll(fds, FD_COUNT, LOOP_MS) < 0 && errno != EINTR) {
+			log_inv_error("Unable to wait for events: %s (%d)", strerror(errno), errno);
+			break;
+		}
+
+		now = get_monotonic_ms();
+		mask = read_events(fds);
+		if (mask) {
+			if (!dirty)
+				first_event = now;
+			last_event = now;
+			dirty |= mask;
+		}
+
+		/* Wait for events to settle so a flapping link is reported once */
+		if (dirty && (now - last_event >= DEBOUNCE_MS || now - first_event >= MAX_HOLD_MS)) {
+			if (refresh_sections(dirty)) {
+				pthread_mutex_lock(&inv_lock);
+				version++;
+				pthread_mutex_unlock(&inv_lock);
+				pending = true;
+			}
+			dirty = 0;
+		}
+
+		if (pending && now >= next_push
+			&& get_cloud_connection_status() == CC_STATUS_CONNECTED) {
+			if (push_delta() == 0) {
+				pending = false;
+			} else {
+				next_push = now + RETRY_MS;
+				log_inv_error("Unable to push inventory, retrying in %d s", RETRY_MS / 1000);
+			}
+		}
+	}
+
+	for (i = 0; i < FD_COUNT; i++) {
+		if (fds[i].fd >= 0)
+			close(fds[i].fd);
+	}
+}
+
+/*
+ * inventory_threaded() - Watch for inventory changes in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *inventory_threaded(void *unused)
+{
+	UNUSED_ARGUMENT(unused);
+
+	inventory_loop();
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * inventory_cb() - Data callback for 'builtin/inventory' data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @req_buffer:		Buffer containing the data request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * Response: {"version": <n>, "inventory": {<key>: <value>, ...}}
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if success, any other code otherwise.
+ */
+static ccapi_receive_error_t inventory_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t const *const req_buffer,
+		ccapi_buffer_info_t *const resp_buffer)
+{
+	json_object *resp = json_object_new_object();
+	json_object *inventory = json_object_new_object();
+	ccapi_receive_error_t status = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	int s;
+
+	UNUSED_ARGUMENT(req_buffer);
+
+	log_inv_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	resp_buffer->buffer = NULL;
+	resp_buffer->length = 0;
+
+	pthread_mutex_lock(&inv_lock);
+	if (!resp || !inventory
+		|| json_object_object_add(resp, "version", json_object_new_int64(version)) < 0) {
+		pthread_mutex_unlock(&inv_lock);
+		goto done;
+	}
+	for (s = 0; s < INV_SECTIONS; s++) {
+		if (add_doc_json(inventory, &current[s]) != 0) {
+			pthread_mutex_unlock(&inv_lock);
+			goto done;
+		}
+	}
+	pthread_mutex_unlock(&inv_lock);
+
+	if (json_object_object_add(resp, "inventory", inventory) < 0)
+		goto done;
+	inventory = NULL;
+
+	resp_buffer->buffer = strdup(json_object_to_json_string(resp));
+	if (resp_buffer->buffer) {
+		resp_buffer->length = strlen(resp_buffer->buffer);
+		status = CCAPI_RECEIVE_ERROR_NONE;
+	}
+
+done:
+	if (status != CCAPI_RECEIVE_ERROR_NONE)
+		log_inv_error("Cannot generate response for target '%s': Out of memory", target);
+
+	json_object_put(inventory);
+	json_object_put(resp);
+
+	return status;
+}
+
+static void inventory_status_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t *const resp_buffer,
+		ccapi_receive_error_t receive_error)
+{
+	log_inv_debug("%s: target='%s' - transport='%d' - error='%d'", __func__,
+		target, transport, receive_error);
+
+	if (resp_buffer)
+		free(resp_buffer->buffer);
+}
+
+int start_inventory(void)
+{
+	ccapi_receive_error_t error;
+
+	if (inv_thread_valid)
+		return 0;
+
+	error = ccapi_receive_add_target(TARGET_INVENTORY, inventory_cb,
+		inventory_status_cb, CCAPI_RECEIVE_NO_LIMIT);
+	if (error != CCAPI_RECEIVE_ERROR_NONE && error != CCAPI_RECEIVE_ERROR_TARGET_ALREADY_ADDED)
+		log_inv_error("Cannot register target '%s', error %d", TARGET_INVENTORY, error);
+
+	stop_requested = false;
+	inv_thread_valid = (pthread_create(&inv_thread, NULL, inventory_threaded, NULL) == 0);
+	if (!inv_thread_valid) {
+		log_inv_error("%s", "Unable to start inventory thread");
+		return -1;
+	}
+
+	log_inv_info("%s", "Inventory tracking started");
+
+	return 0;
+}
+
+void stop_inventory(void)
+{
+	ccapi_receive_error_t error;
+	int s;
+
+	stop_requested = true;
+
+	if (inv_thread_valid) {
+		inv_thread_valid = false;
+		pthread_join(inv_thread, NULL);
+	}
+
+	error = ccapi_receive_remove_target(TARGET_INVENTORY);
+	if (error != CCAPI_RECEIVE_ERROR_NONE)
+		log_inv_error("Could not remove registered target '%s' (%d)", TARGET_INVENTORY, error);
+
+	/* Next connection starts with a complete document */
+	pthread_mutex_lock(&inv_lock);
+	for (s = 0; s < INV_SECTIONS; s++)
+		free_doc(&pushed[s]);
+	pushed_version = 0;
+	pthread_mutex_unlock(&inv_lock);
+}
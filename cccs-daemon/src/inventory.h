@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef INVENTORY_H_
+#define INVENTORY_H_
+
+#include <cloudconnector.h>
+
+/*
+ * start_inventory() - Start tracking the device inventory
+ *
+ * Listens to rtnetlink (links and addresses), kernel uevents and mount table
+ * changes (storage) and inotify (version files). Changes are debounced and
+ * pushed as deltas to the 'management/events/inventory' data stream. The
+ * complete document can be requested with the 'builtin/inventory' target.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int start_inventory(void);
+
+/*
+ * stop_inventory() - Stop tracking the device inventory
+ */
+void stop_inventory(void);
+
+#endif /* INVENTORY_H_ */
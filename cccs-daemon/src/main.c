@@ -25,8 +25,13 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include "crash_capture.h"
 #include "daemonize.h"
 #include "data_request.h"
+#include "device_mgmt.h"
+#include "diagnostics.h"
+#include "inventory.h"
+#include "net_diagnostics.h"
 
 #define VERSION		"1.0.0" GIT_REVISION
 
@@ -41,12 +46,16 @@
 	"  -c  --config-file=<PATH>  Use a custom configuration file instead of\n" \
 	"                            the default one located in /etc/cccs.conf\n" \
 	"  -h  --help                Print help and exit\n" \
+	"      --crash-handler <PID> <SIGNAL> <TIME> [<NAME>]\n" \
+	"                            Store the core dump read from the standard\n" \
+	"                            input (used by the kernel core_pattern)\n" \
 	"\n"
 
 #define REQUEST_TARGETS_DUMP_PATH	"/tmp/cccsd_request_targets.bin"
 
 volatile bool restart = false;
 static volatile bool stop = false;
+static volatile sig_atomic_t toggle_debug = 0;
 
 /**
  * signal_handler() - Manage signal received.
@@ -59,6 +68,18 @@ static void signal_handler(int sig_num)
 	stop = true;
 }
 
+/**
+ * debug_signal_handler() - Request to toggle the debug log
+ *
+ * @sig_num: Received signal.
+ */
+static void debug_signal_handler(int sig_num)
+{
+	UNUSED_ARGUMENT(sig_num);
+
+	toggle_debug = 1;
+}
+
 /*
  * setup_signal_handler() - Setup process signals
  *
@@ -82,6 +103,12 @@ static int setup_signal_handler(void)
 		}
 	}
 
+	new_action.sa_handler = debug_signal_handler;
+	if (sigaction(SIGUSR2, &new_action, NULL)) {
+		log_error("%s", "Failed to install debug signal handler");
+		return 1;
+	}
+
 	sigemptyset(&set);
 	sigaddset(&set, SIGINT);
 
@@ -119,6 +146,11 @@ static int start_connector(const char *config_file)
 		}
 
 		register_cccsd_data_requests();
+		register_device_mgmt_requests();
+		register_diagnostics_requests(config_file);
+		register_net_diagnostics_requests();
+		start_inventory();
+		start_crash_capture(config_file);
 
 		import_datarequests(REQUEST_TARGETS_DUMP_PATH);
 
@@ -130,12 +162,22 @@ static int start_connector(const char *config_file)
 
 		do {
 			sleep(2);
+			if (toggle_debug) {
+				toggle_debug = 0;
+				toggle_debug_log();
+			}
 		} while (get_cloud_connection_status() != CC_STATUS_DISCONNECTED && !stop && !restart);
 
 		if (restart)
 			dump_datarequests(REQUEST_TARGETS_DUMP_PATH);
 
+		stop_inventory();
+		stop_crash_capture();
+
 		unregister_cccsd_data_requests();
+		unregister_device_mgmt_requests();
+		unregister_diagnostics_requests();
+		unregister_net_diagnostics_requests();
 
 		stop_cloud_connection();
 	} while (restart);
@@ -159,6 +201,7 @@ int main(int argc, char *argv[])
 	char *name = basename(argv[0]);
 	static int opt, opt_index;
 	int create_daemon = 0;
+	int crash_handler = 0;
 	int log_options = LOG_CONS | LOG_NDELAY | LOG_PID | LOG_PERROR;
 	char *config_file = NULL;
 	static const char *short_options = "dc:h";
@@ -166,6 +209,7 @@ int main(int argc, char *argv[])
 			{"daemon", no_argument, NULL, 'd'},
 			{"config-file", required_argument, NULL, 'c'},
 			{"help", no_argument, NULL, 'h'},
+			{"crash-handler", no_argument, NULL, 'C'},
 			{NULL, 0, NULL, 0}
 	};
 
@@ -188,6 +232,9 @@ int main(int argc, char *argv[])
 		case 'h':
 			usage(name);
 			goto done;
+		case 'C':
+			crash_handler = 1;
+			break;
 		default:
 			usage(name);
 			result = EXIT_FAILURE;
@@ -195,6 +242,12 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/* Invoked by the kernel to store a core dump. */
+	if (crash_handler) {
+		result = handle_crash(config_file, argc - optind, argv + optind);
+		goto done;
+	}
+
 	/* Daemonize if requested. */
 	if (create_daemon) {
 		if (start_daemon(name) != 0) {
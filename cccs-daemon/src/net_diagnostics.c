@@ -0,0 +1,2131 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <json_object.h>
+#include <json_tokener.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <custom_connector_config.h>
+
+#include "_cc_datapoints.h"
+#include "ccimp/dns_helper.h"
+#include "net_diagnostics.h"
+
+#define NET_TAG				"NETDIAG:"
+
+#define DP_NET_DIAGNOSTICS_STREAM_ID	"management/events/net_diagnostics"
+
+/* EDP over TLS port used to connect to Remote Manager */
+#define CLOUD_TLS_PORT			3199
+#define DEFAULT_TLS_PORT		443
+
+/* Maximum number of tests running at the same time */
+#define MAX_RUNNING			2
+
+#define MAX_HOST_LEN			253
+#define MAX_CLOUD_PATH			255
+
+#define DEFAULT_TIMEOUT_MS		2000
+#define MIN_TIMEOUT_MS			100
+#define MAX_TIMEOUT_MS			10000
+/* Maximum time a data request waits for the result of its test */
+#define DEFAULT_WAIT_MS			500
+#define MAX_WAIT_MS			2000
+
+#define DEFAULT_COUNT			4
+#define MAX_COUNT			10
+#define DEFAULT_INTERVAL_MS		1000
+#define MIN_INTERVAL_MS			200
+#define MAX_INTERVAL_MS			2000
+#define DEFAULT_PING_SIZE		56
+#define MAX_PING_SIZE			1472
+
+/* IPv4 minimum MTU (RFC 791) */
+#define MIN_MTU				68
+#define MAX_MTU				65535
+#define IP_HEADER_LEN			20
+#define ICMP_HEADER_LEN			8
+#define MTU_PROBE_TRIES			2
+#define MAX_MTU_PROBES			24
+#define MAX_MTU_TIMEOUT_MS		2000
+
+#define DEFAULT_THROUGHPUT_SIZE		(256 * 1024)
+#define MIN_THROUGHPUT_SIZE		(4 * 1024)
+#define MAX_THROUGHPUT_SIZE		(2 * 1024 * 1024)
+#define DEFAULT_THROUGHPUT_PATH		"diagnostics/throughput.bin"
+#define THROUGHPUT_CHUNK_SIZE		(64 * 1024)
+#define MAX_THROUGHPUT_TIMEOUT_MS	60000
+
+#define NL_BUFFER_SIZE			(32 * 1024)
+
+#if !(defined ARRAY_SIZE)
+#define ARRAY_SIZE(array)	(sizeof array/sizeof array[0])
+#endif
+
+/**
+ * log_net_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_net_debug(format, ...)				\
+	log_debug("%s " format, NET_TAG, __VA_ARGS__)
+
+/**
+ * log_net_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_net_info(format, ...)				\
+	log_info("%s " format, NET_TAG, __VA_ARGS__)
+
+/**
+ * log_net_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_net_error(format, ...)				\
+	log_error("%s " format, NET_TAG, __VA_ARGS__)
+
+extern cc_cfg_t *cc_cfg;
+
+typedef enum {
+	NET_PING,
+	NET_TCP_CONNECT,
+	NET_DNS,
+	NET_TLS,
+	NET_MTU,
+	NET_LINKS,
+	NET_THROUGHPUT,
+	NET_TEST_COUNT
+} net_test_t;
+
+/*
+ * struct net_probe_t - Network test request
+ *
+ * @test:	Test to run.
+ * @host:	Host name or IPv4 address to test, empty for none.
+ * @cloud:	True if @host is the Remote Manager URL.
+ * @port:	TCP port, 0 if not used.
+ * @count:	Number of probes.
+ * @interval_ms:	Time between probes.
+ * @timeout_ms:	Timeout of each probe, or of the whole test for TLS and
+ *		throughput tests.
+ * @size:	ICMP payload size, or bytes to send in throughput tests.
+ * @iface:	Interface to dump, empty for all.
+ * @cloud_path:	Remote Manager file path of cloud throughput tests.
+ * @wait_ms:	Time the data request waits for the result.
+ */
+typedef struct {
+	net_test_t test;
+	char host[MAX_HOST_LEN + 1];
+	bool cloud;
+	uint16_t port;
+	int count;
+	int interval_ms;
+	int timeout_ms;
+	size_t size;
+	char iface[IF_NAMESIZE];
+	char cloud_path[MAX_CLOUD_PATH + 1];
+	int wait_ms;
+} net_probe_t;
+
+/*
+ * struct net_slot_t - Running or finished test
+ *
+ * @probe:	Test request.
+ * @id:		Identifier of the test, reported with its result.
+ * @thread:	Thread running the test.
+ * @thread_valid:	True if @thread must be joined.
+ * @running:	True until the test finishes.
+ * @waiting:	True while the data request waits for the result.
+ * @result:	Result of the test once finished.
+ */
+typedef struct {
+	net_probe_t probe;
+	unsigned int id;
+	pthread_t thread;
+	bool thread_valid;
+	bool running;
+	bool waiting;
+	json_object *result;
+} net_slot_t;
+
+typedef int (*net_test_cb_t)(const net_probe_t *probe, json_object *result, const char **error);
+
+static int run_ping(const net_probe_t *probe, json_object *result, const char **error);
+static int run_tcp_connect(const net_probe_t *probe, json_object *result, const char **error);
+static int run_dns(const net_probe_t *probe, json_object *result, const char **error);
+static int run_tls(const net_probe_t *probe, json_object *result, const char **error);
+static int run_mtu(const net_probe_t *probe, json_object *result, const char **error);
+static int run_links(const net_probe_t *probe, json_object *result, const char **error);
+static int run_throughput(const net_probe_t *probe, json_object *result, const char **error);
+
+static const struct {
+	const char *target;
+	const char *name;
+	net_test_cb_t run;
+} tests[] = {
+	[NET_PING] = { "builtin/net_ping", "ping", run_ping },
+	[NET_TCP_CONNECT] = { "builtin/net_tcp_connect", "tcp_connect", run_tcp_connect },
+	[NET_DNS] = { "builtin/net_dns", "dns", run_dns },
+	[NET_TLS] = { "builtin/net_tls", "tls", run_tls },
+	[NET_MTU] = { "builtin/net_mtu", "mtu", run_mtu },
+	[NET_LINKS] = { "builtin/net_links", "links", run_links },
+	[NET_THROUGHPUT] = { "builtin/net_throughput", "throughput", run_throughput },
+};
+
+static net_slot_t slots[MAX_RUNNING];
+static unsigned int last_id = 0;
+static volatile bool stop_requested = false;
+static pthread_mutex_t net_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t net_cond;
+static bool net_cond_valid = false;
+
+/*
+ * get_monotonic_us() - Get the microseconds of the monotonic clock
+ *
+ * Return: Microseconds since an unspecified starting point.
+ */
+static int64_t get_monotonic_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+ * remaining_ms() - Get the milliseconds left until a deadline
+ *
+ * @deadline:	Deadline in microseconds of the monotonic clock.
+ *
+ * Return: Milliseconds left, rounded up, 0 if the deadline expired.
+ */
+static int remaining_ms(int64_t deadline)
+{
+	int64_t left = deadline - get_monotonic_us();
+
+	return left > 0 ? (int)((left + 999) / 1000) : 0;
+}
+
+/*
+ * wait_fd() - Wait until a socket is ready or a deadline expires
+ *
+ * @fd:		The socket.
+ * @events:	Events to wait for, POLLIN or POLLOUT.
+ * @deadline:	Deadline in microseconds of the monotonic clock.
+ *
+ * Return: 1 if ready, 0 on timeout or cancellation, -1 on error.
+ */
+static int wait_fd(int fd, short events, int64_t deadline)
+{
+	struct pollfd pfd = { .fd = fd, .events = events };
+	int ret;
+
+	do {
+		int left = remaining_ms(deadline);
+
+		if (left == 0 || stop_requested)
+			return 0;
+		/* Wake up periodically to check for cancellation */
+		ret = poll(&pfd, 1, left < 500 ? left : 500);
+	} while ((ret < 0 && errno == EINTR) || ret == 0);
+
+	return ret < 0 ? -1 : 1;
+}
+
+/*
+ * add_field() - Add a field to a JSON object
+ *
+ * @obj:	The JSON object.
+ * @name:	Name of the field.
+ * @value:	Value of the field, released on failure.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_field(json_object *obj, const char *name, json_object *value)
+{
+	if (!value)
+		return -1;
+
+	if (json_object_object_add(obj, name, value) < 0) {
+		json_object_put(value);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * add_address() - Add an IP address field to a JSON object
+ *
+ * @obj:	The JSON object.
+ * @name:	Name of the field.
+ * @family:	AF_INET or AF_INET6.
+ * @addr:	The address.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_address(json_object *obj, const char *name, int family, const void *addr)
+{
+	char str[INET6_ADDRSTRLEN];
+
+	if (!inet_ntop(family, addr, str, sizeof(str)))
+		return -1;
+
+	return add_field(obj, name, json_object_new_string(str));
+}
+
+/*
+ * resolve_host() - Resolve the host of a test
+ *
+ * @probe:	The test request.
+ * @addr:	Socket address to fill with the address and port of the host.
+ * @result:	Result of the test to add the address and resolution time to.
+ * @error:	Pointer to store the reason if the host cannot be resolved.
+ *
+ * Host names are resolved like the Remote Manager URL, but without using or
+ * updating the connector DNS cache.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int resolve_host(const net_probe_t *probe, struct sockaddr_in *addr,
+	json_object *result, const char **error)
+{
+	int64_t start = get_monotonic_us();
+	in_addr_t ip;
+
+	if (dns_lookup(probe->host, &ip) != 0) {
+		*error = "Unable to resolve host";
+		return -1;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = ip;
+	addr->sin_port = htons(probe->port);
+
+	if (add_address(result, "address", AF_INET, &addr->sin_addr) != 0
+		|| add_field(result, "resolve_us", json_object_new_int64(get_monotonic_us() - start)) != 0) {
+		*error = "Out of memory";
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * tcp_connect() - Open a TCP connection with a timeout
+ *
+ * @addr:	Address and port to connect to.
+ * @deadline:	Deadline in microseconds of the monotonic clock.
+ * @fd:		Pointer to store the non-blocking connected socket.
+ * @time_us:	Pointer to store the time to connect in microseconds.
+ *
+ * Return: 0 on success, the errno value otherwise.
+ */
+static int tcp_connect(const struct sockaddr_in *addr, int64_t deadline, int *fd, int64_t *time_us)
+{
+	int64_t start = get_monotonic_us();
+	socklen_t len = sizeof(int);
+	int error = 0;
+	int sock;
+
+	sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return errno;
+
+	if (connect(sock, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+		int ret;
+
+		if (errno != EINPROGRESS) {
+			error = errno;
+			goto done;
+		}
+
+		ret = wait_fd(sock, POLLOUT, deadline);
+		if (ret == 0)
+			error = stop_requested ? ECANCELED : ETIMEDOUT;
+		else if (ret < 0 || getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+			error = errno;
+	}
+
+done:
+	if (error != 0) {
+		close(sock);
+		return error;
+	}
+
+	*time_us = get_monotonic_us() - start;
+	*fd = sock;
+
+	return 0;
+}
+
+/*
+ * struct icmp_socket_t - Socket to send ICMP echo requests
+ *
+ * @fd:		The socket.
+ * @raw:	True for a raw socket, false for a datagram one.
+ * @ident:	Echo identifier, only used by raw sockets.
+ * @seq:	Sequence number of the last echo request.
+ * @buf:	Buffer for echo requests and replies.
+ */
+typedef struct {
+	int fd;
+	bool raw;
+	uint16_t ident;
+	uint16_t seq;
+	uint8_t *buf;
+} icmp_socket_t;
+
+#define ICMP_BUFFER_SIZE	(MAX_MTU + 1)
+
+/*
+ * icmp_close() - Close an ICMP socket
+ *
+ * @sock:	The socket.
+ */
+static void icmp_close(icmp_socket_t *sock)
+{
+	if (sock->fd >= 0)
+		close(sock->fd);
+	sock->fd = -1;
+	free(sock->buf);
+	sock->buf = NULL;
+}
+
+/*
+ * icmp_open() - Open an ICMP socket connected to a host
+ *
+ * @sock:	The socket to open.
+ * @addr:	Address of the host.
+ *
+ * ICMP datagram sockets are used if 'net.ipv4.ping_group_range' allows them,
+ * raw sockets otherwise.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int icmp_open(icmp_socket_t *sock, const struct sockaddr_in *addr)
+{
+	struct sockaddr_in dst = *addr;
+	pid_t tid = syscall(SYS_gettid);
+
+	sock->raw = false;
+	sock->ident = tid & 0xFFFF;
+	sock->seq = 0;
+	sock->buf = malloc(ICMP_BUFFER_SIZE);
+	if (!sock->buf) {
+		sock->fd = -1;
+		return -1;
+	}
+
+	sock->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+	if (sock->fd < 0) {
+		sock->raw = true;
+		sock->fd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+	}
+
+	dst.sin_port = 0;
+	if (sock->fd < 0 || connect(sock->fd, (const struct sockaddr *)&dst, sizeof(dst)) != 0) {
+		icmp_close(sock);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * icmp_checksum() - Calculate the Internet checksum of a buffer
+ *
+ * @data:	The buffer.
+ * @len:	Number of bytes of @data.
+ *
+ * Return: The checksum in network byte order.
+ */
+static uint16_t icmp_checksum(const uint8_t *data, size_t len)
+{
+	uint32_t sum = 0;
+
+	for (; len > 1; data += 2, len -= 2)
+		sum += (uint32_t)data[0] << 8 | data[1];
+	if (len > 0)
+		sum += (uint32_t)data[0] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+
+	return htons(~sum & 0xFFFF);
+}
+
+/*
+ * icmp_echo() - Send an ICMP echo request and wait for its reply
+ *
+ * @sock:	The ICMP socket.
+ * @size:	Payload size.
+ * @timeout_ms:	Time to wait for the reply.
+ * @rtt_us:	Pointer to store the round trip time in microseconds.
+ *
+ * Return: 1 if the reply was received, 0 on timeout, -1 on error with errno
+ *	   set (EMSGSIZE if the packet is larger than the path MTU).
+ */
+static int icmp_echo(icmp_socket_t *sock, size_t size, int timeout_ms, int64_t *rtt_us)
+{
+	uint16_t seq = ++sock->seq;
+	uint16_t checksum;
+	int64_t start, deadline;
+	size_t i;
+
+	sock->buf[0] = ICMP_ECHO;
+	sock->buf[1] = 0;
+	memset(sock->buf + 2, 0, 2);
+	sock->buf[4] = sock->ident >> 8;
+	sock->buf[5] = sock->ident & 0xFF;
+	sock->buf[6] = seq >> 8;
+	sock->buf[7] = seq & 0xFF;
+	for (i = 0; i < size; i++)
+		sock->buf[ICMP_HEADER_LEN + i] = i & 0xFF;
+	checksum = icmp_checksum(sock->buf, ICMP_HEADER_LEN + size);
+	memcpy(sock->buf + 2, &checksum, sizeof(checksum));
+
+	start = get_monotonic_us();
+	deadline = start + (int64_t)timeout_ms * 1000;
+	if (send(sock->fd, sock->buf, ICMP_HEADER_LEN + size, 0) < 0)
+		return -1;
+
+	for (;;) {
+		const uint8_t *icmp = sock->buf;
+		ssize_t len;
+		int ret = wait_fd(sock->fd, POLLIN, deadline);
+
+		if (ret <= 0)
+			return ret;
+
+		len = recv(sock->fd, sock->buf, ICMP_BUFFER_SIZE, 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (sock->raw) {
+			size_t ihl = (sock->buf[0] & 0x0F) * 4;
+
+			if ((size_t)len < ihl + ICMP_HEADER_LEN)
+				continue;
+			icmp += ihl;
+			/* Raw sockets receive the replies to every echo request */
+			if ((icmp[4] << 8 | icmp[5]) != sock->ident)
+				continue;
+		} else if (len < ICMP_HEADER_LEN) {
+			continue;
+		}
+
+		if (icmp[0] == ICMP_ECHOREPLY && (icmp[6] << 8 | icmp[7]) == seq) {
+			*rtt_us = get_monotonic_us() - start;
+			return 1;
+		}
+	}
+}
+
+/*
+ * run_ping() - Send ICMP echo requests to a host
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_ping(const net_probe_t *probe, json_object *result, const char **error)
+{
+	icmp_socket_t sock = { .fd = -1 };
+	struct sockaddr_in addr;
+	json_object *rtts = NULL;
+	int64_t min = 0, max = 0, total = 0;
+	int i, received = 0, errors = 0;
+	int ret = -1;
+
+	if (resolve_host(probe, &addr, result, error) != 0)
+		return -1;
+
+	if (icmp_open(&sock, &addr) != 0) {
+		log_net_error("Unable to open ICMP socket: %s (%d)", strerror(errno), errno);
+		*error = "Unable to open ICMP socket";
+		return -1;
+	}
+
+	rtts = json_object_new_array();
+	if (!rtts)
+		goto oom;
+
+	for (i = 0; i < probe->count && !stop_requested; i++) {
+		int64_t next = get_monotonic_us() + (int64_t)probe->interval_ms * 1000;
+		int64_t rtt = 0;
+		int r = icmp_echo(&sock, probe->size, probe->timeout_ms, &rtt);
+
+		if (r > 0) {
+			if (received == 0 || rtt < min)
+				min = rtt;
+			if (rtt > max)
+				max = rtt;
+			total += rtt;
+			received++;
+			if (json_object_array_add(rtts, json_object_new_int64(rtt)) < 0)
+				goto oom;
+		} else {
+			if (r < 0)
+				errors++;
+			if (json_object_array_add(rtts, NULL) < 0)
+				goto oom;
+		}
+
+		if (i + 1 < probe->count && remaining_ms(next) > 0) {
+			struct timespec ts = { .tv_sec = 0 };
+			int left = remaining_ms(next);
+
+			ts.tv_sec = left / 1000;
+			ts.tv_nsec = (left % 1000) * 1000000L;
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	if (add_field(result, "socket", json_object_new_string(sock.raw ? "raw" : "datagram")) != 0
+		|| add_field(result, "sent", json_object_new_int(i)) != 0
+		|| add_field(result, "received", json_object_new_int(received)) != 0
+		|| add_field(result, "errors", json_object_new_int(errors)) != 0
+		|| add_field(result, "loss", json_object_new_int(i > 0 ? 100 * (i - received) / i : 0)) != 0)
+		goto oom;
+	if (received > 0
+		&& (add_field(result, "rtt_min_us", json_object_new_int64(min)) != 0
+		|| add_field(result, "rtt_avg_us", json_object_new_int64(total / received)) != 0
+		|| add_field(result, "rtt_max_us", json_object_new_int64(max)) != 0))
+		goto oom;
+	if (json_object_object_add(result, "rtt_us", rtts) < 0)
+		goto oom;
+	rtts = NULL;
+
+	if (received == 0)
+		*error = "No reply received";
+	ret = received > 0 ? 0 : -1;
+	goto done;
+
+oom:
+	*error = "Out of memory";
+
+done:
+	json_object_put(rtts);
+	icmp_close(&sock);
+
+	return ret;
+}
+
+/*
+ * run_tcp_connect() - Measure the time to open TCP connections to a host
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_tcp_connect(const net_probe_t *probe, json_object *result, const char **error)
+{
+	struct sockaddr_in addr;
+	json_object *attempts = NULL;
+	int64_t min = 0, max = 0, total = 0;
+	int i, connected = 0;
+	int ret = -1;
+
+	if (resolve_host(probe, &addr, result, error) != 0)
+		return -1;
+
+	attempts = json_object_new_array();
+	if (!attempts)
+		goto oom;
+
+	for (i = 0; i < probe->count && !stop_requested; i++) {
+		json_object *attempt = json_object_new_object();
+		int64_t time_us = 0;
+		int fd = -1;
+		int err;
+
+		if (!attempt || json_object_array_add(attempts, attempt) < 0) {
+			json_object_put(attempt);
+			goto oom;
+		}
+
+		err = tcp_connect(&addr, get_monotonic_us() + (int64_t)probe->timeout_ms * 1000,
+			&fd, &time_us);
+		if (err != 0) {
+			if (add_field(attempt, "error", json_object_new_string(strerror(err))) != 0)
+				goto oom;
+			continue;
+		}
+		close(fd);
+
+		if (connected == 0 || time_us < min)
+			min = time_us;
+		if (time_us > max)
+			max = time_us;
+		total += time_us;
+		connected++;
+		if (add_field(attempt, "connect_us", json_object_new_int64(time_us)) != 0)
+			goto oom;
+	}
+
+	if (add_field(result, "port", json_object_new_int(probe->port)) != 0
+		|| add_field(result, "attempts", json_object_new_int(i)) != 0
+		|| add_field(result, "connected", json_object_new_int(connected)) != 0)
+		goto oom;
+	if (connected > 0
+		&& (add_field(result, "connect_min_us", json_object_new_int64(min)) != 0
+		|| add_field(result, "connect_avg_us", json_object_new_int64(total / connected)) != 0
+		|| add_field(result, "connect_max_us", json_object_new_int64(max)) != 0))
+		goto oom;
+	if (json_object_object_add(result, "results", attempts) < 0)
+		goto oom;
+	attempts = NULL;
+
+	if (connected == 0)
+		*error = "Unable to connect";
+	ret = connected > 0 ? 0 : -1;
+	goto done;
+
+oom:
+	*error = "Out of memory";
+
+done:
+	json_object_put(attempts);
+
+	return ret;
+}
+
+/*
+ * run_dns() - Resolve a host name
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_dns(const net_probe_t *probe, json_object *result, const char **error)
+{
+	struct sockaddr_in addr;
+
+	return resolve_host(probe, &addr, result, error);
+}
+
+/*
+ * add_certificate() - Add the peer certificate details to a TLS test result
+ *
+ * @ssl:	The TLS connection.
+ * @result:	Result of the test.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_certificate(SSL *ssl, json_object *result)
+{
+	X509 *cert = SSL_get_peer_certificate(ssl);
+	long verify = SSL_get_verify_result(ssl);
+	char name[256];
+	int ret = -1;
+
+	if (add_field(result, "verified", json_object_new_boolean(cert && verify == X509_V_OK)) != 0
+		|| add_field(result, "verify_result", json_object_new_string(
+			cert ? X509_verify_cert_error_string(verify) : "No peer certificate")) != 0)
+		goto done;
+
+	if (!cert) {
+		ret = 0;
+		goto done;
+	}
+
+	if (X509_NAME_oneline(X509_get_subject_name(cert), name, sizeof(name))
+		&& add_field(result, "subject", json_object_new_string(name)) != 0)
+		goto done;
+	if (X509_NAME_oneline(X509_get_issuer_name(cert), name, sizeof(name))
+		&& add_field(result, "issuer", json_object_new_string(name)) != 0)
+		goto done;
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+	{
+		struct tm tm;
+
+		if (ASN1_TIME_to_tm(X509_get0_notAfter(cert), &tm) == 1
+			&& strftime(name, sizeof(name), "%Y-%m-%dT%H:%M:%SZ", &tm) > 0
+			&& add_field(result, "not_after", json_object_new_string(name)) != 0)
+			goto done;
+	}
+#endif
+
+	ret = 0;
+
+done:
+	X509_free(cert);
+
+	return ret;
+}
+
+/*
+ * run_tls() - Check the TLS handshake with a host
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * The handshake uses the protocol and security settings of the Remote Manager
+ * connection. The peer certificate is verified against the system CAs and the
+ * Remote Manager CA, but the handshake is completed even if it is not valid.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_tls(const net_probe_t *probe, json_object *result, const char **error)
+{
+	int64_t deadline = get_monotonic_us() + (int64_t)probe->timeout_ms * 1000;
+	struct sockaddr_in addr;
+	struct in_addr ip;
+	SSL_CTX *ctx = NULL;
+	SSL *ssl = NULL;
+	int64_t time_us = 0, start;
+	int fd = -1;
+	int err, ret = -1;
+
+	if (resolve_host(probe, &addr, result, error) != 0)
+		return -1;
+
+	err = tcp_connect(&addr, deadline, &fd, &time_us);
+	if (err != 0) {
+		log_net_debug("Unable to connect to '%s': %s", probe->host, strerror(err));
+		*error = err == ETIMEDOUT ? "Connection timed out" : "Unable to connect";
+		return -1;
+	}
+
+	*error = "Out of memory";
+	if (add_field(result, "port", json_object_new_int(probe->port)) != 0
+		|| add_field(result, "connect_us", json_object_new_int64(time_us)) != 0)
+		goto done;
+
+	*error = "Unable to set up TLS";
+	ctx = SSL_CTX_new(TLS_client_method());
+	if (!ctx)
+		goto done;
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+	SSL_CTX_set_security_level(ctx, 0);
+#endif
+	if (!SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION))
+		goto done;
+	SSL_CTX_set_default_verify_paths(ctx);
+	if (access(APP_SSL_CA_CERT_PATH, R_OK) == 0)
+		SSL_CTX_load_verify_locations(ctx, APP_SSL_CA_CERT_PATH, NULL);
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+
+	ssl = SSL_new(ctx);
+	if (!ssl || !SSL_set_fd(ssl, fd))
+		goto done;
+	if (inet_pton(AF_INET, probe->host, &ip) != 1
+		&& (!SSL_set_tlsext_host_name(ssl, probe->host) || !SSL_set1_host(ssl, probe->host)))
+		goto done;
+
+	start = get_monotonic_us();
+	for (;;) {
+		int r = SSL_connect(ssl);
+
+		if (r == 1)
+			break;
+
+		switch (SSL_get_error(ssl, r)) {
+		case SSL_ERROR_WANT_READ:
+			r = wait_fd(fd, POLLIN, deadline);
+			break;
+		case SSL_ERROR_WANT_WRITE:
+			r = wait_fd(fd, POLLOUT, deadline);
+			break;
+		default:
+		{
+			char reason[256];
+
+			ERR_error_string_n(ERR_peek_last_error(), reason, sizeof(reason));
+			log_net_debug("TLS handshake with '%s' failed: %s", probe->host, reason);
+			*error = "TLS handshake failed";
+			add_field(result, "tls_error", json_object_new_string(reason));
+			goto done;
+		}
+		}
+
+		if (r <= 0) {
+			*error = r == 0 ? "TLS handshake timed out" : "TLS handshake failed";
+			goto done;
+		}
+	}
+	time_us = get_monotonic_us() - start;
+
+	*error = "Out of memory";
+	if (add_field(result, "handshake_us", json_object_new_int64(time_us)) != 0
+		|| add_field(result, "protocol", json_object_new_string(SSL_get_version(ssl))) != 0
+		|| add_field(result, "cipher", json_object_new_string(SSL_get_cipher_name(ssl))) != 0
+		|| add_certificate(ssl, result) != 0)
+		goto done;
+
+	*error = NULL;
+	ret = 0;
+
+done:
+	SSL_free(ssl);
+	SSL_CTX_free(ctx);
+	ERR_clear_error();
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * run_mtu() - Discover the path MTU to a host
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * ICMP echo requests with the "don't fragment" bit set are sent with a binary
+ * search of their size, from the MTU of the outgoing interface down to the
+ * IPv4 minimum. Each size is tried twice before considering it too large.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_mtu(const net_probe_t *probe, json_object *result, const char **error)
+{
+	icmp_socket_t sock = { .fd = -1 };
+	struct sockaddr_in addr;
+	int pmtudisc = IP_PMTUDISC_PROBE;
+	socklen_t len = sizeof(int);
+	int lo = 0, hi = 0, probes = 0, local_mtu = 0, kernel_mtu = 0;
+	int ret = -1;
+
+	if (resolve_host(probe, &addr, result, error) != 0)
+		return -1;
+
+	if (icmp_open(&sock, &addr) != 0) {
+		log_net_error("Unable to open ICMP socket: %s (%d)", strerror(errno), errno);
+		*error = "Unable to open ICMP socket";
+		return -1;
+	}
+
+	if (setsockopt(sock.fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtudisc, sizeof(pmtudisc)) != 0
+		|| getsockopt(sock.fd, IPPROTO_IP, IP_MTU, &local_mtu, &len) != 0) {
+		*error = "Unable to set up path MTU discovery";
+		goto done;
+	}
+
+	/* Check first the MTU of the interface, the most common case */
+	lo = MIN_MTU - 1;
+	hi = local_mtu < MAX_MTU ? local_mtu : MAX_MTU;
+	while (lo < hi && probes < MAX_MTU_PROBES && !stop_requested) {
+		int mtu = probes == 0 ? hi : lo + (hi - lo + 1) / 2;
+		int tries, r = 0;
+
+		for (tries = 0; tries < MTU_PROBE_TRIES && r <= 0 && probes < MAX_MTU_PROBES
+			&& !stop_requested; tries++) {
+			int64_t rtt;
+
+			probes++;
+			r = icmp_echo(&sock, mtu - IP_HEADER_LEN - ICMP_HEADER_LEN, probe->timeout_ms, &rtt);
+			if (r < 0 && errno == EMSGSIZE)
+				break;
+		}
+
+		if (r > 0)
+			lo = mtu;
+		else
+			hi = mtu - 1;
+	}
+
+	len = sizeof(int);
+	if (getsockopt(sock.fd, IPPROTO_IP, IP_MTU, &kernel_mtu, &len) != 0)
+		kernel_mtu = 0;
+
+	*error = "Out of memory";
+	if (add_field(result, "interface_mtu", json_object_new_int(local_mtu)) != 0
+		|| add_field(result, "probes", json_object_new_int(probes)) != 0
+		|| (kernel_mtu > 0 && add_field(result, "cached_mtu", json_object_new_int(kernel_mtu)) != 0))
+		goto done;
+
+	if (lo < MIN_MTU || stop_requested) {
+		*error = stop_requested ? "Cancelled" : "No reply received";
+		goto done;
+	}
+
+	if (add_field(result, "path_mtu", json_object_new_int(lo)) != 0)
+		goto done;
+
+	*error = NULL;
+	ret = 0;
+
+done:
+	icmp_close(&sock);
+
+	return ret;
+}
+
+/*
+ * struct links_ctx_t - State of a network links dump
+ *
+ * @ifaces:	Array of interfaces.
+ * @filter:	Name of the interface to dump, empty for all.
+ * @oom:	True if out of memory.
+ */
+typedef struct {
+	json_object *ifaces;
+	const char *filter;
+	bool oom;
+} links_ctx_t;
+
+typedef void (*nl_msg_cb_t)(struct nlmsghdr *nlh, links_ctx_t *ctx);
+
+/*
+ * find_iface() - Find an interface of a links dump by index
+ *
+ * @ctx:	The links dump.
+ * @index:	Interface index.
+ *
+ * Return: The JSON object of the interface, NULL if not found.
+ */
+static json_object *find_iface(links_ctx_t *ctx, int index)
+{
+	size_t i, n = json_object_array_length(ctx->ifaces);
+
+	for (i = 0; i < n; i++) {
+		json_object *iface = json_object_array_get_idx(ctx->ifaces, i);
+		json_object *item;
+
+		if (json_object_object_get_ex(iface, "index", &item)
+			&& json_object_get_int(item) == index)
+			return iface;
+	}
+
+	return NULL;
+}
+
+/*
+ * add_to_iface_array() - Append an element to an array of an interface
+ *
+ * @iface:	JSON object of the interface.
+ * @name:	Name of the array.
+ * @value:	Element to append, released on failure.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_to_iface_array(json_object *iface, const char *name, json_object *value)
+{
+	json_object *array;
+
+	if (!json_object_object_get_ex(iface, name, &array)
+		|| json_object_array_add(array, value) < 0) {
+		json_object_put(value);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * parse_link() - Add an interface from an RTM_NEWLINK message
+ *
+ * @nlh:	The netlink message.
+ * @ctx:	The links dump.
+ */
+static void parse_link(struct nlmsghdr *nlh, links_ctx_t *ctx)
+{
+	static const char * const operstates[] = {
+		"unknown", "notpresent", "down", "lowerlayerdown",
+		"testing", "dormant", "up",
+	};
+	struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+	int len = IFLA_PAYLOAD(nlh);
+	struct rtattr *rta;
+	json_object *iface;
+	const char *name = NULL;
+	int err = 0;
+
+	if (nlh->nlmsg_type != RTM_NEWLINK)
+		return;
+
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFLA_IFNAME)
+			name = RTA_DATA(rta);
+	}
+	if (!name || (*ctx->filter != '\0' && strcmp(name, ctx->filter) != 0))
+		return;
+
+	iface = json_object_new_object();
+	if (!iface || json_object_array_add(ctx->ifaces, iface) < 0) {
+		json_object_put(iface);
+		ctx->oom = true;
+		return;
+	}
+
+	err |= add_field(iface, "name", json_object_new_string(name));
+	err |= add_field(iface, "index", json_object_new_int(ifi->ifi_index));
+	err |= add_field(iface, "up", json_object_new_boolean(!!(ifi->ifi_flags & IFF_UP)));
+	err |= add_field(iface, "running", json_object_new_boolean(!!(ifi->ifi_flags & IFF_RUNNING)));
+	err |= add_field(iface, "addresses", json_object_new_array());
+	err |= add_field(iface, "routes", json_object_new_array());
+
+	len = IFLA_PAYLOAD(nlh);
+	for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		size_t size = RTA_PAYLOAD(rta);
+
+		switch (rta->rta_type) {
+		case IFLA_MTU:
+		{
+			uint32_t mtu;
+
+			if (size >= sizeof(mtu)) {
+				memcpy(&mtu, RTA_DATA(rta), sizeof(mtu));
+				err |= add_field(iface, "mtu", json_object_new_int64(mtu));
+			}
+			break;
+		}
+		case IFLA_OPERSTATE:
+		{
+			uint8_t state = *(uint8_t *)RTA_DATA(rta);
+
+			err |= add_field(iface, "operstate", json_object_new_string(
+				state < ARRAY_SIZE(operstates) ? operstates[state] : "unknown"));
+			break;
+		}
+		case IFLA_ADDRESS:
+		{
+			const uint8_t *mac = RTA_DATA(rta);
+			char str[3 * 32];
+			size_t i;
+
+			if (size == 0 || size > 32)
+				break;
+			for (i = 0; i < size; i++)
+				sprintf(str + 3 * i, "%02X%s", mac[i], i + 1 < size ? ":" : "");
+			err |= add_field(iface, "mac", json_object_new_string(str));
+			break;
+		}
+		case IFLA_STATS64:
+		{
+			struct rtnl_link_stats64 stats;
+
+			if (size < sizeof(stats))
+				break;
+			memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+			err |= add_field(iface, "rx_bytes", json_object_new_int64(stats.rx_bytes));
+			err |= add_field(iface, "tx_bytes", json_object_new_int64(stats.tx_bytes));
+			err |= add_field(iface, "rx_packets", json_object_new_int64(stats.rx_packets));
+			err |= add_field(iface, "tx_packets", json_object_new_int64(stats.tx_packets));
+			err |= add_field(iface, "rx_errors", json_object_new_int64(stats.rx_errors));
+			err |= add_field(iface, "tx_errors", json_object_new_int64(stats.tx_errors));
+			err |= add_field(iface, "rx_dropped", json_object_new_int64(stats.rx_dropped));
+			err |= add_field(iface, "tx_dropped", json_object_new_int64(stats.tx_dropped));
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	if (err)
+		ctx->oom = true;
+}
+
+/*
+ * parse_addr() - Add an address to its interface from an RTM_NEWADDR message
+ *
+ * @nlh:	The netlink message.
+ * @ctx:	The links dump.
+ */
+static void parse_addr(struct nlmsghdr *nlh, links_ctx_t *ctx)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+	int len = IFA_PAYLOAD(nlh);
+	struct rtattr *rta;
+	const void *local = NULL, *address = NULL;
+	json_object *iface, *entry;
+	char str[INET6_ADDRSTRLEN + 4];
+
+	if (nlh->nlmsg_type != RTM_NEWADDR
+		|| (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6))
+		return;
+
+	iface = find_iface(ctx, ifa->ifa_index);
+	if (!iface)
+		return;
+
+	for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFA_LOCAL)
+			local = RTA_DATA(rta);
+		else if (rta->rta_type == IFA_ADDRESS)
+			address = RTA_DATA(rta);
+	}
+	/* For point-to-point links IFA_ADDRESS is the address of the peer */
+	if (local)
+		address = local;
+	if (!address || !inet_ntop(ifa->ifa_family, address, str, INET6_ADDRSTRLEN))
+		return;
+
+	sprintf(str + strlen(str), "/%u", ifa->ifa_prefixlen);
+	entry = json_object_new_string(str);
+	if (!entry || add_to_iface_array(iface, "addresses", entry) != 0)
+		ctx->oom = true;
+}
+
+/*
+ * parse_route() - Add a route to its interface from an RTM_NEWROUTE message
+ *
+ * @nlh:	The netlink message.
+ * @ctx:	The links dump.
+ *
+ * Only unicast routes of the main table are added.
+ */
+static void parse_route(struct nlmsghdr *nlh, links_ctx_t *ctx)
+{
+	struct rtmsg *rtm = NLMSG_DATA(nlh);
+	int len = RTM_PAYLOAD(nlh);
+	struct rtattr *rta;
+	const void *dst = NULL, *gateway = NULL;
+	uint32_t table = rtm->rtm_table, metric = 0;
+	int oif = 0;
+	json_object *iface, *route;
+	char str[INET6_ADDRSTRLEN + 4];
+	int err = 0;
+
+	if (nlh->nlmsg_type != RTM_NEWROUTE || rtm->rtm_type != RTN_UNICAST
+		|| (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6))
+		return;
+
+	for (rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case RTA_DST:
+			dst = RTA_DATA(rta);
+			break;
+		case RTA_GATEWAY:
+			gateway = RTA_DATA(rta);
+			break;
+		case RTA_OIF:
+			memcpy(&oif, RTA_DATA(rta), sizeof(oif));
+			break;
+		case RTA_PRIORITY:
+			memcpy(&metric, RTA_DATA(rta), sizeof(metric));
+			break;
+		case RTA_TABLE:
+			memcpy(&table, RTA_DATA(rta), sizeof(table));
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (table != RT_TABLE_MAIN)
+		return;
+
+	iface = find_iface(ctx, oif);
+	if (!iface)
+		return;
+
+	if (!dst || rtm->rtm_dst_len == 0)
+		strcpy(str, "default");
+	else if (inet_ntop(rtm->rtm_family, dst, str, INET6_ADDRSTRLEN))
+		sprintf(str + strlen(str), "/%u", rtm->rtm_dst_len);
+	else
+		return;
+
+	route = json_object_new_object();
+	if (!route) {
+		ctx->oom = true;
+		return;
+	}
+	err |= add_field(route, "destination", json_object_new_string(str));
+	if (gateway)
+		err |= add_address(route, "gateway", rtm->rtm_family, gateway);
+	err |= add_field(route, "metric", json_object_new_int64(metric));
+	if (err) {
+		json_object_put(route);
+		ctx->oom = true;
+		return;
+	}
+
+	if (add_to_iface_array(iface, "routes", route) != 0)
+		ctx->oom = true;
+}
+
+/*
+ * netlink_dump() - Dump a routing netlink object table
+ *
+ * @fd:		Routing netlink socket.
+ * @type:	RTM_GETLINK, RTM_GETADDR or RTM_GETROUTE.
+ * @seq:	Sequence number of the request.
+ * @cb:		Function to parse each received message.
+ * @ctx:	The links dump.
+ * @deadline:	Deadline in microseconds of the monotonic clock.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int netlink_dump(int fd, uint16_t type, uint32_t seq, nl_msg_cb_t cb,
+	links_ctx_t *ctx, int64_t deadline)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct rtgenmsg gen;
+	} req;
+	void *buf = malloc(NL_BUFFER_SIZE);
+	int ret = -1;
+
+	if (!buf)
+		return -1;
+
+	memset(&req, 0, sizeof(req));
+	req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(req.gen));
+	req.nlh.nlmsg_type = type;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nlh.nlmsg_seq = seq;
+	req.gen.rtgen_family = AF_UNSPEC;
+
+	if (send(fd, &req, req.nlh.nlmsg_len, 0) < 0)
+		goto done;
+
+	while (!ctx->oom) {
+		struct nlmsghdr *nlh;
+		ssize_t len;
+
+		if (wait_fd(fd, POLLIN, deadline) <= 0)
+			goto done;
+
+		len = recv(fd, buf, NL_BUFFER_SIZE, 0);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			goto done;
+		}
+
+		for (nlh = buf; NLMSG_OK(nlh, (size_t)len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_seq != seq)
+				continue;
+			if (nlh->nlmsg_type == NLMSG_DONE) {
+				ret = 0;
+				goto done;
+			}
+			if (nlh->nlmsg_type == NLMSG_ERROR)
+				goto done;
+			cb(nlh, ctx);
+		}
+	}
+
+done:
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * run_links() - Dump the network interfaces with their addresses and routes
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_links(const net_probe_t *probe, json_object *result, const char **error)
+{
+	int64_t deadline = get_monotonic_us() + (int64_t)probe->timeout_ms * 1000;
+	links_ctx_t ctx = { .filter = probe->iface };
+	int fd;
+	int ret = -1;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd < 0) {
+		*error = "Unable to open netlink socket";
+		return -1;
+	}
+
+	ctx.ifaces = json_object_new_array();
+	if (!ctx.ifaces || add_field(result, "interfaces", ctx.ifaces) != 0) {
+		*error = "Out of memory";
+		goto done;
+	}
+
+	*error = "Unable to dump network configuration";
+	if (netlink_dump(fd, RTM_GETLINK, 1, parse_link, &ctx, deadline) != 0
+		|| netlink_dump(fd, RTM_GETADDR, 2, parse_addr, &ctx, deadline) != 0
+		|| netlink_dump(fd, RTM_GETROUTE, 3, parse_route, &ctx, deadline) != 0) {
+		if (ctx.oom)
+			*error = "Out of memory";
+		goto done;
+	}
+
+	if (*probe->iface != '\0' && json_object_array_length(ctx.ifaces) == 0) {
+		*error = "Unknown interface";
+		goto done;
+	}
+
+	*error = NULL;
+	ret = 0;
+
+done:
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * fill_random() - Fill a buffer with pseudo-random data
+ *
+ * @buf:	The buffer.
+ * @len:	Number of bytes of @buf.
+ *
+ * Random data is not compressible, so the measured throughput does not depend
+ * on the compression of the transport.
+ */
+static void fill_random(uint8_t *buf, size_t len)
+{
+	int64_t seed = get_monotonic_us();
+	uint32_t x = (uint32_t)seed | 1;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		/* xorshift32 */
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		buf[i] = x & 0xFF;
+	}
+}
+
+/*
+ * send_to_cloud() - Upload data to a Remote Manager file with a deadline
+ *
+ * @probe:	The test request.
+ * @buf:	Data to upload.
+ * @deadline:	Deadline in microseconds of the monotonic clock.
+ * @sent:	Pointer to store the number of bytes uploaded.
+ * @error:	Pointer to store the reason if the upload fails.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int send_to_cloud(const net_probe_t *probe, const uint8_t *buf,
+	int64_t deadline, size_t *sent, const char **error)
+{
+	*sent = 0;
+
+	if (get_cloud_connection_status() != CC_STATUS_CONNECTED) {
+		*error = "Not connected to Remote Manager";
+		return -1;
+	}
+
+	while (*sent < probe->size) {
+		size_t len = probe->size - *sent;
+		int left = remaining_ms(deadline);
+		ccapi_send_error_t err;
+
+		if (len > THROUGHPUT_CHUNK_SIZE)
+			len = THROUGHPUT_CHUNK_SIZE;
+		if (left == 0 || stop_requested) {
+			*error = stop_requested ? "Cancelled" : "Upload timed out";
+			return -1;
+		}
+
+		err = ccapi_send_data_with_reply(CCAPI_TRANSPORT_TCP, probe->cloud_path,
+			"application/octet-stream", buf + *sent, len,
+			*sent == 0 ? CCAPI_SEND_BEHAVIOR_OVERWRITE : CCAPI_SEND_BEHAVIOR_APPEND,
+			(left + 999) / 1000, NULL);
+		if (err != CCAPI_SEND_ERROR_NONE) {
+			log_net_error("Unable to upload '%s': error %d", probe->cloud_path, err);
+			*error = "Upload failed";
+			return -1;
+		}
+		*sent += len;
+	}
+
+	return 0;
+}
+
+/*
+ * send_to_host() - Send data to a TCP listener with a deadline
+ *
+ * @probe:	The test request.
+ * @buf:	Data to send.
+ * @deadline:	Deadline in microseconds of the monotonic clock.
+ * @result:	Result of the test to add the connection time to.
+ * @sent:	Pointer to store the number of bytes sent.
+ * @error:	Pointer to store the reason if sending fails.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int send_to_host(const net_probe_t *probe, const uint8_t *buf,
+	int64_t deadline, json_object *result, size_t *sent, const char **error)
+{
+	struct sockaddr_in addr;
+	int64_t time_us = 0;
+	int fd = -1;
+	int err, ret = -1;
+
+	*sent = 0;
+
+	if (resolve_host(probe, &addr, result, error) != 0)
+		return -1;
+
+	err = tcp_connect(&addr, deadline, &fd, &time_us);
+	if (err != 0) {
+		*error = err == ETIMEDOUT ? "Connection timed out" : "Unable to connect";
+		return -1;
+	}
+
+	if (add_field(result, "connect_us", json_object_new_int64(time_us)) != 0) {
+		*error = "Out of memory";
+		goto done;
+	}
+
+	while (*sent < probe->size) {
+		ssize_t n = send(fd, buf + *sent, probe->size - *sent, MSG_NOSIGNAL);
+
+		if (n >= 0) {
+			*sent += n;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno != EAGAIN) {
+			*error = "Connection lost";
+			goto done;
+		}
+		if (wait_fd(fd, POLLOUT, deadline) <= 0) {
+			*error = stop_requested ? "Cancelled" : "Send timed out";
+			goto done;
+		}
+	}
+
+	ret = 0;
+
+done:
+	close(fd);
+
+	return ret;
+}
+
+/*
+ * run_throughput() - Measure the upload throughput
+ *
+ * @probe:	The test request.
+ * @result:	Result of the test.
+ * @error:	Pointer to store the reason if the test fails.
+ *
+ * Without a host, data is uploaded to a Remote Manager file through the cloud
+ * connection. With a host, data is sent to a TCP listener; the time includes
+ * the transfer to the local socket buffers, so the result is only accurate for
+ * sizes much larger than them.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int run_throughput(const net_probe_t *probe, json_object *result, const char **error)
+{
+	int64_t start = get_monotonic_us();
+	int64_t deadline = start + (int64_t)probe->timeout_ms * 1000;
+	int64_t time_us;
+	uint8_t *buf = malloc(probe->size);
+	size_t sent = 0;
+	int ret;
+
+	if (!buf) {
+		*error = "Out of memory";
+		return -1;
+	}
+	fill_random(buf, probe->size);
+
+	if (probe->cloud)
+		ret = send_to_cloud(probe, buf, deadline, &sent, error);
+	else
+		ret = send_to_host(probe, buf, deadline, result, &sent, error);
+	time_us = get_monotonic_us() - start;
+	free(buf);
+
+	if (add_field(result, "bytes", json_object_new_int64(sent)) != 0
+		|| add_field(result, "time_us", json_object_new_int64(time_us)) != 0
+		|| (probe->cloud && add_field(result, "path", json_object_new_string(probe->cloud_path)) != 0)
+		|| (time_us > 0 && add_field(result, "bytes_per_sec",
+			json_object_new_int64((int64_t)sent * 1000000 / time_us)) != 0)) {
+		*error = "Out of memory";
+		return -1;
+	}
+
+	return ret;
+}
+
+/*
+ * parse_int() - Parse an optional integer field of a request
+ *
+ * @req:	JSON object of the request.
+ * @name:	Name of the field.
+ * @min:	Minimum allowed value.
+ * @max:	Maximum allowed value.
+ * @value:	Pointer with the default value, to store the parsed one.
+ *
+ * Return: 0 on success, -1 if the field is not a valid integer.
+ */
+static int parse_int(json_object *req, const char *name, int min, int max, int *value)
+{
+	json_object *item;
+	int64_t v;
+
+	if (!json_object_object_get_ex(req, name, &item))
+		return 0;
+
+	v = json_object_get_int64(item);
+	if (!json_object_is_type(item, json_type_int) || v < min || v > max)
+		return -1;
+
+	*value = v;
+
+	return 0;
+}
+
+/*
+ * parse_probe() - Parse a network test request
+ *
+ * @test:	Test to run.
+ * @req:	JSON object of the request.
+ * @probe:	Test request to fill.
+ * @error:	Pointer to store the reason if the request is invalid.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int parse_probe(net_test_t test, json_object *req, net_probe_t *probe, const char **error)
+{
+	json_object *item;
+	int port = 0, size, max_timeout = MAX_TIMEOUT_MS;
+
+	memset(probe, 0, sizeof(*probe));
+	probe->test = test;
+	probe->count = DEFAULT_COUNT;
+	probe->interval_ms = DEFAULT_INTERVAL_MS;
+	probe->timeout_ms = DEFAULT_TIMEOUT_MS;
+	probe->wait_ms = DEFAULT_WAIT_MS;
+
+	if (json_object_object_get_ex(req, "host", &item)) {
+		const char *host = json_object_get_string(item);
+
+		if (test == NET_LINKS || !json_object_is_type(item, json_type_string)
+			|| *host == '\0' || strlen(host) > MAX_HOST_LEN) {
+			*error = "Invalid 'host'";
+			return -1;
+		}
+		strcpy(probe->host, host);
+	} else if (test != NET_LINKS) {
+		if (!cc_cfg || !cc_cfg->url || strlen(cc_cfg->url) > MAX_HOST_LEN) {
+			*error = "Missing 'host'";
+			return -1;
+		}
+		strcpy(probe->host, cc_cfg->url);
+		probe->cloud = true;
+	}
+
+	if (test == NET_TCP_CONNECT || test == NET_TLS || test == NET_THROUGHPUT) {
+		if (probe->cloud)
+			port = CLOUD_TLS_PORT;
+		else if (test == NET_TLS)
+			port = DEFAULT_TLS_PORT;
+		if (parse_int(req, "port", 1, UINT16_MAX, &port) != 0 || port == 0) {
+			*error = "Invalid 'port'";
+			return -1;
+		}
+		probe->port = port;
+	}
+
+	if (test == NET_THROUGHPUT) {
+		max_timeout = MAX_THROUGHPUT_TIMEOUT_MS;
+		probe->timeout_ms = MAX_THROUGHPUT_TIMEOUT_MS / 2;
+	} else if (test == NET_MTU) {
+		/* Up to MAX_MTU_PROBES probes may time out */
+		max_timeout = MAX_MTU_TIMEOUT_MS;
+	}
+	if (parse_int(req, "timeout", MIN_TIMEOUT_MS, max_timeout, &probe->timeout_ms) != 0) {
+		*error = "Invalid 'timeout'";
+		return -1;
+	}
+
+	if (parse_int(req, "count", 1, MAX_COUNT, &probe->count) != 0) {
+		*error = "Invalid 'count'";
+		return -1;
+	}
+
+	if (parse_int(req, "interval", MIN_INTERVAL_MS, MAX_INTERVAL_MS, &probe->interval_ms) != 0) {
+		*error = "Invalid 'interval'";
+		return -1;
+	}
+
+	if (parse_int(req, "wait", 0, MAX_WAIT_MS, &probe->wait_ms) != 0) {
+		*error = "Invalid 'wait'";
+		return -1;
+	}
+
+	if (test == NET_THROUGHPUT) {
+		size = DEFAULT_THROUGHPUT_SIZE;
+		if (parse_int(req, "size", MIN_THROUGHPUT_SIZE, MAX_THROUGHPUT_SIZE, &size) != 0) {
+			*error = "Invalid 'size'";
+			return -1;
+		}
+	} else {
+		size = DEFAULT_PING_SIZE;
+		if (parse_int(req, "size", 0, MAX_PING_SIZE, &size) != 0) {
+			*error = "Invalid 'size'";
+			return -1;
+		}
+	}
+	probe->size = size;
+
+	if (json_object_object_get_ex(req, "interface", &item)) {
+		const char *iface = json_object_get_string(item);
+
+		if (!json_object_is_type(item, json_type_string) || strlen(iface) >= IF_NAMESIZE) {
+			*error = "Invalid 'interface'";
+			return -1;
+		}
+		strcpy(probe->iface, iface);
+	}
+
+	if (json_object_object_get_ex(req, "path", &item)) {
+		const char *path = json_object_get_string(item);
+
+		if (!json_object_is_type(item, json_type_string) || *path == '\0'
+			|| strlen(path) > MAX_CLOUD_PATH || path[0] == '/' || strstr(path, "..") != NULL) {
+			*error = "Invalid 'path'";
+			return -1;
+		}
+		strcpy(probe->cloud_path, path);
+	} else {
+		strcpy(probe->cloud_path, DEFAULT_THROUGHPUT_PATH);
+	}
+
+	return 0;
+}
+
+/*
+ * net_diagnostics_threaded() - Run a network test in a new thread
+ *
+ * @data:	The slot of the test.
+ *
+ * If the data request is not waiting for the result, it is sent to the
+ * 'management/events/net_diagnostics' data stream.
+ */
+static void *net_diagnostics_threaded(void *data)
+{
+	net_slot_t *slot = data;
+	const net_probe_t *probe = &slot->probe;
+	json_object *result = json_object_new_object();
+	json_object *details = json_object_new_object();
+	const char *error = NULL;
+	bool waiting;
+	int ret = -1;
+
+	if (!result || !details) {
+		error = "Out of memory";
+	} else {
+		ret = tests[probe->test].run(probe, details, &error);
+		if (ret != 0 && !error)
+			error = "Test failed";
+	}
+
+	log_net_debug("Test %u '%s' %s%s%s", slot->id, tests[probe->test].name,
+		ret == 0 ? "done" : "failed", error ? ": " : "", error ? error : "");
+
+	if (result
+		&& (add_field(result, "status", json_object_new_string(ret == 0 ? "done" : "failed")) != 0
+		|| add_field(result, "id", json_object_new_int64(slot->id)) != 0
+		|| add_field(result, "test", json_object_new_string(tests[probe->test].name)) != 0
+		|| (*probe->host && add_field(result, "host", json_object_new_string(probe->host)) != 0)
+		|| (error && add_field(result, "error", json_object_new_string(error)) != 0)
+		|| json_object_object_add(result, "result", details) < 0)) {
+		json_object_put(details);
+		json_object_put(result);
+		result = NULL;
+	} else if (!result) {
+		json_object_put(details);
+	}
+
+	pthread_mutex_lock(&net_lock);
+	slot->running = false;
+	waiting = slot->waiting;
+	if (waiting) {
+		/* The data request answers with the result */
+		slot->result = result;
+		result = NULL;
+		pthread_cond_broadcast(&net_cond);
+	}
+	pthread_mutex_unlock(&net_lock);
+
+	if (!waiting) {
+		if (!result)
+			log_net_error("Unable to report result of test %u: %s", slot->id, "Out of memory");
+		else if (dp_send_json_event(DP_NET_DIAGNOSTICS_STREAM_ID, json_object_to_json_string(result)) != 0)
+			log_net_error("Unable to report result of test %u", slot->id);
+	}
+	json_object_put(result);
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * set_response() - Set the response of a data request
+ *
+ * @resp_buffer:	Buffer to store the answer of the request.
+ * @resp:		JSON object of the response.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int set_response(ccapi_buffer_info_t *const resp_buffer, json_object *resp)
+{
+	resp_buffer->buffer = resp ? strdup(json_object_to_json_string(resp)) : NULL;
+	resp_buffer->length = 0;
+
+	if (!resp_buffer->buffer)
+		return -1;
+
+	resp_buffer->length = strlen(resp_buffer->buffer);
+
+	return 0;
+}
+
+/*
+ * set_status_response() - Set a response with a status and an optional field
+ *
+ * @resp_buffer:	Buffer to store the answer of the request.
+ * @status:		Value of the 'status' field.
+ * @name:		Name of the additional field, NULL for none.
+ * @value:		Value of the additional field.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int set_status_response(ccapi_buffer_info_t *const resp_buffer,
+	const char *status, const char *name, json_object *value)
+{
+	json_object *resp = json_object_new_object();
+	int ret = -1;
+
+	if (!resp || add_field(resp, "status", json_object_new_string(status)) != 0) {
+		json_object_put(value);
+		goto done;
+	}
+
+	if (name && add_field(resp, name, value) != 0)
+		goto done;
+
+	ret = set_response(resp_buffer, resp);
+
+done:
+	json_object_put(resp);
+
+	return ret;
+}
+
+/*
+ * start_test() - Start a network test and wait for its result
+ *
+ * @probe:	The test request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * The connector thread is blocked for at most the requested wait time.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int start_test(const net_probe_t *probe, ccapi_buffer_info_t *const resp_buffer)
+{
+	net_slot_t *slot = NULL;
+	json_object *result = NULL;
+	struct timespec deadline;
+	bool finished = false;
+	unsigned int id;
+	int i, ret;
+
+	pthread_mutex_lock(&net_lock);
+	for (i = 0; i < MAX_RUNNING; i++) {
+		if (slots[i].running) {
+			/* Only one throughput test at a time, they would measure each other */
+			if (probe->test == NET_THROUGHPUT && slots[i].probe.test == NET_THROUGHPUT) {
+				slot = NULL;
+				break;
+			}
+			continue;
+		}
+		if (!slot)
+			slot = &slots[i];
+	}
+
+	if (!slot) {
+		pthread_mutex_unlock(&net_lock);
+		return set_status_response(resp_buffer, "busy", NULL, NULL);
+	}
+
+	/* Reap the previous test of the slot */
+	if (slot->thread_valid) {
+		pthread_join(slot->thread, NULL);
+		slot->thread_valid = false;
+	}
+	json_object_put(slot->result);
+	slot->result = NULL;
+
+	slot->probe = *probe;
+	slot->id = id = ++last_id;
+	slot->waiting = probe->wait_ms > 0;
+	slot->running = true;
+	slot->thread_valid = (pthread_create(&slot->thread, NULL, net_diagnostics_threaded, slot) == 0);
+	if (!slot->thread_valid) {
+		slot->running = false;
+		slot->waiting = false;
+		pthread_mutex_unlock(&net_lock);
+		return set_status_response(resp_buffer, "error", "error",
+			json_object_new_string("Unable to start test"));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += probe->wait_ms / 1000;
+	deadline.tv_nsec += (probe->wait_ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	while (slot->waiting && slot->running) {
+		if (pthread_cond_timedwait(&net_cond, &net_lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	/* Once not waiting, the thread reports the result to the data stream */
+	if (slot->waiting && !slot->running) {
+		finished = true;
+		result = slot->result;
+		slot->result = NULL;
+	}
+	slot->waiting = false;
+	pthread_mutex_unlock(&net_lock);
+
+	if (finished) {
+		ret = set_response(resp_buffer, result);
+		json_object_put(result);
+		return ret;
+	}
+
+	return set_status_response(resp_buffer, "started", "id", json_object_new_int64(id));
+}
+
+/*
+ * net_diagnostics_cb() - Data callback for network diagnostics data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @req_buffer:		Buffer containing the data request.
+ * @resp_buffer:	Buffer to store the answer of the request.
+ *
+ * Request (all fields are optional, 'host' defaults to the Remote Manager URL):
+ *	'builtin/net_ping':		{"host", "count", "interval", "timeout", "size", "wait"}
+ *	'builtin/net_tcp_connect':	{"host", "port", "count", "timeout", "wait"}
+ *	'builtin/net_dns':		{"host", "wait"}
+ *	'builtin/net_tls':		{"host", "port", "timeout", "wait"}
+ *	'builtin/net_mtu':		{"host", "timeout", "wait"}
+ *	'builtin/net_links':		{"interface", "timeout", "wait"}
+ *	'builtin/net_throughput':	{"host", "port", "size", "path", "timeout", "wait"}
+ * Times are in milliseconds.
+ * Response: {"status": "done"|"failed", "id": <id>, "test": <name>,
+ * "result": {...}} if the test finishes within 'wait', {"status": "started",
+ * "id": <id>} if it is still running, {"status": "busy"} if too many tests are
+ * running, or {"status": "error", "error": <description>}.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if success, any other code otherwise.
+ */
+static ccapi_receive_error_t net_diagnostics_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t const *const req_buffer,
+		ccapi_buffer_info_t *const resp_buffer)
+{
+	ccapi_receive_error_t status = CCAPI_RECEIVE_ERROR_NONE;
+	json_object *req = NULL;
+	net_probe_t probe;
+	const char *error = NULL;
+	size_t test;
+	int r;
+
+	log_net_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	resp_buffer->buffer = NULL;
+	resp_buffer->length = 0;
+
+	for (test = 0; test < ARRAY_SIZE(tests); test++) {
+		if (!strcmp(target, tests[test].target))
+			break;
+	}
+	if (test == ARRAY_SIZE(tests)) {
+		error = "Unknown target";
+		goto done;
+	}
+
+	if (req_buffer->length > 0) {
+		char *request = strndup(req_buffer->buffer, req_buffer->length);
+
+		if (!request) {
+			error = "Out of memory";
+			goto done;
+		}
+		req = json_tokener_parse(request);
+		free(request);
+		if (!req || !json_object_is_type(req, json_type_object)) {
+			error = "Invalid format";
+			goto done;
+		}
+	} else {
+		req = json_object_new_object();
+		if (!req) {
+			error = "Out of memory";
+			goto done;
+		}
+	}
+
+	if (parse_probe(test, req, &probe, &error) != 0)
+		goto done;
+
+	r = start_test(&probe, resp_buffer);
+	goto response;
+
+done:
+	log_net_error("Cannot process request for target '%s': %s", target, error);
+	r = set_status_response(resp_buffer, "error", "error", json_object_new_string(error));
+	if (r == 0)
+		status = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+
+response:
+	if (r != 0)
+		status = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+
+	json_object_put(req);
+
+	return status;
+}
+
+/*
+ * net_diagnostics_status_cb() - Status callback for network diagnostics data requests
+ *
+ * @target:		Target ID of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @resp_buffer:	Buffer containing the response data.
+ * @receive_error:	The error status of the receive process.
+ */
+static void net_diagnostics_status_cb(char const *const target,
+		ccapi_transport_t const transport,
+		ccapi_buffer_info_t *const resp_buffer,
+		ccapi_receive_error_t receive_error)
+{
+	log_net_debug("%s: target='%s' - transport='%d' - error='%d'", __func__,
+		target, transport, receive_error);
+
+	if (resp_buffer)
+		free(resp_buffer->buffer);
+}
+
+ccapi_receive_error_t register_net_diagnostics_requests(void)
+{
+	ccapi_receive_error_t error = CCAPI_RECEIVE_ERROR_NONE;
+	size_t i;
+
+	if (!net_cond_valid) {
+		pthread_condattr_t attr;
+
+		if (pthread_condattr_init(&attr) != 0)
+			return CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+		pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+		net_cond_valid = (pthread_cond_init(&net_cond, &attr) == 0);
+		pthread_condattr_destroy(&attr);
+		if (!net_cond_valid)
+			return CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	stop_requested = false;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		ccapi_receive_error_t e = ccapi_receive_add_target(tests[i].target,
+			net_diagnostics_cb, net_diagnostics_status_cb, CCAPI_RECEIVE_NO_LIMIT);
+
+		if (e == CCAPI_RECEIVE_ERROR_TARGET_ALREADY_ADDED)
+			continue;
+		if (e != CCAPI_RECEIVE_ERROR_NONE) {
+			log_net_error("Cannot register target '%s', error %d", tests[i].target, e);
+			error = e;
+		}
+	}
+
+	return error;
+}
+
+void unregister_net_diagnostics_requests(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		ccapi_receive_error_t error = ccapi_receive_remove_target(tests[i].target);
+
+		if (error != CCAPI_RECEIVE_ERROR_NONE)
+			log_net_error("Could not remove registered target '%s' (%d)", tests[i].target, error);
+	}
+
+	stop_requested = true;
+
+	for (i = 0; i < MAX_RUNNING; i++) {
+		bool thread_valid;
+
+		pthread_mutex_lock(&net_lock);
+		thread_valid = slots[i].thread_valid;
+		slots[i].thread_valid = false;
+		pthread_mutex_unlock(&net_lock);
+
+		/* The thread takes the lock when it finishes */
+		if (thread_valid)
+			pthread_join(slots[i].thread, NULL);
+
+		pthread_mutex_lock(&net_lock);
+		json_object_put(slots[i].result);
+		slots[i].result = NULL;
+		pthread_mutex_unlock(&net_lock);
+	}
+}
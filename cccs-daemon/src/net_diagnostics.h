@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef NET_DIAGNOSTICS_H_
+#define NET_DIAGNOSTICS_H_
+
+#include <cloudconnector.h>
+
+/*
+ * register_net_diagnostics_requests() - Register the network diagnostics targets
+ *
+ * 'builtin/net_ping', 'builtin/net_tcp_connect', 'builtin/net_dns',
+ * 'builtin/net_tls', 'builtin/net_mtu', 'builtin/net_links' and
+ * 'builtin/net_throughput' requests run a bounded network test in a worker
+ * thread. The result is included in the response if the test finishes within
+ * the requested wait time, otherwise it is sent to the
+ * 'management/events/net_diagnostics' data stream.
+ *
+ * Return: Error code after registering the data requests.
+ */
+ccapi_receive_error_t register_net_diagnostics_requests(void);
+
+/*
+ * unregister_net_diagnostics_requests() - Unregister the network diagnostics targets
+ *
+ * Running tests are cancelled.
+ */
+void unregister_net_diagnostics_requests(void);
+
+#endif /* NET_DIAGNOSTICS_H_ */
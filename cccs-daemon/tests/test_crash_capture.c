@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Crash capture test.
+ *
+ * This program is both the crashing process and the core dump handler. It
+ * starts the crash capture as the daemon does, so the kernel runs it with
+ * '--crash-handler' for each core dump, and crashes copies of itself with
+ * '--crash':
+ *  - The handler is registered in 'core_pattern' and the previous pattern
+ *    saved, also when registering again.
+ *  - A crash is stored compressed, with its signal, binary, build ID and a
+ *    backtrace through the crashing functions.
+ *  - Cores over the size cap are truncated and the oldest crashes removed
+ *    over the retention limit.
+ *  - Stored crashes are uploaded when connected and removed.
+ *  - With the handler disabled, the previous 'core_pattern' is restored and
+ *    core files written by the kernel to the capture directory are consumed.
+ *
+ * Remote Manager and the configuration file are replaced by fakes.
+ *
+ * It must run as root, it changes 'core_pattern' and restores it when done.
+ * It is skipped if 'core_pattern' cannot be changed.
+ *
+ * Usage: test_crash_capture
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <json_object.h>
+#include <json_tokener.h>
+#include <json_util.h>
+
+#include "_cc_datapoints.h"
+#include "crash_capture.h"
+
+#define CORE_PATTERN_FILE	"/proc/sys/kernel/core_pattern"
+#define CORE_PATTERN_SAVED_FILE	"/etc/cccs.core_pattern"
+#define CRASH_STREAM_ID		"management/events/crash"
+
+#define MAX_EVENTS		8
+#define MAX_PATTERN		256
+/* The uploads and core file scans run every 10 seconds */
+#define CAPTURE_TIMEOUT_MS	10000
+#define SCAN_TIMEOUT_MS		30000
+
+static unsigned int failures;
+
+#define CHECK(condition)						\
+	do {								\
+		if (!(condition)) {					\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #condition);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *events[MAX_EVENTS];
+static unsigned int n_events;
+static size_t cloud_bytes;
+static bool cloud_connected;
+
+static cc_cfg_t cfg;
+cc_cfg_t *cc_cfg = &cfg;
+
+static char exe[PATH_MAX];
+static char crash_dir[64];
+static char config_file[64];
+
+/*
+ * Crashing process, its functions are kept out of line and not tail called
+ * to appear in the backtrace.
+ */
+
+volatile int crash_depth;
+
+void crash_leaf(volatile int *p) __attribute__ ((noinline));
+void crash_leaf(volatile int *p)
+{
+	*p = crash_depth;
+}
+
+void crash_middle(volatile int *p) __attribute__ ((noinline));
+void crash_middle(volatile int *p)
+{
+	crash_depth++;
+	crash_leaf(p);
+	crash_depth++;
+}
+
+static int crash(void)
+{
+	crash_middle(NULL);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Fakes of the configuration, the connector and the data point functions.
+ */
+
+/*
+ * parse_configuration() - Read the test configuration file
+ *
+ * The file has the capture directory and the size caps in 'kb', as
+ * '<path> <max core> <max stored> <max stored size>'.
+ */
+int parse_configuration(const char *const filename, cc_cfg_t *cc_cfg)
+{
+	char path[PATH_MAX];
+	unsigned int max_core_kb, max_stored, max_stored_kb;
+	FILE *fp = fopen(filename, "r");
+	int n;
+
+	if (!fp)
+		return -1;
+	n = fscanf(fp, "%4095s %u %u %u", path, &max_core_kb, &max_stored, &max_stored_kb);
+	fclose(fp);
+	if (n != 4)
+		return -1;
+
+	cc_cfg->services = CRASH_CAPTURE_SERVICE;
+	cc_cfg->crash_handler = true;
+	cc_cfg->crash_path = strdup(path);
+	cc_cfg->crash_max_core_kb = max_core_kb;
+	cc_cfg->crash_max_stored = max_stored;
+	cc_cfg->crash_max_stored_kb = max_stored_kb;
+	cc_cfg->log_level = LOG_DEBUG;
+
+	return cc_cfg->crash_path ? 0 : -1;
+}
+
+void free_configuration(cc_cfg_t *const config)
+{
+	if (config)
+		free(config->crash_path);
+	free(config);
+}
+
+ccapi_send_error_t ccapi_send_data_with_reply(ccapi_transport_t const transport,
+	char const *const cloud_path, char const *const content_type,
+	void const *const data, size_t const bytes, ccapi_send_behavior_t const behavior,
+	unsigned long const timeout, ccapi_string_info_t *const hint)
+{
+	(void)transport;
+	(void)content_type;
+	(void)data;
+	(void)timeout;
+	(void)hint;
+
+	if (strncmp(cloud_path, "crashes/", 8) != 0)
+		return CCAPI_SEND_ERROR_X;
+
+	pthread_mutex_lock(&fake_lock);
+	if (behavior == CCAPI_SEND_BEHAVIOR_OVERWRITE)
+		printf("Uploading '%s'\n", cloud_path);
+	cloud_bytes += bytes;
+	pthread_mutex_unlock(&fake_lock);
+
+	return CCAPI_SEND_ERROR_NONE;
+}
+
+cc_status_t get_cloud_connection_status(void)
+{
+	return cloud_connected ? CC_STATUS_CONNECTED : CC_STATUS_DISCONNECTED;
+}
+
+int dp_send_json_event(char const *const stream_id, char const *const json)
+{
+	if (strcmp(stream_id, CRASH_STREAM_ID) != 0)
+		return -1;
+
+	pthread_mutex_lock(&fake_lock);
+	if (n_events < MAX_EVENTS)
+		events[n_events++] = strdup(json);
+	pthread_mutex_unlock(&fake_lock);
+
+	return 0;
+}
+
+/*
+ * Helpers.
+ */
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int read_line(const char *path, char *buf, size_t size)
+{
+	FILE *fp = fopen(path, "r");
+	bool ok;
+
+	if (!fp)
+		return -1;
+	ok = fgets(buf, size, fp) != NULL;
+	fclose(fp);
+	if (!ok)
+		return -1;
+	buf[strcspn(buf, "\n")] = '\0';
+
+	return 0;
+}
+
+static int write_line(const char *path, const char *line)
+{
+	FILE *fp = fopen(path, "w");
+	int ret = 0;
+
+	if (!fp || fprintf(fp, "%s\n", line) < 0)
+		ret = -1;
+	if (fp && fclose(fp) != 0)
+		ret = -1;
+
+	return ret;
+}
+
+static void write_config(unsigned int max_core_kb, unsigned int max_stored, unsigned int max_stored_kb)
+{
+	char line[128];
+
+	snprintf(line, sizeof(line), "%s %u %u %u", crash_dir, max_core_kb, max_stored, max_stored_kb);
+	CHECK(write_line(config_file, line) == 0);
+
+	free(cfg.crash_path);
+	memset(&cfg, 0, sizeof(cfg));
+	CHECK(parse_configuration(config_file, &cfg) == 0);
+}
+
+/*
+ * find_crash() - Find the stored crash of a process
+ *
+ * @pid:	PID of the crashed process, 0 for any.
+ * @ext:	Extension of the file to find.
+ * @path:	Buffer to store the path of the file, at least PATH_MAX bytes.
+ *
+ * Return: Number of files with @ext of @pid.
+ */
+static int find_crash(pid_t pid, const char *ext, char *path)
+{
+	DIR *d = opendir(crash_dir);
+	struct dirent *entry;
+	char infix[32];
+	int n = 0;
+
+	if (!d)
+		return 0;
+
+	snprintf(infix, sizeof(infix), "-%d-", pid);
+	while ((entry = readdir(d)) != NULL) {
+		size_t len = strlen(entry->d_name);
+
+		if (len <= strlen(ext) || strcmp(entry->d_name + len - strlen(ext), ext) != 0
+			|| (pid > 0 && !strstr(entry->d_name, infix)))
+			continue;
+		snprintf(path, PATH_MAX, "%s/%s", crash_dir, entry->d_name);
+		n++;
+	}
+	closedir(d);
+
+	return n;
+}
+
+/*
+ * wait_crash() - Wait for the metadata of a stored crash
+ *
+ * @pid:	PID of the crashed process, 0 for any.
+ * @timeout_ms:	Maximum time to wait.
+ *
+ * Return: The metadata, NULL if not stored in time.
+ */
+static json_object *wait_crash(pid_t pid, int64_t timeout_ms)
+{
+	int64_t deadline = now_ms() + timeout_ms;
+	char path[PATH_MAX];
+
+	do {
+		if (find_crash(pid, ".json", path) > 0) {
+			json_object *meta = json_object_from_file(path);
+
+			if (meta) {
+				printf("%s\n  %s\n", path, json_object_to_json_string(meta));
+				return meta;
+			}
+		}
+		usleep(100 * 1000);
+	} while (now_ms() < deadline);
+
+	fprintf(stderr, "Crash of pid %d not stored\n", pid);
+	failures++;
+
+	return NULL;
+}
+
+/*
+ * run_crash() - Run a copy of this program that crashes
+ *
+ * Return: PID of the crashed process, -1 on error.
+ */
+static pid_t run_crash(void)
+{
+	pid_t pid = fork();
+	int status;
+
+	if (pid == 0) {
+		struct rlimit limit = { RLIM_INFINITY, RLIM_INFINITY };
+
+		setrlimit(RLIMIT_CORE, &limit);
+		execl(exe, exe, "--crash", (char *) NULL);
+		_exit(127);
+	}
+	if (pid < 0 || waitpid(pid, &status, 0) != pid)
+		return -1;
+
+	CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+	CHECK(WCOREDUMP(status));
+
+	return pid;
+}
+
+static const char *get_string(json_object *obj, const char *name)
+{
+	json_object *item;
+
+	if (!obj || !json_object_object_get_ex(obj, name, &item)
+		|| !json_object_is_type(item, json_type_string))
+		return "";
+
+	return json_object_get_string(item);
+}
+
+static int64_t get_int(json_object *obj, const char *name)
+{
+	json_object *item;
+
+	if (!obj || !json_object_object_get_ex(obj, name, &item))
+		return -1;
+
+	return json_object_get_int64(item);
+}
+
+static bool is_truncated(json_object *meta)
+{
+	json_object *item;
+
+	return meta && json_object_object_get_ex(meta, "core_truncated", &item)
+		&& json_object_get_boolean(item);
+}
+
+static bool in_backtrace(json_object *meta, const char *function)
+{
+	json_object *backtrace;
+	char symbol[64];
+	size_t i;
+
+	if (!json_object_object_get_ex(meta, "backtrace", &backtrace))
+		return false;
+
+	snprintf(symbol, sizeof(symbol), " %s+0x", function);
+	for (i = 0; i < json_object_array_length(backtrace); i++) {
+		if (strstr(json_object_get_string(json_object_array_get_idx(backtrace, i)), symbol))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * gunzip_size() - Get the uncompressed size of a stored core
+ *
+ * Return: Bytes of the uncompressed core, -1 if it is not valid.
+ */
+static int64_t gunzip_size(const char *path)
+{
+	gzFile gz = gzopen(path, "rb");
+	char buffer[64 * 1024];
+	int64_t total = 0;
+	int n;
+
+	if (!gz)
+		return -1;
+	while ((n = gzread(gz, buffer, sizeof(buffer))) > 0)
+		total += n;
+	gzclose(gz);
+
+	return n < 0 ? -1 : total;
+}
+
+static void check_crash(json_object *meta, pid_t pid)
+{
+	CHECK(get_int(meta, "pid") == pid);
+	CHECK(get_int(meta, "signal") == SIGSEGV);
+	CHECK(!strncmp(get_string(meta, "name"), "test_crash_capt", 15));
+	CHECK(!strcmp(get_string(meta, "binary"), exe));
+	CHECK(get_int(meta, "core_size") > 0);
+	CHECK(in_backtrace(meta, "crash_leaf"));
+	CHECK(in_backtrace(meta, "crash_middle"));
+}
+
+static void remove_dir(const char *dir)
+{
+	DIR *d = opendir(dir);
+	struct dirent *entry;
+
+	if (!d)
+		return;
+	while ((entry = readdir(d)) != NULL) {
+		char path[PATH_MAX];
+
+		if (entry->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+/*
+ * Tests.
+ */
+
+static void test_register(const char *original)
+{
+	char pattern[MAX_PATTERN], expected[PATH_MAX + 128], saved[MAX_PATTERN];
+
+	snprintf(expected, sizeof(expected), "|%s --crash-handler -c %s %%P %%s %%t %%e",
+		exe, config_file);
+
+	/* Registering again keeps the pattern saved the first time */
+	CHECK(start_crash_capture(config_file) == 0);
+	stop_crash_capture();
+	CHECK(start_crash_capture(config_file) == 0);
+
+	CHECK(read_line(CORE_PATTERN_FILE, pattern, sizeof(pattern)) == 0);
+	CHECK(!strcmp(pattern, expected));
+	CHECK(read_line(CORE_PATTERN_SAVED_FILE, saved, sizeof(saved)) == 0);
+	CHECK(!strcmp(saved, original));
+}
+
+static void test_capture(void)
+{
+	json_object *meta;
+	char path[PATH_MAX];
+	pid_t pid;
+
+	pid = run_crash();
+	meta = wait_crash(pid, CAPTURE_TIMEOUT_MS);
+	check_crash(meta, pid);
+	CHECK(*get_string(meta, "build_id") != '\0');
+	CHECK(!is_truncated(meta));
+	CHECK(find_crash(pid, ".core.gz", path) == 1);
+	CHECK(get_int(meta, "core_stored_size") > 0);
+	/* The whole core is stored */
+	CHECK(gunzip_size(path) == get_int(meta, "core_size"));
+	json_object_put(meta);
+}
+
+static void test_retention(void)
+{
+	json_object *meta;
+	char path[PATH_MAX];
+	struct stat st;
+	pid_t first, pid;
+	int i;
+
+	/* 16 kB cores, 2 crashes */
+	write_config(16, 2, 4096);
+	CHECK(find_crash(0, ".json", path) == 1);
+	first = (pid_t) -1;
+	for (i = 0; i < 2; i++) {
+		/* Crashes are sorted by time in seconds */
+		sleep(1);
+		pid = run_crash();
+		if (first == -1)
+			first = pid;
+		meta = wait_crash(pid, CAPTURE_TIMEOUT_MS);
+		check_crash(meta, pid);
+		/* Most of the cap is used */
+		CHECK(get_int(meta, "core_stored_size") > 8 * 1024);
+		CHECK(get_int(meta, "core_stored_size") <= 16 * 1024);
+		CHECK(get_int(meta, "core_size") > 16 * 1024);
+		CHECK(find_crash(pid, ".core.gz", path) == 1);
+		CHECK(stat(path, &st) == 0 && st.st_size <= 16 * 1024);
+		CHECK(is_truncated(meta));
+		/* Truncated, but still a valid compressed file */
+		CHECK(gunzip_size(path) > 0);
+		json_object_put(meta);
+	}
+
+	/* The first crash of test_capture() was removed */
+	CHECK(find_crash(0, ".json", path) == 2);
+	CHECK(find_crash(0, ".core.gz", path) == 2);
+	CHECK(find_crash(first, ".json", path) == 1);
+}
+
+static void test_upload(void)
+{
+	int64_t deadline = now_ms() + SCAN_TIMEOUT_MS;
+	char path[PATH_MAX];
+	unsigned int i, n;
+
+	cloud_connected = true;
+	do {
+		usleep(100 * 1000);
+		pthread_mutex_lock(&fake_lock);
+		n = n_events;
+		pthread_mutex_unlock(&fake_lock);
+	} while (n < 2 && now_ms() < deadline);
+	cloud_connected = false;
+
+	CHECK(n == 2);
+	CHECK(cloud_bytes > 0);
+	/* Uploaded crashes are removed */
+	CHECK(find_crash(0, ".json", path) == 0);
+	CHECK(find_crash(0, ".core.gz", path) == 0);
+
+	for (i = 0; i < n; i++) {
+		json_object *event = json_tokener_parse(events[i]);
+
+		printf("Event %s\n", events[i]);
+		CHECK(!strncmp(get_string(event, "core"), "crashes/", 8));
+		CHECK(get_int(event, "signal") == SIGSEGV);
+		json_object_put(event);
+	}
+}
+
+static void test_core_files(const char *original)
+{
+	char pattern[MAX_PATTERN];
+	json_object *meta;
+	char path[PATH_MAX];
+	pid_t pid;
+
+	/* Disabling the handler restores the previous pattern */
+	cfg.crash_handler = false;
+	CHECK(start_crash_capture(config_file) == 0);
+	CHECK(read_line(CORE_PATTERN_FILE, pattern, sizeof(pattern)) == 0);
+	CHECK(!strcmp(pattern, original));
+	CHECK(access(CORE_PATTERN_SAVED_FILE, F_OK) != 0);
+
+	/* The kernel writes the core files to the capture directory */
+	snprintf(pattern, sizeof(pattern), "%s/core.%%p", crash_dir);
+	CHECK(write_line(CORE_PATTERN_FILE, pattern) == 0);
+	pid = run_crash();
+	snprintf(path, sizeof(path), "%s/core.%d", crash_dir, pid);
+	CHECK(access(path, F_OK) == 0);
+
+	meta = wait_crash(pid, SCAN_TIMEOUT_MS);
+	CHECK(get_int(meta, "pid") == pid);
+	CHECK(get_int(meta, "signal") == SIGSEGV);
+	CHECK(in_backtrace(meta, "crash_leaf"));
+	json_object_put(meta);
+	/* The core file is consumed */
+	CHECK(access(path, F_OK) != 0);
+
+	stop_crash_capture();
+}
+
+int main(int argc, char *argv[])
+{
+	char original[MAX_PATTERN], saved[MAX_PATTERN], dir[32];
+	bool had_saved;
+	ssize_t len;
+	unsigned int i;
+
+	if (argc > 1 && !strcmp(argv[1], "--crash"))
+		return crash();
+
+	/* Invoked by the kernel as the daemon, '--crash-handler -c <config> ...' */
+	if (argc > 3 && !strcmp(argv[1], "--crash-handler") && !strcmp(argv[2], "-c"))
+		return handle_crash(argv[3], argc - 4, argv + 4);
+
+	if (read_line(CORE_PATTERN_FILE, original, sizeof(original)) != 0
+		|| access(CORE_PATTERN_FILE, W_OK) != 0) {
+		printf("Unable to change '%s', skipping\n", CORE_PATTERN_FILE);
+		return EXIT_SUCCESS;
+	}
+	had_saved = read_line(CORE_PATTERN_SAVED_FILE, saved, sizeof(saved)) == 0;
+
+	len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	snprintf(dir, sizeof(dir), "/tmp/cc_crash_XXXXXX");
+	if (len <= 0 || !mkdtemp(dir)) {
+		perror("Unable to create the test directory");
+		return EXIT_FAILURE;
+	}
+	exe[len] = '\0';
+	snprintf(crash_dir, sizeof(crash_dir), "%s/crashes", dir);
+	snprintf(config_file, sizeof(config_file), "%s/cccs.conf", dir);
+
+	/* 1 MB cores, 2 crashes */
+	write_config(1024, 2, 4096);
+
+	test_register(original);
+	test_capture();
+	test_retention();
+	test_upload();
+	stop_crash_capture();
+	test_core_files(original);
+
+	/* Restore the system state */
+	if (write_line(CORE_PATTERN_FILE, original) != 0)
+		fprintf(stderr, "Unable to restore core pattern '%s'\n", original);
+	if (had_saved)
+		write_line(CORE_PATTERN_SAVED_FILE, saved);
+	else
+		unlink(CORE_PATTERN_SAVED_FILE);
+	remove_dir(crash_dir);
+	unlink(config_file);
+	rmdir(dir);
+	free(cfg.crash_path);
+	for (i = 0; i < n_events; i++)
+		free(events[i]);
+
+	if (failures > 0) {
+		fprintf(stderr, "%u checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
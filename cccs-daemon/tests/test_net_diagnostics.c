@@ -0,0 +1,803 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Network diagnostics test.
+ *
+ * The 'builtin/net_*' data requests are run against listeners on the loopback
+ * interface started by this process:
+ *  - A TCP sink that reads and discards everything.
+ *  - A silent TCP listener that never accepts its connections.
+ *  - A closed port that refuses connections.
+ *  - A TLS server with a self-signed certificate generated at start.
+ *
+ * Remote Manager is replaced by fakes: data requests are called as the
+ * connector calls them, uploads are counted and data points are kept to
+ * check the results of tests reported in the background.
+ *
+ * It checks the results of every test, the request validation, that a data
+ * request never waits longer than its 'wait' time, the limits of running
+ * tests, and that unregistering cancels running tests.
+ *
+ * ping and mtu are skipped if ICMP sockets are not allowed.
+ *
+ * Usage: test_net_diagnostics
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json_object.h>
+#include <json_tokener.h>
+
+#include "_cc_datapoints.h"
+#include "net_diagnostics.h"
+
+#define NET_DIAGNOSTICS_STREAM_ID	"management/events/net_diagnostics"
+#define TARGET_PREFIX			"builtin/net_"
+
+#define MAX_TARGETS		8
+#define MAX_EVENTS		32
+#define EVENT_TIMEOUT_MS	15000
+/* Time a data request may take over its 'wait' time */
+#define WAIT_MARGIN_MS		300
+#define CLOUD_CHUNK_DELAY_MS	100
+
+static unsigned int failures;
+
+#define CHECK(condition)						\
+	do {								\
+		if (!(condition)) {					\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #condition);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+static struct {
+	const char *target;
+	ccapi_receive_data_cb_t data_cb;
+	ccapi_receive_status_cb_t status_cb;
+} targets[MAX_TARGETS];
+
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t events_cond = PTHREAD_COND_INITIALIZER;
+static char *events[MAX_EVENTS];
+static unsigned int n_events;
+
+static bool cloud_connected = true;
+static size_t cloud_bytes;
+static unsigned int cloud_overwrites;
+
+static cc_cfg_t cfg = { .url = "localhost" };
+cc_cfg_t *cc_cfg = &cfg;
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Fakes of the connector and the data point functions used by the daemon.
+ */
+
+ccapi_receive_error_t ccapi_receive_add_target(char const *const target,
+	ccapi_receive_data_cb_t const data_cb, ccapi_receive_status_cb_t const status_cb,
+	size_t const max_request_size)
+{
+	size_t i;
+
+	(void)max_request_size;
+
+	for (i = 0; i < MAX_TARGETS; i++) {
+		if (targets[i].target && !strcmp(targets[i].target, target))
+			return CCAPI_RECEIVE_ERROR_TARGET_ALREADY_ADDED;
+	}
+	for (i = 0; i < MAX_TARGETS; i++) {
+		if (!targets[i].target) {
+			targets[i].target = target;
+			targets[i].data_cb = data_cb;
+			targets[i].status_cb = status_cb;
+			return CCAPI_RECEIVE_ERROR_NONE;
+		}
+	}
+
+	return CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+}
+
+ccapi_receive_error_t ccapi_receive_remove_target(char const *const target)
+{
+	size_t i;
+
+	for (i = 0; i < MAX_TARGETS; i++) {
+		if (targets[i].target && !strcmp(targets[i].target, target)) {
+			targets[i].target = NULL;
+			return CCAPI_RECEIVE_ERROR_NONE;
+		}
+	}
+
+	return CCAPI_RECEIVE_ERROR_TARGET_NOT_ADDED;
+}
+
+ccapi_send_error_t ccapi_send_data_with_reply(ccapi_transport_t const transport,
+	char const *const cloud_path, char const *const content_type,
+	void const *const data, size_t const bytes, ccapi_send_behavior_t const behavior,
+	unsigned long const timeout, ccapi_string_info_t *const hint)
+{
+	(void)transport;
+	(void)cloud_path;
+	(void)content_type;
+	(void)data;
+	(void)timeout;
+	(void)hint;
+
+	usleep(CLOUD_CHUNK_DELAY_MS * 1000);
+	if (behavior == CCAPI_SEND_BEHAVIOR_OVERWRITE) {
+		cloud_bytes = 0;
+		cloud_overwrites++;
+	}
+	cloud_bytes += bytes;
+
+	return CCAPI_SEND_ERROR_NONE;
+}
+
+cc_status_t get_cloud_connection_status(void)
+{
+	return cloud_connected ? CC_STATUS_CONNECTED : CC_STATUS_DISCONNECTED;
+}
+
+int dp_send_json_event(char const *const stream_id, char const *const json)
+{
+	if (strcmp(stream_id, NET_DIAGNOSTICS_STREAM_ID) != 0)
+		return -1;
+
+	pthread_mutex_lock(&events_lock);
+	if (n_events < MAX_EVENTS)
+		events[n_events++] = strdup(json);
+	pthread_cond_broadcast(&events_cond);
+	pthread_mutex_unlock(&events_lock);
+
+	return 0;
+}
+
+/*
+ * Local listeners.
+ */
+
+static SSL_CTX *tls_ctx;
+
+/*
+ * listen_socket() - Open a TCP socket on a loopback port
+ *
+ * @listening:	True to listen on the socket, false to leave the port closed.
+ * @port:	Pointer to store the port.
+ *
+ * Return: The socket, -1 on error.
+ */
+static int listen_socket(bool listening, uint16_t *port)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return -1;
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+		|| (listening && listen(fd, SOMAXCONN) != 0)
+		|| getsockname(fd, (struct sockaddr *) &addr, &len) != 0) {
+		close(fd);
+		return -1;
+	}
+	*port = ntohs(addr.sin_port);
+
+	return fd;
+}
+
+static void *sink_server(void *arg)
+{
+	int listen_fd = (int) (intptr_t) arg;
+
+	for (;;) {
+		char buffer[64 * 1024];
+		int fd = accept(listen_fd, NULL, NULL);
+
+		if (fd < 0)
+			return NULL;
+		while (read(fd, buffer, sizeof(buffer)) > 0)
+			;
+		close(fd);
+	}
+}
+
+static void *tls_server(void *arg)
+{
+	int listen_fd = (int) (intptr_t) arg;
+
+	for (;;) {
+		char buffer[256];
+		int fd = accept(listen_fd, NULL, NULL);
+		SSL *ssl;
+
+		if (fd < 0)
+			return NULL;
+
+		ssl = SSL_new(tls_ctx);
+		if (ssl && SSL_set_fd(ssl, fd) == 1 && SSL_accept(ssl) == 1) {
+			while (SSL_read(ssl, buffer, sizeof(buffer)) > 0)
+				;
+		}
+		SSL_free(ssl);
+		close(fd);
+	}
+}
+
+/*
+ * create_tls_ctx() - Create the TLS server context with a self-signed certificate
+ *
+ * Return: The context, NULL on error.
+ */
+static SSL_CTX *create_tls_ctx(void)
+{
+	EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+	EVP_PKEY *key = NULL;
+	X509 *cert = X509_new();
+	SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+	X509_NAME *name;
+	bool ok;
+
+	ok = key_ctx && cert && ctx
+		&& EVP_PKEY_keygen_init(key_ctx) == 1
+		&& EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx, NID_X9_62_prime256v1) == 1
+		&& EVP_PKEY_keygen(key_ctx, &key) == 1
+		&& ASN1_INTEGER_set(X509_get_serialNumber(cert), 1) == 1
+		&& X509_gmtime_adj(X509_getm_notBefore(cert), 0)
+		&& X509_gmtime_adj(X509_getm_notAfter(cert), 3600)
+		&& X509_set_pubkey(cert, key) == 1
+		&& (name = X509_get_subject_name(cert)) != NULL
+		&& X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+			(const unsigned char *) "localhost", -1, -1, 0) == 1
+		&& X509_set_issuer_name(cert, name) == 1
+		&& X509_sign(cert, key, EVP_sha256()) > 0
+		&& SSL_CTX_use_certificate(ctx, cert) == 1
+		&& SSL_CTX_use_PrivateKey(ctx, key) == 1;
+
+	EVP_PKEY_CTX_free(key_ctx);
+	EVP_PKEY_free(key);
+	X509_free(cert);
+	if (!ok) {
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+static int start_server(void *(*server)(void *), uint16_t *port)
+{
+	int fd = listen_socket(true, port);
+	pthread_t thread;
+
+	if (fd < 0 || pthread_create(&thread, NULL, server, (void *) (intptr_t) fd) != 0)
+		return -1;
+	pthread_detach(thread);
+
+	return 0;
+}
+
+/*
+ * Data requests.
+ */
+
+/*
+ * request() - Run a network diagnostics data request
+ *
+ * @test:	Name of the test, the target without 'builtin/net_'.
+ * @expected:	Expected return code of the data callback.
+ * @elapsed_ms:	Pointer to store the time the data callback took, NULL if not needed.
+ * @format:	Request, a printf format.
+ *
+ * Return: The response, NULL if it is not valid JSON.
+ */
+static json_object *request(const char *test, ccapi_receive_error_t expected,
+	int64_t *elapsed_ms, const char *format, ...)
+	__attribute__ ((format (printf, 4, 5)));
+
+static json_object *request(const char *test, ccapi_receive_error_t expected,
+	int64_t *elapsed_ms, const char *format, ...)
+{
+	ccapi_buffer_info_t req_buffer, resp_buffer = { 0 };
+	ccapi_receive_error_t error;
+	json_object *resp = NULL;
+	char target[64], json[256];
+	int64_t start;
+	va_list args;
+	size_t i;
+
+	va_start(args, format);
+	vsnprintf(json, sizeof(json), format, args);
+	va_end(args);
+
+	snprintf(target, sizeof(target), "%s%s", TARGET_PREFIX, test);
+	for (i = 0; i < MAX_TARGETS; i++) {
+		if (targets[i].target && !strcmp(targets[i].target, target))
+			break;
+	}
+	if (i == MAX_TARGETS) {
+		fprintf(stderr, "Target '%s' not registered\n", target);
+		failures++;
+		return NULL;
+	}
+
+	req_buffer.buffer = json;
+	req_buffer.length = strlen(json);
+
+	start = now_ms();
+	error = targets[i].data_cb(target, CCAPI_TRANSPORT_TCP, &req_buffer, &resp_buffer);
+	if (elapsed_ms)
+		*elapsed_ms = now_ms() - start;
+
+	if (error != expected) {
+		fprintf(stderr, "%s %s: error %d, expected %d\n", target, json, error, expected);
+		failures++;
+	}
+	if (resp_buffer.buffer) {
+		char *response = strndup(resp_buffer.buffer, resp_buffer.length);
+
+		if (response) {
+			printf("%s %s\n  -> %s\n", target, json, response);
+			resp = json_tokener_parse(response);
+			free(response);
+		}
+	}
+	targets[i].status_cb(target, CCAPI_TRANSPORT_TCP, &resp_buffer, error);
+
+	CHECK(resp != NULL);
+
+	return resp;
+}
+
+static const char *get_string(json_object *obj, const char *name)
+{
+	json_object *item;
+
+	if (!obj || !json_object_object_get_ex(obj, name, &item)
+		|| !json_object_is_type(item, json_type_string))
+		return "";
+
+	return json_object_get_string(item);
+}
+
+static int64_t get_int(json_object *obj, const char *name)
+{
+	json_object *item;
+
+	if (!obj || !json_object_object_get_ex(obj, name, &item)
+		|| !json_object_is_type(item, json_type_int))
+		return -1;
+
+	return json_object_get_int64(item);
+}
+
+static json_object *get_object(json_object *obj, const char *name)
+{
+	json_object *item;
+
+	if (!obj || !json_object_object_get_ex(obj, name, &item))
+		return NULL;
+
+	return item;
+}
+
+/*
+ * wait_event() - Wait for the result of a test sent to the data stream
+ *
+ * @id:	Identifier of the test.
+ *
+ * Return: The result, NULL if it is not received in time.
+ */
+static json_object *wait_event(int64_t id)
+{
+	int64_t deadline = now_ms() + EVENT_TIMEOUT_MS;
+	json_object *event = NULL;
+	unsigned int i = 0;
+
+	pthread_mutex_lock(&events_lock);
+	while (!event && now_ms() < deadline) {
+		for (; i < n_events && !event; i++) {
+			json_object *e = json_tokener_parse(events[i]);
+
+			if (get_int(e, "id") == id) {
+				printf("  event %s\n", events[i]);
+				event = e;
+			} else {
+				json_object_put(e);
+			}
+		}
+		if (!event) {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec++;
+			pthread_cond_timedwait(&events_cond, &events_lock, &ts);
+		}
+	}
+	pthread_mutex_unlock(&events_lock);
+
+	CHECK(event != NULL);
+
+	return event;
+}
+
+/*
+ * finished() - Get the final result of a test
+ *
+ * @resp:	Response of the data request, released.
+ *
+ * Return: The response if the test finished within its wait time, the result
+ *	   sent to the data stream otherwise.
+ */
+static json_object *finished(json_object *resp)
+{
+	json_object *event;
+
+	if (strcmp(get_string(resp, "status"), "started") != 0)
+		return resp;
+
+	event = wait_event(get_int(resp, "id"));
+	json_object_put(resp);
+
+	return event;
+}
+
+static void check_error(json_object *resp, const char *error)
+{
+	CHECK(!strcmp(get_string(resp, "status"), "error"));
+	CHECK(!strcmp(get_string(resp, "error"), error));
+	json_object_put(resp);
+}
+
+/*
+ * Tests.
+ */
+
+static void test_validation(void)
+{
+	ccapi_receive_error_t const invalid = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+
+	check_error(request("ping", invalid, NULL, "[1]"), "Invalid format");
+	check_error(request("ping", invalid, NULL, "{\"count\":99}"), "Invalid 'count'");
+	check_error(request("ping", invalid, NULL, "{\"interval\":10}"), "Invalid 'interval'");
+	check_error(request("ping", invalid, NULL, "{\"size\":1473}"), "Invalid 'size'");
+	check_error(request("ping", invalid, NULL, "{\"host\":\"\"}"), "Invalid 'host'");
+	check_error(request("tcp_connect", invalid, NULL, "{\"port\":0}"), "Invalid 'port'");
+	check_error(request("tls", invalid, NULL, "{\"timeout\":20000}"), "Invalid 'timeout'");
+	check_error(request("dns", invalid, NULL, "{\"wait\":5000}"), "Invalid 'wait'");
+	check_error(request("links", invalid, NULL, "{\"host\":\"127.0.0.1\"}"), "Invalid 'host'");
+	check_error(request("throughput", invalid, NULL, "{\"size\":1}"), "Invalid 'size'");
+	check_error(request("throughput", invalid, NULL, "{\"path\":\"../x\"}"), "Invalid 'path'");
+}
+
+static void test_tcp_connect(uint16_t sink_port, uint16_t closed_port)
+{
+	json_object *resp, *result, *attempts;
+
+	resp = finished(request("tcp_connect", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"port\":%u,\"count\":3}", sink_port));
+	result = get_object(resp, "result");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(!strcmp(get_string(resp, "test"), "tcp_connect"));
+	CHECK(!strcmp(get_string(result, "address"), "127.0.0.1"));
+	CHECK(get_int(result, "port") == sink_port);
+	CHECK(get_int(result, "attempts") == 3);
+	CHECK(get_int(result, "connected") == 3);
+	CHECK(get_int(result, "connect_min_us") >= 0);
+	CHECK(get_int(result, "connect_max_us") >= get_int(result, "connect_min_us"));
+	json_object_put(resp);
+
+	resp = finished(request("tcp_connect", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"localhost\",\"port\":%u,\"count\":2}", closed_port));
+	result = get_object(resp, "result");
+	attempts = get_object(result, "results");
+	CHECK(!strcmp(get_string(resp, "status"), "failed"));
+	CHECK(!strcmp(get_string(resp, "error"), "Unable to connect"));
+	CHECK(get_int(result, "connected") == 0);
+	CHECK(attempts && json_object_array_length(attempts) == 2);
+	CHECK(attempts && *get_string(json_object_array_get_idx(attempts, 0), "error") != '\0');
+	json_object_put(resp);
+}
+
+static void test_dns(void)
+{
+	json_object *resp;
+
+	resp = finished(request("dns", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"localhost\"}"));
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(!strcmp(get_string(get_object(resp, "result"), "address"), "127.0.0.1"));
+	json_object_put(resp);
+
+	resp = finished(request("dns", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"no-such-host.invalid\",\"wait\":2000}"));
+	CHECK(!strcmp(get_string(resp, "status"), "failed"));
+	CHECK(!strcmp(get_string(resp, "error"), "Unable to resolve host"));
+	json_object_put(resp);
+}
+
+static void test_tls(uint16_t tls_port, uint16_t silent_port)
+{
+	json_object *resp, *result;
+
+	resp = finished(request("tls", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"localhost\",\"port\":%u,\"wait\":2000}", tls_port));
+	result = get_object(resp, "result");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(get_int(result, "handshake_us") >= 0);
+	CHECK(!strncmp(get_string(result, "protocol"), "TLSv1.", 6));
+	CHECK(*get_string(result, "cipher") != '\0');
+	CHECK(!strcmp(get_string(result, "subject"), "/CN=localhost"));
+	/* Self-signed, reported but not verified */
+	CHECK(get_object(result, "verified") && !json_object_get_boolean(get_object(result, "verified")));
+	CHECK(*get_string(result, "verify_result") != '\0');
+	json_object_put(resp);
+
+	resp = finished(request("tls", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"port\":%u,\"timeout\":300,\"wait\":2000}", silent_port));
+	CHECK(!strcmp(get_string(resp, "status"), "failed"));
+	CHECK(!strcmp(get_string(resp, "error"), "TLS handshake timed out"));
+	json_object_put(resp);
+}
+
+static void test_icmp(void)
+{
+	json_object *resp, *result;
+	int64_t interface_mtu;
+
+	resp = finished(request("ping", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"count\":3,\"interval\":200,\"wait\":2000}"));
+	if (!strcmp(get_string(resp, "error"), "Unable to open ICMP socket")) {
+		printf("ICMP sockets not allowed, skipping ping and mtu\n");
+		json_object_put(resp);
+		return;
+	}
+	result = get_object(resp, "result");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(get_int(result, "sent") == 3);
+	CHECK(get_int(result, "received") == 3);
+	CHECK(get_int(result, "loss") == 0);
+	CHECK(get_int(result, "rtt_max_us") >= get_int(result, "rtt_min_us"));
+	CHECK(get_object(result, "rtt_us") && json_object_array_length(get_object(result, "rtt_us")) == 3);
+	json_object_put(resp);
+
+	resp = finished(request("mtu", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"timeout\":300,\"wait\":2000}"));
+	result = get_object(resp, "result");
+	interface_mtu = get_int(result, "interface_mtu");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(interface_mtu > 0);
+	/* Nothing on the loopback path is smaller than the interface */
+	CHECK(get_int(result, "path_mtu") == (interface_mtu < 65535 ? interface_mtu : 65535));
+	json_object_put(resp);
+}
+
+static void test_links(void)
+{
+	json_object *resp, *ifaces, *lo;
+
+	resp = finished(request("links", CCAPI_RECEIVE_ERROR_NONE, NULL, "{\"interface\":\"lo\"}"));
+	ifaces = get_object(get_object(resp, "result"), "interfaces");
+	lo = ifaces ? json_object_array_get_idx(ifaces, 0) : NULL;
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(ifaces && json_object_array_length(ifaces) == 1);
+	CHECK(!strcmp(get_string(lo, "name"), "lo"));
+	CHECK(get_int(lo, "mtu") > 0);
+	CHECK(get_object(lo, "addresses") && json_object_array_length(get_object(lo, "addresses")) > 0);
+	json_object_put(resp);
+
+	resp = finished(request("links", CCAPI_RECEIVE_ERROR_NONE, NULL, "{}"));
+	ifaces = get_object(get_object(resp, "result"), "interfaces");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(ifaces && json_object_array_length(ifaces) >= 1);
+	json_object_put(resp);
+
+	resp = finished(request("links", CCAPI_RECEIVE_ERROR_NONE, NULL, "{\"interface\":\"nope0\"}"));
+	CHECK(!strcmp(get_string(resp, "status"), "failed"));
+	CHECK(!strcmp(get_string(resp, "error"), "Unknown interface"));
+	json_object_put(resp);
+}
+
+static void test_throughput(uint16_t sink_port)
+{
+	json_object *resp, *result;
+
+	resp = finished(request("throughput", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"port\":%u,\"size\":2097152,\"wait\":2000}", sink_port));
+	result = get_object(resp, "result");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(get_int(result, "bytes") == 2097152);
+	CHECK(get_int(result, "bytes_per_sec") > 0);
+	json_object_put(resp);
+
+	/* Without a host, to a Remote Manager file in 64 kB chunks */
+	cloud_overwrites = 0;
+	resp = finished(request("throughput", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"size\":200000,\"path\":\"diag/t.bin\",\"wait\":2000}"));
+	result = get_object(resp, "result");
+	CHECK(!strcmp(get_string(resp, "status"), "done"));
+	CHECK(!strcmp(get_string(resp, "host"), "localhost"));
+	CHECK(!strcmp(get_string(result, "path"), "diag/t.bin"));
+	CHECK(get_int(result, "bytes") == 200000);
+	CHECK(cloud_bytes == 200000);
+	CHECK(cloud_overwrites == 1);
+	json_object_put(resp);
+
+	cloud_connected = false;
+	resp = finished(request("throughput", CCAPI_RECEIVE_ERROR_NONE, NULL, "{}"));
+	CHECK(!strcmp(get_string(resp, "status"), "failed"));
+	CHECK(!strcmp(get_string(resp, "error"), "Not connected to Remote Manager"));
+	json_object_put(resp);
+	cloud_connected = true;
+}
+
+static void test_limits(uint16_t sink_port, uint16_t silent_port)
+{
+	json_object *resp, *event;
+	int64_t elapsed, id[2];
+	int i;
+
+	/* The data request answers after 'wait', the result goes to the data stream */
+	resp = request("tls", CCAPI_RECEIVE_ERROR_NONE, &elapsed,
+		"{\"host\":\"127.0.0.1\",\"port\":%u,\"timeout\":1000,\"wait\":200}", silent_port);
+	CHECK(!strcmp(get_string(resp, "status"), "started"));
+	CHECK(elapsed >= 190 && elapsed <= 200 + WAIT_MARGIN_MS);
+	event = wait_event(get_int(resp, "id"));
+	CHECK(!strcmp(get_string(event, "status"), "failed"));
+	CHECK(!strcmp(get_string(event, "test"), "tls"));
+	json_object_put(event);
+	json_object_put(resp);
+
+	/* Two tests at most */
+	for (i = 0; i < 2; i++) {
+		resp = request("tls", CCAPI_RECEIVE_ERROR_NONE, &elapsed,
+			"{\"host\":\"127.0.0.1\",\"port\":%u,\"timeout\":1000,\"wait\":0}", silent_port);
+		CHECK(!strcmp(get_string(resp, "status"), "started"));
+		CHECK(elapsed <= WAIT_MARGIN_MS);
+		id[i] = get_int(resp, "id");
+		json_object_put(resp);
+	}
+	CHECK(id[1] == id[0] + 1);
+	resp = request("links", CCAPI_RECEIVE_ERROR_NONE, &elapsed, "{}");
+	CHECK(!strcmp(get_string(resp, "status"), "busy"));
+	CHECK(elapsed <= WAIT_MARGIN_MS);
+	json_object_put(resp);
+	for (i = 0; i < 2; i++) {
+		event = wait_event(id[i]);
+		CHECK(!strcmp(get_string(event, "error"), "TLS handshake timed out"));
+		json_object_put(event);
+	}
+
+	/* One throughput test at most, with a free slot */
+	resp = request("throughput", CCAPI_RECEIVE_ERROR_NONE, &elapsed,
+		"{\"size\":262144,\"wait\":0}");
+	CHECK(!strcmp(get_string(resp, "status"), "started"));
+	CHECK(elapsed <= WAIT_MARGIN_MS);
+	id[0] = get_int(resp, "id");
+	json_object_put(resp);
+	resp = request("throughput", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"port\":%u,\"size\":4096}", sink_port);
+	CHECK(!strcmp(get_string(resp, "status"), "busy"));
+	json_object_put(resp);
+	event = wait_event(id[0]);
+	CHECK(!strcmp(get_string(event, "status"), "done"));
+	CHECK(get_int(get_object(event, "result"), "bytes") == 262144);
+	json_object_put(event);
+}
+
+static void test_cancel(uint16_t silent_port)
+{
+	json_object *resp, *event;
+	int64_t start;
+
+	/* Waiting lets the test reach the handshake */
+	resp = request("tls", CCAPI_RECEIVE_ERROR_NONE, NULL,
+		"{\"host\":\"127.0.0.1\",\"port\":%u,\"timeout\":10000,\"wait\":300}", silent_port);
+	CHECK(!strcmp(get_string(resp, "status"), "started"));
+
+	start = now_ms();
+	unregister_net_diagnostics_requests();
+	printf("Unregistered in %lld ms with a test running\n", (long long) (now_ms() - start));
+	CHECK(now_ms() - start < 1000);
+
+	event = wait_event(get_int(resp, "id"));
+	CHECK(!strcmp(get_string(event, "status"), "failed"));
+	CHECK(get_int(get_object(event, "result"), "connect_us") >= 0);
+	json_object_put(event);
+	json_object_put(resp);
+}
+
+int main(void)
+{
+	uint16_t sink_port, silent_port, closed_port, tls_port;
+	int silent_fd, closed_fd;
+	unsigned int i;
+
+	/* As the daemon, the TLS server must not die when a test closes early */
+	signal(SIGPIPE, SIG_IGN);
+
+	tls_ctx = create_tls_ctx();
+	silent_fd = listen_socket(true, &silent_port);
+	closed_fd = listen_socket(false, &closed_port);
+	if (!tls_ctx || silent_fd < 0 || closed_fd < 0
+		|| start_server(sink_server, &sink_port) != 0
+		|| start_server(tls_server, &tls_port) != 0) {
+		fprintf(stderr, "Unable to start the local listeners\n");
+		return EXIT_FAILURE;
+	}
+
+	if (register_net_diagnostics_requests() != CCAPI_RECEIVE_ERROR_NONE) {
+		fprintf(stderr, "Unable to register the data requests\n");
+		return EXIT_FAILURE;
+	}
+
+	test_validation();
+	test_tcp_connect(sink_port, closed_port);
+	test_dns();
+	test_tls(tls_port, silent_port);
+	test_icmp();
+	test_links();
+	test_throughput(sink_port);
+	test_limits(sink_port, silent_port);
+	test_cancel(silent_port);
+
+	for (i = 0; i < MAX_TARGETS; i++)
+		CHECK(targets[i].target == NULL);
+	for (i = 0; i < n_events; i++)
+		free(events[i]);
+	close(silent_fd);
+	close(closed_fd);
+	SSL_CTX_free(tls_ctx);
+
+	if (failures > 0) {
+		fprintf(stderr, "%u checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
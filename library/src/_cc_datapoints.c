@@ -19,10 +19,12 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "ccimp/ccimp_types.h"
 #include "ccapi/ccapi_transport.h"
@@ -30,6 +32,7 @@
 #include "ccapi/ccapi_datapoints.h"
 #include "ccapi/ccapi_datapoints_binary.h"
 
+#include "cc_clock.h"
 #include "cc_error_msg.h"
 #include "cc_logging.h"
 #include "_cc_datapoints.h"
@@ -80,6 +83,43 @@ size_t dp_generate_csv_from_collection(cccs_dp_collection_t * const collection,
 	return generate_dp_csv(&process_data, buf_info, max_dp, n_dp);
 }
 
+size_t dp_generate_csv_from_latest(cccs_dp_collection_t * const collection, buffer_info_t *buf_info)
+{
+	cccs_dp_data_stream_t *current_ds;
+
+	buf_info->bytes_written = 0;
+	buf_info->bytes_available = 0;
+
+	buf_info->buffer = calloc(BUFSIZ, sizeof(*buf_info->buffer));
+	if (!buf_info->buffer) {
+		log_error("Unable to generate CSV data: %s", "Out of memory");
+		return -1;
+	}
+	buf_info->bytes_available = BUFSIZ;
+
+	for (current_ds = collection->cccs_data_stream_list; current_ds != NULL; current_ds = current_ds->next) {
+		connector_data_point_t *last_dp = current_ds->ccfsm_data_stream->point;
+		csv_process_data_t process_data;
+
+		if (last_dp == NULL)
+			continue;
+
+		while (last_dp->next != NULL)
+			last_dp = last_dp->next;
+
+		process_data.current_csv_field = csv_data;
+		process_data.current_data_stream = current_ds->ccfsm_data_stream;
+		process_data.current_data_point = last_dp;
+		process_data.data.init = false;
+
+		/* Only one data point, so the next streams are not processed */
+		if (generate_dp_csv(&process_data, buf_info, 1, NULL) == (size_t) -1)
+			return -1;
+	}
+
+	return buf_info->bytes_written;
+}
+
 /*
  * dp_free_data_point() - Free the provided data point
  *
@@ -430,9 +470,6 @@ int dp_process_send_dp_error(uint32_t type, unsigned int error,
 	char const * const buff, size_t size, char const stream_id[],
 	const char * const backlog_dir_path, uint32_t backlog_kb)
 {
-	int ret = 1;
-	char *backlog_dir = NULL;
-
 	if (!backlog_dir_path || strlen(backlog_dir_path) == 0 || backlog_kb == 0)
 		return 0;
 
@@ -519,6 +556,18 @@ int dp_process_send_dp_error(uint32_t type, unsigned int error,
 
 	log_info("%s", "Storing data points");
 
+	return dp_store_data(type, buff, size, stream_id, backlog_dir_path, backlog_kb);
+}
+
+int dp_store_data(uint32_t type, char const * const buff, size_t size,
+	char const stream_id[], const char * const backlog_dir_path, uint32_t backlog_kb)
+{
+	int ret = 1;
+	char *backlog_dir = NULL;
+
+	if (!backlog_dir_path || strlen(backlog_dir_path) == 0 || backlog_kb == 0)
+		return 1;
+
 	backlog_dir = dp_get_backlog_dir(backlog_dir_path);
 	if (!backlog_dir)
 		return 1;
@@ -531,6 +580,128 @@ int dp_process_send_dp_error(uint32_t type, unsigned int error,
 	return ret;
 }
 
+/*
+ * dp_write_fixed_csv_line() - Write a CSV line with its timestamp corrected
+ *
+ * @out:	File to write the line to.
+ * @line:	CSV line to correct.
+ */
+static void dp_write_fixed_csv_line(FILE *out, const char *line)
+{
+	const char *p, *ts_start = NULL, *ts_end = NULL;
+	bool quoted = false;
+
+	/* Timestamp is the second field */
+	for (p = line; *p != '\0'; p++) {
+		if (*p == '"') {
+			quoted = !quoted;
+		} else if (*p == ',' && !quoted) {
+			if (ts_start == NULL) {
+				ts_start = p + 1;
+			} else {
+				ts_end = p;
+				break;
+			}
+		}
+	}
+
+	if (ts_start != NULL && ts_end != NULL && ts_end > ts_start
+		&& strspn(ts_start, "0123456789") == (size_t) (ts_end - ts_start)) {
+		uint64_t ts_ms = strtoull(ts_start, NULL, 10);
+
+		fprintf(out, "%.*s%" PRIu64 "%s", (int) (ts_start - line), line,
+			clock_fix_timestamp_ms(ts_ms), ts_end);
+	} else {
+		fputs(line, out);
+	}
+}
+
+/*
+ * dp_fix_stored_timestamps() - Correct timestamps of a stored CSV file
+ *
+ * @file:	Absolute path of the stored file, updated if it is renamed.
+ *
+ * Data points stored before the system clock was set have wrong timestamps.
+ * Rewrite them, and the file name (its creation time) so it keeps its place
+ * in the backlog.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int dp_fix_stored_timestamps(char **file)
+{
+	char *name = strrchr(*file, '/');
+	char *end = NULL, *new_file = NULL, *tmp_file = NULL;
+	char *line = NULL;
+	size_t len = 0;
+	uint64_t stored_ms, fixed_ms;
+	FILE *in = NULL, *out = NULL;
+	int error = -1;
+
+	name = name != NULL ? name + 1 : *file;
+	stored_ms = strtoull(name, &end, 10);
+	if (end == name || *end != '_')
+		return 0;
+
+	fixed_ms = clock_fix_timestamp_ms(stored_ms);
+	if (fixed_ms == stored_ms)
+		return 0;
+
+	if (asprintf(&new_file, "%.*s%" PRIu64 "%s", (int) (name - *file), *file, fixed_ms, end) < 0
+		|| asprintf(&tmp_file, "%s.tmp", new_file) < 0) {
+		log_error("Unable to correct stored data timestamps: %s", "Out of memory");
+		new_file = NULL;
+		tmp_file = NULL;
+		goto done;
+	}
+
+	log_debug("Correcting timestamps of stored data in '%s'", *file);
+
+	in = fopen(*file, "r");
+	out = fopen(tmp_file, "w");
+	if (in == NULL || out == NULL) {
+		log_error("Unable to correct stored data timestamps in '%s': %s (%d)",
+			*file, strerror(errno), errno);
+		goto done;
+	}
+
+	while (getline(&line, &len, in) != -1)
+		dp_write_fixed_csv_line(out, line);
+
+	if (ferror(in) || fflush(out) != 0 || fsync(fileno(out)) != 0) {
+		log_error("Unable to correct stored data timestamps in '%s': %s (%d)",
+			*file, strerror(errno), errno);
+		goto done;
+	}
+
+	fclose(out);
+	out = NULL;
+
+	if (rename(tmp_file, new_file) != 0) {
+		log_error("Unable to correct stored data timestamps in '%s': %s (%d)",
+			*file, strerror(errno), errno);
+		goto done;
+	}
+
+	remove(*file);
+	free(*file);
+	*file = new_file;
+	new_file = NULL;
+	error = 0;
+
+done:
+	if (in != NULL)
+		fclose(in);
+	if (out != NULL) {
+		fclose(out);
+		remove(tmp_file);
+	}
+	free(line);
+	free(tmp_file);
+	free(new_file);
+
+	return error;
+}
+
 int dp_send_stored_data(char const * const backlog_dir_path)
 {
 	char *backlog_dir = dp_get_backlog_dir(backlog_dir_path);
@@ -559,7 +730,9 @@ int dp_send_stored_data(char const * const backlog_dir_path)
 		stream_id = stream_id + 1;
 
 	if (!stream_id || !strlen(stream_id)) {
-		/* CSV file */
+		/* CSV file, it may have been stored before the clock was set */
+		dp_fix_stored_timestamps(&next_file);
+
 		error = ccapi_send_file(CCAPI_TRANSPORT_TCP, next_file,
 			"DataPoint/.csv", "text/plain", CCAPI_SEND_BEHAVIOR_OVERWRITE);
 		if (error != CCAPI_SEND_ERROR_NONE)
@@ -586,4 +759,46 @@ done:
 	free(backlog_dir);
 
 	return error;
-}
\ No newline at end of file
+}
+
+int dp_send_json_event(char const * const stream_id, char const * const json)
+{
+	ccapi_dp_collection_handle_t c;
+	ccapi_dp_error_t dp_error;
+	buffer_info_t buf_info;
+	int error = -1;
+
+	dp_error = ccapi_dp_create_collection(&c);
+	if (dp_error != CCAPI_DP_ERROR_NONE) {
+		log_error("Unable to send '%s' event (%d)", stream_id, dp_error);
+		return -1;
+	}
+
+	dp_error = ccapi_dp_add_data_stream_to_collection_extra(c,
+			stream_id, CCAPI_DP_KEY_DATA_JSON, "list", NULL);
+	if (dp_error == CCAPI_DP_ERROR_NONE)
+		dp_error = ccapi_dp_add(c, stream_id, json);
+	if (dp_error != CCAPI_DP_ERROR_NONE) {
+		log_error("Unable to send '%s' event (%d)", stream_id, dp_error);
+		goto done;
+	}
+
+	if (dp_generate_csv_from_collection(c, &buf_info, DP_MAX_NUMBER_PER_REQUEST, NULL) > 0) {
+		error = ccapi_send_data(CCAPI_TRANSPORT_TCP, "DataPoint/.csv",
+			"text/plain", buf_info.buffer, buf_info.bytes_written,
+			CCAPI_SEND_BEHAVIOR_OVERWRITE);
+		if (error != CCAPI_SEND_ERROR_NONE)
+			log_error("Unable to send '%s' event: %s (%d)", stream_id,
+				to_send_error_msg(error), error);
+
+		free(buf_info.buffer);
+	} else {
+		log_error("Unable to send '%s' event: %s", stream_id,
+			"Unable to generate data to send");
+	}
+
+done:
+	ccapi_dp_destroy_collection(c);
+
+	return error ? -1 : 0;
+}
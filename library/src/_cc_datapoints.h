@@ -68,6 +68,21 @@ typedef struct ccapi_dp_collection {
 size_t dp_generate_csv_from_collection(cccs_dp_collection_t * const collection,
 	buffer_info_t *buf_info, unsigned int max_dp, unsigned int *n_dp);
 
+/*
+ * dp_generate_csv_from_latest() - Generate the CSV contents of the newest data points
+ *
+ * @collection:	Data point collection.
+ * @buf_info:	The buffer with the generated CSV.
+ *
+ * Only the newest data point of each stream is included.
+ *
+ * Buffer contains the result of the operation. It must be freed.
+ *
+ * Return: The size of the CSV buffer, -1 if error.
+ */
+size_t dp_generate_csv_from_latest(cccs_dp_collection_t * const collection,
+	buffer_info_t *buf_info);
+
 /*
  * dp_remove_from_collection() - Remove a number of data points from collection
  *
@@ -97,6 +112,21 @@ int dp_process_send_dp_error(uint32_t type, unsigned int error,
 	char const * const buff, size_t size, char const stream_id[],
 	const char * const backlog_dir_path, uint32_t backlog_kb);
 
+/*
+ * dp_store_data() - Store data points in the data backlog
+ *
+ * @type:		Format of the data points information.
+ * @buff:		Buffer with data points or absolute path of the file with them.
+ * @size:		Size of the buffer (not used for file path).
+ * @stream_id:		Stream data id to send data to for binary data points, otherwise not used.
+ * @backlog_dir_path:	Absolute path of the directory to store samples.
+ * @backlog_kb:		Maximum size (kb) of the data backlog.
+ *
+ * Return: 0 if success, 1 otherwise (also if the backlog is disabled).
+ */
+int dp_store_data(uint32_t type, char const * const buff, size_t size,
+	char const stream_id[], const char * const backlog_dir_path, uint32_t backlog_kb);
+
 /*
  * dp_send_stored_data() - Send data stored in the provided backlog directory
  *
@@ -106,4 +136,14 @@ int dp_process_send_dp_error(uint32_t type, unsigned int error,
  */
 int dp_send_stored_data(char const * const backlog_dir_path);
 
+/*
+ * dp_send_json_event() - Send a single JSON data point to Remote Manager
+ *
+ * @stream_id:	Data stream to send the data point to.
+ * @json:	Null-terminated JSON value of the data point.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+int dp_send_json_event(char const * const stream_id, char const * const json);
+
 #endif /* __CC_DATAPOINTS_H_ */
\ No newline at end of file
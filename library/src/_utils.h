@@ -20,6 +20,7 @@
 #ifndef ___UTILS_H__
 #define ___UTILS_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #ifndef TEMP_FAILURE_RETRY
@@ -148,4 +149,14 @@ char *delete_newline_character(char *str);
 int ccimp_logging_init(void);
 void ccimp_logging_deinit(void);
 
+/*
+ * ccimp_logging_set_debug() - Enable or disable the connector debug messages
+ *
+ * @enable:	True to log them, false to discard them without formatting.
+ *
+ * Messages are only logged if the log level also includes debug messages, so
+ * this must be called again after changing the log level.
+ */
+void ccimp_logging_set_debug(bool const enable);
+
 #endif /* ___UTILS_H__ */
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <libdigiapix/process.h>
+#ifdef ENABLE_ONTHEFLY_UPDATE
+#include <libuboot.h>
+#endif /* ENABLE_ONTHEFLY_UPDATE */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cc_bootenv.h"
+#include "cc_logging.h"
+
+#define BOOTENV_TAG			"BOOTENV:"
+
+#define FW_ENV_CONFIG_FILE		"/etc/fw_env.config"
+
+#define CMD_BUFSIZE			255
+
+/**
+ * log_be_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_be_debug(format, ...)					\
+	log_debug("%s " format, BOOTENV_TAG, __VA_ARGS__)
+
+/**
+ * log_be_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_be_error(format, ...)					\
+	log_error("%s " format, BOOTENV_TAG, __VA_ARGS__)
+
+static char *uboot_get(const char *const var);
+static int uboot_set(const char *const var, const char *const value);
+static char *file_get(const char *const var);
+static int file_set(const char *const var, const char *const value);
+
+static const bootenv_backend_t uboot_backend = {
+	.name = "u-boot",
+	.get = uboot_get,
+	.set = uboot_set,
+};
+
+static const bootenv_backend_t file_backend = {
+	.name = "file",
+	.get = file_get,
+	.set = file_set,
+};
+
+static const bootenv_backend_t *backend = &uboot_backend;
+static char env_file_path[PATH_MAX];
+
+/******************** U-Boot backend ********************/
+
+#ifdef ENABLE_ONTHEFLY_UPDATE
+/*
+ * uboot_open() - Open the U-Boot environment
+ *
+ * Return: The environment context, NULL on error. It must be released with
+ *         'libuboot_close()' and 'libuboot_exit()'.
+ */
+static struct uboot_ctx *uboot_open(void)
+{
+	struct uboot_ctx *ctx = NULL;
+
+	if (libuboot_initialize(&ctx, NULL) < 0) {
+		log_be_error("%s", "Unable to initialize bootloader environment");
+		return NULL;
+	}
+
+	if (libuboot_read_config(ctx, FW_ENV_CONFIG_FILE) < 0) {
+		log_be_error("Unable to read bootloader environment configuration '%s'",
+			FW_ENV_CONFIG_FILE);
+		goto error;
+	}
+
+	if (libuboot_open(ctx) < 0) {
+		log_be_error("%s", "Unable to open bootloader environment");
+		goto error;
+	}
+
+	return ctx;
+
+error:
+	libuboot_exit(ctx);
+
+	return NULL;
+}
+
+/*
+ * uboot_get() - Read a variable from the U-Boot environment
+ *
+ * @var:	Name of the variable.
+ *
+ * Return: The value of the variable (must be freed), NULL otherwise.
+ */
+static char *uboot_get(const char *const var)
+{
+	struct uboot_ctx *ctx = uboot_open();
+	char *value = NULL;
+
+	if (ctx == NULL)
+		return NULL;
+
+	value = libuboot_get_env(ctx, var);
+
+	libuboot_close(ctx);
+	libuboot_exit(ctx);
+
+	return value;
+}
+
+/*
+ * uboot_set() - Write a variable to the U-Boot environment
+ *
+ * @var:	Name of the variable.
+ * @value:	Value of the variable, NULL or empty to remove it.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int uboot_set(const char *const var, const char *const value)
+{
+	struct uboot_ctx *ctx = uboot_open();
+	int ret = -1;
+
+	if (ctx == NULL)
+		return -1;
+
+	if (libuboot_set_env(ctx, var, value != NULL && strlen(value) > 0 ? value : NULL) < 0) {
+		log_be_error("Unable to set '%s' in bootloader environment", var);
+		goto done;
+	}
+
+	if (libuboot_env_store(ctx) < 0) {
+		log_be_error("Unable to store bootloader environment (setting '%s')", var);
+		goto done;
+	}
+
+	ret = 0;
+
+done:
+	libuboot_close(ctx);
+	libuboot_exit(ctx);
+
+	return ret;
+}
+#else /* ENABLE_ONTHEFLY_UPDATE */
+/*
+ * uboot_get() - Read a variable from the U-Boot environment
+ *
+ * @var:	Name of the variable.
+ *
+ * Return: The value of the variable (must be freed), NULL otherwise.
+ */
+static char *uboot_get(const char *const var)
+{
+	char cmd[CMD_BUFSIZE] = {0};
+	char *resp = NULL;
+	size_t len;
+
+	snprintf(cmd, sizeof(cmd), "fw_printenv -n %s", var);
+	if (ldx_process_execute_cmd(cmd, &resp, 2) != 0 || resp == NULL) {
+		free(resp);
+		return NULL;
+	}
+
+	len = strlen(resp);
+	while (len > 0 && (resp[len - 1] == '\n' || resp[len - 1] == '\r'))
+		resp[--len] = '\0';
+
+	return resp;
+}
+
+/*
+ * uboot_set() - Write a variable to the U-Boot environment
+ *
+ * @var:	Name of the variable.
+ * @value:	Value of the variable, NULL or empty to remove it.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int uboot_set(const char *const var, const char *const value)
+{
+	char cmd[CMD_BUFSIZE] = {0};
+	char *resp = NULL;
+	int ret = 0;
+
+	if (value != NULL && strlen(value) > 0)
+		snprintf(cmd, sizeof(cmd), "fw_setenv %s '%s'", var, value);
+	else
+		snprintf(cmd, sizeof(cmd), "fw_setenv %s", var);
+
+	if (ldx_process_execute_cmd(cmd, &resp, 2) != 0) {
+		if (resp != NULL)
+			log_be_error("Unable to set '%s' in bootloader environment: %s", var, resp);
+		else
+			log_be_error("Unable to set '%s' in bootloader environment", var);
+		ret = -1;
+	}
+
+	free(resp);
+
+	return ret;
+}
+#endif /* ENABLE_ONTHEFLY_UPDATE */
+
+/******************** File backend ********************/
+
+/*
+ * file_get() - Read a variable from the environment file
+ *
+ * @var:	Name of the variable.
+ *
+ * Return: The value of the variable (must be freed), NULL otherwise.
+ */
+static char *file_get(const char *const var)
+{
+	size_t var_len = strlen(var);
+	char *line = NULL, *value = NULL;
+	size_t line_size = 0;
+	ssize_t len;
+	FILE *fp;
+
+	fp = fopen(env_file_path, "r");
+	if (fp == NULL)
+		return NULL;
+
+	while ((len = getline(&line, &line_size, fp)) != -1) {
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+
+		if (strncmp(line, var, var_len) == 0 && line[var_len] == '=') {
+			value = strdup(line + var_len + 1);
+			break;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+
+	return value;
+}
+
+/*
+ * file_set() - Write a variable to the environment file
+ *
+ * @var:	Name of the variable.
+ * @value:	Value of the variable, NULL or empty to remove it.
+ *
+ * The file is written to a temporary file and renamed to avoid leaving a
+ * corrupted environment if the process is interrupted.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int file_set(const char *const var, const char *const value)
+{
+	char tmp_path[PATH_MAX + 5];
+	size_t var_len = strlen(var);
+	char *line = NULL;
+	size_t line_size = 0;
+	FILE *src, *dst;
+	int ret = -1;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", env_file_path);
+
+	dst = fopen(tmp_path, "w");
+	if (dst == NULL) {
+		log_be_error("Unable to open '%s': %s (%d)", tmp_path, strerror(errno), errno);
+		return -1;
+	}
+
+	src = fopen(env_file_path, "r");
+	if (src != NULL) {
+		while (getline(&line, &line_size, src) != -1) {
+			if (strncmp(line, var, var_len) == 0 && line[var_len] == '=')
+				continue;
+			if (fputs(line, dst) < 0)
+				goto done;
+		}
+		fclose(src);
+		src = NULL;
+	}
+
+	if (value != NULL && strlen(value) > 0 && fprintf(dst, "%s=%s\n", var, value) < 0)
+		goto done;
+
+	if (fflush(dst) != 0 || fsync(fileno(dst)) != 0)
+		goto done;
+
+	ret = 0;
+
+done:
+	free(line);
+	if (src != NULL)
+		fclose(src);
+	fclose(dst);
+
+	if (ret == 0 && rename(tmp_path, env_file_path) != 0) {
+		log_be_error("Unable to write '%s': %s (%d)", env_file_path, strerror(errno), errno);
+		ret = -1;
+	}
+
+	if (ret != 0) {
+		log_be_error("Unable to set '%s' in '%s'", var, env_file_path);
+		unlink(tmp_path);
+	}
+
+	return ret;
+}
+
+/******************** Public API ********************/
+
+int bootenv_init(const char *const env_file)
+{
+	if (env_file == NULL || strlen(env_file) == 0) {
+		backend = &uboot_backend;
+		env_file_path[0] = '\0';
+	} else {
+		if (strlen(env_file) >= sizeof(env_file_path)) {
+			log_be_error("Environment file path too long '%s'", env_file);
+			return -1;
+		}
+		strcpy(env_file_path, env_file);
+		backend = &file_backend;
+	}
+
+	log_be_debug("Using '%s' bootloader environment backend", backend->name);
+
+	return 0;
+}
+
+char *bootenv_get(const char *const var)
+{
+	if (var == NULL || strlen(var) == 0)
+		return NULL;
+
+	return backend->get(var);
+}
+
+int bootenv_set(const char *const var, const char *const value)
+{
+	if (var == NULL || strlen(var) == 0)
+		return -1;
+
+	log_be_debug("Setting '%s' to '%s'", var, value != NULL ? value : "");
+
+	return backend->set(var, value);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_BOOTENV_H_
+#define CC_BOOTENV_H_
+
+/**
+ * struct bootenv_backend_t - Bootloader environment backend
+ *
+ * @name:	Name of the backend.
+ * @get:	Returns the value of a variable (must be freed) or NULL if it
+ *		does not exist or cannot be read.
+ * @set:	Sets the value of a variable, NULL or empty to remove it.
+ *		Returns 0 on success, -1 otherwise.
+ */
+typedef struct {
+	const char *name;
+	char *(*get)(const char *const var);
+	int (*set)(const char *const var, const char *const value);
+} bootenv_backend_t;
+
+/*
+ * bootenv_init() - Select the bootloader environment backend
+ *
+ * @env_file:	Absolute path of a plain 'name=value' file to use as
+ *		bootloader environment. NULL or empty to use the U-Boot
+ *		environment of the device.
+ *
+ * The file backend is a stand-in of the real bootloader environment to test
+ * the features that depend on it without modifying the device environment.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int bootenv_init(const char *const env_file);
+
+/*
+ * bootenv_get() - Read a variable from the bootloader environment
+ *
+ * @var:	Name of the variable.
+ *
+ * Return: The value of the variable (must be freed), NULL if it is not
+ *         defined or cannot be read.
+ */
+char *bootenv_get(const char *const var);
+
+/*
+ * bootenv_set() - Write a variable to the bootloader environment
+ *
+ * @var:	Name of the variable.
+ * @value:	Value of the variable, NULL or empty to remove it.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int bootenv_set(const char *const var, const char *const value);
+
+#endif /* CC_BOOTENV_H_ */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/timex.h>
+#include <time.h>
+
+#include "cc_clock.h"
+#include "cc_logging.h"
+
+#define CLOCK_TAG			"CLOCK:"
+
+#define JUMP_THRESHOLD_MS		5000
+#define SYNC_WAIT_MS			5 * 60 * 1000 /* 5 minutes */
+
+#define MAX_CORRECTIONS			8
+
+/*
+ * struct clock_correction_t - Clock step type
+ *
+ * @from_ms:	First timestamp affected by the step (boot time in the
+ * 		previous clock)
+ * @to_ms:	Last timestamp affected by the step
+ * @delta_ms:	Milliseconds to add to affected timestamps
+ */
+typedef struct {
+	uint64_t from_ms;
+	uint64_t to_ms;
+	int64_t delta_ms;
+} clock_correction_t;
+
+static pthread_mutex_t clock_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool initialized = false;
+static bool valid = false;
+/* Difference between the real time and the time since boot */
+static int64_t boot_offset_ms = 0;
+static clock_correction_t corrections[MAX_CORRECTIONS];
+static int n_corrections = 0;
+
+/*
+ * get_clock_ms() - Get the time of the given clock in milliseconds
+ *
+ * @clock_id:	Clock to read.
+ *
+ * Return: The time in milliseconds.
+ */
+static uint64_t get_clock_ms(clockid_t clock_id)
+{
+	struct timespec ts;
+
+	clock_gettime(clock_id, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * is_kernel_synced() - Check if the kernel clock is synchronized
+ *
+ * Return: True if synchronized, false otherwise.
+ */
+static bool is_kernel_synced(void)
+{
+	struct timex tx = { .modes = 0 };
+	int state = adjtimex(&tx);
+
+	return state != -1 && state != TIME_ERROR && !(tx.status & STA_UNSYNC);
+}
+
+/*
+ * update_clock_status() - Detect clock synchronization and steps
+ *
+ * Must be called with 'clock_lock' held.
+ */
+static void update_clock_status(void)
+{
+	uint64_t real_ms, boot_ms;
+	int64_t offset_ms, delta_ms;
+
+	if (valid)
+		return;
+
+	real_ms = get_clock_ms(CLOCK_REALTIME);
+	boot_ms = get_clock_ms(CLOCK_BOOTTIME);
+	offset_ms = (int64_t) (real_ms - boot_ms);
+
+	if (!initialized) {
+		boot_offset_ms = offset_ms;
+		initialized = true;
+	}
+
+	delta_ms = offset_ms - boot_offset_ms;
+	if (llabs(delta_ms) > JUMP_THRESHOLD_MS) {
+		log_info("%s Clock stepped %lld ms, correcting previous timestamps",
+			CLOCK_TAG, (long long) delta_ms);
+
+		if (n_corrections < MAX_CORRECTIONS) {
+			corrections[n_corrections].from_ms = boot_offset_ms > 0 ? boot_offset_ms : 0;
+			corrections[n_corrections].to_ms = real_ms - delta_ms;
+			corrections[n_corrections].delta_ms = delta_ms;
+			n_corrections++;
+		}
+		boot_offset_ms = offset_ms;
+
+		/* Moving forward means the time was set */
+		if (delta_ms > 0)
+			valid = true;
+	}
+
+	if (!valid && is_kernel_synced()) {
+		log_debug("%s Clock synchronized", CLOCK_TAG);
+		valid = true;
+	}
+
+	if (!valid && boot_ms >= SYNC_WAIT_MS) {
+		log_info("%s Clock not synchronized, using it as is", CLOCK_TAG);
+		valid = true;
+	}
+}
+
+bool clock_is_valid(void)
+{
+	bool ret;
+
+	pthread_mutex_lock(&clock_lock);
+	update_clock_status();
+	ret = valid;
+	pthread_mutex_unlock(&clock_lock);
+
+	return ret;
+}
+
+uint64_t clock_fix_timestamp_ms(uint64_t timestamp_ms)
+{
+	int i;
+
+	pthread_mutex_lock(&clock_lock);
+
+	update_clock_status();
+
+	for (i = 0; i < n_corrections; i++) {
+		if (timestamp_ms >= corrections[i].from_ms && timestamp_ms <= corrections[i].to_ms) {
+			timestamp_ms += corrections[i].delta_ms;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&clock_lock);
+
+	return timestamp_ms;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_CLOCK_H_
+#define CC_CLOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * clock_is_valid() - Check if the system clock can be used for timestamps
+ *
+ * The clock is valid once the kernel reports it is synchronized (NTP), a
+ * forward step of the clock is detected (the time was set), or, for systems
+ * without time synchronization, after waiting a reasonable time since boot.
+ *
+ * Every call also refreshes the clock status, so it must be called before
+ * stamping data to be able to correct the timestamp later.
+ *
+ * Return: True if the clock is valid, false otherwise.
+ */
+bool clock_is_valid(void);
+
+/*
+ * clock_fix_timestamp_ms() - Correct a timestamp taken with an invalid clock
+ *
+ * @timestamp_ms:	Timestamp in milliseconds since epoch.
+ *
+ * Timestamps taken before the system clock was set are moved by the clock
+ * step, using the time since boot as reference.
+ *
+ * Return: The corrected timestamp, the same one if it does not need to be
+ *         corrected.
+ */
+uint64_t clock_fix_timestamp_ms(uint64_t timestamp_ms);
+
+#endif /* CC_CLOCK_H_ */
@@ -0,0 +1,494 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+
+#include "cc_compression.h"
+#include "cc_logging.h"
+#include "cc_mem_budget.h"
+#include "utils.h"
+
+#define COMPRESSION_TAG			"COMPRESSION:"
+
+#define ARRAY_SIZE(array)		(sizeof(array) / sizeof(array[0]))
+
+/* Maximum number of compression streams open at the same time */
+#define MAX_STREAMS			4
+
+/* Bytes of the first input sampled to estimate the message entropy */
+#define SAMPLE_MIN			256
+#define SAMPLE_MAX			1024
+/* Inverse collision probability over 7.5 bits per byte (2^7.5) */
+#define INCOMPRESSIBLE_MIN_INV_COLLISION	181
+
+/* Load average per CPU from which the CPU is considered busy */
+#define CPU_BUSY_LOAD			1.0
+#define CPU_LOAD_CHECK_MS		1000
+
+/* zlib default level and memory level, minimum window and internal state size */
+#define DEFAULT_LEVEL			6
+#define DEFAULT_MEM_LEVEL		8
+#define MIN_WINDOW_BITS			9
+#define DEFLATE_STATE_SIZE		(6 * 1024)
+
+/**
+ * log_cmp_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_cmp_debug(format, ...)					\
+	log_debug("%s " format, COMPRESSION_TAG, __VA_ARGS__)
+
+/**
+ * log_cmp_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_cmp_info(format, ...)					\
+	log_info("%s " format, COMPRESSION_TAG, __VA_ARGS__)
+
+typedef enum {
+	LINK_UNKNOWN,
+	LINK_LAN,
+	LINK_CELLULAR,
+} link_type_t;
+
+/*
+ * struct stream_slot_t - Policy state of a compression stream
+ *
+ * @strm:	zlib stream, NULL if the slot is free.
+ * @level:	Compression level requested by the Cloud Connector.
+ * @strategy:	Compression strategy requested by the Cloud Connector.
+ * @sampled:	Whether the entropy of the current message was sampled.
+ * @cls:	Class of the current message once sampled.
+ * @charged:	Bytes charged to the memory budget for the stream.
+ * @cpu_ns:	CPU time spent compressing the current message.
+ */
+typedef struct {
+	z_streamp strm;
+	int level;
+	int strategy;
+	bool sampled;
+	compression_class_t cls;
+	size_t charged;
+	uint64_t cpu_ns;
+} stream_slot_t;
+
+static const char *const link_names[] = {
+	[LINK_UNKNOWN] = "unknown",
+	[LINK_LAN] = "LAN",
+	[LINK_CELLULAR] = "cellular",
+};
+
+static const char *const class_names[] = {
+	[COMPRESSION_CLASS_SMALL] = "small",
+	[COMPRESSION_CLASS_COMPRESSIBLE] = "compressible",
+	[COMPRESSION_CLASS_INCOMPRESSIBLE] = "incompressible",
+};
+
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static stream_slot_t slots[MAX_STREAMS];
+static int fixed_level = -1;
+static size_t mem_limit = 0;
+static link_type_t link_type = LINK_UNKNOWN;
+static int64_t saved_bytes[COMPRESSION_CLASS_COUNT];
+static uint64_t cpu_time_ns[COMPRESSION_CLASS_COUNT];
+
+static uint64_t get_time_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts) != 0)
+		return 0;
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * is_cpu_busy() - Check whether the CPU is too loaded to compress harder
+ *
+ * The load average is read at most once per second.
+ *
+ * Return: true if the load average per CPU is over the busy threshold.
+ */
+static bool is_cpu_busy(void)
+{
+	static uint64_t checked_ms = 0;
+	static bool busy = false;
+	uint64_t now = get_time_ns(CLOCK_MONOTONIC) / 1000000;
+	double load;
+
+	if (checked_ms != 0 && now - checked_ms < CPU_LOAD_CHECK_MS)
+		return busy;
+
+	checked_ms = now;
+	if (getloadavg(&load, 1) == 1)
+		busy = load / get_nprocs() >= CPU_BUSY_LOAD;
+
+	return busy;
+}
+
+/*
+ * get_level() - Get the compression level for a new message
+ *
+ * @requested:	Level requested by the Cloud Connector.
+ *
+ * Return: The configured level, or the level for the link and CPU load.
+ */
+static int get_level(int requested)
+{
+	if (fixed_level >= 0)
+		return fixed_level;
+
+	switch (__atomic_load_n(&link_type, __ATOMIC_RELAXED)) {
+		case LINK_CELLULAR:
+			return is_cpu_busy() ? Z_DEFAULT_COMPRESSION : Z_BEST_COMPRESSION;
+		case LINK_LAN:
+			return is_cpu_busy() ? Z_NO_COMPRESSION : Z_BEST_SPEED;
+		default:
+			return requested;
+	}
+}
+
+/*
+ * is_incompressible() - Estimate whether the data is worth compressing
+ *
+ * @data:	Data to check.
+ * @len:	Number of bytes of the data, at least SAMPLE_MIN.
+ *
+ * The order-2 entropy of up to SAMPLE_MAX bytes spread over the data is
+ * estimated from the byte collisions. Already compressed or encrypted data is
+ * close to 8 bits per byte, text and structured data are far below.
+ *
+ * Return: true if the entropy is over 7.5 bits per byte.
+ */
+static bool is_incompressible(const Bytef *data, uInt len)
+{
+	uint16_t counts[256] = {0};
+	uInt n = len < SAMPLE_MAX ? len : SAMPLE_MAX;
+	uInt stride = len / n;
+	uint64_t collisions = 0;
+	uInt i;
+
+	for (i = 0; i < n; i++)
+		counts[data[i * stride]]++;
+
+	for (i = 0; i < 256; i++)
+		collisions += (uint64_t) counts[i] * (counts[i] - 1);
+
+	return collisions * INCOMPRESSIBLE_MIN_INV_COLLISION < (uint64_t) n * (n - 1);
+}
+
+static size_t get_deflate_memory(int window_bits, int mem_level)
+{
+	return ((size_t) 1 << (window_bits + 2)) + ((size_t) 1 << (mem_level + 9))
+		+ DEFLATE_STATE_SIZE;
+}
+
+/*
+ * bound_memory() - Reduce the stream parameters to the memory limit
+ *
+ * @window_bits:	Window size to reduce, in zlib format (negative for
+ *			raw deflate, plus 16 for gzip).
+ * @mem_level:		Memory level to reduce.
+ *
+ * The largest of the window and the hash table is halved until the stream
+ * fits. A smaller window can always be inflated by the server.
+ *
+ * Return: The memory the stream uses with the final parameters.
+ */
+static size_t bound_memory(int *window_bits, int *mem_level)
+{
+	int bits = *window_bits, level = *mem_level, sign = 1, offset = 0;
+
+	if (bits < 0) {
+		sign = -1;
+		bits = -bits;
+	} else if (bits > MAX_WBITS) {
+		offset = 16;
+		bits -= offset;
+	}
+
+	while (mem_limit > 0 && get_deflate_memory(bits, level) > mem_limit) {
+		if (level > 1 && (level + 9 >= bits + 2 || bits <= MIN_WINDOW_BITS))
+			level--;
+		else if (bits > MIN_WINDOW_BITS)
+			bits--;
+		else
+			break;
+	}
+
+	*window_bits = sign * bits + offset;
+	*mem_level = level;
+
+	return get_deflate_memory(bits, level);
+}
+
+static stream_slot_t *find_slot(z_streamp strm)
+{
+	stream_slot_t *slot = NULL;
+	int i;
+
+	pthread_mutex_lock(&slots_lock);
+	for (i = 0; i < MAX_STREAMS; i++) {
+		if (slots[i].strm == strm) {
+			slot = &slots[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&slots_lock);
+
+	return slot;
+}
+
+static stream_slot_t *add_slot(z_streamp strm)
+{
+	stream_slot_t *slot = NULL;
+	int i;
+
+	pthread_mutex_lock(&slots_lock);
+	for (i = 0; i < MAX_STREAMS; i++) {
+		if (slots[i].strm == NULL) {
+			slot = &slots[i];
+			memset(slot, 0, sizeof(*slot));
+			slot->strm = strm;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&slots_lock);
+
+	return slot;
+}
+
+static void remove_slot(stream_slot_t *slot)
+{
+	pthread_mutex_lock(&slots_lock);
+	slot->strm = NULL;
+	pthread_mutex_unlock(&slots_lock);
+}
+
+/*
+ * account_message() - Add the compressed message to its class statistics
+ *
+ * @slot:	Slot of the stream that compressed the message.
+ */
+static void account_message(stream_slot_t *slot)
+{
+	z_streamp strm = slot->strm;
+	compression_class_t cls = slot->cls;
+	int64_t saved;
+
+	if (strm->total_in == 0)
+		return;
+
+	if (!slot->sampled)
+		cls = strm->total_in < SAMPLE_MIN ? COMPRESSION_CLASS_SMALL : COMPRESSION_CLASS_COMPRESSIBLE;
+
+	saved = (int64_t) strm->total_in - (int64_t) strm->total_out;
+	__atomic_add_fetch(&saved_bytes[cls], saved, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&cpu_time_ns[cls], slot->cpu_ns, __ATOMIC_RELAXED);
+
+	log_cmp_debug("%s message %lu -> %lu bytes in %llu us", class_names[cls],
+		strm->total_in, strm->total_out, (unsigned long long) slot->cpu_ns / 1000);
+
+	slot->sampled = false;
+	slot->cpu_ns = 0;
+}
+
+void compression_init(const cc_cfg_t *const cc_cfg)
+{
+	fixed_level = cc_cfg->compression_level;
+	mem_limit = cc_cfg->compression_memory_kb * (size_t) 1024;
+}
+
+/*
+ * get_link_type() - Get the type of link of a network interface
+ *
+ * @iface:	Interface name.
+ *
+ * Return: LINK_CELLULAR for PPP and cellular modem interfaces, LINK_LAN
+ *	   otherwise.
+ */
+static link_type_t get_link_type(const char *iface)
+{
+	static const char *const cellular_prefixes[] = { "ppp", "wwan", "rmnet" };
+	char path[64], uevent[256];
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cellular_prefixes); i++) {
+		if (strncmp(iface, cellular_prefixes[i], strlen(cellular_prefixes[i])) == 0)
+			return LINK_CELLULAR;
+	}
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/uevent", iface);
+	if (read_file(path, uevent, sizeof(uevent)) > 0 && strstr(uevent, "DEVTYPE=wwan") != NULL)
+		return LINK_CELLULAR;
+
+	return LINK_LAN;
+}
+
+void compression_set_link(int sock)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	struct ifaddrs *ifaddr, *ifa;
+	link_type_t type = LINK_UNKNOWN;
+	char iface[IF_NAMESIZE] = "unknown";
+
+	if (getsockname(sock, (struct sockaddr *) &addr, &addr_len) == 0
+		&& addr.sin_family == AF_INET && getifaddrs(&ifaddr) == 0) {
+		for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+			struct sockaddr_in *ifa_addr = (struct sockaddr_in *) (void *) ifa->ifa_addr;
+
+			if (ifa_addr == NULL || ifa_addr->sin_family != AF_INET
+				|| ifa_addr->sin_addr.s_addr != addr.sin_addr.s_addr)
+				continue;
+
+			type = get_link_type(ifa->ifa_name);
+			snprintf(iface, sizeof(iface), "%s", ifa->ifa_name);
+			break;
+		}
+		freeifaddrs(ifaddr);
+	}
+
+	__atomic_store_n(&link_type, type, __ATOMIC_RELAXED);
+
+	log_cmp_info("Connected through '%s' (%s link), compression level %d",
+		iface, link_names[type], get_level(DEFAULT_LEVEL));
+}
+
+int64_t compression_get_saved(compression_class_t cls)
+{
+	return __atomic_load_n(&saved_bytes[cls], __ATOMIC_RELAXED);
+}
+
+uint64_t compression_get_cpu(compression_class_t cls)
+{
+	return __atomic_load_n(&cpu_time_ns[cls], __ATOMIC_RELAXED) / 1000000;
+}
+
+int cc_deflateInit_(z_streamp strm, int level, const char *version, int stream_size)
+{
+	return cc_deflateInit2_(strm, level, Z_DEFLATED, MAX_WBITS, DEFAULT_MEM_LEVEL,
+		Z_DEFAULT_STRATEGY, version, stream_size);
+}
+
+int cc_deflateInit2_(z_streamp strm, int level, int method, int windowBits,
+	int memLevel, int strategy, const char *version, int stream_size)
+{
+	/* Allocations through the Cloud Connector are already accounted */
+	bool own_alloc = strm->zalloc == Z_NULL;
+	stream_slot_t *slot;
+	size_t size;
+	int ret;
+
+	size = bound_memory(&windowBits, &memLevel);
+
+	ret = deflateInit2_(strm, get_level(level), method, windowBits, memLevel,
+		strategy, version, stream_size);
+	if (ret != Z_OK)
+		return ret;
+
+	slot = add_slot(strm);
+	if (slot == NULL) {
+		log_cmp_debug("%s", "Too many streams, compressing without policy");
+		return ret;
+	}
+
+	slot->level = level;
+	slot->strategy = strategy;
+	if (own_alloc) {
+		slot->charged = size;
+		mem_budget_charge(MEM_SS_CONNECTOR, size);
+	}
+
+	return ret;
+}
+
+int cc_deflate(z_streamp strm, int flush)
+{
+	stream_slot_t *slot = find_slot(strm);
+	uint64_t start;
+	int ret;
+
+	if (slot == NULL)
+		return deflate(strm, flush);
+
+	/* Sample the message when it starts, before any data is compressed */
+	if (!slot->sampled && strm->total_in == 0 && strm->avail_in >= SAMPLE_MIN) {
+		slot->sampled = true;
+		slot->cls = COMPRESSION_CLASS_COMPRESSIBLE;
+		if (is_incompressible(strm->next_in, strm->avail_in)) {
+			slot->cls = COMPRESSION_CLASS_INCOMPRESSIBLE;
+			if (deflateParams(strm, Z_NO_COMPRESSION, slot->strategy) != Z_OK)
+				log_cmp_debug("%s", "Cannot disable compression of incompressible message");
+		}
+	}
+
+	start = get_time_ns(CLOCK_THREAD_CPUTIME_ID);
+	ret = deflate(strm, flush);
+	slot->cpu_ns += get_time_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+
+	return ret;
+}
+
+int cc_deflateReset(z_streamp strm)
+{
+	stream_slot_t *slot = find_slot(strm);
+	int ret;
+
+	if (slot != NULL)
+		account_message(slot);
+
+	ret = deflateReset(strm);
+	if (ret != Z_OK || slot == NULL)
+		return ret;
+
+	/* Restore the level, the link or the load may also have changed */
+	if (deflateParams(strm, get_level(slot->level), slot->strategy) != Z_OK)
+		log_cmp_debug("%s", "Cannot update the compression level");
+
+	return ret;
+}
+
+int cc_deflateEnd(z_streamp strm)
+{
+	stream_slot_t *slot = find_slot(strm);
+
+	if (slot != NULL) {
+		account_message(slot);
+		if (slot->charged > 0)
+			mem_budget_release(MEM_SS_CONNECTOR, slot->charged);
+		remove_slot(slot);
+	}
+
+	return deflateEnd(strm);
+}
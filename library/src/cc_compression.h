@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_COMPRESSION_H_
+#define CC_COMPRESSION_H_
+
+#include <stdint.h>
+#include <zlib.h>
+
+#include "cc_config.h"
+
+/*
+ * compression_class_t - Classes of compressed messages
+ *
+ * @COMPRESSION_CLASS_SMALL:		Messages too small to sample their entropy.
+ * @COMPRESSION_CLASS_COMPRESSIBLE:	Messages compressed with the link level.
+ * @COMPRESSION_CLASS_INCOMPRESSIBLE:	Messages with high entropy, such as
+ *					already compressed or encrypted data,
+ *					stored without compression.
+ */
+typedef enum {
+	COMPRESSION_CLASS_SMALL,
+	COMPRESSION_CLASS_COMPRESSIBLE,
+	COMPRESSION_CLASS_INCOMPRESSIBLE,
+	COMPRESSION_CLASS_COUNT,
+} compression_class_t;
+
+/*
+ * compression_init() - Configure the message compression policy
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) with the compression
+ *		level and the memory limit of each compression stream.
+ */
+void compression_init(const cc_cfg_t *const cc_cfg);
+
+/*
+ * compression_set_link() - Select the compression level for a connection
+ *
+ * @sock:	Connected socket to Remote Manager.
+ *
+ * The link type is detected from the interface the socket is bound to.
+ * Cellular links use the best compression, other links the fastest one.
+ */
+void compression_set_link(int sock);
+
+/*
+ * compression_get_saved() - Get the bytes saved compressing a class of messages
+ *
+ * @cls:	Class of messages.
+ *
+ * Return: Uncompressed minus compressed bytes since the daemon started.
+ */
+int64_t compression_get_saved(compression_class_t cls);
+
+/*
+ * compression_get_cpu() - Get the CPU time spent compressing a class of messages
+ *
+ * @cls:	Class of messages.
+ *
+ * Return: CPU time in ms since the daemon started.
+ */
+uint64_t compression_get_cpu(compression_class_t cls);
+
+/*
+ * The Cloud Connector deflate calls are redirected to these functions at
+ * build time (see the Makefile). They apply the compression policy and
+ * account each message before calling zlib.
+ */
+int cc_deflateInit_(z_streamp strm, int level, const char *version, int stream_size);
+int cc_deflateInit2_(z_streamp strm, int level, int method, int windowBits,
+	int memLevel, int strategy, const char *version, int stream_size);
+int cc_deflate(z_streamp strm, int flush);
+int cc_deflateReset(z_streamp strm);
+int cc_deflateEnd(z_streamp strm);
+
+#endif /* CC_COMPRESSION_H_ */
@@ -30,6 +30,7 @@
 
 #include "ccapi/ccapi.h"
 #include "cc_config.h"
+#include "cc_log_forward.h"
 #include "cc_logging.h"
 #include "utils.h"
 
@@ -40,6 +41,14 @@
 
 #define ENABLE_SYSTEM_MONITOR			"enable_system_monitor"
 
+#define ENABLE_LOG_FORWARD			"enable_log_forward"
+
+#define ENABLE_CRASH_CAPTURE			"enable_crash_capture"
+
+#define ENABLE_GATEWAY				"enable_gateway"
+
+#define ENABLE_JOB_SCHEDULER			"enable_job_scheduler"
+
 #define SETTING_VENDOR_ID			"vendor_id"
 #define SETTING_VENDOR_ID_MAX			0xFFFFFFFFUL
 #define SETTING_VENDOR_ID_DEFAULT		"0xFE080003"
@@ -58,6 +67,7 @@
 
 #define SETTING_RM_URL				"url"
 #define SETTING_CLIENT_CERT_PATH		"client_cert_path"
+#define SETTING_CLIENT_CERT_KEY_FILE		"client_cert_key_file"
 #define SETTING_ENABLE_RECONNECT		"enable_reconnect"
 #define SETTING_RECONNECT_TIME			"reconnect_time"
 #define SETTING_RECONNECT_TIME_MIN		30
@@ -65,6 +75,15 @@
 #define SETTING_KEEPALIVE_TX			"keep_alive_time"
 #define SETTING_KEEPALIVE_RX			"server_keep_alive_time"
 #define SETTING_WAIT_TIMES			"wait_times"
+#define SETTING_SOCKET_BUFFER_SIZE		"socket_buffer_size"
+#define SETTING_SOCKET_BUFFER_SIZE_MAX		16384
+#define SETTING_SOCKET_BUFFER_MAX		"socket_buffer_max"
+#define SETTING_SOCKET_BUFFER_MAX_MIN		16
+#define SETTING_COMPRESSION_LEVEL		"compression_level"
+#define SETTING_COMPRESSION_LEVEL_MIN		-1
+#define SETTING_COMPRESSION_LEVEL_MAX		9
+#define SETTING_COMPRESSION_MEMORY		"compression_memory_size"
+#define SETTING_COMPRESSION_MEMORY_MAX		1024
 
 #define SETTING_NAME				"name"
 #define SETTING_PATH				"path"
@@ -76,6 +95,12 @@
 #define SETTING_DATA_BACKLOG_SIZE_MIN		0
 #define SETTING_DATA_BACKLOG_SIZE_MAX		5000
 
+#define SETTING_MEM_BUDGET_SIZE			"memory_budget_size"
+#define SETTING_MEM_UPLOAD_SIZE			"memory_upload_size"
+#define SETTING_MEM_DATA_REQUEST_SIZE		"memory_data_request_size"
+#define SETTING_MEM_SIZE_MIN			0
+#define SETTING_MEM_SIZE_MAX			1024 * 1024 /* 1 GB */
+
 #define SETTING_SYS_MON_METRICS			"system_monitor_metrics"
 #define SETTING_SYS_MON_SAMPLE_RATE		"system_monitor_sample_rate"
 #define SETTING_SYS_MON_SAMPLE_RATE_MIN		1
@@ -84,6 +109,50 @@
 #define SETTING_SYS_MON_UPLOAD_SIZE_MIN		1
 #define SETTING_SYS_MON_UPLOAD_SIZE_MAX		DP_MAX_NUMBER_PER_REQUEST
 
+#define SETTING_LOG_FWD_SOURCES			"log_forward_sources"
+#define SETTING_LOG_FWD_LEVEL			"log_forward_level"
+#define SETTING_LOG_FWD_FILTER			"log_forward_filter"
+#define SETTING_LOG_FWD_EXCLUDE			"log_forward_exclude"
+#define SETTING_LOG_FWD_RATE			"log_forward_rate"
+#define SETTING_LOG_FWD_RATE_MIN		0
+#define SETTING_LOG_FWD_RATE_MAX		1000
+#define SETTING_LOG_FWD_INTERVAL		"log_forward_upload_interval"
+#define SETTING_LOG_FWD_INTERVAL_MIN		1
+#define SETTING_LOG_FWD_INTERVAL_MAX		24 * 60 * 60 /* A day */
+#define SETTING_LOG_FWD_UPLOAD_SIZE		"log_forward_upload_size"
+#define SETTING_LOG_FWD_UPLOAD_SIZE_MIN		1
+#define SETTING_LOG_FWD_UPLOAD_SIZE_MAX		DP_MAX_NUMBER_PER_REQUEST
+
+#define SETTING_CRASH_PATH			"crash_capture_path"
+#define SETTING_CRASH_HANDLER			"crash_capture_handler"
+#define SETTING_CRASH_MAX_CORE_SIZE		"crash_max_core_size"
+#define SETTING_CRASH_MAX_CORE_SIZE_MIN		0
+#define SETTING_CRASH_MAX_CORE_SIZE_MAX		1024 * 1024 /* 1 GB */
+#define SETTING_CRASH_MAX_STORED		"crash_max_stored"
+#define SETTING_CRASH_MAX_STORED_MIN		1
+#define SETTING_CRASH_MAX_STORED_MAX		100
+#define SETTING_CRASH_MAX_STORED_SIZE		"crash_max_stored_size"
+#define SETTING_CRASH_MAX_STORED_SIZE_MIN	0
+#define SETTING_CRASH_MAX_STORED_SIZE_MAX	4 * 1024 * 1024 /* 4 GB */
+
+#define SETTING_GW_MAX_CHILDREN			"gateway_max_children"
+#define SETTING_GW_MAX_CHILDREN_MIN		1
+#define SETTING_GW_MAX_CHILDREN_MAX		256
+#define SETTING_GW_CHILD_TIMEOUT		"gateway_child_timeout"
+#define SETTING_GW_CHILD_TIMEOUT_MIN		0
+#define SETTING_GW_CHILD_TIMEOUT_MAX		24 * 60 * 60 /* A day */
+#define SETTING_GW_CHILD_RATE			"gateway_child_rate"
+#define SETTING_GW_CHILD_RATE_MIN		0
+#define SETTING_GW_CHILD_RATE_MAX		1024 * 1024 /* 1 GB */
+#define SETTING_GW_CHILD_BACKLOG_SIZE		"gateway_child_backlog_size"
+#define SETTING_GW_CHILD_BACKLOG_SIZE_MIN	0
+#define SETTING_GW_CHILD_BACKLOG_SIZE_MAX	1024 * 1024 /* 1 GB */
+
+#define SETTING_JOB_COMMANDS			"job_commands"
+#define SETTING_JOB_MAX_TIMEOUT			"job_max_timeout"
+#define SETTING_JOB_MAX_TIMEOUT_MIN		1
+#define SETTING_JOB_MAX_TIMEOUT_MAX		24 * 60 * 60 /* A day */
+
 #define SETTING_USE_STATIC_LOCATION		"static_location"
 #define SETTING_LATITUDE			"latitude"
 #define SETTING_LATITUDE_MIN			(-90.0)
@@ -93,9 +162,21 @@
 #define SETTING_LONGITUDE_MAX			(180.0)
 #define SETTING_ALTITUDE			"altitude"
 #define SETTING_ON_THE_FLY			"on_the_fly"
+#define SETTING_FW_INSTALL_WINDOW		"firmware_install_window"
+#define SETTING_FW_POSTPONE_MAX			"firmware_postpone_max"
+#define SETTING_FW_POSTPONE_MAX_MIN		0
+#define SETTING_FW_POSTPONE_MAX_MAX		24 * 60 /* A day */
+
+#define SETTING_HEALTH_CHECK_TIMEOUT		"health_check_timeout"
+#define SETTING_HEALTH_CHECK_TIMEOUT_MIN	0
+#define SETTING_HEALTH_CHECK_TIMEOUT_MAX	24 * 60 /* A day */
+#define SETTING_HEALTH_CHECK_SERVICES		"health_check_services"
+#define SETTING_HEALTH_CHECK_APPS		"health_check_apps"
+#define SETTING_BOOTENV_FILE			"bootloader_env_file"
 
 #define SETTING_LOG_LEVEL			"log_level"
 #define SETTING_LOG_CONSOLE			"log_console"
+#define SETTING_CONNECTOR_DEBUG			"connector_debug"
 
 #define SETTING_UNKNOWN				"__unknown"
 
@@ -103,11 +184,17 @@
 #define FW_VERSION_FILE_DEFAULT			"/etc/sw-versions"
 
 #define LOG_LEVEL_ERROR_STR			"error"
+#define LOG_LEVEL_WARNING_STR			"warning"
+#define LOG_LEVEL_NOTICE_STR			"notice"
 #define LOG_LEVEL_INFO_STR			"info"
 #define LOG_LEVEL_DEBUG_STR			"debug"
 
 #define ALL_METRICS				"*"
 
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(array)			(sizeof(array) / sizeof(array[0]))
+#endif
+
 typedef enum {
 	CCCS_SINGLE_SYSTEM,
 	CCCS_DUAL_SYSTEM,
@@ -116,6 +203,17 @@ typedef enum {
 
 static cccs_boot_system_t boot_type = CCCS_UNKNOWN_SYSTEM;
 
+static const struct {
+	const char *name;
+	int level;
+} log_fwd_levels[] = {
+	{ LOG_LEVEL_ERROR_STR,		LOG_ERR },
+	{ LOG_LEVEL_WARNING_STR,	LOG_WARNING },
+	{ LOG_LEVEL_NOTICE_STR,		LOG_NOTICE },
+	{ LOG_LEVEL_INFO_STR,		LOG_INFO },
+	{ LOG_LEVEL_DEBUG_STR,		LOG_DEBUG },
+};
+
 static char *get_fw_version(const char *const value) {
 	char data[256] = {0};
 	const char *path = NULL;
@@ -420,6 +518,31 @@ static int cfg_check_cert_path(cfg_t *cfg, cfg_opt_t *opt)
 	return ret;
 }
 
+/*
+ * cfg_check_cert_key_file() - Validate the key file to encrypt the certificate
+ *
+ * @cfg:	The section where the key file is defined.
+ * @opt:	The key file option.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_cert_key_file(cfg_t *cfg, cfg_opt_t *opt)
+{
+	char *val = cfg_opt_getnstr(opt, 0);
+
+	/* Empty to store the certificate without encryption */
+	if (val == NULL || strlen(val) == 0)
+		return 0;
+
+	if (access(val, R_OK) < 0) {
+		cfg_error(cfg, "Invalid %s (%s): file does not exist or is not readable",
+				opt->name, val);
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * cfg_check_reconnect_time() - Check reconnect time is between 1 and 32767
  *
@@ -472,6 +595,66 @@ static int cfg_check_wait_times(cfg_t *cfg, cfg_opt_t *opt)
 	return cfg_check_range(cfg, opt, CCAPI_KEEPALIVES_WCNT_MIN, CCAPI_KEEPALIVES_WCNT_MAX);
 }
 
+/*
+ * cfg_check_socket_buffer_size() - Check socket buffer size is between 0 and 16384
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_socket_buffer_size(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, 0, SETTING_SOCKET_BUFFER_SIZE_MAX);
+}
+
+/*
+ * cfg_check_socket_buffer_max() - Check socket buffer limit is between 16 and 16384
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_socket_buffer_max(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_SOCKET_BUFFER_MAX_MIN, SETTING_SOCKET_BUFFER_SIZE_MAX);
+}
+
+/*
+ * cfg_check_compression_level() - Check compression level is between -1 and 9
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_compression_level(cfg_t *cfg, cfg_opt_t *opt)
+{
+	long val = cfg_opt_getnint(opt, 0);
+
+	if (val < SETTING_COMPRESSION_LEVEL_MIN || val > SETTING_COMPRESSION_LEVEL_MAX) {
+		cfg_error(cfg, "Invalid %s (%ld): value must be between %d and %d", opt->name, val,
+			SETTING_COMPRESSION_LEVEL_MIN, SETTING_COMPRESSION_LEVEL_MAX);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * cfg_check_compression_memory() - Check compression memory is between 0 and 1024
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_compression_memory(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, 0, SETTING_COMPRESSION_MEMORY_MAX);
+}
+
 /*
  * cfg_check_data_backlog_size() - Check data backlog size is in range
  *
@@ -485,6 +668,19 @@ static int cfg_check_data_backlog_size(cfg_t *cfg, cfg_opt_t *opt)
 	return cfg_check_range(cfg, opt, SETTING_DATA_BACKLOG_SIZE_MIN, SETTING_DATA_BACKLOG_SIZE_MAX);
 }
 
+/*
+ * cfg_check_mem_size() - Check a memory budget size is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_mem_size(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_MEM_SIZE_MIN, SETTING_MEM_SIZE_MAX);
+}
+
 /*
  * cfg_check_sys_mon_sample_rate() - Check system monitor sample rate value is between 1s and a year
  *
@@ -529,6 +725,349 @@ static int cfg_check_sys_mon_metrics(cfg_t *cfg, cfg_opt_t *opt)
 	return 0;
 }
 
+/*
+ * cfg_check_log_fwd_sources() - Check log forwarder sources list
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_log_fwd_sources(cfg_t *cfg, cfg_opt_t *opt)
+{
+	unsigned int i;
+
+	for (i = 0; i < cfg_opt_size(opt); i++) {
+		char *val = cfg_opt_getnstr(opt, i);
+
+		if (val == NULL
+			|| (strcmp(val, LOG_FWD_SOURCE_CCCSD) != 0
+				&& strcmp(val, LOG_FWD_SOURCE_SYSLOG) != 0
+				&& strcmp(val, LOG_FWD_SOURCE_JOURNAL) != 0)) {
+			cfg_error(cfg, "Invalid %s (%s): must be '%s', '%s', or '%s'",
+				opt->name, val ? val : "", LOG_FWD_SOURCE_CCCSD,
+				LOG_FWD_SOURCE_SYSLOG, LOG_FWD_SOURCE_JOURNAL);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * cfg_check_log_fwd_level() - Check log forwarder level is a valid severity
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_log_fwd_level(cfg_t *cfg, cfg_opt_t *opt)
+{
+	char *val = cfg_opt_getnstr(opt, 0);
+	unsigned int i;
+
+	for (i = 0; val != NULL && i < ARRAY_SIZE(log_fwd_levels); i++) {
+		if (strcmp(val, log_fwd_levels[i].name) == 0)
+			return 0;
+	}
+
+	cfg_error(cfg, "Invalid %s (%s): must be '%s', '%s', '%s', '%s', or '%s'",
+		opt->name, val ? val : "", LOG_LEVEL_ERROR_STR, LOG_LEVEL_WARNING_STR,
+		LOG_LEVEL_NOTICE_STR, LOG_LEVEL_INFO_STR, LOG_LEVEL_DEBUG_STR);
+
+	return -1;
+}
+
+/*
+ * cfg_check_regex() - Check a setting is empty or a valid regular expression
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_regex(cfg_t *cfg, cfg_opt_t *opt)
+{
+	regex_t regex;
+	char msgbuf[100];
+	int error;
+	char *val = cfg_opt_getnstr(opt, 0);
+
+	if (val == NULL || strlen(val) == 0)
+		return 0;
+
+	error = regcomp(&regex, val, REG_EXTENDED | REG_NOSUB);
+	if (error != 0) {
+		regerror(error, &regex, msgbuf, sizeof(msgbuf));
+		cfg_error(cfg, "Invalid %s (%s): %s", opt->name, val, msgbuf);
+		return -1;
+	}
+
+	regfree(&regex);
+
+	return 0;
+}
+
+/*
+ * cfg_check_log_fwd_rate() - Check log forwarder rate is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_log_fwd_rate(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_LOG_FWD_RATE_MIN, SETTING_LOG_FWD_RATE_MAX);
+}
+
+/*
+ * cfg_check_log_fwd_interval() - Check log forwarder upload interval is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_log_fwd_interval(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_LOG_FWD_INTERVAL_MIN, SETTING_LOG_FWD_INTERVAL_MAX);
+}
+
+/*
+ * cfg_check_log_fwd_upload_size() - Check log forwarder upload size is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_log_fwd_upload_size(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_LOG_FWD_UPLOAD_SIZE_MIN, SETTING_LOG_FWD_UPLOAD_SIZE_MAX);
+}
+
+/*
+ * cfg_check_crash_path() - Check crash capture path is an absolute path
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * The directory is created when the first crash is captured.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_crash_path(cfg_t *cfg, cfg_opt_t *opt)
+{
+	char *val = cfg_opt_getnstr(opt, 0);
+
+	if (val == NULL || val[0] != '/') {
+		cfg_error(cfg, "Invalid %s (%s): must be an absolute path",
+			opt->name, val ? val : "");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * cfg_check_crash_max_core_size() - Check crash maximum core size is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_crash_max_core_size(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_CRASH_MAX_CORE_SIZE_MIN, SETTING_CRASH_MAX_CORE_SIZE_MAX);
+}
+
+/*
+ * cfg_check_crash_max_stored() - Check crash maximum stored number is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_crash_max_stored(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_CRASH_MAX_STORED_MIN, SETTING_CRASH_MAX_STORED_MAX);
+}
+
+/*
+ * cfg_check_crash_max_stored_size() - Check crash maximum stored size is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_crash_max_stored_size(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_CRASH_MAX_STORED_SIZE_MIN, SETTING_CRASH_MAX_STORED_SIZE_MAX);
+}
+
+/*
+ * cfg_check_gw_max_children() - Check gateway maximum children is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_gw_max_children(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_GW_MAX_CHILDREN_MIN, SETTING_GW_MAX_CHILDREN_MAX);
+}
+
+/*
+ * cfg_check_gw_child_timeout() - Check gateway child timeout is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_gw_child_timeout(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_GW_CHILD_TIMEOUT_MIN, SETTING_GW_CHILD_TIMEOUT_MAX);
+}
+
+/*
+ * cfg_check_gw_child_rate() - Check gateway child upload rate is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_gw_child_rate(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_GW_CHILD_RATE_MIN, SETTING_GW_CHILD_RATE_MAX);
+}
+
+/*
+ * cfg_check_gw_child_backlog_size() - Check gateway child backlog size is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_gw_child_backlog_size(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_GW_CHILD_BACKLOG_SIZE_MIN, SETTING_GW_CHILD_BACKLOG_SIZE_MAX);
+}
+
+/*
+ * cfg_check_job_commands() - Check scheduled job commands list
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * Each entry must be 'name=command line', with a name of letters, digits,
+ * '-', '_' or '.'.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_job_commands(cfg_t *cfg, cfg_opt_t *opt)
+{
+	unsigned int i;
+
+	for (i = 0; i < cfg_opt_size(opt); i++) {
+		char *val = cfg_opt_getnstr(opt, i);
+		size_t len = val != NULL ? strspn(val, "abcdefghijklmnopqrstuvwxyz"
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.") : 0;
+
+		if (len == 0 || val[len] != '=' || val[len + 1] == '\0') {
+			cfg_error(cfg, "Invalid %s (%s): must be 'name=command line'",
+				opt->name, val ? val : "");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * cfg_check_job_max_timeout() - Check scheduled job maximum timeout is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_job_max_timeout(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_JOB_MAX_TIMEOUT_MIN, SETTING_JOB_MAX_TIMEOUT_MAX);
+}
+
+/*
+ * cfg_check_fw_install_window() - Check firmware install window format
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * The window must be empty or have the format 'HH:MM-HH:MM'.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_fw_install_window(cfg_t *cfg, cfg_opt_t *opt)
+{
+	regex_t regex;
+	char msgbuf[100];
+	int error = 0;
+	char *val = cfg_opt_getnstr(opt, 0);
+
+	if (val == NULL || strlen(val) == 0)
+		return 0;
+
+	error = regcomp(&regex, "^([01][0-9]|2[0-3]):[0-5][0-9]-([01][0-9]|2[0-3]):[0-5][0-9]$", REG_EXTENDED);
+	if (error != 0) {
+		regerror(error, &regex, msgbuf, sizeof(msgbuf));
+		cfg_error(cfg, "Could not compile regex: %s (%d)", msgbuf, error);
+		return -1;
+	}
+	error = regexec(&regex, val, 0, NULL, 0);
+	if (error != 0) {
+		cfg_error(cfg, "Invalid %s (%s): format must be 'HH:MM-HH:MM'", opt->name, val);
+		error = -1;
+	}
+
+	regfree(&regex);
+
+	return error;
+}
+
+/*
+ * cfg_check_fw_postpone_max() - Check firmware postpone maximum is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_fw_postpone_max(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_FW_POSTPONE_MAX_MIN, SETTING_FW_POSTPONE_MAX_MAX);
+}
+
+/*
+ * cfg_check_health_check_timeout() - Check health check timeout is in range
+ *
+ * @cfg:	The section where the option is defined.
+ * @opt:	The option to check.
+ *
+ * @Return: 0 on success, any other value otherwise.
+ */
+static int cfg_check_health_check_timeout(cfg_t *cfg, cfg_opt_t *opt)
+{
+	return cfg_check_range(cfg, opt, SETTING_HEALTH_CHECK_TIMEOUT_MIN, SETTING_HEALTH_CHECK_TIMEOUT_MAX);
+}
+
 /*
  * cfg_check_latitude() - Check latitude value is between -90.0 and 90.0
  *
@@ -737,6 +1276,8 @@ static int check_cfg(cfg_t *cfg)
 		return -1;
 	if (cfg_check_cert_path(cfg, cfg_getopt(cfg, SETTING_CLIENT_CERT_PATH)) != 0)
 		return -1;
+	if (cfg_check_cert_key_file(cfg, cfg_getopt(cfg, SETTING_CLIENT_CERT_KEY_FILE)) != 0)
+		return -1;
 	if (cfg_check_reconnect_time(cfg, cfg_getopt(cfg, SETTING_RECONNECT_TIME)) != 0)
 		return -1;
 	if (cfg_check_keepalive_rx(cfg, cfg_getopt(cfg, SETTING_KEEPALIVE_RX)) != 0)
@@ -745,10 +1286,24 @@ static int check_cfg(cfg_t *cfg)
 		return -1;
 	if (cfg_check_wait_times(cfg, cfg_getopt(cfg, SETTING_WAIT_TIMES)) != 0)
 		return -1;
+	if (cfg_check_socket_buffer_size(cfg, cfg_getopt(cfg, SETTING_SOCKET_BUFFER_SIZE)) != 0)
+		return -1;
+	if (cfg_check_socket_buffer_max(cfg, cfg_getopt(cfg, SETTING_SOCKET_BUFFER_MAX)) != 0)
+		return -1;
+	if (cfg_check_compression_level(cfg, cfg_getopt(cfg, SETTING_COMPRESSION_LEVEL)) != 0)
+		return -1;
+	if (cfg_check_compression_memory(cfg, cfg_getopt(cfg, SETTING_COMPRESSION_MEMORY)) != 0)
+		return -1;
 
 	/* Check services settings. */
 	if (cfg_check_fw_download_path(cfg, cfg_getopt(cfg, SETTING_FW_DOWNLOAD_PATH)) != 0)
 		return -1;
+	if (cfg_check_fw_install_window(cfg, cfg_getopt(cfg, SETTING_FW_INSTALL_WINDOW)) != 0)
+		return -1;
+	if (cfg_check_fw_postpone_max(cfg, cfg_getopt(cfg, SETTING_FW_POSTPONE_MAX)) != 0)
+		return -1;
+	if (cfg_check_health_check_timeout(cfg, cfg_getopt(cfg, SETTING_HEALTH_CHECK_TIMEOUT)) != 0)
+		return -1;
 
 	/* Check data service settings. */
 	if (cfg_check_directory_exists_or_empty(cfg, cfg_getopt(cfg, SETTING_DATA_BACKLOG_PATH)) != 0)
@@ -756,6 +1311,14 @@ static int check_cfg(cfg_t *cfg)
 	if (cfg_check_data_backlog_size(cfg, cfg_getopt(cfg, SETTING_DATA_BACKLOG_SIZE)) != 0)
 		return -1;
 
+	/* Check memory budget settings. */
+	if (cfg_check_mem_size(cfg, cfg_getopt(cfg, SETTING_MEM_BUDGET_SIZE)) != 0)
+		return -1;
+	if (cfg_check_mem_size(cfg, cfg_getopt(cfg, SETTING_MEM_UPLOAD_SIZE)) != 0)
+		return -1;
+	if (cfg_check_mem_size(cfg, cfg_getopt(cfg, SETTING_MEM_DATA_REQUEST_SIZE)) != 0)
+		return -1;
+
 	/* Check system monitor settings. */
 	if (cfg_check_sys_mon_sample_rate(cfg, cfg_getopt(cfg, SETTING_SYS_MON_SAMPLE_RATE)) != 0)
 		return -1;
@@ -764,6 +1327,48 @@ static int check_cfg(cfg_t *cfg)
 	if (cfg_check_sys_mon_metrics(cfg, cfg_getopt(cfg, SETTING_SYS_MON_METRICS)) != 0)
 		return -1;
 
+	/* Check log forwarder settings. */
+	if (cfg_check_log_fwd_sources(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_SOURCES)) != 0)
+		return -1;
+	if (cfg_check_log_fwd_level(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_LEVEL)) != 0)
+		return -1;
+	if (cfg_check_regex(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_FILTER)) != 0)
+		return -1;
+	if (cfg_check_regex(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_EXCLUDE)) != 0)
+		return -1;
+	if (cfg_check_log_fwd_rate(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_RATE)) != 0)
+		return -1;
+	if (cfg_check_log_fwd_interval(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_INTERVAL)) != 0)
+		return -1;
+	if (cfg_check_log_fwd_upload_size(cfg, cfg_getopt(cfg, SETTING_LOG_FWD_UPLOAD_SIZE)) != 0)
+		return -1;
+
+	/* Check crash capture settings. */
+	if (cfg_check_crash_path(cfg, cfg_getopt(cfg, SETTING_CRASH_PATH)) != 0)
+		return -1;
+	if (cfg_check_crash_max_core_size(cfg, cfg_getopt(cfg, SETTING_CRASH_MAX_CORE_SIZE)) != 0)
+		return -1;
+	if (cfg_check_crash_max_stored(cfg, cfg_getopt(cfg, SETTING_CRASH_MAX_STORED)) != 0)
+		return -1;
+	if (cfg_check_crash_max_stored_size(cfg, cfg_getopt(cfg, SETTING_CRASH_MAX_STORED_SIZE)) != 0)
+		return -1;
+
+	/* Check gateway settings. */
+	if (cfg_check_gw_max_children(cfg, cfg_getopt(cfg, SETTING_GW_MAX_CHILDREN)) != 0)
+		return -1;
+	if (cfg_check_gw_child_timeout(cfg, cfg_getopt(cfg, SETTING_GW_CHILD_TIMEOUT)) != 0)
+		return -1;
+	if (cfg_check_gw_child_rate(cfg, cfg_getopt(cfg, SETTING_GW_CHILD_RATE)) != 0)
+		return -1;
+	if (cfg_check_gw_child_backlog_size(cfg, cfg_getopt(cfg, SETTING_GW_CHILD_BACKLOG_SIZE)) != 0)
+		return -1;
+
+	/* Check job scheduler settings. */
+	if (cfg_check_job_commands(cfg, cfg_getopt(cfg, SETTING_JOB_COMMANDS)) != 0)
+		return -1;
+	if (cfg_check_job_max_timeout(cfg, cfg_getopt(cfg, SETTING_JOB_MAX_TIMEOUT)) != 0)
+		return -1;
+
 	/* Check static location settings. */
 	if (cfg_check_latitude(cfg, cfg_getopt(cfg, SETTING_LATITUDE)) != 0)
 		return -1;
@@ -847,6 +1452,42 @@ static void get_sys_mon_metrics(cc_cfg_t *const cc_cfg)
 	}
 }
 
+/*
+ * get_string_list() - Get the values of a string list setting
+ *
+ * @cc_cfg:	Cloud Connector configuration.
+ * @setting:	Name of the string list setting.
+ * @list:	Pointer to store the list of values.
+ * @n_items:	Pointer to store the number of values in the list.
+ */
+static void get_string_list(cc_cfg_t *const cc_cfg, const char *const setting,
+	char ***list, unsigned int *n_items)
+{
+	cfg_t *cfg = cc_cfg->_data;
+	unsigned int i;
+
+	if (!cfg)
+		return;
+
+	free(*list);
+	*list = NULL;
+
+	*n_items = cfg_size(cfg, setting);
+	if (*n_items == 0)
+		return;
+
+	*list = calloc(*n_items, sizeof(**list));
+	if (*list == NULL) {
+		log_info("Cannot initialize '%s' list", setting);
+		*n_items = 0;
+
+		return;
+	}
+
+	for (i = 0; i < *n_items; i++)
+		(*list)[i] = cfg_getnstr(cfg, setting, i);
+}
+
 /*
  * get_log_level() - Get the log level setting value
  *
@@ -873,6 +1514,31 @@ static int get_log_level(cc_cfg_t *const cc_cfg)
 	return LOG_LEVEL_ERROR;
 }
 
+/*
+ * get_log_fwd_level() - Get the log forwarder level setting value
+ *
+ * @cfg:	Configuration to get log forwarder level.
+ *
+ * @Return: The syslog priority of the lowest severity to forward.
+ */
+static int get_log_fwd_level(cc_cfg_t *const cc_cfg)
+{
+	char *level = NULL;
+	unsigned int i;
+
+	if (!cc_cfg->_data)
+		return LOG_WARNING;
+
+	level = cfg_getstr(cc_cfg->_data, SETTING_LOG_FWD_LEVEL);
+
+	for (i = 0; level != NULL && i < ARRAY_SIZE(log_fwd_levels); i++) {
+		if (strcmp(level, log_fwd_levels[i].name) == 0)
+			return log_fwd_levels[i].level;
+	}
+
+	return LOG_WARNING;
+}
+
 /*
  * fill_connector_config() - Fill the connector configuration struct
  *
@@ -915,11 +1581,16 @@ static int fill_connector_config(cc_cfg_t *cc_cfg, bool log_msgs)
 	/* Fill connection settings. */
 	cc_cfg->url = cfg_getstr(cfg, SETTING_RM_URL);
 	cc_cfg->client_cert_path = cfg_getstr(cfg, SETTING_CLIENT_CERT_PATH);
+	cc_cfg->client_cert_key_file = cfg_getstr(cfg, SETTING_CLIENT_CERT_KEY_FILE);
 	cc_cfg->enable_reconnect = cfg_getbool(cfg, SETTING_ENABLE_RECONNECT);
 	cc_cfg->reconnect_time = cfg_getint(cfg, SETTING_RECONNECT_TIME);
 	cc_cfg->keepalive_rx = cfg_getint(cfg, SETTING_KEEPALIVE_RX);
 	cc_cfg->keepalive_tx = cfg_getint(cfg, SETTING_KEEPALIVE_TX);
 	cc_cfg->wait_count = cfg_getint(cfg, SETTING_WAIT_TIMES);
+	cc_cfg->socket_buffer_size = cfg_getint(cfg, SETTING_SOCKET_BUFFER_SIZE);
+	cc_cfg->socket_buffer_max = cfg_getint(cfg, SETTING_SOCKET_BUFFER_MAX);
+	cc_cfg->compression_level = cfg_getint(cfg, SETTING_COMPRESSION_LEVEL);
+	cc_cfg->compression_memory_kb = cfg_getint(cfg, SETTING_COMPRESSION_MEMORY);
 
 	/* Fill services settings. */
 	cc_cfg->services = 0;
@@ -931,6 +1602,18 @@ static int fill_connector_config(cc_cfg_t *cc_cfg, bool log_msgs)
 	if (cfg_getbool(cfg, ENABLE_SYSTEM_MONITOR))
 		cc_cfg->services = cc_cfg->services | SYS_MONITOR_SERVICE;
 
+	if (cfg_getbool(cfg, ENABLE_LOG_FORWARD))
+		cc_cfg->services = cc_cfg->services | LOG_FORWARD_SERVICE;
+
+	if (cfg_getbool(cfg, ENABLE_CRASH_CAPTURE))
+		cc_cfg->services = cc_cfg->services | CRASH_CAPTURE_SERVICE;
+
+	if (cfg_getbool(cfg, ENABLE_GATEWAY))
+		cc_cfg->services = cc_cfg->services | GATEWAY_SERVICE;
+
+	if (cfg_getbool(cfg, ENABLE_JOB_SCHEDULER))
+		cc_cfg->services = cc_cfg->services | JOB_SCHEDULER_SERVICE;
+
 	cc_cfg->fw_download_path = cfg_getstr(cfg, SETTING_FW_DOWNLOAD_PATH);
 
 	/* Fill On the fly setting */
@@ -938,15 +1621,60 @@ static int fill_connector_config(cc_cfg_t *cc_cfg, bool log_msgs)
 
 	cc_cfg->is_dual_boot = get_boot_type() == CCCS_DUAL_SYSTEM;
 
+	/* Fill firmware install schedule settings */
+	cc_cfg->fw_install_window = cfg_getstr(cfg, SETTING_FW_INSTALL_WINDOW);
+	cc_cfg->fw_postpone_max = cfg_getint(cfg, SETTING_FW_POSTPONE_MAX);
+
+	/* Fill health check settings */
+	cc_cfg->health_check_timeout = cfg_getint(cfg, SETTING_HEALTH_CHECK_TIMEOUT);
+	get_string_list(cc_cfg, SETTING_HEALTH_CHECK_SERVICES,
+		&cc_cfg->health_check_services, &cc_cfg->n_health_check_services);
+	get_string_list(cc_cfg, SETTING_HEALTH_CHECK_APPS,
+		&cc_cfg->health_check_apps, &cc_cfg->n_health_check_apps);
+	cc_cfg->bootenv_file = cfg_getstr(cfg, SETTING_BOOTENV_FILE);
+
 	/* Fill data service settings */
 	cc_cfg->data_backlog_path = cfg_getstr(cfg, SETTING_DATA_BACKLOG_PATH);
 	cc_cfg->data_backlog_kb = cfg_getint(cfg, SETTING_DATA_BACKLOG_SIZE);
 
+	/* Fill memory budget settings */
+	cc_cfg->mem_budget_kb = cfg_getint(cfg, SETTING_MEM_BUDGET_SIZE);
+	cc_cfg->mem_upload_kb = cfg_getint(cfg, SETTING_MEM_UPLOAD_SIZE);
+	cc_cfg->mem_data_request_kb = cfg_getint(cfg, SETTING_MEM_DATA_REQUEST_SIZE);
+
 	/* Fill system monitor settings. */
 	cc_cfg->sys_mon_sample_rate = cfg_getint(cfg, SETTING_SYS_MON_SAMPLE_RATE);
 	cc_cfg->sys_mon_num_samples_upload = cfg_getint(cfg, SETTING_SYS_MON_UPLOAD_SIZE);
 	get_sys_mon_metrics(cc_cfg);
 
+	/* Fill log forwarder settings. */
+	get_string_list(cc_cfg, SETTING_LOG_FWD_SOURCES,
+		&cc_cfg->log_fwd_sources, &cc_cfg->n_log_fwd_sources);
+	cc_cfg->log_fwd_level = get_log_fwd_level(cc_cfg);
+	cc_cfg->log_fwd_filter = cfg_getstr(cfg, SETTING_LOG_FWD_FILTER);
+	cc_cfg->log_fwd_exclude = cfg_getstr(cfg, SETTING_LOG_FWD_EXCLUDE);
+	cc_cfg->log_fwd_rate = cfg_getint(cfg, SETTING_LOG_FWD_RATE);
+	cc_cfg->log_fwd_interval = cfg_getint(cfg, SETTING_LOG_FWD_INTERVAL);
+	cc_cfg->log_fwd_upload_size = cfg_getint(cfg, SETTING_LOG_FWD_UPLOAD_SIZE);
+
+	/* Fill crash capture settings. */
+	cc_cfg->crash_path = cfg_getstr(cfg, SETTING_CRASH_PATH);
+	cc_cfg->crash_handler = cfg_getbool(cfg, SETTING_CRASH_HANDLER);
+	cc_cfg->crash_max_core_kb = cfg_getint(cfg, SETTING_CRASH_MAX_CORE_SIZE);
+	cc_cfg->crash_max_stored = cfg_getint(cfg, SETTING_CRASH_MAX_STORED);
+	cc_cfg->crash_max_stored_kb = cfg_getint(cfg, SETTING_CRASH_MAX_STORED_SIZE);
+
+	/* Fill gateway settings. */
+	cc_cfg->gw_max_children = cfg_getint(cfg, SETTING_GW_MAX_CHILDREN);
+	cc_cfg->gw_child_timeout = cfg_getint(cfg, SETTING_GW_CHILD_TIMEOUT);
+	cc_cfg->gw_child_rate_kb = cfg_getint(cfg, SETTING_GW_CHILD_RATE);
+	cc_cfg->gw_child_backlog_kb = cfg_getint(cfg, SETTING_GW_CHILD_BACKLOG_SIZE);
+
+	/* Fill job scheduler settings. */
+	get_string_list(cc_cfg, SETTING_JOB_COMMANDS,
+		&cc_cfg->job_commands, &cc_cfg->n_job_commands);
+	cc_cfg->job_max_timeout = cfg_getint(cfg, SETTING_JOB_MAX_TIMEOUT);
+
 	/* Fill static location settings. */
 	cc_cfg->use_static_location = cfg_getbool(cfg, SETTING_USE_STATIC_LOCATION);
 	cc_cfg->latitude = (float) cfg_getfloat(cfg, SETTING_LATITUDE);
@@ -956,6 +1684,7 @@ static int fill_connector_config(cc_cfg_t *cc_cfg, bool log_msgs)
 	/* Fill logging settings. */
 	cc_cfg->log_level = get_log_level(cc_cfg);
 	cc_cfg->log_console = cfg_getbool(cfg, SETTING_LOG_CONSOLE);
+	cc_cfg->connector_debug = cfg_getbool(cfg, SETTING_CONNECTOR_DEBUG);
 
 	return 0;
 }
@@ -1005,16 +1734,29 @@ int parse_configuration(const char *const filename, cc_cfg_t *cc_cfg)
 		/* Connection settings. */
 		CFG_STR(	SETTING_RM_URL,			"edp12.devicecloud.com",	CFGF_NONE),
 		CFG_STR(	SETTING_CLIENT_CERT_PATH,	"/etc/ssl/certs/drm_cert.pem",	CFGF_NONE),
+		CFG_STR(	SETTING_CLIENT_CERT_KEY_FILE,	"",				CFGF_NONE),
 		CFG_BOOL(	SETTING_ENABLE_RECONNECT,	cfg_true,			CFGF_NONE),
 		CFG_INT(	SETTING_RECONNECT_TIME,		30,				CFGF_NONE),
 		CFG_INT(	SETTING_KEEPALIVE_TX,		75,				CFGF_NONE),
 		CFG_INT(	SETTING_KEEPALIVE_RX,		75,				CFGF_NONE),
 		CFG_INT(	SETTING_WAIT_TIMES,		5,				CFGF_NONE),
+		CFG_INT(	SETTING_SOCKET_BUFFER_SIZE,	0,				CFGF_NONE),
+		CFG_INT(	SETTING_SOCKET_BUFFER_MAX,	1024,				CFGF_NONE),
+		CFG_INT(	SETTING_COMPRESSION_LEVEL,	-1,				CFGF_NONE),
+		CFG_INT(	SETTING_COMPRESSION_MEMORY,	0,				CFGF_NONE),
 
 		/* Services settings. */
 		CFG_BOOL(	ENABLE_FS_SERVICE,		cfg_true,			CFGF_NONE),
 		CFG_STR(	SETTING_FW_DOWNLOAD_PATH,	"",				CFGF_NONE),
 		CFG_BOOL(	SETTING_ON_THE_FLY,		cfg_false,			CFGF_NONE),
+		CFG_STR(	SETTING_FW_INSTALL_WINDOW,	"",				CFGF_NONE),
+		CFG_INT(	SETTING_FW_POSTPONE_MAX,	60,				CFGF_NONE),
+
+		/* Health check settings. */
+		CFG_INT(	SETTING_HEALTH_CHECK_TIMEOUT,	0,				CFGF_NONE),
+		CFG_STR_LIST(	SETTING_HEALTH_CHECK_SERVICES,	NULL,				CFGF_NONE),
+		CFG_STR_LIST(	SETTING_HEALTH_CHECK_APPS,	NULL,				CFGF_NONE),
+		CFG_STR(	SETTING_BOOTENV_FILE,		"",				CFGF_NONE),
 
 		/* File system settings. */
 		CFG_SEC(	GROUP_VIRTUAL_DIRS,		virtual_dirs_opts,		CFGF_NONE),
@@ -1023,12 +1765,47 @@ int parse_configuration(const char *const filename, cc_cfg_t *cc_cfg)
 		CFG_STR(	SETTING_DATA_BACKLOG_PATH,	"/tmp",				CFGF_NONE),
 		CFG_INT(	SETTING_DATA_BACKLOG_SIZE,	1024,				CFGF_NONE),
 
+		/* Memory budget settings. */
+		CFG_INT(	SETTING_MEM_BUDGET_SIZE,	0,				CFGF_NONE),
+		CFG_INT(	SETTING_MEM_UPLOAD_SIZE,	0,				CFGF_NONE),
+		CFG_INT(	SETTING_MEM_DATA_REQUEST_SIZE,	0,				CFGF_NONE),
+
 		/* System monitor settings. */
 		CFG_BOOL(	ENABLE_SYSTEM_MONITOR,		cfg_false,			CFGF_NONE),
 		CFG_INT(	SETTING_SYS_MON_SAMPLE_RATE,	5,				CFGF_NONE),
 		CFG_INT(	SETTING_SYS_MON_UPLOAD_SIZE,	10,				CFGF_NONE),
 		CFG_STR_LIST(	SETTING_SYS_MON_METRICS,	"{\"*\"}",			CFGF_NONE),
 
+		/* Log forwarder settings. */
+		CFG_BOOL(	ENABLE_LOG_FORWARD,		cfg_false,			CFGF_NONE),
+		CFG_STR_LIST(	SETTING_LOG_FWD_SOURCES,	"{\"" LOG_FWD_SOURCE_CCCSD "\"}",	CFGF_NONE),
+		CFG_STR(	SETTING_LOG_FWD_LEVEL,		LOG_LEVEL_WARNING_STR,		CFGF_NONE),
+		CFG_STR(	SETTING_LOG_FWD_FILTER,		"",				CFGF_NONE),
+		CFG_STR(	SETTING_LOG_FWD_EXCLUDE,	"",				CFGF_NONE),
+		CFG_INT(	SETTING_LOG_FWD_RATE,		10,				CFGF_NONE),
+		CFG_INT(	SETTING_LOG_FWD_INTERVAL,	60,				CFGF_NONE),
+		CFG_INT(	SETTING_LOG_FWD_UPLOAD_SIZE,	100,				CFGF_NONE),
+
+		/* Crash capture settings. */
+		CFG_BOOL(	ENABLE_CRASH_CAPTURE,		cfg_false,			CFGF_NONE),
+		CFG_STR(	SETTING_CRASH_PATH,		"/mnt/data/crashes",		CFGF_NONE),
+		CFG_BOOL(	SETTING_CRASH_HANDLER,		cfg_true,			CFGF_NONE),
+		CFG_INT(	SETTING_CRASH_MAX_CORE_SIZE,	16384,				CFGF_NONE),
+		CFG_INT(	SETTING_CRASH_MAX_STORED,	5,				CFGF_NONE),
+		CFG_INT(	SETTING_CRASH_MAX_STORED_SIZE,	32768,				CFGF_NONE),
+
+		/* Gateway settings. */
+		CFG_BOOL(	ENABLE_GATEWAY,			cfg_false,			CFGF_NONE),
+		CFG_INT(	SETTING_GW_MAX_CHILDREN,	32,				CFGF_NONE),
+		CFG_INT(	SETTING_GW_CHILD_TIMEOUT,	300,				CFGF_NONE),
+		CFG_INT(	SETTING_GW_CHILD_RATE,		256,				CFGF_NONE),
+		CFG_INT(	SETTING_GW_CHILD_BACKLOG_SIZE,	1024,				CFGF_NONE),
+
+		/* Job scheduler settings. */
+		CFG_BOOL(	ENABLE_JOB_SCHEDULER,		cfg_false,			CFGF_NONE),
+		CFG_STR_LIST(	SETTING_JOB_COMMANDS,		NULL,				CFGF_NONE),
+		CFG_INT(	SETTING_JOB_MAX_TIMEOUT,	3600,				CFGF_NONE),
+
 		/* Static location settings */
 		CFG_BOOL(	SETTING_USE_STATIC_LOCATION,	cfg_true,			CFGF_NONE),
 		CFG_FLOAT(	SETTING_LATITUDE,		0.0,				CFGF_NONE),
@@ -1037,6 +1814,7 @@ int parse_configuration(const char *const filename, cc_cfg_t *cc_cfg)
 		/* Logging settings. */
 		CFG_STR(	SETTING_LOG_LEVEL,		LOG_LEVEL_ERROR_STR,		CFGF_NONE),
 		CFG_BOOL(	SETTING_LOG_CONSOLE,		cfg_false,			CFGF_NONE),
+		CFG_BOOL(	SETTING_CONNECTOR_DEBUG,	cfg_false,			CFGF_NONE),
 
 		/* Needed for unknown settings. */
 		CFG_STR(	SETTING_UNKNOWN,		NULL,				CFGF_NONE),
@@ -1061,17 +1839,49 @@ int parse_configuration(const char *const filename, cc_cfg_t *cc_cfg)
 	cfg_set_validate_func(cc_cfg->_data, SETTING_LOCATION, cfg_check_location);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_RM_URL, cfg_check_rm_url);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_CLIENT_CERT_PATH, cfg_check_cert_path);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_CLIENT_CERT_KEY_FILE, cfg_check_cert_key_file);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_RECONNECT_TIME, cfg_check_reconnect_time);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_KEEPALIVE_RX, cfg_check_keepalive_rx);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_KEEPALIVE_TX, cfg_check_keepalive_tx);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_WAIT_TIMES, cfg_check_wait_times);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_SOCKET_BUFFER_SIZE, cfg_check_socket_buffer_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_SOCKET_BUFFER_MAX, cfg_check_socket_buffer_max);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_COMPRESSION_LEVEL, cfg_check_compression_level);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_COMPRESSION_MEMORY, cfg_check_compression_memory);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_FW_INSTALL_WINDOW, cfg_check_fw_install_window);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_FW_POSTPONE_MAX, cfg_check_fw_postpone_max);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_HEALTH_CHECK_TIMEOUT, cfg_check_health_check_timeout);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_DATA_BACKLOG_PATH, cfg_check_directory_exists_or_empty);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_DATA_BACKLOG_SIZE, cfg_check_data_backlog_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_MEM_BUDGET_SIZE, cfg_check_mem_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_MEM_UPLOAD_SIZE, cfg_check_mem_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_MEM_DATA_REQUEST_SIZE, cfg_check_mem_size);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_SYS_MON_SAMPLE_RATE,
 			cfg_check_sys_mon_sample_rate);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_SYS_MON_UPLOAD_SIZE,
 			cfg_check_sys_mon_upload_size);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_SYS_MON_METRICS, cfg_check_sys_mon_metrics);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_SOURCES, cfg_check_log_fwd_sources);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_LEVEL, cfg_check_log_fwd_level);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_FILTER, cfg_check_regex);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_EXCLUDE, cfg_check_regex);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_RATE, cfg_check_log_fwd_rate);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_INTERVAL, cfg_check_log_fwd_interval);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_LOG_FWD_UPLOAD_SIZE,
+			cfg_check_log_fwd_upload_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_CRASH_PATH, cfg_check_crash_path);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_CRASH_MAX_CORE_SIZE,
+			cfg_check_crash_max_core_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_CRASH_MAX_STORED, cfg_check_crash_max_stored);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_CRASH_MAX_STORED_SIZE,
+			cfg_check_crash_max_stored_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_GW_MAX_CHILDREN, cfg_check_gw_max_children);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_GW_CHILD_TIMEOUT, cfg_check_gw_child_timeout);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_GW_CHILD_RATE, cfg_check_gw_child_rate);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_GW_CHILD_BACKLOG_SIZE,
+			cfg_check_gw_child_backlog_size);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_JOB_COMMANDS, cfg_check_job_commands);
+	cfg_set_validate_func(cc_cfg->_data, SETTING_JOB_MAX_TIMEOUT, cfg_check_job_max_timeout);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_LATITUDE, cfg_check_latitude);
 	cfg_set_validate_func(cc_cfg->_data, SETTING_LONGITUDE, cfg_check_longitude);
 
@@ -1127,6 +1937,7 @@ static void free_cc_cfg(cc_cfg_t *cc_cfg)
 	cc_cfg->location = NULL;
 	cc_cfg->url = NULL;
 	cc_cfg->client_cert_path = NULL;
+	cc_cfg->client_cert_key_file = NULL;
 
 	for (i = 0; i < cc_cfg->n_vdirs; i++) {
 		cc_cfg->vdirs[i].name = NULL;
@@ -1137,15 +1948,48 @@ static void free_cc_cfg(cc_cfg_t *cc_cfg)
 	cc_cfg->n_vdirs = 0;
 
 	cc_cfg->fw_download_path = NULL;
+	cc_cfg->fw_install_window = NULL;
+
+	for (i = 0; i < cc_cfg->n_health_check_services; i++)
+		cc_cfg->health_check_services[i] = NULL;
+	free(cc_cfg->health_check_services);
+	cc_cfg->health_check_services = NULL;
+	cc_cfg->n_health_check_services = 0;
+	for (i = 0; i < cc_cfg->n_health_check_apps; i++)
+		cc_cfg->health_check_apps[i] = NULL;
+	free(cc_cfg->health_check_apps);
+	cc_cfg->health_check_apps = NULL;
+	cc_cfg->n_health_check_apps = 0;
+	cc_cfg->bootenv_file = NULL;
 
 	cc_cfg->data_backlog_path = NULL;
 	cc_cfg->data_backlog_kb = 0;
 
+	cc_cfg->mem_budget_kb = 0;
+	cc_cfg->mem_upload_kb = 0;
+	cc_cfg->mem_data_request_kb = 0;
+
 	for (i = 0; i < cc_cfg->n_sys_mon_metrics; i++)
 		cc_cfg->sys_mon_metrics[i] = NULL;
 	free(cc_cfg->sys_mon_metrics);
 	cc_cfg->sys_mon_metrics = NULL;
 	cc_cfg->n_sys_mon_metrics = 0;
+
+	for (i = 0; i < cc_cfg->n_log_fwd_sources; i++)
+		cc_cfg->log_fwd_sources[i] = NULL;
+	free(cc_cfg->log_fwd_sources);
+	cc_cfg->log_fwd_sources = NULL;
+	cc_cfg->n_log_fwd_sources = 0;
+	cc_cfg->log_fwd_filter = NULL;
+	cc_cfg->log_fwd_exclude = NULL;
+
+	cc_cfg->crash_path = NULL;
+
+	for (i = 0; i < cc_cfg->n_job_commands; i++)
+		cc_cfg->job_commands[i] = NULL;
+	free(cc_cfg->job_commands);
+	cc_cfg->job_commands = NULL;
+	cc_cfg->n_job_commands = 0;
 }
 
 void free_configuration(cc_cfg_t *cc_cfg)
@@ -1203,28 +2047,85 @@ static int set_connector_config(cc_cfg_t *cc_cfg)
 	/* Fill connection settings. */
 	cfg_setstr(cfg, SETTING_RM_URL, cc_cfg->url);
 	cfg_setstr(cfg, SETTING_CLIENT_CERT_PATH, cc_cfg->client_cert_path);
+	cfg_setstr(cfg, SETTING_CLIENT_CERT_KEY_FILE, cc_cfg->client_cert_key_file);
 	cfg_setbool(cfg, SETTING_ENABLE_RECONNECT, (cfg_bool_t) cc_cfg->enable_reconnect);
 	cfg_setint(cfg, SETTING_RECONNECT_TIME, cc_cfg->reconnect_time);
 	cfg_setint(cfg, SETTING_KEEPALIVE_RX, cc_cfg->keepalive_rx);
 	cfg_setint(cfg, SETTING_KEEPALIVE_TX, cc_cfg->keepalive_tx);
 	cfg_setint(cfg, SETTING_WAIT_TIMES, cc_cfg->wait_count);
+	cfg_setint(cfg, SETTING_SOCKET_BUFFER_SIZE, cc_cfg->socket_buffer_size);
+	cfg_setint(cfg, SETTING_SOCKET_BUFFER_MAX, cc_cfg->socket_buffer_max);
+	cfg_setint(cfg, SETTING_COMPRESSION_LEVEL, cc_cfg->compression_level);
+	cfg_setint(cfg, SETTING_COMPRESSION_MEMORY, cc_cfg->compression_memory_kb);
 
 	/* Fill services settings. */
 	cfg_setbool(cfg, ENABLE_FS_SERVICE, cc_cfg->services & FS_SERVICE ? cfg_true : cfg_false);
 	cfg_setbool(cfg, ENABLE_SYSTEM_MONITOR, cc_cfg->services & SYS_MONITOR_SERVICE ? cfg_true : cfg_false);
+	cfg_setbool(cfg, ENABLE_LOG_FORWARD, cc_cfg->services & LOG_FORWARD_SERVICE ? cfg_true : cfg_false);
+	cfg_setbool(cfg, ENABLE_CRASH_CAPTURE, cc_cfg->services & CRASH_CAPTURE_SERVICE ? cfg_true : cfg_false);
+	cfg_setbool(cfg, ENABLE_GATEWAY, cc_cfg->services & GATEWAY_SERVICE ? cfg_true : cfg_false);
+	cfg_setbool(cfg, ENABLE_JOB_SCHEDULER, cc_cfg->services & JOB_SCHEDULER_SERVICE ? cfg_true : cfg_false);
 	cfg_setstr(cfg, SETTING_FW_DOWNLOAD_PATH, cc_cfg->fw_download_path);
+	cfg_setstr(cfg, SETTING_FW_INSTALL_WINDOW, cc_cfg->fw_install_window);
+	cfg_setint(cfg, SETTING_FW_POSTPONE_MAX, cc_cfg->fw_postpone_max);
 	/* TODO: Set virtual directories */
 
+	/* Fill health check settings. */
+	cfg_setint(cfg, SETTING_HEALTH_CHECK_TIMEOUT, cc_cfg->health_check_timeout);
+	for (i = 0; i < cc_cfg->n_health_check_services; i++)
+		cfg_setnstr(cfg, SETTING_HEALTH_CHECK_SERVICES, cc_cfg->health_check_services[i], i);
+	for (i = 0; i < cc_cfg->n_health_check_apps; i++)
+		cfg_setnstr(cfg, SETTING_HEALTH_CHECK_APPS, cc_cfg->health_check_apps[i], i);
+	cfg_setstr(cfg, SETTING_BOOTENV_FILE, cc_cfg->bootenv_file);
+
 	/* Fill data service settings. */
 	cfg_setstr(cfg, SETTING_DATA_BACKLOG_PATH, cc_cfg->data_backlog_path);
 	cfg_setint(cfg, SETTING_DATA_BACKLOG_SIZE, cc_cfg->data_backlog_kb);
 
+	/* Fill memory budget settings. */
+	cfg_setint(cfg, SETTING_MEM_BUDGET_SIZE, cc_cfg->mem_budget_kb);
+	cfg_setint(cfg, SETTING_MEM_UPLOAD_SIZE, cc_cfg->mem_upload_kb);
+	cfg_setint(cfg, SETTING_MEM_DATA_REQUEST_SIZE, cc_cfg->mem_data_request_kb);
+
 	/* Fill system monitor settings. */
 	cfg_setint(cfg, SETTING_SYS_MON_SAMPLE_RATE, cc_cfg->sys_mon_sample_rate);
 	cfg_setint(cfg, SETTING_SYS_MON_UPLOAD_SIZE, cc_cfg->sys_mon_num_samples_upload);
 	for (i = 0; i < cc_cfg->n_sys_mon_metrics; i++)
 		cfg_setnstr(cfg, SETTING_SYS_MON_METRICS, cc_cfg->sys_mon_metrics[i], i);
 
+	/* Fill log forwarder settings. */
+	for (i = 0; i < cc_cfg->n_log_fwd_sources; i++)
+		cfg_setnstr(cfg, SETTING_LOG_FWD_SOURCES, cc_cfg->log_fwd_sources[i], i);
+	for (i = 0; i < ARRAY_SIZE(log_fwd_levels); i++) {
+		if (log_fwd_levels[i].level == cc_cfg->log_fwd_level) {
+			cfg_setstr(cfg, SETTING_LOG_FWD_LEVEL, log_fwd_levels[i].name);
+			break;
+		}
+	}
+	cfg_setstr(cfg, SETTING_LOG_FWD_FILTER, cc_cfg->log_fwd_filter);
+	cfg_setstr(cfg, SETTING_LOG_FWD_EXCLUDE, cc_cfg->log_fwd_exclude);
+	cfg_setint(cfg, SETTING_LOG_FWD_RATE, cc_cfg->log_fwd_rate);
+	cfg_setint(cfg, SETTING_LOG_FWD_INTERVAL, cc_cfg->log_fwd_interval);
+	cfg_setint(cfg, SETTING_LOG_FWD_UPLOAD_SIZE, cc_cfg->log_fwd_upload_size);
+
+	/* Fill crash capture settings. */
+	cfg_setstr(cfg, SETTING_CRASH_PATH, cc_cfg->crash_path);
+	cfg_setbool(cfg, SETTING_CRASH_HANDLER, cc_cfg->crash_handler ? cfg_true : cfg_false);
+	cfg_setint(cfg, SETTING_CRASH_MAX_CORE_SIZE, cc_cfg->crash_max_core_kb);
+	cfg_setint(cfg, SETTING_CRASH_MAX_STORED, cc_cfg->crash_max_stored);
+	cfg_setint(cfg, SETTING_CRASH_MAX_STORED_SIZE, cc_cfg->crash_max_stored_kb);
+
+	/* Fill gateway settings. */
+	cfg_setint(cfg, SETTING_GW_MAX_CHILDREN, cc_cfg->gw_max_children);
+	cfg_setint(cfg, SETTING_GW_CHILD_TIMEOUT, cc_cfg->gw_child_timeout);
+	cfg_setint(cfg, SETTING_GW_CHILD_RATE, cc_cfg->gw_child_rate_kb);
+	cfg_setint(cfg, SETTING_GW_CHILD_BACKLOG_SIZE, cc_cfg->gw_child_backlog_kb);
+
+	/* Fill job scheduler settings. */
+	for (i = 0; i < cc_cfg->n_job_commands; i++)
+		cfg_setnstr(cfg, SETTING_JOB_COMMANDS, cc_cfg->job_commands[i], i);
+	cfg_setint(cfg, SETTING_JOB_MAX_TIMEOUT, cc_cfg->job_max_timeout);
+
 	/* Fill static location settings. */
 	cfg_setbool(cfg, SETTING_USE_STATIC_LOCATION, (cfg_bool_t) cc_cfg->use_static_location);
 	cfg_setfloat(cfg, SETTING_LATITUDE, cc_cfg->latitude);
@@ -1244,6 +2145,7 @@ static int set_connector_config(cc_cfg_t *cc_cfg)
 			break;
 	}
 	cfg_setbool(cfg, SETTING_LOG_CONSOLE, (cfg_bool_t) cc_cfg->log_console);
+	cfg_setbool(cfg, SETTING_CONNECTOR_DEBUG, (cfg_bool_t) cc_cfg->connector_debug);
 
 	return 0;
 }
@@ -28,6 +28,10 @@
 
 #define FS_SERVICE		(1 << 0)
 #define SYS_MONITOR_SERVICE	(1 << 1)
+#define LOG_FORWARD_SERVICE	(1 << 2)
+#define CRASH_CAPTURE_SERVICE	(1 << 3)
+#define GATEWAY_SERVICE		(1 << 4)
+#define JOB_SCHEDULER_SERVICE	(1 << 5)
 
 #define LOG_LEVEL_ERROR		LOG_ERR
 #define LOG_LEVEL_INFO		LOG_INFO
@@ -56,30 +60,68 @@ typedef struct {
  * @location:				Location of the device (not GPS location)
  * @url:				Remote Manager URL
  * @client_cert_path:			Client certificate path
+ * @client_cert_key_file:		Device key file to encrypt the client
+ *					certificate, NULL or empty to not encrypt it
  * @enable_reconnect:			Enabled reconnection when connection is lost
  * @reconnect_time:			Number of seconds to reconnect
  * @keepalive_rx:			Keepalive receiving frequency (seconds)
  * @keepalive_tx:			Keepalive transmitting frequency (seconds)
  * @wait_count:				Number of lost keepalives to consider the connection lost
+ * @socket_buffer_size:			Socket buffers size (KB), 0 to adapt it
+ * @socket_buffer_max:			Maximum receive window and buffer when adapting them (KB)
+ * @compression_level:			Messages compression level (0-9), -1 to adapt it
+ * @compression_memory_kb:		Memory limit (kb) of each compression stream, 0 for no limit
  * @services:				Enabled services
  * @vdirs:				List of virtual directories
  * @n_vdirs:				Number of virtual directories in the list
  * @fw_download_path			Absolute path to download firmware files
  * @on_the_fly:				Enable on-the-fly firmware download support
  * @is_dual_boot:			True for dual boot system, false otherwise
+ * @fw_install_window:			Daily time window (HH:MM-HH:MM) to install updates, empty for immediate install
+ * @fw_postpone_max:			Maximum minutes applications can postpone a scheduled update
+ * @health_check_timeout:		Minutes after boot to verify a firmware update, 0 to disable
+ * @health_check_services:		List of processes that must be running after an update
+ * @n_health_check_services:		Number of processes to check after an update
+ * @health_check_apps:			List of applications that must report healthy after an update
+ * @n_health_check_apps:		Number of applications to check after an update
+ * @bootenv_file:			File to use as bootloader environment, empty to use the device one
  * @data_backlog_path:			Absolute path to store data backlog when no connection
  * @data_backlog_kb:			Maximum size (kb) of the data backlog
+ * @mem_budget_kb:			Global memory budget (kb), 0 for no limit
+ * @mem_upload_kb:			Memory cap (kb) for data point file uploads, 0 for no cap
+ * @mem_data_request_kb:		Memory cap (kb) for data request payloads, 0 for no cap
  * @sys_mon_sample_rate:		Frequency at which gather system information
  * @sys_mon_num_samples_upload:		Number of samples of each channel to gather before uploading
  * @sys_mon_metrics:			List of metrics and interfaces to measure and upload to Remote Manager
  * @n_sys_mon_metrics:			Number of system monitor metrics and interfaces to measure
  * @sys_mon_all_metrics:		Whether all system monitor metrics should be measured or not
+ * @log_fwd_sources:			List of log sources to forward to Remote Manager
+ * @n_log_fwd_sources:			Number of log sources to forward
+ * @log_fwd_level:			Lowest severity (syslog priority) of the messages to forward
+ * @log_fwd_filter:			Regular expression messages must match to be forwarded, empty for all
+ * @log_fwd_exclude:			Regular expression of messages not to forward, empty for none
+ * @log_fwd_rate:			Maximum number of messages per second to forward, 0 for no limit
+ * @log_fwd_interval:			Maximum number of seconds to wait before uploading forwarded messages
+ * @log_fwd_upload_size:		Number of messages to gather before uploading
+ * @crash_path:				Absolute path to store captured core dumps until uploaded
+ * @crash_handler:			Whether to register as the kernel core dump pipe handler
+ * @crash_max_core_kb:			Maximum size (kb) of a compressed core dump, 0 for none
+ * @crash_max_stored:			Maximum number of crashes to store until uploaded
+ * @crash_max_stored_kb:		Maximum size (kb) of the stored crashes
+ * @gw_max_children:			Maximum number of child devices in gateway mode
+ * @gw_child_timeout:			Seconds without activity to consider a child offline, 0 to disable
+ * @gw_child_rate_kb:			Maximum data (kb) per minute a child can upload live, 0 for no limit
+ * @gw_child_backlog_kb:		Maximum size (kb) of the data backlog of each child
+ * @job_commands:			List of commands scheduled jobs can run, as 'name=command line'
+ * @n_job_commands:			Number of commands scheduled jobs can run
+ * @job_max_timeout:			Maximum number of seconds a scheduled job can run
  * @use_static_location			If true, use static location as GPS value
  * @latitude				Latitude value for static location
  * @longitude				Longitude value for static location
  * @altitude				Altitude value for static location
  * @log_level:				Level of messaging to log
  * @log_console:			Enable messages logging to the console
+ * @connector_debug:			Enable the Cloud Connector debug messages
  * @_data:				Internal configuration data
  *
  */
@@ -94,11 +136,16 @@ typedef struct {
 
 	char *url;
 	char *client_cert_path;
+	char *client_cert_key_file;
 	bool enable_reconnect;
 	uint16_t reconnect_time;
 	uint16_t keepalive_rx;
 	uint16_t keepalive_tx;
 	uint16_t wait_count;
+	uint32_t socket_buffer_size;
+	uint32_t socket_buffer_max;
+	int compression_level;
+	uint32_t compression_memory_kb;
 
 	uint8_t services;
 
@@ -108,16 +155,53 @@ typedef struct {
 	char *fw_download_path;
 	bool on_the_fly;
 	bool is_dual_boot;
+	char *fw_install_window;
+	uint32_t fw_postpone_max;
+
+	uint32_t health_check_timeout;
+	char **health_check_services;
+	unsigned int n_health_check_services;
+	char **health_check_apps;
+	unsigned int n_health_check_apps;
+	char *bootenv_file;
 
 	char *data_backlog_path;
 	uint32_t data_backlog_kb;
 
+	uint32_t mem_budget_kb;
+	uint32_t mem_upload_kb;
+	uint32_t mem_data_request_kb;
+
 	uint32_t sys_mon_sample_rate;
 	uint32_t sys_mon_num_samples_upload;
 	char **sys_mon_metrics;
 	unsigned int n_sys_mon_metrics;
 	bool sys_mon_all_metrics;
 
+	char **log_fwd_sources;
+	unsigned int n_log_fwd_sources;
+	int log_fwd_level;
+	char *log_fwd_filter;
+	char *log_fwd_exclude;
+	uint32_t log_fwd_rate;
+	uint32_t log_fwd_interval;
+	uint32_t log_fwd_upload_size;
+
+	char *crash_path;
+	bool crash_handler;
+	uint32_t crash_max_core_kb;
+	uint32_t crash_max_stored;
+	uint32_t crash_max_stored_kb;
+
+	uint32_t gw_max_children;
+	uint32_t gw_child_timeout;
+	uint32_t gw_child_rate_kb;
+	uint32_t gw_child_backlog_kb;
+
+	char **job_commands;
+	unsigned int n_job_commands;
+	uint32_t job_max_timeout;
+
 	bool use_static_location;
 	float latitude;
 	float longitude;
@@ -125,6 +209,7 @@ typedef struct {
 
 	int log_level;
 	bool log_console;
+	bool connector_debug;
 
 	void *_data;
 } cc_cfg_t;
@@ -189,6 +274,23 @@ int apply_configuration(cc_cfg_t *cc_cfg);
  */
 char *get_client_cert_path(void);
 
+/*
+ * get_client_cert_key_file() - Return the key file to encrypt the client certificate.
+ *
+ * Return:	Path file or NULL if the certificate is not encrypted.
+ */
+char *get_client_cert_key_file(void);
+
+/*
+ * get_socket_buffer_size() - Return the configured socket buffers size.
+ *
+ * @max_size:	Pointer to store the maximum receive window and buffer in
+ *		bytes when the buffer is adapted.
+ *
+ * Return:	Size in bytes, 0 to adapt it to the connection.
+ */
+uint32_t get_socket_buffer_size(uint32_t *max_size);
+
 int import_datarequests(const char *file_path);
 int dump_datarequests(const char *file_path);
 
@@ -0,0 +1,730 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cc_cred_store.h"
+#include "cc_logging.h"
+
+#define CRED_TAG		"CRED:"
+
+#define BACKUP_SUFFIX		".prev"
+#define FAILURES_SUFFIX		".fails"
+#define TMP_SUFFIX		".tmp"
+
+#define CRED_FILE_MODE		(S_IRUSR | S_IWUSR)
+
+/* Encrypted file: magic, IV, tag and AES-256-GCM encrypted credential */
+#define ENC_MAGIC		"CCCSCRD1"
+#define ENC_MAGIC_LEN		(sizeof(ENC_MAGIC) - 1)
+#define ENC_IV_LEN		12
+#define ENC_TAG_LEN		16
+#define ENC_KEY_LEN		32
+#define ENC_HEADER_LEN		(ENC_MAGIC_LEN + ENC_IV_LEN + ENC_TAG_LEN)
+#define ENC_KEY_CONTEXT		"cccs-credential-store"
+
+#define MAX_KEY_FILE_SIZE	4096
+
+/**
+ * log_cred_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_cred_debug(format, ...)					\
+	log_debug("%s " format, CRED_TAG, __VA_ARGS__)
+
+/**
+ * log_cred_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_cred_info(format, ...)					\
+	log_info("%s " format, CRED_TAG, __VA_ARGS__)
+
+/**
+ * log_cred_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_cred_error(format, ...)					\
+	log_error("%s " format, CRED_TAG, __VA_ARGS__)
+
+static pthread_mutex_t cred_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * get_file_path() - Build the path of a file next to a credential
+ *
+ * @path:	Path of the credential.
+ * @suffix:	Suffix to append.
+ *
+ * Return: The allocated path, NULL if out of memory.
+ */
+static char *get_file_path(const char *path, const char *suffix)
+{
+	size_t len = strlen(path) + strlen(suffix) + 1;
+	char *file_path = malloc(len);
+
+	if (file_path == NULL) {
+		log_cred_error("Unable to store '%s': %s", path, "Out of memory");
+		return NULL;
+	}
+
+	snprintf(file_path, len, "%s%s", path, suffix);
+
+	return file_path;
+}
+
+/*
+ * sync_dir() - Sync the directory of a file to persist renames and removals
+ *
+ * @path:	Path of the file.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int sync_dir(const char *path)
+{
+	char *copy = strdup(path);
+	int fd, ret = -1;
+
+	if (copy == NULL)
+		return -1;
+
+	fd = open(dirname(copy), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd >= 0) {
+		ret = fsync(fd);
+		close(fd);
+	}
+	if (ret != 0)
+		log_cred_debug("Unable to sync directory of '%s': %s (%d)", path, strerror(errno), errno);
+
+	free(copy);
+
+	return ret;
+}
+
+/*
+ * write_file() - Write a file atomically with permissions only for the owner
+ *
+ * @path:	Path of the file.
+ * @data:	Data to write.
+ * @len:	Length of the data.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int write_file(const char *path, const uint8_t *data, size_t len)
+{
+	char *tmp_path = get_file_path(path, TMP_SUFFIX);
+	size_t written = 0;
+	int fd, ret = -1;
+
+	if (tmp_path == NULL)
+		return -1;
+
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, CRED_FILE_MODE);
+	if (fd < 0) {
+		log_cred_error("Unable to create '%s': %s (%d)", tmp_path, strerror(errno), errno);
+		goto done;
+	}
+
+	/* The file may exist from an interrupted write with other permissions */
+	if (fchmod(fd, CRED_FILE_MODE) != 0)
+		goto error;
+
+	while (written < len) {
+		ssize_t n = write(fd, data + written, len - written);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			goto error;
+		written += (size_t) n;
+	}
+
+	if (fsync(fd) != 0)
+		goto error;
+
+	close(fd);
+	fd = -1;
+
+	if (rename(tmp_path, path) != 0)
+		goto error;
+
+	sync_dir(path);
+	ret = 0;
+	goto done;
+
+error:
+	log_cred_error("Unable to write '%s': %s (%d)", path, strerror(errno), errno);
+	if (fd >= 0)
+		close(fd);
+	unlink(tmp_path);
+
+done:
+	free(tmp_path);
+
+	return ret;
+}
+
+/*
+ * read_file() - Read a whole file
+ *
+ * @path:	Path of the file.
+ * @max_len:	Maximum length to read.
+ * @data:	Pointer to store the allocated data, NUL-terminated.
+ * @len:	Pointer to store the length of the data.
+ *
+ * Return: 0 on success, -1 otherwise with 'errno' set.
+ */
+static int read_file(const char *path, size_t max_len, uint8_t **data, size_t *len)
+{
+	struct stat st;
+	uint8_t *buf = NULL;
+	size_t n_read = 0;
+	int fd, error = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0) {
+		error = errno;
+		goto done;
+	}
+	if (st.st_size < 0 || (size_t) st.st_size > max_len) {
+		error = EFBIG;
+		goto done;
+	}
+
+	buf = malloc((size_t) st.st_size + 1);
+	if (buf == NULL) {
+		error = ENOMEM;
+		goto done;
+	}
+
+	while (n_read < (size_t) st.st_size) {
+		ssize_t n = read(fd, buf + n_read, (size_t) st.st_size - n_read);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			error = n < 0 ? errno : EIO;
+			goto done;
+		}
+		n_read += (size_t) n;
+	}
+	buf[n_read] = '\0';
+
+done:
+	close(fd);
+
+	if (error != 0) {
+		free(buf);
+		errno = error;
+		return -1;
+	}
+
+	*data = buf;
+	*len = n_read;
+
+	return 0;
+}
+
+/*
+ * get_key() - Derive the encryption key from a device key file
+ *
+ * @key_file:	Path of the device key file.
+ * @key:	Buffer of ENC_KEY_LEN bytes to store the key.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int get_key(const char *key_file, uint8_t *key)
+{
+	uint8_t *secret = NULL;
+	size_t secret_len = 0;
+	EVP_MD_CTX *ctx = NULL;
+	int ret = -1;
+
+	if (read_file(key_file, MAX_KEY_FILE_SIZE, &secret, &secret_len) != 0) {
+		log_cred_error("Unable to read key file '%s': %s (%d)", key_file, strerror(errno), errno);
+		return -1;
+	}
+	if (secret_len == 0) {
+		log_cred_error("Key file '%s' is empty", key_file);
+		goto done;
+	}
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+	ctx = EVP_MD_CTX_create();
+#else
+	ctx = EVP_MD_CTX_new();
+#endif
+	if (ctx != NULL
+		&& EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) == 1
+		&& EVP_DigestUpdate(ctx, ENC_KEY_CONTEXT, strlen(ENC_KEY_CONTEXT)) == 1
+		&& EVP_DigestUpdate(ctx, secret, secret_len) == 1
+		&& EVP_DigestFinal_ex(ctx, key, NULL) == 1)
+		ret = 0;
+	else
+		log_cred_error("Unable to derive key from '%s'", key_file);
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+	EVP_MD_CTX_destroy(ctx);
+#else
+	EVP_MD_CTX_free(ctx);
+#endif
+
+done:
+	OPENSSL_cleanse(secret, secret_len);
+	free(secret);
+
+	return ret;
+}
+
+/*
+ * encrypt_credential() - Encrypt a credential with the device key
+ *
+ * @key_file:	Path of the device key file.
+ * @data:	Credential to encrypt.
+ * @len:	Length of the credential.
+ * @enc:	Pointer to store the allocated encrypted credential.
+ * @enc_len:	Pointer to store the length of the encrypted credential.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int encrypt_credential(const char *key_file, const uint8_t *data, size_t len,
+	uint8_t **enc, size_t *enc_len)
+{
+	uint8_t key[ENC_KEY_LEN], *buf = NULL, *iv, *tag;
+	EVP_CIPHER_CTX *ctx = NULL;
+	int n, final_len, ret = -1;
+
+	if (len > CRED_MAX_SIZE || get_key(key_file, key) != 0)
+		return -1;
+
+	buf = malloc(ENC_HEADER_LEN + len);
+	if (buf == NULL)
+		goto done;
+
+	memcpy(buf, ENC_MAGIC, ENC_MAGIC_LEN);
+	iv = buf + ENC_MAGIC_LEN;
+	tag = iv + ENC_IV_LEN;
+	if (RAND_bytes(iv, ENC_IV_LEN) != 1)
+		goto done;
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL
+		|| EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1
+		|| EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, ENC_IV_LEN, NULL) != 1
+		|| EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv) != 1
+		|| EVP_EncryptUpdate(ctx, NULL, &n, buf, ENC_MAGIC_LEN) != 1
+		|| EVP_EncryptUpdate(ctx, buf + ENC_HEADER_LEN, &n, data, (int) len) != 1
+		|| EVP_EncryptFinal_ex(ctx, buf + ENC_HEADER_LEN + n, &final_len) != 1
+		|| EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, ENC_TAG_LEN, tag) != 1)
+		goto done;
+
+	*enc = buf;
+	*enc_len = ENC_HEADER_LEN + (size_t) n + (size_t) final_len;
+	buf = NULL;
+	ret = 0;
+
+done:
+	if (ret != 0)
+		log_cred_error("Unable to encrypt credential with key file '%s'", key_file);
+
+	EVP_CIPHER_CTX_free(ctx);
+	OPENSSL_cleanse(key, sizeof(key));
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * decrypt_credential() - Decrypt a credential with the device key
+ *
+ * @key_file:	Path of the device key file.
+ * @enc:	Encrypted credential, it is replaced by the decrypted one.
+ * @len:	Length of the encrypted credential, it is updated with the
+ *		length of the decrypted one.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int decrypt_credential(const char *key_file, uint8_t *enc, size_t *len)
+{
+	uint8_t key[ENC_KEY_LEN], *iv = enc + ENC_MAGIC_LEN, *tag = iv + ENC_IV_LEN;
+	size_t enc_len = *len - ENC_HEADER_LEN;
+	uint8_t *plain = malloc(enc_len + 1);
+	EVP_CIPHER_CTX *ctx = NULL;
+	int n = 0, final_len = 0, ret = -1;
+
+	if (plain == NULL || get_key(key_file, key) != 0) {
+		free(plain);
+		return -1;
+	}
+
+	ctx = EVP_CIPHER_CTX_new();
+	if (ctx == NULL
+		|| EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL) != 1
+		|| EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, ENC_IV_LEN, NULL) != 1
+		|| EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv) != 1
+		|| EVP_DecryptUpdate(ctx, NULL, &n, enc, ENC_MAGIC_LEN) != 1
+		|| EVP_DecryptUpdate(ctx, plain, &n, enc + ENC_HEADER_LEN, (int) enc_len) != 1
+		|| EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, ENC_TAG_LEN, tag) != 1
+		|| EVP_DecryptFinal_ex(ctx, plain + n, &final_len) != 1)
+		goto done;
+
+	*len = (size_t) n + (size_t) final_len;
+	memcpy(enc, plain, *len);
+	enc[*len] = '\0';
+	ret = 0;
+
+done:
+	if (ret != 0)
+		log_cred_error("Unable to decrypt credential, wrong key file '%s'?", key_file);
+
+	EVP_CIPHER_CTX_free(ctx);
+	OPENSSL_cleanse(key, sizeof(key));
+	OPENSSL_cleanse(plain, enc_len + 1);
+	free(plain);
+
+	return ret;
+}
+
+/*
+ * store_credential() - Write a credential, encrypting it if needed
+ *
+ * @path:	Path of the credential file.
+ * @key_file:	Device key file, NULL to not encrypt it.
+ * @data:	Credential.
+ * @len:	Length of the credential.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int store_credential(const char *path, const char *key_file, const uint8_t *data, size_t len)
+{
+	uint8_t *enc = NULL;
+	size_t enc_len = 0;
+	int ret;
+
+	if (key_file == NULL)
+		return write_file(path, data, len);
+
+	if (encrypt_credential(key_file, data, len, &enc, &enc_len) != 0)
+		return -1;
+
+	ret = write_file(path, enc, enc_len);
+	free(enc);
+
+	return ret;
+}
+
+/*
+ * is_encrypted() - Check if a stored credential is encrypted
+ *
+ * @data:	Stored credential.
+ * @len:	Length of the stored credential.
+ *
+ * Return: True if it is encrypted, false otherwise.
+ */
+static bool is_encrypted(const uint8_t *data, size_t len)
+{
+	return len >= ENC_HEADER_LEN && memcmp(data, ENC_MAGIC, ENC_MAGIC_LEN) == 0;
+}
+
+/*
+ * encrypt_file() - Encrypt a credential file stored without encryption
+ *
+ * @path:	Path of the credential file.
+ * @key_file:	Device key file.
+ *
+ * Nothing is done if the file does not exist or is already encrypted.
+ *
+ * Must be called with 'cred_lock' held.
+ */
+static void encrypt_file(const char *path, const char *key_file)
+{
+	uint8_t *buf = NULL;
+	size_t len = 0;
+
+	if (read_file(path, CRED_MAX_SIZE + ENC_HEADER_LEN, &buf, &len) != 0)
+		return;
+
+	if (!is_encrypted(buf, len) && store_credential(path, key_file, buf, len) == 0)
+		log_cred_info("Credential '%s' encrypted", path);
+
+	OPENSSL_cleanse(buf, len);
+	free(buf);
+}
+
+/*
+ * get_failed_handshakes() - Read the failed handshakes with a new credential
+ *
+ * @path:	Path of the credential file.
+ *
+ * The counter is stored next to the backup so it survives restarts.
+ *
+ * Must be called with 'cred_lock' held.
+ *
+ * Return: Number of failed handshakes, 0 if none is stored.
+ */
+static unsigned int get_failed_handshakes(const char *path)
+{
+	char *counter = get_file_path(path, FAILURES_SUFFIX);
+	uint8_t *buf = NULL;
+	size_t len = 0;
+	unsigned int n = 0;
+
+	if (counter == NULL)
+		return 0;
+
+	if (read_file(counter, 16, &buf, &len) == 0) {
+		n = (unsigned int) strtoul((char *) buf, NULL, 10);
+		free(buf);
+	}
+	free(counter);
+
+	return n;
+}
+
+/*
+ * set_failed_handshakes() - Store the failed handshakes with a new credential
+ *
+ * @path:	Path of the credential file.
+ * @n:		Number of failed handshakes, 0 removes the counter.
+ *
+ * Must be called with 'cred_lock' held.
+ */
+static void set_failed_handshakes(const char *path, unsigned int n)
+{
+	char *counter = get_file_path(path, FAILURES_SUFFIX);
+	char text[16];
+	int len;
+
+	if (counter == NULL)
+		return;
+
+	if (n == 0) {
+		if (unlink(counter) == 0)
+			sync_dir(counter);
+	} else {
+		len = snprintf(text, sizeof(text), "%u\n", n);
+		write_file(counter, (uint8_t *) text, (size_t) len);
+	}
+	free(counter);
+}
+
+/*
+ * restore_backup() - Restore the previous credential
+ *
+ * @path:	Path of the credential file.
+ * @backup:	Path of the backup.
+ *
+ * Must be called with 'cred_lock' held.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int restore_backup(const char *path, const char *backup)
+{
+	if (rename(backup, path) != 0) {
+		log_cred_error("Unable to restore '%s': %s (%d)", backup, strerror(errno), errno);
+		return -1;
+	}
+	sync_dir(path);
+	set_failed_handshakes(path, 0);
+
+	return 0;
+}
+
+int cred_store_save(const char *path, const char *key_file, const void *data, size_t len)
+{
+	char *backup;
+	int ret = -1;
+
+	if (path == NULL || data == NULL || len == 0 || len > CRED_MAX_SIZE)
+		return -1;
+
+	backup = get_file_path(path, BACKUP_SUFFIX);
+	if (backup == NULL)
+		return -1;
+
+	pthread_mutex_lock(&cred_lock);
+
+	/*
+	 * Keep the current credential unless an update is already waiting for
+	 * confirmation, in that case the backup is the last one that worked
+	 */
+	if (access(backup, F_OK) != 0 && access(path, F_OK) == 0) {
+		if (link(path, backup) != 0) {
+			log_cred_error("Unable to keep previous credential '%s': %s (%d)",
+				path, strerror(errno), errno);
+			goto done;
+		}
+		sync_dir(backup);
+	}
+
+	/* The previous credential may be stored before enabling the encryption */
+	if (key_file != NULL)
+		encrypt_file(backup, key_file);
+
+	ret = store_credential(path, key_file, data, len);
+	if (ret == 0) {
+		set_failed_handshakes(path, 0);
+		log_cred_info("New credential stored at '%s'%s", path, key_file != NULL ? " (encrypted)" : "");
+	}
+
+done:
+	pthread_mutex_unlock(&cred_lock);
+	free(backup);
+
+	return ret;
+}
+
+int cred_store_load(const char *path, const char *key_file, char **data, size_t *len)
+{
+	char *backup;
+	uint8_t *buf = NULL;
+	size_t buf_len = 0;
+	int ret = -1;
+
+	if (path == NULL)
+		return -1;
+
+	backup = get_file_path(path, BACKUP_SUFFIX);
+	if (backup == NULL)
+		return -1;
+
+	pthread_mutex_lock(&cred_lock);
+
+	if (read_file(path, CRED_MAX_SIZE + ENC_HEADER_LEN, &buf, &buf_len) != 0) {
+		if (errno == ENOENT && access(backup, F_OK) == 0 && restore_backup(path, backup) == 0) {
+			log_cred_info("Credential '%s' missing, restored previous one", path);
+			if (read_file(path, CRED_MAX_SIZE + ENC_HEADER_LEN, &buf, &buf_len) == 0)
+				goto check;
+		}
+		if (errno != ENOENT)
+			log_cred_error("Unable to read credential '%s': %s (%d)", path, strerror(errno), errno);
+		goto done;
+	}
+
+check:
+
+	if (is_encrypted(buf, buf_len)) {
+		if (key_file == NULL) {
+			log_cred_error("Credential '%s' is encrypted but no key file is configured", path);
+			goto done;
+		}
+		if (decrypt_credential(key_file, buf, &buf_len) != 0)
+			goto done;
+	} else if (key_file != NULL) {
+		/* Stored before enabling the encryption */
+		if (store_credential(path, key_file, buf, buf_len) == 0)
+			log_cred_info("Credential '%s' encrypted", path);
+	}
+
+	/* A backup kept before enabling the encryption must not stay in clear */
+	if (key_file != NULL)
+		encrypt_file(backup, key_file);
+
+	*data = (char *) buf;
+	*len = buf_len;
+	buf = NULL;
+	ret = 0;
+
+done:
+	pthread_mutex_unlock(&cred_lock);
+	if (buf != NULL) {
+		OPENSSL_cleanse(buf, buf_len);
+		free(buf);
+	}
+	free(backup);
+
+	return ret;
+}
+
+bool cred_store_pending(const char *path)
+{
+	char *backup;
+	bool pending;
+
+	if (path == NULL)
+		return false;
+
+	backup = get_file_path(path, BACKUP_SUFFIX);
+	if (backup == NULL)
+		return false;
+
+	pending = access(backup, F_OK) == 0;
+	free(backup);
+
+	return pending;
+}
+
+void cred_store_handshake_done(const char *path, bool success)
+{
+	char *backup;
+	unsigned int failed_handshakes;
+
+	if (path == NULL)
+		return;
+
+	backup = get_file_path(path, BACKUP_SUFFIX);
+	if (backup == NULL)
+		return;
+
+	pthread_mutex_lock(&cred_lock);
+
+	if (access(backup, F_OK) != 0)
+		goto done;
+
+	if (success) {
+		if (unlink(backup) == 0) {
+			sync_dir(backup);
+			log_cred_info("New credential '%s' confirmed", path);
+		}
+		set_failed_handshakes(path, 0);
+		goto done;
+	}
+
+	failed_handshakes = get_failed_handshakes(path) + 1;
+	if (failed_handshakes >= CRED_MAX_FAILED_HANDSHAKES) {
+		if (restore_backup(path, backup) == 0)
+			log_cred_error("New credential '%s' failed %d handshakes, restored previous one",
+				path, CRED_MAX_FAILED_HANDSHAKES);
+	} else {
+		set_failed_handshakes(path, failed_handshakes);
+		log_cred_debug("Handshake with new credential '%s' failed (%u/%d)",
+			path, failed_handshakes, CRED_MAX_FAILED_HANDSHAKES);
+	}
+
+done:
+	pthread_mutex_unlock(&cred_lock);
+	free(backup);
+}
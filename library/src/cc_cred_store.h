@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+#ifndef CC_CRED_STORE_H_
+#define CC_CRED_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Failed TLS handshakes with a new credential before restoring the previous one */
+#define CRED_MAX_FAILED_HANDSHAKES	3
+
+/* Maximum size of a stored credential */
+#define CRED_MAX_SIZE			(64 * 1024)
+
+/*
+ * cred_store_save() - Store a new credential replacing the current one
+ *
+ * @path:	Absolute path of the credential file.
+ * @key_file:	Device key file to encrypt the credential, NULL to store it
+ *		without encryption.
+ * @data:	Credential to store.
+ * @len:	Length of the credential.
+ *
+ * The credential is written to a temporary file that is synced and renamed
+ * over 'path', with permissions only for the owner. The current credential is
+ * kept as a backup until the new one is confirmed with
+ * cred_store_handshake_done().
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int cred_store_save(const char *path, const char *key_file, const void *data, size_t len);
+
+/*
+ * cred_store_load() - Read a stored credential
+ *
+ * @path:	Absolute path of the credential file.
+ * @key_file:	Device key file to decrypt the credential, NULL if it is not
+ *		encrypted.
+ * @data:	Pointer to store the allocated credential, NUL-terminated. The
+ *		caller must free it.
+ * @len:	Pointer to store the length of the credential.
+ *
+ * The backup is restored if the credential file is missing. A credential
+ * stored without encryption is encrypted if a key file is provided.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int cred_store_load(const char *path, const char *key_file, char **data, size_t *len);
+
+/*
+ * cred_store_pending() - Check if a new credential is waiting for confirmation
+ *
+ * @path:	Absolute path of the credential file.
+ *
+ * Return: True if the previous credential is still kept, false otherwise.
+ */
+bool cred_store_pending(const char *path);
+
+/*
+ * cred_store_handshake_done() - Report the result of a connection attempt
+ *
+ * @path:	Absolute path of the credential used in the connection.
+ * @success:	True if the connection to Remote Manager was established,
+ *		false if the TLS handshake failed or the server rejected it.
+ *
+ * A successful connection confirms a new credential and removes the backup.
+ * After CRED_MAX_FAILED_HANDSHAKES consecutive failures the previous
+ * credential is restored. Failures are counted in a file next to the backup,
+ * so the count survives restarts of the service.
+ */
+void cred_store_handshake_done(const char *path, bool success);
+
+#endif /* CC_CRED_STORE_H_ */
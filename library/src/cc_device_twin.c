@@ -0,0 +1,1069 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <json_object.h>
+#include <json_object_iterator.h>
+#include <json_tokener.h>
+#include <json_util.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_cc_datapoints.h"
+#include "cc_device_twin.h"
+#include "cc_init.h"
+#include "cc_logging.h"
+#include "service_twin.h"
+#include "_utils.h"
+
+#define TWIN_TAG			"TWIN:"
+
+#define TWIN_DIR			"/etc/cccs.twin"
+#define TWIN_EXT			".json"
+
+/* Data stream of the reported state: device_twin/<namespace>/reported */
+#define DP_TWIN_STREAM_PREFIX		"device_twin/"
+#define DP_TWIN_STREAM_SUFFIX		"/reported"
+
+#define MAX_NAMESPACES			32
+#define MAX_NAMESPACE_LEN		64
+/* Maximum size of a serialized desired or reported document */
+#define MAX_DOC_SIZE			(64 * 1024)
+
+/* Seconds to gather reports before syncing them */
+#define SYNC_DELAY_SEC			5
+#define SYNC_RETRY_SEC			30
+
+#define KEY_DESIRED			"desired"
+#define KEY_DESIRED_VERSION		"desired_version"
+#define KEY_REPORTED			"reported"
+#define KEY_REPORTED_VERSION		"reported_version"
+#define KEY_SYNCED_VERSION		"synced_version"
+
+/**
+ * log_twin_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_twin_debug(format, ...)					\
+	log_debug("%s " format, TWIN_TAG, __VA_ARGS__)
+
+/**
+ * log_twin_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_twin_info(format, ...)					\
+	log_info("%s " format, TWIN_TAG, __VA_ARGS__)
+
+/**
+ * log_twin_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_twin_error(format, ...)					\
+	log_error("%s " format, TWIN_TAG, __VA_ARGS__)
+
+/*
+ * struct twin_ns_t - Device twin of an application namespace
+ *
+ * @name:		Name of the namespace.
+ * @desired:		Desired state, set from Remote Manager.
+ * @desired_version:	Version of the desired state, 0 if never set.
+ * @reported:		Reported state, set by the application.
+ * @reported_version:	Version of the reported state, 0 if never reported.
+ * @synced:		Last reported state synced to Remote Manager in this
+ *			execution, NULL if none.
+ * @synced_version:	Version of the last synced reported state.
+ * @next:		Next namespace.
+ */
+typedef struct twin_ns {
+	char name[MAX_NAMESPACE_LEN + 1];
+	json_object *desired;
+	uint32_t desired_version;
+	json_object *reported;
+	uint32_t reported_version;
+	json_object *synced;
+	uint32_t synced_version;
+	struct twin_ns *next;
+} twin_ns_t;
+
+static volatile bool stop_requested = false;
+static volatile bool twin_thread_valid = false;
+static pthread_t twin_thread;
+
+static pthread_mutex_t twin_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when there is a reported state to sync */
+static pthread_cond_t twin_cond = PTHREAD_COND_INITIALIZER;
+static twin_ns_t *namespaces = NULL;
+static unsigned int n_namespaces = 0;
+static bool loaded = false;
+
+bool device_twin_valid_namespace(const char *ns)
+{
+	size_t len;
+
+	if (ns == NULL || ns[0] == '.')
+		return false;
+
+	len = strspn(ns, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.");
+
+	return len > 0 && len <= MAX_NAMESPACE_LEN && ns[len] == '\0';
+}
+
+/*
+ * copy_json() - Duplicate a JSON value
+ *
+ * @src:	Value to duplicate, NULL for the JSON null.
+ *
+ * Return: The new value, NULL for the JSON null or if out of memory.
+ */
+static json_object *copy_json(json_object *src)
+{
+	json_object *dst = NULL;
+
+	if (src != NULL && json_object_deep_copy(src, &dst, NULL) != 0)
+		return NULL;
+
+	return dst;
+}
+
+/*
+ * json_size() - Get the size of a serialized JSON value
+ *
+ * @obj:	Value to measure.
+ *
+ * Return: Number of bytes of the value without spaces.
+ */
+static size_t json_size(json_object *obj)
+{
+	return strlen(json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
+}
+
+/*
+ * apply_merge_patch() - Apply a JSON merge patch (RFC 7396) to an object
+ *
+ * @target:	Object to modify.
+ * @patch:	Object with the members to change. Null members are removed
+ *		from @target, object members are merged recursively and any
+ *		other member replaces the one in @target.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int apply_merge_patch(json_object *target, json_object *patch)
+{
+	struct json_object_iterator it = json_object_iter_begin(patch);
+	struct json_object_iterator end = json_object_iter_end(patch);
+
+	for (; !json_object_iter_equal(&it, &end); json_object_iter_next(&it)) {
+		const char *name = json_object_iter_peek_name(&it);
+		json_object *value = json_object_iter_peek_value(&it);
+		json_object *member = NULL;
+
+		if (value == NULL) {
+			json_object_object_del(target, name);
+			continue;
+		}
+
+		if (json_object_is_type(value, json_type_object)) {
+			if (!json_object_object_get_ex(target, name, &member)
+				|| !json_object_is_type(member, json_type_object)) {
+				member = json_object_new_object();
+				if (member == NULL || json_object_object_add(target, name, member) != 0) {
+					json_object_put(member);
+					return -1;
+				}
+			}
+			if (apply_merge_patch(member, value) != 0)
+				return -1;
+			continue;
+		}
+
+		member = copy_json(value);
+		if (member == NULL || json_object_object_add(target, name, member) != 0) {
+			json_object_put(member);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * diff_json() - Generate the JSON merge patch between two objects
+ *
+ * @base:	Original object.
+ * @current:	Modified object.
+ *
+ * Applying the generated patch to @base with 'apply_merge_patch()' gives
+ * @current.
+ *
+ * Return: The patch, NULL if out of memory.
+ */
+static json_object *diff_json(json_object *base, json_object *current)
+{
+	json_object *patch = json_object_new_object();
+	struct json_object_iterator it, end;
+
+	if (patch == NULL)
+		return NULL;
+
+	/* Removed members */
+	it = json_object_iter_begin(base);
+	end = json_object_iter_end(base);
+	for (; !json_object_iter_equal(&it, &end); json_object_iter_next(&it)) {
+		const char *name = json_object_iter_peek_name(&it);
+
+		if (!json_object_object_get_ex(current, name, NULL)
+			&& json_object_object_add(patch, name, NULL) != 0)
+			goto error;
+	}
+
+	/* Added and modified members */
+	it = json_object_iter_begin(current);
+	end = json_object_iter_end(current);
+	for (; !json_object_iter_equal(&it, &end); json_object_iter_next(&it)) {
+		const char *name = json_object_iter_peek_name(&it);
+		json_object *value = json_object_iter_peek_value(&it);
+		json_object *old = NULL, *member;
+
+		if (json_object_object_get_ex(base, name, &old)
+			&& json_object_is_type(old, json_type_object)
+			&& json_object_is_type(value, json_type_object)) {
+			member = diff_json(old, value);
+			if (member == NULL)
+				goto error;
+			if (json_object_object_length(member) == 0) {
+				json_object_put(member);
+				continue;
+			}
+		} else if (json_object_object_get_ex(base, name, NULL) && json_object_equal(old, value)) {
+			continue;
+		} else {
+			member = copy_json(value);
+			if (member == NULL)
+				goto error;
+		}
+
+		if (json_object_object_add(patch, name, member) != 0) {
+			json_object_put(member);
+			goto error;
+		}
+	}
+
+	return patch;
+
+error:
+	json_object_put(patch);
+
+	return NULL;
+}
+
+/*
+ * find_namespace() - Find a namespace by its name
+ *
+ * @name:	Name of the namespace.
+ *
+ * Must be called with 'twin_lock' held.
+ *
+ * Return: The namespace, NULL if it does not exist.
+ */
+static twin_ns_t *find_namespace(const char *name)
+{
+	twin_ns_t *ns;
+
+	for (ns = namespaces; ns != NULL; ns = ns->next) {
+		if (strcmp(ns->name, name) == 0)
+			return ns;
+	}
+
+	return NULL;
+}
+
+/*
+ * free_namespace() - Free a namespace
+ *
+ * @ns:		Namespace to free.
+ */
+static void free_namespace(twin_ns_t *ns)
+{
+	if (ns == NULL)
+		return;
+
+	json_object_put(ns->desired);
+	json_object_put(ns->reported);
+	json_object_put(ns->synced);
+	free(ns);
+}
+
+/*
+ * new_namespace() - Create an empty namespace
+ *
+ * @name:	Name of the namespace.
+ *
+ * Return: The new namespace, NULL if out of memory.
+ */
+static twin_ns_t *new_namespace(const char *name)
+{
+	twin_ns_t *ns = calloc(1, sizeof(*ns));
+
+	if (ns == NULL)
+		return NULL;
+
+	strcpy(ns->name, name);
+	ns->desired = json_object_new_object();
+	ns->reported = json_object_new_object();
+	if (ns->desired == NULL || ns->reported == NULL) {
+		free_namespace(ns);
+		return NULL;
+	}
+
+	return ns;
+}
+
+/*
+ * get_namespace() - Get a namespace, creating it if it does not exist
+ *
+ * @name:	Name of the namespace.
+ * @ns:		Pointer to store the namespace.
+ *
+ * Must be called with 'twin_lock' held.
+ *
+ * Return: 0 on success, -ENOSPC if there are too many namespaces, -1 if out
+ *         of memory.
+ */
+static int get_namespace(const char *name, twin_ns_t **ns)
+{
+	*ns = find_namespace(name);
+	if (*ns != NULL)
+		return 0;
+
+	if (n_namespaces >= MAX_NAMESPACES)
+		return -ENOSPC;
+
+	*ns = new_namespace(name);
+	if (*ns == NULL)
+		return -1;
+
+	(*ns)->next = namespaces;
+	namespaces = *ns;
+	n_namespaces++;
+
+	return 0;
+}
+
+/*
+ * save_namespace() - Store a namespace to keep it after a restart
+ *
+ * @ns:		Namespace to store.
+ *
+ * Must be called with 'twin_lock' held.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int save_namespace(twin_ns_t *ns)
+{
+	char path[sizeof(TWIN_DIR) + MAX_NAMESPACE_LEN + sizeof(TWIN_EXT) + 1];
+	char tmp_path[sizeof(path) + sizeof(".tmp")];
+	json_object *doc = json_object_new_object();
+	const char *str;
+	int ret = -1;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%s%s", TWIN_DIR, ns->name, TWIN_EXT);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	if (doc == NULL
+		|| json_object_object_add(doc, KEY_DESIRED, json_object_get(ns->desired)) != 0
+		|| json_object_object_add(doc, KEY_DESIRED_VERSION, json_object_new_int64(ns->desired_version)) != 0
+		|| json_object_object_add(doc, KEY_REPORTED, json_object_get(ns->reported)) != 0
+		|| json_object_object_add(doc, KEY_REPORTED_VERSION, json_object_new_int64(ns->reported_version)) != 0
+		|| json_object_object_add(doc, KEY_SYNCED_VERSION, json_object_new_int64(ns->synced_version)) != 0) {
+		log_twin_error("Unable to save namespace '%s': %s", ns->name, "Out of memory");
+		goto done;
+	}
+
+	if (mkpath(TWIN_DIR, 0700) != 0 && errno != EEXIST) {
+		log_twin_error("Unable to create '%s': %s (%d)", TWIN_DIR, strerror(errno), errno);
+		goto done;
+	}
+
+	fp = fopen(tmp_path, "w");
+	if (fp == NULL) {
+		log_twin_error("Unable to create '%s': %s (%d)", tmp_path, strerror(errno), errno);
+		goto done;
+	}
+
+	str = json_object_to_json_string_ext(doc, JSON_C_TO_STRING_PLAIN);
+	if (fputs(str, fp) < 0 || fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		log_twin_error("Unable to write '%s': %s (%d)", tmp_path, strerror(errno), errno);
+		fclose(fp);
+		remove(tmp_path);
+		goto done;
+	}
+	fclose(fp);
+
+	if (rename(tmp_path, path) != 0) {
+		log_twin_error("Unable to save '%s': %s (%d)", path, strerror(errno), errno);
+		remove(tmp_path);
+		goto done;
+	}
+
+	ret = 0;
+
+done:
+	json_object_put(doc);
+
+	return ret;
+}
+
+/*
+ * get_version() - Get a version member of a stored namespace
+ *
+ * @doc:	Stored namespace.
+ * @key:	Name of the member.
+ *
+ * Return: The version, 0 if it does not exist or it is not valid.
+ */
+static uint32_t get_version(json_object *doc, const char *key)
+{
+	json_object *value;
+	int64_t version;
+
+	if (!json_object_object_get_ex(doc, key, &value) || !json_object_is_type(value, json_type_int))
+		return 0;
+
+	version = json_object_get_int64(value);
+
+	return version > 0 && version <= UINT32_MAX ? (uint32_t) version : 0;
+}
+
+/*
+ * load_namespace() - Load a namespace stored in a previous execution
+ *
+ * @name:	Name of the namespace.
+ * @path:	File where it is stored.
+ *
+ * Must be called with 'twin_lock' held.
+ */
+static void load_namespace(const char *name, const char *path)
+{
+	json_object *doc = json_object_from_file(path), *desired, *reported;
+	twin_ns_t *ns;
+
+	if (doc == NULL || !json_object_is_type(doc, json_type_object)
+		|| !json_object_object_get_ex(doc, KEY_DESIRED, &desired)
+		|| !json_object_is_type(desired, json_type_object)
+		|| !json_object_object_get_ex(doc, KEY_REPORTED, &reported)
+		|| !json_object_is_type(reported, json_type_object)) {
+		log_twin_error("Invalid namespace stored in '%s', discarding it", path);
+		goto done;
+	}
+
+	if (get_namespace(name, &ns) != 0)
+		goto done;
+
+	json_object_put(ns->desired);
+	json_object_put(ns->reported);
+	ns->desired = json_object_get(desired);
+	ns->reported = json_object_get(reported);
+	ns->desired_version = get_version(doc, KEY_DESIRED_VERSION);
+	ns->reported_version = get_version(doc, KEY_REPORTED_VERSION);
+	ns->synced_version = get_version(doc, KEY_SYNCED_VERSION);
+
+	log_twin_debug("Loaded namespace '%s' (desired version %" PRIu32 ", reported version %" PRIu32 ")",
+		name, ns->desired_version, ns->reported_version);
+
+done:
+	json_object_put(doc);
+}
+
+/*
+ * load_namespaces() - Load the namespaces stored in a previous execution
+ */
+static void load_namespaces(void)
+{
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir(TWIN_DIR);
+	if (dir == NULL)
+		return;
+
+	pthread_mutex_lock(&twin_lock);
+
+	while ((entry = readdir(dir)) != NULL) {
+		char name[MAX_NAMESPACE_LEN + 1];
+		char path[sizeof(TWIN_DIR) + MAX_NAMESPACE_LEN + sizeof(TWIN_EXT) + 1];
+		size_t len = strlen(entry->d_name);
+
+		if (len <= strlen(TWIN_EXT) || len - strlen(TWIN_EXT) > MAX_NAMESPACE_LEN
+			|| strcmp(entry->d_name + len - strlen(TWIN_EXT), TWIN_EXT) != 0)
+			continue;
+
+		snprintf(name, sizeof(name), "%.*s", (int) (len - strlen(TWIN_EXT)), entry->d_name);
+		if (!device_twin_valid_namespace(name))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s%s", TWIN_DIR, name, TWIN_EXT);
+		load_namespace(name, path);
+	}
+
+	pthread_mutex_unlock(&twin_lock);
+
+	closedir(dir);
+}
+
+int device_twin_get_desired(const char *name, uint32_t *version, char **desired)
+{
+	twin_ns_t *ns;
+	int ret = 0;
+
+	if (!device_twin_valid_namespace(name))
+		return -EINVAL;
+
+	pthread_mutex_lock(&twin_lock);
+
+	ns = find_namespace(name);
+	*version = ns != NULL ? ns->desired_version : 0;
+	*desired = strdup(ns != NULL ? json_object_to_json_string_ext(ns->desired, JSON_C_TO_STRING_PLAIN) : "{}");
+	if (*desired == NULL)
+		ret = -1;
+
+	pthread_mutex_unlock(&twin_lock);
+
+	return ret;
+}
+
+int device_twin_report(const char *name, const char *patch, size_t length, uint32_t *version)
+{
+	json_object *obj, *reported = NULL;
+	twin_ns_t *ns;
+	int ret;
+
+	if (!device_twin_valid_namespace(name) || patch == NULL)
+		return -EINVAL;
+
+	obj = json_tokener_parse(patch);
+	if (obj == NULL || !json_object_is_type(obj, json_type_object) || strlen(patch) != length) {
+		json_object_put(obj);
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&twin_lock);
+
+	ret = get_namespace(name, &ns);
+	if (ret != 0)
+		goto done;
+
+	reported = copy_json(ns->reported);
+	if (reported == NULL || apply_merge_patch(reported, obj) != 0) {
+		ret = -1;
+		goto done;
+	}
+
+	if (json_size(reported) > MAX_DOC_SIZE) {
+		ret = -ENOSPC;
+		goto done;
+	}
+
+	*version = ns->reported_version;
+	if (json_object_equal(reported, ns->reported))
+		goto done;
+
+	json_object_put(ns->reported);
+	ns->reported = reported;
+	reported = NULL;
+	if (++ns->reported_version == 0)
+		ns->reported_version = 1;
+	*version = ns->reported_version;
+
+	save_namespace(ns);
+	pthread_cond_broadcast(&twin_cond);
+
+	log_twin_debug("Namespace '%s' reported version %" PRIu32, name, ns->reported_version);
+
+done:
+	pthread_mutex_unlock(&twin_lock);
+
+	json_object_put(reported);
+	json_object_put(obj);
+
+	return ret;
+}
+
+/*
+ * build_sync_payload() - Generate the data point to sync a reported state
+ *
+ * @ns:		Namespace to sync.
+ *
+ * The payload is '{"version": <n>, "base": <m>, "delta": <patch>}' with the
+ * JSON merge patch from the last synced version, or
+ * '{"version": <n>, "state": <reported>}' with the whole state if there is
+ * no synced version in this execution or the delta is not smaller.
+ *
+ * Must be called with 'twin_lock' held.
+ *
+ * Return: The payload, NULL if out of memory.
+ */
+static char *build_sync_payload(twin_ns_t *ns)
+{
+	json_object *payload = json_object_new_object(), *delta = NULL;
+	char *str = NULL;
+	int error;
+
+	if (payload == NULL)
+		return NULL;
+
+	if (ns->synced != NULL)
+		delta = diff_json(ns->synced, ns->reported);
+
+	error = json_object_object_add(payload, "version", json_object_new_int64(ns->reported_version));
+	if (!error && delta != NULL && json_size(delta) < json_size(ns->reported)) {
+		error = json_object_object_add(payload, "base", json_object_new_int64(ns->synced_version))
+			|| json_object_object_add(payload, "delta", delta);
+		delta = NULL;
+	} else if (!error) {
+		error = json_object_object_add(payload, "state", json_object_get(ns->reported));
+	}
+
+	if (!error)
+		str = strdup(json_object_to_json_string_ext(payload, JSON_C_TO_STRING_PLAIN));
+
+	json_object_put(delta);
+	json_object_put(payload);
+
+	return str;
+}
+
+/*
+ * sync_reported() - Sync to Remote Manager the reported states that changed
+ *
+ * Return: 0 if everything is synced, -1 if any sync failed.
+ */
+static int sync_reported(void)
+{
+	twin_ns_t *ns;
+	int ret = 0;
+
+	pthread_mutex_lock(&twin_lock);
+
+	for (ns = namespaces; ns != NULL && !stop_requested; ns = ns->next) {
+		char stream[sizeof(DP_TWIN_STREAM_PREFIX) + MAX_NAMESPACE_LEN + sizeof(DP_TWIN_STREAM_SUFFIX)];
+		json_object *reported;
+		uint32_t version;
+		char *payload;
+		int error;
+
+		if (ns->reported_version == ns->synced_version)
+			continue;
+
+		payload = build_sync_payload(ns);
+		if (payload == NULL) {
+			log_twin_error("Unable to sync namespace '%s': %s", ns->name, "Out of memory");
+			ret = -1;
+			continue;
+		}
+		/* Reported objects are replaced, never modified */
+		reported = json_object_get(ns->reported);
+		version = ns->reported_version;
+		snprintf(stream, sizeof(stream), "%s%s%s", DP_TWIN_STREAM_PREFIX, ns->name, DP_TWIN_STREAM_SUFFIX);
+
+		/* Namespaces are never removed, it is safe to keep the pointer */
+		pthread_mutex_unlock(&twin_lock);
+		log_twin_debug("Syncing namespace '%s': %s", ns->name, payload);
+		error = dp_send_json_event(stream, payload);
+		free(payload);
+		pthread_mutex_lock(&twin_lock);
+
+		if (error) {
+			ret = -1;
+		} else {
+			json_object_put(ns->synced);
+			ns->synced = json_object_get(reported);
+			ns->synced_version = version;
+			save_namespace(ns);
+		}
+		json_object_put(reported);
+	}
+
+	pthread_mutex_unlock(&twin_lock);
+
+	return ret;
+}
+
+/*
+ * needs_sync() - Check if any reported state is pending to sync
+ *
+ * Must be called with 'twin_lock' held.
+ *
+ * Return: True if there is a reported state to sync, false otherwise.
+ */
+static bool needs_sync(void)
+{
+	twin_ns_t *ns;
+
+	for (ns = namespaces; ns != NULL; ns = ns->next) {
+		if (ns->reported_version != ns->synced_version)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * wait_for() - Wait until the given time passes or the store is stopped
+ *
+ * @sec:	Number of seconds to wait.
+ * @pending:	True to wait only until a reported state changes.
+ */
+static void wait_for(unsigned int sec, bool pending)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += sec;
+
+	pthread_mutex_lock(&twin_lock);
+	while (!stop_requested && (!pending || !needs_sync())
+		&& pthread_cond_timedwait(&twin_cond, &twin_lock, &ts) != ETIMEDOUT)
+		;
+	pthread_mutex_unlock(&twin_lock);
+}
+
+/*
+ * device_twin_threaded() - Sync the reported states in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *device_twin_threaded(void *unused)
+{
+	UNUSED_ARGUMENT(unused);
+
+	while (!stop_requested) {
+		bool pending;
+
+		pthread_mutex_lock(&twin_lock);
+		pending = needs_sync();
+		pthread_mutex_unlock(&twin_lock);
+
+		if (!pending) {
+			wait_for(SYNC_RETRY_SEC, true);
+			continue;
+		}
+
+		/* Gather reports that come together in a single sync */
+		wait_for(SYNC_DELAY_SEC, false);
+		if (stop_requested)
+			break;
+
+		if (get_cloud_connection_status() != CC_STATUS_CONNECTED || sync_reported() != 0)
+			wait_for(SYNC_RETRY_SEC, false);
+	}
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+int start_device_twin(const cc_cfg_t *const cc_cfg)
+{
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (twin_thread_valid)
+		return 0;
+
+	if (!loaded) {
+		load_namespaces();
+		loaded = true;
+	}
+
+	stop_requested = false;
+	twin_thread_valid = (pthread_create(&twin_thread, NULL, device_twin_threaded, NULL) == 0);
+	if (!twin_thread_valid) {
+		log_twin_error("%s", "Unable to start device twin thread");
+		return 1;
+	}
+
+	return 0;
+}
+
+void stop_device_twin(void)
+{
+	pthread_mutex_lock(&twin_lock);
+	stop_requested = true;
+	pthread_cond_broadcast(&twin_cond);
+	pthread_mutex_unlock(&twin_lock);
+
+	if (twin_thread_valid) {
+		twin_thread_valid = false;
+		pthread_join(twin_thread, NULL);
+	}
+}
+
+/*
+ * add_namespace_json() - Add the state of a namespace to a JSON object
+ *
+ * @obj:	Object to fill.
+ * @ns:		Namespace.
+ * @documents:	True to add the desired and reported states, false to add
+ *		only their versions.
+ *
+ * Must be called with 'twin_lock' held.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_namespace_json(json_object *obj, twin_ns_t *ns, bool documents)
+{
+	if (json_object_object_add(obj, "namespace", json_object_new_string(ns->name)) != 0
+		|| json_object_object_add(obj, KEY_DESIRED_VERSION, json_object_new_int64(ns->desired_version)) != 0
+		|| json_object_object_add(obj, KEY_REPORTED_VERSION, json_object_new_int64(ns->reported_version)) != 0)
+		return -1;
+
+	if (documents
+		&& (json_object_object_add(obj, KEY_DESIRED, copy_json(ns->desired)) != 0
+		|| json_object_object_add(obj, KEY_REPORTED, copy_json(ns->reported)) != 0))
+		return -1;
+
+	return 0;
+}
+
+/*
+ * update_desired() - Replace or patch the desired state of a namespace
+ *
+ * @name:	Name of the namespace.
+ * @doc:	New desired state or patch to apply.
+ * @patch:	True if @doc is a JSON merge patch, false to replace the state.
+ * @expected:	Current version expected by the request, 0 for any.
+ * @resp:	Response to fill.
+ * @error:	Pointer to store the error description.
+ *
+ * Return: 0 if the desired state changed, 1 if it did not change, -1 on error.
+ */
+static int update_desired(const char *name, json_object *doc, bool patch, uint32_t expected,
+	json_object *resp, const char **error)
+{
+	json_object *desired = NULL;
+	twin_ns_t *ns;
+	int ret = -1;
+
+	pthread_mutex_lock(&twin_lock);
+
+	switch (get_namespace(name, &ns)) {
+		case 0:
+			break;
+		case -ENOSPC:
+			*error = "Too many namespaces";
+			goto done;
+		default:
+			*error = "Out of memory";
+			goto done;
+	}
+
+	if (expected != 0 && expected != ns->desired_version) {
+		*error = "Version conflict";
+		add_namespace_json(resp, ns, false);
+		goto done;
+	}
+
+	desired = patch ? copy_json(ns->desired) : copy_json(doc);
+	if (desired == NULL || (patch && apply_merge_patch(desired, doc) != 0)) {
+		*error = "Out of memory";
+		goto done;
+	}
+
+	if (json_size(desired) > MAX_DOC_SIZE) {
+		*error = "Document too big";
+		goto done;
+	}
+
+	ret = 1;
+	if (!json_object_equal(desired, ns->desired)) {
+		json_object_put(ns->desired);
+		ns->desired = desired;
+		desired = NULL;
+		if (++ns->desired_version == 0)
+			ns->desired_version = 1;
+		save_namespace(ns);
+		ret = 0;
+
+		log_twin_info("Namespace '%s' desired version %" PRIu32, name, ns->desired_version);
+	}
+
+	if (add_namespace_json(resp, ns, false) != 0) {
+		*error = "Out of memory";
+		ret = ret == 0 ? 0 : -1;
+	}
+
+done:
+	pthread_mutex_unlock(&twin_lock);
+
+	json_object_put(desired);
+
+	return ret;
+}
+
+/*
+ * process_twin_request() - Process a device twin request
+ *
+ * @req:	Request object.
+ * @resp:	Response to fill.
+ *
+ * Return: NULL on success, the error description otherwise.
+ */
+static const char *process_twin_request(json_object *req, json_object *resp)
+{
+	json_object *op_obj, *ns_obj, *doc, *version_obj;
+	const char *op, *name = NULL, *error = NULL;
+	uint32_t expected = 0;
+	twin_ns_t *ns;
+	bool patch;
+
+	if (!json_object_object_get_ex(req, "op", &op_obj) || !json_object_is_type(op_obj, json_type_string))
+		return "Missing operation";
+	op = json_object_get_string(op_obj);
+
+	if (strcmp(op, "list") == 0) {
+		json_object *list = json_object_new_array();
+
+		if (list == NULL || json_object_object_add(resp, "namespaces", list) != 0) {
+			json_object_put(list);
+			return "Out of memory";
+		}
+
+		pthread_mutex_lock(&twin_lock);
+		for (ns = namespaces; ns != NULL && error == NULL; ns = ns->next) {
+			json_object *item = json_object_new_object();
+
+			if (item == NULL || json_object_array_add(list, item) != 0) {
+				json_object_put(item);
+				error = "Out of memory";
+			} else if (add_namespace_json(item, ns, false) != 0) {
+				error = "Out of memory";
+			}
+		}
+		pthread_mutex_unlock(&twin_lock);
+
+		return error;
+	}
+
+	if (json_object_object_get_ex(req, "namespace", &ns_obj) && json_object_is_type(ns_obj, json_type_string))
+		name = json_object_get_string(ns_obj);
+	if (!device_twin_valid_namespace(name))
+		return "Invalid namespace";
+
+	if (strcmp(op, "get") == 0) {
+		pthread_mutex_lock(&twin_lock);
+		ns = find_namespace(name);
+		if (ns == NULL)
+			error = "Unknown namespace";
+		else if (add_namespace_json(resp, ns, true) != 0)
+			error = "Out of memory";
+		pthread_mutex_unlock(&twin_lock);
+
+		return error;
+	}
+
+	if (strcmp(op, "set") == 0)
+		patch = false;
+	else if (strcmp(op, "patch") == 0)
+		patch = true;
+	else
+		return "Unknown operation";
+
+	if (!json_object_object_get_ex(req, patch ? "patch" : KEY_DESIRED, &doc)
+		|| !json_object_is_type(doc, json_type_object))
+		return patch ? "Missing patch object" : "Missing desired object";
+
+	if (json_object_object_get_ex(req, "version", &version_obj)) {
+		int64_t v = json_object_get_int64(version_obj);
+
+		if (!json_object_is_type(version_obj, json_type_int) || v < 0 || v > UINT32_MAX)
+			return "Invalid version";
+		expected = (uint32_t) v;
+	}
+
+	if (update_desired(name, doc, patch, expected, resp, &error) == 0)
+		twin_service_notify(name);
+
+	return error;
+}
+
+ccapi_receive_error_t device_twin_request_cb(const char *const target,
+	const ccapi_transport_t transport,
+	const ccapi_buffer_info_t *const request_buffer_info,
+	ccapi_buffer_info_t *const response_buffer_info)
+{
+	json_object *req = NULL, *resp = json_object_new_object();
+	ccapi_receive_error_t ret = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	const char *error = NULL;
+
+	log_twin_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	response_buffer_info->buffer = NULL;
+	response_buffer_info->length = 0;
+
+	if (resp == NULL)
+		goto done;
+
+	if (request_buffer_info == NULL || request_buffer_info->buffer == NULL
+		|| request_buffer_info->length == 0) {
+		error = "Empty request";
+	} else {
+		char *str = strndup(request_buffer_info->buffer, request_buffer_info->length);
+
+		req = str != NULL ? json_tokener_parse(str) : NULL;
+		free(str);
+		if (req == NULL || !json_object_is_type(req, json_type_object))
+			error = "Invalid JSON request";
+		else
+			error = process_twin_request(req, resp);
+	}
+
+	if (json_object_object_add(resp, "status", json_object_new_string(error == NULL ? "ok" : "error")) != 0
+		|| (error != NULL && json_object_object_add(resp, "error", json_object_new_string(error)) != 0))
+		goto done;
+
+	if (error != NULL)
+		log_twin_error("Device twin request failed: %s", error);
+
+	response_buffer_info->buffer = strdup(json_object_to_json_string_ext(resp, JSON_C_TO_STRING_PLAIN));
+	if (response_buffer_info->buffer != NULL) {
+		response_buffer_info->length = strlen(response_buffer_info->buffer);
+		ret = CCAPI_RECEIVE_ERROR_NONE;
+	}
+
+done:
+	if (ret != CCAPI_RECEIVE_ERROR_NONE)
+		log_twin_error("Cannot generate response for target '%s': Out of memory", target);
+
+	json_object_put(req);
+	json_object_put(resp);
+
+	return ret;
+}
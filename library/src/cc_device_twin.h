@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_DEVICE_TWIN_H_
+#define CC_DEVICE_TWIN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ccapi/ccapi.h"
+#include "cc_config.h"
+
+/*
+ * start_device_twin() - Start the device twin store
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * Loads the documents stored in a previous execution and starts syncing the
+ * reported state of every namespace to Remote Manager.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int start_device_twin(const cc_cfg_t *const cc_cfg);
+
+/*
+ * stop_device_twin() - Stop the device twin store
+ *
+ * Documents are kept and loaded on next start.
+ */
+void stop_device_twin(void);
+
+/*
+ * device_twin_request_cb() - Handle a device twin request from Remote Manager
+ *
+ * @target:		Target of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @request_buffer_info:	JSON request.
+ * @response_buffer_info:	JSON response, it must be freed.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if the response is set, any other error
+ *         otherwise.
+ */
+ccapi_receive_error_t device_twin_request_cb(const char *const target,
+	const ccapi_transport_t transport,
+	const ccapi_buffer_info_t *const request_buffer_info,
+	ccapi_buffer_info_t *const response_buffer_info);
+
+/*
+ * device_twin_get_desired() - Get the desired state of a namespace
+ *
+ * @ns:		Namespace of the application.
+ * @version:	Version of the desired state, 0 if it was never set.
+ * @desired:	Desired state as a JSON object, it must be freed.
+ *
+ * Return: 0 on success, -EINVAL if the namespace is not valid, -1 otherwise.
+ */
+int device_twin_get_desired(const char *ns, uint32_t *version, char **desired);
+
+/*
+ * device_twin_report() - Update the reported state of a namespace
+ *
+ * @ns:		Namespace of the application.
+ * @patch:	JSON merge patch (RFC 7396) to apply to the reported state.
+ * @length:	Number of bytes of the patch.
+ * @version:	New version of the reported state.
+ *
+ * The reported state is stored and synced to Remote Manager in the
+ * background, as a delta from the last synced one.
+ *
+ * Return: 0 on success, -EINVAL if the namespace or the patch are not valid,
+ *         -ENOSPC if the document or the number of namespaces exceed their
+ *         limit, -1 otherwise.
+ */
+int device_twin_report(const char *ns, const char *patch, size_t length, uint32_t *version);
+
+/*
+ * device_twin_valid_namespace() - Check if a namespace name is valid
+ *
+ * @ns:		Namespace to check.
+ *
+ * Return: True if it has 1 to 64 letters, digits, '-', '_' or '.' and does
+ *         not start with '.', false otherwise.
+ */
+bool device_twin_valid_namespace(const char *ns);
+
+#endif /* CC_DEVICE_TWIN_H_ */
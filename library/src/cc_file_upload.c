@@ -0,0 +1,727 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccapi/ccapi_transport.h"
+#include "ccapi/ccapi_send.h"
+
+#include "cc_error_msg.h"
+#include "cc_file_upload.h"
+#include "cc_init.h"
+#include "cc_logging.h"
+#include "cc_mem_budget.h"
+#include "_utils.h"
+
+#define FILE_UPLOAD_TAG			"UPLOAD:"
+
+#define FILE_UPLOAD_QUEUE_FILE		"/etc/cccs.uploads"
+
+#define MAX_QUEUED_UPLOADS		64
+#define MAX_FINISHED_UPLOADS		16
+#define MAX_CLOUD_PATH_LEN		255
+
+#define CHUNK_SIZE			(64 * 1024)
+#define CONTENT_TYPE			"application/octet-stream"
+/* Seconds to wait for Remote Manager to store a chunk */
+#define SEND_TIMEOUT			60
+
+/* Pause between chunks to leave the connection to other transfers */
+#define CHUNK_PAUSE_MS			100
+/* Nice value of the upload thread */
+#define UPLOAD_NICE			10
+
+#define IDLE_WAIT_SEC			5
+#define RETRY_MIN_SEC			5
+#define RETRY_MAX_SEC			300
+/* Consecutive failures of a chunk before giving up the upload */
+#define MAX_RETRIES			20
+
+#define KEY_NEXT_ID			"next_id"
+#define KEY_UPLOAD			"upload"
+
+/**
+ * log_fu_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_fu_debug(format, ...)					\
+	log_debug("%s " format, FILE_UPLOAD_TAG, __VA_ARGS__)
+
+/**
+ * log_fu_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_fu_info(format, ...)					\
+	log_info("%s " format, FILE_UPLOAD_TAG, __VA_ARGS__)
+
+/**
+ * log_fu_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_fu_error(format, ...)					\
+	log_error("%s " format, FILE_UPLOAD_TAG, __VA_ARGS__)
+
+/*
+ * struct file_upload_t - Queued file upload
+ *
+ * @id:		Identifier of the upload
+ * @local_path:	Absolute path of the file to upload
+ * @cloud_path:	Destination path in the device cloud storage
+ * @offset:	Number of bytes already stored in the cloud
+ * @size:	Size of the file when the upload started
+ * @mtime:	Modification time of the file when the upload started
+ * @retries:	Consecutive failures uploading the current chunk
+ * @next:	Next queued upload
+ */
+typedef struct file_upload {
+	uint32_t id;
+	char *local_path;
+	char *cloud_path;
+	uint64_t offset;
+	uint64_t size;
+	int64_t mtime;
+	unsigned int retries;
+	struct file_upload *next;
+} file_upload_t;
+
+/*
+ * Result of uploading a chunk.
+ */
+typedef enum {
+	CHUNK_SENT,
+	CHUNK_RETRY,
+	CHUNK_RESTART,
+	CHUNK_FAILED,
+} chunk_result_t;
+
+static volatile bool stop_requested = false;
+static volatile bool fu_thread_valid = false;
+static pthread_t fu_thread;
+
+static pthread_mutex_t upload_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t upload_cond = PTHREAD_COND_INITIALIZER;
+/* The first upload of the queue is the one in progress */
+static file_upload_t *queue = NULL;
+static unsigned int n_queued = 0;
+static uint32_t next_id = 1;
+/* Latest finished uploads, to report their result */
+static struct {
+	uint32_t id;
+	file_upload_status_t status;
+} finished[MAX_FINISHED_UPLOADS];
+static unsigned int finished_pos = 0;
+
+/*
+ * free_upload() - Free a queued upload
+ *
+ * @u:		Upload to free.
+ */
+static void free_upload(file_upload_t *u)
+{
+	if (u == NULL)
+		return;
+
+	free(u->local_path);
+	free(u->cloud_path);
+	free(u);
+}
+
+/*
+ * new_upload() - Create a queued upload
+ *
+ * @id:		Identifier of the upload.
+ * @local_path:	Absolute path of the file to upload.
+ * @cloud_path:	Destination path in the device cloud storage.
+ *
+ * Return: The new upload, NULL if there is no memory.
+ */
+static file_upload_t *new_upload(uint32_t id, const char *local_path, const char *cloud_path)
+{
+	file_upload_t *u = calloc(1, sizeof(*u));
+
+	if (u == NULL)
+		return NULL;
+
+	u->id = id;
+	u->local_path = strdup(local_path);
+	u->cloud_path = strdup(cloud_path);
+	if (u->local_path == NULL || u->cloud_path == NULL) {
+		free_upload(u);
+		return NULL;
+	}
+
+	return u;
+}
+
+/*
+ * append_upload() - Add an upload at the end of the queue
+ *
+ * @u:		Upload to add.
+ *
+ * Must be called with 'upload_lock' held.
+ */
+static void append_upload(file_upload_t *u)
+{
+	file_upload_t **p = &queue;
+
+	while (*p != NULL)
+		p = &(*p)->next;
+	*p = u;
+	n_queued++;
+}
+
+/*
+ * save_queue() - Store the queued uploads to resume them after a restart
+ *
+ * Must be called with 'upload_lock' held.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int save_queue(void)
+{
+	const char *tmp_file = FILE_UPLOAD_QUEUE_FILE ".tmp";
+	file_upload_t *u;
+	FILE *fp;
+
+	fp = fopen(tmp_file, "w");
+	if (fp == NULL) {
+		log_fu_error("Unable to create '%s': %s (%d)", tmp_file,
+			strerror(errno), errno);
+		return -1;
+	}
+
+	/* Keep the identifiers unique across restarts */
+	fprintf(fp, KEY_NEXT_ID "=%" PRIu32 "\n", next_id);
+	for (u = queue; u != NULL; u = u->next)
+		fprintf(fp, KEY_UPLOAD "=%" PRIu32 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRId64 "\t%s\t%s\n",
+			u->id, u->offset, u->size, u->mtime, u->local_path, u->cloud_path);
+
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		log_fu_error("Unable to write '%s': %s (%d)", tmp_file,
+			strerror(errno), errno);
+		fclose(fp);
+		remove(tmp_file);
+		return -1;
+	}
+	fclose(fp);
+
+	if (rename(tmp_file, FILE_UPLOAD_QUEUE_FILE) != 0) {
+		log_fu_error("Unable to save '%s': %s (%d)", FILE_UPLOAD_QUEUE_FILE,
+			strerror(errno), errno);
+		remove(tmp_file);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * parse_upload() - Parse a stored upload
+ *
+ * @value:	Stored upload: id, offset, size, modification time, local path
+ * 		and cloud path separated by tabs.
+ *
+ * Return: The parsed upload, NULL if it is not valid.
+ */
+static file_upload_t *parse_upload(char *value)
+{
+	char *fields[6], *saveptr = NULL, *field;
+	file_upload_t *u;
+	int n = 0;
+
+	for (field = strtok_r(value, "\t", &saveptr); field != NULL && n < 6;
+		field = strtok_r(NULL, "\t", &saveptr))
+		fields[n++] = field;
+
+	if (n != 6)
+		return NULL;
+
+	u = new_upload(strtoul(fields[0], NULL, 10), fields[4], fields[5]);
+	if (u == NULL)
+		return NULL;
+
+	u->offset = strtoull(fields[1], NULL, 10);
+	u->size = strtoull(fields[2], NULL, 10);
+	u->mtime = strtoll(fields[3], NULL, 10);
+
+	return u;
+}
+
+/*
+ * load_queue() - Load the uploads queued in a previous execution
+ */
+static void load_queue(void)
+{
+	char *line = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	fp = fopen(FILE_UPLOAD_QUEUE_FILE, "r");
+	if (fp == NULL)
+		return;
+
+	pthread_mutex_lock(&upload_lock);
+
+	while (getline(&line, &len, fp) != -1) {
+		char *value = strchr(line, '=');
+
+		if (value == NULL)
+			continue;
+		*value++ = '\0';
+		value[strcspn(value, "\n")] = '\0';
+
+		if (strcmp(line, KEY_NEXT_ID) == 0) {
+			next_id = strtoul(value, NULL, 10);
+		} else if (strcmp(line, KEY_UPLOAD) == 0 && n_queued < MAX_QUEUED_UPLOADS) {
+			file_upload_t *u = parse_upload(value);
+
+			if (u == NULL || u->offset > u->size) {
+				log_fu_error("Invalid queued upload in '%s', discarding it",
+					FILE_UPLOAD_QUEUE_FILE);
+				free_upload(u);
+				continue;
+			}
+			append_upload(u);
+			log_fu_info("Resuming upload %" PRIu32 " of '%s' at %" PRIu64 " of %" PRIu64 " bytes",
+				u->id, u->local_path, u->offset, u->size);
+		}
+	}
+	if (next_id == 0)
+		next_id = 1;
+
+	pthread_mutex_unlock(&upload_lock);
+
+	free(line);
+	fclose(fp);
+}
+
+/*
+ * finish_upload() - Remove the upload in progress from the queue
+ *
+ * @state:	FILE_UPLOAD_DONE or FILE_UPLOAD_FAILED.
+ *
+ * Must be called with 'upload_lock' held.
+ */
+static void finish_upload(file_upload_state_t state)
+{
+	file_upload_t *u = queue;
+
+	finished[finished_pos].id = u->id;
+	finished[finished_pos].status.state = state;
+	finished[finished_pos].status.sent = u->offset;
+	finished[finished_pos].status.size = u->size;
+	finished_pos = (finished_pos + 1) % MAX_FINISHED_UPLOADS;
+
+	if (state == FILE_UPLOAD_DONE)
+		log_fu_info("Uploaded '%s' to '%s' (%" PRIu64 " bytes)",
+			u->local_path, u->cloud_path, u->size);
+	else
+		log_fu_error("Unable to upload '%s' to '%s', discarding it",
+			u->local_path, u->cloud_path);
+
+	queue = u->next;
+	n_queued--;
+	free_upload(u);
+
+	save_queue();
+}
+
+/*
+ * classify_send_error() - Decide how to go on after a chunk failed
+ *
+ * @error:	Error sending the chunk.
+ * @offset:	Offset of the chunk.
+ *
+ * Return: CHUNK_RETRY if the chunk was not stored and can be sent again,
+ *         CHUNK_RESTART if it may have been appended, CHUNK_FAILED if the
+ *         upload cannot succeed.
+ */
+static chunk_result_t classify_send_error(ccapi_send_error_t error, uint64_t offset)
+{
+	switch (error) {
+		/* Nothing was sent */
+		case CCAPI_SEND_ERROR_CCAPI_NOT_RUNNING:
+		case CCAPI_SEND_ERROR_TRANSPORT_NOT_STARTED:
+		case CCAPI_SEND_ERROR_INSUFFICIENT_MEMORY:
+		case CCAPI_SEND_ERROR_LOCK_FAILED:
+		case CCAPI_SEND_ERROR_INITIATE_ACTION_FAILED:
+			return CHUNK_RETRY;
+		/* The connection dropped, the chunk may be stored or not */
+		case CCAPI_SEND_ERROR_STATUS_CANCEL:
+		case CCAPI_SEND_ERROR_STATUS_TIMEOUT:
+		case CCAPI_SEND_ERROR_STATUS_SESSION_ERROR:
+		case CCAPI_SEND_ERROR_RESPONSE_UNAVAILABLE:
+			/* Overwriting the first chunk is safe, appending again is not */
+			return offset == 0 ? CHUNK_RETRY : CHUNK_RESTART;
+		default:
+			return CHUNK_FAILED;
+	}
+}
+
+/*
+ * upload_chunk() - Upload the next chunk of a file
+ *
+ * @u:		Upload in progress.
+ *
+ * The first chunk overwrites the cloud file and the next ones are appended
+ * to it. The upload offset is stored after every chunk, so a restart
+ * resumes from the last stored one.
+ *
+ * Return: The result of the chunk upload.
+ */
+static chunk_result_t upload_chunk(file_upload_t *u)
+{
+	ccapi_send_error_t error;
+	chunk_result_t ret;
+	struct stat st;
+	uint64_t offset;
+	char *chunk = NULL;
+	ssize_t len;
+	size_t n;
+	int fd;
+
+	fd = open(u->local_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		log_fu_error("Unable to read '%s': %s (%d)", u->local_path,
+			strerror(errno), errno);
+		ret = CHUNK_FAILED;
+		goto done;
+	}
+
+	pthread_mutex_lock(&upload_lock);
+	if ((uint64_t) st.st_size != u->size || (int64_t) st.st_mtime != u->mtime) {
+		if (u->offset > 0)
+			log_fu_info("File '%s' changed, starting its upload over", u->local_path);
+		u->size = st.st_size;
+		u->mtime = st.st_mtime;
+		u->offset = 0;
+		save_queue();
+	}
+	offset = u->offset;
+	pthread_mutex_unlock(&upload_lock);
+
+	if (u->size == 0) {
+		log_fu_error("File '%s' is empty", u->local_path);
+		ret = CHUNK_FAILED;
+		goto done;
+	}
+
+	n = u->size - offset > CHUNK_SIZE ? CHUNK_SIZE : (size_t) (u->size - offset);
+
+	if (mem_budget_reserve(MEM_SS_UPLOAD, n) != 0) {
+		ret = CHUNK_RETRY;
+		goto done;
+	}
+
+	chunk = malloc(n);
+	if (chunk == NULL) {
+		log_fu_error("Unable to upload '%s': %s", u->local_path, "Out of memory");
+		ret = CHUNK_RETRY;
+		goto release;
+	}
+
+	len = pread(fd, chunk, n, (off_t) offset);
+	if (len < 0 || (size_t) len != n) {
+		log_fu_error("Unable to read '%s': %s (%d)", u->local_path,
+			len < 0 ? strerror(errno) : "File truncated", len < 0 ? errno : 0);
+		ret = CHUNK_RESTART;
+		goto release;
+	}
+
+	error = ccapi_send_data_with_reply(CCAPI_TRANSPORT_TCP, u->cloud_path,
+		CONTENT_TYPE, chunk, n,
+		offset == 0 ? CCAPI_SEND_BEHAVIOR_OVERWRITE : CCAPI_SEND_BEHAVIOR_APPEND,
+		SEND_TIMEOUT, NULL);
+	if (error != CCAPI_SEND_ERROR_NONE) {
+		log_fu_error("Unable to upload chunk at %" PRIu64 " of '%s': %s (%d)",
+			offset, u->local_path, to_send_error_msg(error), error);
+		ret = classify_send_error(error, offset);
+		goto release;
+	}
+
+	log_fu_debug("Uploaded %" PRIu64 " of %" PRIu64 " bytes of '%s'",
+		offset + n, u->size, u->local_path);
+
+	/*
+	 * A restart between the chunk is stored and the new offset is saved
+	 * would append the chunk twice, but that window is much shorter than
+	 * the upload itself.
+	 */
+	pthread_mutex_lock(&upload_lock);
+	u->offset = offset + n;
+	u->retries = 0;
+	if (u->offset < u->size)
+		save_queue();
+	pthread_mutex_unlock(&upload_lock);
+
+	ret = CHUNK_SENT;
+
+release:
+	free(chunk);
+	mem_budget_release(MEM_SS_UPLOAD, n);
+done:
+	if (fd >= 0)
+		close(fd);
+
+	return ret;
+}
+
+/*
+ * wait_for() - Wait until the given time passes or the manager is stopped
+ *
+ * @ms:		Number of milliseconds to wait.
+ */
+static void wait_for(unsigned long ms)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (ms % 1000) * 1000 * 1000;
+	if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000 * 1000 * 1000;
+	}
+
+	pthread_mutex_lock(&upload_lock);
+	while (!stop_requested
+		&& pthread_cond_timedwait(&upload_cond, &upload_lock, &ts) != ETIMEDOUT)
+		;
+	pthread_mutex_unlock(&upload_lock);
+}
+
+/*
+ * file_upload_loop() - Upload the queued files one chunk at a time
+ */
+static void file_upload_loop(void)
+{
+	while (!stop_requested) {
+		unsigned long delay = CHUNK_PAUSE_MS;
+		chunk_result_t ret;
+		file_upload_t *u;
+
+		pthread_mutex_lock(&upload_lock);
+		u = queue;
+		pthread_mutex_unlock(&upload_lock);
+
+		if (u == NULL) {
+			wait_for(IDLE_WAIT_SEC * 1000);
+			continue;
+		}
+
+		/* Do not compete with other transfers for scarce resources */
+		if (get_cloud_connection_status() != CC_STATUS_CONNECTED
+			|| mem_budget_get_pressure() >= MEM_PRESSURE_REJECT) {
+			wait_for(RETRY_MIN_SEC * 1000);
+			continue;
+		}
+
+		ret = upload_chunk(u);
+
+		pthread_mutex_lock(&upload_lock);
+		switch (ret) {
+			case CHUNK_SENT:
+				if (u->offset == u->size)
+					finish_upload(FILE_UPLOAD_DONE);
+				break;
+			case CHUNK_RESTART:
+				u->offset = 0;
+				save_queue();
+				/* fall through */
+			case CHUNK_RETRY:
+				if (++u->retries > MAX_RETRIES) {
+					finish_upload(FILE_UPLOAD_FAILED);
+					break;
+				}
+				delay = RETRY_MIN_SEC * 1000UL << (u->retries < 6 ? u->retries - 1 : 5);
+				if (delay > RETRY_MAX_SEC * 1000UL)
+					delay = RETRY_MAX_SEC * 1000UL;
+				break;
+			case CHUNK_FAILED:
+				finish_upload(FILE_UPLOAD_FAILED);
+				break;
+		}
+		pthread_mutex_unlock(&upload_lock);
+
+		wait_for(delay);
+	}
+}
+
+/*
+ * file_upload_threaded() - Upload the queued files in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *file_upload_threaded(void *unused)
+{
+	pid_t tid = syscall(SYS_gettid);
+
+	UNUSED_ARGUMENT(unused);
+
+	/* Uploads are background transfers, on Linux this only affects this thread */
+	if (setpriority(PRIO_PROCESS, tid, UPLOAD_NICE) != 0)
+		log_fu_debug("Unable to lower the upload priority: %s (%d)",
+			strerror(errno), errno);
+
+	file_upload_loop();
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+int start_file_uploads(const cc_cfg_t *const cc_cfg)
+{
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (fu_thread_valid)
+		return 0;
+
+	if (queue == NULL)
+		load_queue();
+
+	stop_requested = false;
+	fu_thread_valid = (pthread_create(&fu_thread, NULL, file_upload_threaded, NULL) == 0);
+	if (!fu_thread_valid) {
+		log_fu_error("%s", "Unable to start file upload thread");
+		return 1;
+	}
+
+	return 0;
+}
+
+void stop_file_uploads(void)
+{
+	pthread_mutex_lock(&upload_lock);
+	stop_requested = true;
+	pthread_cond_broadcast(&upload_cond);
+	pthread_mutex_unlock(&upload_lock);
+
+	/* Do not cancel the thread, let it save the uploaded chunk */
+	if (fu_thread_valid) {
+		fu_thread_valid = false;
+		pthread_join(fu_thread, NULL);
+	}
+}
+
+int queue_file_upload(const char *local_path, const char *cloud_path, uint32_t *id)
+{
+	file_upload_t *u;
+	struct stat st;
+	int ret = 0;
+
+	if (local_path == NULL || local_path[0] != '/' || cloud_path == NULL
+		|| cloud_path[0] == '\0' || strlen(cloud_path) > MAX_CLOUD_PATH_LEN
+		|| strpbrk(local_path, "\t\n") != NULL || strpbrk(cloud_path, "\t\n") != NULL)
+		return -EINVAL;
+
+	if (stat(local_path, &st) != 0 || !S_ISREG(st.st_mode)
+		|| access(local_path, R_OK) != 0 || st.st_size == 0)
+		return -ENOENT;
+
+	pthread_mutex_lock(&upload_lock);
+
+	if (n_queued >= MAX_QUEUED_UPLOADS) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	u = new_upload(next_id, local_path, cloud_path);
+	if (u == NULL) {
+		ret = -1;
+		goto done;
+	}
+	u->size = st.st_size;
+	u->mtime = st.st_mtime;
+
+	append_upload(u);
+	if (++next_id == 0)
+		next_id = 1;
+
+	if (save_queue() != 0) {
+		file_upload_t **p = &queue;
+
+		while (*p != u)
+			p = &(*p)->next;
+		*p = NULL;
+		n_queued--;
+		free_upload(u);
+		ret = -1;
+		goto done;
+	}
+
+	*id = u->id;
+	pthread_cond_broadcast(&upload_cond);
+
+	log_fu_info("Queued upload %" PRIu32 " of '%s' to '%s' (%" PRIu64 " bytes)",
+		u->id, local_path, cloud_path, u->size);
+
+done:
+	pthread_mutex_unlock(&upload_lock);
+
+	return ret;
+}
+
+void get_file_upload_status(uint32_t id, file_upload_status_t *status)
+{
+	file_upload_t *u;
+	unsigned int i;
+
+	status->state = FILE_UPLOAD_UNKNOWN;
+	status->sent = 0;
+	status->size = 0;
+
+	pthread_mutex_lock(&upload_lock);
+
+	for (u = queue; u != NULL; u = u->next) {
+		if (u->id == id) {
+			status->state = u == queue ? FILE_UPLOAD_UPLOADING : FILE_UPLOAD_QUEUED;
+			status->sent = u->offset;
+			status->size = u->size;
+			goto done;
+		}
+	}
+
+	for (i = 0; i < MAX_FINISHED_UPLOADS; i++) {
+		if (finished[i].id == id && finished[i].status.state != FILE_UPLOAD_UNKNOWN) {
+			*status = finished[i].status;
+			break;
+		}
+	}
+
+done:
+	pthread_mutex_unlock(&upload_lock);
+}
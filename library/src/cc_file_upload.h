@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_FILE_UPLOAD_H_
+#define CC_FILE_UPLOAD_H_
+
+#include <stdint.h>
+
+#include "cc_config.h"
+
+/*
+ * File upload states. Values are sent as they are to the services clients,
+ * keep them in sync with 'cccs_file_upload_state_t'.
+ */
+typedef enum {
+	FILE_UPLOAD_UNKNOWN,
+	FILE_UPLOAD_QUEUED,
+	FILE_UPLOAD_UPLOADING,
+	FILE_UPLOAD_DONE,
+	FILE_UPLOAD_FAILED,
+} file_upload_state_t;
+
+/*
+ * struct file_upload_status_t - File upload status type
+ *
+ * @state:	State of the upload
+ * @sent:	Number of bytes already uploaded
+ * @size:	Size of the file
+ */
+typedef struct {
+	file_upload_state_t state;
+	uint64_t sent;
+	uint64_t size;
+} file_upload_status_t;
+
+/*
+ * start_file_uploads() - Start the file upload manager
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * Loads the uploads queued in a previous execution and resumes them from
+ * the last uploaded chunk.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int start_file_uploads(const cc_cfg_t *const cc_cfg);
+
+/*
+ * stop_file_uploads() - Stop the file upload manager
+ *
+ * Queued uploads are kept and resumed on next start.
+ */
+void stop_file_uploads(void);
+
+/*
+ * queue_file_upload() - Queue a file to be uploaded to the cloud storage
+ *
+ * @local_path:	Absolute path of the file to upload.
+ * @cloud_path:	Destination path in the device cloud storage.
+ * @id:		Identifier of the upload to query its status.
+ *
+ * The file is uploaded in chunks in the background, so it must not be
+ * modified until the upload finishes. If it changes, the upload starts over.
+ *
+ * Return: 0 on success, -EINVAL if any path is not valid, -ENOENT if the
+ *         file cannot be read, -EBUSY if the queue is full, -1 otherwise.
+ */
+int queue_file_upload(const char *local_path, const char *cloud_path, uint32_t *id);
+
+/*
+ * get_file_upload_status() - Get the status of a file upload
+ *
+ * @id:		Identifier of the upload.
+ * @status:	Struct to store the status. Its state is FILE_UPLOAD_UNKNOWN
+ * 		if the upload does not exist or finished long ago.
+ */
+void get_file_upload_status(uint32_t id, file_upload_status_t *status);
+
+#endif /* CC_FILE_UPLOAD_H_ */
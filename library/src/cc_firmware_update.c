@@ -18,8 +18,9 @@
  */
 
 #include <confuse.h>
+#include <ctype.h>
 #include <errno.h>
-#include <libdigiapix/process.h>
+#include <inttypes.h>
 #include <miniunz/unzip.h>
 #include <pthread.h>
 #ifdef ENABLE_RECOVERY_UPDATE
@@ -29,19 +30,29 @@
 #include <sys/reboot.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "_cc_datapoints.h"
+#include "cc_bootenv.h"
 #include "cc_config.h"
 #include "cc_firmware_update.h"
+#include "cc_fw_schedule.h"
+#include "cc_health_check.h"
+#include "cc_init.h"
 #include "cc_logging.h"
 #include "_utils.h"
 
 /* Swupdate support */
 #ifdef ENABLE_ONTHEFLY_UPDATE
+#include <fcntl.h>
 #include <mntent.h>
 #include <network_ipc.h>
+#include <progress_ipc.h>
 #include <semaphore.h>
 #include <swupdate_status.h>
+#include <sys/mount.h>
+#include <zlib.h>
 #endif /* ENABLE_ONTHEFLY_UPDATE */
 
 #define FW_UPDATE_TAG			"FW UPDATE:"
@@ -64,6 +75,14 @@
 #define LINE_BUFSIZE			255
 #define CMD_BUFSIZE			255
 
+#define FW_ENV_ACTIVE_SYSTEM		"active_system"
+#define PROC_MTD_FILE			"/proc/mtd"
+#define MOUNT_POINT_LINUX_A		"/mnt/linux_a"
+#define MOUNT_POINT_LINUX_B		"/mnt/linux_b"
+
+#define DP_INSTALL_STREAM_ID		"management/events/firmware_install"
+#define REPORT_BUFSIZE			512
+
 /**
  * log_fw_debug() - Log the given message as debug
  *
@@ -103,13 +122,19 @@ typedef enum {
  * @path:	Absolute path to download the file
  * @fp:		File pointer to the firmware file
  * @size:	Total size of the firmware file
+ * @received:	Number of bytes received so far
  * @percent:	Last percent reported
+ * @scheduled:	True if the installation is deferred to the install window
+ * @start:	Time the download started, to report its throughput
  */
 typedef struct {
 	char *path;
 	FILE *fp;
 	size_t size;
+	uint64_t received;
 	size_t percent;
+	bool scheduled;
+	struct timespec start;
 } fw_info_t;
 
 /*
@@ -122,7 +147,7 @@ typedef struct {
  * @fragments_dir:	Directory where the fragments are located
  */
 typedef struct {
-	size_t fw_total_size;
+	uint64_t fw_total_size;
 	int n_fragments;
 	char *fragment_name;
 	uint32_t fw_checksum;
@@ -167,16 +192,31 @@ typedef struct {
  * 			the read on-the-fly callback to get a package chunk
  * @chunk_size:		Size of received data chunk from the server
  * @status:		Last swupdate status
+ * @swu_fd:		File descriptor of the package to install from the
+ * 			file system, -1 when data comes from the server
+ * @swu_error:		Error code reported by swupdate, 0 if none
+ * @swu_desc:		Last error description reported by swupdate
+ * @progress_fd:	Connection to the swupdate progress interface
+ * @progress_thread:	Thread reporting the swupdate installation progress
+ * @progress_valid:	True if the progress thread is running
  * @sem_end_swupdate:	Semaphore for on-the-fly end callback finish
  * @sem_start_chunk:	Semaphore for a new chunk from the server
  * @sem_end_chunk:	Semaphore for swupdate processed chunk
- * @sem_mutex:		Received data mutex
+ * @sem_mutex:		Received data and progress connection mutex
  */
 typedef struct {
 	char buffer[FW_SWU_CHUNK_SIZE];
 	int chunk_size;
 	int status;
 
+	int swu_fd;
+	int swu_error;
+	char swu_desc[LINE_BUFSIZE + 1];
+
+	int progress_fd;
+	pthread_t progress_thread;
+	bool progress_valid;
+
 	sem_t sem_end_swupdate;
 
 	/* Semaphores to sync download data with swupdate read thread */
@@ -184,6 +224,40 @@ typedef struct {
 	sem_t sem_end_chunk;
 	sem_t sem_mutex;
 } otf_info_t;
+
+/*
+ * struct mf_stream_t - Fragmented package on-the-fly information type
+ *
+ * @mf_fw_info:	Firmware package information from the manifest
+ * @zip:	Fragment being streamed, NULL if none
+ * @index:	Index of the fragment being streamed
+ * @size:	Number of bytes of the package already streamed
+ * @crc32:	CRC32 of the package data already streamed
+ * @error:	true if the package cannot be streamed or is not valid
+ */
+typedef struct {
+	mf_fw_info_t *mf_fw_info;
+	unzFile zip;
+	int index;
+	uint64_t size;
+	uint32_t crc32;
+	bool error;
+} mf_stream_t;
+
+/*
+ * struct install_report_t - Installation status pending to report
+ *
+ * @json:	Last installation status not sent yet, empty if none
+ * @lock:	Mutex to protect the status
+ * @sem_new:	Semaphore signaled every time a new status is available
+ * @valid:	True if the report thread is running
+ */
+typedef struct {
+	char json[REPORT_BUFSIZE];
+	pthread_mutex_t lock;
+	sem_t sem_new;
+	bool valid;
+} install_report_t;
 #endif /* ENABLE_ONTHEFLY_UPDATE */
 
 extern cc_cfg_t *cc_cfg;
@@ -191,7 +265,9 @@ static fw_info_t fw_info = {
 	.path = NULL,
 	.fp = NULL,
 	.size = 0,
+	.received = 0,
 	.percent = 0,
+	.scheduled = false,
 };
 
 #ifdef ENABLE_RECOVERY_UPDATE
@@ -203,7 +279,24 @@ static otf_info_t otf_info = {
 	.buffer = {0},
 	.chunk_size = 0,
 	.status = EXIT_SUCCESS,
+	.swu_fd = -1,
+	.swu_error = 0,
+	.swu_desc = {0},
+	.progress_fd = -1,
+	.progress_valid = false,
 };
+
+static mf_stream_t mf_stream = {
+	.mf_fw_info = NULL,
+	.zip = NULL,
+};
+
+static install_report_t install_report = {
+	.json = {0},
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.valid = false,
+};
+static pthread_once_t install_report_once = PTHREAD_ONCE_INIT;
 #endif /* ENABLE_ONTHEFLY_UPDATE */
 
 /*
@@ -213,14 +306,14 @@ static otf_info_t otf_info = {
  *
  * Return: Number of free bytes.
  */
-static size_t get_available_space(const char* path)
+static uint64_t get_available_space(const char* path)
 {
 	struct statvfs stat;
 
 	if (statvfs(path, &stat) != 0)
 		return 0;
 
-	return stat.f_bsize * stat.f_bfree;
+	return (uint64_t) stat.f_bsize * stat.f_bfree;
 }
 
 /*
@@ -349,11 +442,15 @@ static char* mf_get_fragment_file_name(const char *name, int index)
  */
 static int check_mf_size(cfg_t *mf_cfg, cfg_opt_t *opt)
 {
-	long int size = cfg_opt_getnint(opt, 0);
-
-	if (size <= 0) {
-		cfg_error(mf_cfg, "Invalid %s (%l): size must be greater than 1",
-				opt->name, size);
+	char *size = cfg_opt_getnstr(opt, 0);
+	char *endptr = NULL;
+
+	/* Parsed as a string to allow packages over 4 GB on 32-bit platforms */
+	errno = 0;
+	if (size == NULL || *size < '0' || *size > '9'
+	    || strtoull(size, &endptr, 10) == 0 || *endptr != '\0' || errno != 0) {
+		cfg_error(mf_cfg, "Invalid %s (%s): size must be greater than 0",
+				opt->name, size != NULL ? size : "");
 		return -1;
 	}
 
@@ -471,7 +568,7 @@ static int mf_parse_file(const char *const manifest_path, mf_fw_info_t *mf_fw_in
 			/* ------------------------------------------------------------ */
 			/*|  TYPE   |   SETTING NAME    |  DEFAULT VALUE   |   FLAGS   |*/
 			/* ------------------------------------------------------------ */
-			CFG_INT		(MANIFEST_PROP_SIZE,		0,			CFGF_NODEFAULT),
+			CFG_STR		(MANIFEST_PROP_SIZE,		NULL,			CFGF_NODEFAULT),
 			CFG_INT		(MANIFEST_PROP_FRAGMENTS,	0,			CFGF_NODEFAULT),
 			CFG_STR		(MANIFEST_PROP_NAME,		NULL,		CFGF_NODEFAULT),
 			CFG_STR		(MANIFEST_PROP_CHECKSUM,	NULL,		CFGF_NODEFAULT),
@@ -510,7 +607,7 @@ static int mf_parse_file(const char *const manifest_path, mf_fw_info_t *mf_fw_in
 	}
 
 	/* Fill manifest properties. */
-	mf_fw_info->manifest.fw_total_size = cfg_getint(mf_cfg, MANIFEST_PROP_SIZE);
+	mf_fw_info->manifest.fw_total_size = strtoull(cfg_getstr(mf_cfg, MANIFEST_PROP_SIZE), NULL, 10);
 	mf_fw_info->manifest.n_fragments = cfg_getint(mf_cfg, MANIFEST_PROP_FRAGMENTS);
 	mf_fw_info->manifest.fw_checksum = strtoul(cfg_getstr(mf_cfg, MANIFEST_PROP_CHECKSUM), NULL, 10);
 	mf_fw_info->manifest.fragment_name = strdup(cfg_getstr(mf_cfg, MANIFEST_PROP_NAME));
@@ -624,45 +721,66 @@ done:
 	return n_fragments;
 }
 
-/**
- * mf_assemble_fragment() - Append a fragment to a file
+/*
+ * mf_open_fragment() - Open a fragment to decompress its contents
  *
- * @fragment:		Fragment file to be assembled.
+ * @fragment:		Fragment file to open.
  * @file_name:		Name of the file compressed in the fragment.
- * @swu_fp:		File pointer to the destination file.
  *
- * Return: 0 if the file was successfully assembled, -1 otherwise.
+ * Return: The fragment handle ready to read the compressed file, NULL on error.
  */
-static int mf_assemble_fragment(mf_fragment_t *fragment, const char *file_name, FILE *swu_fp)
+static unzFile mf_open_fragment(mf_fragment_t *fragment, const char *file_name)
 {
-	unzFile src = NULL;
-	char buffer[WRITE_BUFFER_SIZE];
-	int size_buffer = WRITE_BUFFER_SIZE;
-	int error = 0;
+	unzFile src = unzOpen(fragment->path);
 
-	src = unzOpen(fragment->path);
 	if (src == NULL) {
 		log_fw_error("Error assembling fragment, cannot open fragment '%s'",
 				fragment->path);
-		return -1;
+		return NULL;
 	}
 
 	if (unzLocateFile(src, file_name, 1) != UNZ_OK) {
 		log_fw_error(
 				"Error assembling fragment, file '%s' not found in fragment",
 				file_name);
-		error = -1;
-		goto done;
+		goto error;
 	}
 
 	if (unzOpenCurrentFilePassword(src, NULL) != UNZ_OK) {
 		log_fw_error(
 				"Error assembling fragment, cannot open fragment '%s' for decompression",
 				fragment->name);
-		error = -1;
-		goto done;
+		goto error;
 	}
 
+	return src;
+
+error:
+	unzClose(src);
+
+	return NULL;
+}
+
+/**
+ * mf_assemble_fragment() - Append a fragment to a file
+ *
+ * @fragment:		Fragment file to be assembled.
+ * @file_name:		Name of the file compressed in the fragment.
+ * @swu_fp:		File pointer to the destination file.
+ *
+ * Return: 0 if the file was successfully assembled, -1 otherwise.
+ */
+static int mf_assemble_fragment(mf_fragment_t *fragment, const char *file_name, FILE *swu_fp)
+{
+	unzFile src = NULL;
+	char buffer[WRITE_BUFFER_SIZE];
+	int size_buffer = WRITE_BUFFER_SIZE;
+	int error = 0;
+
+	src = mf_open_fragment(fragment, file_name);
+	if (src == NULL)
+		return -1;
+
 	do {
 		int read = unzReadCurrentFile(src, buffer, size_buffer);
 		if (read > 0) {
@@ -680,8 +798,8 @@ static int mf_assemble_fragment(mf_fragment_t *fragment, const char *file_name,
 	if (error)
 		log_fw_error("Error assembling fragment '%s'", fragment->path);
 
-done:
 	unzCloseCurrentFile(src);
+	unzClose(src);
 
 	return error;
 }
@@ -764,9 +882,9 @@ static int mf_assemble_fw_package(mf_fw_info_t *const mf_fw_info)
 	/* Check file size */
 
 	stat(mf_fw_info->file_path, &st);
-	if ((size_t) st.st_size != mf_fw_info->manifest.fw_total_size) {
-		log_fw_error("Bad firmware package size: %zu, expected %zu",
-			     (size_t)st.st_size, mf_fw_info->manifest.fw_total_size);
+	if ((uint64_t) st.st_size != mf_fw_info->manifest.fw_total_size) {
+		log_fw_error("Bad firmware package size: %" PRIu64 ", expected %" PRIu64,
+			     (uint64_t) st.st_size, mf_fw_info->manifest.fw_total_size);
 		error = -1;
 		goto error;
 	}
@@ -827,7 +945,7 @@ done:
  */
 static int mf_generate_fw(const char *manifest_path, int target)
 {
-	size_t available_space;
+	uint64_t available_space;
 	char *tmp = NULL;
 	mf_fw_info_t mf_fw_info = {0};
 	int error = 0;
@@ -852,7 +970,7 @@ static int mf_generate_fw(const char *manifest_path, int target)
 
 	if (available_space < mf_fw_info.manifest.fw_total_size) {
 		log_fw_error(
-				"Not enough space in %s to update firmware (target '%d'), needed %zu have %zu",
+				"Not enough space in %s to update firmware (target '%d'), needed %" PRIu64 " have %" PRIu64,
 				cc_cfg->fw_download_path, target,
 				mf_fw_info.manifest.fw_total_size, available_space);
 		error = -1;
@@ -900,6 +1018,102 @@ done:
 /******************** On-the-fly update ********************/
 
 #ifdef ENABLE_ONTHEFLY_UPDATE
+/*
+ * copy_json_string() - Copy a string to be used as a JSON string value
+ *
+ * @dst:	Destination buffer.
+ * @size:	Size of the destination buffer.
+ * @src:	String to copy.
+ *
+ * Quotes, backslashes and control characters are replaced by spaces.
+ */
+static void copy_json_string(char *dst, size_t size, const char *src)
+{
+	size_t i;
+
+	for (i = 0; i < size - 1 && src[i] != '\0'; i++)
+		dst[i] = (src[i] == '"' || src[i] == '\\' || iscntrl((unsigned char) src[i])) ? ' ' : src[i];
+	dst[i] = '\0';
+}
+
+/*
+ * install_report_threaded() - Send the queued installation status
+ *
+ * @unused:	Unused parameter.
+ *
+ * Installation callbacks can be called while the connection is busy
+ * receiving the package, so reports are sent from this thread to never
+ * block swupdate. Only the last status is sent if several are queued.
+ */
+static void *install_report_threaded(void *unused)
+{
+	char json[REPORT_BUFSIZE];
+
+	UNUSED_ARGUMENT(unused);
+
+	for (;;) {
+		if (sem_wait(&install_report.sem_new) != 0)
+			continue;
+
+		pthread_mutex_lock(&install_report.lock);
+		memcpy(json, install_report.json, sizeof(json));
+		install_report.json[0] = '\0';
+		pthread_mutex_unlock(&install_report.lock);
+
+		if (json[0] != '\0' && get_cloud_connection_status() == CC_STATUS_CONNECTED)
+			dp_send_json_event(DP_INSTALL_STREAM_ID, json);
+	}
+
+	return NULL;
+}
+
+/*
+ * install_report_init() - Start the installation status report thread
+ */
+static void install_report_init(void)
+{
+	pthread_t thread;
+
+	if (sem_init(&install_report.sem_new, 0, 0) != 0)
+		return;
+
+	install_report.valid = pthread_create(&thread, NULL, install_report_threaded, NULL) == 0;
+	if (install_report.valid)
+		pthread_detach(thread);
+	else
+		log_fw_debug("%s", "Unable to report installation status");
+}
+
+/*
+ * report_install_status() - Queue the installation status to send to Remote Manager
+ *
+ * @status:	Installation status: "installing", "installed" or "failed".
+ * @step:	Current installation step, 0 if unknown.
+ * @n_steps:	Total number of installation steps, 0 if unknown.
+ * @percent:	Percentage of the current step already installed.
+ * @error:	Error code reported by swupdate, 0 if none.
+ * @desc:	Description of the status, NULL if none.
+ */
+static void report_install_status(const char *status, unsigned int step,
+	unsigned int n_steps, unsigned int percent, int error, const char *desc)
+{
+	char value[LINE_BUFSIZE + 1];
+
+	pthread_once(&install_report_once, install_report_init);
+	if (!install_report.valid)
+		return;
+
+	copy_json_string(value, sizeof(value), desc != NULL ? desc : "");
+
+	pthread_mutex_lock(&install_report.lock);
+	snprintf(install_report.json, sizeof(install_report.json),
+		"{\"status\": \"%s\", \"step\": %u, \"steps\": %u, \"percent\": %u, \"error\": %d, \"description\": \"%s\"}",
+		status, step, n_steps, percent, error, value);
+	pthread_mutex_unlock(&install_report.lock);
+
+	sem_post(&install_report.sem_new);
+}
+
 /*
  * otf_read_image_cb() - Swupdate callback to read a new chunk of the on-the-fly image
  *
@@ -933,7 +1147,8 @@ static int otf_read_image_cb(char **p, int *size)
  * @msg:	IPC message with the status of the on-the-fly firmware update.
  *
  * This is called by the Swupdate library to inform about the current status of
- * the upgrade.
+ * the upgrade. The last error code and description reported by swupdate are
+ * stored to be able to report them when the update finishes.
  *
  * Returns 0.
  */
@@ -943,6 +1158,14 @@ static int otf_print_status_cb(ipc_message *msg)
 		msg->data.status.current,
 		strlen(msg->data.status.desc) > 0 ? msg->data.status.desc : "");
 
+	if (msg->data.status.current == FAILURE || msg->data.status.error != 0) {
+		otf_info.swu_error = msg->data.status.error;
+		if (strlen(msg->data.status.desc) > 0) {
+			strncpy(otf_info.swu_desc, msg->data.status.desc, sizeof(otf_info.swu_desc) - 1);
+			otf_info.swu_desc[sizeof(otf_info.swu_desc) - 1] = '\0';
+		}
+	}
+
 	return 0;
 }
 
@@ -958,10 +1181,20 @@ static int otf_print_status_cb(ipc_message *msg)
  */
 static int otf_end_cb(RECOVERY_STATUS status)
 {
+	/* A package that does not match its manifest must not be activated */
+	if (status == SUCCESS && mf_stream.mf_fw_info != NULL && mf_stream.error) {
+		snprintf(otf_info.swu_desc, sizeof(otf_info.swu_desc), "%s",
+			"Firmware package does not match the manifest");
+		status = FAILURE;
+	}
+
 	otf_info.status = (status == SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
 
 	log_fw_info("On-the-fly update %s (%d)",
 		status == FAILURE ? "*FAILED*!" : "SUCCEED!", status);
+	if (status == FAILURE)
+		log_fw_error("Swupdate error %d: %s", otf_info.swu_error,
+			strlen(otf_info.swu_desc) > 0 ? otf_info.swu_desc : "Unknown error");
 
 	if (status == SUCCESS) {
 		ipc_message msg;
@@ -971,9 +1204,17 @@ static int otf_end_cb(RECOVERY_STATUS status)
 		if (ipc_postupdate(&msg) != 0 || msg.type != ACK) {
 			log_fw_error("%s", "Running on-the-fly post-update failed!");
 			otf_info.status = EXIT_FAILURE;
+			snprintf(otf_info.swu_desc, sizeof(otf_info.swu_desc), "%s",
+				"Post-update actions failed");
 		}
 	}
 
+	if (otf_info.status == EXIT_SUCCESS)
+		report_install_status("installed", 0, 0, 100, 0, NULL);
+	else
+		report_install_status("failed", 0, 0, 0, otf_info.swu_error,
+			strlen(otf_info.swu_desc) > 0 ? otf_info.swu_desc : "Unknown error");
+
 	/* Signal last chunk has been processed by swupdate (waiting firmware_data_cb) */
 	sem_post(&otf_info.sem_end_chunk);
 
@@ -983,6 +1224,123 @@ static int otf_end_cb(RECOVERY_STATUS status)
 	return 0;
 }
 
+/*
+ * swu_read_file_cb() - Swupdate callback to read a new chunk of a package file
+ *
+ * @p:		Buffer for the new chunk data.
+ * @size:	Size of the new chunk.
+ *
+ * This is the callback to get a new chunk of the package to install when it
+ * has been already downloaded to the file system.
+ * It is called by a thread generated by the library and can block.
+ *
+ * Return: Number of read bytes, 0 at the end of the file, -1 on error.
+ */
+static int swu_read_file_cb(char **p, int *size)
+{
+	ssize_t n_bytes;
+
+	do {
+		n_bytes = read(otf_info.swu_fd, otf_info.buffer, sizeof(otf_info.buffer));
+	} while (n_bytes < 0 && errno == EINTR);
+
+	if (n_bytes < 0) {
+		log_fw_error("Unable to read firmware package: %s (%d)",
+			strerror(errno), errno);
+		n_bytes = -1;
+	}
+
+	*p = otf_info.buffer;
+	*size = n_bytes > 0 ? n_bytes : 0;
+
+	return n_bytes;
+}
+
+/*
+ * swu_progress_threaded() - Report swupdate installation progress
+ *
+ * @unused:	Unused parameter.
+ *
+ * Connects to the swupdate progress interface and logs and reports the
+ * progress of every installation step until the update finishes.
+ */
+static void *swu_progress_threaded(void *unused)
+{
+	struct progress_msg msg;
+	unsigned int last_step = 0, last_percent = 0;
+	int fd, cancel_state;
+
+	UNUSED_ARGUMENT(unused);
+
+	/* Do not get cancelled before storing the connection, it would leak */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+	fd = progress_ipc_connect(false);
+	sem_wait(&otf_info.sem_mutex);
+	otf_info.progress_fd = fd;
+	sem_post(&otf_info.sem_mutex);
+	pthread_setcancelstate(cancel_state, NULL);
+
+	if (fd < 0) {
+		log_fw_debug("%s", "Unable to connect to swupdate progress interface");
+		goto done;
+	}
+
+	while (progress_ipc_receive(&otf_info.progress_fd, &msg) > 0) {
+		if (msg.status == SUCCESS || msg.status == FAILURE || msg.status == DONE)
+			break;
+
+		if (msg.nsteps == 0 || msg.cur_step == 0)
+			continue;
+
+		/* Report each step start and every 10% of it */
+		if (msg.cur_step != last_step || msg.cur_percent / 10 != last_percent / 10) {
+			log_fw_info("Installing step %u/%u '%s' (%s): %u%%",
+				msg.cur_step, msg.nsteps, msg.cur_image,
+				msg.hnd_name, msg.cur_percent);
+			report_install_status("installing", msg.cur_step, msg.nsteps,
+				msg.cur_percent, 0, msg.cur_image);
+			last_step = msg.cur_step;
+			last_percent = msg.cur_percent;
+		}
+	}
+
+done:
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * swu_start_progress() - Start reporting swupdate installation progress
+ */
+static void swu_start_progress(void)
+{
+	otf_info.progress_fd = -1;
+	otf_info.progress_valid = pthread_create(&otf_info.progress_thread,
+		NULL, swu_progress_threaded, NULL) == 0;
+	if (!otf_info.progress_valid)
+		log_fw_debug("%s", "Unable to report installation progress");
+}
+
+/*
+ * swu_stop_progress() - Stop reporting swupdate installation progress
+ */
+static void swu_stop_progress(void)
+{
+	if (otf_info.progress_valid) {
+		pthread_cancel(otf_info.progress_thread);
+		pthread_join(otf_info.progress_thread, NULL);
+		otf_info.progress_valid = false;
+	}
+
+	sem_wait(&otf_info.sem_mutex);
+	if (otf_info.progress_fd >= 0) {
+		close(otf_info.progress_fd);
+		otf_info.progress_fd = -1;
+	}
+	sem_post(&otf_info.sem_mutex);
+}
+
 /*
  * check_mount_point() - Checks if the provided path is an existing mount point
  *
@@ -1021,6 +1379,132 @@ static bool check_mount_point(const char *mp_dir)
 	return found;
 }
 
+/*
+ * get_active_system() - Retrieve the active system of a dual boot device
+ *
+ * Reads the active system directly from the bootloader environment.
+ *
+ * Return: 'a' or 'b' for the active system, '\0' if it cannot be determined.
+ */
+static char get_active_system(void)
+{
+	char *value = bootenv_get(FW_ENV_ACTIVE_SYSTEM);
+	char active = '\0';
+
+	if (value == NULL) {
+		log_fw_error("Variable '%s' not found in bootloader environment",
+			FW_ENV_ACTIVE_SYSTEM);
+		return active;
+	}
+
+	/* Values are 'linux_a' or 'linux_b' */
+	if (!strcmp(value, "linux_a"))
+		active = 'a';
+	else if (!strcmp(value, "linux_b"))
+		active = 'b';
+	else
+		log_fw_error("Unknown active system '%s'", value);
+
+	free(value);
+
+	return active;
+}
+
+/*
+ * is_mtd_device() - Check if the system storage is a raw NAND (MTD) device
+ *
+ * Return: true if there are MTD partitions, false otherwise (eMMC devices).
+ */
+static bool is_mtd_device(void)
+{
+	char line[LINE_BUFSIZE] = {0};
+	bool found = false;
+	FILE *fp;
+
+	fp = fopen(PROC_MTD_FILE, "r");
+	if (fp == NULL)
+		return false;
+
+	/* First line is a header, partitions are listed as 'mtdX: ...' */
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (!strncmp(line, "mtd", strlen("mtd"))) {
+			found = true;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	return found;
+}
+
+/*
+ * swu_prepare_request() - Prepare a swupdate request to install in the inactive system
+ *
+ * @req:	Swupdate request to fill.
+ *
+ * Detects the storage media and the active system, selects the partition to
+ * update and unmounts it if it is mounted.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int swu_prepare_request(struct swupdate_request *req)
+{
+	const char *mount_point;
+	char active_system;
+
+	swupdate_prepare_req(req);
+
+	active_system = get_active_system();
+	if (active_system == '\0') {
+		log_fw_error("%s", "Error getting active system");
+		return -1;
+	}
+
+	log_fw_debug("Active system detected: '%c'", active_system);
+
+	/* Detect storage media */
+	strncpy(req->software_set, is_mtd_device() ? "mtd" : "mmc", sizeof(req->software_set) - 1);
+	log_fw_debug("Is a %s device", req->software_set);
+
+	/* Detect active system & save the partition to umount */
+	if (active_system == 'a') {
+		strncpy(req->running_mode, "secondary", sizeof(req->running_mode) - 1);
+		mount_point = MOUNT_POINT_LINUX_B;
+	} else {
+		strncpy(req->running_mode, "primary", sizeof(req->running_mode) - 1);
+		mount_point = MOUNT_POINT_LINUX_A;
+	}
+
+	log_fw_debug("Selected %s partition to update", req->running_mode);
+
+	/*
+	 * Errors are not relevant, the partition may be already unmounted,
+	 * for example when retrying an update that failed.
+	 */
+	if (check_mount_point(mount_point) && umount(mount_point) != 0)
+		log_fw_debug("Unable to unmount '%s': %s (%d)", mount_point,
+			strerror(errno), errno);
+
+	return 0;
+}
+
+/*
+ * otf_init() - Initialize on-the-fly information for a new installation
+ */
+static void otf_init(void)
+{
+	otf_info.chunk_size = 0;
+	otf_info.status = EXIT_SUCCESS;
+	otf_info.swu_fd = -1;
+	otf_info.swu_error = 0;
+	otf_info.swu_desc[0] = '\0';
+	sem_init(&otf_info.sem_end_swupdate, 0, 0);
+	sem_init(&otf_info.sem_start_chunk, 0, 0);
+	sem_init(&otf_info.sem_end_chunk, 0, 0);
+	sem_init(&otf_info.sem_mutex, 0, 1);
+}
+
 /*
  * otf_destroy_semaphores() - Destroy all on-the-fly semaphores.
  */
@@ -1032,6 +1516,239 @@ static void otf_destroy_semaphores(void)
 	sem_destroy(&otf_info.sem_end_swupdate);
 }
 
+/*
+ * swu_install() - Install a package using swupdate
+ *
+ * @read_cb:	Callback to read each chunk of the package.
+ *
+ * The package is installed in the inactive system of a dual boot device
+ * through the swupdate IPC interface. On-the-fly information must be
+ * initialized with 'otf_init()' before calling this function.
+ *
+ * Return: CCAPI_FW_DATA_ERROR_NONE on success, error code otherwise.
+ */
+static ccapi_fw_data_error_t swu_install(writedata read_cb)
+{
+	static struct swupdate_request req;
+	ccapi_fw_data_error_t error = CCAPI_FW_DATA_ERROR_NONE;
+
+	if (swu_prepare_request(&req) != 0)
+		return CCAPI_FW_DATA_ERROR_INVALID_DATA;
+
+	swu_start_progress();
+
+	if (swupdate_async_start(read_cb, otf_print_status_cb, otf_end_cb, &req, sizeof(req)) < 0) {
+		log_fw_error("%s", "Unable to start swupdate, it may be busy");
+		otf_info.status = EXIT_FAILURE;
+		report_install_status("failed", 0, 0, 0, 0, "Unable to start swupdate");
+		error = CCAPI_FW_DATA_ERROR_BUSY;
+		goto done;
+	}
+
+	/* Wait for end of the update (signaled by otf_end_cb) */
+	sem_wait(&otf_info.sem_end_swupdate);
+
+	if (otf_info.status != EXIT_SUCCESS)
+		error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
+
+done:
+	swu_stop_progress();
+
+	return error;
+}
+
+/*
+ * swu_install_package() - Install a downloaded SWU package using swupdate
+ *
+ * @swu_path:	Absolute path to the downloaded SWU file.
+ *
+ * Return: CCAPI_FW_DATA_ERROR_NONE on success, error code otherwise.
+ */
+static ccapi_fw_data_error_t swu_install_package(const char *swu_path)
+{
+	ccapi_fw_data_error_t error;
+
+	otf_init();
+
+	otf_info.swu_fd = open(swu_path, O_RDONLY | O_CLOEXEC);
+	if (otf_info.swu_fd < 0) {
+		log_fw_error("Unable to open package '%s': %s (%d)", swu_path,
+			strerror(errno), errno);
+		error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
+	} else {
+		error = swu_install(swu_read_file_cb);
+
+		close(otf_info.swu_fd);
+		otf_info.swu_fd = -1;
+	}
+
+	otf_destroy_semaphores();
+
+	return error;
+}
+
+/*
+ * mf_read_fragment_cb() - Swupdate callback to read a new chunk of a fragmented package
+ *
+ * @p:		Buffer for the new chunk data.
+ * @size:	Size of the new chunk.
+ *
+ * Decompresses the fragments in order and feeds their data to swupdate.
+ * Every fragment is removed once it is completely streamed. The size and the
+ * CRC32 of the package are calculated while streaming and checked against the
+ * manifest after the last fragment.
+ * It is called by a thread generated by the library and can block.
+ *
+ * Return: Number of read bytes, 0 at the end of the package.
+ */
+static int mf_read_fragment_cb(char **p, int *size)
+{
+	mf_fw_info_t *mf_fw_info = mf_stream.mf_fw_info;
+	int n_bytes = 0;
+
+	*p = otf_info.buffer;
+	*size = 0;
+
+	if (mf_stream.error)
+		return 0;
+
+	while (mf_stream.index < mf_fw_info->n_fragments) {
+		mf_fragment_t *fragment = &mf_fw_info->fragments[mf_stream.index];
+		int ret;
+
+		if (mf_stream.zip == NULL) {
+			log_fw_debug("Processing fragment %d", fragment->index);
+			mf_stream.zip = mf_open_fragment(fragment, mf_fw_info->file_name);
+			if (mf_stream.zip == NULL) {
+				mf_stream.error = true;
+				return 0;
+			}
+		}
+
+		n_bytes = unzReadCurrentFile(mf_stream.zip, otf_info.buffer, sizeof(otf_info.buffer));
+		if (n_bytes > 0)
+			break;
+
+		/* End of fragment, this also verifies the fragment CRC */
+		ret = unzCloseCurrentFile(mf_stream.zip);
+		unzClose(mf_stream.zip);
+		mf_stream.zip = NULL;
+
+		if (n_bytes < 0 || ret != UNZ_OK) {
+			log_fw_error("Error assembling fragment '%s'", fragment->path);
+			mf_stream.error = true;
+			return 0;
+		}
+
+		log_fw_debug("Fragment %d installed", fragment->index);
+		if (remove(fragment->path) == -1)
+			log_fw_error("Unable to remove fragment %d (errno %d: %s)",
+				fragment->index, errno, strerror(errno));
+
+		mf_stream.index++;
+	}
+
+	if (n_bytes > 0) {
+		mf_stream.crc32 = crc32(mf_stream.crc32, (Bytef *)otf_info.buffer, n_bytes);
+		mf_stream.size += n_bytes;
+
+		if (mf_stream.size > mf_fw_info->manifest.fw_total_size) {
+			log_fw_error("Bad firmware package size: more than %" PRIu64 " bytes",
+				mf_fw_info->manifest.fw_total_size);
+			mf_stream.error = true;
+			return 0;
+		}
+
+		*size = n_bytes;
+
+		return n_bytes;
+	}
+
+	/* All fragments streamed, check the package before finishing */
+	if (mf_stream.size != mf_fw_info->manifest.fw_total_size) {
+		log_fw_error("Bad firmware package size: %" PRIu64 ", expected %" PRIu64,
+			mf_stream.size, mf_fw_info->manifest.fw_total_size);
+		mf_stream.error = true;
+	} else if (mf_stream.crc32 != mf_fw_info->manifest.fw_checksum) {
+		log_fw_error("Wrong CRC32, calculated 0x%08x, expected 0x%08x",
+			mf_stream.crc32, mf_fw_info->manifest.fw_checksum);
+		mf_stream.error = true;
+	} else {
+		log_fw_debug("CRC32 (0x%08x) is correct", mf_stream.crc32);
+	}
+
+	return 0;
+}
+
+/*
+ * mf_install_fw() - Install a firmware package via manifest on-the-fly
+ *
+ * @manifest_path:	Absolute path to the downloaded manifest file.
+ * @target:		Target number.
+ *
+ * Instead of assembling the complete firmware package, the fragments
+ * specified in the manifest are decompressed and streamed to swupdate one by
+ * one, so no space is needed for the assembled package. All fragments must
+ * already be on the device, each one is removed once it is streamed.
+ * Size and CRC32 of the package are verified while streaming, and the update
+ * is considered failed if they do not match the manifest, so the active
+ * system is not swapped.
+ *
+ * Return: CCAPI_FW_DATA_ERROR_NONE on success, error code otherwise.
+ */
+static ccapi_fw_data_error_t mf_install_fw(const char *manifest_path, int target)
+{
+	mf_fw_info_t mf_fw_info = {0};
+	ccapi_fw_data_error_t error;
+
+	if (mf_parse_file(manifest_path, &mf_fw_info) != 0) {
+		log_fw_error("Error loading firmware manifest file '%s'",
+				manifest_path);
+		error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
+		goto done;
+	}
+
+	if (mf_get_fw_path(&mf_fw_info) != 0 || !mf_get_fragments(&mf_fw_info)) {
+		error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
+		goto done;
+	}
+
+	log_fw_debug("Installing %d fragments on-the-fly (target '%d')",
+			mf_fw_info.n_fragments, target);
+
+	mf_stream.mf_fw_info = &mf_fw_info;
+	mf_stream.zip = NULL;
+	mf_stream.index = 0;
+	mf_stream.size = 0;
+	mf_stream.crc32 = crc32(0L, Z_NULL, 0);
+	mf_stream.error = false;
+
+	otf_init();
+
+	error = swu_install(mf_read_fragment_cb);
+	if (mf_stream.error) {
+		otf_info.status = EXIT_FAILURE;
+		error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
+	}
+
+	if (mf_stream.zip != NULL) {
+		unzCloseCurrentFile(mf_stream.zip);
+		unzClose(mf_stream.zip);
+		mf_stream.zip = NULL;
+	}
+
+	if (error != CCAPI_FW_DATA_ERROR_NONE)
+		mf_delete_fragments(&mf_fw_info);
+
+	otf_destroy_semaphores();
+
+done:
+	mf_stream.mf_fw_info = NULL;
+	mf_free_fw_info(&mf_fw_info);
+
+	return error;
+}
+
 #endif /* ENABLE_ONTHEFLY_UPDATE */
 
 /***********************************************************/
@@ -1046,46 +1763,38 @@ static ccapi_fw_data_error_t process_swu_package(const char *swu_path, int targe
 {
 	ccapi_fw_data_error_t error = CCAPI_FW_DATA_ERROR_NONE;
 
+#ifdef ENABLE_ONTHEFLY_UPDATE
 	if (cc_cfg->is_dual_boot) {
-		char cmd[CMD_BUFSIZE] = {0};
-		char line[LINE_BUFSIZE] = {0};
-		FILE *fp;
-
 		log_fw_debug("Starting update with path '%s'", swu_path);
-		sprintf(cmd, "update-firmware --no-reboot %s", swu_path);
-		/* Open process to execute update command */
-		fp = popen(cmd, "r");
-		if (fp == NULL){
-			log_fw_error("Unable to install package '%s' for target '%d'",
-					swu_path, target);
-		} else {
-			/* Read script output till finished */
-			while (fgets(line, LINE_BUFSIZE, fp) != NULL) {
-				log_fw_debug("swupdate: %s", line);
-				if(strstr(line, "There was an error performing the update")) {
-					log_fw_error(
-						"Error updating firmware using package '%s' for target '%d'",
-						swu_path, target);
-					error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
-				}
-			}
-			/* close the process */
-			pclose(fp);
-		}
-#ifdef ENABLE_RECOVERY_UPDATE
-	} else {
-		if (update_firmware(swu_path)) {
+		error = swu_install_package(swu_path);
+		if (error != CCAPI_FW_DATA_ERROR_NONE)
 			log_fw_error(
-					"Error updating firmware using package '%s' for target '%d'",
-					swu_path, target);
-			error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
-		}
-#endif /* ENABLE_RECOVERY_UPDATE */
+				"Error updating firmware using package '%s' for target '%d'",
+				swu_path, target);
 	}
+#endif /* ENABLE_ONTHEFLY_UPDATE */
+#ifdef ENABLE_RECOVERY_UPDATE
+	if (!cc_cfg->is_dual_boot && update_firmware(swu_path)) {
+		log_fw_error(
+				"Error updating firmware using package '%s' for target '%d'",
+				swu_path, target);
+		error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
+	}
+#endif /* ENABLE_RECOVERY_UPDATE */
 
 	return error;
 }
 
+/*
+ * is_install_window_set() - Check if updates must wait for the install window
+ *
+ * Return: True if 'firmware_install_window' is configured, false otherwise.
+ */
+static bool is_install_window_set(void)
+{
+	return cc_cfg->fw_install_window != NULL && strlen(cc_cfg->fw_install_window) > 0;
+}
+
 /*
  * reboot_system() - Reboot the system
  */
@@ -1119,6 +1828,93 @@ static void *reboot_threaded(void *unused)
 	return NULL;
 }
 
+/*
+ * install_or_schedule() - Install a downloaded package or defer it
+ *
+ * @swu_path:		Absolute path to the downloaded SWU file.
+ * @target:		Target number.
+ *
+ * If 'firmware_install_window' is configured the package is scheduled to be
+ * installed inside the window, otherwise it is installed right away.
+ *
+ * Return: CCAPI_FW_DATA_ERROR_NONE on success, error code otherwise.
+ */
+static ccapi_fw_data_error_t install_or_schedule(const char *swu_path, int target)
+{
+	if (!is_install_window_set())
+		return process_swu_package(swu_path, target);
+
+	if (schedule_fw_update(FW_SCHEDULE_INSTALL, swu_path, target) != 0)
+		return CCAPI_FW_DATA_ERROR_INVALID_DATA;
+
+	fw_info.scheduled = true;
+
+	return CCAPI_FW_DATA_ERROR_NONE;
+}
+
+/*
+ * finish_fw_update() - Activate an installed update and reboot
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int finish_fw_update(void)
+{
+#ifdef ENABLE_ONTHEFLY_UPDATE
+	if (cc_cfg->is_dual_boot) {
+		log_fw_debug("%s", "Firmware update finished. Now we will reboot the system");
+
+		/* Boot the updated system, verified on its first boot */
+		if (swap_active_system(true) != 0) {
+			log_fw_error("%s: Error swapping active system", __func__);
+			return -1;
+		}
+	}
+#endif /* ENABLE_ONTHEFLY_UPDATE */
+
+	log_fw_info("Rebooting in %d seconds", REBOOT_TIMEOUT);
+
+	if (pthread_create(&reboot_thread, NULL, reboot_threaded, NULL) != 0) {
+		/* If we cannot create the thread just reboot. */
+		reboot_system();
+	}
+
+	return 0;
+}
+
+int install_scheduled_fw_update(const char *const path, int const target)
+{
+	if (path != NULL) {
+		log_fw_info("Starting scheduled firmware update process (target '%d')", target);
+
+		if (process_swu_package(path, target) != CCAPI_FW_DATA_ERROR_NONE)
+			return -1;
+	}
+
+	return finish_fw_update();
+}
+
+/*
+ * get_download_rate() - Get the effective firmware download throughput
+ *
+ * @bytes:	Number of bytes downloaded so far.
+ * @elapsed:	Pointer to store the seconds elapsed since the download started.
+ *
+ * Return: The throughput in KB/s.
+ */
+static size_t get_download_rate(uint64_t bytes, double *elapsed)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	*elapsed = (double) (now.tv_sec - fw_info.start.tv_sec)
+		+ (double) (now.tv_nsec - fw_info.start.tv_nsec) / 1e9;
+
+	if (*elapsed <= 0)
+		return 0;
+
+	return (size_t) ((double) bytes / 1024 / *elapsed);
+}
+
 /******************** CC firmware update callbacks ********************/
 
 static ccapi_fw_request_error_t firmware_request_reject_all_cb(unsigned int const target,
@@ -1147,85 +1943,49 @@ static ccapi_fw_request_error_t firmware_request_reject_all_cb(unsigned int cons
 static ccapi_fw_request_error_t firmware_request_cb(unsigned int const target,
 		char const *const filename, size_t const total_size) {
 	ccapi_fw_request_error_t error = CCAPI_FW_REQUEST_ERROR_NONE;
-	size_t available_space;
+	uint64_t available_space;
 
 	log_fw_info("Firmware download requested (target '%d')", target);
 
 	fw_info.size = total_size;
+	fw_info.received = 0;
 	fw_info.percent = 0;
+	clock_gettime(CLOCK_MONOTONIC, &fw_info.start);
 
 	if (get_configuration(cc_cfg) != 0) {
 		log_fw_error("Cannot load configuration (target '%d')", target);
 		return CCAPI_FW_REQUEST_ERROR_ENCOUNTERED_ERROR;
 	}
 
+	/* A new update replaces the pending one */
+	if (cancel_fw_schedule() != 0) {
+		log_fw_error("A scheduled firmware update is being applied (target '%d')", target);
+		return CCAPI_FW_REQUEST_ERROR_ENCOUNTERED_ERROR;
+	}
+	fw_info.scheduled = false;
+
 #ifdef ENABLE_ONTHEFLY_UPDATE
 	if (cc_cfg->is_dual_boot && cc_cfg->on_the_fly && target != CC_FW_TARGET_MANIFEST) {
-		char *resp = NULL;
 		int retval;
 		static struct swupdate_request req;
 
 		log_fw_debug("On-the-fly update for target '%d'", target);
 
 		/* Initialize on-the-fly info */
-		otf_info.chunk_size = 0;
-		otf_info.status = EXIT_SUCCESS;
-		sem_init(&otf_info.sem_end_swupdate, 0, 0);
-		sem_init(&otf_info.sem_start_chunk, 0, 0);
-		sem_init(&otf_info.sem_end_chunk, 0, 0);
-		sem_init(&otf_info.sem_mutex, 0, 1);
+		otf_init();
 
 		/* Prepare request structure */
-		swupdate_prepare_req(&req);
-
-		if (ldx_process_execute_cmd("update-firmware -a -s", &resp, 2) != 0 || resp == NULL) {
-			if (resp != NULL)
-				log_fw_error("Error getting active system: %s", resp);
-			else
-				log_fw_error("%s: Error getting active system", __func__);
-			retval = -1;
-		} else {
-			char umount_cmd[CMD_BUFSIZE] = {0};
-			char *active_system = trim(resp);
-
-			/* Read active system */
-			log_fw_debug("Active system detected: '%s'", active_system);
-
-			/* Detect storage media, on eMMC devices the response will be 1*/
-			if (ldx_process_execute_cmd("grep -qs mtd /proc/mtd", NULL, 2) == 0) {
-				strncpy(req.software_set, "mtd" , sizeof(req.software_set) - 1);
-			} else {
-				strncpy(req.software_set, "mmc" , sizeof(req.software_set) - 1);
-			}
-			log_fw_debug("Is a %s device", req.software_set);
-
-			/* Detect active system & save the partition to umount */
-			if (!strcmp(active_system, "a")) {
-				strncpy(req.running_mode, "secondary" , sizeof(req.running_mode) - 1);
-				if (check_mount_point("/mnt/linux_b"))
-					sprintf(umount_cmd, "%s", "umount /mnt/linux_b > /dev/null");
-			} else {
-				strncpy(req.running_mode, "primary" , sizeof(req.running_mode) - 1);
-				if (check_mount_point("/mnt/linux_a"))
-					sprintf(umount_cmd, "%s", "umount /mnt/linux_a > /dev/null");
-			}
-
-			log_fw_debug("Selected %s partition to update", req.running_mode);
-
-			/* We don't care about the result of the command, it will fail
-			if the partition is already umount, for example in the scenario
-			when a first update fails, and we perform a retry */
-			if (strlen(umount_cmd) > 0)
-				ldx_process_execute_cmd(umount_cmd, NULL, 2);
-
+		retval = swu_prepare_request(&req);
+		if (retval == 0) {
+			swu_start_progress();
 			retval = swupdate_async_start(otf_read_image_cb, otf_print_status_cb, otf_end_cb, &req, sizeof(req));
 		}
 
-		free(resp);
-
 		/* Return if we've hit an error scenario */
 		if (retval < 0) {
 			log_fw_error("On-the-fly update failed, returns '%d'", retval);
+			swu_stop_progress();
+			report_install_status("failed", 0, 0, 0, 0, "Unable to start swupdate");
 			otf_destroy_semaphores();
 
 			return CCAPI_FW_REQUEST_ERROR_ENCOUNTERED_ERROR;
@@ -1251,7 +2011,7 @@ static ccapi_fw_request_error_t firmware_request_cb(unsigned int const target,
 		}
 		if (available_space < total_size) {
 			log_fw_error(
-				"Not enough space in '%s' to download firmware (target '%d'), needed %zu have %zu",
+				"Not enough space in '%s' to download firmware (target '%d'), needed %zu have %" PRIu64,
 				cc_cfg->fw_download_path, target, total_size, available_space);
 			error = CCAPI_FW_REQUEST_ERROR_DOWNLOAD_INVALID_SIZE;
 			goto done;
@@ -1294,13 +2054,22 @@ static ccapi_fw_data_error_t firmware_data_cb(unsigned int const target, uint32_
 
 	log_fw_debug("Received chunk: target=%d offset=0x%x length=%zu last_chunk=%d", target, offset, size, last_chunk);
 
+	/* The 32-bit offset wraps for images over 4 GB, count the bytes instead */
+	fw_info.received += size;
+
 	{
-		size_t p = (offset + size) * 100 / fw_info.size;
+		size_t p = fw_info.size > 0 ? (size_t) (fw_info.received * 100 / fw_info.size) : 100;
+		double elapsed;
+		size_t rate = get_download_rate(fw_info.received, &elapsed);
 
 		if (p != fw_info.percent && p % 5 == 0) {
-			log_fw_info("%02zu%% (%zu/%zu KB)", p, (offset + size) / 1024 , fw_info.size / 1024);
+			log_fw_info("%02zu%% (%" PRIu64 "/%zu KB, %zu KB/s)", p, fw_info.received / 1024, fw_info.size / 1024, rate);
 			fw_info.percent = p;
 		}
+
+		if (last_chunk)
+			log_fw_info("Downloaded %" PRIu64 " KB in %.1f seconds (%zu KB/s) for target '%d'",
+				fw_info.received / 1024, elapsed, rate, target);
 	}
 
 #ifdef ENABLE_ONTHEFLY_UPDATE
@@ -1337,6 +2106,7 @@ static ccapi_fw_data_error_t firmware_data_cb(unsigned int const target, uint32_
 			/* Wait for end of on-the-fly update (signaled by otf_end_cb) */
 			sem_wait(&otf_info.sem_end_swupdate);
 
+			swu_stop_progress();
 			otf_destroy_semaphores();
 
 			if (otf_info.status != EXIT_SUCCESS)
@@ -1367,6 +2137,12 @@ static ccapi_fw_data_error_t firmware_data_cb(unsigned int const target, uint32_
 			switch(target) {
 				/* Target for manifest.txt files. */
 				case CC_FW_TARGET_MANIFEST: {
+#ifdef ENABLE_ONTHEFLY_UPDATE
+					if (cc_cfg->is_dual_boot && cc_cfg->on_the_fly) {
+						error = mf_install_fw(fw_info.path, target);
+						break;
+					}
+#endif /* ENABLE_ONTHEFLY_UPDATE */
 					if (mf_generate_fw(fw_info.path, target) != 0) {
 						log_fw_error(
 								"Error generating firmware package from '%s' for target '%d'",
@@ -1374,12 +2150,12 @@ static ccapi_fw_data_error_t firmware_data_cb(unsigned int const target, uint32_
 						error = CCAPI_FW_DATA_ERROR_INVALID_DATA;
 						break;
 					}
-					error = process_swu_package(fw_info.path, target);
+					error = install_or_schedule(fw_info.path, target);
 					break;
 				}
 				/* Target for *.swu files. */
 				case CC_FW_TARGET_SWU: {
-					error = process_swu_package(fw_info.path, target);
+					error = install_or_schedule(fw_info.path, target);
 					break;
 				}
 				default:
@@ -1387,6 +2163,7 @@ static ccapi_fw_data_error_t firmware_data_cb(unsigned int const target, uint32_
 			}
 
 			free(fw_info.path);
+			fw_info.path = NULL;
 		}
 	}
 
@@ -1419,6 +2196,7 @@ static void firmware_cancel_cb(unsigned int const target, ccapi_fw_cancel_error_
 		/* Wait for end of on-the-fly update (signaled by otf_end_cb) */
 		sem_wait(&otf_info.sem_end_swupdate);
 
+		swu_stop_progress();
 		otf_destroy_semaphores();
 	}
 #endif /* ENABLE_ONTHEFLY_UPDATE */
@@ -1436,6 +2214,7 @@ static void firmware_cancel_cb(unsigned int const target, ccapi_fw_cancel_error_
 	free(fw_info.path);
 	fw_info.path = NULL;
 	fw_info.size = 0;
+	fw_info.received = 0;
 	fw_info.percent = 0;
 }
 
@@ -1456,36 +2235,33 @@ static void firmware_reset_cb(unsigned int const target, ccapi_bool_t *system_re
 
 	*system_reset = CCAPI_FALSE;
 
-#ifdef ENABLE_ONTHEFLY_UPDATE
-	if (cc_cfg->is_dual_boot && cc_cfg->on_the_fly && target != CC_FW_TARGET_MANIFEST){
-		char *resp = NULL;
+	if (fw_info.scheduled) {
+		fw_info.scheduled = false;
+		log_fw_info("Firmware update will be installed in the window '%s'",
+			cc_cfg->fw_install_window);
+		return;
+	}
 
+#ifdef ENABLE_ONTHEFLY_UPDATE
+	if (cc_cfg->is_dual_boot) {
 		if (otf_info.status != EXIT_SUCCESS) {
-			log_fw_error("%s", "On-the-fly update failed");
-			return;
-		}
-		log_fw_debug("%s", "On-the-fly update finished. Now we will reboot the system");
-
-		/* Swap the active system partition */
-		if (ldx_process_execute_cmd("update-firmware --swap-active-system --no-reboot", &resp, 2) != 0) {
-			if (resp != NULL)
-				log_fw_error("Error swapping active system: %s", resp);
-			else
-				log_fw_error("%s: Error swapping active system", __func__);
-			free(resp);
+			log_fw_error("%s", "Firmware update failed");
 			return;
 		}
 
-		free(resp);
+		/* Already installed, only the reboot to the new system is deferred */
+		if (is_install_window_set()) {
+			if (schedule_fw_update(FW_SCHEDULE_REBOOT, NULL, target) == 0) {
+				log_fw_info("Reboot to the updated system will happen in the window '%s'",
+					cc_cfg->fw_install_window);
+				return;
+			}
+			log_fw_error("%s", "Unable to schedule firmware update, rebooting now");
+		}
 	}
 #endif /* ENABLE_ONTHEFLY_UPDATE */
 
-	log_fw_info("Rebooting in %d seconds", REBOOT_TIMEOUT);
-
-	if (pthread_create(&reboot_thread, NULL, reboot_threaded, NULL) != 0) {
-		/* If we cannot create the thread just reboot. */
-		reboot_system();
-	}
+	finish_fw_update();
 }
 
 int init_fw_service(const bool enable, const char * const fw_version, ccapi_fw_service_t **fw_service)
@@ -35,4 +35,18 @@
  */
 int init_fw_service(const bool enable, const char * const fw_version, ccapi_fw_service_t **fw_service);
 
+/*
+ * install_scheduled_fw_update() - Apply a firmware update deferred to the
+ *                                 install window
+ *
+ * @path:	Absolute path of the package to install, NULL if the update is
+ * 		already installed and only the reboot is pending.
+ * @target:	Target number of the update.
+ *
+ * On success the device reboots.
+ *
+ * Returns: 0 on success, -1 otherwise.
+ */
+int install_scheduled_fw_update(const char *const path, int const target);
+
 #endif /* CC_FIRMWARE_UPDATE_H_ */
@@ -0,0 +1,715 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_cc_datapoints.h"
+#include "cc_firmware_update.h"
+#include "cc_fw_schedule.h"
+#include "cc_init.h"
+#include "cc_logging.h"
+
+#define FW_SCHEDULE_TAG			"FW SCHEDULE:"
+
+#define FW_SCHEDULE_FILE		"/etc/cccs.fwschedule"
+
+#define LOOP_MS				100
+#define CHECK_INTERVAL_MS		1000
+
+#define NOTICE_TIME			60 /* seconds */
+
+#define KEY_ACTION			"action"
+#define KEY_PATH			"path"
+#define KEY_TARGET			"target"
+#define KEY_POSTPONED_UNTIL		"postponed_until"
+#define KEY_POSTPONED			"postponed"
+
+#define DP_PENDING_UPDATE_STREAM_ID	"management/events/pending_update"
+
+#define TIME_BUFSIZE			25
+
+/**
+ * log_fs_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_fs_debug(format, ...)					\
+	log_debug("%s " format, FW_SCHEDULE_TAG, __VA_ARGS__)
+
+/**
+ * log_fs_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_fs_info(format, ...)					\
+	log_info("%s " format, FW_SCHEDULE_TAG, __VA_ARGS__)
+
+/**
+ * log_fs_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_fs_error(format, ...)					\
+	log_error("%s " format, FW_SCHEDULE_TAG, __VA_ARGS__)
+
+/*
+ * struct fw_schedule_t - Pending firmware update type
+ *
+ * @action:		Pending action
+ * @path:		Absolute path of the package to install, NULL if none
+ * @target:		Target number of the update
+ * @postponed_until:	Time the update is postponed until, 0 if not postponed
+ * @postponed:		Total seconds the update has been postponed
+ * @notice_time:	Time applications were notified the update is
+ * 			imminent, 0 if not notified yet
+ * @installing:		True if the update is being applied
+ * @failed:		True if the last update failed to be applied
+ */
+typedef struct {
+	fw_schedule_action_t action;
+	char *path;
+	int target;
+	time_t postponed_until;
+	uint32_t postponed;
+	time_t notice_time;
+	bool installing;
+	bool failed;
+} fw_schedule_t;
+
+static volatile bool stop_requested = false;
+static volatile bool fs_thread_valid = false;
+static pthread_t fs_thread;
+
+static pthread_mutex_t schedule_lock = PTHREAD_MUTEX_INITIALIZER;
+static fw_schedule_t schedule = {
+	.action = FW_SCHEDULE_NONE,
+	.path = NULL,
+};
+static const cc_cfg_t *fs_cfg = NULL;
+static bool in_maintenance = false;
+/* Incremented on every status change, to know when to report it */
+static unsigned int status_id = 0;
+static unsigned int reported_id = 0;
+
+/*
+ * get_window() - Get the configured install window
+ *
+ * @start:	Minute of the day the window opens.
+ * @end:	Minute of the day the window closes.
+ *
+ * Return: True if a window is configured, false otherwise.
+ */
+static bool get_window(int *start, int *end)
+{
+	int h1, m1, h2, m2;
+
+	if (fs_cfg == NULL || fs_cfg->fw_install_window == NULL
+		|| sscanf(fs_cfg->fw_install_window, "%d:%d-%d:%d", &h1, &m1, &h2, &m2) != 4)
+		return false;
+
+	*start = h1 * 60 + m1;
+	*end = h2 * 60 + m2;
+
+	return true;
+}
+
+/*
+ * is_in_window() - Check if the given time is inside the install window
+ *
+ * @t:	Time to check.
+ *
+ * Return: True if it is inside the window or there is no window configured,
+ *         false otherwise.
+ */
+static bool is_in_window(time_t t)
+{
+	int start, end, minute;
+	struct tm tm;
+
+	if (!get_window(&start, &end) || start == end)
+		return true;
+
+	localtime_r(&t, &tm);
+	minute = tm.tm_hour * 60 + tm.tm_min;
+
+	if (start < end)
+		return minute >= start && minute < end;
+
+	/* The window crosses midnight */
+	return minute >= start || minute < end;
+}
+
+/*
+ * get_window_start() - Get the first time inside the install window
+ *
+ * @t:	Time to start from.
+ *
+ * Return: The given time if it is inside the window, the time the window
+ *         opens next otherwise.
+ */
+static time_t get_window_start(time_t t)
+{
+	int start, end;
+	struct tm tm;
+	time_t next;
+
+	if (is_in_window(t) || !get_window(&start, &end))
+		return t;
+
+	localtime_r(&t, &tm);
+	tm.tm_hour = start / 60;
+	tm.tm_min = start % 60;
+	tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+	next = mktime(&tm);
+	if (next <= t) {
+		tm.tm_mday++;
+		tm.tm_isdst = -1;
+		next = mktime(&tm);
+	}
+
+	return next;
+}
+
+/*
+ * get_apply_time() - Get the time the pending update is expected to be applied
+ *
+ * @now:	Current time.
+ *
+ * Must be called with 'schedule_lock' held.
+ *
+ * Return: The expected time.
+ */
+static time_t get_apply_time(time_t now)
+{
+	time_t t = now > schedule.postponed_until ? now : schedule.postponed_until;
+
+	if (schedule.notice_time != 0)
+		return schedule.notice_time + NOTICE_TIME;
+
+	if (in_maintenance)
+		return t;
+
+	return get_window_start(t);
+}
+
+/*
+ * get_postpone_left() - Get the number of seconds the update can be postponed
+ *
+ * Must be called with 'schedule_lock' held.
+ *
+ * Return: The number of seconds.
+ */
+static uint32_t get_postpone_left(void)
+{
+	uint32_t max = fs_cfg != NULL ? fs_cfg->fw_postpone_max * 60 : 0;
+
+	return max > schedule.postponed ? max - schedule.postponed : 0;
+}
+
+/*
+ * format_time() - Format the given time as an ISO 8601 UTC string
+ *
+ * @t:		Time to format.
+ * @buf:	Buffer to store the string.
+ * @size:	Size of the buffer.
+ */
+static void format_time(time_t t, char *buf, size_t size)
+{
+	struct tm tm;
+
+	gmtime_r(&t, &tm);
+	strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+/*
+ * reset_schedule() - Discard the pending update information
+ *
+ * Must be called with 'schedule_lock' held.
+ */
+static void reset_schedule(void)
+{
+	schedule.action = FW_SCHEDULE_NONE;
+	free(schedule.path);
+	schedule.path = NULL;
+	schedule.target = 0;
+	schedule.postponed_until = 0;
+	schedule.postponed = 0;
+	schedule.notice_time = 0;
+	schedule.installing = false;
+}
+
+/*
+ * save_schedule() - Store the pending update so it survives a restart
+ *
+ * Must be called with 'schedule_lock' held.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int save_schedule(void)
+{
+	const char *tmp_file = FW_SCHEDULE_FILE ".tmp";
+	FILE *fp;
+
+	if (schedule.action == FW_SCHEDULE_NONE) {
+		if (remove(FW_SCHEDULE_FILE) != 0 && errno != ENOENT) {
+			log_fs_error("Unable to remove '%s': %s (%d)", FW_SCHEDULE_FILE,
+				strerror(errno), errno);
+			return -1;
+		}
+		return 0;
+	}
+
+	fp = fopen(tmp_file, "w");
+	if (fp == NULL) {
+		log_fs_error("Unable to create '%s': %s (%d)", tmp_file,
+			strerror(errno), errno);
+		return -1;
+	}
+
+	fprintf(fp, KEY_ACTION "=%d\n", schedule.action);
+	if (schedule.path != NULL)
+		fprintf(fp, KEY_PATH "=%s\n", schedule.path);
+	fprintf(fp, KEY_TARGET "=%d\n", schedule.target);
+	fprintf(fp, KEY_POSTPONED_UNTIL "=%lld\n", (long long) schedule.postponed_until);
+	fprintf(fp, KEY_POSTPONED "=%u\n", schedule.postponed);
+
+	if (fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		log_fs_error("Unable to write '%s': %s (%d)", tmp_file,
+			strerror(errno), errno);
+		fclose(fp);
+		remove(tmp_file);
+		return -1;
+	}
+	fclose(fp);
+
+	if (rename(tmp_file, FW_SCHEDULE_FILE) != 0) {
+		log_fs_error("Unable to save '%s': %s (%d)", FW_SCHEDULE_FILE,
+			strerror(errno), errno);
+		remove(tmp_file);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * load_schedule() - Load an update pending from a previous execution
+ */
+static void load_schedule(void)
+{
+	char *line = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	fp = fopen(FW_SCHEDULE_FILE, "r");
+	if (fp == NULL)
+		return;
+
+	pthread_mutex_lock(&schedule_lock);
+
+	reset_schedule();
+
+	while (getline(&line, &len, fp) != -1) {
+		char *value = strchr(line, '=');
+
+		if (value == NULL)
+			continue;
+		*value++ = '\0';
+		value[strcspn(value, "\n")] = '\0';
+
+		if (strcmp(line, KEY_ACTION) == 0) {
+			schedule.action = strtol(value, NULL, 10);
+		} else if (strcmp(line, KEY_PATH) == 0) {
+			free(schedule.path);
+			schedule.path = strdup(value);
+		} else if (strcmp(line, KEY_TARGET) == 0) {
+			schedule.target = strtol(value, NULL, 10);
+		} else if (strcmp(line, KEY_POSTPONED_UNTIL) == 0) {
+			schedule.postponed_until = strtoll(value, NULL, 10);
+		} else if (strcmp(line, KEY_POSTPONED) == 0) {
+			schedule.postponed = strtoul(value, NULL, 10);
+		}
+	}
+
+	free(line);
+	fclose(fp);
+
+	if (schedule.action != FW_SCHEDULE_INSTALL && schedule.action != FW_SCHEDULE_REBOOT) {
+		log_fs_error("Invalid pending firmware update in '%s', discarding it",
+			FW_SCHEDULE_FILE);
+		reset_schedule();
+	} else if (schedule.action == FW_SCHEDULE_INSTALL
+		&& (schedule.path == NULL || access(schedule.path, R_OK) != 0)) {
+		log_fs_error("Pending firmware package '%s' not found, discarding update",
+			schedule.path != NULL ? schedule.path : "");
+		reset_schedule();
+	} else {
+		char buf[TIME_BUFSIZE] = {0};
+
+		format_time(get_apply_time(time(NULL)), buf, sizeof(buf));
+		log_fs_info("Resuming pending firmware update (target '%d'), expected at %s",
+			schedule.target, buf);
+	}
+
+	if (schedule.action == FW_SCHEDULE_NONE)
+		save_schedule();
+	status_id++;
+
+	pthread_mutex_unlock(&schedule_lock);
+}
+
+/*
+ * get_status_json() - Generate the pending update status to report
+ *
+ * Must be called with 'schedule_lock' held.
+ *
+ * Memory for the string is obtained with 'malloc' and can be freed with 'free'.
+ *
+ * Return: The JSON string, NULL if out of memory.
+ */
+static char *get_status_json(void)
+{
+	char apply_time[TIME_BUFSIZE] = {0};
+	const char *status;
+	char *json = NULL;
+	time_t now = time(NULL);
+
+	if (schedule.action == FW_SCHEDULE_NONE) {
+		if (asprintf(&json, "{\"status\": \"%s\"}",
+			schedule.failed ? "failed" : "none") < 0)
+			return NULL;
+
+		return json;
+	}
+
+	if (schedule.installing)
+		status = "installing";
+	else if (schedule.notice_time != 0)
+		status = "imminent";
+	else if (schedule.postponed_until > now)
+		status = "postponed";
+	else
+		status = "scheduled";
+
+	format_time(get_apply_time(now), apply_time, sizeof(apply_time));
+
+	if (asprintf(&json,
+		"{\"status\": \"%s\", \"action\": \"%s\", \"target\": %d, \"apply_time\": \"%s\", \"postpone_left\": %u}",
+		status, schedule.action == FW_SCHEDULE_INSTALL ? "install" : "reboot",
+		schedule.target, apply_time, get_postpone_left()) < 0)
+		return NULL;
+
+	return json;
+}
+
+/*
+ * apply_fw_update() - Install the pending update and reboot
+ */
+static void apply_fw_update(void)
+{
+	char *path = NULL;
+	int target;
+
+	pthread_mutex_lock(&schedule_lock);
+	path = schedule.path != NULL ? strdup(schedule.path) : NULL;
+	target = schedule.target;
+	/* Remove it before installing, the device reboots afterwards */
+	remove(FW_SCHEDULE_FILE);
+	pthread_mutex_unlock(&schedule_lock);
+
+	log_fs_info("Applying scheduled firmware update (target '%d')", target);
+
+	if (install_scheduled_fw_update(path, target) != 0) {
+		log_fs_error("Unable to apply scheduled firmware update (target '%d')",
+			target);
+		pthread_mutex_lock(&schedule_lock);
+		reset_schedule();
+		schedule.failed = true;
+		status_id++;
+		pthread_mutex_unlock(&schedule_lock);
+	}
+
+	free(path);
+}
+
+/*
+ * fw_schedule_loop() - Apply pending updates inside the install window
+ */
+static void fw_schedule_loop(void)
+{
+	while (!stop_requested) {
+		char *report = NULL;
+		bool apply = false;
+		unsigned int id;
+		time_t now = time(NULL);
+		long loop;
+
+		pthread_mutex_lock(&schedule_lock);
+
+		if (schedule.action != FW_SCHEDULE_NONE && !schedule.installing) {
+			if (now >= schedule.postponed_until && (in_maintenance || is_in_window(now))) {
+				if (schedule.notice_time == 0) {
+					/* Give applications the chance to postpone it */
+					log_fs_info("Firmware update will be applied in %d seconds",
+						NOTICE_TIME);
+					schedule.notice_time = now;
+					status_id++;
+				} else if (now - schedule.notice_time >= NOTICE_TIME) {
+					schedule.installing = true;
+					status_id++;
+					apply = true;
+				}
+			} else if (schedule.notice_time != 0) {
+				/* Maintenance finished or window closed while notifying */
+				schedule.notice_time = 0;
+				status_id++;
+			}
+		}
+
+		id = status_id;
+		if (id != reported_id && get_cloud_connection_status() == CC_STATUS_CONNECTED)
+			report = get_status_json();
+
+		pthread_mutex_unlock(&schedule_lock);
+
+		if (report != NULL) {
+			if (dp_send_json_event(DP_PENDING_UPDATE_STREAM_ID, report) == 0) {
+				pthread_mutex_lock(&schedule_lock);
+				reported_id = id;
+				pthread_mutex_unlock(&schedule_lock);
+			}
+			free(report);
+		}
+
+		if (apply)
+			apply_fw_update();
+
+		for (loop = 0; loop < CHECK_INTERVAL_MS / LOOP_MS; loop++) {
+			struct timespec sleep_value = {
+				.tv_sec = 0,
+				.tv_nsec = LOOP_MS * 1000 * 1000
+			};
+
+			if (stop_requested)
+				break;
+
+			nanosleep(&sleep_value, NULL);
+		}
+	}
+}
+
+/*
+ * fw_schedule_threaded() - Manage pending updates in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *fw_schedule_threaded(void *unused)
+{
+	UNUSED_ARGUMENT(unused);
+
+	fw_schedule_loop();
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+int start_fw_schedule(const cc_cfg_t *const cc_cfg)
+{
+	if (fs_thread_valid)
+		return 0;
+
+	fs_cfg = cc_cfg;
+
+	load_schedule();
+
+	stop_requested = false;
+	fs_thread_valid = (pthread_create(&fs_thread, NULL, fw_schedule_threaded, NULL) == 0);
+	if (!fs_thread_valid) {
+		log_fs_error("%s", "Unable to start firmware schedule thread");
+		return 1;
+	}
+
+	return 0;
+}
+
+void stop_fw_schedule(void)
+{
+	stop_requested = true;
+
+	/* Do not cancel the thread, it may be installing an update */
+	if (fs_thread_valid) {
+		fs_thread_valid = false;
+		pthread_join(fs_thread, NULL);
+	}
+}
+
+int schedule_fw_update(fw_schedule_action_t action, const char *const path, int target)
+{
+	char buf[TIME_BUFSIZE] = {0};
+	char *new_path = NULL;
+	int ret = 0;
+
+	if (path != NULL) {
+		new_path = strdup(path);
+		if (new_path == NULL) {
+			log_fs_error("Unable to schedule firmware update: %s", "Out of memory");
+			return -1;
+		}
+	}
+
+	pthread_mutex_lock(&schedule_lock);
+
+	if (schedule.installing) {
+		log_fs_error("%s", "Unable to schedule firmware update: another update is being applied");
+		free(new_path);
+		ret = -1;
+		goto done;
+	}
+
+	/* The new update replaces the previous one */
+	if (schedule.path != NULL && (new_path == NULL || strcmp(schedule.path, new_path) != 0))
+		remove(schedule.path);
+
+	reset_schedule();
+	schedule.action = action;
+	schedule.path = new_path;
+	schedule.target = target;
+	schedule.failed = false;
+	status_id++;
+
+	if (save_schedule() != 0) {
+		reset_schedule();
+		ret = -1;
+		goto done;
+	}
+
+	format_time(get_apply_time(time(NULL)), buf, sizeof(buf));
+	log_fs_info("Firmware update scheduled (target '%d'), expected at %s",
+		target, buf);
+
+done:
+	pthread_mutex_unlock(&schedule_lock);
+
+	return ret;
+}
+
+int cancel_fw_schedule(void)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&schedule_lock);
+
+	if (schedule.installing) {
+		ret = -1;
+		goto done;
+	}
+
+	if (schedule.action == FW_SCHEDULE_NONE)
+		goto done;
+
+	log_fs_info("Discarding pending firmware update (target '%d')", schedule.target);
+
+	if (schedule.path != NULL)
+		remove(schedule.path);
+
+	reset_schedule();
+	save_schedule();
+	status_id++;
+
+done:
+	pthread_mutex_unlock(&schedule_lock);
+
+	return ret;
+}
+
+void get_fw_schedule_status(fw_schedule_status_t *status)
+{
+	pthread_mutex_lock(&schedule_lock);
+
+	status->action = schedule.action;
+	if (schedule.action == FW_SCHEDULE_NONE) {
+		status->imminent = false;
+		status->apply_time = 0;
+		status->postpone_left = 0;
+	} else {
+		status->imminent = schedule.installing || schedule.notice_time != 0;
+		status->apply_time = get_apply_time(time(NULL));
+		status->postpone_left = get_postpone_left();
+	}
+
+	pthread_mutex_unlock(&schedule_lock);
+}
+
+int postpone_fw_update(uint32_t seconds, time_t *until)
+{
+	uint32_t granted;
+	int ret = 0;
+
+	pthread_mutex_lock(&schedule_lock);
+
+	if (schedule.action == FW_SCHEDULE_NONE || schedule.installing) {
+		ret = -1;
+		goto done;
+	}
+
+	granted = get_postpone_left();
+	if (seconds < granted)
+		granted = seconds;
+	if (granted == 0) {
+		ret = -1;
+		goto done;
+	}
+
+	/* Delay the update from the time it was going to be applied */
+	schedule.postponed_until = get_apply_time(time(NULL)) + granted;
+	schedule.postponed += granted;
+	schedule.notice_time = 0;
+	status_id++;
+	save_schedule();
+
+	*until = schedule.postponed_until;
+
+	log_fs_info("Firmware update postponed %u seconds", granted);
+
+done:
+	pthread_mutex_unlock(&schedule_lock);
+
+	return ret;
+}
+
+void set_fw_schedule_maintenance(bool status)
+{
+	pthread_mutex_lock(&schedule_lock);
+	if (in_maintenance != status) {
+		in_maintenance = status;
+		status_id++;
+	}
+	pthread_mutex_unlock(&schedule_lock);
+}
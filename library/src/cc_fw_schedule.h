@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_FW_SCHEDULE_H_
+#define CC_FW_SCHEDULE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "cc_config.h"
+
+/*
+ * Pending firmware update actions. Values are sent as they are to the
+ * services clients, keep them in sync with 'cccs_fw_update_action_t'.
+ */
+typedef enum {
+	FW_SCHEDULE_NONE,
+	FW_SCHEDULE_INSTALL,
+	FW_SCHEDULE_REBOOT,
+} fw_schedule_action_t;
+
+/*
+ * struct fw_schedule_status_t - Pending firmware update status type
+ *
+ * @action:		Pending action, FW_SCHEDULE_NONE if there is no update
+ * @imminent:		True if the update is about to be applied
+ * @apply_time:		Expected time to apply the update
+ * @postpone_left:	Seconds the update can still be postponed
+ */
+typedef struct {
+	fw_schedule_action_t action;
+	bool imminent;
+	time_t apply_time;
+	uint32_t postpone_left;
+} fw_schedule_status_t;
+
+/*
+ * start_fw_schedule() - Start the scheduled firmware update manager
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * Loads any update pending from a previous execution and applies it when the
+ * configured 'firmware_install_window' opens.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int start_fw_schedule(const cc_cfg_t *const cc_cfg);
+
+/*
+ * stop_fw_schedule() - Stop the scheduled firmware update manager
+ *
+ * Pending updates are kept and resumed on next start.
+ */
+void stop_fw_schedule(void);
+
+/*
+ * schedule_fw_update() - Defer a firmware update to the install window
+ *
+ * @action:	FW_SCHEDULE_INSTALL to install the package and reboot,
+ * 		FW_SCHEDULE_REBOOT to reboot into an already installed system.
+ * @path:	Absolute path of the package to install, NULL for
+ * 		FW_SCHEDULE_REBOOT.
+ * @target:	Target number of the update.
+ *
+ * Any previous pending update is replaced.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int schedule_fw_update(fw_schedule_action_t action, const char *const path, int target);
+
+/*
+ * cancel_fw_schedule() - Discard the pending firmware update
+ *
+ * The package of a pending install is removed.
+ *
+ * Return: 0 on success, -1 if the update is already being applied.
+ */
+int cancel_fw_schedule(void);
+
+/*
+ * get_fw_schedule_status() - Get the status of the pending firmware update
+ *
+ * @status:	Struct to store the status.
+ */
+void get_fw_schedule_status(fw_schedule_status_t *status);
+
+/*
+ * postpone_fw_update() - Postpone the pending firmware update
+ *
+ * @seconds:	Number of seconds to postpone the update.
+ * @until:	Time the update is postponed until.
+ *
+ * The postponement is limited by the 'firmware_postpone_max' setting, so the
+ * granted time may be less than requested.
+ *
+ * Return: 0 on success, -1 if there is no pending update or it cannot be
+ *         postponed anymore.
+ */
+int postpone_fw_update(uint32_t seconds, time_t *until);
+
+/*
+ * set_fw_schedule_maintenance() - Notify the device maintenance status
+ *
+ * @status:	True if the device is in maintenance, false otherwise.
+ *
+ * While the device is in maintenance, pending updates are applied without
+ * waiting for the install window.
+ */
+void set_fw_schedule_maintenance(bool status);
+
+#endif /* CC_FW_SCHEDULE_H_ */
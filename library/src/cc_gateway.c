@@ -0,0 +1,1063 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <json_object.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_cc_datapoints.h"
+#include "cc_clock.h"
+#include "cc_gateway.h"
+#include "cc_init.h"
+#include "cc_logging.h"
+#include "service_common.h"
+#include "services-client/dp_csv_parser.h"
+#include "_utils.h"
+
+#define GW_TAG				"GW:"
+
+#define MAX_CHILD_ID_LEN		64
+
+/* Data stream of the status of a child: children/<child_id>/status */
+#define DP_CHILD_STATUS_STREAM		"status"
+
+/* Directory of the children backlogs inside the data backlog path */
+#define CHILDREN_BACKLOG_DIR		"children"
+
+#define LOOP_SEC			1
+#define MIN_DRAIN_INTERVAL		5	/* seconds */
+#define MAX_DRAIN_INTERVAL		300	/* seconds */
+
+/**
+ * log_gw_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_gw_debug(format, ...)					\
+	log_debug("%s " format, GW_TAG, __VA_ARGS__)
+
+/**
+ * log_gw_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_gw_info(format, ...)					\
+	log_info("%s " format, GW_TAG, __VA_ARGS__)
+
+/**
+ * log_gw_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_gw_error(format, ...)					\
+	log_error("%s " format, GW_TAG, __VA_ARGS__)
+
+/*
+ * struct gw_child_t - Registered child device
+ *
+ * @id:			Identifier of the child.
+ * @type:		Type of the child.
+ * @online:		True if the child is online.
+ * @removed:		True if the child was unregistered and its offline
+ *			status is pending to be sent.
+ * @status_pending:	True if the status must be sent to Remote Manager.
+ * @last_seen_ms:	Monotonic time of the last activity of the child.
+ * @tokens:		Bytes the child can upload before exceeding its rate.
+ * @last_refill_ms:	Monotonic time of the last refill of 'tokens'.
+ * @bytes_sent:		Bytes of data points uploaded, live or from the backlog.
+ * @bytes_delayed:	Bytes of data points stored in the backlog for being
+ *			over the upload rate.
+ * @bytes_failed:	Bytes of data points that failed to upload.
+ * @requests:		Number of data requests received for the child.
+ * @next:		Next child.
+ */
+typedef struct gw_child {
+	char id[MAX_CHILD_ID_LEN + 1];
+	char *type;
+	bool online;
+	bool removed;
+	bool status_pending;
+	uint64_t last_seen_ms;
+	uint64_t tokens;
+	uint64_t last_refill_ms;
+	unsigned long long bytes_sent;
+	unsigned long long bytes_delayed;
+	unsigned long long bytes_failed;
+	unsigned long requests;
+	struct gw_child *next;
+} gw_child_t;
+
+/*
+ * struct gw_status_t - Status of a child to send to Remote Manager
+ *
+ * @id:			Identifier of the child.
+ * @type:		Type of the child.
+ * @online:		True if the child is online.
+ */
+typedef struct {
+	char id[MAX_CHILD_ID_LEN + 1];
+	char *type;
+	bool online;
+} gw_status_t;
+
+static volatile bool stop_requested = false;
+static volatile bool gw_thread_valid = false;
+static pthread_t gw_thread;
+
+static pthread_mutex_t gw_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when there is a status to send */
+static pthread_cond_t gw_cond = PTHREAD_COND_INITIALIZER;
+static gw_child_t *children = NULL;
+static unsigned int n_children = 0;
+
+/* Settings copied when the gateway starts */
+static unsigned int max_children = 0;
+static uint32_t child_timeout = 0;
+static uint32_t child_rate_kb = 0;
+static char *backlog_path = NULL;
+static uint32_t backlog_kb = 0;
+
+/*
+ * get_monotonic_ms() - Get the milliseconds since an unspecified point
+ *
+ * Return: Number of milliseconds.
+ */
+static uint64_t get_monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+bool gateway_valid_child_id(const char *child_id)
+{
+	size_t len;
+
+	if (child_id == NULL || child_id[0] == '.')
+		return false;
+
+	len = strspn(child_id, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.");
+
+	return len > 0 && len <= MAX_CHILD_ID_LEN && child_id[len] == '\0';
+}
+
+/*
+ * find_child() - Find a registered child
+ *
+ * @child_id:	Identifier of the child.
+ *
+ * Must be called with 'gw_lock' held.
+ *
+ * Return: The child, NULL if it is not registered.
+ */
+static gw_child_t *find_child(const char *child_id)
+{
+	gw_child_t *child;
+
+	for (child = children; child != NULL; child = child->next) {
+		if (!child->removed && strcmp(child->id, child_id) == 0)
+			return child;
+	}
+
+	return NULL;
+}
+
+/*
+ * free_child() - Remove a child from the list and free it
+ *
+ * @child:	Child to free.
+ *
+ * Must be called with 'gw_lock' held.
+ */
+static void free_child(gw_child_t *child)
+{
+	gw_child_t **c;
+
+	for (c = &children; *c != NULL; c = &(*c)->next) {
+		if (*c == child) {
+			*c = child->next;
+			break;
+		}
+	}
+
+	free(child->type);
+	free(child);
+}
+
+/*
+ * rate_capacity() - Maximum number of bytes a child can upload in a burst
+ *
+ * Return: One minute of data at the configured rate.
+ */
+static uint64_t rate_capacity(void)
+{
+	return (uint64_t) child_rate_kb * 1024;
+}
+
+/*
+ * refill_tokens() - Refill the upload tokens of a child
+ *
+ * @child:	Child to refill.
+ * @now_ms:	Current monotonic time.
+ *
+ * Must be called with 'gw_lock' held.
+ */
+static void refill_tokens(gw_child_t *child, uint64_t now_ms)
+{
+	uint64_t elapsed_ms = now_ms - child->last_refill_ms;
+
+	if (elapsed_ms >= 60 * 1000)
+		child->tokens = rate_capacity();
+	else
+		child->tokens += elapsed_ms * child_rate_kb * 1024 / (60 * 1000);
+	if (child->tokens > rate_capacity())
+		child->tokens = rate_capacity();
+	child->last_refill_ms = now_ms;
+}
+
+/*
+ * set_online() - Set the online state of a child
+ *
+ * @child:	Child to update.
+ * @online:	True if the child is online, false otherwise.
+ *
+ * Must be called with 'gw_lock' held.
+ */
+static void set_online(gw_child_t *child, bool online)
+{
+	if (online)
+		child->last_seen_ms = get_monotonic_ms();
+
+	if (child->online == online)
+		return;
+
+	log_gw_info("Child '%s' is %s", child->id, online ? "online" : "offline");
+
+	child->online = online;
+	child->status_pending = true;
+	pthread_cond_signal(&gw_cond);
+}
+
+int gateway_register_child(const char *child_id, const char *type)
+{
+	gw_child_t *child;
+	char *new_type;
+	int ret = 0;
+
+	if (!gateway_valid_child_id(child_id))
+		return -EINVAL;
+
+	new_type = strdup(type != NULL ? type : "");
+	if (new_type == NULL)
+		return -1;
+
+	pthread_mutex_lock(&gw_lock);
+
+	if (!gw_thread_valid) {
+		ret = -EPERM;
+		goto done;
+	}
+
+	child = find_child(child_id);
+	if (child == NULL) {
+		gw_child_t **last;
+
+		if (n_children >= max_children) {
+			ret = -ENOSPC;
+			goto done;
+		}
+
+		child = calloc(1, sizeof(*child));
+		if (child == NULL) {
+			ret = -1;
+			goto done;
+		}
+		strcpy(child->id, child_id);
+		child->tokens = rate_capacity();
+		child->last_refill_ms = get_monotonic_ms();
+
+		for (last = &children; *last != NULL; last = &(*last)->next)
+			;
+		*last = child;
+		n_children++;
+
+		log_gw_info("Registered child '%s' (%s)", child_id, new_type);
+	}
+
+	if (child->type == NULL || strcmp(child->type, new_type) != 0)
+		child->status_pending = true;
+	free(child->type);
+	child->type = new_type;
+	new_type = NULL;
+
+	set_online(child, true);
+	pthread_cond_signal(&gw_cond);
+
+done:
+	pthread_mutex_unlock(&gw_lock);
+
+	free(new_type);
+
+	return ret;
+}
+
+int gateway_unregister_child(const char *child_id)
+{
+	gw_child_t *child;
+	int ret = -ENOENT;
+
+	pthread_mutex_lock(&gw_lock);
+
+	child = find_child(child_id);
+	if (child != NULL) {
+		log_gw_info("Unregistered child '%s'", child_id);
+
+		set_online(child, false);
+		/* Keep it until its offline status is sent */
+		if (child->status_pending)
+			child->removed = true;
+		else
+			free_child(child);
+		n_children--;
+		ret = 0;
+	}
+
+	pthread_mutex_unlock(&gw_lock);
+
+	return ret;
+}
+
+int gateway_set_child_state(const char *child_id, bool online)
+{
+	gw_child_t *child;
+	int ret = -ENOENT;
+
+	pthread_mutex_lock(&gw_lock);
+
+	child = find_child(child_id);
+	if (child != NULL) {
+		set_online(child, online);
+		ret = 0;
+	}
+
+	pthread_mutex_unlock(&gw_lock);
+
+	return ret;
+}
+
+/*
+ * find_stream_id() - Find the stream id field of a CSV record
+ *
+ * @record:	Record as generated by 'generate_dp_csv()'.
+ * @length:	Number of bytes of the record.
+ *
+ * Return: Offset of the stream id value inside the record (after its opening
+ *         quote if it is quoted), -1 if the record does not have it.
+ */
+static long find_stream_id(const char *record, size_t length)
+{
+	bool quoted = false, escaped = false;
+	unsigned int field = csv_data;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		char const c = record[i];
+
+		if (escaped) {
+			escaped = false;
+		} else if (quoted && c == '\\') {
+			escaped = true;
+		} else if (c == '\"') {
+			quoted = !quoted;
+		} else if (!quoted && c == '\n') {
+			break;
+		} else if (!quoted && c == ',' && ++field == csv_stream_id) {
+			if (i + 1 < length && record[i + 1] == '\"')
+				i++;
+
+			return (long) i + 1;
+		}
+	}
+
+	return -1;
+}
+
+char *gateway_child_csv(const char *child_id, const char *csv, size_t size, size_t *out_size)
+{
+	char prefix[sizeof(GW_CHILD_STREAM_PREFIX) + MAX_CHILD_ID_LEN + 1];
+	size_t prefix_len, n_records = 0, offset, len = 0;
+	char *out;
+
+	if (!gateway_valid_child_id(child_id) || csv == NULL || size == 0)
+		return NULL;
+
+	prefix_len = (size_t) snprintf(prefix, sizeof(prefix), GW_CHILD_STREAM_PREFIX "%s/", child_id);
+
+	for (offset = 0; offset < size; offset += dp_csv_record_length(csv + offset, size - offset))
+		n_records++;
+
+	out = malloc(size + n_records * prefix_len + 1);
+	if (out == NULL) {
+		log_gw_error("Unable to upload data points of child '%s': %s", child_id, "Out of memory");
+		return NULL;
+	}
+
+	for (offset = 0; offset < size; ) {
+		const char *record = csv + offset;
+		size_t record_len = dp_csv_record_length(record, size - offset);
+		long stream_offset;
+
+		offset += record_len;
+
+		/* Keep empty lines */
+		if (record_len == 1 && record[0] == '\n') {
+			out[len++] = '\n';
+			continue;
+		}
+
+		stream_offset = find_stream_id(record, record_len);
+		if (stream_offset < 0) {
+			log_gw_error("Unable to upload data points of child '%s': %s", child_id, "Invalid CSV");
+			free(out);
+			return NULL;
+		}
+
+		memcpy(out + len, record, (size_t) stream_offset);
+		len += (size_t) stream_offset;
+		memcpy(out + len, prefix, prefix_len);
+		len += prefix_len;
+		memcpy(out + len, record + stream_offset, record_len - (size_t) stream_offset);
+		len += record_len - (size_t) stream_offset;
+	}
+
+	out[len] = '\0';
+	*out_size = len;
+
+	return out;
+}
+
+int gateway_child_upload_allowed(const char *child_id, size_t size)
+{
+	gw_child_t *child;
+	int ret = -ENOENT;
+
+	pthread_mutex_lock(&gw_lock);
+
+	child = find_child(child_id);
+	if (child == NULL)
+		goto done;
+
+	set_online(child, true);
+
+	ret = 1;
+	if (child_rate_kb == 0)
+		goto done;
+
+	refill_tokens(child, get_monotonic_ms());
+
+	/* A full bucket always allows one upload, whatever its size */
+	if (child->tokens < size && child->tokens < rate_capacity()) {
+		ret = 0;
+		goto done;
+	}
+
+	child->tokens = child->tokens > size ? child->tokens - size : 0;
+
+done:
+	pthread_mutex_unlock(&gw_lock);
+
+	return ret;
+}
+
+/*
+ * get_child_backlog_path() - Get the data backlog path of a child
+ *
+ * @child_id:	Identifier of the child.
+ *
+ * Return: The absolute path, it must be freed. NULL if the data backlog is
+ *         disabled or out of memory.
+ */
+static char *get_child_backlog_path(const char *child_id)
+{
+	char *path = NULL;
+
+	if (backlog_path == NULL || strlen(backlog_path) == 0 || backlog_kb == 0)
+		return NULL;
+
+	if (asprintf(&path, "%s/" CHILDREN_BACKLOG_DIR "/%s", backlog_path, child_id) < 0) {
+		log_gw_error("Unable to get backlog of child '%s': %s", child_id, "Out of memory");
+		return NULL;
+	}
+
+	return path;
+}
+
+int gateway_store_child_data(const char *child_id, const char *csv, size_t size,
+	unsigned int error)
+{
+	char *path = get_child_backlog_path(child_id);
+	int ret;
+
+	if (path == NULL)
+		return 1;
+
+	if (error == 0)
+		ret = dp_store_data(upload_datapoint_file_metrics, csv, size,
+			NULL, path, backlog_kb);
+	else
+		ret = dp_process_send_dp_error(upload_datapoint_file_metrics, error,
+			csv, size, NULL, path, backlog_kb);
+
+	free(path);
+
+	return ret;
+}
+
+void gateway_account_upload(const char *child_id, size_t size, gw_upload_result_t result)
+{
+	gw_child_t *child;
+
+	pthread_mutex_lock(&gw_lock);
+
+	child = find_child(child_id);
+	if (child != NULL) {
+		switch (result) {
+			case GW_UPLOAD_SENT:
+				child->bytes_sent += size;
+				break;
+			case GW_UPLOAD_DELAYED:
+				child->bytes_delayed += size;
+				break;
+			case GW_UPLOAD_FAILED:
+				child->bytes_failed += size;
+				break;
+		}
+	}
+
+	pthread_mutex_unlock(&gw_lock);
+}
+
+bool gateway_target_available(const char *target)
+{
+	char child_id[MAX_CHILD_ID_LEN + 1];
+	const char *id, *end;
+	gw_child_t *child;
+	bool available = false;
+
+	if (!gw_thread_valid || strncmp(target, GW_CHILD_TARGET_PREFIX, strlen(GW_CHILD_TARGET_PREFIX)) != 0)
+		return true;
+
+	id = target + strlen(GW_CHILD_TARGET_PREFIX);
+	end = strchr(id, '/');
+	if (end == NULL || end == id || (size_t) (end - id) > MAX_CHILD_ID_LEN)
+		return false;
+
+	memcpy(child_id, id, (size_t) (end - id));
+	child_id[end - id] = '\0';
+
+	pthread_mutex_lock(&gw_lock);
+
+	child = find_child(child_id);
+	if (child != NULL) {
+		child->requests++;
+		available = child->online;
+	}
+
+	pthread_mutex_unlock(&gw_lock);
+
+	if (!available)
+		log_gw_error("Rejecting data request '%s': Child '%s' is not available",
+			target, child_id);
+
+	return available;
+}
+
+/*
+ * check_timeouts() - Set offline the children without recent activity
+ */
+static void check_timeouts(void)
+{
+	uint64_t now_ms = get_monotonic_ms();
+	gw_child_t *child;
+
+	if (child_timeout == 0)
+		return;
+
+	pthread_mutex_lock(&gw_lock);
+
+	for (child = children; child != NULL; child = child->next) {
+		if (!child->removed && child->online
+			&& now_ms - child->last_seen_ms > child_timeout * 1000ULL)
+			set_online(child, false);
+	}
+
+	pthread_mutex_unlock(&gw_lock);
+}
+
+/*
+ * send_child_status() - Send a child status to Remote Manager
+ *
+ * @status:	Status to send.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int send_child_status(const gw_status_t *status)
+{
+	json_object *obj = json_object_new_object();
+	char *stream = NULL;
+	int ret = -1;
+
+	if (obj == NULL
+		|| json_object_object_add(obj, "online", json_object_new_boolean(status->online)) != 0
+		|| json_object_object_add(obj, "type", json_object_new_string(status->type)) != 0
+		|| asprintf(&stream, GW_CHILD_STREAM_PREFIX "%s/" DP_CHILD_STATUS_STREAM, status->id) < 0) {
+		log_gw_error("Unable to send status of child '%s': %s", status->id, "Out of memory");
+		stream = NULL;
+		goto done;
+	}
+
+	ret = dp_send_json_event(stream, json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN));
+
+done:
+	json_object_put(obj);
+	free(stream);
+
+	return ret;
+}
+
+/*
+ * send_pending_status() - Send the status of the children that changed
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int send_pending_status(void)
+{
+	gw_status_t *pending = NULL;
+	unsigned int n_pending = 0, n = 0, i;
+	gw_child_t *child;
+	int ret = 0;
+
+	pthread_mutex_lock(&gw_lock);
+
+	for (child = children; child != NULL; child = child->next) {
+		if (child->status_pending)
+			n++;
+	}
+
+	if (n > 0)
+		pending = calloc(n, sizeof(*pending));
+
+	for (child = children; pending != NULL && child != NULL; child = child->next) {
+		if (!child->status_pending)
+			continue;
+
+		pending[n_pending].type = strdup(child->type != NULL ? child->type : "");
+		if (pending[n_pending].type == NULL)
+			break;
+		strcpy(pending[n_pending].id, child->id);
+		pending[n_pending].online = child->online;
+		n_pending++;
+	}
+
+	pthread_mutex_unlock(&gw_lock);
+
+	for (i = 0; i < n_pending && !stop_requested; i++) {
+		if (send_child_status(&pending[i]) != 0) {
+			ret = -1;
+			break;
+		}
+
+		pthread_mutex_lock(&gw_lock);
+		for (child = children; child != NULL; child = child->next) {
+			if (strcmp(child->id, pending[i].id) != 0 || child->online != pending[i].online)
+				continue;
+
+			child->status_pending = false;
+			if (child->removed) {
+				free_child(child);
+				break;
+			}
+		}
+		pthread_mutex_unlock(&gw_lock);
+	}
+
+	for (i = 0; i < n_pending; i++)
+		free(pending[i].type);
+	free(pending);
+
+	return ret;
+}
+
+/*
+ * drain_child_backlog() - Upload the oldest stored data of a child
+ *
+ * @child_id:	Identifier of the child.
+ * @path:	Absolute path of the backlog of the child.
+ *
+ * Return: 0 if success, any other value otherwise.
+ */
+static int drain_child_backlog(const char *child_id, const char *path)
+{
+	unsigned long long size_before = 0, size_after = 0;
+	gw_child_t *child;
+	bool registered;
+	int ret;
+
+	pthread_mutex_lock(&gw_lock);
+	child = find_child(child_id);
+	registered = child != NULL;
+	if (registered && child_rate_kb > 0) {
+		refill_tokens(child, get_monotonic_ms());
+		if (child->tokens == 0) {
+			/* The child already used its rate */
+			pthread_mutex_unlock(&gw_lock);
+			return 0;
+		}
+	}
+	pthread_mutex_unlock(&gw_lock);
+
+	get_directory_size(path, &size_before);
+
+	ret = dp_send_stored_data(path);
+	if (ret != 0)
+		return ret;
+
+	get_directory_size(path, &size_after);
+
+	if (size_before > size_after) {
+		size_t sent = (size_t) (size_before - size_after);
+
+		pthread_mutex_lock(&gw_lock);
+		child = find_child(child_id);
+		if (child != NULL) {
+			child->bytes_sent += sent;
+			child->tokens = child->tokens > sent ? child->tokens - sent : 0;
+		}
+		pthread_mutex_unlock(&gw_lock);
+	} else if (!registered) {
+		char *dir = NULL;
+
+		/* Remove the empty backlog of an unregistered child */
+		if (asprintf(&dir, "%s/cccs", path) >= 0) {
+			rmdir(dir);
+			free(dir);
+		}
+		rmdir(path);
+	}
+
+	return 0;
+}
+
+/*
+ * drain_backlogs() - Upload stored data of every child
+ *
+ * One file of each child is uploaded per call, so a child with a big backlog
+ * does not delay the data of the others.
+ *
+ * Return: 0 if success, -1 otherwise.
+ */
+static int drain_backlogs(void)
+{
+	struct dirent **entry_list = NULL;
+	char *children_dir = NULL;
+	int n_entries, i, ret = 0;
+
+	if (asprintf(&children_dir, "%s/" CHILDREN_BACKLOG_DIR, backlog_path) < 0) {
+		log_gw_error("Unable to upload stored data: %s", "Out of memory");
+		return -1;
+	}
+
+	n_entries = scandir(children_dir, &entry_list, NULL, alphasort);
+	for (i = 0; i < n_entries && !stop_requested; i++) {
+		char *path = NULL;
+		struct stat st;
+
+		if (!gateway_valid_child_id(entry_list[i]->d_name))
+			continue;
+
+		if (asprintf(&path, "%s/%s", children_dir, entry_list[i]->d_name) < 0) {
+			log_gw_error("Unable to upload stored data: %s", "Out of memory");
+			ret = -1;
+			break;
+		}
+
+		if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)
+			&& drain_child_backlog(entry_list[i]->d_name, path) != 0)
+			ret = -1;
+
+		free(path);
+	}
+
+	if (entry_list) {
+		for (i = 0; i < n_entries; i++)
+			free(entry_list[i]);
+		free(entry_list);
+	}
+	free(children_dir);
+
+	return ret;
+}
+
+/*
+ * wait_for() - Wait until the given time passes or a status changes
+ *
+ * @sec:	Number of seconds to wait.
+ */
+static void wait_for(unsigned int sec)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += sec;
+
+	pthread_mutex_lock(&gw_lock);
+	if (!stop_requested)
+		pthread_cond_timedwait(&gw_cond, &gw_lock, &ts);
+	pthread_mutex_unlock(&gw_lock);
+}
+
+/*
+ * gateway_threaded() - Track the children and upload their data in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *gateway_threaded(void *unused)
+{
+	uint32_t drain_interval = MIN_DRAIN_INTERVAL; /* seconds */
+	uint64_t next_drain_ms = get_monotonic_ms() + MIN_DRAIN_INTERVAL * 1000;
+
+	UNUSED_ARGUMENT(unused);
+
+	while (!stop_requested) {
+		check_timeouts();
+
+		if (get_cloud_connection_status() == CC_STATUS_CONNECTED) {
+			send_pending_status();
+
+			if (backlog_path != NULL && backlog_kb > 0 && clock_is_valid()
+				&& get_monotonic_ms() >= next_drain_ms) {
+				if (drain_backlogs() != 0) {
+					if (drain_interval < MAX_DRAIN_INTERVAL)
+						drain_interval *= 2;
+				} else {
+					drain_interval = MIN_DRAIN_INTERVAL;
+				}
+				next_drain_ms = get_monotonic_ms() + drain_interval * 1000;
+			}
+		}
+
+		wait_for(LOOP_SEC);
+	}
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+int start_gateway(const cc_cfg_t *const cc_cfg)
+{
+	if (!(cc_cfg->services & GATEWAY_SERVICE))
+		return 0;
+
+	if (gw_thread_valid)
+		return 0;
+
+	if (cc_cfg->data_backlog_path != NULL && strlen(cc_cfg->data_backlog_path) > 0) {
+		backlog_path = strdup(cc_cfg->data_backlog_path);
+		if (backlog_path == NULL) {
+			log_gw_error("Unable to start gateway: %s", "Out of memory");
+			return 1;
+		}
+	}
+	backlog_kb = cc_cfg->gw_child_backlog_kb;
+	max_children = cc_cfg->gw_max_children;
+	child_timeout = cc_cfg->gw_child_timeout;
+	child_rate_kb = cc_cfg->gw_child_rate_kb;
+
+	pthread_mutex_lock(&gw_lock);
+	stop_requested = false;
+	gw_thread_valid = (pthread_create(&gw_thread, NULL, gateway_threaded, NULL) == 0);
+	pthread_mutex_unlock(&gw_lock);
+	if (!gw_thread_valid) {
+		log_gw_error("%s", "Unable to start gateway thread");
+		free(backlog_path);
+		backlog_path = NULL;
+		return 1;
+	}
+
+	log_gw_info("Gateway started for up to %u children", max_children);
+
+	return 0;
+}
+
+void stop_gateway(void)
+{
+	pthread_mutex_lock(&gw_lock);
+	stop_requested = true;
+	pthread_cond_broadcast(&gw_cond);
+	pthread_mutex_unlock(&gw_lock);
+
+	if (!gw_thread_valid)
+		return;
+
+	pthread_join(gw_thread, NULL);
+
+	pthread_mutex_lock(&gw_lock);
+	gw_thread_valid = false;
+	while (children != NULL)
+		free_child(children);
+	n_children = 0;
+	pthread_mutex_unlock(&gw_lock);
+
+	free(backlog_path);
+	backlog_path = NULL;
+
+	log_gw_info("%s", "Gateway stopped");
+}
+
+/*
+ * add_child_json() - Add a child and its counters to a JSON array
+ *
+ * @array:	Array to add the child to.
+ * @child:	Child to add.
+ * @now_ms:	Current monotonic time.
+ *
+ * Must be called with 'gw_lock' held.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_child_json(json_object *array, gw_child_t *child, uint64_t now_ms)
+{
+	json_object *obj = json_object_new_object();
+
+	if (obj == NULL || json_object_array_add(array, obj) != 0) {
+		json_object_put(obj);
+		return -1;
+	}
+
+	if (json_object_object_add(obj, "id", json_object_new_string(child->id)) != 0
+		|| json_object_object_add(obj, "type", json_object_new_string(child->type)) != 0
+		|| json_object_object_add(obj, "online", json_object_new_boolean(child->online)) != 0
+		|| json_object_object_add(obj, "idle", json_object_new_int64((int64_t) ((now_ms - child->last_seen_ms) / 1000))) != 0
+		|| json_object_object_add(obj, "bytes_sent", json_object_new_int64((int64_t) child->bytes_sent)) != 0
+		|| json_object_object_add(obj, "bytes_delayed", json_object_new_int64((int64_t) child->bytes_delayed)) != 0
+		|| json_object_object_add(obj, "bytes_failed", json_object_new_int64((int64_t) child->bytes_failed)) != 0
+		|| json_object_object_add(obj, "requests", json_object_new_int64((int64_t) child->requests)) != 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * add_backlog_sizes() - Add the backlog size of every child in a JSON array
+ *
+ * @array:	Array of children.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_backlog_sizes(json_object *array)
+{
+	size_t i;
+
+	for (i = 0; i < json_object_array_length(array); i++) {
+		json_object *obj = json_object_array_get_idx(array, i), *id = NULL;
+		unsigned long long size = 0;
+		char *path;
+
+		if (!json_object_object_get_ex(obj, "id", &id))
+			continue;
+
+		path = get_child_backlog_path(json_object_get_string(id));
+		if (path != NULL)
+			get_directory_size(path, &size);
+		free(path);
+
+		if (json_object_object_add(obj, "backlog_size", json_object_new_int64((int64_t) size)) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+ccapi_receive_error_t gateway_request_cb(const char *const target,
+	const ccapi_transport_t transport,
+	const ccapi_buffer_info_t *const request_buffer_info,
+	ccapi_buffer_info_t *const response_buffer_info)
+{
+	json_object *resp = json_object_new_object(), *array = json_object_new_array();
+	ccapi_receive_error_t ret = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	uint64_t now_ms = get_monotonic_ms();
+	gw_child_t *child;
+	int error = 0;
+
+	UNUSED_ARGUMENT(request_buffer_info);
+
+	log_gw_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	response_buffer_info->buffer = NULL;
+	response_buffer_info->length = 0;
+
+	if (resp == NULL || array == NULL) {
+		json_object_put(array);
+		goto done;
+	}
+
+	if (json_object_object_add(resp, "children", array) != 0) {
+		json_object_put(array);
+		goto done;
+	}
+
+	pthread_mutex_lock(&gw_lock);
+	for (child = children; child != NULL && error == 0; child = child->next) {
+		if (!child->removed)
+			error = add_child_json(array, child, now_ms);
+	}
+	pthread_mutex_unlock(&gw_lock);
+
+	if (error != 0 || add_backlog_sizes(array) != 0
+		|| json_object_object_add(resp, "enabled", json_object_new_boolean(gw_thread_valid)) != 0
+		|| json_object_object_add(resp, "status", json_object_new_string("ok")) != 0)
+		goto done;
+
+	response_buffer_info->buffer = strdup(json_object_to_json_string_ext(resp, JSON_C_TO_STRING_PLAIN));
+	if (response_buffer_info->buffer != NULL) {
+		response_buffer_info->length = strlen(response_buffer_info->buffer);
+		ret = CCAPI_RECEIVE_ERROR_NONE;
+	}
+
+done:
+	if (ret != CCAPI_RECEIVE_ERROR_NONE)
+		log_gw_error("Cannot generate response for target '%s': Out of memory", target);
+
+	json_object_put(resp);
+
+	return ret;
+}
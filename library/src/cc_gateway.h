@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_GATEWAY_H_
+#define CC_GATEWAY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ccapi/ccapi.h"
+#include "cc_config.h"
+
+/* Data streams of a child device: children/<child_id>/<stream> */
+#define GW_CHILD_STREAM_PREFIX		"children/"
+
+typedef enum {
+	GW_UPLOAD_SENT,
+	GW_UPLOAD_DELAYED,
+	GW_UPLOAD_FAILED
+} gw_upload_result_t;
+
+/*
+ * start_gateway() - Start the gateway for child devices
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * Starts tracking the online state of the registered children and uploading
+ * their data backlogs. The registry of children is not persistent, so
+ * applications must register their children every time the daemon starts.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int start_gateway(const cc_cfg_t *const cc_cfg);
+
+/*
+ * stop_gateway() - Stop the gateway for child devices
+ *
+ * All the children are unregistered. Their data backlogs are kept and
+ * uploaded on next start.
+ */
+void stop_gateway(void);
+
+/*
+ * gateway_valid_child_id() - Check if a child device identifier is valid
+ *
+ * @child_id:	Identifier to check.
+ *
+ * Return: True if it has 1 to 64 letters, digits, '-', '_' or '.' and does
+ *         not start with '.', false otherwise.
+ */
+bool gateway_valid_child_id(const char *child_id);
+
+/*
+ * gateway_register_child() - Register a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @type:	Type of the child device, reported with its status.
+ *
+ * The child is registered online. Registering an existing child updates its
+ * type and keeps its counters.
+ *
+ * Return: 0 on success, -EPERM if the gateway is not running, -EINVAL if the
+ *         identifier is not valid, -ENOSPC if there are too many children,
+ *         -1 otherwise.
+ */
+int gateway_register_child(const char *child_id, const char *type);
+
+/*
+ * gateway_unregister_child() - Unregister a child device
+ *
+ * @child_id:	Identifier of the child device.
+ *
+ * Return: 0 on success, -ENOENT if the child is not registered.
+ */
+int gateway_unregister_child(const char *child_id);
+
+/*
+ * gateway_set_child_state() - Set the online state of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @online:	True if the child is online, false otherwise.
+ *
+ * Return: 0 on success, -ENOENT if the child is not registered.
+ */
+int gateway_set_child_state(const char *child_id, bool online);
+
+/*
+ * gateway_child_csv() - Move CSV data points to the data streams of a child
+ *
+ * @child_id:	Identifier of the child device.
+ * @csv:	Data points as generated by 'generate_dp_csv()'.
+ * @size:	Number of bytes of 'csv'.
+ * @out_size:	Number of bytes of the returned buffer.
+ *
+ * The stream of every data point is prefixed with
+ * 'children/<child_id>/'.
+ *
+ * Return: The new null-terminated CSV buffer, it must be freed. NULL if
+ *         'csv' is not valid or out of memory.
+ */
+char *gateway_child_csv(const char *child_id, const char *csv, size_t size, size_t *out_size);
+
+/*
+ * gateway_child_upload_allowed() - Check the upload rate of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @size:	Number of bytes to upload.
+ *
+ * The child is considered active, and online if it was not.
+ *
+ * Return: 1 if the data can be uploaded now, 0 if the child is over its
+ *         upload rate, -ENOENT if the child is not registered.
+ */
+int gateway_child_upload_allowed(const char *child_id, size_t size);
+
+/*
+ * gateway_store_child_data() - Store CSV data points in a child backlog
+ *
+ * @child_id:	Identifier of the child device.
+ * @csv:	Data points to store.
+ * @size:	Number of bytes of 'csv'.
+ * @error:	Upload error, 0 to store the data points unconditionally.
+ *
+ * With an 'error', data points are only stored if the upload can succeed
+ * later.
+ *
+ * Return: 0 if success, 1 otherwise (also if the backlog is disabled).
+ */
+int gateway_store_child_data(const char *child_id, const char *csv, size_t size,
+	unsigned int error);
+
+/*
+ * gateway_account_upload() - Update the upload counters of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @size:	Number of bytes of the upload.
+ * @result:	What happened with the data.
+ */
+void gateway_account_upload(const char *child_id, size_t size, gw_upload_result_t result);
+
+/*
+ * gateway_target_available() - Check if a data request target can be served
+ *
+ * @target:	Target of the data request.
+ *
+ * Targets of child devices ('child/<child_id>/<target>') are only served
+ * while their child is registered and online.
+ *
+ * Return: False if the target belongs to a child that is not available, true
+ *         otherwise.
+ */
+bool gateway_target_available(const char *target);
+
+/*
+ * gateway_request_cb() - Handle a gateway request from Remote Manager
+ *
+ * @target:		Target of the data request.
+ * @transport:		Communication transport used by the data request.
+ * @request_buffer_info:	Request, not used.
+ * @response_buffer_info:	JSON response with the registered children and
+ *				their counters, it must be freed.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE if the response is set, any other error
+ *         otherwise.
+ */
+ccapi_receive_error_t gateway_request_cb(const char *const target,
+	const ccapi_transport_t transport,
+	const ccapi_buffer_info_t *const request_buffer_info,
+	ccapi_buffer_info_t *const response_buffer_info);
+
+#endif /* CC_GATEWAY_H_ */
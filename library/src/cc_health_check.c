@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/reboot.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccapi/ccapi.h"
+#include "_cc_datapoints.h"
+#include "cc_bootenv.h"
+#include "cc_health_check.h"
+#include "cc_init.h"
+#include "cc_logging.h"
+
+#define HEALTH_CHECK_TAG		"HEALTH:"
+
+#define LOOP_MS				100
+#define CHECK_INTERVAL_MS		5000
+
+#define BOOTENV_ACTIVE_SYSTEM		"active_system"
+#define BOOTENV_UPGRADE_AVAILABLE	"upgrade_available"
+#define BOOTENV_BOOTCOUNT		"bootcount"
+#define BOOTENV_ROLLBACK		"cccs_rollback"
+
+#define TASK_COMM_LEN			16
+
+#define REASON_BUFSIZE			200
+
+#define DP_ROLLBACK_STREAM_ID		"management/events/update_rollback"
+
+/**
+ * log_hc_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_hc_debug(format, ...)					\
+	log_debug("%s " format, HEALTH_CHECK_TAG, __VA_ARGS__)
+
+/**
+ * log_hc_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_hc_info(format, ...)					\
+	log_info("%s " format, HEALTH_CHECK_TAG, __VA_ARGS__)
+
+/**
+ * log_hc_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_hc_error(format, ...)					\
+	log_error("%s " format, HEALTH_CHECK_TAG, __VA_ARGS__)
+
+static volatile bool stop_requested = false;
+static volatile bool hc_thread_valid = false;
+static volatile bool verifying = false;
+static pthread_t hc_thread;
+
+static pthread_mutex_t apps_lock = PTHREAD_MUTEX_INITIALIZER;
+static char **apps = NULL;
+static bool *apps_healthy = NULL;
+static unsigned int n_apps = 0;
+
+/*
+ * Copy of the settings used by the thread, the configuration lists are
+ * reallocated every time the configuration is read again
+ */
+static char **services = NULL;
+static unsigned int n_services = 0;
+static char *fw_version = NULL;
+static uint32_t timeout = 0;
+
+/*
+ * get_uptime() - Get the number of seconds since the system booted
+ *
+ * Return: Seconds since boot.
+ */
+static time_t get_uptime(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_BOOTTIME, &now);
+
+	return now.tv_sec;
+}
+
+/*
+ * is_update_pending() - Check if the running firmware is not verified yet
+ *
+ * Return: True if the health of the running firmware must be checked, false
+ *         otherwise.
+ */
+static bool is_update_pending(void)
+{
+	char *value = bootenv_get(BOOTENV_UPGRADE_AVAILABLE);
+	bool pending = value != NULL && strcmp(value, "1") == 0;
+
+	free(value);
+
+	return pending;
+}
+
+/*
+ * is_service_running() - Check if there is a process with the given name
+ *
+ * @name:	Name of the process.
+ *
+ * Return: True if it is running, false otherwise.
+ */
+static bool is_service_running(const char *const name)
+{
+	bool running = false;
+	struct dirent *entry;
+	DIR *dir;
+
+	dir = opendir("/proc");
+	if (dir == NULL) {
+		log_hc_error("Unable to open '/proc': %s (%d)", strerror(errno), errno);
+		return false;
+	}
+
+	while (!running && (entry = readdir(dir)) != NULL) {
+		char path[PATH_MAX], comm[TASK_COMM_LEN + 1] = {0};
+		FILE *fp;
+
+		if (!isdigit((unsigned char)entry->d_name[0]))
+			continue;
+
+		snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+		fp = fopen(path, "r");
+		if (fp == NULL)
+			continue;
+
+		if (fgets(comm, sizeof(comm), fp) != NULL) {
+			comm[strcspn(comm, "\n")] = '\0';
+			/* Kernel truncates process names to TASK_COMM_LEN - 1 */
+			running = strncmp(comm, name, TASK_COMM_LEN - 1) == 0;
+		}
+
+		fclose(fp);
+	}
+
+	closedir(dir);
+
+	return running;
+}
+
+/*
+ * check_health() - Check the configured health conditions
+ *
+ * @reason:	Buffer to store the first failed condition.
+ * @size:	Size of the reason buffer.
+ *
+ * Return: True if all conditions are satisfied, false otherwise.
+ */
+static bool check_health(char *reason, size_t size)
+{
+	bool healthy = true;
+	unsigned int i;
+
+	if (get_cloud_connection_status() != CC_STATUS_CONNECTED) {
+		snprintf(reason, size, "%s", "No connection to Remote Manager");
+		return false;
+	}
+
+	for (i = 0; i < n_services; i++) {
+		if (!is_service_running(services[i])) {
+			snprintf(reason, size, "Service '%s' not running", services[i]);
+			return false;
+		}
+	}
+
+	pthread_mutex_lock(&apps_lock);
+	for (i = 0; i < n_apps; i++) {
+		if (!apps_healthy[i]) {
+			snprintf(reason, size, "Application '%s' not healthy", apps[i]);
+			healthy = false;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&apps_lock);
+
+	return healthy;
+}
+
+/*
+ * commit_update() - Mark the running firmware as valid
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int commit_update(void)
+{
+	if (bootenv_set(BOOTENV_UPGRADE_AVAILABLE, "0") != 0
+		|| bootenv_set(BOOTENV_BOOTCOUNT, "0") != 0) {
+		log_hc_error("%s", "Unable to commit firmware update");
+		return -1;
+	}
+
+	log_hc_info("%s", "Firmware update verified and committed");
+
+	return 0;
+}
+
+/*
+ * rollback_update() - Switch back to the previous system and reboot
+ *
+ * @reason:	Failed condition that causes the rollback.
+ *
+ * Return: -1 if the rollback cannot be performed, it does not return
+ *         otherwise.
+ */
+static int rollback_update(const char *const reason)
+{
+	char value[REASON_BUFSIZE + 64];
+	char *c;
+
+	snprintf(value, sizeof(value), "Firmware %s: %s",
+		fw_version != NULL ? fw_version : "unknown", reason);
+	/* Keep the value safe for the environment and the JSON report */
+	for (c = value; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\'' || *c == '\\' || !isprint((unsigned char)*c))
+			*c = '_';
+	}
+
+	log_hc_error("Health check failed (%s), rolling back", reason);
+
+	if (swap_active_system(false) != 0) {
+		log_hc_error("%s", "Unable to roll back");
+		return -1;
+	}
+
+	bootenv_set(BOOTENV_ROLLBACK, value);
+
+	sync();
+	fflush(stdout);
+	sleep(1);
+	reboot(RB_AUTOBOOT);
+
+	return -1;
+}
+
+/*
+ * send_rollback_report() - Report a rollback to Remote Manager
+ *
+ * @reason:	Description of the rollback.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int send_rollback_report(const char *const reason)
+{
+	char *dp_value = NULL;
+	int ret;
+
+	if (asprintf(&dp_value, "{\"rollback\": true, \"reason\": \"%s\"}", reason) < 0) {
+		log_hc_error("Unable to report rollback: %s", "Out of memory");
+		return -1;
+	}
+
+	ret = dp_send_json_event(DP_ROLLBACK_STREAM_ID, dp_value);
+
+	free(dp_value);
+
+	return ret;
+}
+
+/*
+ * health_check_loop() - Verify the system health until done or stopped
+ */
+static void health_check_loop(void)
+{
+	char *rollback = bootenv_get(BOOTENV_ROLLBACK);
+	time_t deadline = timeout * 60;
+
+	if (rollback != NULL && strlen(rollback) == 0) {
+		free(rollback);
+		rollback = NULL;
+	}
+
+	if (rollback != NULL)
+		log_hc_error("Previous firmware update was rolled back: %s", rollback);
+
+	if (verifying)
+		log_hc_info("Verifying firmware update, timeout %u minutes", timeout);
+
+	while (!stop_requested && (verifying || rollback != NULL)) {
+		long loop;
+
+		if (rollback != NULL && get_cloud_connection_status() == CC_STATUS_CONNECTED
+			&& send_rollback_report(rollback) == 0) {
+			bootenv_set(BOOTENV_ROLLBACK, NULL);
+			free(rollback);
+			rollback = NULL;
+		}
+
+		if (verifying) {
+			char reason[REASON_BUFSIZE] = {0};
+
+			if (check_health(reason, sizeof(reason))) {
+				commit_update();
+				verifying = false;
+			} else if (get_uptime() >= deadline) {
+				rollback_update(reason);
+				verifying = false;
+			} else {
+				log_hc_debug("System not healthy yet: %s", reason);
+			}
+		}
+
+		for (loop = 0; loop < CHECK_INTERVAL_MS / LOOP_MS; loop++) {
+			struct timespec sleep_value = {
+				.tv_sec = 0,
+				.tv_nsec = LOOP_MS * 1000 * 1000
+			};
+
+			if (stop_requested)
+				break;
+
+			nanosleep(&sleep_value, NULL);
+		}
+	}
+
+	verifying = false;
+	free(rollback);
+}
+
+/*
+ * health_check_threaded() - Execute the health verification in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *health_check_threaded(void *unused)
+{
+	UNUSED_ARGUMENT(unused);
+
+	health_check_loop();
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * free_list() - Release a list of strings
+ *
+ * @list:	List to release.
+ * @n:		Number of strings in the list.
+ */
+static void free_list(char **list, unsigned int n)
+{
+	unsigned int i;
+
+	if (list == NULL)
+		return;
+
+	for (i = 0; i < n; i++)
+		free(list[i]);
+	free(list);
+}
+
+/*
+ * copy_list() - Duplicate a list of strings
+ *
+ * @list:	List to duplicate.
+ * @n:		Number of strings in the list.
+ * @copy:	Pointer to store the new list, NULL if it is empty.
+ *
+ * Return: 0 on success, -1 if there is not enough memory.
+ */
+static int copy_list(char **list, unsigned int n, char ***copy)
+{
+	unsigned int i;
+
+	*copy = NULL;
+	if (n == 0)
+		return 0;
+
+	*copy = calloc(n, sizeof(**copy));
+	if (*copy == NULL)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		(*copy)[i] = strdup(list[i]);
+		if ((*copy)[i] == NULL) {
+			free_list(*copy, n);
+			*copy = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * free_settings() - Release the copy of the health check settings
+ */
+static void free_settings(void)
+{
+	pthread_mutex_lock(&apps_lock);
+	free(apps_healthy);
+	apps_healthy = NULL;
+	free_list(apps, n_apps);
+	apps = NULL;
+	n_apps = 0;
+	pthread_mutex_unlock(&apps_lock);
+
+	free_list(services, n_services);
+	services = NULL;
+	n_services = 0;
+	free(fw_version);
+	fw_version = NULL;
+	timeout = 0;
+}
+
+/*
+ * copy_settings() - Copy the health check settings from the configuration
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t).
+ *
+ * Return: 0 on success, -1 if there is not enough memory.
+ */
+static int copy_settings(const cc_cfg_t *const cc_cfg)
+{
+	int ret = 0;
+
+	timeout = cc_cfg->health_check_timeout;
+	if (cc_cfg->fw_version != NULL) {
+		fw_version = strdup(cc_cfg->fw_version);
+		if (fw_version == NULL)
+			goto error;
+	}
+
+	if (copy_list(cc_cfg->health_check_services, cc_cfg->n_health_check_services, &services) != 0)
+		goto error;
+	n_services = cc_cfg->n_health_check_services;
+
+	pthread_mutex_lock(&apps_lock);
+	if (cc_cfg->n_health_check_apps > 0) {
+		apps_healthy = calloc(cc_cfg->n_health_check_apps, sizeof(*apps_healthy));
+		if (apps_healthy == NULL
+			|| copy_list(cc_cfg->health_check_apps, cc_cfg->n_health_check_apps, &apps) != 0)
+			ret = -1;
+		else
+			n_apps = cc_cfg->n_health_check_apps;
+	}
+	pthread_mutex_unlock(&apps_lock);
+
+	if (ret == 0)
+		return 0;
+
+error:
+	free_settings();
+
+	return -1;
+}
+
+int start_health_check(const cc_cfg_t *const cc_cfg)
+{
+	if (!cc_cfg->is_dual_boot)
+		return 0;
+
+	if (hc_thread_valid)
+		return 0;
+
+	if (copy_settings(cc_cfg) != 0) {
+		log_hc_error("Unable to start health check: %s", "Out of memory");
+		return 1;
+	}
+
+	stop_requested = false;
+	verifying = timeout > 0 && is_update_pending();
+	hc_thread_valid = (pthread_create(&hc_thread, NULL, health_check_threaded, NULL) == 0);
+	if (!hc_thread_valid) {
+		log_hc_error("%s", "Unable to start health check thread");
+		verifying = false;
+		free_settings();
+		return 1;
+	}
+
+	return 0;
+}
+
+void stop_health_check(void)
+{
+	stop_requested = true;
+
+	/* Do not cancel it, it may be writing the bootloader environment */
+	if (hc_thread_valid) {
+		hc_thread_valid = false;
+		pthread_join(hc_thread, NULL);
+	}
+
+	free_settings();
+}
+
+void wait_health_check(const volatile bool *const cancel)
+{
+	struct timespec sleep_value = {
+		.tv_sec = 0,
+		.tv_nsec = LOOP_MS * 1000 * 1000
+	};
+
+	if (!hc_thread_valid || !verifying)
+		return;
+
+	log_hc_info("%s", "Waiting for the firmware update verification to finish");
+
+	while (hc_thread_valid && verifying && !*cancel)
+		nanosleep(&sleep_value, NULL);
+}
+
+int swap_active_system(bool const verify)
+{
+	char *active = bootenv_get(BOOTENV_ACTIVE_SYSTEM);
+	const char *other = NULL;
+
+	if (active != NULL && strcmp(active, "linux_a") == 0)
+		other = "linux_b";
+	else if (active != NULL && strcmp(active, "linux_b") == 0)
+		other = "linux_a";
+
+	if (other == NULL) {
+		log_hc_error("Unknown active system '%s'", active != NULL ? active : "");
+		free(active);
+		return -1;
+	}
+
+	free(active);
+
+	/* Switch first, so a failure never leaves the current system pending verification */
+	if (bootenv_set(BOOTENV_ACTIVE_SYSTEM, other) != 0) {
+		log_hc_error("Unable to set '%s' as active system", other);
+		return -1;
+	}
+
+	if (bootenv_set(BOOTENV_BOOTCOUNT, "0") != 0
+		|| bootenv_set(BOOTENV_UPGRADE_AVAILABLE, verify ? "1" : "0") != 0) {
+		log_hc_error("Active system set to '%s', unable to %s its verification",
+			other, verify ? "request" : "cancel");
+		return -1;
+	}
+
+	log_hc_info("Active system set to '%s'", other);
+
+	return 0;
+}
+
+int set_app_health_status(const char *const app, bool healthy)
+{
+	unsigned int i;
+	int ret = -1;
+
+	pthread_mutex_lock(&apps_lock);
+	for (i = 0; i < n_apps; i++) {
+		if (strcmp(apps[i], app) == 0) {
+			apps_healthy[i] = healthy;
+			ret = 0;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&apps_lock);
+
+	if (ret == 0)
+		log_hc_debug("Application '%s' reported %s", app, healthy ? "healthy" : "not healthy");
+	else
+		log_hc_debug("Application '%s' is not monitored", app);
+
+	return ret;
+}
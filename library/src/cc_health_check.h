@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_HEALTH_CHECK_H_
+#define CC_HEALTH_CHECK_H_
+
+#include <stdbool.h>
+
+#include "cc_config.h"
+
+/*
+ * start_health_check() - Start the post-update health verification
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * If the system is booting a new firmware for the first time (dual boot
+ * systems), it checks the configured health conditions until all of them are
+ * satisfied, so the update is committed, or 'health_check_timeout' minutes
+ * since boot expire, so the system rolls back to the previous partition.
+ *
+ * It also reports a previous rollback to Remote Manager once connected.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int start_health_check(const cc_cfg_t *const cc_cfg);
+
+/*
+ * stop_health_check() - Stop the post-update health verification
+ */
+void stop_health_check(void);
+
+/*
+ * wait_health_check() - Wait until a firmware update is committed or rolled back
+ *
+ * @cancel:	Flag to stop waiting before the verification finishes.
+ *
+ * Returns immediately if there is no update pending verification. Otherwise,
+ * if the health conditions are not satisfied, the system rolls back and
+ * reboots once 'health_check_timeout' expires.
+ */
+void wait_health_check(const volatile bool *const cancel);
+
+/*
+ * swap_active_system() - Boot the other system of a dual boot device
+ *
+ * @verify:	True to boot it as a firmware update pending verification,
+ *		false to boot it as a verified one.
+ *
+ * Sets the other system as active system in the bootloader environment,
+ * resets the boot counter and sets 'upgrade_available' to 1 if it must be
+ * verified, 0 otherwise. It is used both to activate an installed update and
+ * to roll it back. The new system runs after the next reboot.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int swap_active_system(bool const verify);
+
+/*
+ * set_app_health_status() - Set the health status reported by an application
+ *
+ * @app:	Name of the application.
+ * @healthy:	True if the application is healthy, false otherwise.
+ *
+ * Return: 0 on success, -1 if the application is not a monitored one.
+ */
+int set_app_health_status(const char *const app, bool healthy);
+
+#endif /* CC_HEALTH_CHECK_H_ */
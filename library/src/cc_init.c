@@ -25,9 +25,21 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include "cc_bootenv.h"
+#include "cc_clock.h"
+#include "cc_compression.h"
+#include "cc_cred_store.h"
+#include "cc_device_twin.h"
+#include "cc_file_upload.h"
 #include "cc_firmware_update.h"
+#include "cc_fw_schedule.h"
+#include "cc_gateway.h"
+#include "cc_health_check.h"
 #include "cc_init.h"
+#include "cc_job_scheduler.h"
+#include "cc_log_forward.h"
 #include "cc_logging.h"
+#include "cc_mem_budget.h"
 #include "cc_system_monitor.h"
 #include "network_utils.h"
 #include "service_data_request.h"
@@ -55,6 +67,7 @@ static volatile cc_status_t connection_status = CC_STATUS_DISCONNECTED;
 static pthread_t reconnect_thread;
 static bool reconnect_thread_valid;
 static volatile bool stop_requested;
+static bool debug_log_forced;
 cc_cfg_t *cc_cfg = NULL;
 #ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
 bool edp_cert_downloaded = false;
@@ -323,10 +336,22 @@ cc_init_error_t init_cloud_connection(const char *config_file)
 		ret = CC_INIT_ERROR_UNKOWN;
 		goto error;
 	}
+	update_log_level();
 
 	if (!cc_cfg->data_backlog_path || strlen(cc_cfg->data_backlog_path) == 0 || cc_cfg->data_backlog_kb == 0)
 		log_warning("%s", "Disabled storage of system monitor and custom data");
 
+	/* Take the clock reference before it is set, to correct timestamps */
+	clock_is_valid();
+
+	mem_budget_init(cc_cfg);
+	compression_init(cc_cfg);
+
+	if (bootenv_init(cc_cfg->bootenv_file) != 0) {
+		ret = CC_INIT_ERROR_PARSE_CONFIGURATION;
+		goto error;
+	}
+
 	ccapi_error = initialize_ccapi(cc_cfg);
 	switch(ccapi_error) {
 		case CCAPI_START_ERROR_NONE:
@@ -624,7 +649,15 @@ static ccapi_tcp_start_error_t initialize_tcp_transport(
 		if (create_ccapi_tcp_start_info_struct(cc_cfg, &tcp_info) == 0)
 			error = ccapi_start_transport_tcp(&tcp_info);
 
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+		/*
+		 * Keep retrying with a new client certificate pending confirmation,
+		 * the previous one is restored after several failed handshakes
+		 */
+		retry = (cc_cfg->enable_reconnect || cred_store_pending(cc_cfg->client_cert_path))
+#else /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 		retry = cc_cfg->enable_reconnect
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 				&& error != CCAPI_TCP_START_ERROR_NONE
 				&& error != CCAPI_TCP_START_ERROR_ALREADY_STARTED;
 	} while (retry && !stop_requested);
@@ -635,6 +668,11 @@ static ccapi_tcp_start_error_t initialize_tcp_transport(
 			set_cloud_connection_status(CC_STATUS_DISCONNECTED);
 	} else {
 		set_cloud_connection_status(CC_STATUS_CONNECTED);
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+		/* Only a completed connection proves the new certificate works */
+		if (error == CCAPI_TCP_START_ERROR_NONE)
+			cred_store_handshake_done(cc_cfg->client_cert_path, true);
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 	}
 
 	return error;
@@ -689,15 +727,39 @@ cc_start_error_t start_cloud_connection(void)
 
 	srand(time(NULL));
 
+	/* Start before connecting, a failing connection must be detected too */
+	if (start_health_check(cc_cfg) != 0)
+		log_error("%s", "Unable to verify the health of the system");
+
+	/* Scheduled firmware updates are applied even without connection */
+	if (start_fw_schedule(cc_cfg) != 0)
+		log_error("%s", "Unable to manage scheduled firmware updates");
+
+	/* Uploads can be queued before connecting */
+	if (start_file_uploads(cc_cfg) != 0)
+		log_error("%s", "Unable to manage file uploads");
+
+	/* Load the stored twins before the cloud can request them */
+	if (start_device_twin(cc_cfg) != 0)
+		log_error("%s", "Unable to sync device twin reported states");
+
 	/* Set a signal handler to be able to cancel while trying to connect */
 	ret = setup_signal_handler(&orig_action);
 	tcp_start_error = initialize_tcp_transport(cc_cfg);
+
+	if (tcp_start_error != CCAPI_TCP_START_ERROR_NONE) {
+		log_error("Error initializing TCP transport: error %d", tcp_start_error);
+		/* A new firmware that cannot connect must still be rolled back */
+		wait_health_check(&stop_requested);
+		stop_device_twin();
+		stop_file_uploads();
+		stop_fw_schedule();
+		stop_health_check();
+	}
+
 	/* Restore the original signal handler */
 	if (!ret)
 		sigaction(SIGINT, &orig_action, NULL);
-
-	if (tcp_start_error != CCAPI_TCP_START_ERROR_NONE)
-		log_error("Error initializing TCP transport: error %d", tcp_start_error);
 	switch(tcp_start_error) {
 		case CCAPI_TCP_START_ERROR_NONE:
 			break;
@@ -728,6 +790,16 @@ cc_start_error_t start_cloud_connection(void)
 	if (start_system_monitor(cc_cfg) != CC_SYS_MON_ERROR_NONE)
 		return CC_START_ERROR_SYSTEM_MONITOR;
 
+	if (start_log_forward(cc_cfg) != CC_LOG_FWD_ERROR_NONE)
+		log_error("%s", "Cannot start log forwarder");
+
+	/* Children register through the local requests */
+	if (start_gateway(cc_cfg) != 0)
+		log_error("%s", "Cannot start gateway");
+
+	if (start_job_scheduler(cc_cfg) != 0)
+		log_error("%s", "Cannot start job scheduler");
+
 	start_listening_for_local_requests(cc_cfg);
 
 	log_info("%s", "Cloud connection started");
@@ -749,8 +821,22 @@ cc_stop_error_t stop_cloud_connection(void)
 		pthread_join(reconnect_thread, NULL);
 	}
 
+	stop_job_scheduler();
+
+	stop_gateway();
+
+	stop_log_forward();
+
 	stop_system_monitor();
 
+	stop_device_twin();
+
+	stop_file_uploads();
+
+	stop_fw_schedule();
+
+	stop_health_check();
+
 	{
 		ccapi_tcp_stop_t tcp_stop = { .behavior = CCAPI_TRANSPORT_STOP_GRACEFULLY };
 		ccapi_stop_transport_tcp(&tcp_stop);
@@ -798,6 +884,30 @@ cc_status_t get_cloud_connection_status(void)
 	return connection_status;
 }
 
+void update_log_level(void)
+{
+	if (!cc_cfg)
+		return;
+
+	set_log_level(debug_log_forced ? LOG_DEBUG : cc_cfg->log_level);
+	ccimp_logging_set_debug(debug_log_forced || cc_cfg->connector_debug);
+}
+
+void toggle_debug_log(void)
+{
+	if (!cc_cfg)
+		return;
+
+	if (debug_log_forced)
+		log_info("%s", "Debug log disabled, restoring the configured log level");
+
+	debug_log_forced = !debug_log_forced;
+	update_log_level();
+
+	if (debug_log_forced)
+		log_info("%s", "Debug log enabled, including Cloud Connector messages");
+}
+
 char *get_client_cert_path(void)
 {
 	if (!cc_cfg)
@@ -805,3 +915,23 @@ char *get_client_cert_path(void)
 
 	return cc_cfg->client_cert_path;
 }
+
+char *get_client_cert_key_file(void)
+{
+	if (!cc_cfg || !cc_cfg->client_cert_key_file || cc_cfg->client_cert_key_file[0] == '\0')
+		return NULL;
+
+	return cc_cfg->client_cert_key_file;
+}
+
+uint32_t get_socket_buffer_size(uint32_t *max_size)
+{
+	if (!cc_cfg) {
+		*max_size = 0;
+		return 0;
+	}
+
+	*max_size = cc_cfg->socket_buffer_max * 1024;
+
+	return cc_cfg->socket_buffer_size * 1024;
+}
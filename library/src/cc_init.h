@@ -102,4 +102,20 @@ cc_stop_error_t stop_cloud_connection(void);
  */
 cc_status_t get_cloud_connection_status(void);
 
+/*
+ * update_log_level() - Apply the configured log level
+ *
+ * Applies the 'log_level' and 'connector_debug' settings, unless the debug
+ * log is forced with toggle_debug_log(). Must be called after changing them.
+ */
+void update_log_level(void);
+
+/*
+ * toggle_debug_log() - Force or release the debug log
+ *
+ * The first call logs all messages, including the Cloud Connector debug
+ * ones. The next call restores the configured log level.
+ */
+void toggle_debug_log(void);
+
 #endif /* CC_INIT_H_ */
@@ -0,0 +1,1861 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <json_object.h>
+#include <json_tokener.h>
+#include <json_util.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_cc_datapoints.h"
+#include "cc_clock.h"
+#include "cc_init.h"
+#include "cc_job_scheduler.h"
+#include "cc_logging.h"
+#include "service_data_request.h"
+#include "_utils.h"
+
+#define JOBS_TAG			"JOBS:"
+
+#define JOBS_FILE			"/etc/cccs.jobs.json"
+
+#define DP_JOB_STREAM_ID		"management/events/job"
+
+#define SCHEDULE_ONCE			"@once "
+
+/* A run that starts later than this is considered missed */
+#define MISSED_GRACE_SEC		60
+/* Maximum number of missed runs to execute with the 'run_all' policy */
+#define MAX_CATCHUP_RUNS		10
+#define MAX_RUNNING_JOBS		4
+/* Last bytes of the output of a job reported in its result */
+#define MAX_OUTPUT_SIZE			1024
+#define MAX_PENDING_RESULTS		32
+
+#define POLL_INTERVAL_MS		200
+#define KILL_GRACE_MS			5000
+#define DEFAULT_MAX_TIMEOUT		3600
+
+#define RESULT_SUCCESS			"success"
+#define RESULT_FAILED			"failed"
+#define RESULT_TIMEOUT			"timeout"
+#define RESULT_SKIPPED			"skipped"
+#define RESULT_ERROR			"error"
+
+#define ARRAY_SIZE(array)		(sizeof(array) / sizeof(array[0]))
+
+/**
+ * log_jobs_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_jobs_debug(format, ...)					\
+	log_debug("%s " format, JOBS_TAG, __VA_ARGS__)
+
+/**
+ * log_jobs_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_jobs_info(format, ...)					\
+	log_info("%s " format, JOBS_TAG, __VA_ARGS__)
+
+/**
+ * log_jobs_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_jobs_error(format, ...)					\
+	log_error("%s " format, JOBS_TAG, __VA_ARGS__)
+
+/*
+ * struct cron_t - Parsed cron expression type
+ *
+ * @minutes:		Bit mask of minutes (0-59).
+ * @hours:		Bit mask of hours (0-23).
+ * @days:		Bit mask of days of the month (1-31).
+ * @months:		Bit mask of months (1-12).
+ * @weekdays:		Bit mask of days of the week (0-6, Sunday is 0).
+ * @any_day:		True if the day of the month is '*'.
+ * @any_weekday:	True if the day of the week is '*'.
+ */
+typedef struct {
+	uint64_t minutes;
+	uint32_t hours;
+	uint32_t days;
+	uint16_t months;
+	uint8_t weekdays;
+	bool any_day;
+	bool any_weekday;
+} cron_t;
+
+/*
+ * struct job_t - Scheduled job type
+ *
+ * @def:		Job definition, with an empty name if the slot is free.
+ * @cron:		Parsed schedule of a recurring job.
+ * @once:		Time of a one-shot job, 0 for recurring jobs.
+ * @status:		Job status.
+ * @catchup:		Number of consecutive missed runs executed.
+ * @generation:		Identifier of the job in this slot, to discard the
+ *			results of a removed job.
+ * @run_now:		True to run the job out of its schedule.
+ */
+typedef struct {
+	job_def_t def;
+	cron_t cron;
+	time_t once;
+	job_status_t status;
+	unsigned int catchup;
+	unsigned int generation;
+	bool run_now;
+} job_t;
+
+/*
+ * struct job_run_t - Job run type
+ *
+ * @def:		Copy of the job definition.
+ * @command:		Command line to run for command jobs.
+ * @index:		Slot of the job.
+ * @generation:		Identifier of the job in the slot.
+ * @scheduled:		Time the run was scheduled for.
+ * @missed:		True if it is a missed run.
+ * @manual:		True if it was requested out of the schedule.
+ */
+typedef struct {
+	job_def_t def;
+	char *command;
+	unsigned int index;
+	unsigned int generation;
+	time_t scheduled;
+	bool missed;
+	bool manual;
+} job_run_t;
+
+static const char *const missed_names[] = {
+	"skip", "run_once", "run_all"
+};
+
+static const struct {
+	const char *name;
+	const char *expression;
+} schedule_macros[] = {
+	{ "@yearly", "0 0 1 1 *" },
+	{ "@annually", "0 0 1 1 *" },
+	{ "@monthly", "0 0 1 * *" },
+	{ "@weekly", "0 0 * * 0" },
+	{ "@daily", "0 0 * * *" },
+	{ "@midnight", "0 0 * * *" },
+	{ "@hourly", "0 * * * *" },
+};
+
+static volatile bool stop_requested = false;
+static volatile bool jobs_thread_valid = false;
+static pthread_t jobs_thread;
+
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when jobs change or a run finishes */
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+static job_t jobs[JOB_MAX_JOBS];
+static unsigned int n_running = 0;
+static unsigned int last_generation = 0;
+static bool loaded = false;
+static bool dirty = false;
+static const cc_cfg_t *jobs_cfg = NULL;
+
+/* Results not sent yet because the device was disconnected */
+static char *pending_results[MAX_PENDING_RESULTS];
+static unsigned int n_pending_results = 0;
+
+/*
+ * get_monotonic_ms() - Get the milliseconds since an unspecified point
+ *
+ * Return: Number of milliseconds.
+ */
+static uint64_t get_monotonic_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * format_time() - Format the given time as an ISO 8601 UTC string
+ *
+ * @t:		Time to format.
+ * @buf:	Buffer to store the string.
+ * @size:	Size of the buffer.
+ */
+static void format_time(time_t t, char *buf, size_t size)
+{
+	struct tm tm;
+
+	gmtime_r(&t, &tm);
+	strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+/*
+ * valid_name() - Check if a job or command name is valid
+ *
+ * @name:	Name to check.
+ * @max_len:	Maximum length of the name.
+ *
+ * Return: True if it has 1 to @max_len letters, digits, '-', '_' or '.',
+ *         false otherwise.
+ */
+static bool valid_name(const char *name, size_t max_len)
+{
+	size_t len = strspn(name, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.");
+
+	return len > 0 && len <= max_len && name[len] == '\0';
+}
+
+/*
+ * parse_cron_field() - Parse a field of a cron expression
+ *
+ * @field:	Field to parse: '*', values, ranges ('a-b') and steps ('/n')
+ *		separated by commas.
+ * @min:	Minimum value of the field.
+ * @max:	Maximum value of the field.
+ * @mask:	Pointer to store the bit mask of the values.
+ *
+ * Return: 0 on success, -1 if the field is not valid.
+ */
+static int parse_cron_field(const char *field, int min, int max, uint64_t *mask)
+{
+	const char *p = field;
+
+	*mask = 0;
+
+	do {
+		long first, last, step = 1, v;
+		char *end;
+
+		if (*p == '*') {
+			first = min;
+			last = max;
+			p++;
+		} else {
+			first = strtol(p, &end, 10);
+			if (end == p)
+				return -1;
+			p = end;
+			last = first;
+			if (*p == '-') {
+				last = strtol(p + 1, &end, 10);
+				if (end == p + 1)
+					return -1;
+				p = end;
+			}
+		}
+
+		if (*p == '/') {
+			step = strtol(p + 1, &end, 10);
+			if (end == p + 1 || step < 1)
+				return -1;
+			p = end;
+			if (first == last)
+				last = max;
+		}
+
+		if (first < min || last > max || first > last)
+			return -1;
+
+		for (v = first; v <= last; v += step)
+			*mask |= (uint64_t) 1 << v;
+	} while (*p++ == ',');
+
+	return p[-1] == '\0' ? 0 : -1;
+}
+
+/*
+ * parse_schedule() - Parse the schedule of a job
+ *
+ * @schedule:	Schedule to parse, see 'job_def_t'.
+ * @cron:	Pointer to store the parsed cron expression.
+ * @once:	Pointer to store the time of a one-shot job, 0 if recurring.
+ *
+ * Return: 0 on success, -1 if the schedule is not valid.
+ */
+static int parse_schedule(const char *schedule, cron_t *cron, time_t *once)
+{
+	char buf[JOB_SCHEDULE_MAX_LEN + 1], *fields[5], *saveptr = NULL;
+	uint64_t mask;
+	size_t i;
+
+	memset(cron, 0, sizeof(*cron));
+	*once = 0;
+
+	if (strncmp(schedule, SCHEDULE_ONCE, strlen(SCHEDULE_ONCE)) == 0) {
+		struct tm tm;
+		const char *end;
+
+		memset(&tm, 0, sizeof(tm));
+		end = strptime(schedule + strlen(SCHEDULE_ONCE), "%Y-%m-%dT%H:%M:%SZ", &tm);
+		if (end == NULL || *end != '\0')
+			return -1;
+		*once = timegm(&tm);
+
+		return *once > 0 ? 0 : -1;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(schedule_macros); i++) {
+		if (strcmp(schedule, schedule_macros[i].name) == 0) {
+			schedule = schedule_macros[i].expression;
+			break;
+		}
+	}
+
+	if (strlen(schedule) >= sizeof(buf))
+		return -1;
+	strcpy(buf, schedule);
+
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		fields[i] = strtok_r(i == 0 ? buf : NULL, " \t", &saveptr);
+		if (fields[i] == NULL)
+			return -1;
+	}
+	if (strtok_r(NULL, " \t", &saveptr) != NULL)
+		return -1;
+
+	if (parse_cron_field(fields[0], 0, 59, &cron->minutes) != 0)
+		return -1;
+	if (parse_cron_field(fields[1], 0, 23, &mask) != 0)
+		return -1;
+	cron->hours = (uint32_t) mask;
+	if (parse_cron_field(fields[2], 1, 31, &mask) != 0)
+		return -1;
+	cron->days = (uint32_t) mask;
+	if (parse_cron_field(fields[3], 1, 12, &mask) != 0)
+		return -1;
+	cron->months = (uint16_t) mask;
+	/* Both 0 and 7 are Sunday */
+	if (parse_cron_field(fields[4], 0, 7, &mask) != 0)
+		return -1;
+	cron->weekdays = (uint8_t) ((mask | (mask >> 7)) & 0x7F);
+
+	cron->any_day = strcmp(fields[2], "*") == 0;
+	cron->any_weekday = strcmp(fields[4], "*") == 0;
+
+	return 0;
+}
+
+/*
+ * day_matches() - Check if a day matches a cron expression
+ *
+ * @cron:	Cron expression.
+ * @tm:		Day to check.
+ *
+ * As in cron, if both the day of the month and the day of the week are
+ * restricted, the day matches if any of them matches.
+ *
+ * Return: True if the day matches, false otherwise.
+ */
+static bool day_matches(const cron_t *cron, const struct tm *tm)
+{
+	bool day = (cron->days & (1U << tm->tm_mday)) != 0;
+	bool weekday = (cron->weekdays & (1U << tm->tm_wday)) != 0;
+
+	if (cron->any_day && cron->any_weekday)
+		return true;
+	if (cron->any_day)
+		return weekday;
+	if (cron->any_weekday)
+		return day;
+
+	return day || weekday;
+}
+
+/*
+ * cron_next() - Get the next time matching a cron expression
+ *
+ * @cron:	Cron expression, evaluated in local time.
+ * @after:	Time to start searching from (excluded).
+ *
+ * Return: The next matching time, 0 if there is none in the next years.
+ */
+static time_t cron_next(const cron_t *cron, time_t after)
+{
+	struct tm tm;
+	int max_year;
+	time_t t;
+
+	localtime_r(&after, &tm);
+	max_year = tm.tm_year + 5;
+	tm.tm_sec = 0;
+	tm.tm_min++;
+
+	while (true) {
+		tm.tm_isdst = -1;
+		t = mktime(&tm);
+		if (t == (time_t) -1 || tm.tm_year > max_year)
+			return 0;
+
+		if (!(cron->months & (1U << (tm.tm_mon + 1)))) {
+			tm.tm_mon++;
+			tm.tm_mday = 1;
+			tm.tm_hour = 0;
+			tm.tm_min = 0;
+		} else if (!day_matches(cron, &tm)) {
+			tm.tm_mday++;
+			tm.tm_hour = 0;
+			tm.tm_min = 0;
+		} else if (!(cron->hours & (1U << tm.tm_hour))) {
+			tm.tm_hour++;
+			tm.tm_min = 0;
+		} else if (!(cron->minutes & ((uint64_t) 1 << tm.tm_min))) {
+			tm.tm_min++;
+		} else if (t > after) {
+			return t;
+		} else {
+			/* Repeated local time when the clock goes back */
+			tm.tm_min++;
+		}
+	}
+}
+
+/*
+ * get_next_run() - Get the next run time of a job
+ *
+ * @job:	Job.
+ * @after:	Time to start searching from (excluded).
+ *
+ * Return: The next run time, 0 if the job will not run anymore.
+ */
+static time_t get_next_run(const job_t *job, time_t after)
+{
+	if (job->once > 0)
+		return job->status.last_run == 0 ? job->once : 0;
+
+	return cron_next(&job->cron, after);
+}
+
+/*
+ * find_job() - Find a job by its name
+ *
+ * @name:	Name of the job.
+ *
+ * Must be called with 'jobs_lock' held.
+ *
+ * Return: The index of the job, -1 if it does not exist.
+ */
+static int find_job(const char *name)
+{
+	int i;
+
+	for (i = 0; i < JOB_MAX_JOBS; i++) {
+		if (jobs[i].def.name[0] != '\0' && strcmp(jobs[i].def.name, name) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * find_command() - Get the command line of an allowed command
+ *
+ * @name:	Name of the command in 'job_commands'.
+ *
+ * Return: The command line, NULL if the command is not allowed.
+ */
+static const char *find_command(const char *name)
+{
+	size_t len = strlen(name);
+	unsigned int i;
+
+	if (jobs_cfg == NULL)
+		return NULL;
+
+	for (i = 0; i < jobs_cfg->n_job_commands; i++) {
+		const char *entry = jobs_cfg->job_commands[i];
+
+		if (strncmp(entry, name, len) == 0 && entry[len] == '=')
+			return entry + len + 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * get_max_timeout() - Get the maximum number of seconds a job can run
+ *
+ * Return: The maximum timeout.
+ */
+static uint32_t get_max_timeout(void)
+{
+	return jobs_cfg != NULL ? jobs_cfg->job_max_timeout : DEFAULT_MAX_TIMEOUT;
+}
+
+const char *job_scheduler_check(const job_def_t *def)
+{
+	cron_t cron;
+	time_t once;
+
+	if (!valid_name(def->name, JOB_NAME_MAX_LEN))
+		return "Invalid job name";
+	if (parse_schedule(def->schedule, &cron, &once) != 0)
+		return "Invalid schedule";
+	if (def->type == JOB_TYPE_TARGET && (def->action[0] == '\0' || strlen(def->action) > JOB_ACTION_MAX_LEN))
+		return "Invalid target";
+	if (def->type == JOB_TYPE_COMMAND && !valid_name(def->action, JOB_ACTION_MAX_LEN))
+		return "Invalid command";
+	if (def->type != JOB_TYPE_TARGET && def->type != JOB_TYPE_COMMAND)
+		return "Invalid job type";
+	if (strlen(def->payload) > JOB_PAYLOAD_MAX_LEN)
+		return "Payload too long";
+	if (def->missed > JOB_MISSED_RUN_ALL)
+		return "Invalid missed runs policy";
+	if (def->timeout < 1 || def->timeout > get_max_timeout())
+		return "Invalid timeout";
+	if (def->nice < -20 || def->nice > 19)
+		return "Invalid nice value";
+
+	return NULL;
+}
+
+/*
+ * copy_string() - Copy a string to a fixed size buffer
+ *
+ * @dst:	Destination buffer.
+ * @size:	Size of the buffer.
+ * @src:	String to copy.
+ *
+ * Return: 0 on success, -1 if the string does not fit.
+ */
+static int copy_string(char *dst, size_t size, const char *src)
+{
+	size_t len = strlen(src);
+
+	if (len >= size)
+		return -1;
+	memcpy(dst, src, len + 1);
+
+	return 0;
+}
+
+/*
+ * get_int_member() - Get an integer member of a JSON object
+ *
+ * @obj:	JSON object.
+ * @key:	Name of the member.
+ * @min:	Minimum valid value.
+ * @max:	Maximum valid value.
+ * @value:	Pointer to store the value, not modified if the member does
+ *		not exist.
+ *
+ * Return: 0 on success or if the member does not exist, -1 if it is not a
+ *         valid integer.
+ */
+static int get_int_member(json_object *obj, const char *key, int64_t min, int64_t max, int64_t *value)
+{
+	json_object *member;
+	int64_t v;
+
+	if (!json_object_object_get_ex(obj, key, &member))
+		return 0;
+
+	if (!json_object_is_type(member, json_type_int))
+		return -1;
+
+	v = json_object_get_int64(member);
+	if (v < min || v > max)
+		return -1;
+	*value = v;
+
+	return 0;
+}
+
+/*
+ * get_string_member() - Get a string member of a JSON object
+ *
+ * @obj:	JSON object.
+ * @key:	Name of the member.
+ *
+ * Return: The string, NULL if the member does not exist or it is not a string.
+ */
+static const char *get_string_member(json_object *obj, const char *key)
+{
+	json_object *member;
+
+	if (!json_object_object_get_ex(obj, key, &member) || !json_object_is_type(member, json_type_string))
+		return NULL;
+
+	return json_object_get_string(member);
+}
+
+/*
+ * json_to_def() - Get a job definition from a JSON object
+ *
+ * @obj:	JSON object with the job.
+ * @def:	Struct to store the job definition.
+ *
+ * Return: NULL on success, the error description otherwise.
+ */
+static const char *json_to_def(json_object *obj, job_def_t *def)
+{
+	const char *name = get_string_member(obj, "name");
+	const char *schedule = get_string_member(obj, "schedule");
+	const char *target = get_string_member(obj, "target");
+	const char *command = get_string_member(obj, "command");
+	const char *payload = get_string_member(obj, "payload");
+	const char *missed = get_string_member(obj, "missed");
+	uint32_t max_timeout = get_max_timeout();
+	int64_t timeout = max_timeout < JOB_DEFAULT_TIMEOUT ? max_timeout : JOB_DEFAULT_TIMEOUT;
+	int64_t nice = JOB_DEFAULT_NICE, memory = 0;
+	json_object *enabled;
+	size_t i;
+
+	memset(def, 0, sizeof(*def));
+
+	if (name == NULL || copy_string(def->name, sizeof(def->name), name) != 0)
+		return "Invalid job name";
+	if (schedule == NULL || copy_string(def->schedule, sizeof(def->schedule), schedule) != 0)
+		return "Invalid schedule";
+
+	if ((target == NULL) == (command == NULL))
+		return "Missing target or command";
+	def->type = target != NULL ? JOB_TYPE_TARGET : JOB_TYPE_COMMAND;
+	if (copy_string(def->action, sizeof(def->action), target != NULL ? target : command) != 0)
+		return target != NULL ? "Invalid target" : "Invalid command";
+
+	if (payload != NULL && copy_string(def->payload, sizeof(def->payload), payload) != 0)
+		return "Payload too long";
+
+	def->missed = JOB_MISSED_RUN_ONCE;
+	if (missed != NULL) {
+		for (i = 0; i < ARRAY_SIZE(missed_names); i++) {
+			if (strcmp(missed, missed_names[i]) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(missed_names))
+			return "Invalid missed runs policy";
+		def->missed = (job_missed_t) i;
+	}
+
+	if (get_int_member(obj, "timeout", 1, max_timeout, &timeout) != 0)
+		return "Invalid timeout";
+	if (get_int_member(obj, "nice", -20, 19, &nice) != 0)
+		return "Invalid nice value";
+	if (get_int_member(obj, "memory", 0, UINT32_MAX, &memory) != 0)
+		return "Invalid memory limit";
+	def->timeout = (uint32_t) timeout;
+	def->nice = (int32_t) nice;
+	def->memory_kb = (uint32_t) memory;
+
+	def->enabled = true;
+	if (json_object_object_get_ex(obj, "enabled", &enabled)) {
+		if (!json_object_is_type(enabled, json_type_boolean))
+			return "Invalid enabled value";
+		def->enabled = json_object_get_boolean(enabled);
+	}
+
+	return job_scheduler_check(def);
+}
+
+/*
+ * add_time_member() - Add a time member to a JSON object
+ *
+ * @obj:	JSON object.
+ * @key:	Name of the member.
+ * @t:		Time to add as an ISO 8601 string, null if 0.
+ *
+ * Return: 0 on success, -1 if out of memory.
+ */
+static int add_time_member(json_object *obj, const char *key, time_t t)
+{
+	char buf[sizeof("YYYY-MM-DDTHH:MM:SSZ")];
+	json_object *value = NULL;
+
+	if (t > 0) {
+		format_time(t, buf, sizeof(buf));
+		value = json_object_new_string(buf);
+		if (value == NULL)
+			return -1;
+	}
+
+	return json_object_object_add(obj, key, value);
+}
+
+/*
+ * job_to_json() - Get a job as a JSON object
+ *
+ * @job:	Job.
+ * @stored:	True to get the members to store, false to get them for a
+ *		response.
+ *
+ * Must be called with 'jobs_lock' held.
+ *
+ * Return: The JSON object, NULL if out of memory.
+ */
+static json_object *job_to_json(const job_t *job, bool stored)
+{
+	json_object *obj = json_object_new_object();
+	const job_def_t *def = &job->def;
+	int ret;
+
+	if (obj == NULL)
+		return NULL;
+
+	ret = json_object_object_add(obj, "name", json_object_new_string(def->name))
+		|| json_object_object_add(obj, "schedule", json_object_new_string(def->schedule))
+		|| json_object_object_add(obj, def->type == JOB_TYPE_TARGET ? "target" : "command",
+			json_object_new_string(def->action))
+		|| json_object_object_add(obj, "payload", json_object_new_string(def->payload))
+		|| json_object_object_add(obj, "missed", json_object_new_string(missed_names[def->missed]))
+		|| json_object_object_add(obj, "timeout", json_object_new_int64(def->timeout))
+		|| json_object_object_add(obj, "nice", json_object_new_int(def->nice))
+		|| json_object_object_add(obj, "memory", json_object_new_int64(def->memory_kb))
+		|| json_object_object_add(obj, "enabled", json_object_new_boolean(def->enabled));
+
+	if (ret == 0 && stored)
+		ret = json_object_object_add(obj, "next_run", json_object_new_int64(job->status.next_run))
+			|| json_object_object_add(obj, "last_run", json_object_new_int64(job->status.last_run))
+			|| json_object_object_add(obj, "last_result", json_object_new_string(job->status.last_result))
+			|| json_object_object_add(obj, "catchup", json_object_new_int64(job->catchup));
+	else if (ret == 0)
+		ret = add_time_member(obj, "next_run", job->status.next_run)
+			|| add_time_member(obj, "last_run", job->status.last_run)
+			|| json_object_object_add(obj, "last_result", job->status.last_result[0] != '\0' ?
+				json_object_new_string(job->status.last_result) : NULL)
+			|| json_object_object_add(obj, "running", json_object_new_boolean(job->status.running));
+
+	if (ret != 0) {
+		json_object_put(obj);
+		return NULL;
+	}
+
+	return obj;
+}
+
+/*
+ * save_jobs() - Store the jobs to keep them after a restart
+ *
+ * Must be called with 'jobs_lock' held.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int save_jobs(void)
+{
+	json_object *doc = json_object_new_object(), *list = json_object_new_array();
+	const char *tmp_path = JOBS_FILE ".tmp";
+	const char *str;
+	int i, ret = -1;
+	FILE *fp;
+
+	if (doc == NULL || list == NULL || json_object_object_add(doc, "jobs", list) != 0) {
+		json_object_put(list);
+		goto oom;
+	}
+
+	for (i = 0; i < JOB_MAX_JOBS; i++) {
+		json_object *item;
+
+		if (jobs[i].def.name[0] == '\0')
+			continue;
+
+		item = job_to_json(&jobs[i], true);
+		if (item == NULL || json_object_array_add(list, item) != 0) {
+			json_object_put(item);
+			goto oom;
+		}
+		if (json_object_object_add(item, "slot", json_object_new_int(i)) != 0)
+			goto oom;
+	}
+
+	fp = fopen(tmp_path, "w");
+	if (fp == NULL) {
+		log_jobs_error("Unable to create '%s': %s (%d)", tmp_path, strerror(errno), errno);
+		goto done;
+	}
+
+	str = json_object_to_json_string_ext(doc, JSON_C_TO_STRING_PLAIN);
+	if (fputs(str, fp) < 0 || fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		log_jobs_error("Unable to write '%s': %s (%d)", tmp_path, strerror(errno), errno);
+		fclose(fp);
+		remove(tmp_path);
+		goto done;
+	}
+	fclose(fp);
+
+	if (rename(tmp_path, JOBS_FILE) != 0) {
+		log_jobs_error("Unable to save '%s': %s (%d)", JOBS_FILE, strerror(errno), errno);
+		remove(tmp_path);
+		goto done;
+	}
+
+	dirty = false;
+	ret = 0;
+	goto done;
+
+oom:
+	log_jobs_error("Unable to save jobs: %s", "Out of memory");
+
+done:
+	json_object_put(doc);
+
+	return ret;
+}
+
+/*
+ * set_job() - Set the definition of a job slot
+ *
+ * @index:	Index of the slot.
+ * @def:	Job definition, with an empty name to free the slot.
+ *
+ * The status of the job is reset. Must be called with 'jobs_lock' held.
+ */
+static void set_job(unsigned int index, const job_def_t *def)
+{
+	job_t *job = &jobs[index];
+
+	memset(job, 0, sizeof(*job));
+	job->generation = ++last_generation;
+
+	if (def != NULL && def->name[0] != '\0') {
+		job->def = *def;
+		parse_schedule(def->schedule, &job->cron, &job->once);
+	}
+
+	dirty = true;
+	pthread_cond_broadcast(&jobs_cond);
+}
+
+/*
+ * load_jobs() - Load the jobs stored in a previous execution
+ *
+ * Must be called with 'jobs_lock' held.
+ */
+static void load_jobs(void)
+{
+	json_object *doc = json_object_from_file(JOBS_FILE), *list;
+	size_t i, n;
+
+	if (doc == NULL)
+		return;
+
+	if (!json_object_object_get_ex(doc, "jobs", &list) || !json_object_is_type(list, json_type_array)) {
+		log_jobs_error("Invalid jobs stored in '%s', discarding them", JOBS_FILE);
+		goto done;
+	}
+
+	n = json_object_array_length(list);
+	for (i = 0; i < n; i++) {
+		json_object *item = json_object_array_get_idx(list, i);
+		int64_t slot = -1, next_run = 0, last_run = 0, catchup = 0;
+		const char *error, *last_result;
+		job_def_t def;
+		int index;
+
+		error = json_to_def(item, &def);
+		if (error == NULL && find_job(def.name) >= 0)
+			error = "Duplicated name";
+		if (error != NULL) {
+			log_jobs_error("Discarding stored job %zu: %s", i, error);
+			continue;
+		}
+
+		get_int_member(item, "slot", 0, JOB_MAX_JOBS - 1, &slot);
+		get_int_member(item, "next_run", 0, INT64_MAX, &next_run);
+		get_int_member(item, "last_run", 0, INT64_MAX, &last_run);
+		get_int_member(item, "catchup", 0, MAX_CATCHUP_RUNS, &catchup);
+
+		index = (int) slot;
+		if (index < 0 || jobs[index].def.name[0] != '\0') {
+			for (index = 0; index < JOB_MAX_JOBS && jobs[index].def.name[0] != '\0'; index++)
+				;
+			if (index == JOB_MAX_JOBS) {
+				log_jobs_error("Discarding stored job '%s': %s", def.name, "Too many jobs");
+				continue;
+			}
+		}
+
+		set_job(index, &def);
+		jobs[index].status.next_run = (time_t) next_run;
+		jobs[index].status.last_run = (time_t) last_run;
+		jobs[index].catchup = (unsigned int) catchup;
+		last_result = get_string_member(item, "last_result");
+		if (last_result != NULL)
+			copy_string(jobs[index].status.last_result, sizeof(jobs[index].status.last_result), last_result);
+
+		log_jobs_debug("Loaded job '%s' (%s)", def.name, def.schedule);
+	}
+
+done:
+	json_object_put(doc);
+	dirty = false;
+}
+
+/*
+ * queue_result() - Queue the result of a job run to send it
+ *
+ * @result:	JSON result, freed once sent.
+ *
+ * Must be called with 'jobs_lock' held.
+ */
+static void queue_result(char *result)
+{
+	if (n_pending_results == MAX_PENDING_RESULTS) {
+		log_jobs_error("Too many job results pending, discarding '%s'", pending_results[0]);
+		free(pending_results[0]);
+		memmove(pending_results, pending_results + 1, --n_pending_results * sizeof(pending_results[0]));
+	}
+
+	pending_results[n_pending_results++] = result;
+	pthread_cond_broadcast(&jobs_cond);
+}
+
+/*
+ * send_results() - Send the pending results of job runs
+ */
+static void send_results(void)
+{
+	while (!stop_requested) {
+		char *result;
+
+		pthread_mutex_lock(&jobs_lock);
+		result = n_pending_results > 0 ? pending_results[0] : NULL;
+		pthread_mutex_unlock(&jobs_lock);
+
+		if (result == NULL || dp_send_json_event(DP_JOB_STREAM_ID, result) != 0)
+			return;
+
+		pthread_mutex_lock(&jobs_lock);
+		memmove(pending_results, pending_results + 1, --n_pending_results * sizeof(pending_results[0]));
+		pthread_mutex_unlock(&jobs_lock);
+		free(result);
+	}
+}
+
+/*
+ * build_result() - Build the result of a job run to report
+ *
+ * @run:		Job run.
+ * @result:		Result of the run (RESULT_*).
+ * @started:		Time the run started, 0 if it did not start.
+ * @duration_ms:	Duration of the run in milliseconds.
+ * @exit_code:		Exit code of a command, -1 if none.
+ * @error:		Error description, NULL if none.
+ * @output:		Output of the run, NULL if none.
+ * @output_len:		Length of the output.
+ *
+ * Return: The JSON result, NULL if out of memory.
+ */
+static char *build_result(const job_run_t *run, const char *result, time_t started,
+	uint64_t duration_ms, int exit_code, const char *error, const char *output, size_t output_len)
+{
+	json_object *obj = json_object_new_object();
+	char *str = NULL;
+
+	if (error != NULL)
+		log_jobs_error("Job '%s' %s: %s", run->def.name, result, error);
+	else
+		log_jobs_info("Job '%s' %s", run->def.name, result);
+
+	if (obj == NULL
+		|| json_object_object_add(obj, "name", json_object_new_string(run->def.name)) != 0
+		|| json_object_object_add(obj, run->def.type == JOB_TYPE_TARGET ? "target" : "command",
+			json_object_new_string(run->def.action)) != 0
+		|| json_object_object_add(obj, "result", json_object_new_string(result)) != 0
+		|| add_time_member(obj, "scheduled", run->scheduled) != 0
+		|| add_time_member(obj, "started", started) != 0
+		|| json_object_object_add(obj, "duration_ms", json_object_new_int64((int64_t) duration_ms)) != 0
+		|| json_object_object_add(obj, "missed", json_object_new_boolean(run->missed)) != 0
+		|| json_object_object_add(obj, "manual", json_object_new_boolean(run->manual)) != 0
+		|| (exit_code >= 0 && json_object_object_add(obj, "exit_code", json_object_new_int(exit_code)) != 0)
+		|| (error != NULL && json_object_object_add(obj, "error", json_object_new_string(error)) != 0)
+		|| (output != NULL && output_len > 0
+			&& json_object_object_add(obj, "output", json_object_new_string_len(output, (int) output_len)) != 0)
+		|| (str = strdup(json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN))) == NULL) {
+		log_jobs_error("Unable to report result of job '%s': %s", run->def.name, "Out of memory");
+		json_object_put(obj);
+		return NULL;
+	}
+	json_object_put(obj);
+
+	return str;
+}
+
+/*
+ * append_output() - Append data to the output of a job, keeping its end
+ *
+ * @output:	Output buffer of MAX_OUTPUT_SIZE bytes.
+ * @len:	Length of the output.
+ * @data:	Data to append.
+ * @n:		Length of the data.
+ */
+static void append_output(char *output, size_t *len, const char *data, size_t n)
+{
+	if (n >= MAX_OUTPUT_SIZE) {
+		memcpy(output, data + n - MAX_OUTPUT_SIZE, MAX_OUTPUT_SIZE);
+		*len = MAX_OUTPUT_SIZE;
+		return;
+	}
+
+	if (*len + n > MAX_OUTPUT_SIZE) {
+		size_t drop = *len + n - MAX_OUTPUT_SIZE;
+
+		memmove(output, output + drop, *len - drop);
+		*len -= drop;
+	}
+
+	memcpy(output + *len, data, n);
+	*len += n;
+}
+
+/*
+ * run_command() - Run the command of a job
+ *
+ * @run:	Job run.
+ * @output:	Buffer of MAX_OUTPUT_SIZE bytes to store the end of the
+ *		standard output and error of the command.
+ * @len:	Pointer to store the length of the output.
+ * @exit_code:	Pointer to store the exit code of the command, -1 if it did
+ *		not exit.
+ * @error:	Pointer to store the error description.
+ *
+ * The command runs in its own session with the nice value and memory limit of
+ * the job, and is killed with all its processes if it exceeds the timeout.
+ *
+ * Return: The result of the run (RESULT_*).
+ */
+static const char *run_command(const job_run_t *run, char *output, size_t *len,
+	int *exit_code, const char **error)
+{
+	int in_fds[2] = { -1, -1 }, out_fds[2] = { -1, -1 };
+	uint64_t deadline = get_monotonic_ms() + (uint64_t) run->def.timeout * 1000;
+	uint64_t kill_deadline = 0;
+	const char *result = NULL;
+	size_t payload_len = strlen(run->def.payload);
+	bool exited = false;
+	int status = 0;
+	pid_t pid;
+
+	*len = 0;
+	*exit_code = -1;
+
+	if (pipe2(in_fds, O_CLOEXEC) != 0 || pipe2(out_fds, O_CLOEXEC) != 0) {
+		*error = strerror(errno);
+		if (in_fds[0] >= 0) {
+			close(in_fds[0]);
+			close(in_fds[1]);
+		}
+		return RESULT_ERROR;
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		struct rlimit limit;
+		sigset_t set;
+
+		/* Do not log here, other threads may hold the logging locks */
+		setsid();
+		dup2(in_fds[0], STDIN_FILENO);
+		dup2(out_fds[1], STDOUT_FILENO);
+		dup2(out_fds[1], STDERR_FILENO);
+		setpriority(PRIO_PROCESS, 0, run->def.nice);
+		if (run->def.memory_kb > 0) {
+			limit.rlim_cur = (rlim_t) run->def.memory_kb * 1024;
+			limit.rlim_max = limit.rlim_cur;
+			setrlimit(RLIMIT_AS, &limit);
+		}
+		signal(SIGPIPE, SIG_DFL);
+		sigemptyset(&set);
+		sigprocmask(SIG_SETMASK, &set, NULL);
+		execl("/bin/sh", "sh", "-c", run->command, (char *) NULL);
+		_exit(127);
+	}
+
+	close(in_fds[0]);
+	close(out_fds[1]);
+	if (pid < 0) {
+		*error = strerror(errno);
+		close(in_fds[1]);
+		close(out_fds[0]);
+		return RESULT_ERROR;
+	}
+
+	/* The payload fits in the pipe, so this does not block */
+	if (payload_len > 0 && write(in_fds[1], run->def.payload, payload_len) < 0)
+		log_jobs_debug("Unable to write payload of job '%s': %s (%d)", run->def.name, strerror(errno), errno);
+	close(in_fds[1]);
+
+	while (!exited || out_fds[0] >= 0) {
+		uint64_t now;
+
+		if (out_fds[0] >= 0) {
+			struct pollfd pfd = { .fd = out_fds[0], .events = POLLIN };
+
+			if (poll(&pfd, 1, exited ? 0 : POLL_INTERVAL_MS) > 0) {
+				char buf[512];
+				ssize_t n = read(out_fds[0], buf, sizeof(buf));
+
+				/* Do not skip the checks below, output may never stop */
+				if (n > 0) {
+					append_output(output, len, buf, (size_t) n);
+				} else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+					close(out_fds[0]);
+					out_fds[0] = -1;
+				}
+			} else if (exited) {
+				/* Processes started by the command may keep the output open */
+				close(out_fds[0]);
+				out_fds[0] = -1;
+			}
+		} else {
+			poll(NULL, 0, POLL_INTERVAL_MS);
+		}
+
+		if (!exited && waitpid(pid, &status, WNOHANG) == pid)
+			exited = true;
+		if (exited) {
+			if (out_fds[0] >= 0 && get_monotonic_ms() >= deadline) {
+				close(out_fds[0]);
+				out_fds[0] = -1;
+			}
+			continue;
+		}
+
+		now = get_monotonic_ms();
+		if (kill_deadline == 0 && (now >= deadline || stop_requested)) {
+			result = stop_requested ? RESULT_ERROR : RESULT_TIMEOUT;
+			*error = stop_requested ? "Stopped" : "Timeout";
+			kill(-pid, SIGTERM);
+			kill_deadline = now + KILL_GRACE_MS;
+		} else if (kill_deadline > 0 && now >= kill_deadline) {
+			kill(-pid, SIGKILL);
+		}
+	}
+
+	if (result != NULL)
+		return result;
+
+	if (WIFEXITED(status)) {
+		*exit_code = WEXITSTATUS(status);
+		if (*exit_code == 0)
+			return RESULT_SUCCESS;
+		*error = *exit_code == 127 ? "Command not found" : "Command failed";
+	} else {
+		*error = "Command killed by a signal";
+	}
+
+	return RESULT_FAILED;
+}
+
+/*
+ * run_target() - Send the data request of a job to a local application
+ *
+ * @run:	Job run.
+ * @output:	Buffer of MAX_OUTPUT_SIZE bytes to store the end of the
+ *		response.
+ * @len:	Pointer to store the length of the output.
+ * @error:	Pointer to store the error description.
+ *
+ * Return: The result of the run (RESULT_*).
+ */
+static const char *run_target(const job_run_t *run, char *output, size_t *len, const char **error)
+{
+	char *response = NULL;
+	size_t response_len = 0;
+	ccapi_receive_error_t ret;
+
+	*len = 0;
+
+	ret = run_data_request(run->def.action, run->def.payload, strlen(run->def.payload),
+		run->def.timeout, &response, &response_len);
+	if (response != NULL)
+		append_output(output, len, response, response_len);
+	free(response);
+
+	switch (ret) {
+		case CCAPI_RECEIVE_ERROR_NONE:
+			return RESULT_SUCCESS;
+		case CCAPI_RECEIVE_ERROR_TARGET_NOT_ADDED:
+			*error = "Target is not registered";
+			return RESULT_ERROR;
+		case CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY:
+			*error = "Out of memory";
+			return RESULT_FAILED;
+		default:
+			*error = "Target failed";
+			return RESULT_FAILED;
+	}
+}
+
+/*
+ * finish_run() - Report the result of a job run and update its status
+ *
+ * @run:	Job run.
+ * @result:	Result of the run (RESULT_*).
+ * @report:	JSON result to report, NULL if none.
+ */
+static void finish_run(const job_run_t *run, const char *result, char *report)
+{
+	job_t *job = &jobs[run->index];
+
+	pthread_mutex_lock(&jobs_lock);
+	if (report != NULL)
+		queue_result(report);
+	/* The job may have been removed or replaced while running */
+	if (job->generation == run->generation) {
+		job->status.running = false;
+		copy_string(job->status.last_result, sizeof(job->status.last_result), result);
+		dirty = true;
+	}
+	n_running--;
+	pthread_cond_broadcast(&jobs_cond);
+	pthread_mutex_unlock(&jobs_lock);
+}
+
+/*
+ * job_run_threaded() - Run a job in a new thread
+ *
+ * @arg:	Job run (job_run_t), freed when done.
+ */
+static void *job_run_threaded(void *arg)
+{
+	job_run_t *run = arg;
+	char output[MAX_OUTPUT_SIZE];
+	const char *result, *error = NULL;
+	time_t started = time(NULL);
+	uint64_t start_ms = get_monotonic_ms();
+	int exit_code = -1;
+	size_t len = 0;
+
+	log_jobs_info("Running job '%s'%s", run->def.name, run->missed ? " (missed run)" : "");
+
+	if (run->def.type == JOB_TYPE_COMMAND) {
+		if (run->command == NULL) {
+			error = "Command not allowed";
+			result = RESULT_ERROR;
+		} else {
+			result = run_command(run, output, &len, &exit_code, &error);
+		}
+	} else {
+		result = run_target(run, output, &len, &error);
+	}
+
+	finish_run(run, result, build_result(run, result, started, get_monotonic_ms() - start_ms,
+		exit_code, error, output, len));
+
+	free(run->command);
+	free(run);
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * start_run() - Start a run of a job
+ *
+ * @index:	Slot of the job.
+ * @scheduled:	Time the run was scheduled for.
+ * @missed:	True if it is a missed run.
+ * @manual:	True if it was requested out of the schedule.
+ *
+ * Must be called with 'jobs_lock' held.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int start_run(unsigned int index, time_t scheduled, bool missed, bool manual)
+{
+	job_t *job = &jobs[index];
+	job_run_t *run = calloc(1, sizeof(*run));
+	const char *command = NULL;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int error;
+
+	if (job->def.type == JOB_TYPE_COMMAND)
+		command = find_command(job->def.action);
+
+	if (run == NULL || (command != NULL && (run->command = strdup(command)) == NULL)) {
+		log_jobs_error("Unable to run job '%s': %s", job->def.name, "Out of memory");
+		free(run);
+		return -1;
+	}
+
+	run->def = job->def;
+	run->index = index;
+	run->generation = job->generation;
+	run->scheduled = scheduled;
+	run->missed = missed;
+	run->manual = manual;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	error = pthread_create(&thread, &attr, job_run_threaded, run);
+	pthread_attr_destroy(&attr);
+	if (error != 0) {
+		log_jobs_error("Unable to run job '%s': %s (%d)", job->def.name, strerror(error), error);
+		free(run->command);
+		free(run);
+		return -1;
+	}
+
+	job->status.running = true;
+	job->status.last_run = time(NULL);
+	n_running++;
+	dirty = true;
+
+	return 0;
+}
+
+/*
+ * skip_run() - Report a run of a job that is not executed
+ *
+ * @index:	Slot of the job.
+ * @scheduled:	Time the run was scheduled for.
+ * @missed:	True if it is a missed run.
+ * @reason:	Reason to skip the run.
+ *
+ * Must be called with 'jobs_lock' held.
+ */
+static void skip_run(unsigned int index, time_t scheduled, bool missed, const char *reason)
+{
+	job_run_t run;
+	char *report;
+
+	memset(&run, 0, sizeof(run));
+	run.def = jobs[index].def;
+	run.scheduled = scheduled;
+	run.missed = missed;
+
+	copy_string(jobs[index].status.last_result, sizeof(jobs[index].status.last_result), RESULT_SKIPPED);
+	dirty = true;
+
+	report = build_result(&run, RESULT_SKIPPED, 0, 0, -1, reason, NULL, 0);
+	if (report != NULL)
+		queue_result(report);
+}
+
+/*
+ * schedule_next_run() - Schedule the next run of a job after a run is due
+ *
+ * @index:	Slot of the job.
+ * @now:	Current time.
+ * @missed:	True if the due run was a missed run.
+ *
+ * One-shot jobs are removed. Must be called with 'jobs_lock' held.
+ */
+static void schedule_next_run(unsigned int index, time_t now, bool missed)
+{
+	job_t *job = &jobs[index];
+
+	if (job->once > 0) {
+		log_jobs_debug("One-shot job '%s' done, removing it", job->def.name);
+		set_job(index, NULL);
+		return;
+	}
+
+	if (missed && job->def.missed == JOB_MISSED_RUN_ALL && ++job->catchup < MAX_CATCHUP_RUNS) {
+		/* Run the following missed runs one after the other */
+		job->status.next_run = cron_next(&job->cron, job->status.next_run);
+	} else {
+		if (job->catchup >= MAX_CATCHUP_RUNS)
+			log_jobs_info("Job '%s' missed too many runs, skipping the rest", job->def.name);
+		job->catchup = 0;
+		job->status.next_run = cron_next(&job->cron, now);
+	}
+
+	dirty = true;
+}
+
+/*
+ * check_job() - Run a job if it is due
+ *
+ * @index:	Slot of the job.
+ * @now:	Current time.
+ *
+ * Must be called with 'jobs_lock' held.
+ */
+static void check_job(unsigned int index, time_t now)
+{
+	job_t *job = &jobs[index];
+	bool missed;
+
+	if (job->def.name[0] == '\0')
+		return;
+
+	if (job->run_now && !job->status.running && n_running < MAX_RUNNING_JOBS) {
+		job->run_now = false;
+		start_run(index, now, false, true);
+	}
+
+	if (!job->def.enabled)
+		return;
+
+	if (job->status.next_run == 0) {
+		job->status.next_run = get_next_run(job, now);
+		if (job->status.next_run == 0)
+			return;
+		dirty = true;
+	}
+
+	if (job->status.next_run > now)
+		return;
+
+	missed = now - job->status.next_run > MISSED_GRACE_SEC;
+	if (missed && job->def.missed == JOB_MISSED_SKIP) {
+		skip_run(index, job->status.next_run, true, "Missed run");
+	} else if (job->status.running) {
+		/* Missed runs to catch up wait for the previous one */
+		if (missed && job->catchup > 0)
+			return;
+		skip_run(index, job->status.next_run, missed, "Previous run still running");
+	} else if (n_running >= MAX_RUNNING_JOBS) {
+		return;
+	} else {
+		if (!missed)
+			job->catchup = 0;
+		if (start_run(index, job->status.next_run, missed, false) != 0)
+			copy_string(job->status.last_result, sizeof(job->status.last_result), RESULT_ERROR);
+	}
+
+	schedule_next_run(index, now, missed);
+}
+
+/*
+ * reschedule_jobs() - Reschedule the recurring jobs after the clock goes back
+ *
+ * @now:	Current time.
+ *
+ * Must be called with 'jobs_lock' held.
+ */
+static void reschedule_jobs(time_t now)
+{
+	int i;
+
+	for (i = 0; i < JOB_MAX_JOBS; i++) {
+		if (jobs[i].def.name[0] == '\0' || jobs[i].once > 0)
+			continue;
+
+		jobs[i].status.next_run = cron_next(&jobs[i].cron, now);
+		jobs[i].catchup = 0;
+		dirty = true;
+	}
+}
+
+/*
+ * job_scheduler_threaded() - Run the scheduled jobs in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *job_scheduler_threaded(void *unused)
+{
+	time_t last_check = 0;
+
+	UNUSED_ARGUMENT(unused);
+
+	while (!stop_requested) {
+		struct timespec ts;
+		bool pending;
+
+		pthread_mutex_lock(&jobs_lock);
+
+		if (clock_is_valid()) {
+			time_t now = time(NULL);
+			int i;
+
+			if (now < last_check - MISSED_GRACE_SEC) {
+				log_jobs_info("%s", "System time went back, rescheduling jobs");
+				reschedule_jobs(now);
+			}
+			last_check = now;
+
+			for (i = 0; i < JOB_MAX_JOBS && !stop_requested; i++)
+				check_job(i, now);
+		}
+
+		if (dirty)
+			save_jobs();
+
+		pending = n_pending_results > 0;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += 1;
+		if (!stop_requested && (!pending || get_cloud_connection_status() != CC_STATUS_CONNECTED))
+			pthread_cond_timedwait(&jobs_cond, &jobs_lock, &ts);
+
+		pthread_mutex_unlock(&jobs_lock);
+
+		if (pending && get_cloud_connection_status() == CC_STATUS_CONNECTED)
+			send_results();
+	}
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+int start_job_scheduler(const cc_cfg_t *const cc_cfg)
+{
+	jobs_cfg = cc_cfg;
+
+	pthread_mutex_lock(&jobs_lock);
+	if (!loaded) {
+		load_jobs();
+		loaded = true;
+	}
+	pthread_mutex_unlock(&jobs_lock);
+
+	if (!(cc_cfg->services & JOB_SCHEDULER_SERVICE)) {
+		log_jobs_debug("%s", "Job scheduler disabled");
+		return 0;
+	}
+
+	if (jobs_thread_valid)
+		return 0;
+
+	stop_requested = false;
+	jobs_thread_valid = (pthread_create(&jobs_thread, NULL, job_scheduler_threaded, NULL) == 0);
+	if (!jobs_thread_valid) {
+		log_jobs_error("%s", "Unable to start job scheduler thread");
+		return 1;
+	}
+
+	return 0;
+}
+
+void stop_job_scheduler(void)
+{
+	pthread_mutex_lock(&jobs_lock);
+	stop_requested = true;
+	pthread_cond_broadcast(&jobs_cond);
+	pthread_mutex_unlock(&jobs_lock);
+
+	if (jobs_thread_valid) {
+		jobs_thread_valid = false;
+		pthread_join(jobs_thread, NULL);
+	}
+
+	/* Running commands are stopped, wait for them */
+	pthread_mutex_lock(&jobs_lock);
+	while (n_running > 0)
+		pthread_cond_wait(&jobs_cond, &jobs_lock);
+	if (dirty)
+		save_jobs();
+	pthread_mutex_unlock(&jobs_lock);
+}
+
+int job_scheduler_get(unsigned int index, job_def_t *def, job_status_t *status)
+{
+	if (index >= JOB_MAX_JOBS)
+		return -1;
+
+	pthread_mutex_lock(&jobs_lock);
+	*def = jobs[index].def;
+	if (status != NULL)
+		*status = jobs[index].status;
+	pthread_mutex_unlock(&jobs_lock);
+
+	return 0;
+}
+
+/*
+ * same_def() - Check if two job definitions are the same
+ *
+ * @a:	First job definition.
+ * @b:	Second job definition.
+ *
+ * Return: True if they are the same, false otherwise.
+ */
+static bool same_def(const job_def_t *a, const job_def_t *b)
+{
+	return strcmp(a->name, b->name) == 0
+		&& strcmp(a->schedule, b->schedule) == 0
+		&& a->type == b->type
+		&& strcmp(a->action, b->action) == 0
+		&& strcmp(a->payload, b->payload) == 0
+		&& a->missed == b->missed
+		&& a->timeout == b->timeout
+		&& a->nice == b->nice
+		&& a->memory_kb == b->memory_kb
+		&& a->enabled == b->enabled;
+}
+
+/*
+ * update_job() - Validate and set the definition of a job slot
+ *
+ * @index:	Index of the slot.
+ * @def:	New job definition, with an empty name to free the slot.
+ *
+ * Must be called with 'jobs_lock' held.
+ *
+ * Return: NULL on success, the error description otherwise.
+ */
+static const char *update_job(unsigned int index, const job_def_t *def)
+{
+	const char *error;
+	time_t once = 0;
+	int existing;
+	cron_t cron;
+
+	if (def->name[0] == '\0') {
+		if (jobs[index].def.name[0] != '\0') {
+			log_jobs_info("Job '%s' removed", jobs[index].def.name);
+			set_job(index, NULL);
+			save_jobs();
+		}
+		return NULL;
+	}
+
+	error = job_scheduler_check(def);
+	if (error != NULL)
+		return error;
+
+	existing = find_job(def->name);
+	if (existing >= 0 && (unsigned int) existing != index)
+		return "Duplicated job name";
+
+	if (def->type == JOB_TYPE_COMMAND && find_command(def->action) == NULL)
+		return "Command not allowed";
+
+	if (same_def(def, &jobs[index].def))
+		return NULL;
+
+	parse_schedule(def->schedule, &cron, &once);
+	if (once > 0 && clock_is_valid() && once < time(NULL) - MISSED_GRACE_SEC)
+		return "Schedule in the past";
+
+	set_job(index, def);
+	if (clock_is_valid())
+		jobs[index].status.next_run = get_next_run(&jobs[index], time(NULL));
+	save_jobs();
+
+	log_jobs_info("Job '%s' set (%s)", def->name, def->schedule);
+
+	return NULL;
+}
+
+const char *job_scheduler_set(unsigned int index, const job_def_t *def)
+{
+	const char *error;
+
+	if (index >= JOB_MAX_JOBS)
+		return "Invalid job index";
+
+	pthread_mutex_lock(&jobs_lock);
+	error = update_job(index, def);
+	pthread_mutex_unlock(&jobs_lock);
+
+	return error;
+}
+
+/*
+ * add_jobs_list() - Add the jobs and the available commands to a response
+ *
+ * @resp:	Response to fill.
+ *
+ * Return: NULL on success, the error description otherwise.
+ */
+static const char *add_jobs_list(json_object *resp)
+{
+	json_object *list = json_object_new_array(), *commands = json_object_new_array();
+	const char *error = NULL;
+	unsigned int i;
+
+	if (list == NULL || json_object_object_add(resp, "jobs", list) != 0) {
+		json_object_put(list);
+		json_object_put(commands);
+		return "Out of memory";
+	}
+	if (commands == NULL || json_object_object_add(resp, "commands", commands) != 0) {
+		json_object_put(commands);
+		return "Out of memory";
+	}
+
+	for (i = 0; jobs_cfg != NULL && i < jobs_cfg->n_job_commands; i++) {
+		const char *cmd = jobs_cfg->job_commands[i];
+		const char *sep = strchr(cmd, '=');
+		json_object *name = json_object_new_string_len(cmd, sep != NULL ? (int) (sep - cmd) : (int) strlen(cmd));
+
+		if (name == NULL || json_object_array_add(commands, name) != 0) {
+			json_object_put(name);
+			return "Out of memory";
+		}
+	}
+
+	if (json_object_object_add(resp, "enabled", json_object_new_boolean(jobs_thread_valid)) != 0)
+		return "Out of memory";
+
+	pthread_mutex_lock(&jobs_lock);
+	for (i = 0; i < JOB_MAX_JOBS && error == NULL; i++) {
+		json_object *item;
+
+		if (jobs[i].def.name[0] == '\0')
+			continue;
+
+		item = job_to_json(&jobs[i], false);
+		if (item == NULL || json_object_array_add(list, item) != 0) {
+			json_object_put(item);
+			error = "Out of memory";
+		}
+	}
+	pthread_mutex_unlock(&jobs_lock);
+
+	return error;
+}
+
+/*
+ * process_jobs_request() - Process a job scheduler request
+ *
+ * @req:	Request object.
+ * @resp:	Response to fill.
+ *
+ * Return: NULL on success, the error description otherwise.
+ */
+static const char *process_jobs_request(json_object *req, json_object *resp)
+{
+	json_object *op_obj, *job_obj = NULL;
+	const char *op, *name, *error = NULL;
+	job_def_t def;
+	int index;
+
+	if (!json_object_object_get_ex(req, "op", &op_obj) || !json_object_is_type(op_obj, json_type_string))
+		return "Missing operation";
+	op = json_object_get_string(op_obj);
+
+	if (strcmp(op, "list") == 0)
+		return add_jobs_list(resp);
+
+	if (strcmp(op, "add") == 0) {
+		if (!json_object_object_get_ex(req, "job", &job_obj) || !json_object_is_type(job_obj, json_type_object))
+			return "Missing job";
+		error = json_to_def(job_obj, &def);
+		if (error != NULL)
+			return error;
+		name = def.name;
+	} else if (strcmp(op, "get") != 0 && strcmp(op, "remove") != 0 && strcmp(op, "run") != 0) {
+		return "Unknown operation";
+	} else {
+		name = get_string_member(req, "name");
+		if (name == NULL)
+			return "Missing job name";
+	}
+
+	pthread_mutex_lock(&jobs_lock);
+
+	index = find_job(name);
+	if (strcmp(op, "add") == 0) {
+		for (index = index < 0 ? 0 : index; index < JOB_MAX_JOBS; index++) {
+			if (jobs[index].def.name[0] == '\0' || strcmp(jobs[index].def.name, name) == 0)
+				break;
+		}
+		if (index == JOB_MAX_JOBS)
+			error = "Too many jobs";
+		else
+			error = update_job(index, &def);
+	} else if (index < 0) {
+		error = "Unknown job";
+	} else if (strcmp(op, "remove") == 0) {
+		log_jobs_info("Job '%s' removed", name);
+		set_job(index, NULL);
+		save_jobs();
+		index = -1;
+	} else if (strcmp(op, "run") == 0) {
+		if (!jobs_thread_valid) {
+			error = "Job scheduler is disabled";
+		} else {
+			jobs[index].run_now = true;
+			pthread_cond_broadcast(&jobs_cond);
+		}
+	}
+
+	if (error == NULL && index >= 0) {
+		job_obj = job_to_json(&jobs[index], false);
+		if (job_obj == NULL || json_object_object_add(resp, "job", job_obj) != 0) {
+			json_object_put(job_obj);
+			error = "Out of memory";
+		}
+	}
+
+	pthread_mutex_unlock(&jobs_lock);
+
+	return error;
+}
+
+ccapi_receive_error_t job_scheduler_request_cb(const char *const target,
+	const ccapi_transport_t transport,
+	const ccapi_buffer_info_t *const request_buffer_info,
+	ccapi_buffer_info_t *const response_buffer_info)
+{
+	json_object *req = NULL, *resp = json_object_new_object();
+	ccapi_receive_error_t ret = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
+	const char *error = NULL;
+
+	log_jobs_debug("%s: target='%s' - transport='%d'", __func__, target, transport);
+
+	response_buffer_info->buffer = NULL;
+	response_buffer_info->length = 0;
+
+	if (resp == NULL)
+		goto done;
+
+	if (request_buffer_info == NULL || request_buffer_info->buffer == NULL
+		|| request_buffer_info->length == 0) {
+		error = "Empty request";
+	} else {
+		char *str = strndup(request_buffer_info->buffer, request_buffer_info->length);
+
+		req = str != NULL ? json_tokener_parse(str) : NULL;
+		free(str);
+		if (req == NULL || !json_object_is_type(req, json_type_object))
+			error = "Invalid JSON request";
+		else
+			error = process_jobs_request(req, resp);
+	}
+
+	if (json_object_object_add(resp, "status", json_object_new_string(error == NULL ? "ok" : "error")) != 0
+		|| (error != NULL && json_object_object_add(resp, "error", json_object_new_string(error)) != 0))
+		goto done;
+
+	if (error != NULL)
+		log_jobs_error("Job scheduler request failed: %s", error);
+
+	response_buffer_info->buffer = strdup(json_object_to_json_string_ext(resp, JSON_C_TO_STRING_PLAIN));
+	if (response_buffer_info->buffer != NULL) {
+		response_buffer_info->length = strlen(response_buffer_info->buffer);
+		ret = CCAPI_RECEIVE_ERROR_NONE;
+	}
+
+done:
+	if (ret != CCAPI_RECEIVE_ERROR_NONE)
+		log_jobs_error("Cannot generate response for target '%s': Out of memory", target);
+
+	json_object_put(req);
+	json_object_put(resp);
+
+	return ret;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_JOB_SCHEDULER_H_
+#define CC_JOB_SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ccapi/ccapi.h"
+#include "cc_config.h"
+
+/* Number of job slots, also the number of 'scheduled_jobs' RCI instances */
+#define JOB_MAX_JOBS			16
+
+#define JOB_NAME_MAX_LEN		63
+#define JOB_SCHEDULE_MAX_LEN		63
+#define JOB_ACTION_MAX_LEN		63
+#define JOB_PAYLOAD_MAX_LEN		1024
+
+#define JOB_DEFAULT_TIMEOUT		300
+#define JOB_DEFAULT_NICE		10
+
+typedef enum {
+	JOB_TYPE_TARGET,
+	JOB_TYPE_COMMAND
+} job_type_t;
+
+/* What to do with the runs missed while the device was off or busy */
+typedef enum {
+	JOB_MISSED_SKIP,
+	JOB_MISSED_RUN_ONCE,
+	JOB_MISSED_RUN_ALL
+} job_missed_t;
+
+/*
+ * struct job_def_t - Scheduled job definition type
+ *
+ * @name:	Unique name of the job, empty for a free slot.
+ * @schedule:	Cron expression ('<minute> <hour> <day> <month> <weekday>'),
+ *		'@hourly', '@daily', '@weekly', '@monthly', '@yearly', or
+ *		'@once <YYYY-MM-DDTHH:MM:SSZ>' for a one-shot job.
+ * @type:	JOB_TYPE_TARGET to send a data request to a local application,
+ *		JOB_TYPE_COMMAND to run one of the 'job_commands'.
+ * @action:	Data request target or command name to run.
+ * @payload:	Data request payload, or standard input of the command.
+ * @missed:	Policy for the runs missed while the daemon was not running.
+ * @timeout:	Maximum number of seconds the job can run.
+ * @nice:	Nice value of the command (-20 to 19).
+ * @memory_kb:	Maximum memory (kb) of the command, 0 for no limit.
+ * @enabled:	True to run the job, false to keep it without running.
+ */
+typedef struct {
+	char name[JOB_NAME_MAX_LEN + 1];
+	char schedule[JOB_SCHEDULE_MAX_LEN + 1];
+	job_type_t type;
+	char action[JOB_ACTION_MAX_LEN + 1];
+	char payload[JOB_PAYLOAD_MAX_LEN + 1];
+	job_missed_t missed;
+	uint32_t timeout;
+	int32_t nice;
+	uint32_t memory_kb;
+	bool enabled;
+} job_def_t;
+
+/*
+ * struct job_status_t - Scheduled job status type
+ *
+ * @next_run:		Time of the next run, 0 if not scheduled.
+ * @last_run:		Time of the last run, 0 if it never ran.
+ * @last_result:	Result of the last run, empty if it never ran.
+ * @running:		True if the job is running.
+ */
+typedef struct {
+	time_t next_run;
+	time_t last_run;
+	char last_result[16];
+	bool running;
+} job_status_t;
+
+/*
+ * start_job_scheduler() - Start the scheduler of jobs
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * Loads the jobs stored in a previous execution and, if the scheduler is
+ * enabled, runs them when they are due. Runs missed while the daemon was not
+ * running are handled according to the policy of each job. Jobs can be
+ * managed even if the scheduler is disabled.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+int start_job_scheduler(const cc_cfg_t *const cc_cfg);
+
+/*
+ * stop_job_scheduler() - Stop the scheduler of jobs
+ *
+ * Running commands are stopped, and running data requests are waited for.
+ */
+void stop_job_scheduler(void);
+
+/*
+ * job_scheduler_check() - Check a job definition
+ *
+ * @def:	Job definition to check.
+ *
+ * Return: NULL if the definition is valid, the error description otherwise.
+ */
+const char *job_scheduler_check(const job_def_t *def);
+
+/*
+ * job_scheduler_get() - Get a job slot
+ *
+ * @index:	Index of the slot, from 0 to JOB_MAX_JOBS - 1.
+ * @def:	Struct to store the job definition, with an empty name if the
+ *		slot is free.
+ * @status:	Struct to store the job status, NULL if not needed.
+ *
+ * Return: 0 on success, -1 if the index is not valid.
+ */
+int job_scheduler_get(unsigned int index, job_def_t *def, job_status_t *status);
+
+/*
+ * job_scheduler_set() - Set a job slot
+ *
+ * @index:	Index of the slot, from 0 to JOB_MAX_JOBS - 1.
+ * @def:	New job definition, with an empty name to free the slot.
+ *
+ * The job is rescheduled from the current time and stored to keep it after a
+ * restart.
+ *
+ * Return: NULL on success, the error description otherwise.
+ */
+const char *job_scheduler_set(unsigned int index, const job_def_t *def);
+
+/*
+ * job_scheduler_request_cb() - Data request callback to manage the jobs
+ *
+ * @target:			Target ID of the data request.
+ * @transport:			Communication transport used by the data request.
+ * @request_buffer_info:	Buffer with the JSON request.
+ * @response_buffer_info:	Buffer to store the JSON response.
+ *
+ * The request is a JSON object with an "op" member:
+ *   - "list": Get the jobs, the available commands and the scheduler status.
+ *   - "get": Get the job with the given "name".
+ *   - "add": Add the job in the "job" object, replacing any job with the same
+ *     name. Members are the fields of 'job_def_t' ("memory" in kb, "type" is
+ *     implied by a "target" or a "command" member, "missed" is "skip",
+ *     "run_once" or "run_all").
+ *   - "remove": Remove the job with the given "name".
+ *   - "run": Run the job with the given "name" now, out of its schedule.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE on success, any other error otherwise.
+ */
+ccapi_receive_error_t job_scheduler_request_cb(const char *const target,
+	const ccapi_transport_t transport,
+	const ccapi_buffer_info_t *const request_buffer_info,
+	ccapi_buffer_info_t *const response_buffer_info);
+
+#endif /* CC_JOB_SCHEDULER_H_ */
@@ -0,0 +1,1306 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <regex.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccapi/ccapi.h"
+#include "_cc_datapoints.h"
+#include "cc_clock.h"
+#include "cc_config.h"
+#include "cc_log_forward.h"
+#include "cc_logging.h"
+#include "service_common.h"
+
+#define LOG_FORWARD_TAG			"LOGFWD:"
+
+#define LOOP_MS				500
+#define RESPAWN_INTERVAL_MS		30 * 1000
+#define SEND_TIMEOUT			30	/* seconds */
+
+#define MAX_LINE_LENGTH			1024
+#define MAX_IDENT_LENGTH		64
+#define MAX_JSON_LENGTH			(MAX_LINE_LENGTH * 2 + 256)
+#define JSON_RESERVED_LENGTH		48
+#define MAX_QUEUED_MESSAGES		DP_MAX_NUMBER_PER_REQUEST * 4
+#define READ_BUFFER_SIZE		8 * 1024
+
+/* Seconds of messages that can be forwarded in a burst over the rate */
+#define RATE_BURST			5
+
+#define DATA_STREAM_PREFIX		"logs/"
+
+#define ARRAY_SIZE(array)		(sizeof(array) / sizeof(array[0]))
+
+/**
+ * log_lf_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_lf_debug(format, ...)					\
+	log_debug("%s " format, LOG_FORWARD_TAG, __VA_ARGS__)
+
+/**
+ * log_lf_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_lf_info(format, ...)					\
+	log_info("%s " format, LOG_FORWARD_TAG, __VA_ARGS__)
+
+/**
+ * log_lf_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_lf_error(format, ...)					\
+	log_error("%s " format, LOG_FORWARD_TAG, __VA_ARGS__)
+
+typedef enum {
+	LOG_SRC_CCCSD,
+	LOG_SRC_SYSLOG,
+	LOG_SRC_JOURNAL,
+	LOG_SRC_COUNT
+} log_source_id_t;
+
+/**
+ * struct log_msg_t - Queued log message
+ *
+ * @timestamp_ms:	Time of the message (first one for repeated messages)
+ * @priority:		Syslog priority of the message
+ * @repeat:		Number of consecutive times the message was logged
+ * @in_flight:		True while the message is being uploaded
+ * @ident:		Identifier of the process that logged it, NULL if unknown
+ * @text:		Message
+ * @next:		Next queued message
+ */
+typedef struct log_msg {
+	uint64_t timestamp_ms;
+	int priority;
+	unsigned int repeat;
+	bool in_flight;
+	char *ident;
+	char *text;
+	struct log_msg *next;
+} log_msg_t;
+
+/**
+ * struct journal_entry_t - Fields of the journal entry being parsed
+ *
+ * @priority:		Value of 'PRIORITY'
+ * @pid:		Value of '_PID'
+ * @timestamp_ms:	Value of '__REALTIME_TIMESTAMP' in milliseconds
+ * @ident:		Value of 'SYSLOG_IDENTIFIER'
+ * @text:		Value of 'MESSAGE'
+ */
+typedef struct {
+	int priority;
+	pid_t pid;
+	uint64_t timestamp_ms;
+	char ident[MAX_IDENT_LENGTH];
+	char text[MAX_LINE_LENGTH];
+} journal_entry_t;
+
+/**
+ * struct log_source_t - Log source
+ *
+ * @name:		Name of the source, also the data stream name
+ * @argv:		Command to follow the source, NULL for the own log
+ * @enabled:		True if the messages of the source are forwarded
+ * @pid:		Process id of the running command, -1 if not running
+ * @fd:			Read end of the command output, -1 if not running
+ * @respawn_ms:		Time to start the command again after it exits
+ * @buffer:		Output of the command pending to parse
+ * @len:		Number of bytes in 'buffer'
+ * @skip:		Number of bytes to discard of an oversized field
+ * @skip_line:		True to discard bytes until the next new line
+ * @entry:		Journal entry being parsed
+ * @head:		First queued message
+ * @tail:		Last queued message
+ * @count:		Number of queued messages
+ * @dropped:		Number of messages dropped since the last upload
+ */
+typedef struct {
+	const char *name;
+	char *const *argv;
+	bool enabled;
+	pid_t pid;
+	int fd;
+	uint64_t respawn_ms;
+	char buffer[READ_BUFFER_SIZE];
+	size_t len;
+	uint64_t skip;
+	bool skip_line;
+	journal_entry_t entry;
+	log_msg_t *head;
+	log_msg_t *tail;
+	unsigned int count;
+	unsigned int dropped;
+} log_source_t;
+
+static char *const logread_argv[] = { "logread", "-f", NULL };
+static char *const journalctl_argv[] = { "journalctl", "-f", "-n", "0", "-o", "export", NULL };
+
+static log_source_t sources[LOG_SRC_COUNT] = {
+	[LOG_SRC_CCCSD] = { .name = LOG_FWD_SOURCE_CCCSD, .argv = NULL },
+	[LOG_SRC_SYSLOG] = { .name = LOG_FWD_SOURCE_SYSLOG, .argv = logread_argv },
+	[LOG_SRC_JOURNAL] = { .name = LOG_FWD_SOURCE_JOURNAL, .argv = journalctl_argv },
+};
+
+static const char *const priority_names[] = {
+	"emerg", "alert", "crit", "err", "warning", "notice", "info", "debug"
+};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool stop_requested = false;
+static volatile bool fwd_thread_valid = false;
+static pthread_t fwd_thread;
+
+/* Forwarder settings, copied when it starts */
+static volatile bool accepting = false;
+static volatile int max_priority = LOG_WARNING;
+static regex_t filter_regex, exclude_regex;
+static bool has_filter = false, has_exclude = false;
+static uint32_t rate, interval, upload_size;
+static char *backlog_path = NULL;
+static uint32_t backlog_kb = 0;
+
+/* Token bucket, in thousandths of a message */
+static uint64_t tokens = 0, last_refill_ms = 0;
+
+/*
+ * get_monotonic_ms() - Get the milliseconds since an unspecified point
+ *
+ * Return: Number of milliseconds.
+ */
+static uint64_t get_monotonic_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * get_epoch_ms() - Get the milliseconds since the epoch
+ *
+ * Return: Number of milliseconds.
+ */
+static uint64_t get_epoch_ms(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+
+	return (uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+/*
+ * is_forwarder_thread() - Check if the caller is the forwarder thread
+ *
+ * Messages logged by the forwarder itself are not forwarded, so an upload
+ * error does not generate new messages to upload.
+ *
+ * Return: True if called from the forwarder thread, false otherwise.
+ */
+static bool is_forwarder_thread(void)
+{
+	return fwd_thread_valid && pthread_equal(pthread_self(), fwd_thread);
+}
+
+/*
+ * matches_filters() - Check if a message passes the pattern filters
+ *
+ * @ident:	Identifier of the process that logged the message, or NULL.
+ * @text:	Message.
+ *
+ * Patterns are matched against '<ident>: <text>', or just '<text>' if the
+ * identifier is unknown.
+ *
+ * Return: True if the message must be forwarded, false otherwise.
+ */
+static bool matches_filters(const char *ident, const char *text)
+{
+	char line[MAX_LINE_LENGTH];
+	const char *subject = text;
+
+	if (!has_filter && !has_exclude)
+		return true;
+
+	if (ident) {
+		snprintf(line, sizeof(line), "%s: %s", ident, text);
+		subject = line;
+	}
+
+	if (has_filter && regexec(&filter_regex, subject, 0, NULL, 0) != 0)
+		return false;
+
+	return !has_exclude || regexec(&exclude_regex, subject, 0, NULL, 0) != 0;
+}
+
+/*
+ * take_token() - Take a message from the rate limit bucket
+ *
+ * Must be called with 'queue_lock' held.
+ *
+ * Return: True if the message can be forwarded, false if the rate is exceeded.
+ */
+static bool take_token(void)
+{
+	uint64_t now_ms, capacity;
+
+	if (rate == 0)
+		return true;
+
+	capacity = (uint64_t) rate * RATE_BURST * 1000;
+	now_ms = get_monotonic_ms();
+	tokens += (now_ms - last_refill_ms) * rate;
+	if (tokens > capacity)
+		tokens = capacity;
+	last_refill_ms = now_ms;
+
+	if (tokens < 1000)
+		return false;
+
+	tokens -= 1000;
+
+	return true;
+}
+
+/*
+ * queue_message() - Queue a message to forward
+ *
+ * @src:		Source of the message.
+ * @priority:		Syslog priority of the message.
+ * @ident:		Identifier of the process that logged it, or NULL.
+ * @text:		Message.
+ * @timestamp_ms:	Time of the message in milliseconds since the epoch.
+ *
+ * Filtered messages are ignored. A message equal to the last queued one of
+ * the source only increments its repeat count. Messages over the rate, or
+ * that do not fit in the queue, are dropped and counted.
+ */
+static void queue_message(log_source_t *src, int priority, const char *ident,
+	const char *text, uint64_t timestamp_ms)
+{
+	log_msg_t *msg, *last;
+
+	priority = LOG_PRI(priority);
+	if (priority > max_priority)
+		return;
+
+	pthread_mutex_lock(&queue_lock);
+
+	if (!accepting || !src->enabled || !matches_filters(ident, text))
+		goto done;
+
+	last = src->tail;
+	if (last && !last->in_flight && last->priority == priority
+		&& strcmp(last->text, text) == 0
+		&& ((!last->ident && !ident) || (last->ident && ident && strcmp(last->ident, ident) == 0))) {
+		last->repeat++;
+		goto done;
+	}
+
+	if (src->count >= MAX_QUEUED_MESSAGES || !take_token()) {
+		src->dropped++;
+		goto done;
+	}
+
+	msg = calloc(1, sizeof(*msg));
+	if (!msg) {
+		src->dropped++;
+		goto done;
+	}
+	msg->text = strdup(text);
+	msg->ident = ident ? strdup(ident) : NULL;
+	if (!msg->text || (ident && !msg->ident)) {
+		free(msg->text);
+		free(msg->ident);
+		free(msg);
+		src->dropped++;
+		goto done;
+	}
+	msg->timestamp_ms = timestamp_ms;
+	msg->priority = priority;
+	msg->repeat = 1;
+
+	if (last)
+		last->next = msg;
+	else
+		src->head = msg;
+	src->tail = msg;
+	src->count++;
+
+done:
+	pthread_mutex_unlock(&queue_lock);
+}
+
+void cc_syslog(int priority, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+
+	if (accepting && LOG_PRI(priority) <= max_priority && !is_forwarder_thread()) {
+		char text[MAX_LINE_LENGTH];
+		va_list copy;
+
+		va_copy(copy, args);
+		vsnprintf(text, sizeof(text), format, copy);
+		va_end(copy);
+
+		queue_message(&sources[LOG_SRC_CCCSD], priority, NULL, text, get_epoch_ms());
+	}
+
+	vsyslog(priority, format, args);
+
+	va_end(args);
+}
+
+/*
+ * skip_own_message() - Check if a message read from the system is ours
+ *
+ * @pid:	Process id that logged the message, or -1 if unknown.
+ *
+ * When the own log is forwarded, our messages are skipped in the system
+ * sources to not upload them twice.
+ *
+ * Return: True if the message must be skipped, false otherwise.
+ */
+static bool skip_own_message(pid_t pid)
+{
+	return sources[LOG_SRC_CCCSD].enabled && pid == getpid();
+}
+
+/*
+ * parse_priority_name() - Get the priority of a 'facility.priority' string
+ *
+ * @token:	String to parse.
+ * @len:	Length of the string.
+ *
+ * Return: The syslog priority, -1 if the string is not a priority.
+ */
+static int parse_priority_name(const char *token, size_t len)
+{
+	const char *dot = memchr(token, '.', len);
+	size_t name_len;
+	int i;
+
+	if (!dot)
+		return -1;
+
+	dot++;
+	name_len = len - (dot - token);
+	for (i = 0; i < (int) ARRAY_SIZE(priority_names); i++) {
+		if (strlen(priority_names[i]) == name_len && strncmp(dot, priority_names[i], name_len) == 0)
+			return i;
+	}
+	/* Short names used by some syslog daemons */
+	if (name_len == 4 && strncmp(dot, "warn", 4) == 0)
+		return LOG_WARNING;
+	if (name_len == 5 && strncmp(dot, "error", 5) == 0)
+		return LOG_ERR;
+
+	return -1;
+}
+
+/*
+ * parse_syslog_line() - Parse and queue a line of the system log
+ *
+ * @line:	Null-terminated line.
+ *
+ * Lines have the format of 'logread':
+ *   'Mon DD HH:MM:SS [hostname] facility.priority ident[pid]: message'
+ * Lines with a different format are queued as they are, with info priority.
+ */
+static void parse_syslog_line(char *line)
+{
+	char *p = line, *ident = NULL, *text = line, *end;
+	int priority = -1, i;
+	pid_t pid = -1;
+
+	/* Look for the priority after the timestamp and the optional hostname */
+	for (i = 0; i < 5 && priority < 0 && *p; i++) {
+		size_t len;
+
+		while (*p == ' ')
+			p++;
+		len = strcspn(p, " ");
+		if (i >= 3)
+			priority = parse_priority_name(p, len);
+		p += len;
+	}
+
+	if (priority < 0) {
+		priority = LOG_INFO;
+	} else {
+		while (*p == ' ')
+			p++;
+		end = strstr(p, ": ");
+		if (end && end - p < MAX_IDENT_LENGTH && !memchr(p, ' ', end - p)) {
+			char *bracket = memchr(p, '[', end - p);
+
+			*end = '\0';
+			if (bracket) {
+				*bracket = '\0';
+				pid = (pid_t) strtol(bracket + 1, NULL, 10);
+			}
+			ident = p;
+			text = end + 2;
+		} else {
+			text = p;
+		}
+	}
+
+	if (skip_own_message(pid))
+		return;
+
+	queue_message(&sources[LOG_SRC_SYSLOG], priority, ident, text, get_epoch_ms());
+}
+
+/*
+ * parse_syslog() - Parse the complete lines read from the system log
+ *
+ * @src:	System log source.
+ */
+static void parse_syslog(log_source_t *src)
+{
+	char *start = src->buffer, *nl;
+	size_t left = src->len;
+
+	while ((nl = memchr(start, '\n', left)) != NULL) {
+		*nl = '\0';
+		if (src->skip_line)
+			src->skip_line = false;
+		else if (nl > start)
+			parse_syslog_line(start);
+		left -= nl + 1 - start;
+		start = nl + 1;
+	}
+
+	if (left == sizeof(src->buffer)) {
+		/* Line too long: forward the beginning and discard the rest */
+		src->buffer[MAX_LINE_LENGTH - 1] = '\0';
+		if (!src->skip_line)
+			parse_syslog_line(src->buffer);
+		src->skip_line = true;
+		left = 0;
+	}
+
+	memmove(src->buffer, start, left);
+	src->len = left;
+}
+
+/*
+ * set_journal_field() - Store a field of the journal entry being parsed
+ *
+ * @entry:	Journal entry.
+ * @name:	Name of the field.
+ * @name_len:	Length of the name.
+ * @value:	Value of the field.
+ * @value_len:	Length of the value.
+ */
+static void set_journal_field(journal_entry_t *entry, const char *name, size_t name_len,
+	const char *value, size_t value_len)
+{
+	char number[32];
+
+#define FIELD_IS(field)	(name_len == strlen(field) && strncmp(name, field, name_len) == 0)
+
+	if (FIELD_IS("MESSAGE")) {
+		size_t i, len = value_len < sizeof(entry->text) - 1 ? value_len : sizeof(entry->text) - 1;
+
+		/* Binary messages may include any byte */
+		for (i = 0; i < len; i++)
+			entry->text[i] = value[i] != '\0' ? value[i] : ' ';
+		entry->text[len] = '\0';
+		return;
+	}
+
+	if (FIELD_IS("SYSLOG_IDENTIFIER")) {
+		size_t len = value_len < sizeof(entry->ident) - 1 ? value_len : sizeof(entry->ident) - 1;
+
+		memcpy(entry->ident, value, len);
+		entry->ident[len] = '\0';
+		return;
+	}
+
+	if (value_len >= sizeof(number))
+		return;
+	memcpy(number, value, value_len);
+	number[value_len] = '\0';
+
+	if (FIELD_IS("PRIORITY"))
+		entry->priority = (int) strtol(number, NULL, 10);
+	else if (FIELD_IS("_PID"))
+		entry->pid = (pid_t) strtol(number, NULL, 10);
+	else if (FIELD_IS("__REALTIME_TIMESTAMP"))
+		entry->timestamp_ms = strtoull(number, NULL, 10) / 1000;
+
+#undef FIELD_IS
+}
+
+/*
+ * reset_journal_entry() - Prepare the journal entry to parse a new one
+ *
+ * @entry:	Journal entry.
+ */
+static void reset_journal_entry(journal_entry_t *entry)
+{
+	entry->priority = LOG_INFO;
+	entry->pid = -1;
+	entry->timestamp_ms = 0;
+	entry->ident[0] = '\0';
+	entry->text[0] = '\0';
+}
+
+/*
+ * parse_journal() - Parse the complete fields read from the journal
+ *
+ * @src:	Journal source.
+ *
+ * The journal is read in export format: entries are lists of 'NAME=value'
+ * lines ended by an empty line. Fields with binary values are written as
+ * the name, a new line, the value size as 64-bit little endian, the value,
+ * and a new line.
+ */
+static void parse_journal(log_source_t *src)
+{
+	char *start = src->buffer, *nl;
+	size_t left = src->len;
+
+	while ((nl = memchr(start, '\n', left)) != NULL) {
+		size_t line_len = nl - start, avail = left - line_len - 1;
+		const unsigned char *size_ptr = (const unsigned char *) nl + 1;
+		char *eq = memchr(start, '=', line_len);
+		uint64_t size = 0;
+		int i;
+
+		if (src->skip_line) {
+			src->skip_line = false;
+		} else if (line_len == 0) {
+			journal_entry_t *entry = &src->entry;
+
+			if (entry->text[0] != '\0' && !skip_own_message(entry->pid))
+				queue_message(src, entry->priority,
+					entry->ident[0] != '\0' ? entry->ident : NULL,
+					entry->text,
+					entry->timestamp_ms ? entry->timestamp_ms : get_epoch_ms());
+			reset_journal_entry(entry);
+		} else if (eq) {
+			set_journal_field(&src->entry, start, eq - start, eq + 1, line_len - (eq - start) - 1);
+		} else {
+			/* Binary field */
+			if (avail < sizeof(size))
+				break;
+			for (i = sizeof(size) - 1; i >= 0; i--)
+				size = (size << 8) | size_ptr[i];
+			if (size >= sizeof(src->buffer)
+				|| line_len + 1 + sizeof(size) + size + 1 > sizeof(src->buffer)) {
+				/* It does not fit in the buffer: discard it */
+				src->skip = size + 1 - (avail - sizeof(size));
+				left = 0;
+				break;
+			}
+			if (avail - sizeof(size) < size + 1)
+				break;
+			set_journal_field(&src->entry, start, line_len, nl + 1 + sizeof(size), size);
+			nl += sizeof(size) + size + 1;
+		}
+		left -= nl + 1 - start;
+		start = nl + 1;
+	}
+
+	if (left == sizeof(src->buffer)) {
+		/* Field too long, discard it */
+		src->skip_line = true;
+		left = 0;
+	}
+
+	memmove(src->buffer, start, left);
+	src->len = left;
+}
+
+/*
+ * spawn_source() - Start the command that follows a log source
+ *
+ * @src:	Log source.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int spawn_source(log_source_t *src)
+{
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) != 0) {
+		log_lf_error("Unable to read '%s' log: %s (%d)", src->name, strerror(errno), errno);
+		return -1;
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		sigset_t set;
+		int null_fd = open("/dev/null", O_RDWR);
+
+		/* Do not log here, other threads may hold the logging locks */
+		dup2(fds[1], STDOUT_FILENO);
+		if (null_fd >= 0) {
+			dup2(null_fd, STDIN_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+		}
+		signal(SIGPIPE, SIG_DFL);
+		sigemptyset(&set);
+		sigprocmask(SIG_SETMASK, &set, NULL);
+		execvp(src->argv[0], src->argv);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	if (pid < 0) {
+		log_lf_error("Unable to read '%s' log: %s (%d)", src->name, strerror(errno), errno);
+		close(fds[0]);
+		return -1;
+	}
+
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+	src->pid = pid;
+	src->fd = fds[0];
+	src->len = 0;
+	src->skip = 0;
+	src->skip_line = false;
+	reset_journal_entry(&src->entry);
+
+	log_lf_debug("Following '%s' log with '%s' (pid %d)", src->name, src->argv[0], pid);
+
+	return 0;
+}
+
+/*
+ * close_source() - Stop the command that follows a log source
+ *
+ * @src:	Log source.
+ */
+static void close_source(log_source_t *src)
+{
+	if (src->fd >= 0) {
+		close(src->fd);
+		src->fd = -1;
+	}
+
+	if (src->pid > 0) {
+		kill(src->pid, SIGTERM);
+		waitpid(src->pid, NULL, 0);
+		src->pid = -1;
+	}
+}
+
+/*
+ * read_source() - Read and parse the available output of a log source
+ *
+ * @src:	Log source.
+ */
+static void read_source(log_source_t *src)
+{
+	ssize_t n;
+
+	do {
+		n = read(src->fd, src->buffer + src->len, sizeof(src->buffer) - src->len);
+		if (n <= 0)
+			break;
+
+		if (src->skip > 0) {
+			size_t drop = src->skip < (uint64_t) n ? (size_t) src->skip : (size_t) n;
+
+			memmove(src->buffer + src->len, src->buffer + src->len + drop, n - drop);
+			src->skip -= drop;
+			n -= drop;
+		}
+		src->len += n;
+
+		if (src->argv == journalctl_argv)
+			parse_journal(src);
+		else
+			parse_syslog(src);
+	} while (!stop_requested);
+
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		int status = 0;
+
+		close(src->fd);
+		src->fd = -1;
+		waitpid(src->pid, &status, 0);
+		src->pid = -1;
+
+		log_lf_error("Stopped reading '%s' log (exit status %d), retrying in %d seconds",
+			src->name, WIFEXITED(status) ? WEXITSTATUS(status) : -1,
+			RESPAWN_INTERVAL_MS / 1000);
+		src->respawn_ms = get_monotonic_ms() + RESPAWN_INTERVAL_MS;
+	}
+}
+
+/*
+ * append_json_string() - Append a JSON string to a buffer
+ *
+ * @buf:	Buffer.
+ * @size:	Size of the buffer.
+ * @len:	Length of the contents of the buffer.
+ * @str:	String to escape and append.
+ *
+ * The string is truncated if it does not fit.
+ *
+ * Return: The new length of the contents of the buffer.
+ */
+static size_t append_json_string(char *buf, size_t size, size_t len, const char *str)
+{
+	const unsigned char *p;
+
+	/* Keep room for an escape sequence and the rest of the JSON object */
+	if (len + JSON_RESERVED_LENGTH >= size)
+		return len;
+
+	buf[len++] = '"';
+	for (p = (const unsigned char *) str; *p && len + JSON_RESERVED_LENGTH < size; p++) {
+		switch (*p) {
+			case '"':
+			case '\\':
+				buf[len++] = '\\';
+				buf[len++] = *p;
+				break;
+			case '\n':
+				buf[len++] = '\\';
+				buf[len++] = 'n';
+				break;
+			case '\r':
+				buf[len++] = '\\';
+				buf[len++] = 'r';
+				break;
+			case '\t':
+				buf[len++] = '\\';
+				buf[len++] = 't';
+				break;
+			default:
+				if (*p < 0x20)
+					len += snprintf(buf + len, size - len, "\\u%04x", *p);
+				else
+					buf[len++] = *p;
+				break;
+		}
+	}
+	buf[len++] = '"';
+	buf[len] = '\0';
+
+	return len;
+}
+
+/*
+ * msg_to_json() - Get the JSON representation of a message
+ *
+ * @json:	Buffer to store the JSON.
+ * @size:	Size of the buffer.
+ * @msg:	Message.
+ */
+static void msg_to_json(char *json, size_t size, const log_msg_t *msg)
+{
+	size_t len;
+
+	len = snprintf(json, size, "{\"level\":\"%s\"", priority_names[msg->priority]);
+	if (msg->ident) {
+		len += snprintf(json + len, size - len, ",\"ident\":");
+		len = append_json_string(json, size, len, msg->ident);
+	}
+	len += snprintf(json + len, size - len, ",\"msg\":");
+	len = append_json_string(json, size, len, msg->text);
+	if (msg->repeat > 1)
+		len += snprintf(json + len, size - len, ",\"repeat\":%u", msg->repeat);
+	snprintf(json + len, size - len, "}");
+}
+
+/*
+ * add_msg_to_collection() - Add a message to a data point collection
+ *
+ * @collection:		Data point collection.
+ * @stream_id:		Data stream of the message.
+ * @json:		JSON value of the message.
+ * @timestamp_ms:	Time of the message in milliseconds since the epoch.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int add_msg_to_collection(ccapi_dp_collection_handle_t collection,
+	const char *stream_id, const char *json, uint64_t timestamp_ms)
+{
+	ccapi_timestamp_t timestamp;
+	ccapi_dp_error_t dp_error;
+
+	memset(&timestamp, 0, sizeof(timestamp));
+	timestamp.epoch.seconds = timestamp_ms / 1000;
+	timestamp.epoch.milliseconds = timestamp_ms % 1000;
+
+	dp_error = ccapi_dp_add(collection, stream_id, json, &timestamp);
+	if (dp_error != CCAPI_DP_ERROR_NONE) {
+		log_lf_error("Unable to add message to '%s': %d", stream_id, dp_error);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * upload_messages() - Upload the queued messages
+ *
+ * @store_only:	True to store the messages in the data backlog without
+ * 		trying to upload them.
+ *
+ * At most 'DP_MAX_NUMBER_PER_REQUEST' messages are uploaded. If the upload
+ * fails and a complete request cannot be sent, they are kept in the queue to
+ * retry. Otherwise they are moved to the data backlog, if it is enabled.
+ */
+static void upload_messages(bool store_only)
+{
+	unsigned int n_msgs[LOG_SRC_COUNT] = { 0 }, n_dropped[LOG_SRC_COUNT] = { 0 };
+	unsigned int total = 0, queued = 0, i;
+	ccapi_dp_collection_handle_t collection = NULL;
+	ccapi_dp_error_t dp_error;
+	buffer_info_t buf_info;
+	char json[MAX_JSON_LENGTH];
+	uint64_t now_ms = get_epoch_ms();
+	bool consumed = false;
+
+	/* Select the messages to send, new ones are added while sending */
+	pthread_mutex_lock(&queue_lock);
+	for (i = 0; i < LOG_SRC_COUNT; i++) {
+		log_msg_t *msg;
+
+		if (sources[i].dropped > 0 && total < DP_MAX_NUMBER_PER_REQUEST) {
+			n_dropped[i] = sources[i].dropped;
+			sources[i].dropped = 0;
+			total++;
+		}
+		for (msg = sources[i].head; msg && total < DP_MAX_NUMBER_PER_REQUEST; msg = msg->next) {
+			msg->in_flight = true;
+			n_msgs[i]++;
+			total++;
+		}
+		queued += sources[i].count;
+	}
+	pthread_mutex_unlock(&queue_lock);
+
+	if (total == 0)
+		return;
+
+	dp_error = ccapi_dp_create_collection(&collection);
+	if (dp_error != CCAPI_DP_ERROR_NONE) {
+		log_lf_error("Unable to create data point collection: %d", dp_error);
+		goto done;
+	}
+
+	for (i = 0; i < LOG_SRC_COUNT; i++) {
+		char stream_id[sizeof(DATA_STREAM_PREFIX) + 16];
+		log_msg_t *msg = sources[i].head;
+		unsigned int n;
+
+		if (n_msgs[i] == 0 && n_dropped[i] == 0)
+			continue;
+
+		snprintf(stream_id, sizeof(stream_id), DATA_STREAM_PREFIX "%s", sources[i].name);
+		dp_error = ccapi_dp_add_data_stream_to_collection_extra(collection, stream_id,
+			CCAPI_DP_KEY_DATA_JSON " " CCAPI_DP_KEY_TS_EPOCH, NULL, NULL);
+		if (dp_error != CCAPI_DP_ERROR_NONE) {
+			log_lf_error("Unable to add data stream '%s': %d", stream_id, dp_error);
+			goto done;
+		}
+
+		for (n = 0; n < n_msgs[i]; n++, msg = msg->next) {
+			msg_to_json(json, sizeof(json), msg);
+			if (add_msg_to_collection(collection, stream_id, json, msg->timestamp_ms) != 0)
+				goto done;
+		}
+
+		if (n_dropped[i] > 0) {
+			snprintf(json, sizeof(json),
+				"{\"level\":\"warning\",\"msg\":\"Messages dropped\",\"dropped\":%u}",
+				n_dropped[i]);
+			if (add_msg_to_collection(collection, stream_id, json, now_ms) != 0)
+				goto done;
+		}
+	}
+
+	if (dp_generate_csv_from_collection(collection, &buf_info, DP_MAX_NUMBER_PER_REQUEST, NULL) <= 0) {
+		log_lf_error("Unable to upload messages: %s", "Unable to generate data to send");
+		goto done;
+	}
+
+	if (store_only) {
+		consumed = dp_store_data(upload_datapoint_file_metrics, buf_info.buffer,
+			buf_info.bytes_written, NULL, backlog_path, backlog_kb) == 0;
+		if (consumed)
+			log_lf_debug("Stored %u messages in the data backlog", total);
+	} else {
+		ccapi_send_error_t ret;
+
+		log_lf_debug("Uploading %u messages", total);
+		ret = ccapi_send_data_with_reply(CCAPI_TRANSPORT_TCP, "DataPoint/.csv",
+			"text/plain", buf_info.buffer, buf_info.bytes_written,
+			CCAPI_SEND_BEHAVIOR_OVERWRITE, SEND_TIMEOUT, NULL);
+		if (ret == CCAPI_SEND_ERROR_NONE) {
+			consumed = true;
+		} else {
+			log_lf_error("Error uploading messages, %d", ret);
+
+			/* Only store the messages when there is a complete request */
+			consumed = queued >= DP_MAX_NUMBER_PER_REQUEST
+				&& dp_process_send_dp_error(upload_datapoint_file_metrics,
+					ret, buf_info.buffer, buf_info.bytes_written, NULL,
+					backlog_path, backlog_kb) == 0;
+		}
+	}
+
+	free(buf_info.buffer);
+
+done:
+	if (collection)
+		ccapi_dp_destroy_collection(collection);
+
+	pthread_mutex_lock(&queue_lock);
+	for (i = 0; i < LOG_SRC_COUNT; i++) {
+		log_source_t *src = &sources[i];
+		unsigned int n;
+
+		if (!consumed) {
+			log_msg_t *msg = src->head;
+
+			for (n = 0; n < n_msgs[i]; n++, msg = msg->next)
+				msg->in_flight = false;
+			src->dropped += n_dropped[i];
+			continue;
+		}
+
+		for (n = 0; n < n_msgs[i]; n++) {
+			log_msg_t *msg = src->head;
+
+			src->head = msg->next;
+			free(msg->ident);
+			free(msg->text);
+			free(msg);
+		}
+		if (!src->head)
+			src->tail = NULL;
+		src->count -= n_msgs[i];
+	}
+	pthread_mutex_unlock(&queue_lock);
+}
+
+/*
+ * get_queued_count() - Get the number of queued messages
+ *
+ * Return: The number of messages pending to upload.
+ */
+static unsigned int get_queued_count(void)
+{
+	unsigned int count = 0, i;
+
+	pthread_mutex_lock(&queue_lock);
+	for (i = 0; i < LOG_SRC_COUNT; i++)
+		count += sources[i].count + (sources[i].dropped > 0 ? 1 : 0);
+	pthread_mutex_unlock(&queue_lock);
+
+	return count;
+}
+
+/*
+ * free_queues() - Remove all the queued messages
+ */
+static void free_queues(void)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&queue_lock);
+	for (i = 0; i < LOG_SRC_COUNT; i++) {
+		log_source_t *src = &sources[i];
+
+		while (src->head) {
+			log_msg_t *msg = src->head;
+
+			src->head = msg->next;
+			free(msg->ident);
+			free(msg->text);
+			free(msg);
+		}
+		src->tail = NULL;
+		src->count = 0;
+		src->dropped = 0;
+	}
+	pthread_mutex_unlock(&queue_lock);
+}
+
+/*
+ * log_forward_loop() - Forward messages until the forwarder is stopped
+ *
+ * Reads the output of the source commands, and uploads the queued messages
+ * every 'interval' seconds, or as soon as there are 'upload_size' of them.
+ * Messages are kept while the system clock is not valid, so they are not
+ * uploaded with wrong timestamps.
+ */
+static void log_forward_loop(void)
+{
+	uint64_t next_upload_ms = get_monotonic_ms() + interval * 1000;
+
+	while (!stop_requested) {
+		struct pollfd pfds[LOG_SRC_COUNT];
+		log_source_t *polled[LOG_SRC_COUNT];
+		uint64_t now_ms = get_monotonic_ms();
+		int n_fds = 0, i;
+
+		for (i = 0; i < LOG_SRC_COUNT; i++) {
+			log_source_t *src = &sources[i];
+
+			if (!src->enabled || !src->argv)
+				continue;
+			if (src->fd < 0 && now_ms >= src->respawn_ms && spawn_source(src) != 0)
+				src->respawn_ms = now_ms + RESPAWN_INTERVAL_MS;
+			if (src->fd < 0)
+				continue;
+
+			pfds[n_fds].fd = src->fd;
+			pfds[n_fds].events = POLLIN;
+			pfds[n_fds].revents = 0;
+			polled[n_fds] = src;
+			n_fds++;
+		}
+
+		if (poll(pfds, n_fds, LOOP_MS) > 0) {
+			for (i = 0; i < n_fds; i++) {
+				if (pfds[i].revents)
+					read_source(polled[i]);
+			}
+		}
+
+		if (stop_requested)
+			break;
+
+		now_ms = get_monotonic_ms();
+		if (now_ms < next_upload_ms && get_queued_count() < upload_size)
+			continue;
+
+		if (!clock_is_valid()) {
+			log_lf_debug("%s", "Waiting for clock synchronization to upload messages");
+		} else {
+			upload_messages(false);
+		}
+
+		next_upload_ms = get_monotonic_ms() + interval * 1000;
+	}
+}
+
+/*
+ * log_forward_threaded() - Execute the log forwarder in a new thread
+ *
+ * @unused:	Unused parameter.
+ */
+static void *log_forward_threaded(void *unused)
+{
+	int i;
+
+	UNUSED_ARGUMENT(unused);
+
+	/* Wait until 'fwd_thread' is set to skip the own messages */
+	pthread_mutex_lock(&queue_lock);
+	pthread_mutex_unlock(&queue_lock);
+
+	log_forward_loop();
+
+	for (i = 0; i < LOG_SRC_COUNT; i++)
+		close_source(&sources[i]);
+
+	if (backlog_kb > 0 && backlog_path && strlen(backlog_path) > 0) {
+		unsigned int count = get_queued_count(), prev = 0;
+
+		while (count > 0 && count != prev) {
+			upload_messages(true);
+			prev = count;
+			count = get_queued_count();
+		}
+	}
+
+	pthread_exit(NULL);
+
+	return NULL;
+}
+
+/*
+ * compile_pattern() - Compile a filter pattern
+ *
+ * @pattern:	Regular expression, or NULL or empty for no pattern.
+ * @regex:	Compiled regular expression.
+ * @compiled:	True if there is a compiled expression.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int compile_pattern(const char *pattern, regex_t *regex, bool *compiled)
+{
+	int error;
+
+	*compiled = false;
+
+	if (!pattern || strlen(pattern) == 0)
+		return 0;
+
+	error = regcomp(regex, pattern, REG_EXTENDED | REG_NOSUB);
+	if (error != 0) {
+		char msgbuf[100];
+
+		regerror(error, regex, msgbuf, sizeof(msgbuf));
+		log_lf_error("Invalid pattern '%s': %s", pattern, msgbuf);
+
+		return -1;
+	}
+
+	*compiled = true;
+
+	return 0;
+}
+
+/*
+ * free_settings() - Release the copied forwarder settings
+ */
+static void free_settings(void)
+{
+	if (has_filter)
+		regfree(&filter_regex);
+	if (has_exclude)
+		regfree(&exclude_regex);
+	has_filter = false;
+	has_exclude = false;
+
+	free(backlog_path);
+	backlog_path = NULL;
+}
+
+cc_log_fwd_error_t start_log_forward(const cc_cfg_t *const cc_cfg)
+{
+	pthread_attr_t attr;
+	unsigned int i, j;
+	int error;
+
+	if (!(cc_cfg->services & LOG_FORWARD_SERVICE) || cc_cfg->n_log_fwd_sources == 0)
+		return CC_LOG_FWD_ERROR_NONE;
+
+	if (fwd_thread_valid)
+		return CC_LOG_FWD_ERROR_NONE;
+
+	if (compile_pattern(cc_cfg->log_fwd_filter, &filter_regex, &has_filter) != 0
+		|| compile_pattern(cc_cfg->log_fwd_exclude, &exclude_regex, &has_exclude) != 0) {
+		free_settings();
+		return CC_LOG_FWD_ERROR_FILTER;
+	}
+
+	if (cc_cfg->data_backlog_path) {
+		backlog_path = strdup(cc_cfg->data_backlog_path);
+		if (!backlog_path) {
+			log_lf_error("Unable to start log forwarder: %s", "Out of memory");
+			free_settings();
+			return CC_LOG_FWD_ERROR_NO_MEMORY;
+		}
+	}
+	backlog_kb = cc_cfg->data_backlog_kb;
+	rate = cc_cfg->log_fwd_rate;
+	interval = cc_cfg->log_fwd_interval;
+	upload_size = cc_cfg->log_fwd_upload_size;
+	max_priority = cc_cfg->log_fwd_level;
+	tokens = (uint64_t) rate * RATE_BURST * 1000;
+	last_refill_ms = get_monotonic_ms();
+
+	for (i = 0; i < LOG_SRC_COUNT; i++) {
+		log_source_t *src = &sources[i];
+
+		src->enabled = false;
+		src->pid = -1;
+		src->fd = -1;
+		src->respawn_ms = 0;
+		for (j = 0; j < cc_cfg->n_log_fwd_sources; j++) {
+			if (strcmp(cc_cfg->log_fwd_sources[j], src->name) == 0)
+				src->enabled = true;
+		}
+	}
+
+	error = pthread_attr_init(&attr);
+	if (error != 0) {
+		/* On Linux this function always succeeds. */
+		log_lf_error("pthread_attr_init() error %d", error);
+	}
+	stop_requested = false;
+	accepting = true;
+	pthread_mutex_lock(&queue_lock);
+	fwd_thread_valid = (pthread_create(&fwd_thread, &attr, log_forward_threaded, NULL) == 0);
+	pthread_mutex_unlock(&queue_lock);
+	pthread_attr_destroy(&attr);
+	if (!fwd_thread_valid) {
+		log_lf_error("Error while starting the log forwarder, %d", error);
+		accepting = false;
+		free_settings();
+		return CC_LOG_FWD_ERROR_THREAD;
+	}
+
+	log_lf_info("Forwarding log messages up to '%s' severity", priority_names[max_priority]);
+
+	return CC_LOG_FWD_ERROR_NONE;
+}
+
+bool is_log_forward_running(void)
+{
+	return fwd_thread_valid;
+}
+
+void stop_log_forward(void)
+{
+	if (!fwd_thread_valid)
+		return;
+
+	pthread_mutex_lock(&queue_lock);
+	accepting = false;
+	pthread_mutex_unlock(&queue_lock);
+
+	stop_requested = true;
+	pthread_join(fwd_thread, NULL);
+	fwd_thread_valid = false;
+
+	free_queues();
+	free_settings();
+
+	log_lf_info("%s", "Stop forwarding log messages");
+}
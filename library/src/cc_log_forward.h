@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_LOG_FORWARD_H_
+#define CC_LOG_FORWARD_H_
+
+#include <stdbool.h>
+
+#include "cc_config.h"
+
+#define LOG_FWD_SOURCE_CCCSD		"cccsd"
+#define LOG_FWD_SOURCE_SYSLOG		"syslog"
+#define LOG_FWD_SOURCE_JOURNAL		"journal"
+
+typedef enum {
+	CC_LOG_FWD_ERROR_NONE,
+	CC_LOG_FWD_ERROR_FILTER,
+	CC_LOG_FWD_ERROR_NO_MEMORY,
+	CC_LOG_FWD_ERROR_THREAD
+} cc_log_fwd_error_t;
+
+/*
+ * start_log_forward() - Start forwarding log messages to Remote Manager
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the
+ * 		settings parsed from the configuration file are stored.
+ *
+ * Messages are read from the sources in 'cc_cfg->log_fwd_sources', filtered
+ * by severity and patterns, rate limited, and uploaded in batches to the
+ * 'logs/<source>' data streams.
+ *
+ * The settings are copied, so the forwarder must be restarted to apply any
+ * change in the configuration.
+ *
+ * Return: Error code after starting the forwarder.
+ */
+cc_log_fwd_error_t start_log_forward(const cc_cfg_t * const cc_cfg);
+
+/*
+ * is_log_forward_running() - Check log forwarder status
+ *
+ * Return: True if the log forwarder is running, false if it is not.
+ */
+bool is_log_forward_running(void);
+
+/*
+ * stop_log_forward() - Stop forwarding log messages
+ *
+ * Pending messages are stored in the data backlog, if it is enabled, to
+ * upload them later.
+ */
+void stop_log_forward(void);
+
+#endif /* CC_LOG_FORWARD_H_ */
@@ -40,6 +40,20 @@ int init_logger(int level, int options, char *name);
  */
 void deinit_logger(void);
 
+#ifdef CCCS_LOG_FORWARD
+/**
+ * cc_syslog() - Log the given message and pass it to the log forwarder
+ *
+ * @priority:	Syslog priority of the message.
+ * @format:	Message to log.
+ * @args:	Additional arguments.
+ */
+void cc_syslog(int priority, const char *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+#else
+#define cc_syslog	syslog
+#endif /* CCCS_LOG_FORWARD */
+
 /**
  * set_log_level() - Set the new log level
  *
@@ -55,7 +69,7 @@ void deinit_logger(void);
  * @args:	Additional arguments.
  */
 #define log_error(format, ...)					\
-	syslog(LOG_ERR, "[ERROR] " format, __VA_ARGS__)
+	cc_syslog(LOG_ERR, "[ERROR] " format, __VA_ARGS__)
 
 /**
  * log_warning() - Log the given message as warning
@@ -64,7 +78,7 @@ void deinit_logger(void);
  * @args:	Additional arguments.
  */
 #define log_warning(format, ...)				\
-	syslog(LOG_WARNING, "[WARN] " format, __VA_ARGS__)
+	cc_syslog(LOG_WARNING, "[WARN] " format, __VA_ARGS__)
 
 
 /**
@@ -74,7 +88,7 @@ void deinit_logger(void);
  * @args:	Additional arguments.
  */
 #define log_info(format, ...)					\
-	syslog(LOG_INFO, "[INFO] " format, __VA_ARGS__)
+	cc_syslog(LOG_INFO, "[INFO] " format, __VA_ARGS__)
 
 /**
  * log_debug() - Log the given message as debug
@@ -83,6 +97,6 @@ void deinit_logger(void);
  * @args:	Additional arguments.
  */
 #define log_debug(format, ...)					\
-	syslog(LOG_DEBUG, "[DEBUG] " format, __VA_ARGS__)
+	cc_syslog(LOG_DEBUG, "[DEBUG] " format, __VA_ARGS__)
 
 #endif /* CC_LOGGING_H_ */
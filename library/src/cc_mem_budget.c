@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include "cc_logging.h"
+#include "cc_mem_budget.h"
+
+#define MEM_BUDGET_TAG			"MEMBUDGET:"
+
+/* Budget usage percentages to enter each degradation level */
+#define PRESSURE_SPILL_PERCENT		70
+#define PRESSURE_REJECT_PERCENT		85
+#define PRESSURE_SHRINK_PERCENT		95
+
+/**
+ * log_mb_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_mb_debug(format, ...)					\
+	log_debug("%s " format, MEM_BUDGET_TAG, __VA_ARGS__)
+
+/**
+ * log_mb_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_mb_info(format, ...)					\
+	log_info("%s " format, MEM_BUDGET_TAG, __VA_ARGS__)
+
+static const char *const ss_names[] = {
+	[MEM_SS_CONNECTOR] = "connector",
+	[MEM_SS_UPLOAD] = "upload",
+	[MEM_SS_DATA_REQUEST] = "data_request",
+	[MEM_SS_BUS] = "bus",
+};
+
+static pthread_mutex_t budget_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t usage[MEM_SS_COUNT];
+static size_t caps[MEM_SS_COUNT];
+static size_t total_usage = 0;
+static size_t budget = 0;
+static mem_pressure_t pressure = MEM_PRESSURE_NONE;
+
+/*
+ * get_pressure() - Calculate the degradation level for the given usage
+ *
+ * @used:	Number of bytes in use.
+ *
+ * Return: The memory pressure for that usage.
+ */
+static mem_pressure_t get_pressure(size_t used)
+{
+	unsigned long long percent;
+
+	if (budget == 0)
+		return MEM_PRESSURE_NONE;
+
+	percent = used * 100ULL / budget;
+	if (percent >= PRESSURE_SHRINK_PERCENT)
+		return MEM_PRESSURE_SHRINK;
+	if (percent >= PRESSURE_REJECT_PERCENT)
+		return MEM_PRESSURE_REJECT;
+	if (percent >= PRESSURE_SPILL_PERCENT)
+		return MEM_PRESSURE_SPILL;
+
+	return MEM_PRESSURE_NONE;
+}
+
+/*
+ * update_pressure() - Refresh the degradation level after a usage change
+ *
+ * Must be called with 'budget_lock' held.
+ */
+static void update_pressure(void)
+{
+	mem_pressure_t new_pressure = get_pressure(total_usage);
+
+	if (new_pressure == pressure)
+		return;
+
+	log_mb_info("Memory pressure level %d -> %d (%zu of %zu bytes)",
+		pressure, new_pressure, total_usage, budget);
+	pressure = new_pressure;
+}
+
+void mem_budget_init(const cc_cfg_t *const cc_cfg)
+{
+	pthread_mutex_lock(&budget_lock);
+
+	budget = cc_cfg->mem_budget_kb * (size_t) 1024;
+	caps[MEM_SS_CONNECTOR] = 0;
+	caps[MEM_SS_UPLOAD] = cc_cfg->mem_upload_kb * (size_t) 1024;
+	caps[MEM_SS_DATA_REQUEST] = cc_cfg->mem_data_request_kb * (size_t) 1024;
+	caps[MEM_SS_BUS] = 0;
+	update_pressure();
+
+	pthread_mutex_unlock(&budget_lock);
+
+	if (budget > 0)
+		log_mb_debug("Memory budget %u kB, upload cap %u kB, data request cap %u kB",
+			cc_cfg->mem_budget_kb, cc_cfg->mem_upload_kb,
+			cc_cfg->mem_data_request_kb);
+}
+
+int mem_budget_reserve(mem_subsystem_t ss, size_t size)
+{
+	size_t used;
+	int ret = 0;
+
+	if (ss <= MEM_SS_NONE || ss >= MEM_SS_COUNT)
+		return 0;
+
+	pthread_mutex_lock(&budget_lock);
+
+	if (caps[ss] > 0 && usage[ss] + size > caps[ss])
+		ret = -ENOBUFS;
+	else if (budget > 0 && total_usage + size > budget)
+		ret = -ENOBUFS;
+	else if (size >= MEM_LARGE_RESERVATION
+		&& get_pressure(total_usage + size) >= MEM_PRESSURE_REJECT)
+		ret = -ENOBUFS;
+
+	if (ret == 0) {
+		usage[ss] += size;
+		total_usage += size;
+		update_pressure();
+	}
+	used = total_usage;
+
+	pthread_mutex_unlock(&budget_lock);
+
+	if (ret)
+		log_mb_debug("Rejected %zu bytes for '%s' (%zu in use of %zu)",
+			size, ss_names[ss], used, budget);
+
+	return ret;
+}
+
+void mem_budget_charge(mem_subsystem_t ss, size_t size)
+{
+	if (ss <= MEM_SS_NONE || ss >= MEM_SS_COUNT || size == 0)
+		return;
+
+	pthread_mutex_lock(&budget_lock);
+
+	usage[ss] += size;
+	total_usage += size;
+	update_pressure();
+
+	pthread_mutex_unlock(&budget_lock);
+}
+
+void mem_budget_release(mem_subsystem_t ss, size_t size)
+{
+	if (ss <= MEM_SS_NONE || ss >= MEM_SS_COUNT || size == 0)
+		return;
+
+	pthread_mutex_lock(&budget_lock);
+
+	if (size > usage[ss])
+		size = usage[ss];
+	usage[ss] -= size;
+	total_usage -= size;
+	update_pressure();
+
+	pthread_mutex_unlock(&budget_lock);
+}
+
+size_t mem_budget_get_usage(mem_subsystem_t ss)
+{
+	size_t used;
+
+	pthread_mutex_lock(&budget_lock);
+	used = (ss > MEM_SS_NONE && ss < MEM_SS_COUNT) ? usage[ss] : total_usage;
+	pthread_mutex_unlock(&budget_lock);
+
+	return used;
+}
+
+const char *mem_budget_get_name(mem_subsystem_t ss)
+{
+	if (ss > MEM_SS_NONE && ss < MEM_SS_COUNT)
+		return ss_names[ss];
+
+	return "total";
+}
+
+mem_pressure_t mem_budget_get_pressure(void)
+{
+	mem_pressure_t level;
+
+	pthread_mutex_lock(&budget_lock);
+	level = pressure;
+	pthread_mutex_unlock(&budget_lock);
+
+	return level;
+}
+
+void mem_budget_shrink(void)
+{
+	if (malloc_trim(0))
+		log_mb_debug("%s", "Returned free heap memory to the system");
+}
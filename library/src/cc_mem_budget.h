@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef CC_MEM_BUDGET_H_
+#define CC_MEM_BUDGET_H_
+
+#include <stddef.h>
+
+#include "cc_config.h"
+
+/* Reservations from this size are considered large */
+#define MEM_LARGE_RESERVATION	(16 * 1024)
+
+/*
+ * mem_subsystem_t - Subsystems accounted in the memory budget
+ *
+ * @MEM_SS_NONE:		Not accounted.
+ * @MEM_SS_CONNECTOR:		Cloud Connector allocations, including the
+ *				data point collections.
+ * @MEM_SS_UPLOAD:		Data point files received from applications and
+ *				chunks of queued file uploads.
+ * @MEM_SS_DATA_REQUEST:	Data request responses from applications.
+ * @MEM_SS_BUS:			Queues of the local data point subscribers.
+ */
+typedef enum {
+	MEM_SS_NONE = -1,
+	MEM_SS_CONNECTOR,
+	MEM_SS_UPLOAD,
+	MEM_SS_DATA_REQUEST,
+	MEM_SS_BUS,
+	MEM_SS_COUNT,
+} mem_subsystem_t;
+
+/*
+ * mem_pressure_t - Degradation level depending on the budget usage
+ *
+ * @MEM_PRESSURE_NONE:		Under 70% of the budget.
+ * @MEM_PRESSURE_SPILL:		Collections must be moved to the data backlog.
+ * @MEM_PRESSURE_REJECT:	Large reservations are also rejected (85%).
+ * @MEM_PRESSURE_SHRINK:	Buffers must also be shrunk (95%).
+ */
+typedef enum {
+	MEM_PRESSURE_NONE,
+	MEM_PRESSURE_SPILL,
+	MEM_PRESSURE_REJECT,
+	MEM_PRESSURE_SHRINK,
+} mem_pressure_t;
+
+/*
+ * mem_budget_init() - Configure the memory budget
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) with the budget and
+ *		the subsystem caps.
+ *
+ * Usage is accounted even before the budget is configured.
+ */
+void mem_budget_init(const cc_cfg_t *const cc_cfg);
+
+/*
+ * mem_budget_reserve() - Reserve memory for a subsystem
+ *
+ * @ss:		Subsystem to account the memory to.
+ * @size:	Number of bytes to reserve.
+ *
+ * The reservation is rejected if it exceeds the subsystem cap or the global
+ * budget, or if it is large and the budget is under reject pressure.
+ *
+ * Return: 0 on success, -ENOBUFS if it is rejected.
+ */
+int mem_budget_reserve(mem_subsystem_t ss, size_t size);
+
+/*
+ * mem_budget_charge() - Account memory already allocated by a subsystem
+ *
+ * @ss:		Subsystem to account the memory to.
+ * @size:	Number of bytes allocated.
+ *
+ * Unlike mem_budget_reserve(), it never fails.
+ */
+void mem_budget_charge(mem_subsystem_t ss, size_t size);
+
+/*
+ * mem_budget_release() - Return memory of a subsystem to the budget
+ *
+ * @ss:		Subsystem the memory was accounted to.
+ * @size:	Number of bytes to release.
+ */
+void mem_budget_release(mem_subsystem_t ss, size_t size);
+
+/*
+ * mem_budget_get_usage() - Get the memory accounted to a subsystem
+ *
+ * @ss:		Subsystem to check, MEM_SS_NONE for the total.
+ *
+ * Return: Number of bytes in use.
+ */
+size_t mem_budget_get_usage(mem_subsystem_t ss);
+
+/*
+ * mem_budget_get_name() - Get the name of a subsystem
+ *
+ * @ss:		Subsystem to get its name, MEM_SS_NONE for the total.
+ *
+ * Return: The subsystem name.
+ */
+const char *mem_budget_get_name(mem_subsystem_t ss);
+
+/*
+ * mem_budget_get_pressure() - Get the current degradation level
+ *
+ * Return: The memory pressure, always MEM_PRESSURE_NONE without budget.
+ */
+mem_pressure_t mem_budget_get_pressure(void);
+
+/*
+ * mem_budget_shrink() - Return freed heap memory to the system
+ */
+void mem_budget_shrink(void);
+
+#endif /* CC_MEM_BUDGET_H_ */
@@ -21,21 +21,27 @@
 #include <libdigiapix/bluetooth.h>
 #endif /* ENABLE_BT */
 #include <libdigiapix/network.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <sys/sysinfo.h>
-#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "ccapi/ccapi.h"
 #include "_cc_datapoints.h"
+#include "cc_clock.h"
+#include "cc_compression.h"
 #include "cc_config.h"
 #include "cc_init.h"
 #include "cc_logging.h"
+#include "cc_mem_budget.h"
 #include "cc_system_monitor.h"
 #include "cc_utils.h"
 #include "service_common.h"
+#include "service_dp_bus.h"
 #include "utils.h"
 
 #define LOOP_MS				100
@@ -52,6 +58,14 @@
 #define MIN_STORE_UPLOAD_INTERVAL	60		/* 1 minute */
 #define MAX_STORE_UPLOAD_INTERVAL	1 * 60 * 60	/* 1 hour */
 
+/*
+ * PSI trigger: 200 ms of partial stall within a 2 seconds window (without
+ * CAP_SYS_RESOURCE the window must be a multiple of 2 seconds)
+ */
+#define PSI_TRIGGER			"some 200000 2000000"
+#define PSI_BURST_RATE_MS		1000		/* 1 second */
+#define PSI_BURST_MS			10 * 1000	/* 10 seconds */
+
 #define METRIC_FREE_MEMORY		"free_memory"
 #define METRIC_USED_MEMORY		"used_memory"
 #define METRIC_CPU_LOAD			"cpu_load"
@@ -61,6 +75,11 @@
 #define METRIC_STATE			"state"
 #define METRIC_RX_BYTES			"rx_bytes"
 #define METRIC_TX_BYTES			"tx_bytes"
+#define METRIC_CCCS_MEMORY		"cccs_memory"
+#define METRIC_CPU_PRESSURE		"cpu_pressure"
+#define METRIC_MEMORY_PRESSURE		"memory_pressure"
+#define METRIC_IO_PRESSURE		"io_pressure"
+#define METRIC_COMPRESSION		"compression"
 
 #define SYS_MON_DATA_STREAM_PREFIX	"system_monitor/"
 
@@ -70,6 +89,12 @@
 #define DATA_STREAM_CPU_TEMP		SYS_MON_DATA_STREAM_PREFIX METRIC_CPU_TEMP
 #define DATA_STREAM_FREQ		SYS_MON_DATA_STREAM_PREFIX METRIC_FREQ
 #define DATA_STREAM_UPTIME		SYS_MON_DATA_STREAM_PREFIX METRIC_UPTIME
+#define DATA_STREAM_CCCS_MEMORY		SYS_MON_DATA_STREAM_PREFIX METRIC_CCCS_MEMORY
+#define DATA_STREAM_CPU_PRESSURE	SYS_MON_DATA_STREAM_PREFIX METRIC_CPU_PRESSURE
+#define DATA_STREAM_MEMORY_PRESSURE	SYS_MON_DATA_STREAM_PREFIX METRIC_MEMORY_PRESSURE
+#define DATA_STREAM_IO_PRESSURE		SYS_MON_DATA_STREAM_PREFIX METRIC_IO_PRESSURE
+#define DATA_STREAM_PRESSURE_EVENT	SYS_MON_DATA_STREAM_PREFIX "pressure_event"
+#define DATA_STREAM_COMPRESSION		SYS_MON_DATA_STREAM_PREFIX METRIC_COMPRESSION
 
 #define DATA_STREAM_NET_STATE		SYS_MON_DATA_STREAM_PREFIX "%s/" METRIC_STATE
 #define DATA_STREAM_NET_TRAFFIC_RX	SYS_MON_DATA_STREAM_PREFIX "%s/" METRIC_RX_BYTES
@@ -82,10 +107,15 @@
 #define DATA_STREAM_UPTIME_UNITS	"s"
 #define DATA_STREAM_STATE_UNITS		"state"
 #define DATA_STREAM_BYTES_UNITS		"bytes"
+#define DATA_STREAM_PRESSURE_UNITS	"%"
+#define DATA_STREAM_CPU_TIME_UNITS	"ms"
 
 #define FILE_CPU_LOAD			"/proc/stat"
 #define FILE_CPU_TEMP			"/sys/class/thermal/thermal_zone0/temp"
 #define FILE_CPU_FREQ			"/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_cur_freq"
+#define FILE_PSI_CPU			"/proc/pressure/cpu"
+#define FILE_PSI_MEMORY			"/proc/pressure/memory"
+#define FILE_PSI_IO			"/proc/pressure/io"
 
 /**
  * log_sm_debug() - Log the given message as debug
@@ -121,6 +151,23 @@ typedef enum {
 	STREAM_CPU_TEMP,
 	STREAM_FREQ,
 	STREAM_UPTIME,
+	STREAM_MEM_CONNECTOR,
+	STREAM_MEM_UPLOAD,
+	STREAM_MEM_DATA_REQUEST,
+	STREAM_MEM_BUS,
+	STREAM_MEM_TOTAL,
+	STREAM_CPU_PRESSURE_SOME,
+	STREAM_CPU_PRESSURE_FULL,
+	STREAM_MEMORY_PRESSURE_SOME,
+	STREAM_MEMORY_PRESSURE_FULL,
+	STREAM_IO_PRESSURE_SOME,
+	STREAM_IO_PRESSURE_FULL,
+	STREAM_SAVED_SMALL,
+	STREAM_SAVED_COMPRESSIBLE,
+	STREAM_SAVED_INCOMPRESSIBLE,
+	STREAM_CPU_SMALL,
+	STREAM_CPU_COMPRESSIBLE,
+	STREAM_CPU_INCOMPRESSIBLE,
 	STREAM_STATE,
 	STREAM_RX_BYTES,
 	STREAM_TX_BYTES,
@@ -139,6 +186,25 @@ typedef struct {
 	int n_streams;
 } stream_list_t;
 
+/*
+ * struct psi_trigger_t - Pressure stall information trigger of a resource
+ *
+ * @resource:		Resource name.
+ * @file:		PSI file of the resource.
+ * @some_type:		Stream type of the 'some' average.
+ * @full_type:		Stream type of the 'full' average.
+ * @fd:			File descriptor of the registered trigger, -1 if none.
+ * @burst_until_ms:	Timestamp in ms when the high-rate sampling ends.
+ */
+typedef struct {
+	const char *resource;
+	const char *file;
+	stream_type_t some_type;
+	stream_type_t full_type;
+	int fd;
+	uint64_t burst_until_ms;
+} psi_trigger_t;
+
 static volatile bool stop_requested = false;
 static volatile bool dp_thread_valid = false;
 static pthread_t dp_thread;
@@ -149,6 +215,30 @@ static stream_list_t bt_stream_list;
 #endif /* ENABLE_BT */
 static stream_list_t net_stream_list;
 static stream_list_t sys_stream_list;
+static uint64_t burst_until_ms = 0;
+static psi_trigger_t psi_triggers[] = {
+	{
+		.resource = "cpu",
+		.file = FILE_PSI_CPU,
+		.some_type = STREAM_CPU_PRESSURE_SOME,
+		.full_type = STREAM_CPU_PRESSURE_FULL,
+		.fd = -1
+	},
+	{
+		.resource = "memory",
+		.file = FILE_PSI_MEMORY,
+		.some_type = STREAM_MEMORY_PRESSURE_SOME,
+		.full_type = STREAM_MEMORY_PRESSURE_FULL,
+		.fd = -1
+	},
+	{
+		.resource = "io",
+		.file = FILE_PSI_IO,
+		.some_type = STREAM_IO_PRESSURE_SOME,
+		.full_type = STREAM_IO_PRESSURE_FULL,
+		.fd = -1
+	},
+};
 static stream_t net_stream_formats[] = {
 	{
 		.name = METRIC_STATE,
@@ -214,6 +304,125 @@ static stream_t sys_streams_formats[] = {
 		.units = DATA_STREAM_UPTIME_UNITS,
 		.format = CCAPI_DP_KEY_DATA_INT32 " " CCAPI_DP_KEY_TS_EPOCH,
 		.type = STREAM_UPTIME
+	},
+	{
+		.name = METRIC_CCCS_MEMORY "/connector",
+		.path = DATA_STREAM_CCCS_MEMORY "/connector",
+		.units = DATA_STREAM_MEMORY_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEM_CONNECTOR
+	},
+	{
+		.name = METRIC_CCCS_MEMORY "/upload",
+		.path = DATA_STREAM_CCCS_MEMORY "/upload",
+		.units = DATA_STREAM_MEMORY_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEM_UPLOAD
+	},
+	{
+		.name = METRIC_CCCS_MEMORY "/data_request",
+		.path = DATA_STREAM_CCCS_MEMORY "/data_request",
+		.units = DATA_STREAM_MEMORY_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEM_DATA_REQUEST
+	},
+	{
+		.name = METRIC_CCCS_MEMORY "/bus",
+		.path = DATA_STREAM_CCCS_MEMORY "/bus",
+		.units = DATA_STREAM_MEMORY_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEM_BUS
+	},
+	{
+		.name = METRIC_CCCS_MEMORY "/total",
+		.path = DATA_STREAM_CCCS_MEMORY "/total",
+		.units = DATA_STREAM_MEMORY_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEM_TOTAL
+	},
+	{
+		.name = METRIC_CPU_PRESSURE "/some",
+		.path = DATA_STREAM_CPU_PRESSURE "/some",
+		.units = DATA_STREAM_PRESSURE_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_CPU_PRESSURE_SOME
+	},
+	{
+		.name = METRIC_CPU_PRESSURE "/full",
+		.path = DATA_STREAM_CPU_PRESSURE "/full",
+		.units = DATA_STREAM_PRESSURE_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_CPU_PRESSURE_FULL
+	},
+	{
+		.name = METRIC_MEMORY_PRESSURE "/some",
+		.path = DATA_STREAM_MEMORY_PRESSURE "/some",
+		.units = DATA_STREAM_PRESSURE_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEMORY_PRESSURE_SOME
+	},
+	{
+		.name = METRIC_MEMORY_PRESSURE "/full",
+		.path = DATA_STREAM_MEMORY_PRESSURE "/full",
+		.units = DATA_STREAM_PRESSURE_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_MEMORY_PRESSURE_FULL
+	},
+	{
+		.name = METRIC_IO_PRESSURE "/some",
+		.path = DATA_STREAM_IO_PRESSURE "/some",
+		.units = DATA_STREAM_PRESSURE_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_IO_PRESSURE_SOME
+	},
+	{
+		.name = METRIC_IO_PRESSURE "/full",
+		.path = DATA_STREAM_IO_PRESSURE "/full",
+		.units = DATA_STREAM_PRESSURE_UNITS,
+		.format = CCAPI_DP_KEY_DATA_DOUBLE " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_IO_PRESSURE_FULL
+	},
+	{
+		.name = METRIC_COMPRESSION "/small/saved",
+		.path = DATA_STREAM_COMPRESSION "/small/saved",
+		.units = DATA_STREAM_BYTES_UNITS,
+		.format = CCAPI_DP_KEY_DATA_INT64 " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_SAVED_SMALL
+	},
+	{
+		.name = METRIC_COMPRESSION "/compressible/saved",
+		.path = DATA_STREAM_COMPRESSION "/compressible/saved",
+		.units = DATA_STREAM_BYTES_UNITS,
+		.format = CCAPI_DP_KEY_DATA_INT64 " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_SAVED_COMPRESSIBLE
+	},
+	{
+		.name = METRIC_COMPRESSION "/incompressible/saved",
+		.path = DATA_STREAM_COMPRESSION "/incompressible/saved",
+		.units = DATA_STREAM_BYTES_UNITS,
+		.format = CCAPI_DP_KEY_DATA_INT64 " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_SAVED_INCOMPRESSIBLE
+	},
+	{
+		.name = METRIC_COMPRESSION "/small/cpu",
+		.path = DATA_STREAM_COMPRESSION "/small/cpu",
+		.units = DATA_STREAM_CPU_TIME_UNITS,
+		.format = CCAPI_DP_KEY_DATA_INT64 " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_CPU_SMALL
+	},
+	{
+		.name = METRIC_COMPRESSION "/compressible/cpu",
+		.path = DATA_STREAM_COMPRESSION "/compressible/cpu",
+		.units = DATA_STREAM_CPU_TIME_UNITS,
+		.format = CCAPI_DP_KEY_DATA_INT64 " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_CPU_COMPRESSIBLE
+	},
+	{
+		.name = METRIC_COMPRESSION "/incompressible/cpu",
+		.path = DATA_STREAM_COMPRESSION "/incompressible/cpu",
+		.units = DATA_STREAM_CPU_TIME_UNITS,
+		.format = CCAPI_DP_KEY_DATA_INT64 " " CCAPI_DP_KEY_TS_EPOCH,
+		.type = STREAM_CPU_INCOMPRESSIBLE
 	}
 };
 
@@ -413,6 +622,60 @@ static bool should_read_interface(char *iface_name, const cc_cfg_t *const cc_cfg
 	return false;
 }
 
+/*
+ * get_psi_trigger() - Get the PSI resource of a pressure stream
+ *
+ * @type:	Stream type.
+ *
+ * Return: The PSI resource, NULL if it is not a pressure stream.
+ */
+static psi_trigger_t *get_psi_trigger(stream_type_t type)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(psi_triggers); i++) {
+		if (psi_triggers[i].some_type == type || psi_triggers[i].full_type == type)
+			return &psi_triggers[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * get_pressure() - Get the 10 seconds stall average of a resource
+ *
+ * @trigger:	PSI resource to read.
+ * @full:	True for the time all tasks stalled, false for the time at
+ *		least one task stalled.
+ *
+ * Return: The percentage of time stalled, -1 if not supported.
+ */
+static double get_pressure(const psi_trigger_t *trigger, bool full)
+{
+	const char *kind = full ? "full" : "some";
+	char line[MAX_LENGTH];
+	double value = -1;
+	FILE *fp;
+
+	fp = fopen(trigger->file, "r");
+	if (!fp)
+		return -1;
+
+	while (fgets(line, sizeof(line), fp)) {
+		double avg10;
+
+		if (strncmp(line, kind, strlen(kind)) == 0
+			&& sscanf(line + strlen(kind), " avg10=%lf", &avg10) == 1) {
+			value = avg10;
+			break;
+		}
+	}
+
+	fclose(fp);
+
+	return value;
+}
+
 /*
  * init_sys_streams() - Add the system data point streams to collection
  *
@@ -426,6 +689,7 @@ static bool should_read_interface(char *iface_name, const cc_cfg_t *const cc_cfg
  */
 static ccapi_dp_error_t init_sys_streams(const cc_cfg_t *const cc_cfg)
 {
+	psi_trigger_t *trigger;
 	unsigned int i;
 	int n_metrics_to_monitor = 0;
 	ccapi_dp_error_t dp_error = CCAPI_DP_ERROR_NONE;
@@ -455,6 +719,13 @@ static ccapi_dp_error_t init_sys_streams(const cc_cfg_t *const cc_cfg)
 			continue;
 		}
 
+		/* Skip pressure metrics on kernels without PSI */
+		trigger = get_psi_trigger(stream_format.type);
+		if (trigger && get_pressure(trigger, stream_format.type == trigger->full_type) < 0) {
+			log_sm_debug("Skipping metric '%s': Not supported", stream_format.name);
+			continue;
+		}
+
 		sys_stream_list.n_streams++;
 
 		stream->name = strdup(stream_format.name);
@@ -639,6 +910,65 @@ static ccapi_dp_error_t init_bt_streams(const cc_cfg_t *const cc_cfg)
 }
 #endif /* ENABLE_BT */
 
+/*
+ * init_psi_triggers() - Register PSI triggers for the monitored resources
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t) where the parsed
+ * 		settings from the configuration file are stored.
+ *
+ * A trigger is registered for each resource with a pressure metric in the
+ * monitored streams. Kernels without PSI triggers only get periodic samples.
+ */
+static void init_psi_triggers(const cc_cfg_t *const cc_cfg)
+{
+	unsigned int i;
+	int j;
+
+	if (!(cc_cfg->services & SYS_MONITOR_SERVICE) || cc_cfg->sys_mon_sample_rate <= 0)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(psi_triggers); i++) {
+		psi_trigger_t *trigger = &psi_triggers[i];
+		bool monitored = false;
+
+		for (j = 0; j < sys_stream_list.n_streams && !monitored; j++)
+			monitored = get_psi_trigger(sys_stream_list.streams[j].type) == trigger;
+
+		if (!monitored || trigger->fd >= 0)
+			continue;
+
+		trigger->fd = open(trigger->file, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (trigger->fd < 0)
+			continue;
+
+		if (write(trigger->fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0) {
+			log_sm_info("Cannot register '%s' pressure trigger, using periodic samples: %s (%d)",
+				trigger->resource, strerror(errno), errno);
+			close(trigger->fd);
+			trigger->fd = -1;
+			continue;
+		}
+
+		log_sm_debug("Registered '%s' pressure trigger", trigger->resource);
+	}
+}
+
+/*
+ * close_psi_triggers() - Unregister the PSI triggers
+ */
+static void close_psi_triggers(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(psi_triggers); i++) {
+		if (psi_triggers[i].fd >= 0)
+			close(psi_triggers[i].fd);
+		psi_triggers[i].fd = -1;
+		psi_triggers[i].burst_until_ms = 0;
+	}
+	burst_until_ms = 0;
+}
+
 /*
  * init_system_monitor() - Create and initialize the system monitor data point
  *                         collection
@@ -682,6 +1012,8 @@ static ccapi_dp_error_t init_system_monitor(const cc_cfg_t *const cc_cfg)
 	}
 #endif /* ENABLE_BT */
 
+	init_psi_triggers(cc_cfg);
+
 	return dp_error;
 }
 
@@ -839,6 +1171,87 @@ static unsigned long get_uptime(void)
 	return info.uptime;
 }
 
+/*
+ * get_cccs_memory() - Get the memory accounted to a budget subsystem
+ *
+ * @type:	Stream type of the subsystem.
+ *
+ * Return: The memory in use in kB.
+ */
+static double get_cccs_memory(stream_type_t type)
+{
+	mem_subsystem_t ss;
+
+	switch (type) {
+		case STREAM_MEM_CONNECTOR:
+			ss = MEM_SS_CONNECTOR;
+			break;
+		case STREAM_MEM_UPLOAD:
+			ss = MEM_SS_UPLOAD;
+			break;
+		case STREAM_MEM_DATA_REQUEST:
+			ss = MEM_SS_DATA_REQUEST;
+			break;
+		case STREAM_MEM_BUS:
+			ss = MEM_SS_BUS;
+			break;
+		default:
+			ss = MEM_SS_NONE;
+			break;
+	}
+
+	return mem_budget_get_usage(ss) / 1024.0;
+}
+
+/*
+ * get_stream_pressure() - Get the stall average of a pressure stream
+ *
+ * @type:	Stream type.
+ *
+ * Return: The percentage of time stalled, -1 if error.
+ */
+static double get_stream_pressure(stream_type_t type)
+{
+	psi_trigger_t *trigger = get_psi_trigger(type);
+	double value;
+
+	if (!trigger)
+		return -1;
+
+	value = get_pressure(trigger, type == trigger->full_type);
+	if (value < 0)
+		log_sm_error("Error getting %s pressure", trigger->resource);
+
+	return value;
+}
+
+/*
+ * get_compression() - Get the compression statistics of a class of messages
+ *
+ * @type:	Stream type of the class and statistic.
+ *
+ * Return: The saved bytes or the CPU time in ms.
+ */
+static int64_t get_compression(stream_type_t type)
+{
+	switch (type) {
+		case STREAM_SAVED_SMALL:
+			return compression_get_saved(COMPRESSION_CLASS_SMALL);
+		case STREAM_SAVED_COMPRESSIBLE:
+			return compression_get_saved(COMPRESSION_CLASS_COMPRESSIBLE);
+		case STREAM_SAVED_INCOMPRESSIBLE:
+			return compression_get_saved(COMPRESSION_CLASS_INCOMPRESSIBLE);
+		case STREAM_CPU_SMALL:
+			return (int64_t) compression_get_cpu(COMPRESSION_CLASS_SMALL);
+		case STREAM_CPU_COMPRESSIBLE:
+			return (int64_t) compression_get_cpu(COMPRESSION_CLASS_COMPRESSIBLE);
+		case STREAM_CPU_INCOMPRESSIBLE:
+			return (int64_t) compression_get_cpu(COMPRESSION_CLASS_INCOMPRESSIBLE);
+		default:
+			return 0;
+	}
+}
+
 /*
  * add_sys_samples() - Add system metrics values to the data point collection
  *
@@ -847,8 +1260,9 @@ static unsigned long get_uptime(void)
 static void add_sys_samples(ccapi_timestamp_t timestamp)
 {
 	int i;
-	double free_mem, used_mem, load, temp;
+	double free_mem, used_mem, load, temp, cccs_mem, pressure;
 	unsigned long freq, uptime;
+	int64_t compression;
 	ccapi_dp_error_t dp_error;
 
 	for (i = 0; i < sys_stream_list.n_streams; i++) {
@@ -885,6 +1299,35 @@ static void add_sys_samples(ccapi_timestamp_t timestamp)
 				dp_error = ccapi_dp_add(dp_collection, stream.path, uptime, &timestamp);
 				log_sm_debug("%s = %lu %s", stream.name, uptime, stream.units);
 				break;
+			case STREAM_MEM_CONNECTOR:
+			case STREAM_MEM_UPLOAD:
+			case STREAM_MEM_DATA_REQUEST:
+			case STREAM_MEM_BUS:
+			case STREAM_MEM_TOTAL:
+				cccs_mem = get_cccs_memory(stream.type);
+				dp_error = ccapi_dp_add(dp_collection, stream.path, cccs_mem, &timestamp);
+				log_sm_debug("%s = %f %s", stream.name, cccs_mem, stream.units);
+				break;
+			case STREAM_CPU_PRESSURE_SOME:
+			case STREAM_CPU_PRESSURE_FULL:
+			case STREAM_MEMORY_PRESSURE_SOME:
+			case STREAM_MEMORY_PRESSURE_FULL:
+			case STREAM_IO_PRESSURE_SOME:
+			case STREAM_IO_PRESSURE_FULL:
+				pressure = get_stream_pressure(stream.type);
+				dp_error = ccapi_dp_add(dp_collection, stream.path, pressure, &timestamp);
+				log_sm_debug("%s = %f %s", stream.name, pressure, stream.units);
+				break;
+			case STREAM_SAVED_SMALL:
+			case STREAM_SAVED_COMPRESSIBLE:
+			case STREAM_SAVED_INCOMPRESSIBLE:
+			case STREAM_CPU_SMALL:
+			case STREAM_CPU_COMPRESSIBLE:
+			case STREAM_CPU_INCOMPRESSIBLE:
+				compression = get_compression(stream.type);
+				dp_error = ccapi_dp_add(dp_collection, stream.path, compression, &timestamp);
+				log_sm_debug("%s = %lld %s", stream.name, (long long) compression, stream.units);
+				break;
 			default:
 				/* Should not occur */
 				log_sm_error("Cannot add %s value, unknown stream (%d)", stream.name, stream.type);
@@ -1029,6 +1472,172 @@ static void add_samples(void)
 	free_timestamp(timestamp);
 }
 
+/*
+ * publish_samples() - Deliver the new samples to the local subscribers
+ *
+ * Samples are published as soon as they are taken, not when they are
+ * uploaded.
+ */
+static void publish_samples(void)
+{
+	buffer_info_t buf_info;
+
+	if (!dp_bus_has_subscribers())
+		return;
+
+	if (dp_generate_csv_from_latest(dp_collection, &buf_info) != (size_t) -1)
+		dp_bus_publish_csv(buf_info.buffer, buf_info.bytes_written);
+
+	free(buf_info.buffer);
+}
+
+/*
+ * get_monotonic_ms() - Get the milliseconds since an unspecified point
+ *
+ * Unlike the real time, it is not affected by system clock changes.
+ *
+ * Return: Number of milliseconds.
+ */
+static uint64_t get_monotonic_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * report_pressure_event() - Report a fired PSI trigger
+ *
+ * @trigger:	PSI resource whose trigger fired.
+ *
+ * Sends an event with the current stall averages and starts a burst of
+ * high-rate samples. Triggers fired during the burst only extend it.
+ */
+static void report_pressure_event(psi_trigger_t *trigger)
+{
+	uint64_t now_ms = get_monotonic_ms();
+	bool new_event = now_ms >= trigger->burst_until_ms;
+	double some, full;
+	char json[MAX_LENGTH];
+	int len;
+
+	trigger->burst_until_ms = now_ms + PSI_BURST_MS;
+	if (trigger->burst_until_ms > burst_until_ms)
+		burst_until_ms = trigger->burst_until_ms;
+
+	if (!new_event)
+		return;
+
+	some = get_pressure(trigger, false);
+	full = get_pressure(trigger, true);
+
+	log_sm_info("Detected %s pressure stall (some %.2f%%, full %.2f%%)",
+		trigger->resource, some, full);
+
+	if (get_cloud_connection_status() != CC_STATUS_CONNECTED)
+		return;
+
+	len = snprintf(json, sizeof(json), "{\"resource\":\"%s\",\"some\":%.2f",
+		trigger->resource, some);
+	if (full >= 0)
+		len += snprintf(json + len, sizeof(json) - len, ",\"full\":%.2f", full);
+	snprintf(json + len, sizeof(json) - len, "}");
+
+	dp_send_json_event(DATA_STREAM_PRESSURE_EVENT, json);
+}
+
+/*
+ * wait_psi_triggers() - Wait for PSI triggers to fire
+ *
+ * @timeout_ms:	Maximum time to wait in milliseconds.
+ *
+ * Without registered triggers it just sleeps.
+ *
+ * Return: True if any trigger fired, false otherwise.
+ */
+static bool wait_psi_triggers(int timeout_ms)
+{
+	struct pollfd fds[ARRAY_SIZE(psi_triggers)];
+	psi_trigger_t *polled[ARRAY_SIZE(psi_triggers)];
+	unsigned int i, n_fds = 0;
+	bool fired = false;
+
+	for (i = 0; i < ARRAY_SIZE(psi_triggers); i++) {
+		if (psi_triggers[i].fd < 0)
+			continue;
+
+		fds[n_fds].fd = psi_triggers[i].fd;
+		fds[n_fds].events = POLLPRI;
+		fds[n_fds].revents = 0;
+		polled[n_fds++] = &psi_triggers[i];
+	}
+
+	if (n_fds == 0) {
+		struct timespec sleepValue = {0};
+
+		sleepValue.tv_nsec = timeout_ms * 1000 * 1000;
+		nanosleep(&sleepValue, NULL);
+
+		return false;
+	}
+
+	if (poll(fds, n_fds, timeout_ms) <= 0)
+		return false;
+
+	for (i = 0; i < n_fds; i++) {
+		if (fds[i].revents & POLLERR) {
+			log_sm_error("'%s' pressure trigger is no longer available",
+				polled[i]->resource);
+			close(polled[i]->fd);
+			polled[i]->fd = -1;
+		} else if (fds[i].revents & POLLPRI) {
+			report_pressure_event(polled[i]);
+			fired = true;
+		}
+	}
+
+	return fired;
+}
+
+/*
+ * spill_system_monitor_samples() - Move system monitor samples to the backlog
+ *
+ * @cc_cfg:	Connector configuration struct (cc_cfg_t).
+ *
+ * Used under memory pressure to free the collection without losing samples.
+ * They are uploaded later with the rest of the data backlog.
+ */
+static void spill_system_monitor_samples(const cc_cfg_t *const cc_cfg)
+{
+	uint32_t count;
+
+	if (cc_cfg->data_backlog_kb == 0 || !cc_cfg->data_backlog_path || strlen(cc_cfg->data_backlog_path) == 0)
+		return;
+
+	ccapi_dp_get_collection_points_count(dp_collection, &count);
+	while (count > 0 && !stop_requested) {
+		unsigned int n_dp;
+		buffer_info_t buf_info;
+		int ret;
+
+		if (dp_generate_csv_from_collection(dp_collection, &buf_info, DP_MAX_NUMBER_PER_REQUEST, &n_dp) <= 0)
+			break;
+
+		ret = dp_store_data(upload_datapoint_file_metrics, buf_info.buffer,
+			buf_info.bytes_written, NULL, cc_cfg->data_backlog_path,
+			cc_cfg->data_backlog_kb);
+		free(buf_info.buffer);
+		if (ret != 0)
+			break;
+
+		log_sm_debug("Memory pressure, moved %u samples to the data backlog", n_dp);
+		dp_remove_from_collection(dp_collection, n_dp);
+		ccapi_dp_get_collection_points_count(dp_collection, &count);
+	}
+}
+
 /*
  * send_system_monitor_samples() - Uploads system monitor samples
  *
@@ -1037,9 +1646,9 @@ static void add_samples(void)
  */
 static void send_system_monitor_samples(const cc_cfg_t *const cc_cfg, uint64_t *next_sample_ms)
 {
-	struct timeval now;
 	uint64_t now_ms;
-	uint32_t count;
+	uint32_t count, max_dp;
+	mem_pressure_t pressure;
 	uint32_t n_samples_to_send = (sys_stream_list.n_streams + net_stream_list.n_streams) * cc_cfg->sys_mon_num_samples_upload;
 #ifdef ENABLE_BT
 	n_samples_to_send += bt_stream_list.n_streams * cc_cfg->sys_mon_num_samples_upload;
@@ -1051,8 +1660,7 @@ static void send_system_monitor_samples(const cc_cfg_t *const cc_cfg, uint64_t *
 		return;
 	}
 
-	gettimeofday(&now, NULL);
-	now_ms = now.tv_sec * 1000 + now.tv_usec / 1000;
+	now_ms = get_monotonic_ms();
 	if (!*next_sample_ms)
 		*next_sample_ms = now_ms;
 
@@ -1063,17 +1671,23 @@ static void send_system_monitor_samples(const cc_cfg_t *const cc_cfg, uint64_t *
 		n_samples_to_send = DP_MAX_NUMBER_PER_REQUEST;
 
 	add_samples();
+	publish_samples();
 
-	gettimeofday(&now, NULL);
-	now_ms = now.tv_sec * 1000 + now.tv_usec / 1000;
-	*next_sample_ms = now_ms + cc_cfg->sys_mon_sample_rate * 1000;
+	now_ms = get_monotonic_ms();
+	if (now_ms < burst_until_ms)
+		*next_sample_ms = now_ms + PSI_BURST_RATE_MS;
+	else
+		*next_sample_ms = now_ms + cc_cfg->sys_mon_sample_rate * 1000;
 
 	ccapi_dp_get_collection_points_count(dp_collection, &count);
 
 	if (stop_requested)
 		return;
 
-	if (count >= n_samples_to_send) {
+	/* Keep samples until the clock is set, so their timestamps are corrected */
+	if (count >= n_samples_to_send && !clock_is_valid()) {
+		log_sm_debug("%s", "Waiting for clock synchronization to send samples");
+	} else if (count >= n_samples_to_send) {
 		unsigned int n_dp;
 		buffer_info_t buf_info;
 
@@ -1102,13 +1716,23 @@ static void send_system_monitor_samples(const cc_cfg_t *const cc_cfg, uint64_t *
 		}
 	}
 
+	pressure = mem_budget_get_pressure();
+	if (pressure >= MEM_PRESSURE_SPILL)
+		spill_system_monitor_samples(cc_cfg);
+
+	/* Under high memory pressure keep at most one request of samples */
+	max_dp = pressure >= MEM_PRESSURE_SHRINK ? DP_MAX_NUMBER_PER_REQUEST : SM_MAX_DP_IN_COLLECTION;
+
 	ccapi_dp_get_collection_points_count(dp_collection, &count);
 	/* If cannot send data points nor store them, limit the size of collection */
-	while (count > SM_MAX_DP_IN_COLLECTION) {
+	while (count > max_dp) {
 		log_sm_debug("%s", "Removing old system monitor samples...");
 		ccapi_dp_remove_older_data_point_from_streams(dp_collection);
 		ccapi_dp_get_collection_points_count(dp_collection, &count);
 	}
+
+	if (pressure >= MEM_PRESSURE_SHRINK)
+		mem_budget_shrink();
 }
 
 /*
@@ -1120,7 +1744,6 @@ static void send_system_monitor_samples(const cc_cfg_t *const cc_cfg, uint64_t *
  */
 static void send_stored_dp(const cc_cfg_t *const cc_cfg, uint32_t *store_upload_rate, uint64_t *next_store_upload_ms)
 {
-	struct timeval now;
 	uint64_t now_ms;
 	int rnd_inc;
 
@@ -1130,10 +1753,9 @@ static void send_stored_dp(const cc_cfg_t *const cc_cfg, uint32_t *store_upload_
 		return;
 	}
 
-	gettimeofday(&now, NULL);
-	now_ms = now.tv_sec * 1000 + now.tv_usec / 1000;
+	now_ms = get_monotonic_ms();
 
-	if (stop_requested || now_ms < *next_store_upload_ms)
+	if (stop_requested || now_ms < *next_store_upload_ms || !clock_is_valid())
 		return;
 
 	/* When starting, do not immediately upload stored data, wait one 'rate' */
@@ -1157,8 +1779,7 @@ done:
 
 	log_sm_debug("Checking for stored data in %u seconds", *store_upload_rate);
 
-	gettimeofday(&now, NULL);
-	now_ms = now.tv_sec * 1000 + now.tv_usec / 1000;
+	now_ms = get_monotonic_ms();
 	*next_store_upload_ms = now_ms + *store_upload_rate * 1000;
 }
 
@@ -1188,7 +1809,6 @@ static void system_monitor_loop(const cc_cfg_t *const cc_cfg)
 
 	while (!stop_requested) {
 		long n_loops, loop;
-		struct timeval now;
 		uint64_t now_ms, next_operation_ms;
 
 		send_system_monitor_samples(cc_cfg, &next_sample_ms);
@@ -1211,19 +1831,20 @@ static void system_monitor_loop(const cc_cfg_t *const cc_cfg)
 		else
 			next_operation_ms = next_sample_ms;
 
-		gettimeofday(&now, NULL);
-		now_ms = now.tv_sec * 1000 + now.tv_usec / 1000;
+		now_ms = get_monotonic_ms();
 		n_loops = 1; /* At least wait one loop */
 		if (next_operation_ms > now_ms)
 			n_loops += (next_operation_ms - now_ms) / LOOP_MS;
 		for (loop = 0; loop < n_loops; loop++) {
-			struct timespec sleepValue = {0};
-
 			if (stop_requested)
 				break;
 
-			sleepValue.tv_nsec = LOOP_MS * 1000 * 1000;
-			nanosleep(&sleepValue, NULL);
+			/* Take samples as soon as a stall is detected */
+			if (wait_psi_triggers(LOOP_MS)) {
+				if (next_sample_ms != 0)
+					next_sample_ms = get_monotonic_ms();
+				break;
+			}
 		}
 	}
 }
@@ -1299,5 +1920,7 @@ void stop_system_monitor(void)
 		pthread_join(dp_thread, NULL);
 	}
 
+	close_psi_triggers();
+
 	log_sm_info("%s", "Stop monitoring the system");
 }
@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include "ccapi/ccapi.h"
+#include "cc_clock.h"
 #include "cc_utils.h"
 
 ccapi_timestamp_t *get_timestamp(void)
@@ -33,20 +34,18 @@ ccapi_timestamp_t *get_timestamp(void)
 	return get_timestamp_by_type(CCCS_TS_DEFAULT);
 }
 
-ccapi_timestamp_t *get_timestamp_by_type(cccs_timestamp_type_t type)
+int fill_timestamp_by_type(ccapi_timestamp_t *timestamp, cccs_timestamp_type_t type)
 {
-	ccapi_timestamp_t *timestamp = NULL;
 	struct timeval now;
 
-	if (type >= CCCS_TS_INVALID || type < CCCS_TS_DEFAULT)
-		return NULL;
+	if (!timestamp || type >= CCCS_TS_INVALID || type < CCCS_TS_DEFAULT)
+		return -1;
 
-	timestamp = calloc(1, sizeof(*timestamp));
-	if (timestamp == NULL)
-		return NULL;
+	/* Refresh the clock status to be able to correct the timestamp later */
+	clock_is_valid();
 
 	if (gettimeofday(&now, NULL) != 0)
-		goto error;
+		return -1;
 
 	switch (type) {
 		case CCCS_TS_EPOCH_MS:
@@ -58,7 +57,7 @@ ccapi_timestamp_t *get_timestamp_by_type(cccs_timestamp_type_t type)
 				char *date = calloc(len, sizeof(*date));
 
 				if (date == NULL)
-					goto error;
+					return -1;
 
 				if (strftime(date, len, "%FT%H:%M:%S", gmtime(&now.tv_sec)) > 0) {
 					sprintf(date + strlen(date), ".%03ldZ", now.tv_usec/10000);
@@ -67,7 +66,7 @@ ccapi_timestamp_t *get_timestamp_by_type(cccs_timestamp_type_t type)
 				}
 
 				free(date);
-				goto error;
+				return -1;
 			}
 		case CCCS_TS_DEFAULT:
 		case CCCS_TS_EPOCH:
@@ -79,11 +78,27 @@ ccapi_timestamp_t *get_timestamp_by_type(cccs_timestamp_type_t type)
 			break;
 	}
 
-	return timestamp;
-error:
-	free_timestamp_by_type(timestamp, type);
+	return 0;
+}
+
+ccapi_timestamp_t *get_timestamp_by_type(cccs_timestamp_type_t type)
+{
+	ccapi_timestamp_t *timestamp = NULL;
 
-	return NULL;
+	if (type >= CCCS_TS_INVALID || type < CCCS_TS_DEFAULT)
+		return NULL;
+
+	timestamp = calloc(1, sizeof(*timestamp));
+	if (timestamp == NULL)
+		return NULL;
+
+	if (fill_timestamp_by_type(timestamp, type) != 0) {
+		free(timestamp);
+
+		return NULL;
+	}
+
+	return timestamp;
 }
 
 void free_timestamp(ccapi_timestamp_t *timestamp)
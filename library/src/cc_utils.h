@@ -47,6 +47,19 @@ ccapi_timestamp_t *get_timestamp(void);
  */
 ccapi_timestamp_t *get_timestamp_by_type(cccs_timestamp_type_t type);
 
+/*
+ * fill_timestamp_by_type() - Fill the provided structure with the current timestamp
+ *
+ * @timestamp:	The timestamp structure to fill.
+ * @type:	Timestamp type, 'CCCS_TS_DEFAULT' to use default timestamp type, 'CCCS_TS_EPOCH'.
+ *
+ * Same as 'get_timestamp_by_type()' without allocating the structure. For
+ * 'CCCS_TS_ISO8601' the string is allocated and must be freed.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+int fill_timestamp_by_type(ccapi_timestamp_t *timestamp, cccs_timestamp_type_t type);
+
 /*
  * free_timestamp() - Free given timestamp structure
  *
@@ -37,6 +37,10 @@
 #define MIN_VALUE(a, b)		((a) < (b) ? (a) : (b))
 #define APP_HASH_BUFFER_SIZE	1024
 
+/* Offsets and sizes must fit both in 'off_t' and in 'ccimp_file_offset_t' */
+#define FITS_OFF_T(value)	((ccimp_file_offset_t) (off_t) (value) == (value))
+#define FITS_FILE_OFFSET(value)	((off_t) (ccimp_file_offset_t) (value) == (value))
+
 #define ERROR_SESSION		"Session error %d"
 
 /**
@@ -237,8 +241,18 @@ ccimp_status_t ccimp_fs_file_seek(ccimp_fs_file_seek_t *const file_seek_data)
 			origin = SEEK_CUR;
 			break;
 	}
+	if (!FITS_OFF_T(file_seek_data->requested_offset)) {
+		file_seek_data->resulting_offset = -1;
+		file_seek_data->errnum = EOVERFLOW;
+		return CCIMP_STATUS_ERROR;
+	}
+
 	offset = lseek(file_seek_data->handle,
-			file_seek_data->requested_offset, origin);
+			(off_t) file_seek_data->requested_offset, origin);
+	if (offset >= 0 && !FITS_FILE_OFFSET(offset)) {
+		offset = -1;
+		errno = EOVERFLOW;
+	}
 	file_seek_data->resulting_offset = (ccimp_file_offset_t) offset;
 	if (offset < 0) {
 		file_seek_data->errnum = errno;
@@ -261,9 +275,15 @@ ccimp_status_t ccimp_fs_file_truncate(ccimp_fs_file_truncate_t \
 		*const file_truncate_data)
 {
 	ccimp_status_t status = CCIMP_STATUS_OK;
-	int result = ftruncate(file_truncate_data->handle,
-			file_truncate_data->length_in_bytes);
+	int result;
 
+	if (!FITS_OFF_T(file_truncate_data->length_in_bytes)) {
+		file_truncate_data->errnum = EOVERFLOW;
+		return CCIMP_STATUS_ERROR;
+	}
+
+	result = ftruncate(file_truncate_data->handle,
+			(off_t) file_truncate_data->length_in_bytes);
 	if (result < 0) {
 		file_truncate_data->errnum = errno;
 		status = CCIMP_STATUS_ERROR;
@@ -425,6 +445,12 @@ ccimp_status_t ccimp_fs_dir_entry_status(ccimp_fs_dir_entry_status_t \
 	if (S_ISDIR(statbuf.st_mode)) {
 		dir_entry_status_data->status.type = CCIMP_FS_DIR_ENTRY_DIR;
 	} else if (S_ISREG(statbuf.st_mode)) {
+		if (!FITS_FILE_OFFSET(statbuf.st_size)) {
+			dir_entry_status_data->status.type = CCIMP_FS_DIR_ENTRY_UNKNOWN;
+			dir_entry_status_data->status.file_size = 0;
+			dir_entry_status_data->errnum = EOVERFLOW;
+			return CCIMP_STATUS_ERROR;
+		}
 		dir_entry_status_data->status.type = CCIMP_FS_DIR_ENTRY_FILE;
 		dir_entry_status_data->status.file_size = \
 				(ccimp_file_offset_t)statbuf.st_size;
@@ -680,6 +706,7 @@ ccimp_status_t ccimp_fs_error_desc(ccimp_fs_error_desc_t \
 			error_desc_data->error_status = CCIMP_FS_ERROR_PATH_NOT_FOUND;
 			break;
 		case EINVAL:
+		case EOVERFLOW:
 		case ENOSYS:
 		case ENOTDIR:
 		case EISDIR:
@@ -35,6 +35,12 @@
 
 #define CCAPI_DEBUG_PREFIX		"[DEBUG] CCAPI: "
 
+/* Whether connector debug messages are logged, see ccimp_logging_set_debug() */
+static bool debug_enabled = false;
+
+/* Whether the message being printed by this thread was accepted at its start */
+static __thread bool tracing = false;
+
 static struct {
 	pthread_mutex_t mutex;
 	bool init;
@@ -132,7 +138,7 @@ static void buffer_flush(void)
 	char *line;
 
 	for (char *s = buffer.data; (line = strtok_r(s, "\n", &state)); s = NULL)
-		syslog(LOG_DEBUG, "%s", line);
+		cc_syslog(LOG_DEBUG, "%s", line);
 
 	buffer.offset = 0;
 	buffer.remaining = buffer.length;
@@ -205,14 +211,19 @@ done:
 
 void ccimp_hal_logging_vprintf(debug_t const debug, char const * const format, va_list args)
 {
-	if (!buffer.init)
-		return;
-
 	switch (debug) {
 		case debug_beg:
 		case debug_all:
 		{
+			/* Decide once per message, so it is never split on a change */
+			tracing = __atomic_load_n(&debug_enabled, __ATOMIC_RELAXED);
+			if (!tracing || !buffer.init) {
+				tracing = false;
+				return;
+			}
+
 			if (!lock()) {
+				tracing = false;
 				syslog(LOG_DEBUG, format, args);
 				return;
 			}
@@ -223,6 +234,8 @@ void ccimp_hal_logging_vprintf(debug_t const debug, char const * const format, v
 
 		case debug_mid:
 		case debug_end:
+			if (!tracing)
+				return;
 			break;
 	}
 
@@ -234,6 +247,7 @@ void ccimp_hal_logging_vprintf(debug_t const debug, char const * const format, v
 		{
 			buffer_flush();
 			unlock();
+			tracing = false;
 			break;
 		}
 
@@ -245,8 +259,18 @@ void ccimp_hal_logging_vprintf(debug_t const debug, char const * const format, v
 	return;
 }
 
+void ccimp_logging_set_debug(bool const enable)
+{
+	/* Messages not passing the log mask are discarded after formatting them */
+	bool const logged = (setlogmask(0) & LOG_MASK(LOG_DEBUG)) != 0;
+
+	__atomic_store_n(&debug_enabled, enable && logged, __ATOMIC_RELAXED);
+}
+
 void ccimp_logging_deinit(void)
 {
+	__atomic_store_n(&debug_enabled, false, __ATOMIC_RELAXED);
+
 	if (!buffer.init)
 		return;
 
@@ -265,6 +289,11 @@ int ccimp_logging_init(void)
 	return 0;
 }
 
+void ccimp_logging_set_debug(bool const enable)
+{
+	UNUSED_ARGUMENT(enable);
+}
+
 void ccimp_logging_deinit(void)
 {
 	return;
@@ -27,15 +27,20 @@
 #include <stdio.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 #ifdef APP_SSL
 #include <openssl/err.h>
+#include <openssl/pem.h>
 #include <openssl/ssl.h>
 #endif /* APP_SSL */
 
 #include "ccimp/ccimp_os.h"
+#include "cc_compression.h"
 #include "cc_config.h"
+#include "cc_cred_store.h"
 #include "cc_logging.h"
+#include "connector_event.h"
 #include "dns_helper.h"
 
 #ifdef UNIT_TEST
@@ -52,16 +57,43 @@
 #define APP_CONNECT_TIMEOUT		25
 #define APP_DISCONNECT_TIMEOUT		10
 
+/* Receive buffer sizing: minimum sample and growth threshold */
+#define APP_RCVBUF_SAMPLE_MS		200
+#define APP_RCVBUF_SAMPLE_RTTS		4
+#define APP_RCVBUF_GROWTH_PERCENT	125
+
 typedef struct {
 	int sock;
 #ifdef APP_SSL
 	SSL_CTX *ctx;
 	SSL *ssl;
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+	bool cred_unconfirmed;
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 #endif /* APP_SSL */
 	ccimp_os_system_up_time_t disconnect_start_time;
 	ccimp_os_system_up_time_t connect_start_time;
+	bool watch_writable;
+	uint32_t rcvbuf_max;
+	uint64_t rx_start_ms;
+	size_t rx_bytes;
 } network_handle_t;
 
+/*
+ * watch_socket() - Wake the idle connector when the socket is ready
+ *
+ * @handle:	Network handle.
+ * @writable:	true to also wake it when the socket is writable.
+ */
+static void watch_socket(network_handle_t *const handle, bool const writable)
+{
+	if (handle->watch_writable == writable)
+		return;
+
+	if (connector_event_watch(handle->sock, writable) == 0)
+		handle->watch_writable = writable;
+}
+
 static void free_network_handle(network_handle_t *const handle)
 {
 #ifdef APP_SSL
@@ -77,6 +109,121 @@ static void free_network_handle(network_handle_t *const handle)
 	free(handle);
 }
 
+static uint64_t get_time_ms(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+
+	return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+/*
+ * app_tcp_set_buffers() - Set the socket buffers size from the configuration
+ *
+ * @handle:	Network handle with the socket to configure.
+ *
+ * With a fixed size both buffers use it. Otherwise the receive buffer is not
+ * set, so the kernel tunes it to the connection, the advertised window is
+ * limited to the configured maximum and app_tcp_adapt_buffers() grows the
+ * buffer if the kernel keeps it below the bandwidth-delay product.
+ */
+static void app_tcp_set_buffers(network_handle_t *const handle)
+{
+	uint32_t max_size;
+	int size = (int) get_socket_buffer_size(&max_size);
+
+	handle->rcvbuf_max = 0;
+	handle->rx_start_ms = 0;
+	handle->rx_bytes = 0;
+
+	if (size > 0) {
+		if (setsockopt(handle->sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0)
+			log_error("Failed to set socket option SO_SNDBUF: %s (%d)", strerror(errno), errno);
+		if (setsockopt(handle->sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+			log_error("Failed to set socket option SO_RCVBUF: %s (%d)", strerror(errno), errno);
+	} else if (max_size > 0) {
+		size = (int) max_size;
+		if (setsockopt(handle->sock, IPPROTO_TCP, TCP_WINDOW_CLAMP, &size, sizeof(size)) < 0)
+			log_error("Failed to set socket option TCP_WINDOW_CLAMP: %s (%d)", strerror(errno), errno);
+		handle->rcvbuf_max = max_size;
+	}
+}
+
+/*
+ * app_tcp_adapt_buffers() - Grow the receive buffer to the bandwidth-delay product
+ *
+ * @handle:	Network handle.
+ * @bytes:	Number of bytes just received.
+ *
+ * The throughput is measured over samples of several round trips, and the
+ * target size is twice the bandwidth-delay product so the sender is not
+ * limited by the advertised window while the data is processed.
+ * The buffer is only set when the one tuned by the kernel is smaller than
+ * the target, for example when 'tcp_rmem' limits it, because setting it
+ * stops the kernel tuning. It only grows, up to the configured limit.
+ */
+static void app_tcp_adapt_buffers(network_handle_t *const handle, size_t const bytes)
+{
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	uint64_t now, elapsed, rate, rtt_ms, target;
+	int size, current;
+
+	if (handle->rcvbuf_max == 0)
+		return;
+
+	now = get_time_ms();
+	if (handle->rx_start_ms == 0) {
+		handle->rx_start_ms = now;
+		handle->rx_bytes = 0;
+		return;
+	}
+	handle->rx_bytes += bytes;
+
+	if (getsockopt(handle->sock, IPPROTO_TCP, TCP_INFO, &info, &len) != 0)
+		return;
+
+	rtt_ms = info.tcpi_rtt / 1000;
+	if (rtt_ms == 0)
+		rtt_ms = 1;
+
+	elapsed = now - handle->rx_start_ms;
+	if (elapsed < APP_RCVBUF_SAMPLE_MS || elapsed < APP_RCVBUF_SAMPLE_RTTS * rtt_ms)
+		return;
+
+	rate = (uint64_t) handle->rx_bytes * 1000 / elapsed;
+	target = 2 * rate * rtt_ms / 1000;
+	if (target > handle->rcvbuf_max)
+		target = handle->rcvbuf_max;
+
+	handle->rx_start_ms = now;
+	handle->rx_bytes = 0;
+
+	/* The kernel reports twice the usable size to account for its overhead */
+	len = sizeof(current);
+	if (getsockopt(handle->sock, SOL_SOCKET, SO_RCVBUF, &current, &len) != 0)
+		return;
+	current /= 2;
+
+	if (target * 100 < (uint64_t) current * APP_RCVBUF_GROWTH_PERCENT)
+		return;
+
+	size = (int) target;
+	if (setsockopt(handle->sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+		log_debug("Failed to set socket option SO_RCVBUF: %s (%d)", strerror(errno), errno);
+		return;
+	}
+
+	log_debug("Receive buffer set to %d KB (RTT %lu ms, %lu KB/s)", size / 1024,
+		(unsigned long) rtt_ms, (unsigned long) (rate / 1024));
+
+	/* Nothing else to do once the limit is reached */
+	if (target >= handle->rcvbuf_max)
+		handle->rcvbuf_max = 0;
+}
+
 static int app_tcp_create_socket(void)
 {
 	int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
@@ -239,10 +386,103 @@ done:
 	return ret;
 }
 
-static int app_ssl_connect(network_handle_t *const handle)
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+/*
+ * app_use_client_certificate() - Load the client certificate and its key
+ *
+ * @ctx:	SSL context to configure.
+ * @cert_path:	Path of the client certificate, it may be encrypted.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int app_use_client_certificate(SSL_CTX *const ctx, const char *const cert_path)
 {
+	char *pem = NULL;
+	size_t pem_len = 0;
+	BIO *bio = NULL;
+	X509 *cert = NULL;
+	EVP_PKEY *key = NULL;
 	int ret = -1;
 
+	if (cred_store_load(cert_path, get_client_cert_key_file(), &pem, &pem_len) != 0)
+		return -1;
+
+	bio = BIO_new_mem_buf(pem, (int) pem_len);
+	if (bio == NULL)
+		goto done;
+
+	cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+	if (cert == NULL || SSL_CTX_use_certificate(ctx, cert) != 1) {
+		log_error("Error setting up SSL connection: Failed to load '%s' cert", cert_path);
+		goto done;
+	}
+
+	if (BIO_reset(bio) != 1)
+		goto done;
+
+	key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+	if (key == NULL || SSL_CTX_use_PrivateKey(ctx, key) != 1) {
+		log_error("Error setting up SSL connection: Failed to load '%s' private key", cert_path);
+		goto done;
+	}
+
+	ret = 0;
+
+done:
+	EVP_PKEY_free(key);
+	X509_free(cert);
+	BIO_free(bio);
+	OPENSSL_cleanse(pem, pem_len);
+	free(pem);
+
+	return ret;
+}
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
+
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+/*
+ * is_credential_failure() - Check if an error may be a rejected client certificate
+ *
+ * @ssl_error:	SSL error of the failed operation.
+ *
+ * With TLS 1.3 the server verifies the client certificate after the client
+ * has finished the handshake, so a rejection arrives as an alert in the first
+ * operations on the connection. Network errors, like resets in a flaky link,
+ * do not count.
+ *
+ * Return: true if it must count against a new certificate, false otherwise.
+ */
+static bool is_credential_failure(int const ssl_error)
+{
+	unsigned long const error = ERR_peek_error();
+
+	/* Reasons of alerts received from the peer are offset by SSL_AD_REASON_OFFSET */
+	return ssl_error == SSL_ERROR_SSL
+		&& ERR_GET_LIB(error) == ERR_LIB_SSL
+		&& ERR_GET_REASON(error) >= SSL_AD_REASON_OFFSET;
+}
+
+/*
+ * credential_failed() - Count a failure against a new client certificate
+ *
+ * @handle:	Network handle.
+ *
+ * It is only counted once per connection.
+ */
+static void credential_failed(network_handle_t *const handle)
+{
+	if (!handle->cred_unconfirmed)
+		return;
+
+	handle->cred_unconfirmed = false;
+	cred_store_handshake_done(get_client_cert_path(), false);
+}
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
+
+static int app_ssl_connect(network_handle_t *const handle)
+{
+	int ret = -1, ssl_ret;
+
 	SSL_library_init();
 	OpenSSL_add_all_algorithms();
 	SSL_load_error_strings();
@@ -284,13 +524,13 @@ static int app_ssl_connect(network_handle_t *const handle)
 #ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
 	char *cert_path = get_client_cert_path();
 
-	/* Check if the certificate file exists */
-	if (cert_path && access(cert_path, F_OK) == 0 ) {
+	/* Load the certificate, restoring the previous one if it is missing */
+	if (cert_path && app_use_client_certificate(handle->ctx, cert_path) == 0) {
 		log_debug("Using cert file '%s' for SSL connection", cert_path);
+		/* Confirmed once connected to Remote Manager, see cc_init.c */
+		handle->cred_unconfirmed = cred_store_pending(cert_path);
 		/* Set the client verification mode, but use the builtin function */
 		SSL_CTX_set_verify(handle->ctx, SSL_VERIFY_PEER, NULL);
-		SSL_CTX_use_certificate_file(handle->ctx, cert_path, SSL_FILETYPE_PEM);
-		SSL_CTX_use_PrivateKey_file(handle->ctx, cert_path, SSL_FILETYPE_PEM);
 #if OPENSSL_VERSION_NUMBER >= 0x1010100fL
 		/*
 		 * For OpenSSL >=1.1.1, turn on client cert support which is
@@ -317,8 +557,16 @@ static int app_ssl_connect(network_handle_t *const handle)
 		goto error;
 
 	SSL_set_options(handle->ssl, SSL_OP_ALL);
-	if (SSL_connect(handle->ssl) <= 0) {
-		log_error("Error establishing SSL connection: %s (%d)", strerror(errno), errno);
+	ssl_ret = SSL_connect(handle->ssl);
+	if (ssl_ret <= 0) {
+		int const err = errno;
+
+		log_error("Error establishing SSL connection: %s (%d)", strerror(err), err);
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+		/* Only alerts from the server count against a new certificate */
+		if (is_credential_failure(SSL_get_error(handle->ssl, ssl_ret)))
+			credential_failed(handle);
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 		ERR_print_errors_fp(stderr);
 		goto error;
 	}
@@ -374,6 +622,13 @@ ccimp_status_t ccimp_network_tcp_open(ccimp_network_open_t *const data)
 			goto error;
 		}
 
+		/* Before connecting, so the window scale fits the buffer */
+		app_tcp_set_buffers(handle);
+
+		/* Wait for the connection to complete */
+		handle->watch_writable = false;
+		watch_socket(handle, true);
+
 		status = app_tcp_connect(handle->sock, ip_addr);
 		if (status != CCIMP_STATUS_OK)
 			goto error;
@@ -409,8 +664,12 @@ ccimp_status_t ccimp_network_tcp_open(ccimp_network_open_t *const data)
 			}
 		}
 
+		watch_socket(handle, false);
+
 		log_info("Connected to %s", data->device_cloud.url);
 
+		compression_set_link(handle->sock);
+
 		return CCIMP_STATUS_OK;
 	}
 
@@ -433,8 +692,10 @@ error:
 		log_error("Failed to connect to %s", data->device_cloud.url);
 		dns_set_redirected(0);
 
-		if (handle->sock != -1)
+		if (handle->sock != -1) {
+			connector_event_unwatch(handle->sock);
 			close(handle->sock);
+		}
 
 		free_network_handle(handle);
 		data->handle = NULL;
@@ -480,6 +741,8 @@ ccimp_status_t ccimp_network_tcp_close(ccimp_network_close_t *const data)
 #endif /* APP_SSL */
 
 close:
+	if (handle->sock != -1)
+		connector_event_unwatch(handle->sock);
 	if (handle->sock != -1 && close(handle->sock) < 0)
 		log_error("Error closing connection: %s (%d)", strerror(errno), errno);
 
@@ -508,6 +771,11 @@ static ccimp_status_t get_status(int const ret, network_handle_t *const handle,
 			default:
 				log_error("%s: SSL error %d", func_name, ssl_error);
 		}
+
+#ifdef CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED
+		if (is_credential_failure(ssl_error))
+			credential_failed(handle);
+#endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 #else /* APP_SSL */
 		UNUSED_ARGUMENT(handle);
 		UNUSED_ARGUMENT(func_name);
@@ -566,6 +834,8 @@ ccimp_status_t ccimp_network_tcp_receive(ccimp_network_receive_t *const data)
 		/* EOF on input: the connection was closed. */
 		log_debug("%s: EOF on socket", __func__);
 		errno = ECONNRESET;
+	} else if (read_bytes > 0) {
+		app_tcp_adapt_buffers(handle, (size_t) read_bytes);
 	}
 
 	return get_status(read_bytes, handle, &data->bytes_used, __func__);
@@ -574,6 +844,7 @@ ccimp_status_t ccimp_network_tcp_receive(ccimp_network_receive_t *const data)
 ccimp_status_t ccimp_network_tcp_send(ccimp_network_send_t *const data)
 {
 	network_handle_t *const handle = data->handle;
+	ccimp_status_t status;
 	int sent_bytes = 0;
 
 #ifdef APP_SSL
@@ -582,5 +853,10 @@ ccimp_status_t ccimp_network_tcp_send(ccimp_network_send_t *const data)
 	sent_bytes = write(handle->sock, data->buffer, data->bytes_available);
 #endif /* APP_SSL */
 
-	return get_status(sent_bytes, handle, &data->bytes_used, __func__);
+	status = get_status(sent_bytes, handle, &data->bytes_used, __func__);
+
+	/* Wake the connector when there is room to send again */
+	watch_socket(handle, status == CCIMP_STATUS_BUSY);
+
+	return status;
 }
@@ -27,6 +27,8 @@
 
 #include "ccimp/ccimp_os.h"
 #include "cc_logging.h"
+#include "cc_mem_budget.h"
+#include "connector_event.h"
 
 #if (defined UNIT_TEST)
 #define ccimp_os_malloc			ccimp_os_malloc_real
@@ -51,14 +53,25 @@ typedef struct thread_info {
 static thread_info_t * thread_info_list = NULL;
 #endif /* UNIT_TEST */
 
+/* Last lock the connector thread waited on with a timeout, NULL if none */
+static sem_t *idle_lock = NULL;
+
 ccimp_status_t ccimp_os_malloc(ccimp_os_malloc_t *const malloc_info)
 {
 	malloc_info->ptr = malloc(malloc_info->size);
-	return malloc_info->ptr == NULL ? CCIMP_STATUS_ERROR : CCIMP_STATUS_OK;
+	if (malloc_info->ptr == NULL)
+		return CCIMP_STATUS_ERROR;
+
+	/* Connector allocations are accounted, but never refused */
+	mem_budget_charge(MEM_SS_CONNECTOR, malloc_usable_size(malloc_info->ptr));
+
+	return CCIMP_STATUS_OK;
 }
 
 ccimp_status_t ccimp_os_free(ccimp_os_free_t *const free_info)
 {
+	if (free_info->ptr != NULL)
+		mem_budget_release(MEM_SS_CONNECTOR, malloc_usable_size((void *) free_info->ptr));
 	free((void *) free_info->ptr);
 	return CCIMP_STATUS_OK;
 }
@@ -66,10 +79,20 @@ ccimp_status_t ccimp_os_free(ccimp_os_free_t *const free_info)
 ccimp_status_t ccimp_os_realloc(ccimp_os_realloc_t *const realloc_info)
 {
 	ccimp_status_t status = CCIMP_STATUS_OK;
+	size_t old_size = 0;
+	void *ptr;
+
+	if (realloc_info->ptr != NULL)
+		old_size = malloc_usable_size(realloc_info->ptr);
 
-	realloc_info->ptr = realloc(realloc_info->ptr, realloc_info->new_size);
-	if (realloc_info->ptr == NULL)
+	ptr = realloc(realloc_info->ptr, realloc_info->new_size);
+	if (ptr == NULL) {
 		status = CCIMP_STATUS_ERROR;
+	} else {
+		mem_budget_release(MEM_SS_CONNECTOR, old_size);
+		mem_budget_charge(MEM_SS_CONNECTOR, malloc_usable_size(ptr));
+	}
+	realloc_info->ptr = ptr;
 
 	return status;
 }
@@ -90,9 +113,16 @@ void wait_for_ccimp_threads(void)
 static void *thread_wrapper(void *argument)
 {
 	ccimp_os_create_thread_info_t *create_thread_info = (ccimp_os_create_thread_info_t *) argument;
+	bool const is_fsm = create_thread_info->type == CCIMP_THREAD_FSM;
+
+	if (is_fsm)
+		connector_event_set_connector_thread();
 
 	create_thread_info->start(create_thread_info->argument);
 
+	if (is_fsm)
+		connector_event_stop();
+
 	return NULL;
 }
 
@@ -244,11 +274,40 @@ done:
 	return status;
 }
 
+/*
+ * connector_lock_wait() - Timed lock wait of the connector thread
+ *
+ * @data:	Lock acquire request.
+ * @sem:	Semaphore of the lock.
+ *
+ * The connector (FSM) thread only waits with a timeout when it is idle, and
+ * it must handle network data as soon as it arrives. Instead of blocking on
+ * the bare semaphore, wait for connector events: a release of this lock by
+ * another thread, which is how work is queued, or a watched socket being
+ * ready. Ending the wait early is reported as a timeout.
+ *
+ * Return: CCIMP_STATUS_OK.
+ */
+static ccimp_status_t connector_lock_wait(ccimp_os_lock_acquire_t *const data, sem_t *const sem)
+{
+	/* Releasing this lock from other threads wakes the connector */
+	__atomic_store_n(&idle_lock, sem, __ATOMIC_RELEASE);
+	if (sem_trywait(sem) != 0) {
+		connector_event_wait(data->timeout_ms);
+		if (sem_trywait(sem) != 0)
+			return CCIMP_STATUS_OK;
+	}
+	data->acquired = CCAPI_TRUE;
+
+	return CCIMP_STATUS_OK;
+}
+
 ccimp_status_t ccimp_os_lock_acquire(ccimp_os_lock_acquire_t *const data)
 {
 	struct timespec ts = { 0 };
 	int s;
 	sem_t *sem = data->lock;
+	unsigned long timeout_ms = data->timeout_ms;
 
 	if (sem == NULL) {
 		log_error("%s: NULL semaphore", __func__);
@@ -257,6 +316,17 @@ ccimp_status_t ccimp_os_lock_acquire(ccimp_os_lock_acquire_t *const data)
 
 	data->acquired = CCAPI_FALSE;
 
+	if (connector_event_is_connector_thread()
+		&& data->timeout_ms != OS_LOCK_ACQUIRE_NOWAIT
+		&& data->timeout_ms != OS_LOCK_ACQUIRE_INFINITE) {
+		if (connector_event_available())
+			return connector_lock_wait(data, sem);
+
+		/* Without events, keep the original idle sleep to notice network data */
+		if (timeout_ms > CONNECTOR_EVENT_FALLBACK_MS)
+			timeout_ms = CONNECTOR_EVENT_FALLBACK_MS;
+	}
+
 	if (data->timeout_ms == OS_LOCK_ACQUIRE_NOWAIT) {
 		ccapi_logging_line_info("ccimp_os_lock_acquire(): about to call sem_trywait()\n");
 		s = sem_trywait(sem);
@@ -275,8 +345,8 @@ ccimp_status_t ccimp_os_lock_acquire(ccimp_os_lock_acquire_t *const data)
 			return CCIMP_STATUS_ERROR;
 		}
 
-		ts.tv_sec += data->timeout_ms / 1000;
-		ts.tv_nsec += (data->timeout_ms % 1000) * 1000 * 1000;
+		ts.tv_sec += timeout_ms / 1000;
+		ts.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
 
 		/* Adjust if nsec rolls-over 999999999 */
 		#define NSEC_ROLL_OVER (1 * 1000 * 1000 * 1000)
@@ -326,18 +396,25 @@ ccimp_status_t ccimp_os_lock_release(ccimp_os_lock_release_t *const data)
 		return CCIMP_STATUS_ERROR;
 	}
 
+	if (sem == __atomic_load_n(&idle_lock, __ATOMIC_ACQUIRE) && !connector_event_is_connector_thread())
+		connector_event_wake();
+
 	return CCIMP_STATUS_OK;
 }
 
 ccimp_status_t ccimp_os_lock_destroy(ccimp_os_lock_destroy_t *const data)
 {
 	sem_t *const sem = data->lock;
+	sem_t *expected = sem;
 
 	if (sem == NULL) {
 		log_error("%s: NULL semaphore", __func__);
 		return CCIMP_STATUS_ERROR;
 	}
 
+	__atomic_compare_exchange_n(&idle_lock, &expected, NULL, false,
+		__ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+
 	if (sem_destroy(sem) == -1) {
 		log_error("%s: error", __func__);
 		return CCIMP_STATUS_ERROR;
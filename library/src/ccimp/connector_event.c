@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cc_logging.h"
+#include "connector_event.h"
+
+#define EVENT_MAX_EVENTS	4
+#define EVENT_STATS_PERIOD	60 /* seconds */
+
+/*
+ * The eventfd is registered with a NULL data pointer to tell it apart from
+ * the watched sockets, registered with their descriptor.
+ */
+#define WAKE_EVENT_FD		(-1)
+
+/* Protects 'wake_fd', used from any thread */
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static int wake_fd = -1;
+
+static __thread bool connector_thread = false;
+
+/* Only accessed from the connector thread */
+static int epoll_fd = -1;
+static unsigned long event_wakeups = 0;
+static unsigned long timeout_wakeups = 0;
+static time_t stats_start = 0;
+
+static void event_init(void)
+{
+	struct epoll_event ev = { 0 };
+	int fd;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		log_error("Unable to create connector event poll: %s (%d)", strerror(errno), errno);
+		return;
+	}
+
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0) {
+		log_error("Unable to create connector wake event: %s (%d)", strerror(errno), errno);
+		goto error;
+	}
+
+	ev.events = EPOLLIN;
+	ev.data.fd = WAKE_EVENT_FD;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		log_error("Unable to watch connector wake event: %s (%d)", strerror(errno), errno);
+		close(fd);
+		goto error;
+	}
+
+	pthread_mutex_lock(&wake_lock);
+	wake_fd = fd;
+	pthread_mutex_unlock(&wake_lock);
+
+	return;
+
+error:
+	close(epoll_fd);
+	epoll_fd = -1;
+}
+
+static time_t get_monotonic_time(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+
+	return ts.tv_sec;
+}
+
+/*
+ * update_stats() - Account an idle wakeup and log the rate periodically
+ *
+ * @by_event:	true if an event ended the wait, false if it timed out.
+ */
+static void update_stats(bool const by_event)
+{
+	time_t now = get_monotonic_time();
+	time_t elapsed;
+
+	if (by_event)
+		event_wakeups++;
+	else
+		timeout_wakeups++;
+
+	if (stats_start == 0)
+		stats_start = now;
+
+	elapsed = now - stats_start;
+	if (elapsed < EVENT_STATS_PERIOD)
+		return;
+
+	log_debug("Connector idle wakeups: %.2f/s (%lu by event, %lu by timeout in %ld s)",
+		(double) (event_wakeups + timeout_wakeups) / (double) elapsed,
+		event_wakeups, timeout_wakeups, (long) elapsed);
+
+	event_wakeups = 0;
+	timeout_wakeups = 0;
+	stats_start = now;
+}
+
+void connector_event_set_connector_thread(void)
+{
+	if (connector_thread)
+		return;
+
+	connector_thread = true;
+	event_init();
+}
+
+void connector_event_stop(void)
+{
+	if (!connector_thread)
+		return;
+
+	pthread_mutex_lock(&wake_lock);
+	if (wake_fd >= 0)
+		close(wake_fd);
+	wake_fd = -1;
+	pthread_mutex_unlock(&wake_lock);
+
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	epoll_fd = -1;
+
+	event_wakeups = 0;
+	timeout_wakeups = 0;
+	stats_start = 0;
+	connector_thread = false;
+}
+
+bool connector_event_is_connector_thread(void)
+{
+	return connector_thread;
+}
+
+bool connector_event_available(void)
+{
+	return connector_thread && epoll_fd >= 0;
+}
+
+void connector_event_wake(void)
+{
+	uint64_t value = 1;
+
+	pthread_mutex_lock(&wake_lock);
+	/* If the counter is saturated a wakeup is already pending */
+	if (wake_fd >= 0 && write(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+		log_debug("Unable to wake connector: %s (%d)", strerror(errno), errno);
+	pthread_mutex_unlock(&wake_lock);
+}
+
+bool connector_event_wait(unsigned long timeout_ms)
+{
+	struct epoll_event events[EVENT_MAX_EVENTS];
+	unsigned long waited_ms = 0;
+	int n, i;
+
+	if (epoll_fd < 0) {
+		usleep((timeout_ms < CONNECTOR_EVENT_FALLBACK_MS ? timeout_ms : CONNECTOR_EVENT_FALLBACK_MS) * 1000);
+		return false;
+	}
+
+	do {
+		struct timespec start, end;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		n = epoll_wait(epoll_fd, events, EVENT_MAX_EVENTS, (int) (timeout_ms - waited_ms));
+		if (n >= 0 || errno != EINTR)
+			break;
+
+		/* Interrupted by a signal, wait for the remaining time */
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		waited_ms += (unsigned long) ((end.tv_sec - start.tv_sec) * 1000
+			+ (end.tv_nsec - start.tv_nsec) / 1000000);
+	} while (waited_ms < timeout_ms);
+
+	if (n < 0) {
+		if (errno != EINTR)
+			log_debug("Unable to wait for connector events: %s (%d)", strerror(errno), errno);
+		n = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (events[i].data.fd == WAKE_EVENT_FD) {
+			uint64_t value;
+
+			/* Consume all the pending wakeups at once */
+			if (read(wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+				log_debug("Unable to read connector wake event: %s (%d)",
+					strerror(errno), errno);
+		} else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+			/*
+			 * A closed peer keeps the socket ready until it is closed,
+			 * report it once so the idle wait does not spin
+			 */
+			connector_event_unwatch(events[i].data.fd);
+		}
+	}
+
+	update_stats(n > 0);
+
+	return n > 0;
+}
+
+int connector_event_watch(int const fd, bool const writable)
+{
+	struct epoll_event ev = { 0 };
+
+	if (epoll_fd < 0)
+		return -1;
+
+	ev.events = EPOLLIN | EPOLLRDHUP | (writable ? EPOLLOUT : 0);
+	ev.data.fd = fd;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0)
+		return 0;
+
+	if (errno == ENOENT && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0)
+		return 0;
+
+	log_debug("Unable to watch socket %d: %s (%d)", fd, strerror(errno), errno);
+
+	return -1;
+}
+
+void connector_event_unwatch(int const fd)
+{
+	if (epoll_fd < 0)
+		return;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL) < 0 && errno != ENOENT && errno != EBADF)
+		log_debug("Unable to stop watching socket %d: %s (%d)", fd, strerror(errno), errno);
+}
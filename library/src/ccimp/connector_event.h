@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+#ifndef _CONNECTOR_EVENT_H
+#define _CONNECTOR_EVENT_H
+
+#include <stdbool.h>
+
+/*
+ * Longest timed wait of the connector thread when connector events are not
+ * available, the idle sleep it had before the events were added
+ */
+#define CONNECTOR_EVENT_FALLBACK_MS	100
+
+/* Mark the calling thread as the one running the connector state machine */
+void connector_event_set_connector_thread(void);
+bool connector_event_is_connector_thread(void);
+
+/* Release the connector events, called by the connector thread when it ends */
+void connector_event_stop(void);
+
+/* Check if the connector thread can wait for events */
+bool connector_event_available(void);
+
+/* Wake the connector thread if it is waiting idle, it can be called from any thread */
+void connector_event_wake(void);
+
+/*
+ * Wait idle in the connector thread until work is queued, a watched socket
+ * is ready or 'timeout_ms' milliseconds elapse.
+ * Returns true if an event ended the wait, false on timeout.
+ */
+bool connector_event_wait(unsigned long timeout_ms);
+
+/* Watch a socket for readability, and also writability if 'writable' is true */
+int connector_event_watch(int const fd, bool const writable);
+void connector_event_unwatch(int const fd);
+
+#endif /* _CONNECTOR_EVENT_H */
@@ -131,6 +131,18 @@ static void dns_cache_update(char const *const device_cloud_url, in_addr_t const
 	}
 }
 
+int dns_lookup(char const *const domain_name, in_addr_t *const ip_addr)
+{
+	if (domain_name == NULL || ip_addr == NULL)
+		return -1;
+
+	*ip_addr = inet_addr(domain_name);
+	if (*ip_addr != INADDR_NONE)
+		return 0;
+
+	return dns_resolve_name(domain_name, ip_addr);
+}
+
 int dns_resolve(char const *const device_cloud_url, in_addr_t *const ip_addr)
 {
 	int status = -1;
@@ -21,6 +21,8 @@
 #define _NETWORK_DNS_H
 
 int dns_resolve(char const *const domain_name, in_addr_t *const ip_addr);
+/* Same resolution as dns_resolve() but the cache is neither used nor updated */
+int dns_lookup(char const *const domain_name, in_addr_t *const ip_addr);
 void dns_set_redirected(int const state);
 void dns_cache_invalidate(void);
 
@@ -52,12 +52,18 @@
 
 /* Limits */
 #define CCIMP_FILE_SYSTEM_MAX_PATH_LENGTH   256
-#undef  CCIMP_FILE_SYSTEM_LARGE_FILES_SUPPORTED
+#define CCIMP_FILE_SYSTEM_LARGE_FILES_SUPPORTED
 
 #define CCIMP_SM_UDP_MAX_RX_SEGMENTS   256
 #define CCIMP_SM_SMS_MAX_RX_SEGMENTS   256
 
-#define CCIMP_IDLE_SLEEP_TIME_MS 100
+/*
+ * Maximum time the connector sleeps when idle. Queued work and network data
+ * wake it earlier, so this only bounds the handling of its timers. If the
+ * connector events are not available, it sleeps at most 100 ms as before
+ * (CONNECTOR_EVENT_FALLBACK_MS).
+ */
+#define CCIMP_IDLE_SLEEP_TIME_MS 1000
 
 #define CONNECTOR_MAX_VENDOR_ID_NUMBER 0xFFFFFFFF
 
@@ -65,7 +71,13 @@
 #define CONNECTOR_COMPRESSION_WINDOW_BITS 15
 #define CONNECTOR_COMPRESSION_MEM_LEVEL 8
 
+/*
+ * Connector receive window and maximum packet size, they can be set at build
+ * time (DFLAGS) to reduce the footprint or increase download throughput.
+ */
+#ifndef MSG_RECV_WINDOW_SIZE
 #define MSG_RECV_WINDOW_SIZE 65536
+#endif
 
 #define DP_MAX_NUMBER_PER_REQUEST 250
 
@@ -80,6 +92,8 @@
 #define CONNECTOR_STREAMING_CLI_CAPABILITIES_EXECUTE
 
 /* Default of 1500 - 20 - 20 bytes if not defined here. Maximum of 0xFFFF */
+#ifndef CCIMP_MSG_MAX_RECV_PACKET_SIZE
 #define CCIMP_MSG_MAX_RECV_PACKET_SIZE	1024 * 10 /* bytes */
+#endif
 
 #endif /* _CUSTOM_CONNECTOR_CONFIG_H_ */
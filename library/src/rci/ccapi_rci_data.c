@@ -44,6 +44,12 @@ static unsigned int start_group(ccapi_rci_info_t * const info)
 			rci_setting_static_location_start(info);
 		else if (strcmp(info->group.name, "system_monitor") == 0)
 			rci_setting_system_monitor_start(info);
+		else if (strcmp(info->group.name, "log_forward") == 0)
+			rci_setting_log_forward_start(info);
+		else if (strcmp(info->group.name, "logging") == 0)
+			rci_setting_logging_start(info);
+		else if (strcmp(info->group.name, "scheduled_jobs") == 0)
+			rci_setting_scheduled_jobs_start(info);
 		else if (strcmp(info->group.name, "system") == 0)
 			rci_setting_system_start(info);
 		else
@@ -75,6 +81,12 @@ static unsigned int end_group(ccapi_rci_info_t * const info)
 			rci_setting_static_location_end(info);
 		else if (strcmp(info->group.name, "system_monitor") == 0)
 			rci_setting_system_monitor_end(info);
+		else if (strcmp(info->group.name, "log_forward") == 0)
+			rci_setting_log_forward_end(info);
+		else if (strcmp(info->group.name, "logging") == 0)
+			rci_setting_logging_end(info);
+		else if (strcmp(info->group.name, "scheduled_jobs") == 0)
+			rci_setting_scheduled_jobs_end(info);
 		else if (strcmp(info->group.name, "system") == 0)
 			rci_setting_system_end(info);
 		else
@@ -286,6 +298,74 @@ static unsigned int get_element(ccapi_rci_info_t * const info, ccapi_element_val
 			ret = rci_setting_system_monitor_n_dp_upload_get(info, &element->unsigned_integer_value);
 	}
 
+	/* group setting log_forward "Log forwarding" */
+	if (strcmp(info->group.name, "log_forward") == 0) {
+		if (strcmp(info->element.name, "enable_logfwd") == 0)
+			ret = rci_setting_log_forward_enable_logfwd_get(info, &element->on_off_value);
+		else if (strcmp(info->element.name, "level") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_log_forward_level_get(info, &element->string_value);
+#else
+			ret = rci_setting_log_forward_level_get(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "filter") == 0)
+			ret = rci_setting_log_forward_filter_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "exclude") == 0)
+			ret = rci_setting_log_forward_exclude_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "rate") == 0)
+			ret = rci_setting_log_forward_rate_get(info, &element->unsigned_integer_value);
+		else if (strcmp(info->element.name, "interval") == 0)
+			ret = rci_setting_log_forward_interval_get(info, &element->unsigned_integer_value);
+	}
+
+	/* group setting logging "Logging" */
+	if (strcmp(info->group.name, "logging") == 0) {
+		if (strcmp(info->element.name, "level") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_logging_level_get(info, &element->string_value);
+#else
+			ret = rci_setting_logging_level_get(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "connector_debug") == 0)
+			ret = rci_setting_logging_connector_debug_get(info, &element->on_off_value);
+	}
+
+	/* group setting scheduled_jobs 16 "Scheduled jobs" */
+	if (strcmp(info->group.name, "scheduled_jobs") == 0) {
+		if (strcmp(info->element.name, "name") == 0)
+			ret = rci_setting_scheduled_jobs_name_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "schedule") == 0)
+			ret = rci_setting_scheduled_jobs_schedule_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "type") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_scheduled_jobs_type_get(info, &element->string_value);
+#else
+			ret = rci_setting_scheduled_jobs_type_get(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "action") == 0)
+			ret = rci_setting_scheduled_jobs_action_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "payload") == 0)
+			ret = rci_setting_scheduled_jobs_payload_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "missed") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_scheduled_jobs_missed_get(info, &element->string_value);
+#else
+			ret = rci_setting_scheduled_jobs_missed_get(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "timeout") == 0)
+			ret = rci_setting_scheduled_jobs_timeout_get(info, &element->unsigned_integer_value);
+		else if (strcmp(info->element.name, "nice") == 0)
+			ret = rci_setting_scheduled_jobs_nice_get(info, &element->signed_integer_value);
+		else if (strcmp(info->element.name, "memory") == 0)
+			ret = rci_setting_scheduled_jobs_memory_get(info, &element->unsigned_integer_value);
+		else if (strcmp(info->element.name, "enabled") == 0)
+			ret = rci_setting_scheduled_jobs_enabled_get(info, &element->on_off_value);
+		else if (strcmp(info->element.name, "next_run") == 0)
+			ret = rci_setting_scheduled_jobs_next_run_get(info, &element->string_value);
+		else if (strcmp(info->element.name, "last_result") == 0)
+			ret = rci_setting_scheduled_jobs_last_result_get(info, &element->string_value);
+	}
+
 	/* group setting system "System" */
 	if (strcmp(info->group.name, "system") == 0) {
 		if (strcmp(info->element.name, "description") == 0)
@@ -327,6 +407,70 @@ static unsigned int set_element(ccapi_rci_info_t * const info, ccapi_element_val
 			ret = rci_setting_system_monitor_n_dp_upload_set(info, &element->unsigned_integer_value);
 	}
 
+	/* group setting log_forward "Log forwarding" */
+	if (strcmp(info->group.name, "log_forward") == 0) {
+		if (strcmp(info->element.name, "enable_logfwd") == 0)
+			ret = rci_setting_log_forward_enable_logfwd_set(info, &element->on_off_value);
+		else if (strcmp(info->element.name, "level") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_log_forward_level_set(info, element->string_value);
+#else
+			ret = rci_setting_log_forward_level_set(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "filter") == 0)
+			ret = rci_setting_log_forward_filter_set(info, element->string_value);
+		else if (strcmp(info->element.name, "exclude") == 0)
+			ret = rci_setting_log_forward_exclude_set(info, element->string_value);
+		else if (strcmp(info->element.name, "rate") == 0)
+			ret = rci_setting_log_forward_rate_set(info, &element->unsigned_integer_value);
+		else if (strcmp(info->element.name, "interval") == 0)
+			ret = rci_setting_log_forward_interval_set(info, &element->unsigned_integer_value);
+	}
+
+	/* group setting logging "Logging" */
+	if (strcmp(info->group.name, "logging") == 0) {
+		if (strcmp(info->element.name, "level") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_logging_level_set(info, element->string_value);
+#else
+			ret = rci_setting_logging_level_set(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "connector_debug") == 0)
+			ret = rci_setting_logging_connector_debug_set(info, &element->on_off_value);
+	}
+
+	/* group setting scheduled_jobs 16 "Scheduled jobs" */
+	if (strcmp(info->group.name, "scheduled_jobs") == 0) {
+		if (strcmp(info->element.name, "name") == 0)
+			ret = rci_setting_scheduled_jobs_name_set(info, element->string_value);
+		else if (strcmp(info->element.name, "schedule") == 0)
+			ret = rci_setting_scheduled_jobs_schedule_set(info, element->string_value);
+		else if (strcmp(info->element.name, "type") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_scheduled_jobs_type_set(info, element->string_value);
+#else
+			ret = rci_setting_scheduled_jobs_type_set(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "action") == 0)
+			ret = rci_setting_scheduled_jobs_action_set(info, element->string_value);
+		else if (strcmp(info->element.name, "payload") == 0)
+			ret = rci_setting_scheduled_jobs_payload_set(info, element->string_value);
+		else if (strcmp(info->element.name, "missed") == 0)
+#if (defined RCI_ENUMS_AS_STRINGS)
+			ret = rci_setting_scheduled_jobs_missed_set(info, element->string_value);
+#else
+			ret = rci_setting_scheduled_jobs_missed_set(info, &element->enum_value);
+#endif /* RCI_ENUMS_AS_STRINGS */
+		else if (strcmp(info->element.name, "timeout") == 0)
+			ret = rci_setting_scheduled_jobs_timeout_set(info, &element->unsigned_integer_value);
+		else if (strcmp(info->element.name, "nice") == 0)
+			ret = rci_setting_scheduled_jobs_nice_set(info, &element->signed_integer_value);
+		else if (strcmp(info->element.name, "memory") == 0)
+			ret = rci_setting_scheduled_jobs_memory_set(info, &element->unsigned_integer_value);
+		else if (strcmp(info->element.name, "enabled") == 0)
+			ret = rci_setting_scheduled_jobs_enabled_set(info, &element->on_off_value);
+	}
+
 	/* group setting system "System" */
 	if (strcmp(info->group.name, "system") == 0) {
 		if (strcmp(info->element.name, "description") == 0)
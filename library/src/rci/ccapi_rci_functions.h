@@ -30,6 +30,9 @@
 #include "rci_setting_static_location.h"
 #include "rci_setting_system.h"
 #include "rci_setting_system_monitor.h"
+#include "rci_setting_log_forward.h"
+#include "rci_setting_logging.h"
+#include "rci_setting_scheduled_jobs.h"
 #include "rci_state_device_info.h"
 #include "rci_state_device_state.h"
 #include "rci_state_gps_stats.h"
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "cc_logging.h"
+#include "cc_log_forward.h"
+#include "cc_config.h"
+#include "rci_setting_log_forward.h"
+
+extern cc_cfg_t *cc_cfg;
+
+static int restart = 0;
+
+/* Copies of the expressions set remotely, the configuration does not own them */
+static char *filter = NULL, *exclude = NULL;
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+static char const *const level_names[] = {
+	"error", "warning", "notice", "info", "debug"
+};
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+/*
+ * set_regex() - Validate and store a regular expression setting
+ *
+ * @value:	New regular expression, empty to disable it.
+ * @copy:	Copy of the previous expression set remotely, replaced on success.
+ * @setting:	Configuration field to update.
+ *
+ * Return: CCAPI_SETTING_LOG_FORWARD_ERROR_NONE on success, an error otherwise.
+ */
+static ccapi_setting_log_forward_error_id_t set_regex(char const * const value,
+		char **copy, char **setting)
+{
+	regex_t regex;
+	char *new_value;
+
+	if (*value != '\0') {
+		if (regcomp(&regex, value, REG_EXTENDED | REG_NOSUB) != 0)
+			return CCAPI_SETTING_LOG_FORWARD_ERROR_BAD_VALUE;
+		regfree(&regex);
+	}
+
+	new_value = strdup(value);
+	if (new_value == NULL)
+		return CCAPI_SETTING_LOG_FORWARD_ERROR_MEMORY_FAIL;
+
+	free(*copy);
+	*copy = new_value;
+	*setting = new_value;
+	restart = 1;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_start(
+		ccapi_rci_info_t * const info)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_end(
+		ccapi_rci_info_t * const info)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (restart) {
+		stop_log_forward();
+		start_log_forward(cc_cfg);
+		restart = 0;
+	}
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_enable_logfwd_get(
+		ccapi_rci_info_t * const info, ccapi_on_off_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = (cc_cfg->services & LOG_FORWARD_SERVICE) ? CCAPI_ON : CCAPI_OFF;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_enable_logfwd_set(
+		ccapi_rci_info_t * const info, ccapi_on_off_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (*value == CCAPI_ON)
+		cc_cfg->services |= LOG_FORWARD_SERVICE;
+	else
+		cc_cfg->services &= ~LOG_FORWARD_SERVICE;
+	restart = 1;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_level_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = level_names[cc_cfg->log_fwd_level - LOG_ERR];
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_level_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	int i;
+
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	for (i = 0; i < CCAPI_SETTING_LOG_FORWARD_LEVEL_COUNT; i++) {
+		if (strcmp(value, level_names[i]) == 0) {
+			cc_cfg->log_fwd_level = LOG_ERR + i;
+			restart = 1;
+			return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+		}
+	}
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_BAD_VALUE;
+}
+#else
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_level_get(
+		ccapi_rci_info_t * const info, ccapi_setting_log_forward_level_id_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	/* Severities from 'error' to 'debug' are consecutive syslog priorities */
+	*value = (ccapi_setting_log_forward_level_id_t) (cc_cfg->log_fwd_level - LOG_ERR);
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_level_set(
+		ccapi_rci_info_t * const info, ccapi_setting_log_forward_level_id_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (*value >= CCAPI_SETTING_LOG_FORWARD_LEVEL_COUNT)
+		return CCAPI_SETTING_LOG_FORWARD_ERROR_BAD_VALUE;
+
+	cc_cfg->log_fwd_level = LOG_ERR + (int) *value;
+	restart = 1;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_filter_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = cc_cfg->log_fwd_filter ? cc_cfg->log_fwd_filter : "";
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_filter_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return set_regex(value, &filter, &cc_cfg->log_fwd_filter);
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_exclude_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = cc_cfg->log_fwd_exclude ? cc_cfg->log_fwd_exclude : "";
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_exclude_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return set_regex(value, &exclude, &cc_cfg->log_fwd_exclude);
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_rate_get(
+		ccapi_rci_info_t * const info, uint32_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = cc_cfg->log_fwd_rate;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_rate_set(
+		ccapi_rci_info_t * const info, uint32_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	cc_cfg->log_fwd_rate = *value;
+	restart = 1;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_interval_get(
+		ccapi_rci_info_t * const info, uint32_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = cc_cfg->log_fwd_interval;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
+
+ccapi_setting_log_forward_error_id_t rci_setting_log_forward_interval_set(
+		ccapi_rci_info_t * const info, uint32_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	cc_cfg->log_fwd_interval = *value;
+	restart = 1;
+
+	return CCAPI_SETTING_LOG_FORWARD_ERROR_NONE;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <string.h>
+#include <syslog.h>
+
+#include "cc_config.h"
+#include "cc_init.h"
+#include "cc_logging.h"
+#include "rci_setting_logging.h"
+
+extern cc_cfg_t *cc_cfg;
+
+static int update = 0;
+
+/* Log levels of the 'log_level' setting, in the order of the RCI enum */
+static int const levels[] = {
+	LOG_LEVEL_ERROR, LOG_LEVEL_INFO, LOG_LEVEL_DEBUG
+};
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+static char const *const level_names[] = {
+	"error", "info", "debug"
+};
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+/*
+ * get_level_index() - Get the RCI enum index of the configured log level
+ *
+ * Return: The index of the log level, 'error' if it is not a known one.
+ */
+static ccapi_setting_logging_level_id_t get_level_index(void)
+{
+	int i;
+
+	for (i = 0; i < CCAPI_SETTING_LOGGING_LEVEL_COUNT; i++) {
+		if (levels[i] == cc_cfg->log_level)
+			return (ccapi_setting_logging_level_id_t) i;
+	}
+
+	return CCAPI_SETTING_LOGGING_LEVEL_ERROR;
+}
+
+ccapi_setting_logging_error_id_t rci_setting_logging_start(
+		ccapi_rci_info_t * const info)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
+
+ccapi_setting_logging_error_id_t rci_setting_logging_end(
+		ccapi_rci_info_t * const info)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (update) {
+		update_log_level();
+		update = 0;
+	}
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+ccapi_setting_logging_error_id_t rci_setting_logging_level_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = level_names[get_level_index()];
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
+
+ccapi_setting_logging_error_id_t rci_setting_logging_level_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	int i;
+
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	for (i = 0; i < CCAPI_SETTING_LOGGING_LEVEL_COUNT; i++) {
+		if (strcmp(value, level_names[i]) == 0) {
+			cc_cfg->log_level = levels[i];
+			update = 1;
+			return CCAPI_SETTING_LOGGING_ERROR_NONE;
+		}
+	}
+
+	return CCAPI_SETTING_LOGGING_ERROR_BAD_VALUE;
+}
+#else
+ccapi_setting_logging_error_id_t rci_setting_logging_level_get(
+		ccapi_rci_info_t * const info, ccapi_setting_logging_level_id_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = get_level_index();
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
+
+ccapi_setting_logging_error_id_t rci_setting_logging_level_set(
+		ccapi_rci_info_t * const info, ccapi_setting_logging_level_id_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (*value >= CCAPI_SETTING_LOGGING_LEVEL_COUNT)
+		return CCAPI_SETTING_LOGGING_ERROR_BAD_VALUE;
+
+	cc_cfg->log_level = levels[*value];
+	update = 1;
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+ccapi_setting_logging_error_id_t rci_setting_logging_connector_debug_get(
+		ccapi_rci_info_t * const info, ccapi_on_off_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = cc_cfg->connector_debug ? CCAPI_ON : CCAPI_OFF;
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
+
+ccapi_setting_logging_error_id_t rci_setting_logging_connector_debug_set(
+		ccapi_rci_info_t * const info, ccapi_on_off_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	cc_cfg->connector_debug = (*value == CCAPI_ON);
+	update = 1;
+
+	return CCAPI_SETTING_LOGGING_ERROR_NONE;
+}
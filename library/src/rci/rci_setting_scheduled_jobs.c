@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "cc_logging.h"
+#include "cc_job_scheduler.h"
+#include "rci_setting_scheduled_jobs.h"
+
+/* Copy of the job being configured, it is set at the end of the group */
+static job_def_t job;
+static job_status_t job_status;
+static int changed = 0;
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+static char const *const type_names[] = {
+	"target", "command"
+};
+
+static char const *const missed_names[] = {
+	"skip", "run_once", "run_all"
+};
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+/*
+ * set_string() - Set a string field of the job being configured
+ *
+ * @dst:	Field to set.
+ * @size:	Size of the field.
+ * @value:	New value.
+ *
+ * Return: CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE on success, an error otherwise.
+ */
+static ccapi_setting_scheduled_jobs_error_id_t set_string(char *dst, size_t size,
+		char const * const value)
+{
+	if (strlen(value) >= size)
+		return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_BAD_VALUE;
+
+	strcpy(dst, value);
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_start(
+		ccapi_rci_info_t * const info)
+{
+	log_debug("    Called '%s'\n", __func__);
+
+	changed = 0;
+	if (job_scheduler_get(info->group.item.index - 1, &job, &job_status) != 0)
+		return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_INVALID_INDEX;
+
+	/* Defaults for a free slot, used once a name is set */
+	if (job.name[0] == '\0') {
+		job.missed = JOB_MISSED_RUN_ONCE;
+		job.timeout = JOB_DEFAULT_TIMEOUT;
+		job.nice = JOB_DEFAULT_NICE;
+		job.enabled = true;
+	}
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_end(
+		ccapi_rci_info_t * const info)
+{
+	const char *error;
+
+	log_debug("    Called '%s'\n", __func__);
+
+	if (!changed)
+		return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+
+	changed = 0;
+	error = job_scheduler_set(info->group.item.index - 1, &job);
+	if (error != NULL) {
+		log_error("Cannot set scheduled job %u: %s", info->group.item.index, error);
+		return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_SAVE_FAIL;
+	}
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_name_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.name;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_name_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return set_string(job.name, sizeof(job.name), value);
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_schedule_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.schedule;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_schedule_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return set_string(job.schedule, sizeof(job.schedule), value);
+}
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_type_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = type_names[job.type];
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_type_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	int i;
+
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	for (i = 0; i < CCAPI_SETTING_SCHEDULED_JOBS_TYPE_COUNT; i++) {
+		if (strcmp(value, type_names[i]) == 0) {
+			job.type = (job_type_t) i;
+			changed = 1;
+			return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+		}
+	}
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_BAD_VALUE;
+}
+#else
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_type_get(
+		ccapi_rci_info_t * const info, ccapi_setting_scheduled_jobs_type_id_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.type == JOB_TYPE_COMMAND ?
+		CCAPI_SETTING_SCHEDULED_JOBS_TYPE_COMMAND : CCAPI_SETTING_SCHEDULED_JOBS_TYPE_TARGET;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_type_set(
+		ccapi_rci_info_t * const info, ccapi_setting_scheduled_jobs_type_id_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (*value >= CCAPI_SETTING_SCHEDULED_JOBS_TYPE_COUNT)
+		return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_BAD_VALUE;
+
+	job.type = *value == CCAPI_SETTING_SCHEDULED_JOBS_TYPE_COMMAND ? JOB_TYPE_COMMAND : JOB_TYPE_TARGET;
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_action_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.action;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_action_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return set_string(job.action, sizeof(job.action), value);
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_payload_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.payload;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_payload_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	return set_string(job.payload, sizeof(job.payload), value);
+}
+
+#if (defined RCI_ENUMS_AS_STRINGS)
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_missed_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = missed_names[job.missed];
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_missed_set(
+		ccapi_rci_info_t * const info, char const * const value)
+{
+	int i;
+
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	for (i = 0; i < CCAPI_SETTING_SCHEDULED_JOBS_MISSED_COUNT; i++) {
+		if (strcmp(value, missed_names[i]) == 0) {
+			job.missed = (job_missed_t) i;
+			changed = 1;
+			return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+		}
+	}
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_BAD_VALUE;
+}
+#else
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_missed_get(
+		ccapi_rci_info_t * const info, ccapi_setting_scheduled_jobs_missed_id_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	/* Both enumerations follow the same order */
+	*value = (ccapi_setting_scheduled_jobs_missed_id_t) job.missed;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_missed_set(
+		ccapi_rci_info_t * const info, ccapi_setting_scheduled_jobs_missed_id_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	if (*value >= CCAPI_SETTING_SCHEDULED_JOBS_MISSED_COUNT)
+		return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_BAD_VALUE;
+
+	job.missed = (job_missed_t) *value;
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+#endif /* RCI_ENUMS_AS_STRINGS */
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_timeout_get(
+		ccapi_rci_info_t * const info, uint32_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.timeout;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_timeout_set(
+		ccapi_rci_info_t * const info, uint32_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	job.timeout = *value;
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_nice_get(
+		ccapi_rci_info_t * const info, int32_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.nice;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_nice_set(
+		ccapi_rci_info_t * const info, int32_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	job.nice = *value;
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_memory_get(
+		ccapi_rci_info_t * const info, uint32_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.memory_kb;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_memory_set(
+		ccapi_rci_info_t * const info, uint32_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	job.memory_kb = *value;
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_enabled_get(
+		ccapi_rci_info_t * const info, ccapi_on_off_t * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job.enabled ? CCAPI_ON : CCAPI_OFF;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_enabled_set(
+		ccapi_rci_info_t * const info, ccapi_on_off_t const * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	job.enabled = *value == CCAPI_ON;
+	changed = 1;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_next_run_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	static char next_run[sizeof("YYYY-MM-DDTHH:MM:SSZ")];
+	struct tm tm;
+
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	next_run[0] = '\0';
+	if (job.enabled && job_status.next_run > 0 && gmtime_r(&job_status.next_run, &tm) != NULL)
+		strftime(next_run, sizeof(next_run), "%Y-%m-%dT%H:%M:%SZ", &tm);
+	*value = next_run;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
+
+ccapi_setting_scheduled_jobs_error_id_t rci_setting_scheduled_jobs_last_result_get(
+		ccapi_rci_info_t * const info, char const * * const value)
+{
+	UNUSED_PARAMETER(info);
+	log_debug("    Called '%s'\n", __func__);
+
+	*value = job_status.running ? "running" : job_status.last_result;
+
+	return CCAPI_SETTING_SCHEDULED_JOBS_ERROR_NONE;
+}
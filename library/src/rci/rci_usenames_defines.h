@@ -39,11 +39,11 @@
 #endif
 #endif
 #if !(defined RCI_VALUES_NAME_MAX_SIZE)
-#define RCI_VALUES_NAME_MAX_SIZE 7
+#define RCI_VALUES_NAME_MAX_SIZE 8
 #else
-#if RCI_VALUES_NAME_MAX_SIZE < 7
+#if RCI_VALUES_NAME_MAX_SIZE < 8
 #undef RCI_VALUES_NAME_MAX_SIZE
-#define RCI_VALUES_NAME_MAX_SIZE 7
+#define RCI_VALUES_NAME_MAX_SIZE 8
 #endif
 #endif
 
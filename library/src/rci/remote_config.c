@@ -302,6 +302,200 @@ static connector_item_t CONST setting_system_monitor_items[] = {
 { connector_element_type_uint32, { .element = &setting_system_monitor__n_dp_upload_element } }
 };
 
+static connector_element_enum_t CONST setting_log_forward__level_enum[] = {
+    {"error"},
+    {"warning"},
+    {"notice"},
+    {"info"},
+    {"debug"}
+};
+
+static connector_element_t CONST setting_log_forward__enable_logfwd_element = {
+    "enable_logfwd",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_log_forward__level_element = {
+    "level",
+    NULL,
+    connector_element_access_read_write,
+    { ARRAY_SIZE(setting_log_forward__level_enum), setting_log_forward__level_enum}, 
+};
+
+static connector_element_t CONST setting_log_forward__filter_element = {
+    "filter",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_log_forward__exclude_element = {
+    "exclude",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_log_forward__rate_element = {
+    "rate",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_log_forward__interval_element = {
+    "interval",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_item_t CONST setting_log_forward_items[] = {
+{ connector_element_type_on_off, { .element = &setting_log_forward__enable_logfwd_element } },
+{ connector_element_type_enum, { .element = &setting_log_forward__level_element } },
+{ connector_element_type_string, { .element = &setting_log_forward__filter_element } },
+{ connector_element_type_string, { .element = &setting_log_forward__exclude_element } },
+{ connector_element_type_uint32, { .element = &setting_log_forward__rate_element } },
+{ connector_element_type_uint32, { .element = &setting_log_forward__interval_element } }
+};
+
+static connector_element_enum_t CONST setting_logging__level_enum[] = {
+    {"error"},
+    {"info"},
+    {"debug"}
+};
+
+static connector_element_t CONST setting_logging__level_element = {
+    "level",
+    NULL,
+    connector_element_access_read_write,
+    { ARRAY_SIZE(setting_logging__level_enum), setting_logging__level_enum}, 
+};
+
+static connector_element_t CONST setting_logging__connector_debug_element = {
+    "connector_debug",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_item_t CONST setting_logging_items[] = {
+{ connector_element_type_enum, { .element = &setting_logging__level_element } },
+{ connector_element_type_on_off, { .element = &setting_logging__connector_debug_element } }
+};
+
+static connector_element_enum_t CONST setting_scheduled_jobs__type_enum[] = {
+    {"target"},
+    {"command"}
+};
+
+static connector_element_enum_t CONST setting_scheduled_jobs__missed_enum[] = {
+    {"skip"},
+    {"run_once"},
+    {"run_all"}
+};
+
+static connector_element_t CONST setting_scheduled_jobs__name_element = {
+    "name",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__schedule_element = {
+    "schedule",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__type_element = {
+    "type",
+    NULL,
+    connector_element_access_read_write,
+    { ARRAY_SIZE(setting_scheduled_jobs__type_enum), setting_scheduled_jobs__type_enum}, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__action_element = {
+    "action",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__payload_element = {
+    "payload",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__missed_element = {
+    "missed",
+    NULL,
+    connector_element_access_read_write,
+    { ARRAY_SIZE(setting_scheduled_jobs__missed_enum), setting_scheduled_jobs__missed_enum}, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__timeout_element = {
+    "timeout",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__nice_element = {
+    "nice",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__memory_element = {
+    "memory",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__enabled_element = {
+    "enabled",
+    NULL,
+    connector_element_access_read_write,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__next_run_element = {
+    "next_run",
+    NULL,
+    connector_element_access_read_only,
+    { 0, NULL }, 
+};
+
+static connector_element_t CONST setting_scheduled_jobs__last_result_element = {
+    "last_result",
+    NULL,
+    connector_element_access_read_only,
+    { 0, NULL }, 
+};
+
+static connector_item_t CONST setting_scheduled_jobs_items[] = {
+{ connector_element_type_string, { .element = &setting_scheduled_jobs__name_element } },
+{ connector_element_type_string, { .element = &setting_scheduled_jobs__schedule_element } },
+{ connector_element_type_enum, { .element = &setting_scheduled_jobs__type_element } },
+{ connector_element_type_string, { .element = &setting_scheduled_jobs__action_element } },
+{ connector_element_type_string, { .element = &setting_scheduled_jobs__payload_element } },
+{ connector_element_type_enum, { .element = &setting_scheduled_jobs__missed_element } },
+{ connector_element_type_uint32, { .element = &setting_scheduled_jobs__timeout_element } },
+{ connector_element_type_int32, { .element = &setting_scheduled_jobs__nice_element } },
+{ connector_element_type_uint32, { .element = &setting_scheduled_jobs__memory_element } },
+{ connector_element_type_on_off, { .element = &setting_scheduled_jobs__enabled_element } },
+{ connector_element_type_string, { .element = &setting_scheduled_jobs__next_run_element } },
+{ connector_element_type_string, { .element = &setting_scheduled_jobs__last_result_element } }
+};
+
 static connector_element_t CONST setting_system__description_element = {
     "description",
     NULL,
@@ -370,6 +564,36 @@ static connector_group_t CONST connector_setting_groups[] = {
     { 0, NULL }
 },
 
+{
+    {
+        "log_forward",
+        connector_collection_type_fixed_array,
+        { 1 /* instances */ },
+        { 6, setting_log_forward_items },
+    },
+    { 0, NULL }
+},
+
+{
+    {
+        "logging",
+        connector_collection_type_fixed_array,
+        { 1 /* instances */ },
+        { 2, setting_logging_items },
+    },
+    { 0, NULL }
+},
+
+{
+    {
+        "scheduled_jobs",
+        connector_collection_type_fixed_array,
+        { 16 /* instances */ },
+        { 12, setting_scheduled_jobs_items },
+    },
+    { 0, NULL }
+},
+
 {
     {
         "system",
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -692,3 +693,83 @@ cccs_comm_error_t cccs_remove_request_target_tout(char const * const target, uns
 
 	return ret;
 }
+
+/*
+ * get_child_target() - Get the data request target of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @target:	Target name of the child device.
+ *
+ * Return: The 'child/<child_id>/<target>' name, it must be freed. NULL if any
+ *         argument is not valid or out of memory.
+ */
+static char *get_child_target(char const * const child_id, char const * const target)
+{
+	char *child_target = NULL;
+
+	if (!child_id || *child_id == '\0' || strchr(child_id, '/') || !target) {
+		log_dr_error("%s", "Invalid child data request target");
+		return NULL;
+	}
+
+	if (asprintf(&child_target, GW_CHILD_TARGET_PREFIX "%s/%s", child_id, target) < 0) {
+		log_dr_error("Invalid child data request target: %s", "Out of memory");
+		return NULL;
+	}
+
+	return child_target;
+}
+
+cccs_comm_error_t cccs_gw_add_request_target(char const * const child_id,
+	char const * const target, cccs_request_data_cb_t data_cb,
+	cccs_request_status_cb_t status_cb, cccs_resp_t *resp)
+{
+	return cccs_gw_add_request_target_tout(child_id, target, data_cb, status_cb, 0, resp);
+}
+
+cccs_comm_error_t cccs_gw_add_request_target_tout(char const * const child_id,
+	char const * const target, cccs_request_data_cb_t data_cb,
+	cccs_request_status_cb_t status_cb, unsigned long timeout, cccs_resp_t *resp)
+{
+	char *child_target = get_child_target(child_id, target);
+	cccs_comm_error_t ret;
+
+	if (!child_target) {
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	ret = cccs_add_request_target_tout(child_target, data_cb, status_cb, timeout, resp);
+
+	free(child_target);
+
+	return ret;
+}
+
+cccs_comm_error_t cccs_gw_remove_request_target(char const * const child_id,
+	char const * const target, cccs_resp_t *resp)
+{
+	return cccs_gw_remove_request_target_tout(child_id, target, 0, resp);
+}
+
+cccs_comm_error_t cccs_gw_remove_request_target_tout(char const * const child_id,
+	char const * const target, unsigned long timeout, cccs_resp_t *resp)
+{
+	char *child_target = get_child_target(child_id, target);
+	cccs_comm_error_t ret;
+
+	if (!child_target) {
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	ret = cccs_remove_request_target_tout(child_target, timeout, resp);
+
+	free(child_target);
+
+	return ret;
+}
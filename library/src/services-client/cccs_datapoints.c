@@ -18,6 +18,7 @@
  */
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,6 +47,9 @@
 #define CCCS_DP_KEY_TS_EPOCH_MS		"ts_epoch_ms"
 #define CCCS_DP_KEY_TS_ISO8601		"ts_iso"
 
+/* Maximum number of collections with a staging area */
+#define DP_STAGING_SLOTS		32
+
 /**
  * log_dp_debug() - Log the given message as debug
  *
@@ -73,11 +77,49 @@
 #define log_dp_error(format, ...)					\
 	log_error("%s " format, SERVICE_TAG, __VA_ARGS__)
 
+/*
+ * dp_staged_t - Data point added to a collection not yet linked to its stream
+ *
+ * @dp:			The data point. It must be the first member, ccapi
+ *			frees the whole entry when it releases the data point.
+ * @data_stream:	Data stream the data point belongs to.
+ * @next:		Previously staged data point.
+ */
+typedef struct dp_staged {
+	connector_data_point_t dp;
+	cccs_dp_data_stream_t *data_stream;
+	struct dp_staged *next;
+} dp_staged_t;
+
+/*
+ * dp_staging_t - Staging area of a data point collection
+ *
+ * @collection:		Collection using the slot, NULL if the slot is free.
+ * @head:		Last staged data point.
+ * @streams_lock:	Protects the data streams list of the collection. Read
+ *			by producers, written when data streams are added or
+ *			removed.
+ *
+ * Producers push new data points to 'head' without taking the collection lock
+ * so they never wait for an in-progress send. Data points are linked to their
+ * data streams, in the order they were added, by any operation holding the
+ * collection lock that needs them.
+ */
+typedef struct {
+	cccs_dp_collection_t *collection;
+	dp_staged_t *head;
+	pthread_rwlock_t streams_lock;
+} dp_staging_t;
+
+static dp_staging_t dp_staging[DP_STAGING_SLOTS];
+static pthread_once_t dp_staging_once = PTHREAD_ONCE_INIT;
+
 typedef union {
 	struct {
 		char *data;
 		size_t length;
 		char *stream_id;
+		char const *child_id;
 	} blob;
 	struct {
 		char *path;
@@ -92,7 +134,9 @@ typedef union {
  * @type:	Type of the data to upload: 'upload_datapoint_file_metrics' or
  *		'upload_datapoint_file_path_metrics' or
  *		'upload_datapoint_file_metrics_binary' or
- *		'upload_datapoint_file_path_binary'.
+ *		'upload_datapoint_file_path_binary' or
+ *		'upload_datapoint_file_metrics_local' or
+ *		'upload_datapoint_file_metrics_child'.
  * @data:	Data points data to send.
  *
  * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
@@ -103,10 +147,13 @@ static cccs_comm_error_t send_dp_data_type(int fd, upload_datapoint_file_t type,
 	switch (type) {
 		case upload_datapoint_file_metrics:
 		case upload_datapoint_file_metrics_binary:
+		case upload_datapoint_file_metrics_local:
+		case upload_datapoint_file_metrics_child:
 			if (write_string(fd, REQ_TAG_DP_FILE_REQUEST)						/* The request type */
 				|| write_uint32(fd, type)							/* CSV data or binary data*/
 				|| write_blob(fd, data.blob.data, data.blob.length)				/* Data */
 				|| (data.blob.stream_id != NULL && write_string(fd, data.blob.stream_id))	/* Stream id, only for binary data */
+				|| (data.blob.child_id != NULL && write_string(fd, data.blob.child_id))	/* Child id, only for child data */
 				|| write_uint32(fd, upload_datapoint_file_terminate)) {				/* End of message */
 				log_dp_error("Could not send data points request to CCCSD: %s (%d)",
 					strerror(errno), errno);
@@ -141,7 +188,9 @@ static cccs_comm_error_t send_dp_data_type(int fd, upload_datapoint_file_t type,
  * @type:	Type of the data to upload: 'upload_datapoint_file_metrics' or
  *		'upload_datapoint_file_path_metrics' or
  *		'upload_datapoint_file_metrics_binary' or
- *		'upload_datapoint_file_path_binary'.
+ *		'upload_datapoint_file_path_binary' or
+ *		'upload_datapoint_file_metrics_local' or
+ *		'upload_datapoint_file_metrics_child'.
  * @data:	Data points data to send.
  * @timeout:	Number of seconds to wait for a response from the daemon.
  * @resp:	Received response from CCCS daemon.
@@ -166,7 +215,9 @@ static cccs_comm_error_t send_dp_data(upload_datapoint_file_t type, cccs_dp_data
 	if (type != upload_datapoint_file_metrics
 		&& type != upload_datapoint_file_path_metrics
 		&& type != upload_datapoint_file_path_binary
-		&& type != upload_datapoint_file_metrics_binary) {
+		&& type != upload_datapoint_file_metrics_binary
+		&& type != upload_datapoint_file_metrics_local
+		&& type != upload_datapoint_file_metrics_child) {
 		log_dp_error("%s", "Invalid upload type");
 		ret = CCCS_SEND_ERROR_INVALID_ARGUMENT;
 		goto done;
@@ -175,6 +226,7 @@ static cccs_comm_error_t send_dp_data(upload_datapoint_file_t type, cccs_dp_data
 	switch (type) {
 		/* CSV buffer */
 		case upload_datapoint_file_metrics:
+		case upload_datapoint_file_metrics_local:
 			if (!data.blob.data)
 				log_dp_error("%s", "Unable to upload NULL");
 			if (!data.blob.length)
@@ -184,6 +236,20 @@ static cccs_comm_error_t send_dp_data(upload_datapoint_file_t type, cccs_dp_data
 				goto done;
 			}
 			break;
+		/* CSV buffer of a child device */
+		case upload_datapoint_file_metrics_child:
+			if (!data.blob.data)
+				log_dp_error("%s", "Unable to upload NULL");
+			if (!data.blob.length)
+				log_dp_error("%s", "Number of bytes to upload must be greater than 0");
+			if (!data.blob.child_id || *data.blob.child_id == '\0')
+				log_dp_error("%s", "Child device identifier must be defined");
+			if (!data.blob.data || !data.blob.length
+				|| !data.blob.child_id || *data.blob.child_id == '\0') {
+				ret = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+				goto done;
+			}
+			break;
 		/* CSV file */
 		case upload_datapoint_file_path_metrics:
 			if (!data.file.path || *data.file.path == '\0') {
@@ -275,6 +341,150 @@ cccs_comm_error_t cccs_send_dp_csv_file(const char *path, unsigned long const ti
 	return ret;
 }
 
+/*
+ * init_staging() - Initialize the staging slots
+ */
+static void init_staging(void)
+{
+	int i;
+
+	for (i = 0; i < DP_STAGING_SLOTS; i++)
+		pthread_rwlock_init(&dp_staging[i].streams_lock, NULL);
+}
+
+/*
+ * get_staging() - Get the staging area of a data point collection
+ *
+ * @collection:	The data point collection.
+ *
+ * Return: The staging area, NULL if the collection does not have one.
+ */
+static dp_staging_t *get_staging(cccs_dp_collection_t const * const collection)
+{
+	int i;
+
+	if (!collection)
+		return NULL;
+
+	for (i = 0; i < DP_STAGING_SLOTS; i++) {
+		if (__atomic_load_n(&dp_staging[i].collection, __ATOMIC_ACQUIRE) == collection)
+			return &dp_staging[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * staging_owned() - Check if a staging area still belongs to a collection
+ *
+ * @staging:	The staging area.
+ * @collection:	The data point collection.
+ *
+ * The slot is released when its collection is destroyed and can be claimed
+ * by a new one, so it must be checked again once its lock is held.
+ *
+ * Return: True if the staging area is assigned to the collection.
+ */
+static bool staging_owned(dp_staging_t * const staging,
+	cccs_dp_collection_t const * const collection)
+{
+	return __atomic_load_n(&staging->collection, __ATOMIC_ACQUIRE) == collection;
+}
+
+/*
+ * claim_staging() - Assign a staging area to a data point collection
+ *
+ * @collection:	The data point collection.
+ *
+ * If all slots are in use, data points added to the collection are linked to
+ * their data streams holding the collection lock.
+ */
+static void claim_staging(cccs_dp_collection_t * const collection)
+{
+	int i;
+
+	pthread_once(&dp_staging_once, init_staging);
+
+	for (i = 0; i < DP_STAGING_SLOTS; i++) {
+		cccs_dp_collection_t *expected = NULL;
+
+		if (__atomic_compare_exchange_n(&dp_staging[i].collection, &expected,
+				collection, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return;
+	}
+
+	log_dp_debug("No staging area available for collection %p", (void *)collection);
+}
+
+/*
+ * link_staged_data_points() - Link staged data points to their data streams
+ *
+ * @collection:	The data point collection.
+ *
+ * The collection lock must be held.
+ */
+static void link_staged_data_points(cccs_dp_collection_t * const collection)
+{
+	dp_staging_t *staging = get_staging(collection);
+	dp_staged_t *staged, *oldest = NULL;
+
+	if (!staging)
+		return;
+
+	staged = __atomic_exchange_n(&staging->head, NULL, __ATOMIC_ACQUIRE);
+
+	/* Reverse the list to link them in the order they were added */
+	while (staged) {
+		dp_staged_t *next = staged->next;
+
+		staged->next = oldest;
+		oldest = staged;
+		staged = next;
+	}
+
+	while (oldest) {
+		connector_data_stream_t *ds = oldest->data_stream->ccfsm_data_stream;
+		dp_staged_t *next = oldest->next;
+
+		oldest->dp.next = ds->point;
+		ds->point = &oldest->dp;
+		collection->dp_count += 1;
+		oldest = next;
+	}
+}
+
+/*
+ * flush_staged_data_points() - Link staged data points before a ccapi operation
+ *
+ * @collection:	The data point collection.
+ *
+ * ccapi functions take the collection lock, so it is released before
+ * returning.
+ *
+ * Return: CCCS_DP_ERROR_NONE if success, CCCS_DP_ERROR_LOCK_FAILED otherwise.
+ */
+static cccs_dp_error_t flush_staged_data_points(cccs_dp_collection_t * const collection)
+{
+	if (!get_staging(collection))
+		return CCCS_DP_ERROR_NONE;
+
+	if (lock_acquire(collection->lock) != 0) {
+		log_dp_error("Data point collection %s", "busy");
+
+		return CCCS_DP_ERROR_LOCK_FAILED;
+	}
+
+	link_staged_data_points(collection);
+
+	if (lock_release(collection->lock) != 0) {
+		log_dp_error("Data point collection %s", "busy");
+
+		return CCCS_DP_ERROR_LOCK_FAILED;
+	}
+
+	return CCCS_DP_ERROR_NONE;
+}
+
 /*
  * dp_free_data_point() - Free the provided data point
  *
@@ -320,6 +530,12 @@ static void dp_free_data_point(connector_data_point_t * data_point, connector_da
  * dp_send_collection() - Send data point collection to CCCS daemon
  *
  * @collection:	Data point collection to send.
+ * @type:	'upload_datapoint_file_metrics' to upload the data points,
+ *		'upload_datapoint_file_metrics_local' to only deliver them to
+ *		the local subscribers or 'upload_datapoint_file_metrics_child'
+ *		to upload them as data points of a child device.
+ * @child_id:	Identifier of the child device, only for
+ *		'upload_datapoint_file_metrics_child'.
  * @timeout:	Number of seconds to wait for a response from the daemon.
  * @resp:	Received response from CCCS daemon.
  *
@@ -330,6 +546,7 @@ static void dp_free_data_point(connector_data_point_t * data_point, connector_da
  *         communication with the daemon fails.
  */
 static cccs_comm_error_t dp_send_collection(cccs_dp_collection_t * const collection,
+	upload_datapoint_file_t type, char const * const child_id,
 	unsigned long const timeout, cccs_resp_t *resp)
 {
 	cccs_comm_error_t ret = CCCS_SEND_ERROR_NONE;
@@ -358,15 +575,20 @@ static cccs_comm_error_t dp_send_collection(cccs_dp_collection_t * const collect
 	}
 	collection_lock_acquired = true;
 
+	link_staged_data_points(collection);
+
 	if (dp_generate_csv_from_collection(collection, &buf_info, DP_MAX_NUMBER_PER_REQUEST, &dp_to_rm) > 0) {
 		cccs_dp_data_t data_to_send = {
 			.blob.data = buf_info.buffer,
 			.blob.length = buf_info.bytes_written,
+			.blob.child_id = child_id,
 		};
 
-		ret = send_dp_data(upload_datapoint_file_metrics, data_to_send, timeout, resp);
-		if (ret == CCCS_SEND_ERROR_NONE || resp->code != CCCS_SEND_ERROR_UNABLE_TO_STORE_DP)
-			/* Remove only sent or stored data points from collection */
+		ret = send_dp_data(type, data_to_send, timeout, resp);
+		if (ret == CCCS_SEND_ERROR_NONE
+			|| (resp->code != CCCS_SEND_ERROR_UNABLE_TO_STORE_DP
+				&& resp->code != CCCS_SEND_ERROR_BUSY))
+			/* Remove only sent or stored data points, keep them to retry if daemon is busy */
 			dp_remove_from_collection(collection, dp_to_rm);
 	} else {
 		ret = CCCS_SEND_ERROR_INVALID_ARGUMENT;
@@ -386,13 +608,36 @@ static cccs_comm_error_t dp_send_collection(cccs_dp_collection_t * const collect
 
 cccs_comm_error_t cccs_send_dp_collection(cccs_dp_collection_t *const collection, cccs_resp_t *resp)
 {
-	return dp_send_collection(collection, CCCS_DP_WAIT_FOREVER, resp);
+	return dp_send_collection(collection, upload_datapoint_file_metrics, NULL, CCCS_DP_WAIT_FOREVER, resp);
 }
 
 cccs_comm_error_t cccs_send_dp_collection_tout(cccs_dp_collection_t *const collection,
 	unsigned long const timeout, cccs_resp_t *resp)
 {
-	return dp_send_collection(collection, timeout, resp);
+	return dp_send_collection(collection, upload_datapoint_file_metrics, NULL, timeout, resp);
+}
+
+cccs_comm_error_t cccs_publish_dp_collection(cccs_dp_collection_t *const collection, cccs_resp_t *resp)
+{
+	return dp_send_collection(collection, upload_datapoint_file_metrics_local, NULL, CCCS_DP_WAIT_FOREVER, resp);
+}
+
+cccs_comm_error_t cccs_publish_dp_collection_tout(cccs_dp_collection_t *const collection,
+	unsigned long const timeout, cccs_resp_t *resp)
+{
+	return dp_send_collection(collection, upload_datapoint_file_metrics_local, NULL, timeout, resp);
+}
+
+cccs_comm_error_t cccs_gw_send_dp_collection(char const * const child_id,
+	cccs_dp_collection_t *const collection, cccs_resp_t *resp)
+{
+	return dp_send_collection(collection, upload_datapoint_file_metrics_child, child_id, CCCS_DP_WAIT_FOREVER, resp);
+}
+
+cccs_comm_error_t cccs_gw_send_dp_collection_tout(char const * const child_id,
+	cccs_dp_collection_t *const collection, unsigned long const timeout, cccs_resp_t *resp)
+{
+	return dp_send_collection(collection, upload_datapoint_file_metrics_child, child_id, timeout, resp);
 }
 
 cccs_comm_error_t cccs_send_dp_binary_file(char const * const path,
@@ -441,17 +686,49 @@ cccs_comm_error_t cccs_send_binary_dp_tout(char const * const stream_id,
 
 cccs_dp_error_t cccs_dp_create_collection(cccs_dp_collection_handle_t *const collection)
 {
-	return (cccs_dp_error_t) ccapi_dp_create_collection(collection);
+	cccs_dp_error_t ret = (cccs_dp_error_t) ccapi_dp_create_collection(collection);
+
+	if (ret == CCCS_DP_ERROR_NONE)
+		claim_staging(*collection);
+
+	return ret;
 }
 
 cccs_dp_error_t cccs_dp_clear_collection(cccs_dp_collection_handle_t const collection)
 {
+	cccs_dp_error_t ret = flush_staged_data_points(collection);
+
+	if (ret != CCCS_DP_ERROR_NONE)
+		return ret;
+
 	return (cccs_dp_error_t) ccapi_dp_clear_collection(collection);
 }
 
 cccs_dp_error_t cccs_dp_destroy_collection(cccs_dp_collection_handle_t const collection)
 {
-	return (cccs_dp_error_t)ccapi_dp_destroy_collection(collection);
+	dp_staging_t *staging = get_staging(collection);
+	cccs_dp_error_t ret;
+
+	if (!staging)
+		return (cccs_dp_error_t)ccapi_dp_destroy_collection(collection);
+
+	pthread_rwlock_wrlock(&staging->streams_lock);
+
+	if (!staging_owned(staging, collection)) {
+		ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
+		goto done;
+	}
+
+	ret = flush_staged_data_points(collection);
+	if (ret == CCCS_DP_ERROR_NONE)
+		ret = (cccs_dp_error_t)ccapi_dp_destroy_collection(collection);
+	if (ret == CCCS_DP_ERROR_NONE)
+		__atomic_store_n(&staging->collection, NULL, __ATOMIC_RELEASE);
+
+done:
+	pthread_rwlock_unlock(&staging->streams_lock);
+
+	return ret;
 }
 
 cccs_dp_error_t cccs_dp_add_data_stream_to_collection(
@@ -497,6 +774,7 @@ cccs_dp_error_t cccs_dp_add_data_stream_to_collection_extra(
 	char const * const units,
 	char const * const forward_to)
 {
+	dp_staging_t *staging = get_staging(collection);
 	cccs_dp_error_t ret;
 	char *new_fs = NULL;
 
@@ -534,7 +812,16 @@ cccs_dp_error_t cccs_dp_add_data_stream_to_collection_extra(
 	if (!new_fs)
 		new_fs = (char *)format_string;
 
-	ret = (cccs_dp_error_t) ccapi_dp_add_data_stream_to_collection_extra(collection, stream_id, new_fs, units, forward_to);
+	if (staging)
+		pthread_rwlock_wrlock(&staging->streams_lock);
+
+	if (staging && !staging_owned(staging, collection))
+		ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
+	else
+		ret = (cccs_dp_error_t) ccapi_dp_add_data_stream_to_collection_extra(collection, stream_id, new_fs, units, forward_to);
+
+	if (staging)
+		pthread_rwlock_unlock(&staging->streams_lock);
 
 	if (new_fs != format_string)
 		free(new_fs);
@@ -546,13 +833,36 @@ cccs_dp_error_t cccs_dp_remove_data_stream_from_collection(
 	cccs_dp_collection_handle_t const collection,
 	char const * const stream_id)
 {
-	return (cccs_dp_error_t) ccapi_dp_remove_data_stream_from_collection(collection, stream_id);
+	dp_staging_t *staging = get_staging(collection);
+	cccs_dp_error_t ret;
+
+	if (!staging)
+		return (cccs_dp_error_t) ccapi_dp_remove_data_stream_from_collection(collection, stream_id);
+
+	/* Staged data points of the stream are released with it */
+	pthread_rwlock_wrlock(&staging->streams_lock);
+
+	if (!staging_owned(staging, collection))
+		ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
+	else
+		ret = flush_staged_data_points(collection);
+	if (ret == CCCS_DP_ERROR_NONE)
+		ret = (cccs_dp_error_t) ccapi_dp_remove_data_stream_from_collection(collection, stream_id);
+
+	pthread_rwlock_unlock(&staging->streams_lock);
+
+	return ret;
 }
 
 cccs_dp_error_t cccs_dp_get_collection_points_count(
 	cccs_dp_collection_handle_t const collection,
 	uint32_t * const count)
 {
+	cccs_dp_error_t ret = flush_staged_data_points(collection);
+
+	if (ret != CCCS_DP_ERROR_NONE)
+		return ret;
+
 	return (cccs_dp_error_t) ccapi_dp_get_collection_points_count(collection, count);
 }
 
@@ -575,20 +885,24 @@ done:
 
 static cccs_dp_error_t parse_arg_list_and_create_dp(
 	/*int n_args, */va_list *arg_list, cccs_dp_data_stream_t * const data_stream,
-	connector_data_point_t * * const new_data_point)
+	dp_staged_t * * const new_data_point)
 {
 	cccs_dp_argument_t * const arg = data_stream->arguments.list;
 	int const fmt_count = data_stream->arguments.count;
-	connector_data_point_t *datapoint = calloc(1, sizeof (*datapoint));
+	dp_staged_t *staged = calloc(1, sizeof (*staged));
+	connector_data_point_t *datapoint = NULL;
 	cccs_dp_error_t ret = CCCS_DP_ERROR_NONE;
 	int i;
 	va_list arg_list_copy;
 
-	if (!datapoint) {
+	if (!staged) {
 		ret = CCCS_DP_ERROR_INSUFFICIENT_MEMORY;
 		goto done;
 	}
 
+	staged->data_stream = data_stream;
+	datapoint = &staged->dp;
+
 	datapoint->data.type = connector_data_type_native;
 	datapoint->quality.type = connector_quality_type_ignore;
 	datapoint->location.type = connector_location_type_ignore;
@@ -638,55 +952,43 @@ static cccs_dp_error_t parse_arg_list_and_create_dp(
 				}
 			case CCCS_DP_ARG_TS_EPOCH:
 				{
-					ccapi_timestamp_t *timestamp = get_timestamp_by_type(CCCS_TS_EPOCH);
+					ccapi_timestamp_t timestamp;
 
-					if (!timestamp) {
+					if (fill_timestamp_by_type(&timestamp, CCCS_TS_EPOCH) != 0) {
 						ret = CCCS_DP_ERROR_INSUFFICIENT_MEMORY;
 						goto done;
 					}
 
 					datapoint->time.source = connector_time_local_epoch_fractional;
-					datapoint->time.value.since_epoch_fractional.seconds = timestamp->epoch.seconds;
-					datapoint->time.value.since_epoch_fractional.milliseconds = timestamp->epoch.milliseconds;
-
-					/*if (i == n_args)
-						free_timestamp(timestamp);*/
-					free_timestamp_by_type(timestamp, CCCS_TS_EPOCH);
+					datapoint->time.value.since_epoch_fractional.seconds = timestamp.epoch.seconds;
+					datapoint->time.value.since_epoch_fractional.milliseconds = timestamp.epoch.milliseconds;
 					break;
 				}
 			case CCCS_DP_ARG_TS_EPOCH_MS:
 				{
-					ccapi_timestamp_t *timestamp = get_timestamp_by_type(CCCS_TS_EPOCH_MS);
+					ccapi_timestamp_t timestamp;
 
-					if (!timestamp) {
+					if (fill_timestamp_by_type(&timestamp, CCCS_TS_EPOCH_MS) != 0) {
 						ret = CCCS_DP_ERROR_INSUFFICIENT_MEMORY;
 						goto done;
 					}
 
 					datapoint->time.source = connector_time_local_epoch_whole;
-					datapoint->time.value.since_epoch_whole.milliseconds = timestamp->epoch_msec;
-
-					free_timestamp_by_type(timestamp, CCCS_TS_EPOCH_MS);
+					datapoint->time.value.since_epoch_whole.milliseconds = timestamp.epoch_msec;
 					break;
 				}
 			case CCCS_DP_ARG_TS_ISO8601:
 				{
-					ccapi_timestamp_t *timestamp = get_timestamp_by_type(CCCS_TS_ISO8601);
+					ccapi_timestamp_t timestamp;
 
-					if (!timestamp) {
+					if (fill_timestamp_by_type(&timestamp, CCCS_TS_ISO8601) != 0) {
 						ret = CCCS_DP_ERROR_INSUFFICIENT_MEMORY;
 						goto done;
 					}
 
+					/* The data point takes the ownership of the string */
 					datapoint->time.source = connector_time_local_iso8601;
-					datapoint->time.value.iso8601_string = strdup(timestamp->iso8601);
-					if (datapoint->time.value.iso8601_string == NULL)
-						ret = CCCS_DP_ERROR_INSUFFICIENT_MEMORY;
-
-					free_timestamp_by_type(timestamp, CCCS_TS_EPOCH_MS);
-
-					if (ret != CCCS_DP_ERROR_NONE)
-						goto done;
+					datapoint->time.value.iso8601_string = (char *)timestamp.iso8601;
 					break;
 				}
 			case CCCS_DP_ARG_LOCATION:
@@ -713,58 +1015,111 @@ static cccs_dp_error_t parse_arg_list_and_create_dp(
 		}
 	}
 done:
-	if (datapoint && ret != CCCS_DP_ERROR_NONE) {
+	if (staged && ret != CCCS_DP_ERROR_NONE) {
 		free(datapoint->data.element.native.string_value);
 		free(datapoint->time.value.iso8601_string);
-		free(datapoint);
-		datapoint = NULL;
+		free(staged);
+		staged = NULL;
 	}
 
 	va_end(arg_list_copy);
 
-	*new_data_point = datapoint;
+	*new_data_point = staged;
 
 	return ret;
 }
 
-cccs_dp_error_t cccs_dp_add(cccs_dp_collection_handle_t const collection, char const * const stream_id, ...)
+/*
+ * stage_dp() - Add a data point to the staging area of a collection
+ *
+ * @staging:	The staging area of the collection.
+ * @collection:	The collection with the data stream.
+ * @stream_id:	The name of the data stream.
+ * @arg_list:	Data point attributes.
+ *
+ * Return: CCCS_DP_ERROR_NONE if success, any other error if it fails.
+ */
+static cccs_dp_error_t stage_dp(dp_staging_t * const staging,
+	cccs_dp_collection_t const * const collection,
+	char const * const stream_id, va_list *arg_list)
 {
 	cccs_dp_error_t ret = CCCS_DP_ERROR_NONE;
 	cccs_dp_data_stream_t *data_stream;
+	dp_staged_t *staged = NULL;
 
-	if (!collection)
-		return CCCS_DP_ERROR_INVALID_ARGUMENT;
-
-	if (lock_acquire(collection->lock) != 0) {
+	if (pthread_rwlock_rdlock(&staging->streams_lock) != 0) {
 		log_dp_error("Data point collection %s", "busy");
 
 		return CCCS_DP_ERROR_LOCK_FAILED;
 	}
 
-	data_stream = find_stream_id_in_collection(collection, stream_id);
+	/* The collection may have been destroyed while getting its staging area */
+	if (!staging_owned(staging, collection)) {
+		ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
+		goto done;
+	}
+
+	data_stream = find_stream_id_in_collection(staging->collection, stream_id);
 	if (!data_stream) {
 		ret = CCCS_DP_ERROR_INVALID_STREAM_ID;
 		goto done;
 	}
 
-	{
-		connector_data_point_t *datapoint = NULL;
-		va_list arg_list;
+	ret = parse_arg_list_and_create_dp(arg_list, data_stream, &staged);
+	if (ret == CCCS_DP_ERROR_NONE && !staged)
+		ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
 
-		va_start(arg_list, stream_id);
-		ret = parse_arg_list_and_create_dp(&arg_list, data_stream, &datapoint);
-		va_end(arg_list);
+	if (ret != CCCS_DP_ERROR_NONE)
+		goto done;
 
-		if (ret == CCCS_DP_ERROR_NONE && !datapoint)
-			ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
+	staged->next = __atomic_load_n(&staging->head, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&staging->head, &staged->next, staged,
+			true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+done:
+	pthread_rwlock_unlock(&staging->streams_lock);
 
-		if (ret != CCCS_DP_ERROR_NONE)
-			goto done;
+	return ret;
+}
 
-		datapoint->next = data_stream->ccfsm_data_stream->point;
-		data_stream->ccfsm_data_stream->point = datapoint;
-		collection->dp_count += 1;
+/*
+ * add_dp() - Add a data point to a collection holding its lock
+ *
+ * @collection:	The collection with the data stream.
+ * @stream_id:	The name of the data stream.
+ * @arg_list:	Data point attributes.
+ *
+ * Return: CCCS_DP_ERROR_NONE if success, any other error if it fails.
+ */
+static cccs_dp_error_t add_dp(cccs_dp_collection_t * const collection,
+	char const * const stream_id, va_list *arg_list)
+{
+	cccs_dp_error_t ret = CCCS_DP_ERROR_NONE;
+	cccs_dp_data_stream_t *data_stream;
+	dp_staged_t *staged = NULL;
+
+	if (lock_acquire(collection->lock) != 0) {
+		log_dp_error("Data point collection %s", "busy");
+
+		return CCCS_DP_ERROR_LOCK_FAILED;
 	}
+
+	data_stream = find_stream_id_in_collection(collection, stream_id);
+	if (!data_stream) {
+		ret = CCCS_DP_ERROR_INVALID_STREAM_ID;
+		goto done;
+	}
+
+	ret = parse_arg_list_and_create_dp(arg_list, data_stream, &staged);
+	if (ret == CCCS_DP_ERROR_NONE && !staged)
+		ret = CCCS_DP_ERROR_INVALID_ARGUMENT;
+
+	if (ret != CCCS_DP_ERROR_NONE)
+		goto done;
+
+	staged->dp.next = data_stream->ccfsm_data_stream->point;
+	data_stream->ccfsm_data_stream->point = &staged->dp;
+	collection->dp_count += 1;
 done:
 	if (lock_release(collection->lock) != 0) {
 		if (ret == CCCS_DP_ERROR_NONE)
@@ -775,8 +1130,34 @@ done:
 	return ret;
 }
 
+cccs_dp_error_t cccs_dp_add(cccs_dp_collection_handle_t const collection, char const * const stream_id, ...)
+{
+	dp_staging_t *staging;
+	cccs_dp_error_t ret;
+	va_list arg_list;
+
+	if (!collection)
+		return CCCS_DP_ERROR_INVALID_ARGUMENT;
+
+	staging = get_staging(collection);
+
+	va_start(arg_list, stream_id);
+	if (staging)
+		ret = stage_dp(staging, collection, stream_id, &arg_list);
+	else
+		ret = add_dp(collection, stream_id, &arg_list);
+	va_end(arg_list);
+
+	return ret;
+}
+
 cccs_dp_error_t cccs_dp_remove_older_data_point_from_streams(cccs_dp_collection_handle_t const collection)
 {
+	cccs_dp_error_t ret = flush_staged_data_points(collection);
+
+	if (ret != CCCS_DP_ERROR_NONE)
+		return ret;
+
 	return (cccs_dp_error_t) ccapi_dp_remove_older_data_point_from_streams(collection);
 }
 
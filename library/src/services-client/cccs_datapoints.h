@@ -75,6 +75,37 @@ typedef struct {
 
 typedef struct ccapi_dp_collection *cccs_dp_collection_handle_t;
 
+/**
+ * struct cccs_local_dp_t - Data point received from a subscription
+ *
+ * @stream_id:		Stream id of the data point.
+ * @value:		Value of the data point.
+ * @type:		Type of the data point: INTEGER, LONG, FLOAT, DOUBLE,
+ *			STRING, JSON or GEOJSON.
+ * @units:		Units of the data point, empty if not defined.
+ * @timestamp:		Milliseconds since the epoch or ISO 8601 timestamp,
+ *			empty if not defined.
+ * @quality:		Quality of the data point, empty if not defined.
+ * @description:	Description of the data point, empty if not defined.
+ * @location:		Location as "lat,lon,alt", empty if not defined.
+ *
+ * All the fields are only valid during the subscription callback.
+ */
+typedef struct {
+	const char *stream_id;
+	const char *value;
+	const char *type;
+	const char *units;
+	const char *timestamp;
+	const char *quality;
+	const char *description;
+	const char *location;
+} cccs_local_dp_t;
+
+typedef struct cccs_dp_subscription cccs_dp_subscription_t;
+
+typedef void (*cccs_dp_subscriber_cb_t)(const cccs_local_dp_t *dp, void *user_data);
+
 
 /*
  * cccs_dp_create_collection() - Create a data point collection
@@ -226,6 +257,9 @@ cccs_dp_error_t cccs_dp_get_collection_points_count(
  *			'ccapi_dp_add_data_stream_to_collection()' or
  *			'cccs_dp_add_data_stream_to_collection_extra()'.
  *
+ * It can be called from several threads at the same time and it does not wait
+ * for an in-progress send of the collection.
+ *
  * Return: CCCS_SEND_ERROR_NONE if success, any other error if it fails.
  */
 cccs_dp_error_t cccs_dp_add(cccs_dp_collection_handle_t const collection, char const * const stream_id, ...);
@@ -319,6 +353,137 @@ cccs_comm_error_t cccs_send_dp_collection(cccs_dp_collection_handle_t const coll
 cccs_comm_error_t cccs_send_dp_collection_tout(cccs_dp_collection_handle_t const collection,
 	unsigned long const timeout, cccs_resp_t *resp);
 
+/*
+ * cccs_publish_dp_collection() - Deliver provided data point collection to local subscribers
+ *
+ * @collection:	Data point collection to publish.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Data points are only delivered to the applications subscribed with
+ * 'cccs_dp_subscribe()', they are not uploaded to Remote Manager.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_publish_dp_collection(cccs_dp_collection_handle_t const collection, cccs_resp_t *resp);
+
+/*
+ * cccs_publish_dp_collection_tout() - Deliver provided data point collection to local subscribers
+ *
+ * @collection:	Data point collection to publish.
+ * @timeout:	Number of seconds to wait for response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Data points are only delivered to the applications subscribed with
+ * 'cccs_dp_subscribe()', they are not uploaded to Remote Manager.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_publish_dp_collection_tout(cccs_dp_collection_handle_t const collection,
+	unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_send_dp_collection() - Send provided data point collection of a child device to CCCS daemon
+ *
+ * @child_id:	Identifier of the child device, registered with
+ *		'cccs_gw_register_child()'.
+ * @collection:	Data point collection to send to CCCS daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Data points are uploaded to the 'children/<child_id>/<stream_id>' data
+ * streams. If the child exceeds its upload rate, they are stored in its
+ * backlog and uploaded later.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_send_dp_collection(char const * const child_id,
+	cccs_dp_collection_handle_t const collection, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_send_dp_collection_tout() - Send provided data point collection of a child device to CCCS daemon
+ *
+ * @child_id:	Identifier of the child device, registered with
+ *		'cccs_gw_register_child()'.
+ * @collection:	Data point collection to send to CCCS daemon.
+ * @timeout:	Number of seconds to wait for response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Data points are uploaded to the 'children/<child_id>/<stream_id>' data
+ * streams. If the child exceeds its upload rate, they are stored in its
+ * backlog and uploaded later.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_send_dp_collection_tout(char const * const child_id,
+	cccs_dp_collection_handle_t const collection, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_dp_subscribe() - Subscribe to the data points handled by CCCS daemon
+ *
+ * @patterns:	Stream id patterns to subscribe to, shell wildcards are
+ *		allowed, for example "system_monitor/cpu_*".
+ * @n_patterns:	Number of patterns, up to 16.
+ * @queue_kb:	Size in kB of the daemon queue for this subscriber, 0 for the
+ *		default one (64 kB). When the subscriber does not keep up, the
+ *		oldest data points are dropped.
+ * @cb:		Callback executed for every received data point.
+ * @user_data:	User data to pass to the callback.
+ * @subscription: Created subscription, it must be freed with
+ *		'cccs_dp_unsubscribe()'.
+ * @timeout:	Number of seconds to wait for response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Subscribers receive the System Monitor samples, the data points uploaded
+ * or published by other applications as CSV, and the data requests received
+ * from Remote Manager as "data_request/<target>" STRING data points.
+ *
+ * The callback runs in a thread of the subscription.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_dp_subscribe(const char * const *patterns, unsigned int n_patterns,
+	unsigned int queue_kb, cccs_dp_subscriber_cb_t cb, void *user_data,
+	cccs_dp_subscription_t **subscription, unsigned long const timeout,
+	cccs_resp_t *resp);
+
+/*
+ * cccs_dp_subscription_dropped() - Get the data points dropped for a subscription
+ *
+ * @subscription:	Subscription.
+ *
+ * Return: Number of data points the daemon dropped because the subscriber
+ *         did not keep up.
+ */
+unsigned long long cccs_dp_subscription_dropped(cccs_dp_subscription_t *subscription);
+
+/*
+ * cccs_dp_unsubscribe() - Cancel a subscription and free it
+ *
+ * @subscription:	Subscription to cancel.
+ *
+ * It must not be called from the subscription callback.
+ */
+void cccs_dp_unsubscribe(cccs_dp_subscription_t *subscription);
+
 /*
  * cccs_send_dp_binary_file() - Send provided file as binary data point to CCCS daemon to be uploaded
  *
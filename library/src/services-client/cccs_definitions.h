@@ -34,6 +34,7 @@ typedef enum {
 	CCCS_SEND_ERROR_UNABLE_TO_STORE_DP,
 	CCCS_SEND_ERROR_CCAPI_ERROR,
 	CCCS_SEND_ERROR_SRV_ERROR,
+	CCCS_SEND_ERROR_BUSY,
 } cccs_comm_error_t;
 
 /**
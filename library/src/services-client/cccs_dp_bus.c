@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "_cccs_utils.h"
+#include "cc_logging.h"
+#include "cccs_datapoints.h"
+#include "dp_csv_parser.h"
+#include "service_common.h"
+#include "services_util.h"
+
+#define SERVICE_TAG	"BUS:"
+
+/*
+ * struct cccs_dp_subscription - Subscription to the daemon data points
+ *
+ * @fd:		Socket connected to the daemon.
+ * @cb:		Callback executed for every data point.
+ * @user_data:	User data to pass to the callback.
+ * @dropped:	Data points dropped by the daemon.
+ * @thread:	Thread reading the data points.
+ */
+struct cccs_dp_subscription {
+	int fd;
+	cccs_dp_subscriber_cb_t cb;
+	void *user_data;
+	unsigned long long dropped;
+	pthread_t thread;
+};
+
+/*
+ * deliver_records() - Execute the subscription callback for each CSV record
+ *
+ * @s:		Subscription.
+ * @csv:	Received records.
+ * @length:	Number of bytes of the records.
+ */
+static void deliver_records(cccs_dp_subscription_t *s, const char *csv, size_t length)
+{
+	char *out = malloc(length + 1);
+	size_t pos = 0;
+
+	if (!out) {
+		log_error("%s Unable to deliver data points: Out of memory", SERVICE_TAG);
+		return;
+	}
+
+	while (pos < length) {
+		size_t rec_len = dp_csv_record_length(csv + pos, length - pos);
+		char *fields[csv_finished];
+		cccs_local_dp_t dp;
+
+		if (dp_csv_parse_record(csv + pos, rec_len, out, fields) != 0) {
+			log_debug("%s Discarding malformed data point", SERVICE_TAG);
+			pos += rec_len;
+			continue;
+		}
+		pos += rec_len;
+
+		dp.stream_id = fields[csv_stream_id];
+		dp.value = fields[csv_data];
+		dp.type = fields[csv_type];
+		dp.units = fields[csv_unit];
+		dp.timestamp = fields[csv_time];
+		dp.quality = fields[csv_quality];
+		dp.description = fields[csv_description];
+		dp.location = fields[csv_location];
+
+		s->cb(&dp, s->user_data);
+	}
+
+	free(out);
+}
+
+/*
+ * subscription_threaded() - Read the data points of a subscription
+ *
+ * @arg:	Subscription.
+ *
+ * Each frame from the daemon is the number of data points dropped since the
+ * previous one followed by the data points as CSV records.
+ */
+static void *subscription_threaded(void *arg)
+{
+	cccs_dp_subscription_t *s = arg;
+
+	while (true) {
+		uint32_t dropped;
+		void *csv = NULL;
+		size_t length;
+
+		if (read_uint32(s->fd, &dropped, NULL) != 0
+			|| read_blob(s->fd, &csv, &length, NULL) != 0)
+			break;
+
+		if (dropped > 0)
+			__atomic_add_fetch(&s->dropped, dropped, __ATOMIC_RELAXED);
+
+		deliver_records(s, csv, length);
+		free(csv);
+	}
+
+	return NULL;
+}
+
+cccs_comm_error_t cccs_dp_subscribe(const char * const *patterns, unsigned int n_patterns,
+	unsigned int queue_kb, cccs_dp_subscriber_cb_t cb, void *user_data,
+	cccs_dp_subscription_t **subscription, unsigned long const timeout,
+	cccs_resp_t *resp)
+{
+	cccs_dp_subscription_t *s = NULL;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+	unsigned int i;
+	int error;
+
+	resp->hint = NULL;
+	resp->code = 0;
+
+	if (!patterns || n_patterns == 0 || !cb || !subscription) {
+		log_error("%s Invalid subscription", SERVICE_TAG);
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	*subscription = NULL;
+
+	s = calloc(1, sizeof(*s));
+	if (!s) {
+		log_error("%s Unable to subscribe: Out of memory", SERVICE_TAG);
+		resp->code = CCCS_SEND_ERROR_OUT_OF_MEMORY;
+
+		return CCCS_SEND_ERROR_OUT_OF_MEMORY;
+	}
+	s->cb = cb;
+	s->user_data = user_data;
+
+	s->fd = connect_cccsd();
+	if (s->fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	error = write_string(s->fd, REQ_TAG_DP_SUBSCRIBE)	/* The request type */
+		|| write_uint32(s->fd, queue_kb)		/* Queue size */
+		|| write_uint32(s->fd, n_patterns);		/* Number of patterns */
+	for (i = 0; !error && i < n_patterns; i++)
+		error = patterns[i] == NULL || write_string(s->fd, patterns[i]);	/* Pattern */
+	if (!error)
+		error = write_uint32(s->fd, 0);			/* End of message */
+
+	if (error) {
+		log_error("%s Could not subscribe: %s (%d)", SERVICE_TAG,
+			strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+		goto done;
+	}
+
+	ret = parse_cccsd_response(s->fd, &cccs_resp, timeout);
+	if (ret != CCCS_SEND_ERROR_NONE)
+		goto done;
+
+	error = pthread_create(&s->thread, NULL, subscription_threaded, s);
+	if (error) {
+		log_error("%s Unable to start subscription thread (%d)", SERVICE_TAG, error);
+		ret = CCCS_SEND_ERROR_OUT_OF_MEMORY;
+		cccs_resp.cccs_err = CCCS_SEND_ERROR_OUT_OF_MEMORY;
+		goto done;
+	}
+
+	*subscription = s;
+
+done:
+	if (*subscription == NULL) {
+		if (s->fd >= 0)
+			close(s->fd);
+		free(s);
+	}
+
+	resp->hint = cccs_resp.hint;
+
+	/* cccs_resp.cccs_err   ---> Error while reading command */
+	switch (cccs_resp.cccs_err) {
+		case CCCS_SEND_ERROR_NONE:
+			break;
+		/* cccs_resp.ccapi_err  ---> Error while sending data points/error from DRM */
+		case CCCS_SEND_ERROR_CCAPI_ERROR:
+			resp->code = cccs_resp.ccapi_err;
+			break;
+		/* cccs_resp.srv_err    ---> Error from DRM */
+		case CCCS_SEND_ERROR_SRV_ERROR:
+			resp->code = cccs_resp.srv_err;
+			break;
+		default:
+			resp->code = cccs_resp.cccs_err;
+			break;
+	}
+
+	return ret;
+}
+
+unsigned long long cccs_dp_subscription_dropped(cccs_dp_subscription_t *subscription)
+{
+	if (!subscription)
+		return 0;
+
+	return __atomic_load_n(&subscription->dropped, __ATOMIC_RELAXED);
+}
+
+void cccs_dp_unsubscribe(cccs_dp_subscription_t *subscription)
+{
+	if (!subscription)
+		return;
+
+	/* Unblock the subscription thread */
+	shutdown(subscription->fd, SHUT_RDWR);
+	pthread_join(subscription->thread, NULL);
+
+	close(subscription->fd);
+	free(subscription);
+}
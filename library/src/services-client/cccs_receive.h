@@ -125,4 +125,86 @@ cccs_comm_error_t cccs_remove_request_target(char const * const target, cccs_res
 cccs_comm_error_t cccs_remove_request_target_tout(char const * const target,
 	unsigned long timeout, cccs_resp_t *resp);
 
+/*
+ * cccs_gw_add_request_target() - Register a request target of a child device
+ *
+ * @child_id:	Identifier of the child device, registered with
+ *		'cccs_gw_register_child()'.
+ * @target:	Target name to register.
+ * @data_cb:	Callback function executed when a request for the provided
+ *		target is received.
+ * @status_cb:	Callback function executed when the receive process has completed.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The target is registered as 'child/<child_id>/<target>', the name the
+ * callbacks receive. Requests are rejected while the child is offline.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_add_request_target(char const * const child_id,
+	char const * const target, cccs_request_data_cb_t data_cb,
+	cccs_request_status_cb_t status_cb, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_add_request_target_tout() - Register a request target of a child device
+ *
+ * @child_id:	Identifier of the child device, registered with
+ *		'cccs_gw_register_child()'.
+ * @target:	Target name to register.
+ * @data_cb:	Callback function executed when a request for the provided
+ *		target is received.
+ * @status_cb:	Callback function executed when the receive process has completed.
+ * @timeout:	Number of seconds to wait for response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The target is registered as 'child/<child_id>/<target>', the name the
+ * callbacks receive. Requests are rejected while the child is offline.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_add_request_target_tout(char const * const child_id,
+	char const * const target, cccs_request_data_cb_t data_cb,
+	cccs_request_status_cb_t status_cb, unsigned long timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_remove_request_target() - Unregister a request target of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @target:	Target name to unregister.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_remove_request_target(char const * const child_id,
+	char const * const target, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_remove_request_target_tout() - Unregister a request target of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @target:	Target name to unregister.
+ * @timeout:	Number of seconds to wait for response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_remove_request_target_tout(char const * const child_id,
+	char const * const target, unsigned long timeout, cccs_resp_t *resp);
+
 #endif  /* _CCCS_RECEIVE_H_ */
@@ -18,6 +18,7 @@
  */
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,6 +40,11 @@
 
 #define CCCSD_TAG	"CCCSD:"
 
+/* Seconds between file upload status queries while waiting for it */
+#define FILE_UPLOAD_POLL_INTERVAL	1
+/* Seconds to wait for the daemon to report the status of an upload */
+#define FILE_UPLOAD_POLL_TIMEOUT	5
+
 /**
  * log_cccsd_debug() - Log the given message as debug
  *
@@ -377,3 +383,529 @@ done:
 
 	return ready;
 }
+
+cccs_comm_error_t cccs_set_health_status(const char *const app, bool healthy, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	char *status_str = healthy ? "healthy" : "not healthy";
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	if (app == NULL || strlen(app) == 0) {
+		log_error("%s", "Invalid application name");
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	log_info("HEALTH: Setting '%s' status to '%s'", app, status_str);
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, REQ_TAG_HEALTH_REQUEST)	/* The request type */
+		|| write_string(fd, app)			/* Application name */
+		|| write_uint32(fd, healthy ? 1 : 0)	/* Health status */
+		|| write_uint32(fd, 0)) {		/* End of message */
+		log_error("HEALTH: Could not set '%s' status to '%s': %s (%d)",
+			app, status_str, strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+	}
+
+	close(fd);
+done:
+	resp->hint = cccs_resp.hint;
+	resp->code = 0;
+
+	/* cccs_resp.cccs_err   ---> Error while reading command */
+	switch (cccs_resp.cccs_err) {
+		case CCCS_SEND_ERROR_NONE:
+			break;
+		/* cccs_resp.ccapi_err  ---> Error from the daemon */
+		case CCCS_SEND_ERROR_CCAPI_ERROR:
+			resp->code = cccs_resp.ccapi_err;
+			break;
+		/* cccs_resp.srv_err    ---> Error from DRM */
+		case CCCS_SEND_ERROR_SRV_ERROR:
+			resp->code = cccs_resp.srv_err;
+			break;
+		default:
+			resp->code = cccs_resp.cccs_err;
+			break;
+	}
+
+	return ret;
+}
+
+/*
+ * fill_response() - Fill the client response with the daemon response
+ *
+ * @cccs_resp:	Response from CCCS daemon.
+ * @resp:	Response to fill.
+ */
+static void fill_response(cccs_srv_resp_t *cccs_resp, cccs_resp_t *resp)
+{
+	resp->hint = cccs_resp->hint;
+	resp->code = 0;
+
+	/* cccs_resp->cccs_err   ---> Error while reading command */
+	switch (cccs_resp->cccs_err) {
+		case CCCS_SEND_ERROR_NONE:
+			break;
+		/* cccs_resp->ccapi_err  ---> Error from the daemon */
+		case CCCS_SEND_ERROR_CCAPI_ERROR:
+			resp->code = cccs_resp->ccapi_err;
+			break;
+		/* cccs_resp->srv_err    ---> Error from DRM */
+		case CCCS_SEND_ERROR_SRV_ERROR:
+			resp->code = cccs_resp->srv_err;
+			break;
+		default:
+			resp->code = cccs_resp->cccs_err;
+			break;
+	}
+}
+
+/*
+ * read_resp_values() - Read the values that follow a successful response
+ *
+ * @fd:		Socket to read from.
+ * @values:	Array to store the values.
+ * @n_values:	Number of values to read.
+ * @timeout:	Number of seconds to wait for the reading.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error otherwise.
+ */
+static cccs_comm_error_t read_resp_values(int fd, uint32_t *values, int n_values, unsigned long timeout)
+{
+	struct timeval timeout_val = {
+		.tv_sec = timeout,
+		.tv_usec = 0
+	};
+	int i;
+
+	for (i = 0; i < n_values; i++) {
+		if (read_error(fd, &values[i], timeout > 0 ? &timeout_val : NULL, "response value ") != 0)
+			return CCCS_SEND_ERROR_BAD_RESPONSE;
+	}
+
+	return CCCS_SEND_ERROR_NONE;
+}
+
+/*
+ * read_resp_time() - Read a time value that follows a successful response
+ *
+ * @fd:		Socket to read from.
+ * @value:	Pointer to store the time.
+ * @timeout:	Number of seconds to wait for the reading.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error otherwise.
+ */
+static cccs_comm_error_t read_resp_time(int fd, time_t *value, unsigned long timeout)
+{
+	struct timeval timeout_val = {
+		.tv_sec = timeout,
+		.tv_usec = 0
+	};
+	uint64_t t;
+
+	if (read_uint64(fd, &t, timeout > 0 ? &timeout_val : NULL) != 0) {
+		log_cccsd_error("Bad response, failed to read %sfrom CCCSD", "response time ");
+		return CCCS_SEND_ERROR_BAD_RESPONSE;
+	}
+
+	*value = (time_t) t;
+
+	return CCCS_SEND_ERROR_NONE;
+}
+
+cccs_comm_error_t cccs_get_fw_update_status(cccs_fw_update_status_t *status, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	uint32_t values[3] = {0};
+	time_t apply_time = 0;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, REQ_TAG_FW_UPDATE_STATUS)	/* The request type */
+		|| write_uint32(fd, 0)) {		/* End of message */
+		log_error("FW UPDATE: Could not get pending update status: %s (%d)",
+			strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+		if (ret == CCCS_SEND_ERROR_NONE) {
+			/* Action, imminent, apply time, postpone left */
+			ret = read_resp_values(fd, values, 2, timeout);
+			if (ret == CCCS_SEND_ERROR_NONE)
+				ret = read_resp_time(fd, &apply_time, timeout);
+			if (ret == CCCS_SEND_ERROR_NONE)
+				ret = read_resp_values(fd, &values[2], 1, timeout);
+			cccs_resp.cccs_err = ret;
+		}
+	}
+
+	close(fd);
+
+	if (ret == CCCS_SEND_ERROR_NONE) {
+		status->action = values[0];
+		status->imminent = values[1] != 0;
+		status->apply_time = apply_time;
+		status->postpone_left = values[2];
+	}
+done:
+	fill_response(&cccs_resp, resp);
+
+	return ret;
+}
+
+cccs_comm_error_t cccs_postpone_fw_update(unsigned long seconds, time_t *until, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	time_t value = 0;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	if (seconds == 0 || seconds > UINT32_MAX) {
+		log_error("%s", "Invalid postpone time");
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	log_info("FW UPDATE: Postponing pending update %lu seconds", seconds);
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, REQ_TAG_FW_UPDATE_POSTPONE)	/* The request type */
+		|| write_uint32(fd, seconds)		/* Seconds to postpone */
+		|| write_uint32(fd, 0)) {		/* End of message */
+		log_error("FW UPDATE: Could not postpone pending update: %s (%d)",
+			strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+		if (ret == CCCS_SEND_ERROR_NONE) {
+			/* Postponed until */
+			ret = read_resp_time(fd, &value, timeout);
+			cccs_resp.cccs_err = ret;
+		}
+	}
+
+	close(fd);
+
+	if (ret == CCCS_SEND_ERROR_NONE && until != NULL)
+		*until = value;
+done:
+	fill_response(&cccs_resp, resp);
+
+	return ret;
+}
+
+cccs_comm_error_t cccs_send_file(const char *local_path, const char *cloud_path, uint32_t *id, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	char *abs_path = NULL;
+	uint32_t value = 0;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	/* The daemon does not share the working directory of the application */
+	if (local_path != NULL)
+		abs_path = realpath(local_path, NULL);
+	if (abs_path == NULL || cloud_path == NULL || *cloud_path == '\0') {
+		log_error("UPLOAD: Invalid file to upload '%s'", local_path != NULL ? local_path : "");
+		free(abs_path);
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	log_info("UPLOAD: Queuing upload of '%s' to '%s'", abs_path, cloud_path);
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, REQ_TAG_FILE_UPLOAD)	/* The request type */
+		|| write_string(fd, abs_path)		/* Local path */
+		|| write_string(fd, cloud_path)		/* Cloud path */
+		|| write_uint32(fd, 0)) {		/* End of message */
+		log_error("UPLOAD: Could not queue upload of '%s': %s (%d)",
+			abs_path, strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+		if (ret == CCCS_SEND_ERROR_NONE) {
+			/* Upload identifier */
+			ret = read_resp_values(fd, &value, 1, timeout);
+			cccs_resp.cccs_err = ret;
+		}
+	}
+
+	close(fd);
+
+	if (ret == CCCS_SEND_ERROR_NONE && id != NULL)
+		*id = value;
+done:
+	free(abs_path);
+	fill_response(&cccs_resp, resp);
+
+	return ret;
+}
+
+cccs_comm_error_t cccs_get_file_upload_status(uint32_t id, cccs_file_upload_status_t *status, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	uint32_t values[5] = {0};
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, REQ_TAG_FILE_UPLOAD_STATUS)	/* The request type */
+		|| write_uint32(fd, id)			/* Upload identifier */
+		|| write_uint32(fd, 0)) {		/* End of message */
+		log_error("UPLOAD: Could not get status of upload %" PRIu32 ": %s (%d)",
+			id, strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+		if (ret == CCCS_SEND_ERROR_NONE) {
+			/* State, sent bytes and file size (high and low parts) */
+			ret = read_resp_values(fd, values, 5, timeout);
+			cccs_resp.cccs_err = ret;
+		}
+	}
+
+	close(fd);
+
+	if (ret == CCCS_SEND_ERROR_NONE) {
+		status->state = values[0];
+		status->sent = (uint64_t) values[1] << 32 | values[2];
+		status->size = (uint64_t) values[3] << 32 | values[4];
+	}
+done:
+	fill_response(&cccs_resp, resp);
+
+	return ret;
+}
+
+cccs_comm_error_t cccs_wait_file_upload(uint32_t id, cccs_file_upload_progress_cb_t progress_cb,
+	void *user_data, long timeout, cccs_file_upload_status_t *status, cccs_resp_t *resp)
+{
+	cccs_file_upload_status_t current, last = { .state = CCCS_FILE_UPLOAD_UNKNOWN, .sent = 0, .size = 0 };
+	time_t deadline = time(NULL) + timeout;
+	bool first = true;
+	cccs_comm_error_t ret;
+
+	while (true) {
+		ret = cccs_get_file_upload_status(id, &current, FILE_UPLOAD_POLL_TIMEOUT, resp);
+		if (ret != CCCS_SEND_ERROR_NONE)
+			return ret;
+
+		if (progress_cb != NULL && (first || current.state != last.state || current.sent != last.sent))
+			progress_cb(id, &current, user_data);
+		first = false;
+		last = current;
+
+		if (status != NULL)
+			*status = current;
+
+		if (current.state != CCCS_FILE_UPLOAD_QUEUED && current.state != CCCS_FILE_UPLOAD_UPLOADING)
+			return CCCS_SEND_ERROR_NONE;
+
+		if (timeout != CCCSD_WAIT_FOREVER && time(NULL) >= deadline) {
+			resp->code = CCCS_SEND_ERROR_READ_TIMEOUT;
+			return CCCS_SEND_ERROR_READ_TIMEOUT;
+		}
+
+		sleep(FILE_UPLOAD_POLL_INTERVAL);
+	}
+}
+
+cccs_comm_error_t cccs_twin_report(const char *ns, const char *patch, uint32_t *version, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	uint32_t value = 0;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	if (ns == NULL || *ns == '\0' || patch == NULL) {
+		log_error("TWIN: Invalid reported state for namespace '%s'", ns != NULL ? ns : "");
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	log_debug("TWIN: Reporting state of namespace '%s'", ns);
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, REQ_TAG_TWIN_REPORT)		/* The request type */
+		|| write_string(fd, ns)				/* Namespace */
+		|| write_blob(fd, patch, strlen(patch))		/* Reported state patch */
+		|| write_uint32(fd, 0)) {			/* End of message */
+		log_error("TWIN: Could not report state of namespace '%s': %s (%d)",
+			ns, strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+		if (ret == CCCS_SEND_ERROR_NONE) {
+			/* Reported version */
+			ret = read_resp_values(fd, &value, 1, timeout);
+			cccs_resp.cccs_err = ret;
+		}
+	}
+
+	close(fd);
+
+	if (ret == CCCS_SEND_ERROR_NONE && version != NULL)
+		*version = value;
+done:
+	fill_response(&cccs_resp, resp);
+
+	return ret;
+}
+
+/*
+ * send_gw_request() - Send a gateway request to CCCS daemon
+ *
+ * @tag:	Request type.
+ * @child_id:	Identifier of the child device.
+ * @type:	Type of the child device, NULL if not part of the request.
+ * @online:	Online state of the child, negative if not part of the request.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+static cccs_comm_error_t send_gw_request(const char *tag, const char *child_id,
+	const char *type, int online, unsigned long const timeout, cccs_resp_t *resp)
+{
+	int fd = -1;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+
+	if (child_id == NULL || *child_id == '\0') {
+		log_error("%s", "GW: Invalid child device identifier");
+		resp->hint = NULL;
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	log_debug("GW: Sending '%s' request for child '%s'", tag, child_id);
+
+	fd = connect_cccsd();
+	if (fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	if (write_string(fd, tag)					/* The request type */
+		|| write_string(fd, child_id)				/* Child identifier */
+		|| (type != NULL && write_string(fd, type))		/* Child type */
+		|| (online >= 0 && write_uint32(fd, online))		/* Child state */
+		|| write_uint32(fd, 0)) {				/* End of message */
+		log_error("GW: Could not send '%s' request for child '%s': %s (%d)",
+			tag, child_id, strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+	} else {
+		ret = parse_cccsd_response(fd, &cccs_resp, timeout);
+	}
+
+	close(fd);
+done:
+	fill_response(&cccs_resp, resp);
+
+	return ret;
+}
+
+cccs_comm_error_t cccs_gw_register_child(const char *child_id, const char *type, unsigned long const timeout, cccs_resp_t *resp)
+{
+	return send_gw_request(REQ_TAG_GW_REGISTER_CHILD, child_id,
+		type != NULL ? type : "", -1, timeout, resp);
+}
+
+cccs_comm_error_t cccs_gw_unregister_child(const char *child_id, unsigned long const timeout, cccs_resp_t *resp)
+{
+	return send_gw_request(REQ_TAG_GW_UNREGISTER_CHILD, child_id, NULL, -1, timeout, resp);
+}
+
+cccs_comm_error_t cccs_gw_set_child_state(const char *child_id, bool online, unsigned long const timeout, cccs_resp_t *resp)
+{
+	return send_gw_request(REQ_TAG_GW_CHILD_STATE, child_id, NULL, online ? 1 : 0, timeout, resp);
+}
@@ -20,6 +20,8 @@
 #ifndef _CCCS_SERVICES_H_
 #define _CCCS_SERVICES_H_
 
+#include <time.h>
+
 #include "cc_logging.h"
 #include "cccs_datapoints.h"
 #include "cccs_receive.h"
@@ -27,6 +29,65 @@
 #define CCCSD_WAIT_FOREVER		-1
 #define CCCSD_NO_WAIT			0
 
+/*
+ * Pending firmware update actions.
+ */
+typedef enum {
+	CCCS_FW_UPDATE_NONE,
+	CCCS_FW_UPDATE_INSTALL,
+	CCCS_FW_UPDATE_REBOOT,
+} cccs_fw_update_action_t;
+
+/*
+ * struct cccs_fw_update_status_t - Pending firmware update status type
+ *
+ * @action:		Pending action, CCCS_FW_UPDATE_NONE if there is no
+ * 			firmware update waiting for the install window
+ * @imminent:		True if the update is going to be applied in a few
+ * 			seconds, last chance to postpone it
+ * @apply_time:		Expected time to apply the update and reboot
+ * @postpone_left:	Seconds the update can still be postponed
+ */
+typedef struct {
+	cccs_fw_update_action_t action;
+	bool imminent;
+	time_t apply_time;
+	unsigned long postpone_left;
+} cccs_fw_update_status_t;
+
+/*
+ * File upload states.
+ */
+typedef enum {
+	CCCS_FILE_UPLOAD_UNKNOWN,
+	CCCS_FILE_UPLOAD_QUEUED,
+	CCCS_FILE_UPLOAD_UPLOADING,
+	CCCS_FILE_UPLOAD_DONE,
+	CCCS_FILE_UPLOAD_FAILED,
+} cccs_file_upload_state_t;
+
+/*
+ * struct cccs_file_upload_status_t - File upload status type
+ *
+ * @state:		State of the upload, CCCS_FILE_UPLOAD_UNKNOWN if it
+ * 			does not exist or finished long ago
+ * @sent:		Number of bytes already uploaded
+ * @size:		Size of the file
+ */
+typedef struct {
+	cccs_file_upload_state_t state;
+	uint64_t sent;
+	uint64_t size;
+} cccs_file_upload_status_t;
+
+typedef void (*cccs_file_upload_progress_cb_t)(uint32_t id,
+	const cccs_file_upload_status_t *status, void *user_data);
+
+typedef struct cccs_twin_subscription cccs_twin_subscription_t;
+
+typedef void (*cccs_twin_desired_cb_t)(const char *ns, uint32_t version,
+	const char *desired, void *user_data);
+
 /*
  * cccs_is_daemon_ready() - Check if CCCS daemon is ready
  *
@@ -54,4 +115,255 @@ bool cccs_is_daemon_ready(long timeout);
  */
 cccs_comm_error_t cccs_set_maintenance_status(bool status, unsigned long const timeout, cccs_resp_t *resp);
 
+/*
+ * cccs_set_health_status() - Report the health status of an application
+ *
+ * @app:	Name of the application, as listed in 'health_check_apps'.
+ * @healthy:	True if the application is working properly, false otherwise.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * After a firmware update, the daemon waits for all the applications in the
+ * 'health_check_apps' setting to report they are healthy before committing
+ * the update. If they do not report it in time, the system rolls back to
+ * the previous firmware.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_set_health_status(const char *const app, bool healthy, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_get_fw_update_status() - Get the status of the pending firmware update
+ *
+ * @status:	Struct to store the pending firmware update status.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * When 'firmware_install_window' is configured, firmware updates are
+ * installed and the device rebooted inside that window. Applications can
+ * poll this status to know when the reboot is going to happen and postpone
+ * it with 'cccs_postpone_fw_update()'.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_get_fw_update_status(cccs_fw_update_status_t *status, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_postpone_fw_update() - Postpone the pending firmware update
+ *
+ * @seconds:	Number of seconds to postpone the update.
+ * @until:	Time the update is postponed until. Can be NULL.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The total postponement is limited by the 'firmware_postpone_max' setting,
+ * so the granted time may be less than requested. The request fails if
+ * there is no pending update or it cannot be postponed anymore.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_postpone_fw_update(unsigned long seconds, time_t *until, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_send_file() - Upload a file to the device cloud storage
+ *
+ * @local_path:	Path of the file to upload.
+ * @cloud_path:	Destination path in the device cloud storage.
+ * @id:		Identifier of the upload to follow its progress. Can be NULL.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The file is queued and the daemon uploads it in the background in chunks,
+ * with lower priority than other transfers. If the connection drops or the
+ * device reboots, the upload resumes from the last uploaded chunk. The file
+ * must not be modified until the upload finishes, otherwise it starts over.
+ *
+ * Use 'cccs_get_file_upload_status()' or 'cccs_wait_file_upload()' to follow
+ * its progress.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if the upload was queued, any other error if
+ *         the communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_send_file(const char *local_path, const char *cloud_path, uint32_t *id, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_get_file_upload_status() - Get the status of a file upload
+ *
+ * @id:		Identifier of the upload returned by 'cccs_send_file()'.
+ * @status:	Struct to store the upload status.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_get_file_upload_status(uint32_t id, cccs_file_upload_status_t *status, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_wait_file_upload() - Wait for a file upload to finish
+ *
+ * @id:		Identifier of the upload returned by 'cccs_send_file()'.
+ * @progress_cb: Callback executed when the upload progresses. Can be NULL.
+ * @user_data:	User data to pass to the callback.
+ * @timeout:	Number of seconds to wait for the upload to finish.
+ *		CCCSD_WAIT_FOREVER to block until it finishes.
+ * @status:	Struct to store the last upload status. Can be NULL.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if the upload finished, check the state of
+ *         'status' to know if it succeeded, CCCS_SEND_ERROR_READ_TIMEOUT if
+ *         it did not finish in time, any other error if the communication
+ *         with the daemon fails.
+ */
+cccs_comm_error_t cccs_wait_file_upload(uint32_t id, cccs_file_upload_progress_cb_t progress_cb,
+	void *user_data, long timeout, cccs_file_upload_status_t *status, cccs_resp_t *resp);
+
+/*
+ * cccs_twin_subscribe() - Subscribe to the desired state of a device twin
+ *
+ * @ns:		Namespace of the application: 1 to 64 characters among letters,
+ *		digits, '-', '_' and '.', not starting with '.'.
+ * @version:	Last desired version the application knows, 0 if none.
+ * @cb:		Callback executed with the desired state as a JSON object
+ *		string and its version.
+ * @user_data:	User data to pass to the callback.
+ * @subscription: Created subscription, it must be freed with
+ *		'cccs_twin_unsubscribe()'.
+ * @timeout:	Number of seconds to wait for response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The desired state is set from Remote Manager with the
+ * "builtin/device_twin" target and stored by the daemon. If its version
+ * differs from @version, the callback is executed right after subscribing,
+ * so changes made while the application was not running are not lost.
+ * Several changes in a row may be delivered as the latest one only.
+ *
+ * The callback runs in a thread of the subscription.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_twin_subscribe(const char *ns, uint32_t version,
+	cccs_twin_desired_cb_t cb, void *user_data,
+	cccs_twin_subscription_t **subscription, unsigned long const timeout,
+	cccs_resp_t *resp);
+
+/*
+ * cccs_twin_unsubscribe() - Cancel a device twin subscription and free it
+ *
+ * @subscription:	Subscription to cancel.
+ *
+ * It must not be called from the subscription callback.
+ */
+void cccs_twin_unsubscribe(cccs_twin_subscription_t *subscription);
+
+/*
+ * cccs_twin_report() - Update the reported state of a device twin
+ *
+ * @ns:		Namespace of the application.
+ * @patch:	JSON object string to merge into the reported state, as a
+ *		JSON merge patch (RFC 7396): null members are removed.
+ * @version:	Version of the resulting reported state. Can be NULL.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The daemon stores the reported state and syncs it to Remote Manager in
+ * the "device_twin/<ns>/reported" data stream, sending only the changes
+ * since the last synced version when they are smaller than the whole state.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_twin_report(const char *ns, const char *patch, uint32_t *version, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_register_child() - Register a child device behind this gateway
+ *
+ * @child_id:	Identifier of the child device: 1 to 64 letters, digits, '-',
+ *		'_' or '.', not starting with '.'.
+ * @type:	Type of the child device, reported with its status.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The child is online after registering it. Its status is uploaded to the
+ * "children/<child_id>/status" data stream. Its data points, sent with
+ * 'cccs_gw_send_dp_collection()', go to the "children/<child_id>/" data
+ * streams, and its data request targets, registered with
+ * 'cccs_gw_add_request_target()', are named "child/<child_id>/<target>".
+ *
+ * Children are not persistent, they must be registered every time the daemon
+ * starts. The gateway mode must be enabled in the daemon configuration.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_register_child(const char *child_id, const char *type, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_unregister_child() - Unregister a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * The child is reported offline. Its stored data points are still uploaded.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_unregister_child(const char *child_id, unsigned long const timeout, cccs_resp_t *resp);
+
+/*
+ * cccs_gw_set_child_state() - Set the online state of a child device
+ *
+ * @child_id:	Identifier of the child device.
+ * @online:	True if the child is online, false otherwise.
+ * @timeout:	Number of seconds to wait for a response from the daemon.
+ * @resp:	Received response from CCCS daemon.
+ *
+ * Sending data points of a child also sets it online. A child is set offline
+ * by the daemon when it has no activity for 'gateway_child_timeout' seconds.
+ * Data requests for an offline child are rejected.
+ *
+ * Response may contain a string with the result of the operation (resp->hint).
+ * This string must be freed.
+ *
+ * Return: CCCS_SEND_ERROR_NONE if success, any other error if the
+ *         communication with the daemon fails.
+ */
+cccs_comm_error_t cccs_gw_set_child_state(const char *child_id, bool online, unsigned long const timeout, cccs_resp_t *resp);
+
 #endif /* _CCCS_SERVICES_H_ */
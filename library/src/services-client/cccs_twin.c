@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "_cccs_utils.h"
+#include "cc_logging.h"
+#include "cccs_services.h"
+#include "service_common.h"
+#include "services_util.h"
+
+#define SERVICE_TAG	"TWIN:"
+
+/*
+ * struct cccs_twin_subscription - Subscription to a device twin desired state
+ *
+ * @fd:		Socket connected to the daemon.
+ * @ns:		Namespace of the subscription.
+ * @cb:		Callback executed for every desired state.
+ * @user_data:	User data to pass to the callback.
+ * @thread:	Thread reading the desired states.
+ */
+struct cccs_twin_subscription {
+	int fd;
+	char *ns;
+	cccs_twin_desired_cb_t cb;
+	void *user_data;
+	pthread_t thread;
+};
+
+/*
+ * subscription_threaded() - Read the desired states of a subscription
+ *
+ * @arg:	Subscription.
+ *
+ * Each frame from the daemon is the desired version followed by the desired
+ * state as a JSON blob.
+ */
+static void *subscription_threaded(void *arg)
+{
+	cccs_twin_subscription_t *s = arg;
+
+	while (true) {
+		uint32_t version;
+		void *desired = NULL;
+		size_t length;
+
+		if (read_uint32(s->fd, &version, NULL) != 0
+			|| read_blob(s->fd, &desired, &length, NULL) != 0)
+			break;
+
+		if (desired != NULL)
+			s->cb(s->ns, version, desired, s->user_data);
+		free(desired);
+	}
+
+	return NULL;
+}
+
+cccs_comm_error_t cccs_twin_subscribe(const char *ns, uint32_t version,
+	cccs_twin_desired_cb_t cb, void *user_data,
+	cccs_twin_subscription_t **subscription, unsigned long const timeout,
+	cccs_resp_t *resp)
+{
+	cccs_twin_subscription_t *s = NULL;
+	cccs_comm_error_t ret;
+	cccs_srv_resp_t cccs_resp = {
+		.srv_err = 0,
+		.ccapi_err = 0,
+		.cccs_err = 0,
+		.hint = NULL
+	};
+	int error;
+
+	resp->hint = NULL;
+	resp->code = 0;
+
+	if (!ns || *ns == '\0' || !cb || !subscription) {
+		log_error("%s Invalid subscription", SERVICE_TAG);
+		resp->code = CCCS_SEND_ERROR_INVALID_ARGUMENT;
+
+		return CCCS_SEND_ERROR_INVALID_ARGUMENT;
+	}
+
+	*subscription = NULL;
+
+	s = calloc(1, sizeof(*s));
+	if (s)
+		s->ns = strdup(ns);
+	if (!s || !s->ns) {
+		log_error("%s Unable to subscribe: Out of memory", SERVICE_TAG);
+		free(s);
+		resp->code = CCCS_SEND_ERROR_OUT_OF_MEMORY;
+
+		return CCCS_SEND_ERROR_OUT_OF_MEMORY;
+	}
+	s->cb = cb;
+	s->user_data = user_data;
+
+	s->fd = connect_cccsd();
+	if (s->fd < 0) {
+		ret = CCCS_SEND_UNABLE_TO_CONNECT_TO_DAEMON;
+		goto done;
+	}
+
+	error = write_string(s->fd, REQ_TAG_TWIN_SUBSCRIBE)	/* The request type */
+		|| write_string(s->fd, ns)			/* Namespace */
+		|| write_uint32(s->fd, version)			/* Known version */
+		|| write_uint32(s->fd, 0);			/* End of message */
+
+	if (error) {
+		log_error("%s Could not subscribe to namespace '%s': %s (%d)", SERVICE_TAG,
+			ns, strerror(errno), errno);
+
+		ret = CCCS_SEND_ERROR_BAD_RESPONSE;
+		goto done;
+	}
+
+	ret = parse_cccsd_response(s->fd, &cccs_resp, timeout);
+	if (ret != CCCS_SEND_ERROR_NONE)
+		goto done;
+
+	error = pthread_create(&s->thread, NULL, subscription_threaded, s);
+	if (error) {
+		log_error("%s Unable to start subscription thread (%d)", SERVICE_TAG, error);
+		ret = CCCS_SEND_ERROR_OUT_OF_MEMORY;
+		cccs_resp.cccs_err = CCCS_SEND_ERROR_OUT_OF_MEMORY;
+		goto done;
+	}
+
+	*subscription = s;
+
+done:
+	if (*subscription == NULL) {
+		if (s->fd >= 0)
+			close(s->fd);
+		free(s->ns);
+		free(s);
+	}
+
+	resp->hint = cccs_resp.hint;
+
+	/* cccs_resp.cccs_err   ---> Error while reading command */
+	switch (cccs_resp.cccs_err) {
+		case CCCS_SEND_ERROR_NONE:
+			break;
+		/* cccs_resp.ccapi_err  ---> Error while sending data points/error from DRM */
+		case CCCS_SEND_ERROR_CCAPI_ERROR:
+			resp->code = cccs_resp.ccapi_err;
+			break;
+		/* cccs_resp.srv_err    ---> Error from DRM */
+		case CCCS_SEND_ERROR_SRV_ERROR:
+			resp->code = cccs_resp.srv_err;
+			break;
+		default:
+			resp->code = cccs_resp.cccs_err;
+			break;
+	}
+
+	return ret;
+}
+
+void cccs_twin_unsubscribe(cccs_twin_subscription_t *subscription)
+{
+	if (!subscription)
+		return;
+
+	/* Unblock the subscription thread */
+	shutdown(subscription->fd, SHUT_RDWR);
+	pthread_join(subscription->thread, NULL);
+
+	close(subscription->fd);
+	free(subscription->ns);
+	free(subscription);
+}
@@ -16,6 +16,7 @@
  * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
  * ===========================================================================
  */
+#include "cc_clock.h"
 #include "dp_csv_generator.h"
 
 static bool terminate_csv_field(csv_process_data_t * const csv_process_data, buffer_info_t * const buffer_info, csv_field_t const next_field)
@@ -209,6 +210,23 @@ static int process_csv_location(csv_process_data_t * const csv_process_data, buf
 	return done_processing;
 }
 
+/*
+ * get_fractional_time_ms() - Get the corrected time of a data point in milliseconds
+ *
+ * @data_point:	Data point with 'connector_time_local_epoch_fractional' time.
+ *
+ * Data points stamped before the system clock was set are corrected.
+ *
+ * Return: The data point time in milliseconds.
+ */
+static uint64_t get_fractional_time_ms(connector_data_point_t const * const data_point)
+{
+	uint64_t time_ms = (uint64_t) data_point->time.value.since_epoch_fractional.seconds * 1000
+		+ data_point->time.value.since_epoch_fractional.milliseconds;
+
+	return clock_fix_timestamp_ms(time_ms);
+}
+
 static bool process_csv_time(csv_process_data_t * const csv_process_data, buffer_info_t * const buffer_info)
 {
 	connector_data_point_t const * const current_data_point = csv_process_data->current_data_point;
@@ -222,7 +240,7 @@ static bool process_csv_time(csv_process_data_t * const csv_process_data, buffer
 		{
 			if (!csv_process_data->data.init) {
 				csv_process_data->data.init = true;
-				init_int_info(&csv_process_data->data.info.intg, current_data_point->time.value.since_epoch_fractional.seconds, 10);
+				init_int_info(&csv_process_data->data.info.intg, get_fractional_time_ms(current_data_point) / 1000, 10);
 				csv_process_data->data.internal_state.time = TIME_EPOCH_FRAC_STATE_SECONDS;
 			}
 
@@ -233,7 +251,7 @@ static bool process_csv_time(csv_process_data_t * const csv_process_data, buffer
 					bool const field_done = process_integer(&csv_process_data->data.info.intg, buffer_info);
 
 					if (field_done) {
-						init_int_info(&csv_process_data->data.info.intg, current_data_point->time.value.since_epoch_fractional.milliseconds, 10);
+						init_int_info(&csv_process_data->data.info.intg, get_fractional_time_ms(current_data_point) % 1000, 10);
 						csv_process_data->data.info.intg.figures = 3; /* Always add leading zeroes, i.e. 1 millisecond must be "001" */
 						csv_process_data->data.internal_state.time++;
 					}
@@ -249,7 +267,7 @@ static bool process_csv_time(csv_process_data_t * const csv_process_data, buffer
 		{
 			if (!csv_process_data->data.init) {
 				csv_process_data->data.init = true;
-				init_int_info(&csv_process_data->data.info.intg, current_data_point->time.value.since_epoch_whole.milliseconds, 10);
+				init_int_info(&csv_process_data->data.info.intg, clock_fix_timestamp_ms(current_data_point->time.value.since_epoch_whole.milliseconds), 10);
 			}
 
 			done_processing = process_integer(&csv_process_data->data.info.intg, buffer_info);
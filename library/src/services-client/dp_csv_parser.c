@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <stdbool.h>
+
+#include "dp_csv_parser.h"
+
+size_t dp_csv_record_length(const char *csv, size_t length)
+{
+	bool quoted = false, escaped = false;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		if (escaped)
+			escaped = false;
+		else if (quoted && csv[i] == '\\')
+			escaped = true;
+		else if (csv[i] == '\"')
+			quoted = !quoted;
+		else if (!quoted && csv[i] == '\n')
+			return i + 1;
+	}
+
+	return length;
+}
+
+int dp_csv_parse_record(const char *record, size_t length, char *out,
+	char *fields[csv_finished])
+{
+	bool quoted = false, escaped = false;
+	unsigned int field = csv_data;
+	size_t i;
+
+	fields[field] = out;
+
+	for (i = 0; i < length; i++) {
+		char const c = record[i];
+
+		if (escaped) {
+			escaped = false;
+		} else if (quoted && c == '\\') {
+			escaped = true;
+			continue;
+		} else if (c == '\"') {
+			quoted = !quoted;
+			continue;
+		} else if (!quoted && c == '\n') {
+			break;
+		} else if (!quoted && c == ',') {
+			*out++ = '\0';
+			if (++field == csv_finished)
+				return -1;
+			fields[field] = out;
+			continue;
+		}
+
+		*out++ = c;
+	}
+
+	*out = '\0';
+
+	return field == csv_stream_id ? 0 : -1;
+}
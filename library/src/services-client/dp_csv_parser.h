@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef _DP_CSV_PARSER_H_
+#define _DP_CSV_PARSER_H_
+
+#include <stddef.h>
+
+#include "dp_csv_generator.h"
+
+/*
+ * dp_csv_record_length() - Get the length of the first record of a CSV buffer
+ *
+ * @csv:	Buffer with records as generated by 'generate_dp_csv()'.
+ * @length:	Number of bytes of the buffer.
+ *
+ * Line breaks inside quoted fields do not end the record.
+ *
+ * Return: Number of bytes of the record including its '\n' terminator, the
+ *         whole buffer if the record is not terminated.
+ */
+size_t dp_csv_record_length(const char *csv, size_t length);
+
+/*
+ * dp_csv_parse_record() - Split a CSV record into its fields
+ *
+ * @record:	Record as generated by 'generate_dp_csv()'.
+ * @length:	Number of bytes of the record.
+ * @out:	Buffer of at least 'length' + 1 bytes to store the fields
+ *		without quotes and escape characters.
+ * @fields:	Array to store the fields, indexed by 'csv_field_t'. They
+ *		point to 'out'.
+ *
+ * Return: 0 on success, -1 if the record does not have all the fields.
+ */
+int dp_csv_parse_record(const char *record, size_t length, char *out,
+	char *fields[csv_finished]);
+
+#endif /* _DP_CSV_PARSER_H_ */
@@ -24,14 +24,31 @@
 
 #define REQ_TAG_DP_FILE_REQUEST		"upload_1_dp"
 #define REQ_TAG_MNT_REQUEST		"mnt_request"
+#define REQ_TAG_HEALTH_REQUEST		"health_request"
+#define REQ_TAG_FW_UPDATE_STATUS	"fw_update_status"
+#define REQ_TAG_FW_UPDATE_POSTPONE	"fw_update_postpone"
 #define REQ_TAG_REGISTER_DR		"register_devicerequest"
 #define REQ_TAG_UNREGISTER_DR		"unregister_devicerequest"
 #define REQ_TAG_REGISTER_DR_IPV4	"register_devicerequest_ipv4"
 #define REQ_TAG_UNREGISTER_DR_IPV4	"unregister_devicerequest_ipv4"
+#define REQ_TAG_DP_SUBSCRIBE		"dp_subscribe"
+#define REQ_TAG_FILE_UPLOAD		"file_upload"
+#define REQ_TAG_FILE_UPLOAD_STATUS	"file_upload_status"
+#define REQ_TAG_TWIN_SUBSCRIBE		"twin_subscribe"
+#define REQ_TAG_TWIN_REPORT		"twin_report"
+#define REQ_TAG_GW_REGISTER_CHILD	"gw_child_register"
+#define REQ_TAG_GW_UNREGISTER_CHILD	"gw_child_unregister"
+#define REQ_TAG_GW_CHILD_STATE		"gw_child_state"
+
+/* Data request targets of a child device: child/<child_id>/<target> */
+#define GW_CHILD_TARGET_PREFIX		"child/"
 
 #define REQ_TYPE_REQUEST_CB		"request"
 #define REQ_TYPE_STATUS_CB		"status"
 
+/* Local stream of the data requests received from the cloud */
+#define DP_BUS_DATA_REQUEST_STREAM	"data_request"
+
 typedef enum {
 	upload_datapoint_file_terminate,
 	upload_datapoint_file_metrics,
@@ -39,6 +56,8 @@ typedef enum {
 	upload_datapoint_file_path_metrics,
 	upload_datapoint_file_path_binary,
 	upload_datapoint_file_metrics_binary,
+	upload_datapoint_file_metrics_local,
+	upload_datapoint_file_metrics_child,
 	upload_datapoint_file_count
 } upload_datapoint_file_t;
 
@@ -20,16 +20,26 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <malloc.h>
+#include <stdio.h>
 #include <unistd.h>
 
 #include "cc_config.h"
+#include "cc_cred_store.h"
+#include "cc_device_twin.h"
+#include "cc_gateway.h"
+#include "cc_job_scheduler.h"
 #include "cc_logging.h"
+#include "cc_mem_budget.h"
 #include "ccapi/ccapi.h"
 #include "services_util.h"
 #include "service_data_request.h"
+#include "service_dp_bus.h"
 #include "_utils.h"
 
 #define TARGET_EDP_CERT_UPDATE	"builtin/edp_certificate_update"
+#define TARGET_DEVICE_TWIN	"builtin/device_twin"
+#define TARGET_GATEWAY		"builtin/gateway"
+#define TARGET_JOB_SCHEDULER	"builtin/job_scheduler"
 
 #define DATA_REQUEST_TAG		"DREQ:"
 
@@ -183,22 +193,66 @@ out:
 	}
 }
 
-static ccapi_receive_error_t data_request(const char *target,
-			   ccapi_transport_t transport,
+/*
+ * publish_data_request() - Deliver a data request to the local subscribers
+ *
+ * @target:		Target of the data request.
+ * @request_buffer_info:	Payload of the data request.
+ *
+ * It is published as a string data point in the 'data_request/<target>'
+ * stream, in addition to being delivered to the application that registered
+ * the target.
+ */
+static void publish_data_request(const char *target,
+	const ccapi_buffer_info_t *request_buffer_info)
+{
+	char *stream_id = NULL;
+
+	if (!dp_bus_has_subscribers())
+		return;
+
+	if (asprintf(&stream_id, "%s/%s", DP_BUS_DATA_REQUEST_STREAM, target) < 0) {
+		log_dr_error("Could not publish data request: %s", "Out of memory");
+		return;
+	}
+
+	dp_bus_publish_string(stream_id, request_buffer_info->buffer,
+		request_buffer_info->length);
+
+	free(stream_id);
+}
+
+/*
+ * deliver_data_request() - Deliver a data request to the registered application
+ *
+ * @target:			Target of the data request.
+ * @request_buffer_info:	Payload of the data request.
+ * @response_buffer_info:	Buffer to store the response of the application.
+ * @timeout_sec:		Seconds to wait for the response.
+ *
+ * Return: The error code reported by the application, or the delivery error.
+ */
+static ccapi_receive_error_t deliver_data_request(const char *target,
 			   const ccapi_buffer_info_t *request_buffer_info,
-			   ccapi_buffer_info_t *response_buffer_info)
+			   ccapi_buffer_info_t *response_buffer_info,
+			   unsigned int timeout_sec)
 {
 	int ret = 1; /* Assume errors */
 	int sock_fd = get_socket_for_target(target);
 	ccapi_receive_error_t error = CCAPI_RECEIVE_ERROR_NONE;
 	struct timeval timeout = {
-		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_sec = timeout_sec,
 		.tv_usec = 0
 	};
 
-	UNUSED_ARGUMENT(transport);
-
 	if (sock_fd < 0) {
+		error = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+		goto out;
+	}
+
+	/* Requests for an offline child device do not reach its application */
+	if (!gateway_target_available(target)) {
+		error = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
 		goto out;
 	}
 
@@ -213,10 +267,13 @@ static ccapi_receive_error_t data_request(const char *target,
 	/* Read the blob response from the device */
 	ret = read_uint32(sock_fd, &error, &timeout);
 	if (ret == 0)
-		ret = read_blob(sock_fd, &response_buffer_info->buffer, &response_buffer_info->length, &timeout);
+		ret = read_blob_budget(sock_fd, &response_buffer_info->buffer,
+			&response_buffer_info->length, &timeout, MEM_SS_DATA_REQUEST);
 
 	if (ret == -ETIMEDOUT)
 		log_dr_error("Could not receive request data: %s", "Timeout");
+	else if (ret == -ENOBUFS)
+		log_dr_error("Could not receive request data: %s", "Memory budget exceeded");
 	else if (ret == -ENOMEM)
 		log_dr_error("Could not receive request data: %s", "Out of memory");
 	else if (ret == -EPIPE)
@@ -225,7 +282,7 @@ static ccapi_receive_error_t data_request(const char *target,
 		log_dr_error("Could not receive request data: %s (%d)", strerror(errno), errno);
 
 	if (ret) {
-		error = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
+		error = ret == -ENOBUFS ? CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY : CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
 		goto out;
 	}
 out:
@@ -239,6 +296,19 @@ out:
 	return error;
 }
 
+static ccapi_receive_error_t data_request(const char *target,
+			   ccapi_transport_t transport,
+			   const ccapi_buffer_info_t *request_buffer_info,
+			   ccapi_buffer_info_t *response_buffer_info)
+{
+	UNUSED_ARGUMENT(transport);
+
+	publish_data_request(target, request_buffer_info);
+
+	return deliver_data_request(target, request_buffer_info,
+		response_buffer_info, SOCKET_READ_TIMEOUT_SEC);
+}
+
 static void data_request_done(const char *target,
 		ccapi_transport_t transport,
 		ccapi_buffer_info_t *response_buffer_info,
@@ -264,13 +334,49 @@ static void data_request_done(const char *target,
 		goto out;
 	}
 out:
-	if (response_buffer_info)
+	if (response_buffer_info) {
+		if (response_buffer_info->buffer)
+			mem_budget_release(MEM_SS_DATA_REQUEST, response_buffer_info->length + 1);
 		free(response_buffer_info->buffer);
+	}
 
 	if (sock_fd >= 0)
 		close(sock_fd);
 }
 
+ccapi_receive_error_t run_data_request(const char *target, const char *payload,
+	size_t length, unsigned int timeout, char **response, size_t *response_length)
+{
+	ccapi_buffer_info_t request_buffer_info = {
+		.buffer = (void *) payload,
+		.length = length
+	};
+	ccapi_buffer_info_t response_buffer_info = {
+		.buffer = NULL,
+		.length = 0
+	};
+	ccapi_receive_error_t error;
+
+	*response = NULL;
+	*response_length = 0;
+
+	if (!find_request_data(target))
+		return CCAPI_RECEIVE_ERROR_TARGET_NOT_ADDED;
+
+	error = deliver_data_request(target, &request_buffer_info,
+		&response_buffer_info, timeout);
+	if (response_buffer_info.buffer != NULL && response_buffer_info.length > 0) {
+		*response = strndup(response_buffer_info.buffer, response_buffer_info.length);
+		if (*response != NULL)
+			*response_length = strlen(*response);
+	}
+
+	/* Let the application know the request finished, as for cloud requests */
+	data_request_done(target, CCAPI_TRANSPORT_TCP, &response_buffer_info, error);
+
+	return error;
+}
+
 static int read_request(int fd, request_data_t *out, bool expect_ip, int expected_ip_af)
 {
 	/* Receive a device registration request */
@@ -616,7 +722,6 @@ static ccapi_receive_error_t edp_cert_update_cb(const char *const target,
 			const ccapi_buffer_info_t *const request_buffer_info,
 			ccapi_buffer_info_t *const response_buffer_info)
 {
-	FILE *fp;
 	ccapi_receive_error_t ret;
 
 	UNUSED_ARGUMENT(response_buffer_info);
@@ -632,13 +737,9 @@ static ccapi_receive_error_t edp_cert_update_cb(const char *const target,
 			return CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
 		}
 
-		fp = fopen(client_cert_path, "w");
-		if (!fp) {
-			log_dr_error("Unable to open certificate '%s': %s (%d)",
-				client_cert_path, strerror(errno), errno);
-			return CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
-		}
-		if (fwrite(request_buffer_info->buffer, sizeof(char), request_buffer_info->length, fp) < request_buffer_info->length) {
+		/* Keep the current certificate until the new one completes a handshake */
+		if (cred_store_save(client_cert_path, get_client_cert_key_file(),
+			request_buffer_info->buffer, request_buffer_info->length) != 0) {
 			log_dr_error("Unable to write certificate '%s'", client_cert_path);
 			ret = CCAPI_RECEIVE_ERROR_INSUFFICIENT_MEMORY;
 		} else {
@@ -646,7 +747,6 @@ static ccapi_receive_error_t edp_cert_update_cb(const char *const target,
 			edp_cert_downloaded = true;
 			ret = CCAPI_RECEIVE_ERROR_NONE;
 		}
-		fclose(fp);
 	} else {
 		log_dr_error("%s: received invalid data", __func__);
 		ret = CCAPI_RECEIVE_ERROR_INVALID_DATA_CB;
@@ -687,6 +787,36 @@ ccapi_receive_error_t register_builtin_requests(void)
 	}
 #endif /* CCIMP_CLIENT_CERTIFICATE_CAP_ENABLED */
 
+	receive_error = ccapi_receive_add_target(TARGET_DEVICE_TWIN,
+						 device_twin_request_cb,
+						 builtin_request_status_cb,
+						 CCAPI_RECEIVE_NO_LIMIT);
+	if (receive_error != CCAPI_RECEIVE_ERROR_NONE) {
+		log_dr_error("Cannot register target '%s', error %d", TARGET_DEVICE_TWIN,
+				receive_error);
+		return receive_error;
+	}
+
+	receive_error = ccapi_receive_add_target(TARGET_GATEWAY,
+						 gateway_request_cb,
+						 builtin_request_status_cb,
+						 CCAPI_RECEIVE_NO_LIMIT);
+	if (receive_error != CCAPI_RECEIVE_ERROR_NONE) {
+		log_dr_error("Cannot register target '%s', error %d", TARGET_GATEWAY,
+				receive_error);
+		return receive_error;
+	}
+
+	receive_error = ccapi_receive_add_target(TARGET_JOB_SCHEDULER,
+						 job_scheduler_request_cb,
+						 builtin_request_status_cb,
+						 CCAPI_RECEIVE_NO_LIMIT);
+	if (receive_error != CCAPI_RECEIVE_ERROR_NONE) {
+		log_dr_error("Cannot register target '%s', error %d", TARGET_JOB_SCHEDULER,
+				receive_error);
+		return receive_error;
+	}
+
 	return receive_error;
 }
 
@@ -35,4 +35,24 @@ int handle_unregister_data_request_ipv4(int fd, const cc_cfg_t *const cc_cfg);
  */
 ccapi_receive_error_t register_builtin_requests(void);
 
+/*
+ * run_data_request() - Send a data request to a local application
+ *
+ * @target:		Target registered by the application.
+ * @payload:		Payload of the data request.
+ * @length:		Length of the payload.
+ * @timeout:		Seconds to wait for the response.
+ * @response:		Pointer to store the null-terminated response, NULL if
+ *			there is none. Must be freed.
+ * @response_length:	Pointer to store the length of the response.
+ *
+ * The application receives the request and its status callback as if it came
+ * from Remote Manager.
+ *
+ * Return: CCAPI_RECEIVE_ERROR_NONE on success, CCAPI_RECEIVE_ERROR_TARGET_NOT_ADDED
+ *         if the target is not registered, any other error otherwise.
+ */
+ccapi_receive_error_t run_data_request(const char *target, const char *payload,
+	size_t length, unsigned int timeout, char **response, size_t *response_length);
+
 #endif /* SERVICE_DATA_REQUEST_H */
@@ -0,0 +1,795 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cc_logging.h"
+#include "cc_mem_budget.h"
+#include "service_dp_bus.h"
+#include "services_util.h"
+#include "services-client/cccs_definitions.h"
+#include "services-client/dp_csv_parser.h"
+#include "_utils.h"
+
+#define DP_BUS_TAG			"BUS:"
+
+#define MAX_SUBSCRIBERS			32
+#define MAX_PATTERNS			16
+#define MAX_PATTERN_LEN			255
+
+#define MIN_QUEUE_SIZE			(4 * 1024)
+#define DEFAULT_QUEUE_SIZE		(64 * 1024)
+#define MAX_QUEUE_SIZE			(1024 * 1024)
+
+/* Each queued record is prefixed with its length */
+#define RECORD_HDR_SIZE			sizeof(uint32_t)
+
+/* Seconds between checks of idle subscriber connections */
+#define IDLE_CHECK_SEC			5
+/* Seconds to wait for the subscribers to disconnect when stopping */
+#define STOP_TIMEOUT_SEC		5
+
+/**
+ * log_bus_debug() - Log the given message as debug
+ *
+ * @format:		Debug message to log.
+ * @args:		Additional arguments.
+ */
+#define log_bus_debug(format, ...)					\
+	log_debug("%s " format, DP_BUS_TAG, __VA_ARGS__)
+
+/**
+ * log_bus_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_bus_info(format, ...)					\
+	log_info("%s " format, DP_BUS_TAG, __VA_ARGS__)
+
+/**
+ * log_bus_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_bus_error(format, ...)					\
+	log_error("%s " format, DP_BUS_TAG, __VA_ARGS__)
+
+/*
+ * struct bus_subscriber_t - Local data point subscriber
+ *
+ * @fd:			Socket connected to the subscriber.
+ * @patterns:		Stream id patterns the subscriber is interested in.
+ * @n_patterns:		Number of patterns.
+ * @ring:		Queue of records pending to deliver, each one prefixed
+ *			by its length.
+ * @frame:		Buffer to send the queued records.
+ * @size:		Size of the queue and the frame buffer.
+ * @head:		Position of the oldest record in the queue.
+ * @used:		Number of bytes used in the queue.
+ * @dropped:		Records dropped since the last delivery.
+ * @total_dropped:	Records dropped since the subscription.
+ * @delivered:		Records delivered since the subscription.
+ * @closing:		True when the subscriber must be disconnected.
+ * @lock:		Lock to access the queue.
+ * @cond:		Signaled when there are records to deliver.
+ * @next:		Next subscriber.
+ */
+typedef struct bus_subscriber {
+	int fd;
+	char *patterns[MAX_PATTERNS];
+	unsigned int n_patterns;
+	char *ring;
+	char *frame;
+	size_t size;
+	size_t head;
+	size_t used;
+	uint32_t dropped;
+	unsigned long long total_dropped;
+	unsigned long long delivered;
+	bool closing;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct bus_subscriber *next;
+} bus_subscriber_t;
+
+/*
+ * struct bus_record_t - Data point record to publish
+ *
+ * @record:	CSV record, including its '\n' terminator.
+ * @length:	Number of bytes of the record.
+ * @stream_id:	Stream id of the data point.
+ */
+typedef struct {
+	const char *record;
+	size_t length;
+	const char *stream_id;
+} bus_record_t;
+
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when a subscriber leaves the bus */
+static pthread_cond_t bus_cond = PTHREAD_COND_INITIALIZER;
+static bus_subscriber_t *subscribers = NULL;
+static unsigned int n_subscribers = 0;
+static bool bus_stopped = false;
+
+bool dp_bus_has_subscribers(void)
+{
+	return __atomic_load_n(&n_subscribers, __ATOMIC_RELAXED) > 0;
+}
+
+/*
+ * ring_write() - Copy data to the end of a subscriber queue
+ *
+ * @s:		Subscriber.
+ * @data:	Data to copy.
+ * @length:	Number of bytes to copy. They must fit in the free space.
+ *
+ * Must be called with the subscriber lock held.
+ */
+static void ring_write(bus_subscriber_t *s, const void *data, size_t length)
+{
+	size_t pos = (s->head + s->used) % s->size;
+	size_t n = length < s->size - pos ? length : s->size - pos;
+
+	memcpy(s->ring + pos, data, n);
+	memcpy(s->ring, (const char *)data + n, length - n);
+	s->used += length;
+}
+
+/*
+ * ring_read() - Take data from the beginning of a subscriber queue
+ *
+ * @s:		Subscriber.
+ * @data:	Buffer to store the data, NULL to discard it.
+ * @length:	Number of bytes to take. They must be in the queue.
+ *
+ * Must be called with the subscriber lock held.
+ */
+static void ring_read(bus_subscriber_t *s, void *data, size_t length)
+{
+	size_t n = length < s->size - s->head ? length : s->size - s->head;
+
+	if (data) {
+		memcpy(data, s->ring + s->head, n);
+		memcpy((char *)data + n, s->ring, length - n);
+	}
+	s->head = (s->head + length) % s->size;
+	s->used -= length;
+}
+
+/*
+ * enqueue_record() - Queue a record for a subscriber
+ *
+ * @s:		Subscriber.
+ * @record:	Record to queue.
+ * @length:	Number of bytes of the record.
+ *
+ * The oldest records are dropped to make room for the new one.
+ *
+ * Must be called with the subscriber lock held.
+ */
+static void enqueue_record(bus_subscriber_t *s, const char *record, size_t length)
+{
+	uint32_t len = length;
+
+	if (RECORD_HDR_SIZE + length > s->size) {
+		s->dropped++;
+		return;
+	}
+
+	while (s->size - s->used < RECORD_HDR_SIZE + length) {
+		uint32_t old_len;
+
+		ring_read(s, &old_len, RECORD_HDR_SIZE);
+		ring_read(s, NULL, old_len);
+		s->dropped++;
+	}
+
+	ring_write(s, &len, RECORD_HDR_SIZE);
+	ring_write(s, record, length);
+}
+
+/*
+ * dequeue_records() - Move all the queued records of a subscriber to its frame
+ *
+ * @s:		Subscriber.
+ * @n_records:	Number of records moved.
+ *
+ * Must be called with the subscriber lock held.
+ *
+ * Return: Number of bytes of the frame.
+ */
+static size_t dequeue_records(bus_subscriber_t *s, unsigned long long *n_records)
+{
+	size_t length = 0;
+
+	*n_records = 0;
+	while (s->used > 0) {
+		uint32_t len;
+
+		ring_read(s, &len, RECORD_HDR_SIZE);
+		ring_read(s, s->frame + length, len);
+		length += len;
+		(*n_records)++;
+	}
+
+	return length;
+}
+
+/*
+ * matches_subscriber() - Check if a stream id matches any subscriber pattern
+ *
+ * @s:		Subscriber.
+ * @stream_id:	Stream id to check.
+ *
+ * Return: True if the stream id matches, false otherwise.
+ */
+static bool matches_subscriber(const bus_subscriber_t *s, const char *stream_id)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->n_patterns; i++) {
+		if (fnmatch(s->patterns[i], stream_id, 0) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * split_records() - Split a CSV buffer in records
+ *
+ * @csv:	Data points in CSV format.
+ * @length:	Number of bytes of the CSV buffer.
+ * @records:	Pointer to store the allocated array of records.
+ * @ids:	Pointer to store the allocated buffer with the stream ids of
+ *		the records.
+ *
+ * Records without all the fields are skipped.
+ *
+ * Return: Number of records, 0 if there is none or on error.
+ */
+static size_t split_records(const char *csv, size_t length, bus_record_t **records, char **ids)
+{
+	size_t n = 0, max_len = 0, pos, id_pos = 0;
+	char *fields[csv_finished];
+	char *scratch = NULL;
+
+	*records = NULL;
+	*ids = NULL;
+
+	for (pos = 0; pos < length; n++) {
+		size_t len = dp_csv_record_length(csv + pos, length - pos);
+
+		if (len > max_len)
+			max_len = len;
+		pos += len;
+	}
+
+	if (n == 0)
+		return 0;
+
+	*records = calloc(n, sizeof(**records));
+	*ids = malloc(length + 1);
+	scratch = malloc(max_len + 1);
+	if (!*records || !*ids || !scratch) {
+		log_bus_error("Cannot publish data points: %s", "Out of memory");
+		n = 0;
+		goto done;
+	}
+
+	for (pos = 0, n = 0; pos < length; ) {
+		size_t len = dp_csv_record_length(csv + pos, length - pos);
+		size_t id_len;
+
+		if (dp_csv_parse_record(csv + pos, len, scratch, fields) != 0) {
+			log_bus_debug("Skipping malformed data point '%.*s'", (int) len, csv + pos);
+			pos += len;
+			continue;
+		}
+
+		id_len = strlen(fields[csv_stream_id]);
+		memcpy(*ids + id_pos, fields[csv_stream_id], id_len + 1);
+		(*records)[n].record = csv + pos;
+		(*records)[n].length = len;
+		(*records)[n].stream_id = *ids + id_pos;
+		id_pos += id_len + 1;
+		pos += len;
+		n++;
+	}
+
+done:
+	free(scratch);
+	if (n == 0) {
+		free(*records);
+		free(*ids);
+		*records = NULL;
+		*ids = NULL;
+	}
+
+	return n;
+}
+
+void dp_bus_publish_csv(const char *csv, size_t length)
+{
+	bus_subscriber_t *s;
+	bus_record_t *records;
+	bool *matched;
+	char *ids;
+	size_t n, i;
+
+	if (!csv || length == 0 || !dp_bus_has_subscribers())
+		return;
+
+	n = split_records(csv, length, &records, &ids);
+	if (n == 0)
+		return;
+
+	matched = malloc(n * sizeof(*matched));
+	if (!matched) {
+		log_bus_error("Cannot publish data points: %s", "Out of memory");
+		goto done;
+	}
+
+	pthread_mutex_lock(&bus_lock);
+
+	for (s = subscribers; s != NULL; s = s->next) {
+		bool any = false;
+
+		/* Patterns are immutable, match without blocking the subscriber */
+		for (i = 0; i < n; i++) {
+			matched[i] = matches_subscriber(s, records[i].stream_id);
+			any = any || matched[i];
+		}
+
+		if (!any)
+			continue;
+
+		pthread_mutex_lock(&s->lock);
+		for (i = 0; i < n; i++) {
+			if (matched[i])
+				enqueue_record(s, records[i].record, records[i].length);
+		}
+		pthread_cond_signal(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	pthread_mutex_unlock(&bus_lock);
+
+done:
+	free(matched);
+	free(records);
+	free(ids);
+}
+
+void dp_bus_publish_string(const char *stream_id, const char *value, size_t length)
+{
+	buffer_info_t buf_info;
+	string_info_t str_info;
+	int_info_t int_info;
+	struct timespec now;
+	char *str;
+	bool done;
+
+	if (!dp_bus_has_subscribers())
+		return;
+
+	str = value ? strndup(value, length) : strdup("");
+	buf_info.bytes_written = 0;
+	buf_info.bytes_available = length + strlen(stream_id) + 64;
+	buf_info.buffer = malloc(buf_info.bytes_available);
+	if (!str || !buf_info.buffer) {
+		log_bus_error("Cannot publish data point: %s", "Out of memory");
+		goto done;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	/* data,time,quality,description,location,type,unit,forward_to,stream_id */
+	init_string_info(&str_info, str);
+	done = process_string(&str_info, &buf_info) && put_character(',', &buf_info);
+	init_int_info(&int_info, (largest_int_t) now.tv_sec * 1000 + now.tv_nsec / 1000000, 10);
+	done = done && process_integer(&int_info, &buf_info);
+	done = done && put_character(',', &buf_info) && put_character(',', &buf_info)
+		&& put_character(',', &buf_info) && put_character(',', &buf_info);
+	init_string_info(&str_info, "STRING");
+	done = done && process_string(&str_info, &buf_info);
+	done = done && put_character(',', &buf_info) && put_character(',', &buf_info)
+		&& put_character(',', &buf_info);
+	init_string_info(&str_info, stream_id);
+	done = done && process_string(&str_info, &buf_info) && put_character('\n', &buf_info);
+
+	if (done)
+		dp_bus_publish_csv(buf_info.buffer, buf_info.bytes_written);
+	else
+		log_bus_error("Cannot publish data point: %s", "Out of memory");
+
+done:
+	free(buf_info.buffer);
+	free(str);
+}
+
+/*
+ * is_connected() - Check if the subscriber did not close its connection
+ *
+ * @fd:		Socket connected to the subscriber.
+ *
+ * Return: True if the connection is still open, false otherwise.
+ */
+static bool is_connected(int fd)
+{
+	char c;
+	ssize_t ret = recv(fd, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+
+	return ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
+
+/*
+ * send_frame() - Deliver queued records to a subscriber
+ *
+ * @s:		Subscriber.
+ * @dropped:	Number of records dropped since the last frame.
+ * @length:	Number of bytes of the frame.
+ *
+ * The frame is the number of dropped records followed by the records as a
+ * CSV blob. Both are corked in the same TCP segments.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int send_frame(bus_subscriber_t *s, uint32_t dropped, size_t length)
+{
+	int on = 1, off = 0;
+	int ret;
+
+	setsockopt(s->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+	ret = write_uint32(s->fd, dropped) || write_blob(s->fd, s->frame, length);
+	setsockopt(s->fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+
+	return ret ? -1 : 0;
+}
+
+/*
+ * free_subscriber() - Free a subscriber and close its connection
+ *
+ * @s:		Subscriber to free.
+ */
+static void free_subscriber(bus_subscriber_t *s)
+{
+	unsigned int i;
+
+	if (s->fd >= 0)
+		close(s->fd);
+	for (i = 0; i < s->n_patterns; i++)
+		free(s->patterns[i]);
+	free(s->ring);
+	free(s->frame);
+	if (s->size > 0)
+		mem_budget_release(MEM_SS_BUS, 2 * s->size);
+	pthread_mutex_destroy(&s->lock);
+	pthread_cond_destroy(&s->cond);
+	free(s);
+}
+
+/*
+ * remove_subscriber() - Remove a subscriber from the bus
+ *
+ * @s:		Subscriber to remove.
+ */
+static void remove_subscriber(bus_subscriber_t *s)
+{
+	bus_subscriber_t **p;
+
+	pthread_mutex_lock(&bus_lock);
+
+	for (p = &subscribers; *p != NULL; p = &(*p)->next) {
+		if (*p == s) {
+			*p = s->next;
+			__atomic_store_n(&n_subscribers, n_subscribers - 1, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	pthread_cond_broadcast(&bus_cond);
+
+	pthread_mutex_unlock(&bus_lock);
+}
+
+/*
+ * subscriber_threaded() - Deliver the queued records to a subscriber
+ *
+ * @arg:	Subscriber.
+ *
+ * Runs until the subscriber closes the connection or the bus is stopped.
+ * Publishers never wait for it: a slow subscriber only loses its own oldest
+ * records.
+ */
+static void *subscriber_threaded(void *arg)
+{
+	bus_subscriber_t *s = arg;
+
+	while (true) {
+		unsigned long long n_records;
+		uint32_t dropped;
+		size_t length;
+
+		pthread_mutex_lock(&s->lock);
+		while (s->used == 0 && s->dropped == 0 && !s->closing) {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += IDLE_CHECK_SEC;
+			if (pthread_cond_timedwait(&s->cond, &s->lock, &ts) == ETIMEDOUT
+				&& !is_connected(s->fd))
+				s->closing = true;
+		}
+
+		if (s->closing) {
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+
+		length = dequeue_records(s, &n_records);
+		dropped = s->dropped;
+		s->dropped = 0;
+		s->total_dropped += dropped;
+		s->delivered += n_records;
+		pthread_mutex_unlock(&s->lock);
+
+		if (dropped > 0)
+			log_bus_debug("Subscriber %d: %" PRIu32 " data points dropped", s->fd, dropped);
+
+		if (send_frame(s, dropped, length) != 0)
+			break;
+	}
+
+	log_bus_info("Subscriber %d disconnected (%llu data points delivered, %llu dropped)",
+		s->fd, s->delivered, s->total_dropped);
+
+	remove_subscriber(s);
+	free_subscriber(s);
+
+	return NULL;
+}
+
+/*
+ * read_subscription() - Read a subscription request
+ *
+ * @fd:		Socket to read from.
+ * @s:		Subscriber to fill with the request.
+ * @queue_kb:	Requested queue size in kB, 0 for the default one.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int read_subscription(int fd, bus_subscriber_t *s, uint32_t *queue_kb)
+{
+	uint32_t n_patterns, end;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	int ret;
+
+	ret = read_uint32(fd, queue_kb, &timeout);
+	if (ret == 0)
+		ret = read_uint32(fd, &n_patterns, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading subscription",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret)
+		send_error_codes(fd, "Failed to read subscription",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret)
+		return -1;
+
+	if (n_patterns == 0 || n_patterns > MAX_PATTERNS) {
+		send_error_codes(fd, "Invalid number of stream id patterns",
+			0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+
+		return -1;
+	}
+
+	for (s->n_patterns = 0; s->n_patterns < n_patterns; s->n_patterns++) {
+		size_t len;
+
+		ret = read_string(fd, &s->patterns[s->n_patterns], &len, &timeout);
+		if (ret == -ETIMEDOUT)
+			send_error_codes(fd, "Timeout reading stream id pattern",
+				0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+		else if (ret == -ENOMEM)
+			send_error_codes(fd, "Failed to read stream id pattern: Out of memory",
+				0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+		else if (ret == -EPIPE)
+			/* Do not send anything */
+			;
+		else if (ret)
+			send_error_codes(fd, "Failed to read stream id pattern",
+				0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+		if (ret)
+			return -1;
+
+		if (len == 0 || len > MAX_PATTERN_LEN) {
+			send_error_codes(fd, "Invalid stream id pattern",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			s->n_patterns++;
+
+			return -1;
+		}
+	}
+
+	ret = read_uint32(fd, &end, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading message end",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret || end != 0)
+		send_error_codes(fd, "Failed to read message end",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	return ret || end != 0 ? -1 : 0;
+}
+
+int handle_dp_subscribe_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	bus_subscriber_t *s;
+	pthread_attr_t attr;
+	pthread_t thread;
+	uint32_t queue_kb;
+	size_t size;
+	int one = 1;
+	int ret;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	s = calloc(1, sizeof(*s));
+	if (!s) {
+		send_error_codes(fd, "Failed to subscribe: Out of memory",
+			0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+
+		return 1;
+	}
+	s->fd = -1;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->cond, NULL);
+
+	if (read_subscription(fd, s, &queue_kb) != 0)
+		goto error;
+
+	size = queue_kb > 0 ? queue_kb * (size_t) 1024 : DEFAULT_QUEUE_SIZE;
+	if (size < MIN_QUEUE_SIZE)
+		size = MIN_QUEUE_SIZE;
+	else if (size > MAX_QUEUE_SIZE)
+		size = MAX_QUEUE_SIZE;
+
+	/* The queue and the frame buffer */
+	if (mem_budget_reserve(MEM_SS_BUS, 2 * size) != 0) {
+		send_error_codes(fd, "Failed to subscribe: Memory budget exceeded, retry later",
+			0, 0, CCCS_SEND_ERROR_BUSY);
+		goto error;
+	}
+	s->size = size;
+
+	s->ring = malloc(size);
+	s->frame = malloc(size);
+	if (!s->ring || !s->frame) {
+		send_error_codes(fd, "Failed to subscribe: Out of memory",
+			0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+		goto error;
+	}
+
+	/* The request socket is closed after handling the request */
+	s->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (s->fd < 0) {
+		send_error_codes(fd, "Failed to subscribe",
+			0, 0, CCCS_SEND_ERROR_ERROR_FROM_DAEMON);
+		goto error;
+	}
+	setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	pthread_mutex_lock(&bus_lock);
+	if (bus_stopped || n_subscribers >= MAX_SUBSCRIBERS) {
+		pthread_mutex_unlock(&bus_lock);
+		send_error_codes(fd, bus_stopped ? "Failed to subscribe: Stopping" : "Failed to subscribe: Too many subscribers",
+			0, 0, CCCS_SEND_ERROR_BUSY);
+		goto error;
+	}
+
+	/*
+	 * Add it before answering, so data points published once the
+	 * application is subscribed are queued, and answer before the
+	 * subscriber thread can deliver any record.
+	 */
+	s->next = subscribers;
+	subscribers = s;
+	__atomic_store_n(&n_subscribers, n_subscribers + 1, __ATOMIC_RELAXED);
+
+	if (send_ok(fd) != 0) {
+		ret = -1;
+	} else {
+		ret = pthread_attr_init(&attr);
+		if (ret == 0) {
+			pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+			ret = pthread_create(&thread, &attr, subscriber_threaded, s);
+			pthread_attr_destroy(&attr);
+		}
+		if (ret != 0)
+			log_bus_error("Unable to start subscriber thread (%d)", ret);
+	}
+	if (ret != 0) {
+		/* Still the first one, the bus lock is held */
+		subscribers = s->next;
+		__atomic_store_n(&n_subscribers, n_subscribers - 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&bus_lock);
+		goto error;
+	}
+
+	/* Log before unlocking, the subscriber thread may free it right after */
+	log_bus_info("Subscriber %d connected (%u patterns, %zu bytes queue)",
+		s->fd, s->n_patterns, s->size);
+
+	pthread_mutex_unlock(&bus_lock);
+
+	return 0;
+
+error:
+	free_subscriber(s);
+
+	return 1;
+}
+
+void dp_bus_stop(void)
+{
+	bus_subscriber_t *s;
+	struct timespec ts;
+
+	pthread_mutex_lock(&bus_lock);
+
+	bus_stopped = true;
+
+	for (s = subscribers; s != NULL; s = s->next) {
+		pthread_mutex_lock(&s->lock);
+		s->closing = true;
+		pthread_cond_signal(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+		/* Unblock any send in progress */
+		shutdown(s->fd, SHUT_RDWR);
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += STOP_TIMEOUT_SEC;
+	while (subscribers != NULL) {
+		if (pthread_cond_timedwait(&bus_cond, &bus_lock, &ts) == ETIMEDOUT) {
+			log_bus_error("%u subscribers did not disconnect", n_subscribers);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&bus_lock);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef SERVICE_DP_BUS_H
+#define SERVICE_DP_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "cc_config.h"
+#include "service_common.h"
+
+int handle_dp_subscribe_request(int fd, const cc_cfg_t *const cc_cfg);
+
+/*
+ * dp_bus_has_subscribers() - Check if any application is subscribed
+ *
+ * Return: True if there is at least one local subscriber, false otherwise.
+ */
+bool dp_bus_has_subscribers(void);
+
+/*
+ * dp_bus_publish_csv() - Deliver data points to the local subscribers
+ *
+ * @csv:	Data points in the CSV format generated by 'generate_dp_csv()'.
+ * @length:	Number of bytes of the CSV buffer.
+ *
+ * Each data point is queued for the subscribers with a pattern matching its
+ * stream id. It never blocks: when a subscriber queue is full, its oldest
+ * data points are dropped and the subscriber is told how many.
+ */
+void dp_bus_publish_csv(const char *csv, size_t length);
+
+/*
+ * dp_bus_publish_string() - Deliver a string data point to the local subscribers
+ *
+ * @stream_id:	Stream id of the data point.
+ * @value:	Value of the data point.
+ * @length:	Number of bytes of the value.
+ *
+ * The data point is stamped with the current time.
+ */
+void dp_bus_publish_string(const char *stream_id, const char *value, size_t length);
+
+/*
+ * dp_bus_stop() - Disconnect all the local subscribers
+ */
+void dp_bus_stop(void);
+
+#endif /* SERVICE_DP_BUS_H */
@@ -22,8 +22,12 @@
 
 #include "ccapi/ccapi.h"
 #include "_cc_datapoints.h"
+#include "cc_fw_schedule.h"
+#include "cc_gateway.h"
 #include "cc_logging.h"
+#include "cc_mem_budget.h"
 #include "cc_error_msg.h"
+#include "service_dp_bus.h"
 #include "service_dp_upload.h"
 #include "services_util.h"
 #include "services-client/cccs_definitions.h"
@@ -45,6 +49,7 @@ static ccapi_send_error_t upload_datapoint_file(uint32_t type,
 	switch (type) {
 		case upload_datapoint_file_events:
 		case upload_datapoint_file_metrics:
+		case upload_datapoint_file_metrics_child:
 			send_error = ccapi_send_data_with_reply_and_errorcode(CCAPI_TRANSPORT_TCP,
 				cloud_path, file_type, buff, size,
 				CCAPI_SEND_BEHAVIOR_OVERWRITE, TIMEOUT, hint_string_info, err_from_server);
@@ -101,11 +106,11 @@ static ccapi_dp_b_error_t upload_binary_datapoint(uint32_t type,
 int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 {
 	while (1) {
-		int ret, cccs_err = 0;
+		int ret, cccs_err = 0, allowed = 1;
 		uint32_t type;
 		size_t size;
 		void *blob = NULL;
-		char *file_path = NULL, *stream_id = NULL, *cloud_path = NULL;
+		char *file_path = NULL, *stream_id = NULL, *cloud_path = NULL, *child_id = NULL;
 		char const * err_msg = NULL;
 		struct timeval timeout = {
 			.tv_sec = SOCKET_READ_TIMEOUT_SEC,
@@ -141,7 +146,9 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 			&& type != upload_datapoint_file_events
 			&& type != upload_datapoint_file_path_metrics
 			&& type != upload_datapoint_file_path_binary
-			&& type != upload_datapoint_file_metrics_binary) {
+			&& type != upload_datapoint_file_metrics_binary
+			&& type != upload_datapoint_file_metrics_local
+			&& type != upload_datapoint_file_metrics_child) {
 			send_error_codes(fd, "Invalid data type",
 				0, 0, CCCS_SEND_ERROR_BAD_RESPONSE);
 
@@ -174,12 +181,17 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 			case upload_datapoint_file_events:
 			case upload_datapoint_file_metrics:
 			case upload_datapoint_file_metrics_binary:
+			case upload_datapoint_file_metrics_local:
+			case upload_datapoint_file_metrics_child:
 			default:
 				/* Read the data point(s) blob of data from the client process */
-				ret = read_blob(fd, &blob, &size, &timeout);
+				ret = read_blob_budget(fd, &blob, &size, &timeout, MEM_SS_UPLOAD);
 				if (ret == -ETIMEDOUT)
 					send_error_codes(fd, "Timeout reading data point data",
 						0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+				else if (ret == -ENOBUFS)
+					send_error_codes(fd, "Failed to read data point data: Memory budget exceeded, retry later",
+						0, 0, CCCS_SEND_ERROR_BUSY);
 				else if (ret == -ENOMEM)
 					send_error_codes(fd, "Failed to read data point data: Out of memory",
 						0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
@@ -196,6 +208,91 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 				break;
 		}
 
+		/* Move the data points of a child device to its data streams */
+		if (type == upload_datapoint_file_metrics_child) {
+			size_t child_size = 0;
+			char *child_csv = NULL;
+
+			/* Read the child device identifier */
+			ret = read_string(fd, &child_id, NULL, &timeout);
+			if (ret == -ETIMEDOUT)
+				send_error_codes(fd, "Timeout reading child identifier",
+					0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+			else if (ret == -ENOMEM)
+				send_error_codes(fd, "Failed to read child identifier: Out of memory",
+					0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+			else if (ret == -EPIPE)
+				/* Do not send anything */
+				;
+			else if (ret)
+				send_error_codes(fd, "Failed to read child identifier",
+					0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+			if (!ret) {
+				child_csv = gateway_child_csv(child_id, blob, size, &child_size);
+				if (!child_csv) {
+					send_error_codes(fd, "Invalid child identifier or data points",
+						0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+					ret = 1;
+				}
+			}
+
+			if (!ret) {
+				allowed = gateway_child_upload_allowed(child_id, child_size);
+				if (allowed < 0) {
+					send_error_codes(fd, "Child not registered",
+						0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+					ret = 1;
+				}
+			}
+
+			mem_budget_release(MEM_SS_UPLOAD, size + 1);
+			free(blob);
+
+			if (ret) {
+				free(child_csv);
+				free(child_id);
+				return 1;
+			}
+
+			mem_budget_charge(MEM_SS_UPLOAD, child_size + 1);
+			blob = child_csv;
+			size = child_size;
+		}
+
+		/* Deliver the data points to the local subscribers */
+		if (type == upload_datapoint_file_metrics
+			|| type == upload_datapoint_file_metrics_local
+			|| type == upload_datapoint_file_metrics_child)
+			dp_bus_publish_csv(blob, size);
+
+		/* Data points of a child over its upload rate wait in its backlog */
+		if (type == upload_datapoint_file_metrics_child && !allowed) {
+			ret = gateway_store_child_data(child_id, blob, size, 0);
+			gateway_account_upload(child_id, size, ret ? GW_UPLOAD_FAILED : GW_UPLOAD_DELAYED);
+
+			mem_budget_release(MEM_SS_UPLOAD, size + 1);
+			free(blob);
+			free(child_id);
+
+			if (ret) {
+				send_error_codes(fd, "Child upload rate exceeded, retry later",
+					0, 0, CCCS_SEND_ERROR_BUSY);
+				return 1;
+			}
+
+			send_ok(fd);
+			continue;
+		}
+
+		/* Local data points never reach the cloud */
+		if (type == upload_datapoint_file_metrics_local) {
+			mem_budget_release(MEM_SS_UPLOAD, size + 1);
+			free(blob);
+			send_ok(fd);
+			continue;
+		}
+
 		/* Determine cloud_path/stream_id*/
 		switch (type) {
 			case upload_datapoint_file_events:
@@ -219,6 +316,8 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 						0, 0, CCCS_SEND_ERROR_READ_ERROR);
 
 				if (ret) {
+					if (blob)
+						mem_budget_release(MEM_SS_UPLOAD, size + 1);
 					free(blob);
 					free(file_path);
 					return 1;
@@ -226,6 +325,7 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 				break;
 			case upload_datapoint_file_metrics:
 			case upload_datapoint_file_path_metrics:
+			case upload_datapoint_file_metrics_child:
 			default:
 				cloud_path = "DataPoint/.csv";
 				break;
@@ -257,6 +357,15 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 					cc_cfg->data_backlog_path, cc_cfg->data_backlog_kb);
 				err_msg = dp_b_to_send_error_msg(ret);
 				break;
+			case upload_datapoint_file_metrics_child:
+				/* Upload the blob to the cloud, the child backlog keeps it on failure */
+				ret = upload_datapoint_file(type, blob, size,
+					cloud_path, &hint_string_info, &err_from_server);
+				if (ret)
+					cccs_err = gateway_store_child_data(child_id, blob, size, ret);
+				gateway_account_upload(child_id, size, ret ? GW_UPLOAD_FAILED : GW_UPLOAD_SENT);
+				err_msg = to_send_error_msg(ret);
+				break;
 			case upload_datapoint_file_events:
 			case upload_datapoint_file_metrics:
 			default:
@@ -269,9 +378,12 @@ int handle_datapoint_file_upload(int fd, const cc_cfg_t *const cc_cfg)
 				break;
 		}
 
+		if (blob)
+			mem_budget_release(MEM_SS_UPLOAD, size + 1);
 		free(blob);
 		free(file_path);
 		free(stream_id);
+		free(child_id);
 
 		if (ret || cccs_err) {
 			char *err_msg_with_hint = NULL;
@@ -412,5 +524,8 @@ int handle_maintenance_request(int fd, const cc_cfg_t *const cc_cfg)
 	if (ret)
 		return 1;
 
+	/* Pending firmware updates can be applied during maintenance */
+	set_fw_schedule_maintenance(mnt_status != 0);
+
 	return send_datapoint_maintenance(fd, mnt_status);
 }
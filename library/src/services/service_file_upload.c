@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cc_file_upload.h"
+#include "cc_logging.h"
+#include "service_file_upload.h"
+#include "services_util.h"
+#include "services-client/cccs_definitions.h"
+#include "_utils.h"
+
+/*
+ * read_message_end() - Read the end of a client message
+ *
+ * @fd:		Socket to read from.
+ * @timeout:	Time to wait for the end of the message.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_message_end(int fd, struct timeval *timeout)
+{
+	uint32_t end;
+	int ret = read_uint32(fd, &end, timeout);
+
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading message end",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret || end != 0)
+		send_error_codes(fd, "Failed to read message end",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	return ret || end != 0 ? 1 : 0;
+}
+
+/*
+ * read_path() - Read a path from a client message
+ *
+ * @fd:		Socket to read from.
+ * @path:	Read path, it must be freed.
+ * @name:	Name of the path for the error messages.
+ * @timeout:	Time to wait for the path.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_path(int fd, char **path, const char *name, struct timeval *timeout)
+{
+	char msg[64];
+	int ret = read_string(fd, path, NULL, timeout);
+
+	if (ret == -ETIMEDOUT) {
+		snprintf(msg, sizeof(msg), "Timeout reading %s", name);
+		send_error_codes(fd, msg, 0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	} else if (ret == -ENOMEM) {
+		snprintf(msg, sizeof(msg), "Failed to read %s: Out of memory", name);
+		send_error_codes(fd, msg, 0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+	} else if (ret == -EPIPE) {
+		/* Do not send anything */
+		;
+	} else if (ret) {
+		snprintf(msg, sizeof(msg), "Failed to read %s", name);
+		send_error_codes(fd, msg, 0, 0, CCCS_SEND_ERROR_READ_ERROR);
+	}
+
+	return ret ? 1 : 0;
+}
+
+int handle_file_upload_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	char *local_path = NULL, *cloud_path = NULL;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	uint32_t id = 0;
+	int ret = 1;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (read_path(fd, &local_path, "local path", &timeout)
+		|| read_path(fd, &cloud_path, "cloud path", &timeout)
+		|| read_message_end(fd, &timeout))
+		goto done;
+
+	switch (queue_file_upload(local_path, cloud_path, &id)) {
+		case 0:
+			ret = send_ok(fd) || write_uint32(fd, id);
+			break;
+		case -EINVAL:
+			send_error_codes(fd, "Invalid local or cloud path",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		case -ENOENT:
+			send_error_codes(fd, "File does not exist, is empty or cannot be read",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		case -EBUSY:
+			send_error_codes(fd, "Too many queued uploads, retry later",
+				0, 0, CCCS_SEND_ERROR_BUSY);
+			break;
+		default:
+			send_error_codes(fd, "Unable to queue the upload",
+				0, 0, CCCS_SEND_ERROR_ERROR_FROM_DAEMON);
+			break;
+	}
+
+done:
+	free(local_path);
+	free(cloud_path);
+
+	return ret;
+}
+
+int handle_file_upload_status_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	file_upload_status_t status;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	uint32_t id;
+	int ret;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	ret = read_uint32(fd, &id, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading upload identifier",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret)
+		send_error_codes(fd, "Failed to read upload identifier",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret || read_message_end(fd, &timeout))
+		return 1;
+
+	get_file_upload_status(id, &status);
+
+	/* 64-bit sizes are sent as two 32-bit values, high part first */
+	if (send_ok(fd)
+		|| write_uint32(fd, status.state)
+		|| write_uint32(fd, (uint32_t) (status.sent >> 32))
+		|| write_uint32(fd, (uint32_t) status.sent)
+		|| write_uint32(fd, (uint32_t) (status.size >> 32))
+		|| write_uint32(fd, (uint32_t) status.size))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "cc_fw_schedule.h"
+#include "cc_logging.h"
+#include "service_fw_update.h"
+#include "services_util.h"
+#include "services-client/cccs_definitions.h"
+#include "_utils.h"
+
+/*
+ * read_message_end() - Read the end of a client message
+ *
+ * @fd:		Socket to read from.
+ * @timeout:	Time to wait for the end of the message.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_message_end(int fd, struct timeval *timeout)
+{
+	uint32_t end;
+	int ret = read_uint32(fd, &end, timeout);
+
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading message end",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret || end != 0)
+		send_error_codes(fd, "Failed to read message end",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	return ret || end != 0 ? 1 : 0;
+}
+
+int handle_fw_update_status_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	fw_schedule_status_t status;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (read_message_end(fd, &timeout))
+		return 1;
+
+	get_fw_schedule_status(&status);
+
+	if (send_ok(fd)
+		|| write_uint32(fd, status.action)
+		|| write_uint32(fd, status.imminent ? 1 : 0)
+		|| write_uint64(fd, status.apply_time > 0 ? (uint64_t) status.apply_time : 0)
+		|| write_uint32(fd, status.postpone_left))
+		return 1;
+
+	return 0;
+}
+
+int handle_fw_update_postpone_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	int ret;
+	uint32_t seconds;
+	time_t until;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	/* Read the seconds to postpone from the client message */
+	ret = read_uint32(fd, &seconds, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading postpone time",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret)
+		send_error_codes(fd, "Failed to read postpone time",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret || read_message_end(fd, &timeout))
+		return 1;
+
+	if (postpone_fw_update(seconds, &until) != 0) {
+		send_error_codes(fd, "No pending firmware update or cannot be postponed anymore",
+			0, 0, CCCS_SEND_ERROR_ERROR_FROM_DAEMON);
+		return 1;
+	}
+
+	if (send_ok(fd) || write_uint64(fd, until > 0 ? (uint64_t) until : 0))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "cc_gateway.h"
+#include "cc_logging.h"
+#include "service_gateway.h"
+#include "services_util.h"
+#include "services-client/cccs_definitions.h"
+
+/*
+ * read_message_end() - Read the end of a client message
+ *
+ * @fd:		Socket to read from.
+ * @timeout:	Time to wait for the end of the message.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_message_end(int fd, struct timeval *timeout)
+{
+	uint32_t end;
+	int ret = read_uint32(fd, &end, timeout);
+
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading message end",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret || end != 0)
+		send_error_codes(fd, "Failed to read message end",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	return ret || end != 0 ? 1 : 0;
+}
+
+/*
+ * read_child_id() - Read and validate a child identifier from a client message
+ *
+ * @fd:		Socket to read from.
+ * @child_id:	Read identifier, it must be freed.
+ * @timeout:	Time to wait for the identifier.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_child_id(int fd, char **child_id, struct timeval *timeout)
+{
+	int ret = read_string(fd, child_id, NULL, timeout);
+
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading child identifier",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret == -ENOMEM)
+		send_error_codes(fd, "Failed to read child identifier: Out of memory",
+			0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+	else if (ret == -EPIPE)
+		/* Do not send anything */
+		;
+	else if (ret)
+		send_error_codes(fd, "Failed to read child identifier",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret)
+		return 1;
+
+	if (!gateway_valid_child_id(*child_id)) {
+		send_error_codes(fd, "Invalid child identifier",
+			0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * send_gateway_result() - Send the result of a gateway operation
+ *
+ * @fd:		Socket to write to.
+ * @result:	Result of the operation.
+ *
+ * Return: 0 if the result is success and it was sent, 1 otherwise.
+ */
+static int send_gateway_result(int fd, int result)
+{
+	switch (result) {
+		case 0:
+			return send_ok(fd) ? 1 : 0;
+		case -EPERM:
+			send_error_codes(fd, "Gateway mode is disabled",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		case -EINVAL:
+			send_error_codes(fd, "Invalid child identifier",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		case -ENOSPC:
+			send_error_codes(fd, "Too many children",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		case -ENOENT:
+			send_error_codes(fd, "Child not registered",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		default:
+			send_error_codes(fd, "Unable to register child: Out of memory",
+				0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+			break;
+	}
+
+	return 1;
+}
+
+int handle_gw_register_child_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	char *child_id = NULL, *type = NULL;
+	int ret = 1;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (read_child_id(fd, &child_id, &timeout))
+		goto done;
+
+	switch (read_string(fd, &type, NULL, &timeout)) {
+		case 0:
+			break;
+		case -ETIMEDOUT:
+			send_error_codes(fd, "Timeout reading child type",
+				0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+			goto done;
+		case -ENOMEM:
+			send_error_codes(fd, "Failed to read child type: Out of memory",
+				0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+			goto done;
+		case -EPIPE:
+			/* Do not send anything */
+			goto done;
+		default:
+			send_error_codes(fd, "Failed to read child type",
+				0, 0, CCCS_SEND_ERROR_READ_ERROR);
+			goto done;
+	}
+
+	if (read_message_end(fd, &timeout))
+		goto done;
+
+	ret = send_gateway_result(fd, gateway_register_child(child_id, type));
+
+done:
+	free(child_id);
+	free(type);
+
+	return ret;
+}
+
+int handle_gw_unregister_child_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	char *child_id = NULL;
+	int ret = 1;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (read_child_id(fd, &child_id, &timeout) || read_message_end(fd, &timeout))
+		goto done;
+
+	ret = send_gateway_result(fd, gateway_unregister_child(child_id));
+
+done:
+	free(child_id);
+
+	return ret;
+}
+
+int handle_gw_child_state_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	char *child_id = NULL;
+	uint32_t online;
+	int ret = 1;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (read_child_id(fd, &child_id, &timeout))
+		goto done;
+
+	switch (read_uint32(fd, &online, &timeout)) {
+		case 0:
+			break;
+		case -ETIMEDOUT:
+			send_error_codes(fd, "Timeout reading child state",
+				0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+			goto done;
+		default:
+			send_error_codes(fd, "Failed to read child state",
+				0, 0, CCCS_SEND_ERROR_READ_ERROR);
+			goto done;
+	}
+
+	if (read_message_end(fd, &timeout))
+		goto done;
+
+	ret = send_gateway_result(fd, gateway_set_child_state(child_id, online != 0));
+
+done:
+	free(child_id);
+
+	return ret;
+}
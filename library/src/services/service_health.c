@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "cc_health_check.h"
+#include "cc_logging.h"
+#include "service_health.h"
+#include "services_util.h"
+#include "services-client/cccs_definitions.h"
+#include "_utils.h"
+
+int handle_health_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	int ret;
+	char *app = NULL;
+	uint32_t healthy, end;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	/* Read the application name from the client message */
+	ret = read_string(fd, &app, NULL, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading application name",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret == -ENOMEM)
+		send_error_codes(fd, "Failed to read application name: Out of memory",
+			0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+	else if (ret == -EPIPE)
+		/* Do not send anything */
+		;
+	else if (ret)
+		send_error_codes(fd, "Failed to read application name",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret)
+		return 1;
+
+	/* Read the health status */
+	ret = read_uint32(fd, &healthy, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading health status",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret)
+		send_error_codes(fd, "Failed to read health status",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret)
+		goto done;
+
+	/* Read message end */
+	ret = read_uint32(fd, &end, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading message end",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret || end != 0)
+		send_error_codes(fd, "Failed to read message end",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret || end != 0) {
+		ret = 1;
+		goto done;
+	}
+
+	/* Applications not in the health check list are accepted and ignored */
+	set_app_health_status(app, healthy != 0);
+
+	ret = send_ok(fd);
+
+done:
+	free(app);
+
+	return ret ? 1 : 0;
+}
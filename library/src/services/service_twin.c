@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cc_device_twin.h"
+#include "cc_logging.h"
+#include "service_twin.h"
+#include "services_util.h"
+#include "services-client/cccs_definitions.h"
+#include "_utils.h"
+
+#define TWIN_SVC_TAG			"TWIN:"
+
+#define MAX_SUBSCRIBERS			32
+
+/* Seconds between checks of idle subscriber connections */
+#define IDLE_CHECK_SEC			5
+/* Seconds to wait for the subscribers to disconnect when stopping */
+#define STOP_TIMEOUT_SEC		5
+
+/**
+ * log_twin_svc_info() - Log the given message as info
+ *
+ * @format:		Info message to log.
+ * @args:		Additional arguments.
+ */
+#define log_twin_svc_info(format, ...)					\
+	log_info("%s " format, TWIN_SVC_TAG, __VA_ARGS__)
+
+/**
+ * log_twin_svc_error() - Log the given message as error
+ *
+ * @format:		Error message to log.
+ * @args:		Additional arguments.
+ */
+#define log_twin_svc_error(format, ...)					\
+	log_error("%s " format, TWIN_SVC_TAG, __VA_ARGS__)
+
+/*
+ * struct twin_subscriber_t - Local device twin subscriber
+ *
+ * @fd:			Socket connected to the subscriber.
+ * @ns:			Namespace the subscriber is interested in.
+ * @version:		Last desired version the subscriber knows.
+ * @pending:		True when the desired state may have changed.
+ * @closing:		True when the subscriber must be disconnected.
+ * @next:		Next subscriber.
+ *
+ * All the fields but @fd and @ns are protected by 'twin_svc_lock'.
+ */
+typedef struct twin_subscriber {
+	int fd;
+	char *ns;
+	uint32_t version;
+	bool pending;
+	bool closing;
+	struct twin_subscriber *next;
+} twin_subscriber_t;
+
+static pthread_mutex_t twin_svc_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when a desired state changes or a subscriber leaves */
+static pthread_cond_t twin_svc_cond = PTHREAD_COND_INITIALIZER;
+static twin_subscriber_t *subscribers = NULL;
+static unsigned int n_subscribers = 0;
+static bool twin_svc_stopped = false;
+
+/*
+ * read_message_end() - Read the end of a client message
+ *
+ * @fd:		Socket to read from.
+ * @timeout:	Time to wait for the end of the message.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_message_end(int fd, struct timeval *timeout)
+{
+	uint32_t end;
+	int ret = read_uint32(fd, &end, timeout);
+
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading message end",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret || end != 0)
+		send_error_codes(fd, "Failed to read message end",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	return ret || end != 0 ? 1 : 0;
+}
+
+/*
+ * read_namespace() - Read and validate a namespace from a client message
+ *
+ * @fd:		Socket to read from.
+ * @ns:		Read namespace, it must be freed.
+ * @timeout:	Time to wait for the namespace.
+ *
+ * Return: 0 on success, 1 otherwise.
+ */
+static int read_namespace(int fd, char **ns, struct timeval *timeout)
+{
+	int ret = read_string(fd, ns, NULL, timeout);
+
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading namespace",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret == -ENOMEM)
+		send_error_codes(fd, "Failed to read namespace: Out of memory",
+			0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+	else if (ret == -EPIPE)
+		/* Do not send anything */
+		;
+	else if (ret)
+		send_error_codes(fd, "Failed to read namespace",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret)
+		return 1;
+
+	if (!device_twin_valid_namespace(*ns)) {
+		send_error_codes(fd, "Invalid namespace",
+			0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+		return 1;
+	}
+
+	return 0;
+}
+
+void twin_service_notify(const char *ns)
+{
+	twin_subscriber_t *s;
+	bool any = false;
+
+	pthread_mutex_lock(&twin_svc_lock);
+
+	for (s = subscribers; s != NULL; s = s->next) {
+		if (strcmp(s->ns, ns) == 0) {
+			s->pending = true;
+			any = true;
+		}
+	}
+	if (any)
+		pthread_cond_broadcast(&twin_svc_cond);
+
+	pthread_mutex_unlock(&twin_svc_lock);
+}
+
+/*
+ * is_connected() - Check if the subscriber did not close its connection
+ *
+ * @fd:		Socket connected to the subscriber.
+ *
+ * Return: True if the connection is still open, false otherwise.
+ */
+static bool is_connected(int fd)
+{
+	char c;
+	ssize_t ret = recv(fd, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+
+	return ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
+
+/*
+ * send_desired() - Deliver the desired state of its namespace to a subscriber
+ *
+ * @s:		Subscriber.
+ *
+ * The frame is the desired version followed by the desired state as a JSON
+ * blob. Nothing is sent if the subscriber already knows the current version.
+ *
+ * Return: 0 on success, -1 otherwise.
+ */
+static int send_desired(twin_subscriber_t *s)
+{
+	int on = 1, off = 0;
+	uint32_t version;
+	char *desired;
+	int ret;
+
+	if (device_twin_get_desired(s->ns, &version, &desired) != 0) {
+		log_twin_svc_error("Cannot notify subscriber %d: %s", s->fd, "Out of memory");
+		return -1;
+	}
+
+	/* Coalesced changes only deliver the latest state */
+	if (version == s->version) {
+		free(desired);
+		return 0;
+	}
+
+	setsockopt(s->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+	ret = write_uint32(s->fd, version) || write_blob(s->fd, desired, strlen(desired));
+	setsockopt(s->fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+	free(desired);
+
+	if (ret)
+		return -1;
+
+	s->version = version;
+
+	return 0;
+}
+
+/*
+ * free_subscriber() - Free a subscriber and close its connection
+ *
+ * @s:		Subscriber to free.
+ */
+static void free_subscriber(twin_subscriber_t *s)
+{
+	if (s->fd >= 0)
+		close(s->fd);
+	free(s->ns);
+	free(s);
+}
+
+/*
+ * remove_subscriber() - Remove a subscriber from the list
+ *
+ * @s:		Subscriber to remove.
+ *
+ * Must be called with 'twin_svc_lock' held.
+ */
+static void remove_subscriber(twin_subscriber_t *s)
+{
+	twin_subscriber_t **p;
+
+	for (p = &subscribers; *p != NULL; p = &(*p)->next) {
+		if (*p == s) {
+			*p = s->next;
+			n_subscribers--;
+			break;
+		}
+	}
+	pthread_cond_broadcast(&twin_svc_cond);
+}
+
+/*
+ * subscriber_threaded() - Deliver the desired state changes to a subscriber
+ *
+ * @arg:	Subscriber.
+ *
+ * The current desired state is delivered right away if the subscriber does
+ * not know it, so changes made while the application was not running are not
+ * lost. Runs until the subscriber closes the connection or the service is
+ * stopped.
+ */
+static void *subscriber_threaded(void *arg)
+{
+	twin_subscriber_t *s = arg;
+	int ret;
+
+	pthread_mutex_lock(&twin_svc_lock);
+	while (!s->closing) {
+		if (!s->pending) {
+			struct timespec ts;
+
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += IDLE_CHECK_SEC;
+			if (pthread_cond_timedwait(&twin_svc_cond, &twin_svc_lock, &ts) == ETIMEDOUT
+				&& !is_connected(s->fd))
+				s->closing = true;
+			continue;
+		}
+
+		s->pending = false;
+		pthread_mutex_unlock(&twin_svc_lock);
+		ret = send_desired(s);
+		pthread_mutex_lock(&twin_svc_lock);
+		if (ret != 0)
+			s->closing = true;
+	}
+
+	log_twin_svc_info("Subscriber %d of namespace '%s' disconnected", s->fd, s->ns);
+
+	remove_subscriber(s);
+	pthread_mutex_unlock(&twin_svc_lock);
+
+	free_subscriber(s);
+
+	return NULL;
+}
+
+int handle_twin_subscribe_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	twin_subscriber_t *s;
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	pthread_attr_t attr;
+	pthread_t thread;
+	int one = 1;
+	int ret;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	s = calloc(1, sizeof(*s));
+	if (!s) {
+		send_error_codes(fd, "Failed to subscribe: Out of memory",
+			0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+
+		return 1;
+	}
+	s->fd = -1;
+	s->pending = true;
+
+	if (read_namespace(fd, &s->ns, &timeout))
+		goto error;
+
+	ret = read_uint32(fd, &s->version, &timeout);
+	if (ret == -ETIMEDOUT)
+		send_error_codes(fd, "Timeout reading known version",
+			0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+	else if (ret)
+		send_error_codes(fd, "Failed to read known version",
+			0, 0, CCCS_SEND_ERROR_READ_ERROR);
+
+	if (ret || read_message_end(fd, &timeout))
+		goto error;
+
+	/* The request socket is closed after handling the request */
+	s->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (s->fd < 0) {
+		send_error_codes(fd, "Failed to subscribe",
+			0, 0, CCCS_SEND_ERROR_ERROR_FROM_DAEMON);
+		goto error;
+	}
+	setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	pthread_mutex_lock(&twin_svc_lock);
+	if (twin_svc_stopped || n_subscribers >= MAX_SUBSCRIBERS) {
+		pthread_mutex_unlock(&twin_svc_lock);
+		send_error_codes(fd, twin_svc_stopped ? "Failed to subscribe: Stopping" : "Failed to subscribe: Too many subscribers",
+			0, 0, CCCS_SEND_ERROR_BUSY);
+		goto error;
+	}
+
+	/* Answer before the subscriber thread can deliver any state */
+	if (send_ok(fd) != 0) {
+		pthread_mutex_unlock(&twin_svc_lock);
+		goto error;
+	}
+
+	ret = pthread_attr_init(&attr);
+	if (ret == 0) {
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		ret = pthread_create(&thread, &attr, subscriber_threaded, s);
+		pthread_attr_destroy(&attr);
+	}
+	if (ret != 0) {
+		pthread_mutex_unlock(&twin_svc_lock);
+		log_twin_svc_error("Unable to start subscriber thread (%d)", ret);
+		goto error;
+	}
+
+	s->next = subscribers;
+	subscribers = s;
+	n_subscribers++;
+
+	log_twin_svc_info("Subscriber %d of namespace '%s' connected (known version %" PRIu32 ")",
+		s->fd, s->ns, s->version);
+
+	pthread_mutex_unlock(&twin_svc_lock);
+
+	return 0;
+
+error:
+	free_subscriber(s);
+
+	return 1;
+}
+
+int handle_twin_report_request(int fd, const cc_cfg_t *const cc_cfg)
+{
+	struct timeval timeout = {
+		.tv_sec = SOCKET_READ_TIMEOUT_SEC,
+		.tv_usec = 0
+	};
+	char *ns = NULL, *patch = NULL;
+	uint32_t version = 0;
+	size_t length;
+	int ret = 1;
+
+	UNUSED_ARGUMENT(cc_cfg);
+
+	if (read_namespace(fd, &ns, &timeout))
+		goto done;
+
+	switch (read_blob(fd, (void **) &patch, &length, &timeout)) {
+		case 0:
+			break;
+		case -ETIMEDOUT:
+			send_error_codes(fd, "Timeout reading reported state",
+				0, 0, CCCS_SEND_ERROR_READ_TIMEOUT);
+			goto done;
+		case -ENOMEM:
+			send_error_codes(fd, "Failed to read reported state: Out of memory",
+				0, 0, CCCS_SEND_ERROR_OUT_OF_MEMORY);
+			goto done;
+		case -EPIPE:
+			/* Do not send anything */
+			goto done;
+		default:
+			send_error_codes(fd, "Failed to read reported state",
+				0, 0, CCCS_SEND_ERROR_READ_ERROR);
+			goto done;
+	}
+
+	if (read_message_end(fd, &timeout))
+		goto done;
+
+	switch (device_twin_report(ns, patch, length, &version)) {
+		case 0:
+			ret = send_ok(fd) || write_uint32(fd, version);
+			break;
+		case -EINVAL:
+			send_error_codes(fd, "Reported state is not a JSON object",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		case -ENOSPC:
+			send_error_codes(fd, "Reported state too big or too many namespaces",
+				0, 0, CCCS_SEND_ERROR_INVALID_ARGUMENT);
+			break;
+		default:
+			send_error_codes(fd, "Unable to store the reported state",
+				0, 0, CCCS_SEND_ERROR_ERROR_FROM_DAEMON);
+			break;
+	}
+
+done:
+	free(ns);
+	free(patch);
+
+	return ret;
+}
+
+void twin_service_stop(void)
+{
+	twin_subscriber_t *s;
+	struct timespec ts;
+
+	pthread_mutex_lock(&twin_svc_lock);
+
+	twin_svc_stopped = true;
+
+	for (s = subscribers; s != NULL; s = s->next) {
+		s->closing = true;
+		/* Unblock any send in progress */
+		shutdown(s->fd, SHUT_RDWR);
+	}
+	pthread_cond_broadcast(&twin_svc_cond);
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += STOP_TIMEOUT_SEC;
+	while (subscribers != NULL) {
+		if (pthread_cond_timedwait(&twin_svc_cond, &twin_svc_lock, &ts) == ETIMEDOUT) {
+			log_twin_svc_error("%u subscribers did not disconnect", n_subscribers);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&twin_svc_lock);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+#ifndef SERVICE_TWIN_H
+#define SERVICE_TWIN_H
+
+#include "cc_config.h"
+#include "service_common.h"
+
+int handle_twin_subscribe_request(int fd, const cc_cfg_t *const cc_cfg);
+int handle_twin_report_request(int fd, const cc_cfg_t *const cc_cfg);
+
+/*
+ * twin_service_notify() - Notify the subscribers of a namespace
+ *
+ * @ns:		Namespace whose desired state changed.
+ *
+ * The subscribers get the latest desired state of the namespace. It never
+ * blocks on the subscriber connections.
+ */
+void twin_service_notify(const char *ns);
+
+/*
+ * twin_service_stop() - Disconnect all the device twin subscribers
+ */
+void twin_service_stop(void);
+
+#endif /* SERVICE_TWIN_H */
@@ -26,7 +26,13 @@
 #include "ccapi/ccapi.h"
 #include "cc_logging.h"
 #include "service_data_request.h"
+#include "service_dp_bus.h"
 #include "service_dp_upload.h"
+#include "service_file_upload.h"
+#include "service_fw_update.h"
+#include "service_gateway.h"
+#include "service_health.h"
+#include "service_twin.h"
 #include "services.h"
 #include "services_util.h"
 
@@ -50,6 +56,18 @@ struct handler_t {
 		REQ_TAG_MNT_REQUEST,
 		handle_maintenance_request
 	},
+	{
+		REQ_TAG_HEALTH_REQUEST,
+		handle_health_request
+	},
+	{
+		REQ_TAG_FW_UPDATE_STATUS,
+		handle_fw_update_status_request
+	},
+	{
+		REQ_TAG_FW_UPDATE_POSTPONE,
+		handle_fw_update_postpone_request
+	},
 	{
 		REQ_TAG_REGISTER_DR,
 		handle_register_data_request
@@ -65,6 +83,38 @@ struct handler_t {
 	{
 		REQ_TAG_UNREGISTER_DR_IPV4,
 		handle_unregister_data_request_ipv4
+	},
+	{
+		REQ_TAG_DP_SUBSCRIBE,
+		handle_dp_subscribe_request
+	},
+	{
+		REQ_TAG_FILE_UPLOAD,
+		handle_file_upload_request
+	},
+	{
+		REQ_TAG_FILE_UPLOAD_STATUS,
+		handle_file_upload_status_request
+	},
+	{
+		REQ_TAG_TWIN_SUBSCRIBE,
+		handle_twin_subscribe_request
+	},
+	{
+		REQ_TAG_TWIN_REPORT,
+		handle_twin_report_request
+	},
+	{
+		REQ_TAG_GW_REGISTER_CHILD,
+		handle_gw_register_child_request
+	},
+	{
+		REQ_TAG_GW_UNREGISTER_CHILD,
+		handle_gw_unregister_child_request
+	},
+	{
+		REQ_TAG_GW_CHILD_STATE,
+		handle_gw_child_state_request
 	}
 };
 
@@ -189,4 +239,7 @@ void stop_listening_for_local_requests(void)
 		pthread_cancel(listen_thread);
 		pthread_join(listen_thread, NULL);
 	}
+
+	dp_bus_stop();
+	twin_service_stop();
 }
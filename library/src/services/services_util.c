@@ -19,12 +19,14 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "cc_mem_budget.h"
 #include "services_util.h"
 
 /*
@@ -362,6 +364,34 @@ int write_uint32(int fd, const uint32_t value)
 	return -1;
 }
 
+int read_uint64(int fd, uint64_t * const result, struct timeval *timeout)
+{
+	char text[50], *end;
+	int length = read_line(fd, text, sizeof(text) -1, timeout);	/* Read up to '\n' */
+
+	if (length > 2							/* Minimum req'd type, separator, terminator */
+		&& text[0] == DT_INTEGER				/* Verify correct type */
+		&& text[1] == SEPARATOR) {				/* A valid integer... so far */
+		*result = (uint64_t)strtoull(text+2, &end, 10);
+		if (*end == '\0')					/* All chars valid for an int */
+			return 0;
+	}
+
+	return length == -ETIMEDOUT ? length : -1;
+}
+
+int write_uint64(int fd, const uint64_t value)
+{
+	char text[30];
+	int length;
+
+	length = snprintf(text, (sizeof text)-1, "i:%" PRIu64 "%c", value, TERMINATOR);
+	if (length > -1)
+		return send_amt(fd, text, length);
+
+	return -1;
+}
+
 static int send_blob(int fd, const char *type, const void *data, size_t data_length)
 {
 	char terminator = TERMINATOR;
@@ -375,7 +405,34 @@ static int send_blob(int fd, const char *type, const void *data, size_t data_len
 	return -1;
 }
 
-static int recv_blob(int fd, char type, void **data, size_t *data_length, struct timeval *timeout)
+/*
+ * discard_amt() - Read and drop the given number of bytes
+ *
+ * @fd:		Socket to read from.
+ * @count:	Number of bytes to drop.
+ * @timeout:	Maximum time to wait, NULL to wait forever.
+ *
+ * Return: 0 on success, the read_amt() error otherwise.
+ */
+static int discard_amt(int fd, size_t count, struct timeval *timeout)
+{
+	char chunk[1024];
+
+	while (count > 0) {
+		size_t n = count < sizeof(chunk) ? count : sizeof(chunk);
+		int ret = read_amt(fd, chunk, n, timeout);
+
+		if (ret != 0)
+			return ret;
+
+		count -= n;
+	}
+
+	return 0;
+}
+
+static int recv_blob(int fd, char type, void **data, size_t *data_length,
+	struct timeval *timeout, mem_subsystem_t ss)
 {
 	char rxtype[12];
 	uint32_t length = 0;
@@ -396,9 +453,18 @@ static int recv_blob(int fd, char type, void **data, size_t *data_length, struct
 		if (ret != 0)
 			goto error;
 
+		if (mem_budget_reserve(ss, length + 1) != 0) {
+			/* Drop the payload so the sender can read the response */
+			ret = discard_amt(fd, length + 1, timeout);
+
+			return ret != 0 ? ret : -ENOBUFS;
+		}
+
 		buffer = calloc(length + 1, sizeof(*buffer));
-		if (!buffer)
+		if (!buffer) {
+			mem_budget_release(ss, length + 1);
 			return -ENOMEM;
+		}
 
 		ret = read_amt(fd, buffer, length + 1, timeout);	/* Read the payload + terminator */
 		if (ret != 0)
@@ -417,6 +483,8 @@ static int recv_blob(int fd, char type, void **data, size_t *data_length, struct
 	ret = -1;
 
 error:
+	if (buffer)
+		mem_budget_release(ss, length + 1);
 	free(buffer);
 
 	return ret;
@@ -429,12 +497,18 @@ int write_string(int fd, const char *string)
 
 int read_string(int fd, char **string, size_t *length, struct timeval *timeout)
 {
-	return recv_blob(fd, DT_STRING, (void **)string, length, timeout);
+	return recv_blob(fd, DT_STRING, (void **)string, length, timeout, MEM_SS_NONE);
 }
 
 int read_blob(int fd, void **buffer, size_t *length, struct timeval *timeout)
 {
-	return recv_blob(fd, DT_BLOB, buffer, length, timeout);
+	return recv_blob(fd, DT_BLOB, buffer, length, timeout, MEM_SS_NONE);
+}
+
+int read_blob_budget(int fd, void **buffer, size_t *length, struct timeval *timeout,
+	mem_subsystem_t ss)
+{
+	return recv_blob(fd, DT_BLOB, buffer, length, timeout, ss);
 }
 
 int write_blob(int fd, const void *data, size_t data_length)
@@ -24,6 +24,8 @@
 #include <inttypes.h>
 #include <sys/time.h>
 
+#include "cc_mem_budget.h"
+
 /* Upper protocol constants */
 
 #define RESP_END_OF_MESSAGE	0
@@ -42,10 +44,21 @@
 int read_uint32(int fd, uint32_t * const ret, struct timeval *timeout);
 int write_uint32(int fd, const uint32_t value);
 
+/* Same integer type on the wire, for values that may not fit 32 bits */
+int read_uint64(int fd, uint64_t * const ret, struct timeval *timeout);
+int write_uint64(int fd, const uint64_t value);
+
 int read_string(int fd, char **string, size_t *length, struct timeval *timeout);
 int write_string(int fd, const char *string);
 
 int read_blob(int fd, void **buffer, size_t *length, struct timeval *timeout);
+/*
+ * The blob is accounted to the memory budget subsystem 'ss' and must be
+ * released with 'mem_budget_release(ss, length + 1)' after freeing it.
+ * Returns -ENOBUFS if the budget cannot hold it.
+ */
+int read_blob_budget(int fd, void **buffer, size_t *length, struct timeval *timeout,
+	mem_subsystem_t ss);
 int write_blob(int fd, const void *data, size_t data_length);
 
 int send_ok(int fd);
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Cloud Connector debug messages benchmark.
+ *
+ * Measures the CPU time the connector debug messages take per data point
+ * upload, with the "error" log level of production devices. Each upload
+ * prints the messages CCAPI traces for a send: single-line and multi-part
+ * ones, through ccimp_hal_logging_vprintf().
+ *
+ * It runs twice:
+ *  - always: the messages are formatted, split in lines and passed to
+ *    syslog(), which drops them for the log level. This is the cost before
+ *    the messages could be switched off, reproduced by enabling them and
+ *    then lowering the log level.
+ *  - off: the messages are switched off, the default.
+ *
+ * Usage: bench_connector_debug [data points]
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "_utils.h"
+#include "cc_logging.h"
+#include "ccimp/ccimp_logging.h"
+
+#define DEFAULT_DATA_POINTS	1000000
+
+static void trace(debug_t debug, char const *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+static void trace(debug_t debug, char const *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	ccimp_hal_logging_vprintf(debug, format, args);
+	va_end(args);
+}
+
+static uint64_t cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * upload_data_point() - Print the connector messages of a data point upload
+ *
+ * @n:		Number of the data point.
+ */
+static void upload_data_point(unsigned long n)
+{
+	trace(debug_all, "ccapi_send_data: cloud_path='%s' content_type='%s' bytes=%zu\n",
+		"DataPoint/upload.csv", "text/plain", (size_t) 96);
+	trace(debug_beg, "ccapi_send_data: sending %lu", n);
+	trace(debug_mid, " block %d of %d", 1, 1);
+	trace(debug_end, " (%s)\n", "last");
+	trace(debug_all, "data_service: send request %lu, status %d\n", n, 0);
+}
+
+/*
+ * run() - Upload data points with the connector messages switched on or off
+ *
+ * @always:	True to format the messages, false to switch them off.
+ * @points:	Number of data points to upload.
+ *
+ * Return: CPU nanoseconds per data point.
+ */
+static double run(bool always, unsigned long points)
+{
+	uint64_t start;
+	unsigned long i;
+
+	set_log_level(LOG_DEBUG);
+	ccimp_logging_set_debug(always);
+	/* Not applied again, syslog() drops the formatted messages */
+	set_log_level(LOG_ERR);
+
+	start = cpu_ns();
+	for (i = 0; i < points; i++)
+		upload_data_point(i);
+
+	return (double) (cpu_ns() - start) / points;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long points = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_DATA_POINTS;
+	double always, off;
+
+#if !(defined CCIMP_DEBUG_ENABLED)
+	printf("Connector debug messages not built (CCIMP_DEBUG_ENABLED), skipping\n");
+	return EXIT_SUCCESS;
+#endif
+
+	if (points == 0 || init_logger(LOG_ERR, 0, "bench_connector_debug") != 0) {
+		fprintf(stderr, "Unable to set up the benchmark\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Warm up */
+	run(true, points / 10 + 1);
+
+	always = run(true, points);
+	off = run(false, points);
+
+	printf("%lu data points, 5 connector messages each, log level \"error\"\n", points);
+	printf("%-8s %16s\n", "messages", "CPU ns/point");
+	printf("%-8s %16.1f\n", "always", always);
+	printf("%-8s %16.1f\n", "off", off);
+
+	ccimp_logging_set_debug(false);
+	deinit_logger();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Connector idle wait benchmark.
+ *
+ * A simulated connector loop waits idle on its run lock through the ccimp OS
+ * layer, as the connector does, and measures:
+ *  - Idle wakeups per second.
+ *  - Latency from another thread releasing the run lock (queued work) until
+ *    the loop runs.
+ *  - Latency from data written to a socket until the loop runs.
+ *
+ * It runs twice: with a plain thread sleeping CONNECTOR_EVENT_FALLBACK_MS,
+ * the fixed idle sleep, and with the connector (FSM) thread waiting for
+ * connector events up to CCIMP_IDLE_SLEEP_TIME_MS.
+ *
+ * Usage: bench_connector_event [idle seconds]
+ */
+
+#include <poll.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccimp/ccimp_os.h"
+#include "connector_event.h"
+
+#define SAMPLES		20
+#define MAX_PAUSE_MS	150
+
+typedef struct {
+	bool events;
+	unsigned long timeout_ms;
+	ccimp_os_lock_create_t run_lock;
+	int sock[2];
+	sem_t done;
+	bool stop;
+	unsigned long wakeups;
+	uint64_t queued_at;
+	uint64_t sent_at;
+	uint64_t queued_us;
+	uint64_t net_us;
+	unsigned int queued_samples;
+	unsigned int net_samples;
+} bench_t;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+static void sleep_ms(unsigned long ms)
+{
+	usleep(ms * 1000);
+}
+
+/*
+ * connector_loop() - Simulated connector thread
+ *
+ * @argument:	Benchmark data (bench_t).
+ */
+static void connector_loop(void *argument)
+{
+	bench_t *b = argument;
+	ccimp_os_lock_acquire_t acquire = {
+		.lock = b->run_lock.lock,
+		.timeout_ms = b->timeout_ms
+	};
+
+	if (b->events)
+		connector_event_watch(b->sock[1], false);
+
+	while (!__atomic_load_n(&b->stop, __ATOMIC_ACQUIRE)) {
+		struct pollfd pfd = { .fd = b->sock[1], .events = POLLIN };
+		uint64_t queued_at, sent_at, now;
+
+		ccimp_os_lock_acquire(&acquire);
+		now = now_us();
+		__atomic_add_fetch(&b->wakeups, 1, __ATOMIC_RELAXED);
+
+		queued_at = __atomic_exchange_n(&b->queued_at, 0, __ATOMIC_ACQ_REL);
+		if (acquire.acquired && queued_at != 0) {
+			b->queued_us += now - queued_at;
+			b->queued_samples++;
+		}
+
+		if (poll(&pfd, 1, 0) == 1) {
+			char c;
+
+			sent_at = __atomic_exchange_n(&b->sent_at, 0, __ATOMIC_ACQ_REL);
+			if (read(b->sock[1], &c, 1) == 1 && sent_at != 0) {
+				b->net_us += now - sent_at;
+				b->net_samples++;
+			}
+		}
+	}
+
+	if (b->events)
+		connector_event_unwatch(b->sock[1]);
+
+	sem_post(&b->done);
+}
+
+/*
+ * wait_consumed() - Wait until the connector loop handles a sample
+ *
+ * @stamp:	Timestamp of the sample, cleared by the loop.
+ */
+static void wait_consumed(uint64_t *stamp)
+{
+	while (__atomic_load_n(stamp, __ATOMIC_ACQUIRE) != 0)
+		sleep_ms(1);
+}
+
+static int run(bool events, unsigned int idle_seconds)
+{
+	ccimp_os_create_thread_info_t thread = {
+		.start = connector_loop,
+		.type = events ? CCIMP_THREAD_FSM : CCIMP_THREAD_RECEIVE
+	};
+	ccimp_os_lock_release_t release;
+	ccimp_os_lock_destroy_t destroy;
+	bench_t b = {
+		.events = events,
+		.timeout_ms = events ? CCIMP_IDLE_SLEEP_TIME_MS : CONNECTOR_EVENT_FALLBACK_MS
+	};
+	unsigned long idle_wakeups;
+	int i;
+
+	if (ccimp_os_lock_create(&b.run_lock) != CCIMP_STATUS_OK
+		|| socketpair(AF_UNIX, SOCK_STREAM, 0, b.sock) != 0
+		|| sem_init(&b.done, 0, 0) != 0) {
+		fprintf(stderr, "Unable to set up the benchmark\n");
+		return -1;
+	}
+	release.lock = b.run_lock.lock;
+	destroy.lock = b.run_lock.lock;
+
+	thread.argument = &b;
+	if (ccimp_os_create_thread(&thread) != CCIMP_STATUS_OK) {
+		fprintf(stderr, "Unable to create the connector thread\n");
+		return -1;
+	}
+
+	/* Let the loop settle before counting idle wakeups */
+	sleep_ms(200);
+	idle_wakeups = __atomic_load_n(&b.wakeups, __ATOMIC_RELAXED);
+	sleep(idle_seconds);
+	idle_wakeups = __atomic_load_n(&b.wakeups, __ATOMIC_RELAXED) - idle_wakeups;
+
+	srand(1);
+	for (i = 0; i < SAMPLES; i++) {
+		sleep_ms((unsigned long) (rand() % MAX_PAUSE_MS));
+		__atomic_store_n(&b.queued_at, now_us(), __ATOMIC_RELEASE);
+		ccimp_os_lock_release(&release);
+		wait_consumed(&b.queued_at);
+	}
+
+	for (i = 0; i < SAMPLES; i++) {
+		sleep_ms((unsigned long) (rand() % MAX_PAUSE_MS));
+		__atomic_store_n(&b.sent_at, now_us(), __ATOMIC_RELEASE);
+		if (write(b.sock[0], "x", 1) != 1)
+			break;
+		wait_consumed(&b.sent_at);
+	}
+
+	__atomic_store_n(&b.stop, true, __ATOMIC_RELEASE);
+	ccimp_os_lock_release(&release);
+	sem_wait(&b.done);
+
+	printf("%-6s %8lu ms %10.2f %16.3f %16.3f\n", events ? "event" : "sleep",
+		b.timeout_ms, (double) idle_wakeups / idle_seconds,
+		b.queued_samples ? (double) b.queued_us / b.queued_samples / 1000 : 0.0,
+		b.net_samples ? (double) b.net_us / b.net_samples / 1000 : 0.0);
+
+	ccimp_os_lock_destroy(&destroy);
+	close(b.sock[0]);
+	close(b.sock[1]);
+	sem_destroy(&b.done);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int idle_seconds = argc > 1 ? (unsigned int) atoi(argv[1]) : 5;
+
+	if (idle_seconds == 0)
+		idle_seconds = 1;
+
+	printf("%-6s %11s %10s %16s %16s\n", "mode", "idle wait", "wakeups/s",
+		"queued work (ms)", "net data (ms)");
+
+	if (run(false, idle_seconds) != 0 || run(true, idle_seconds) != 0)
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
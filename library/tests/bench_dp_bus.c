@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Local data point bus benchmark.
+ *
+ * Subscribers connect with 'cccs_dp_subscribe()' over a loopback socket to
+ * the daemon side of the bus, which runs in this process. One thread then
+ * publishes batches of 41 data points, as 'dp_bus_publish_csv()' receives
+ * them from uploads, back to back.
+ *
+ * For 1, 8 and 32 subscribers, with 1 MB and 4 kB queues, it prints:
+ *  - Data points published per second. Publishing never waits for the
+ *    subscribers.
+ *  - Data points delivered per second to all the subscribers.
+ *  - Data points dropped because a subscriber queue was full.
+ *
+ * It fails if any subscriber did not get or was not told about the drop of
+ * every published data point.
+ *
+ * The bus removes unsubscribed applications when it finds their connection
+ * closed, so each run first waits a few seconds for the previous one.
+ *
+ * Usage: bench_dp_bus [batches]
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "_cccs_utils.h"
+#include "cccs_datapoints.h"
+#include "service_dp_bus.h"
+#include "services_util.h"
+
+#define MAX_BENCH_SUBSCRIBERS	32
+#define DEFAULT_BATCHES		5000
+#define BATCH_POINTS		41
+#define DRAIN_TIMEOUT_US	(20 * 1000000)
+#define LAST_STREAM_ID		"data_request/bench"
+
+typedef struct {
+	cccs_dp_subscription_t *subscription;
+	unsigned long long delivered;
+	bool done;
+} subscriber_t;
+
+static int listen_fd = -1;
+static in_port_t listen_port;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+/*
+ * Daemon side: accept subscription requests as the daemon does.
+ */
+
+static void *acceptor(void *arg)
+{
+	(void)arg;
+
+	for (;;) {
+		char *tag = NULL;
+		int fd = accept(listen_fd, NULL, NULL);
+
+		if (fd < 0)
+			return NULL;
+
+		if (read_string(fd, &tag, NULL, NULL) == 0)
+			handle_dp_subscribe_request(fd, NULL);
+		free(tag);
+		close(fd);
+	}
+}
+
+static int start_daemon(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	pthread_t thread;
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd < 0
+		|| bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+		|| listen(listen_fd, MAX_BENCH_SUBSCRIBERS) != 0
+		|| getsockname(listen_fd, (struct sockaddr *) &addr, &len) != 0)
+		return -1;
+	listen_port = addr.sin_port;
+
+	if (pthread_create(&thread, NULL, acceptor, NULL) != 0)
+		return -1;
+	pthread_detach(thread);
+
+	return 0;
+}
+
+/*
+ * Client side: connect to the daemon side above.
+ */
+
+int connect_cccsd(void)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = listen_port,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+cccs_comm_error_t parse_cccsd_response(int fd, cccs_srv_resp_t *resp, unsigned long timeout)
+{
+	uint32_t code;
+
+	(void)timeout;
+
+	memset(resp, 0, sizeof(*resp));
+	if (read_uint32(fd, &code, NULL) != 0 || code != 0) {
+		resp->cccs_err = CCCS_SEND_ERROR_BAD_RESPONSE;
+
+		return CCCS_SEND_ERROR_BAD_RESPONSE;
+	}
+
+	return CCCS_SEND_ERROR_NONE;
+}
+
+static void subscriber_cb(const cccs_local_dp_t *dp, void *user_data)
+{
+	subscriber_t *s = user_data;
+
+	__atomic_add_fetch(&s->delivered, 1, __ATOMIC_RELAXED);
+	if (strcmp(dp->stream_id, LAST_STREAM_ID) == 0)
+		__atomic_store_n(&s->done, true, __ATOMIC_RELEASE);
+}
+
+/*
+ * drained() - Check if a subscriber got or was told about every data point
+ *
+ * @s:		The subscriber.
+ * @total:	Number of published data points.
+ */
+static bool drained(subscriber_t *s, unsigned long long total)
+{
+	unsigned long long delivered = __atomic_load_n(&s->delivered, __ATOMIC_RELAXED);
+
+	return __atomic_load_n(&s->done, __ATOMIC_ACQUIRE)
+		&& delivered + cccs_dp_subscription_dropped(s->subscription) >= total;
+}
+
+static size_t build_batch(char *batch, size_t size)
+{
+	size_t len = 0;
+	int i;
+
+	/* Same format as the CSV generated for uploads */
+	for (i = 0; i < BATCH_POINTS - 1; i++)
+		len += (size_t) snprintf(batch + len, size - len,
+			"%d,1685440800000,,,,INTEGER,bytes,,bench/s%d\n", i, i % 4);
+	len += (size_t) snprintf(batch + len, size - len,
+		"\"a,\\\"b\\\"\nc\",,,,,STRING,,,bench/str\n");
+
+	return len;
+}
+
+static int run(unsigned int n_subscribers, unsigned int queue_kb, unsigned int n_batches)
+{
+	const char *patterns[] = { "bench/*", "data_request/*" };
+	subscriber_t subscribers[MAX_BENCH_SUBSCRIBERS];
+	unsigned long long total = (unsigned long long) n_batches * BATCH_POINTS + 1;
+	unsigned long long delivered = 0, dropped = 0;
+	uint64_t start, published_us, drained_us;
+	char batch[4096];
+	size_t batch_len = build_batch(batch, sizeof(batch));
+	bool failed = false;
+	unsigned int i;
+
+	/* Subscribers of the previous run are removed in the background */
+	start = now_us();
+	while (dp_bus_has_subscribers() && now_us() - start < DRAIN_TIMEOUT_US)
+		usleep(1000);
+
+	memset(subscribers, 0, sizeof(subscribers));
+	for (i = 0; i < n_subscribers; i++) {
+		cccs_resp_t resp;
+
+		if (cccs_dp_subscribe(patterns, 2, queue_kb, subscriber_cb, &subscribers[i],
+				&subscribers[i].subscription, 5, &resp) != CCCS_SEND_ERROR_NONE) {
+			fprintf(stderr, "Unable to subscribe (%d)\n", resp.code);
+			free(resp.hint);
+			return -1;
+		}
+	}
+
+	start = now_us();
+	for (i = 0; i < n_batches; i++)
+		dp_bus_publish_csv(batch, batch_len);
+	/* The last data point also reports the drops after the last delivery */
+	dp_bus_publish_string(LAST_STREAM_ID, "last", 4);
+	published_us = now_us() - start;
+
+	for (i = 0; i < n_subscribers; i++) {
+		while (!drained(&subscribers[i], total) && now_us() - start < DRAIN_TIMEOUT_US)
+			usleep(1000);
+	}
+	drained_us = now_us() - start;
+
+	for (i = 0; i < n_subscribers; i++) {
+		subscriber_t *s = &subscribers[i];
+		unsigned long long s_dropped = cccs_dp_subscription_dropped(s->subscription);
+
+		if (s->delivered + s_dropped != total)
+			failed = true;
+		delivered += s->delivered;
+		dropped += s_dropped;
+		cccs_dp_unsubscribe(s->subscription);
+	}
+
+	printf("%11u %10u %14.0f %16.0f %12llu\n", n_subscribers, queue_kb,
+		(double) total * 1000000 / (double) (published_us ? published_us : 1),
+		(double) delivered * 1000000 / (double) (drained_us ? drained_us : 1),
+		dropped);
+
+	if (failed) {
+		fprintf(stderr, "%u subscribers: %llu delivered + %llu dropped of %llu published\n",
+			n_subscribers, delivered, dropped, total * n_subscribers);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int const subscribers[] = { 1, 8, 32 };
+	unsigned int const queues_kb[] = { 1024, 4 };
+	unsigned int n_batches = argc > 1 ? (unsigned int) atoi(argv[1]) : DEFAULT_BATCHES;
+	int ret = EXIT_SUCCESS;
+	size_t q, i;
+
+	if (n_batches == 0)
+		n_batches = DEFAULT_BATCHES;
+
+	if (start_daemon() != 0) {
+		fprintf(stderr, "Unable to start the bus\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%11s %10s %14s %16s %12s\n", "subscribers", "queue (kB)",
+		"published/s", "delivered/s", "dropped");
+
+	for (q = 0; q < sizeof(queues_kb) / sizeof(queues_kb[0]); q++) {
+		for (i = 0; i < sizeof(subscribers) / sizeof(subscribers[0]); i++) {
+			if (run(subscribers[i], queues_kb[q], n_batches) != 0)
+				ret = EXIT_FAILURE;
+		}
+	}
+
+	dp_bus_stop();
+	close(listen_fd);
+
+	return ret;
+}
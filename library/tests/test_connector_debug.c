@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Runtime switch test of the Cloud Connector debug messages.
+ *
+ * Connector messages are printed with ccimp_hal_logging_vprintf(), as CCAPI
+ * does, and the log is captured from the standard error (LOG_PERROR):
+ *  - Messages are off by default.
+ *  - Enabled messages are logged with the CCAPI prefix, and multi-part
+ *    messages as a single line.
+ *  - Messages stay off if the log level does not include debug.
+ *  - Switching in the middle of a multi-part message neither splits it nor
+ *    leaves the buffer locked.
+ *  - Messages from other threads follow the switch.
+ *
+ * Usage: test_connector_debug
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "_utils.h"
+#include "cc_logging.h"
+#include "ccimp/ccimp_logging.h"
+
+#define LOG_NAME	"test_connector_debug"
+#define PREFIX		"[DEBUG] CCAPI: "
+
+static unsigned int failures;
+
+/* The standard error is the captured log */
+#define CHECK(condition)						\
+	do {								\
+		if (!(condition)) {					\
+			fprintf(stdout, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #condition);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+static int log_fd = -1;
+static off_t log_offset;
+static char log_text[4096];
+
+static void trace(debug_t debug, char const *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+
+static void trace(debug_t debug, char const *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	ccimp_hal_logging_vprintf(debug, format, args);
+	va_end(args);
+}
+
+/*
+ * read_log() - Get the messages logged since the last call
+ *
+ * Return: The logged text, empty if nothing was logged.
+ */
+static char const *read_log(void)
+{
+	ssize_t n = pread(log_fd, log_text, sizeof(log_text) - 1, log_offset);
+
+	if (n < 0)
+		n = 0;
+	log_text[n] = '\0';
+	log_offset += n;
+
+	return log_text;
+}
+
+static unsigned int count_lines(char const *text)
+{
+	unsigned int n = 0;
+
+	for (; *text; text++) {
+		if (*text == '\n')
+			n++;
+	}
+
+	return n;
+}
+
+static void test_default_off(void)
+{
+	set_log_level(LOG_DEBUG);
+	trace(debug_all, "default %d\n", 1);
+	CHECK(*read_log() == '\0');
+}
+
+static void test_enabled(void)
+{
+	char const *text;
+
+	set_log_level(LOG_DEBUG);
+	ccimp_logging_set_debug(true);
+
+	trace(debug_all, "single %d\n", 1);
+	text = read_log();
+	CHECK(strstr(text, LOG_NAME ": " PREFIX "single 1\n") != NULL);
+	CHECK(count_lines(text) == 1);
+
+	trace(debug_beg, "multi %s", "part ");
+	trace(debug_mid, "%d ", 2);
+	trace(debug_end, "%s\n", "end");
+	text = read_log();
+	CHECK(strstr(text, PREFIX "multi part 2 end\n") != NULL);
+	CHECK(count_lines(text) == 1);
+
+	/* Lines are logged separately */
+	trace(debug_all, "line %d\nline %d\n", 1, 2);
+	text = read_log();
+	CHECK(strstr(text, PREFIX "line 1\n") != NULL);
+	CHECK(strstr(text, ": line 2\n") != NULL);
+	CHECK(count_lines(text) == 2);
+
+	ccimp_logging_set_debug(false);
+	trace(debug_all, "disabled %d\n", 1);
+	CHECK(*read_log() == '\0');
+}
+
+static void test_log_mask(void)
+{
+	set_log_level(LOG_ERR);
+	ccimp_logging_set_debug(true);
+	set_log_level(LOG_DEBUG);
+
+	/* Enabled with a log level without debug, it must be applied again */
+	trace(debug_all, "masked %d\n", 1);
+	CHECK(*read_log() == '\0');
+
+	ccimp_logging_set_debug(true);
+	trace(debug_all, "unmasked %d\n", 1);
+	CHECK(strstr(read_log(), PREFIX "unmasked 1\n") != NULL);
+	ccimp_logging_set_debug(false);
+}
+
+static void test_switch_mid_message(void)
+{
+	char const *text;
+
+	set_log_level(LOG_DEBUG);
+
+	/* Disabled during the message: it is still logged complete */
+	ccimp_logging_set_debug(true);
+	trace(debug_beg, "%s", "started ");
+	ccimp_logging_set_debug(false);
+	trace(debug_mid, "%s", "enabled ");
+	trace(debug_end, "%s\n", "done");
+	text = read_log();
+	CHECK(strstr(text, PREFIX "started enabled done\n") != NULL);
+	CHECK(count_lines(text) == 1);
+
+	/* Enabled during the message: it is discarded complete */
+	trace(debug_beg, "%s", "started ");
+	ccimp_logging_set_debug(true);
+	trace(debug_mid, "%s", "disabled ");
+	trace(debug_end, "%s\n", "done");
+	CHECK(*read_log() == '\0');
+
+	/* The buffer is not left locked */
+	trace(debug_all, "next %d\n", 1);
+	text = read_log();
+	CHECK(strstr(text, PREFIX "next 1\n") != NULL);
+	CHECK(strstr(text, "[ERROR]") == NULL);
+	ccimp_logging_set_debug(false);
+}
+
+static void *thread_trace(void *argument)
+{
+	trace(debug_beg, "thread %s", (char const *) argument);
+	trace(debug_end, "%s\n", " end");
+
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	pthread_t thread;
+	char const *text;
+
+	set_log_level(LOG_DEBUG);
+	ccimp_logging_set_debug(true);
+	CHECK(pthread_create(&thread, NULL, thread_trace, "on") == 0);
+	pthread_join(thread, NULL);
+	text = read_log();
+	CHECK(strstr(text, PREFIX "thread on end\n") != NULL);
+
+	ccimp_logging_set_debug(false);
+	CHECK(pthread_create(&thread, NULL, thread_trace, "off") == 0);
+	pthread_join(thread, NULL);
+	CHECK(*read_log() == '\0');
+}
+
+int main(void)
+{
+	char path[] = "/tmp/cc_debug_XXXXXX";
+	int stderr_fd;
+
+#if !(defined CCIMP_DEBUG_ENABLED)
+	printf("Connector debug messages not built (CCIMP_DEBUG_ENABLED), skipping\n");
+	return EXIT_SUCCESS;
+#endif
+
+	/* The log is printed to the standard error, captured in a file */
+	log_fd = mkstemp(path);
+	stderr_fd = dup(STDERR_FILENO);
+	if (log_fd < 0 || stderr_fd < 0 || dup2(log_fd, STDERR_FILENO) < 0) {
+		perror("Unable to capture the log");
+		return EXIT_FAILURE;
+	}
+	unlink(path);
+
+	if (init_logger(LOG_ERR, LOG_PERROR, LOG_NAME) != 0) {
+		fprintf(stdout, "Unable to initialize the log\n");
+		return EXIT_FAILURE;
+	}
+
+	test_default_off();
+	test_enabled();
+	test_log_mask();
+	test_switch_mid_message();
+	test_threads();
+
+	deinit_logger();
+	dup2(stderr_fd, STDERR_FILENO);
+	close(stderr_fd);
+	close(log_fd);
+
+	if (failures > 0) {
+		fprintf(stderr, "%u checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Data point staging stress test.
+ *
+ * 1, 2, 4, 8 and 16 producer threads add data points to one collection with
+ * 'cccs_dp_add()' while another thread keeps sending it, as an application
+ * uploading its samples does. Each producer adds increasing values to its
+ * own data stream.
+ *
+ * The test fails if a data point is lost or duplicated, or if the data
+ * points of a stream are not sent in the order they were added. For each
+ * number of producers it prints the add throughput and the maximum time a
+ * single 'cccs_dp_add()' took.
+ *
+ * The CCAPI collection functions and the communication with the daemon are
+ * replaced by the minimal versions below, as well as 'trim()', only used by
+ * formats with timestamps. Sending takes SEND_DELAY_MS, the time the
+ * collection lock is held while the daemon stores the data points.
+ *
+ * Usage: test_dp_staging [data points per producer]
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccimp/ccimp_types.h"
+#include "ccapi/ccapi_datapoints.h"
+#include "_cc_datapoints.h"
+#include "_utils.h"
+#include "_cccs_utils.h"
+#include "cccs_datapoints.h"
+#include "cccs_services.h"
+#include "services_util.h"
+
+#define MAX_PRODUCERS		16
+#define DEFAULT_POINTS		20000
+#define SEND_DELAY_MS		20
+
+typedef struct {
+	cccs_dp_collection_handle_t collection;
+	unsigned int id;
+	int32_t n_points;
+	uint64_t max_add_us;
+	bool failed;
+} producer_t;
+
+/* Last value sent of each producer stream, -1 if none */
+static int32_t last_sent[MAX_PRODUCERS];
+static unsigned long sent_points;
+static unsigned long order_errors;
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+/*
+ * Minimal CCAPI data point collection, protected by a mutex.
+ */
+
+static void free_data_points(connector_data_stream_t *ds)
+{
+	connector_data_point_t *dp = ds->point;
+
+	while (dp) {
+		connector_data_point_t *next = dp->next;
+
+		free(dp);
+		dp = next;
+	}
+	ds->point = NULL;
+}
+
+static void free_data_stream(cccs_dp_data_stream_t *stream)
+{
+	free_data_points(stream->ccfsm_data_stream);
+	free(stream->ccfsm_data_stream->stream_id);
+	free(stream->ccfsm_data_stream);
+	free(stream->arguments.list);
+	free(stream);
+}
+
+ccapi_dp_error_t ccapi_dp_create_collection(ccapi_dp_collection_handle_t *collection)
+{
+	cccs_dp_collection_t *c = calloc(1, sizeof(*c));
+	pthread_mutex_t *lock = malloc(sizeof(*lock));
+
+	if (!c || !lock) {
+		free(c);
+		free(lock);
+		return CCAPI_DP_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	pthread_mutex_init(lock, NULL);
+	c->lock = lock;
+	*collection = c;
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+ccapi_dp_error_t ccapi_dp_clear_collection(ccapi_dp_collection_handle_t collection)
+{
+	cccs_dp_data_stream_t *stream;
+
+	lock_acquire(collection->lock);
+	for (stream = collection->cccs_data_stream_list; stream; stream = stream->next)
+		free_data_points(stream->ccfsm_data_stream);
+	collection->dp_count = 0;
+	lock_release(collection->lock);
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+ccapi_dp_error_t ccapi_dp_destroy_collection(ccapi_dp_collection_handle_t collection)
+{
+	cccs_dp_data_stream_t *stream = collection->cccs_data_stream_list;
+
+	while (stream) {
+		cccs_dp_data_stream_t *next = stream->next;
+
+		free_data_stream(stream);
+		stream = next;
+	}
+	pthread_mutex_destroy(collection->lock);
+	free(collection->lock);
+	free(collection);
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+ccapi_dp_error_t ccapi_dp_add_data_stream_to_collection_extra(
+	ccapi_dp_collection_handle_t collection, char const *stream_id,
+	char const *format_string, char const *units, char const *forward_to)
+{
+	cccs_dp_data_stream_t *stream = calloc(1, sizeof(*stream));
+
+	(void)units;
+	(void)forward_to;
+
+	/* Only "int32" data streams are used */
+	if (!stream || strcmp(format_string, CCCS_DP_KEY_DATA_INT32) != 0) {
+		free(stream);
+		return CCAPI_DP_ERROR_INVALID_FORMAT;
+	}
+
+	stream->ccfsm_data_stream = calloc(1, sizeof(*stream->ccfsm_data_stream));
+	stream->arguments.list = calloc(1, sizeof(*stream->arguments.list));
+	if (!stream->ccfsm_data_stream || !stream->arguments.list) {
+		free(stream->ccfsm_data_stream);
+		free(stream->arguments.list);
+		free(stream);
+		return CCAPI_DP_ERROR_INSUFFICIENT_MEMORY;
+	}
+	stream->ccfsm_data_stream->stream_id = strdup(stream_id);
+	stream->ccfsm_data_stream->type = connector_data_point_type_integer;
+	stream->arguments.list[0] = CCCS_DP_ARG_DATA_INT32;
+	stream->arguments.count = 1;
+
+	lock_acquire(collection->lock);
+	stream->next = collection->cccs_data_stream_list;
+	if (stream->next)
+		stream->ccfsm_data_stream->next = stream->next->ccfsm_data_stream;
+	collection->cccs_data_stream_list = stream;
+	lock_release(collection->lock);
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+ccapi_dp_error_t ccapi_dp_remove_data_stream_from_collection(
+	ccapi_dp_collection_handle_t collection, char const *stream_id)
+{
+	cccs_dp_data_stream_t **p, *stream;
+
+	lock_acquire(collection->lock);
+	for (p = &collection->cccs_data_stream_list; (stream = *p) != NULL; p = &stream->next) {
+		connector_data_point_t *dp;
+
+		if (strcmp(stream->ccfsm_data_stream->stream_id, stream_id) != 0)
+			continue;
+
+		for (dp = stream->ccfsm_data_stream->point; dp; dp = dp->next)
+			collection->dp_count--;
+		*p = stream->next;
+		free_data_stream(stream);
+		break;
+	}
+	lock_release(collection->lock);
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+ccapi_dp_error_t ccapi_dp_get_collection_points_count(
+	ccapi_dp_collection_handle_t collection, uint32_t *count)
+{
+	lock_acquire(collection->lock);
+	*count = collection->dp_count;
+	lock_release(collection->lock);
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+ccapi_dp_error_t ccapi_dp_remove_older_data_point_from_streams(
+	ccapi_dp_collection_handle_t collection)
+{
+	(void)collection;
+
+	return CCAPI_DP_ERROR_NONE;
+}
+
+char *trim(char *str)
+{
+	return str;
+}
+
+int lock_acquire(void *lock)
+{
+	return pthread_mutex_lock(lock) == 0 ? 0 : 1;
+}
+
+int lock_release(void *lock)
+{
+	return pthread_mutex_unlock(lock) == 0 ? 0 : 1;
+}
+
+/*
+ * Sending: all data points are sent at once and checked when removed.
+ */
+
+size_t dp_generate_csv_from_collection(cccs_dp_collection_t * const collection,
+	buffer_info_t *buf_info, unsigned int max_dp, unsigned int *n_dp)
+{
+	(void)max_dp;
+
+	buf_info->buffer = strdup("");
+	buf_info->bytes_written = 0;
+	*n_dp = collection->dp_count;
+
+	return collection->dp_count > 0 ? 1 : 0;
+}
+
+/*
+ * check_sent_stream() - Check the data points of a producer stream
+ *
+ * @ds:	The data stream, its data points are linked newest first.
+ */
+static unsigned long check_sent_stream(connector_data_stream_t const * const ds)
+{
+	unsigned int id = (unsigned int) atoi(ds->stream_id + 1);
+	connector_data_point_t const *dp;
+	unsigned long n = 0;
+	int32_t newer = INT32_MAX;
+
+	for (dp = ds->point; dp; dp = dp->next, n++) {
+		int32_t value = dp->data.element.native.int_value;
+
+		if (value >= newer || value <= last_sent[id])
+			order_errors++;
+		newer = value;
+	}
+
+	if (ds->point)
+		last_sent[id] = ds->point->data.element.native.int_value;
+
+	return n;
+}
+
+unsigned int dp_remove_from_collection(cccs_dp_collection_t * const collection, unsigned int n_to_remove)
+{
+	cccs_dp_data_stream_t *stream;
+	unsigned long removed = 0;
+
+	for (stream = collection->cccs_data_stream_list; stream; stream = stream->next) {
+		removed += check_sent_stream(stream->ccfsm_data_stream);
+		free_data_points(stream->ccfsm_data_stream);
+	}
+
+	if (removed != n_to_remove)
+		order_errors++;
+
+	collection->dp_count = 0;
+	sent_points += removed;
+
+	return (unsigned int) removed;
+}
+
+int connect_cccsd(void)
+{
+	return open("/dev/null", O_WRONLY);
+}
+
+int write_string(int fd, const char *string)
+{
+	(void)fd;
+	(void)string;
+
+	return 0;
+}
+
+int write_uint32(int fd, const uint32_t value)
+{
+	(void)fd;
+	(void)value;
+
+	return 0;
+}
+
+int write_blob(int fd, const void *data, size_t data_length)
+{
+	(void)fd;
+	(void)data;
+	(void)data_length;
+
+	return 0;
+}
+
+cccs_comm_error_t parse_cccsd_response(int fd, cccs_srv_resp_t *resp, unsigned long timeout)
+{
+	(void)fd;
+	(void)timeout;
+
+	usleep(SEND_DELAY_MS * 1000);
+	memset(resp, 0, sizeof(*resp));
+
+	return CCCS_SEND_ERROR_NONE;
+}
+
+/*
+ * Test
+ */
+
+static void *producer(void *arg)
+{
+	producer_t *p = arg;
+	char stream_id[8];
+	int32_t i;
+
+	snprintf(stream_id, sizeof(stream_id), "p%u", p->id);
+
+	for (i = 0; i < p->n_points; i++) {
+		uint64_t start = now_us(), elapsed;
+
+		if (cccs_dp_add(p->collection, stream_id, i) != CCCS_DP_ERROR_NONE) {
+			p->failed = true;
+			break;
+		}
+		elapsed = now_us() - start;
+		if (elapsed > p->max_add_us)
+			p->max_add_us = elapsed;
+	}
+
+	return NULL;
+}
+
+static volatile bool stop_sender;
+
+static void *sender(void *arg)
+{
+	cccs_dp_collection_handle_t collection = arg;
+
+	while (!stop_sender) {
+		cccs_resp_t resp;
+
+		cccs_send_dp_collection(collection, &resp);
+		free(resp.hint);
+	}
+
+	return NULL;
+}
+
+static int run(unsigned int n_producers, int32_t n_points)
+{
+	producer_t producers[MAX_PRODUCERS];
+	pthread_t threads[MAX_PRODUCERS], sender_thread;
+	cccs_dp_collection_handle_t collection;
+	unsigned long expected = (unsigned long) n_producers * (unsigned long) n_points;
+	uint64_t start, elapsed, max_add_us = 0;
+	cccs_resp_t resp;
+	uint32_t left;
+	bool failed = false;
+	unsigned int i;
+
+	sent_points = 0;
+	order_errors = 0;
+
+	if (cccs_dp_create_collection(&collection) != CCCS_DP_ERROR_NONE) {
+		fprintf(stderr, "Unable to create the collection\n");
+		return -1;
+	}
+
+	for (i = 0; i < n_producers; i++) {
+		char stream_id[8];
+
+		snprintf(stream_id, sizeof(stream_id), "p%u", i);
+		if (cccs_dp_add_data_stream_to_collection(collection, stream_id,
+				CCCS_DP_KEY_DATA_INT32, false) != CCCS_DP_ERROR_NONE) {
+			fprintf(stderr, "Unable to add stream '%s'\n", stream_id);
+			return -1;
+		}
+		last_sent[i] = -1;
+		producers[i] = (producer_t) {
+			.collection = collection,
+			.id = i,
+			.n_points = n_points,
+		};
+	}
+
+	stop_sender = false;
+	pthread_create(&sender_thread, NULL, sender, collection);
+
+	start = now_us();
+	for (i = 0; i < n_producers; i++)
+		pthread_create(&threads[i], NULL, producer, &producers[i]);
+	for (i = 0; i < n_producers; i++) {
+		pthread_join(threads[i], NULL);
+		failed |= producers[i].failed;
+		if (producers[i].max_add_us > max_add_us)
+			max_add_us = producers[i].max_add_us;
+	}
+	elapsed = now_us() - start;
+
+	stop_sender = true;
+	pthread_join(sender_thread, NULL);
+
+	/* Send what is left */
+	cccs_send_dp_collection(collection, &resp);
+	free(resp.hint);
+	cccs_dp_get_collection_points_count(collection, &left);
+
+	for (i = 0; i < n_producers; i++) {
+		if (last_sent[i] != n_points - 1)
+			order_errors++;
+	}
+
+	printf("%9u %14.0f %18.3f %12lu %12lu\n", n_producers,
+		(double) expected * 1000000 / (double) (elapsed ? elapsed : 1),
+		(double) max_add_us / 1000, sent_points, order_errors);
+
+	cccs_dp_destroy_collection(collection);
+
+	if (failed || order_errors || left || sent_points != expected) {
+		fprintf(stderr, "%u producers: %lu of %lu data points sent, %u left, %lu order errors%s\n",
+			n_producers, sent_points, expected, left, order_errors,
+			failed ? ", add failed" : "");
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int32_t n_points = argc > 1 ? (int32_t) atoi(argv[1]) : DEFAULT_POINTS;
+	unsigned int n;
+	int ret = EXIT_SUCCESS;
+
+	if (n_points <= 0)
+		n_points = DEFAULT_POINTS;
+
+	printf("%9s %14s %18s %12s %12s\n", "producers", "adds/s",
+		"max add (ms)", "sent", "errors");
+
+	for (n = 1; n <= MAX_PRODUCERS; n *= 2) {
+		if (run(n, n_points) != 0)
+			ret = EXIT_FAILURE;
+	}
+
+	return ret;
+}
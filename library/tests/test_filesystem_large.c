@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2024 Digi International Inc.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+ * OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Digi International Inc., 9350 Excelsior Blvd., Suite 700, Hopkins, MN 55343
+ * ===========================================================================
+ */
+
+/*
+ * Large file test of the ccimp file system layer.
+ *
+ * A sparse file of more than 5 GB is created in a temporary directory and
+ * accessed with the ccimp file system functions:
+ *  - Seeks from the start, the current offset and the end past 2^32.
+ *  - Reads and writes around and past 2^32.
+ *  - Truncates to sizes past 2^32.
+ *  - The size reported for the file.
+ *
+ * When 'ccimp_file_offset_t' is 32 bits, the connector built without
+ * CCIMP_FILE_SYSTEM_LARGE_FILES_SUPPORTED, it checks instead that those
+ * offsets fail with EOVERFLOW and are not truncated. EOVERFLOW must be
+ * reported as an invalid parameter in both cases.
+ *
+ * The file takes no space on file systems with sparse file support. If the
+ * file system cannot hold it, the test is skipped.
+ *
+ * Usage: test_filesystem_large [directory]
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ccimp/ccimp_filesystem.h"
+
+#define OFFSET_4G	((int64_t) 1 << 32)
+#define LARGE_SIZE	(5 * OFFSET_4G + 3)
+
+static unsigned int failures;
+
+#define CHECK(condition)						\
+	do {								\
+		if (!(condition)) {					\
+			fprintf(stderr, "%s:%d: check failed: %s\n",	\
+				__FILE__, __LINE__, #condition);	\
+			failures++;					\
+		}							\
+	} while (0)
+
+static bool large_offsets(void)
+{
+	return sizeof(ccimp_file_offset_t) >= sizeof(int64_t)
+		&& sizeof(off_t) >= sizeof(int64_t);
+}
+
+/*
+ * seek() - Seek with ccimp_fs_file_seek()
+ *
+ * @fd:		File handle.
+ * @offset:	Requested offset.
+ * @origin:	Origin of the offset.
+ * @errnum:	Error number, 0 if the seek succeeds.
+ *
+ * Return: The resulting offset, -1 if it fails.
+ */
+static int64_t seek(int fd, int64_t offset, ccimp_fs_seek_origin_t origin, int *errnum)
+{
+	ccimp_fs_file_seek_t seek_data = {
+		.handle = fd,
+		.requested_offset = (ccimp_file_offset_t) offset,
+		.origin = origin
+	};
+
+	*errnum = 0;
+	if (ccimp_fs_file_seek(&seek_data) != CCIMP_STATUS_OK) {
+		*errnum = seek_data.errnum;
+		return -1;
+	}
+
+	return seek_data.resulting_offset;
+}
+
+static size_t read_at(int fd, int64_t offset, void *buffer, size_t length)
+{
+	ccimp_fs_file_read_t read_data = {
+		.handle = fd,
+		.buffer = buffer,
+		.bytes_available = length
+	};
+	int errnum;
+
+	if (seek(fd, offset, CCIMP_SEEK_SET, &errnum) != offset
+		|| ccimp_fs_file_read(&read_data) != CCIMP_STATUS_OK)
+		return 0;
+
+	return read_data.bytes_used;
+}
+
+static size_t write_at(int fd, int64_t offset, void const *buffer, size_t length)
+{
+	ccimp_fs_file_write_t write_data = {
+		.handle = fd,
+		.buffer = buffer,
+		.bytes_available = length
+	};
+	int errnum;
+
+	if (seek(fd, offset, CCIMP_SEEK_SET, &errnum) != offset
+		|| ccimp_fs_file_write(&write_data) != CCIMP_STATUS_OK)
+		return 0;
+
+	return write_data.bytes_used;
+}
+
+static int truncate_to(int fd, int64_t length)
+{
+	ccimp_fs_file_truncate_t truncate_data = {
+		.handle = fd,
+		.length_in_bytes = (ccimp_file_offset_t) length
+	};
+
+	if (ccimp_fs_file_truncate(&truncate_data) != CCIMP_STATUS_OK)
+		return truncate_data.errnum;
+
+	return 0;
+}
+
+static ccimp_fs_error_t error_status(int errnum)
+{
+	char error_string[64];
+	ccimp_fs_error_desc_t error_desc_data = {
+		.errnum = errnum,
+		.error_string = error_string,
+		.bytes_available = sizeof(error_string)
+	};
+
+	CHECK(ccimp_fs_error_desc(&error_desc_data) == CCIMP_STATUS_OK);
+	CHECK(error_desc_data.bytes_used > 0);
+
+	return error_desc_data.error_status;
+}
+
+static void test_large_offsets(int fd, char const *path)
+{
+	ccimp_fs_dir_entry_status_t status_data = { .path = path };
+	char buffer[8];
+	int errnum;
+
+	CHECK(truncate_to(fd, LARGE_SIZE) == 0);
+
+	CHECK(ccimp_fs_dir_entry_status(&status_data) == CCIMP_STATUS_OK);
+	CHECK(status_data.status.type == CCIMP_FS_DIR_ENTRY_FILE);
+	CHECK(status_data.status.file_size == LARGE_SIZE);
+
+	CHECK(seek(fd, OFFSET_4G + 1, CCIMP_SEEK_SET, &errnum) == OFFSET_4G + 1);
+	CHECK(seek(fd, OFFSET_4G, CCIMP_SEEK_CUR, &errnum) == 2 * OFFSET_4G + 1);
+	CHECK(seek(fd, -(OFFSET_4G + 3), CCIMP_SEEK_CUR, &errnum) == OFFSET_4G - 2);
+	CHECK(seek(fd, 0, CCIMP_SEEK_END, &errnum) == LARGE_SIZE);
+	CHECK(seek(fd, -3, CCIMP_SEEK_END, &errnum) == 5 * OFFSET_4G);
+
+	/* Data past 2^32 and across the 2^32 boundary */
+	CHECK(write_at(fd, OFFSET_4G + 1, "abc", 3) == 3);
+	CHECK(write_at(fd, LARGE_SIZE - 3, "xyz", 3) == 3);
+	CHECK(read_at(fd, OFFSET_4G - 2, buffer, 6) == 6);
+	CHECK(memcmp(buffer, "\0\0\0abc", 6) == 0);
+	CHECK(read_at(fd, LARGE_SIZE - 3, buffer, sizeof(buffer)) == 3);
+	CHECK(memcmp(buffer, "xyz", 3) == 0);
+
+	/* Shrink, still past 2^32 */
+	CHECK(truncate_to(fd, OFFSET_4G + 2) == 0);
+	CHECK(ccimp_fs_dir_entry_status(&status_data) == CCIMP_STATUS_OK);
+	CHECK(status_data.status.file_size == OFFSET_4G + 2);
+	CHECK(seek(fd, 0, CCIMP_SEEK_END, &errnum) == OFFSET_4G + 2);
+	CHECK(read_at(fd, OFFSET_4G, buffer, sizeof(buffer)) == 2);
+	CHECK(memcmp(buffer, "\0a", 2) == 0);
+}
+
+static void test_offset_overflow(int fd, char const *path)
+{
+	ccimp_fs_dir_entry_status_t status_data = { .path = path };
+	int errnum;
+
+	/* The file is made large without ccimp, its offsets cannot hold the size */
+	if (ftruncate(fd, (off_t) (OFFSET_4G + 1)) != 0) {
+		printf("File system cannot hold a %lld bytes file, skipping\n",
+			(long long) (OFFSET_4G + 1));
+		return;
+	}
+
+	CHECK(ccimp_fs_dir_entry_status(&status_data) == CCIMP_STATUS_ERROR);
+	CHECK(status_data.errnum == EOVERFLOW);
+	CHECK(status_data.status.type == CCIMP_FS_DIR_ENTRY_UNKNOWN);
+	CHECK(status_data.status.file_size == 0);
+	CHECK(error_status(status_data.errnum) == CCIMP_FS_ERROR_INVALID_PARAMETER);
+
+	/* The end of the file is past the largest offset */
+	CHECK(seek(fd, 0, CCIMP_SEEK_END, &errnum) == -1);
+	CHECK(errnum == EOVERFLOW);
+	CHECK(error_status(errnum) == CCIMP_FS_ERROR_INVALID_PARAMETER);
+}
+
+int main(int argc, char *argv[])
+{
+	char const *base = argc > 1 ? argv[1] : getenv("TMPDIR");
+	char dir[256], path[300];
+	ccimp_fs_file_open_t open_data = { 0 };
+	ccimp_fs_file_close_t close_data = { 0 };
+	ccimp_fs_file_remove_t remove_data = { 0 };
+	int errnum;
+
+	snprintf(dir, sizeof(dir), "%s/cc_fs_XXXXXX", base ? base : "/tmp");
+	if (!mkdtemp(dir)) {
+		perror("Unable to create the test directory");
+		return EXIT_FAILURE;
+	}
+	snprintf(path, sizeof(path), "%s/large.bin", dir);
+
+	open_data.path = path;
+	open_data.flags = CCIMP_FILE_O_RDWR | CCIMP_FILE_O_CREAT | CCIMP_FILE_O_TRUNC;
+	if (ccimp_fs_file_open(&open_data) != CCIMP_STATUS_OK) {
+		fprintf(stderr, "Unable to open '%s': %s\n", path, strerror(open_data.errnum));
+		rmdir(dir);
+		return EXIT_FAILURE;
+	}
+
+	CHECK(error_status(EOVERFLOW) == CCIMP_FS_ERROR_INVALID_PARAMETER);
+
+	if (!large_offsets()) {
+		printf("%zu bits file offsets: checking overflows\n", 8 * sizeof(ccimp_file_offset_t));
+		test_offset_overflow(open_data.handle, path);
+	} else if ((errnum = truncate_to(open_data.handle, LARGE_SIZE)) != 0) {
+		printf("File system cannot hold a %lld bytes file (%s), skipping\n",
+			(long long) LARGE_SIZE, strerror(errnum));
+	} else {
+		printf("%zu bits file offsets: checking offsets past 2^32\n", 8 * sizeof(ccimp_file_offset_t));
+		test_large_offsets(open_data.handle, path);
+	}
+
+	close_data.handle = open_data.handle;
+	CHECK(ccimp_fs_file_close(&close_data) == CCIMP_STATUS_OK);
+	remove_data.path = path;
+	CHECK(ccimp_fs_file_remove(&remove_data) == CCIMP_STATUS_OK);
+	rmdir(dir);
+
+	if (failures > 0) {
+		fprintf(stderr, "%u checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}